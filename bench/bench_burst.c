@@ -0,0 +1,358 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Benchmark: deadline misses with and without burst learning
+ *
+ * Replays a trace of task activations on a simulated node of CPUS CPUs in
+ * steps of TICK_NS, scheduling it twice: once the way the scheduler does
+ * without burst learning (class slices, earliest deadline first) and once
+ * with it (slices sized from each task's burst, short bursts moved ahead,
+ * see burst.h). Runs are judged like simple_stopping judges them: each
+ * enqueue gets the deadline its SLO gives, and a run that ends past it is
+ * a miss. Reports the miss ratio per task group and how well the early
+ * predictions matched the misses.
+ *
+ * The trace is read from TRACE if given, else (or with -) generated:
+ * request threads with short bursts and workers with long ones share one
+ * SLO, next to batch work. Trace format, '#' starts a comment:
+ *
+ *   task ID GROUP CLASS BUDGET_MS IMPORTANCE
+ *   TIME_US ID BURST_US
+ *
+ * CLASS is standard, latency-critical, batch or best-effort; activations
+ * must be in time order.
+ *
+ * Usage: bench_burst [TRACE|-] [SECONDS]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../src/burst.h"
+
+#define CPUS       4
+#define MAX_TASKS  256
+#define MAX_GROUPS 8
+#define TICK_NS    10000ULL
+#define US         1000ULL
+#define MS         1000000ULL
+#define SEC        1000000000ULL
+
+/* Slices per class, as in class_policy in scx_slo.bpf.c */
+#define SLICE_DFL (20 * MS)
+static const __u64 class_slice[NR_SLO_CLASSES] = {
+	[SLO_CLASS_STANDARD] = SLICE_DFL,
+	[SLO_CLASS_CRITICAL] = SLICE_DFL / 4,
+	[SLO_CLASS_BATCH] = SLICE_DFL * 2,
+	[SLO_CLASS_BESTEFFORT] = SLICE_DFL / 2,
+};
+
+static const char *class_names[NR_SLO_CLASSES] = {
+	[SLO_CLASS_STANDARD] = "standard",
+	[SLO_CLASS_CRITICAL] = "latency-critical",
+	[SLO_CLASS_BATCH] = "batch",
+	[SLO_CLASS_BESTEFFORT] = "best-effort",
+};
+
+struct activation {
+	__u64 time_ns;
+	int task;
+	__u64 burst_ns;
+};
+
+enum state { SLEEPING, QUEUED, RUNNING };
+
+struct task {
+	int group;
+	__u32 cls;
+	__u64 window_ns;
+	enum state state;
+	__u64 deadline, vtime;
+	__u64 left_ns;      /* Of the current activation */
+	__u64 backlog_ns;   /* Of activations that arrived while it was awake */
+	__u64 slice_left;
+	struct slo_task_burst b;
+};
+
+struct trace {
+	struct task tasks[MAX_TASKS];
+	int nr_tasks;
+	char groups[MAX_GROUPS][16];
+	int nr_groups;
+	struct activation *acts;
+	size_t nr_acts, cap;
+};
+
+struct result {
+	__u64 runs[MAX_GROUPS], late[MAX_GROUPS];
+	__u64 predicted, predicted_late, late_learned, boosted;
+};
+
+static void add_activation(struct trace *t, __u64 time_ns, int task, __u64 burst_ns)
+{
+	if (t->nr_acts == t->cap) {
+		t->cap = t->cap ? t->cap * 2 : 4096;
+		t->acts = realloc(t->acts, t->cap * sizeof(*t->acts));
+		if (!t->acts)
+			exit(1);
+	}
+	t->acts[t->nr_acts++] = (struct activation){ time_ns, task, burst_ns };
+}
+
+static int group_of(struct trace *t, const char *name)
+{
+	for (int i = 0; i < t->nr_groups; i++)
+		if (strcmp(t->groups[i], name) == 0)
+			return i;
+	if (t->nr_groups == MAX_GROUPS)
+		return -1;
+	snprintf(t->groups[t->nr_groups], sizeof(t->groups[0]), "%s", name);
+	return t->nr_groups++;
+}
+
+static int add_task(struct trace *t, const char *group, __u32 cls, __u64 budget_ms,
+		    __u32 importance)
+{
+	struct task *k = &t->tasks[t->nr_tasks];
+
+	if (t->nr_tasks == MAX_TASKS || (k->group = group_of(t, group)) < 0)
+		return -1;
+	k->cls = cls;
+	k->window_ns = budget_ms * MS * (101 - importance) / 100;
+	return t->nr_tasks++;
+}
+
+static int read_trace(struct trace *t, const char *path)
+{
+	char line[256], group[32], cls[32];
+	unsigned long long a, b, c;
+	unsigned int id, imp;
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		char *hash = strchr(line, '#');
+
+		if (hash)
+			*hash = '\0';
+		if (sscanf(line, "task %u %31s %31s %llu %u", &id, group, cls, &a, &imp) == 5) {
+			__u32 k;
+
+			for (k = 0; k < NR_SLO_CLASSES; k++)
+				if (strcmp(cls, class_names[k]) == 0)
+					break;
+			if (id != (unsigned int)t->nr_tasks || k == NR_SLO_CLASSES ||
+			    imp < MIN_IMPORTANCE || imp > MAX_IMPORTANCE ||
+			    add_task(t, group, k, a, imp) < 0)
+				goto bad;
+		} else if (sscanf(line, "%llu %llu %llu", &a, &b, &c) == 3) {
+			if (b >= (unsigned long long)t->nr_tasks ||
+			    (t->nr_acts && a * US < t->acts[t->nr_acts - 1].time_ns))
+				goto bad;
+			add_activation(t, a * US, b, c * US);
+		} else if (strspn(line, " \t\r\n") != strlen(line)) {
+			goto bad;
+		}
+	}
+	fclose(f);
+	return 0;
+bad:
+	fprintf(stderr, "Bad trace line: %s", line);
+	fclose(f);
+	return -1;
+}
+
+static double exp_rand(unsigned int *seed, double mean)
+{
+	return -mean * log(1.0 - (double)rand_r(seed) / ((double)RAND_MAX + 1));
+}
+
+static int cmp_activation(const void *a, const void *b)
+{
+	const struct activation *x = a, *y = b;
+
+	return x->time_ns < y->time_ns ? -1 : x->time_ns > y->time_ns;
+}
+
+/*
+ * Request threads: 0.3ms bursts every 4ms. Workers: 4ms bursts every
+ * 16ms, with the same SLO. Batch: 100ms bursts every 110ms. All three
+ * exponentially distributed.
+ */
+static void gen_trace(struct trace *t, __u64 duration_ns)
+{
+	static const struct {
+		const char *group;
+		__u32 cls, budget_ms, importance, nr;
+		double burst_us, period_us;
+	} kinds[] = {
+		{ "request", SLO_CLASS_STANDARD, 20, 50, 12, 300, 4000 },
+		{ "worker", SLO_CLASS_STANDARD, 20, 50, 5, 4000, 16000 },
+		{ "batch", SLO_CLASS_BATCH, 100, 10, 2, 100000, 110000 },
+	};
+	unsigned int seed = 1;
+
+	for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+		for (__u32 i = 0; i < kinds[k].nr; i++) {
+			int id = add_task(t, kinds[k].group, kinds[k].cls, kinds[k].budget_ms,
+					  kinds[k].importance);
+			double at = exp_rand(&seed, kinds[k].period_us);
+
+			while (at * US < duration_ns) {
+				__u64 burst = exp_rand(&seed, kinds[k].burst_us) * US;
+
+				add_activation(t, (__u64)(at * US), id, burst > TICK_NS ? burst : TICK_NS);
+				at += exp_rand(&seed, kinds[k].period_us);
+			}
+		}
+	}
+	qsort(t->acts, t->nr_acts, sizeof(*t->acts), cmp_activation);
+}
+
+static void enqueue(struct task *k, const struct burst_params *p, bool learn, __u64 now,
+		    struct result *r)
+{
+	k->state = QUEUED;
+	k->deadline = now + k->window_ns;
+	k->vtime = learn ? burst_vtime(p, &k->b, k->deadline, k->window_ns) : k->deadline;
+	if (k->vtime != k->deadline)
+		r->boosted++;
+}
+
+static void wake(struct task *k, __u64 burst_ns, const struct burst_params *p, bool learn,
+		 __u64 now, struct result *r)
+{
+	k->left_ns = burst_ns;
+	enqueue(k, p, learn, now, r);
+}
+
+/* A run of @k ends at @now; judged like simple_stopping */
+static void stop(struct task *k, const struct burst_params *p, __u64 now, bool runnable,
+		 struct result *r)
+{
+	bool late = now > k->deadline;
+
+	r->runs[k->group]++;
+	r->late[k->group] += late;
+	if (k->b.predicted) {
+		r->predicted++;
+		r->predicted_late += late;
+	}
+	if (burst_learned(p, &k->b))
+		r->late_learned += late;
+	k->b.predicted = 0;
+	burst_stopping(p, &k->b, now, runnable);
+}
+
+static void simulate(const struct trace *tr, bool learn, const struct burst_params *p,
+		     __u64 end, struct result *r)
+{
+	struct task tasks[MAX_TASKS];
+	struct task *running[CPUS] = {};
+	size_t next = 0;
+
+	memcpy(tasks, tr->tasks, sizeof(tasks));
+	memset(r, 0, sizeof(*r));
+
+	for (__u64 now = 0; now < end; now += TICK_NS) {
+		/* Activations due: wake the task, or queue work behind the current one */
+		for (; next < tr->nr_acts && tr->acts[next].time_ns <= now; next++) {
+			struct task *k = &tasks[tr->acts[next].task];
+
+			if (k->state == SLEEPING)
+				wake(k, tr->acts[next].burst_ns, p, learn, now, r);
+			else
+				k->backlog_ns += tr->acts[next].burst_ns;
+		}
+
+		for (int c = 0; c < CPUS; c++) {
+			struct task *k = running[c];
+
+			if (!k) {
+				for (int i = 0; i < tr->nr_tasks; i++)
+					if (tasks[i].state == QUEUED &&
+					    (!k || tasks[i].vtime < k->vtime))
+						k = &tasks[i];
+				if (!k)
+					continue;
+				k->state = RUNNING;
+				k->slice_left = learn ? burst_slice(p, &k->b, class_slice[k->cls])
+						      : class_slice[k->cls];
+				burst_running(&k->b, now);
+				k->b.predicted = burst_predict(p, &k->b,
+							       k->deadline > now ? k->deadline - now : 0);
+				running[c] = k;
+			}
+
+			k->left_ns = k->left_ns > TICK_NS ? k->left_ns - TICK_NS : 0;
+			k->slice_left = k->slice_left > TICK_NS ? k->slice_left - TICK_NS : 0;
+			if (k->left_ns && k->slice_left)
+				continue;
+
+			running[c] = NULL;
+			if (k->left_ns) {
+				/* Slice used up: back in the queue with a new deadline */
+				stop(k, p, now + TICK_NS, true, r);
+				enqueue(k, p, learn, now + TICK_NS, r);
+			} else {
+				stop(k, p, now + TICK_NS, false, r);
+				k->state = SLEEPING;
+				if (k->backlog_ns) {
+					wake(k, k->backlog_ns, p, learn, now + TICK_NS, r);
+					k->backlog_ns = 0;
+				}
+			}
+		}
+	}
+}
+
+static void report(const struct trace *tr, const char *name, const struct result *r)
+{
+	__u64 runs = 0, late = 0;
+
+	printf("  %-8s", name);
+	for (int g = 0; g < tr->nr_groups; g++) {
+		printf("  %8.2f%%", r->runs[g] ? 100.0 * r->late[g] / r->runs[g] : 0);
+		runs += r->runs[g];
+		late += r->late[g];
+	}
+	printf("  %8.2f%%  %9.1f%%  %6.1f%%  %9llu\n", runs ? 100.0 * late / runs : 0,
+	       r->predicted ? 100.0 * r->predicted_late / r->predicted : 0,
+	       r->late_learned ? 100.0 * r->predicted_late / r->late_learned : 0,
+	       (unsigned long long)r->boosted);
+}
+
+int main(int argc, char **argv)
+{
+	static struct trace tr;
+	struct burst_params p;
+	struct result r;
+	__u64 end;
+
+	burst_params_default(&p);
+	end = (argc > 2 ? strtoull(argv[2], NULL, 10) : 20) * SEC;
+	if (argc > 1 && strcmp(argv[1], "-") != 0) {
+		if (read_trace(&tr, argv[1]) != 0) {
+			fprintf(stderr, "Cannot read trace %s\n", argv[1]);
+			return 1;
+		}
+	} else {
+		gen_trace(&tr, end);
+	}
+
+	printf("%d CPUs, %d tasks, %zu activations over %llus\n", CPUS, tr.nr_tasks, tr.nr_acts,
+	       (unsigned long long)(end / SEC));
+	printf("  %-8s", "policy");
+	for (int g = 0; g < tr.nr_groups; g++)
+		printf("  %9s", tr.groups[g]);
+	printf("  %9s  %10s  %7s  %9s\n", "all", "precision", "recall", "boosted");
+
+	simulate(&tr, false, &p, end, &r);
+	report(&tr, "fixed", &r);
+	simulate(&tr, true, &p, end, &r);
+	report(&tr, "learned", &r);
+
+	free(tr.acts);
+	return 0;
+}
@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Benchmark: resolving config cgroup paths to IDs
+ *
+ * Builds a synthetic 10k-cgroup tree (kubepods/<qos>/pod<N>/ctr<M>) in a
+ * scratch directory and compares the per-entry realpath/open/
+ * name_to_handle_at/close sequence the config loader used to run with the
+ * bulk resolver, single-threaded and with a worker pool.
+ *
+ * Usage: bench_cgroup_resolve [ENTRIES] [ROOT]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../src/cgroup_resolve.h"
+
+#define CTRS_PER_POD 10
+#define ROUNDS 5
+
+static const char *qos_classes[] = { "burstable", "besteffort", "guaranteed" };
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void make_dir(const char *root, const char *rel)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s%s", root, rel);
+	if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "mkdir %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+}
+
+/* Create the tree and return the @n leaf paths, interleaved across pods */
+static char **build_tree(const char *root, size_t n)
+{
+	size_t pods = (n + CTRS_PER_POD - 1) / CTRS_PER_POD;
+	char **paths = calloc(n, sizeof(*paths));
+	char rel[128];
+
+	if (!paths)
+		exit(1);
+
+	make_dir(root, "/kubepods");
+	for (size_t q = 0; q < 3; q++) {
+		snprintf(rel, sizeof(rel), "/kubepods/%s", qos_classes[q]);
+		make_dir(root, rel);
+	}
+
+	for (size_t p = 0; p < pods; p++) {
+		snprintf(rel, sizeof(rel), "/kubepods/%s/pod%05zu", qos_classes[p % 3], p);
+		make_dir(root, rel);
+		for (size_t c = 0; c < CTRS_PER_POD; c++) {
+			snprintf(rel, sizeof(rel), "/kubepods/%s/pod%05zu/ctr%02zu",
+				 qos_classes[p % 3], p, c);
+			make_dir(root, rel);
+		}
+	}
+
+	/* Config order rarely matches tree order */
+	for (size_t i = 0; i < n; i++) {
+		size_t p = i % pods, c = (i / pods) % CTRS_PER_POD;
+
+		snprintf(rel, sizeof(rel), "/kubepods/%s/pod%05zu/ctr%02zu",
+			 qos_classes[p % 3], p, c);
+		paths[i] = strdup(rel);
+	}
+	return paths;
+}
+
+/* The old per-entry sequence from load_slo_config() */
+static __u64 legacy_resolve(const char *root, const char *path)
+{
+	char full_path[PATH_MAX], resolved[PATH_MAX];
+	struct {
+		struct file_handle handle;
+		unsigned char buf[128];
+	} fh;
+	int fd, mount_id;
+	__u64 id = 0;
+
+	snprintf(full_path, sizeof(full_path), "%s%s", root, path);
+	if (!realpath(full_path, resolved))
+		return 0;
+	fd = open(resolved, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+	if (fd < 0)
+		return 0;
+	fh.handle.handle_bytes = 128;
+	if (name_to_handle_at(fd, "", &fh.handle, &mount_id, AT_EMPTY_PATH) == 0)
+		memcpy(&id, fh.handle.f_handle, sizeof(id));
+	close(fd);
+	return id;
+}
+
+int main(int argc, char **argv)
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	char tmp_root[] = "/tmp/scx_slo_bench.XXXXXX";
+	const char *root = argc > 2 ? argv[2] : NULL;
+	__u64 *ids = calloc(n, sizeof(*ids));
+	double best_legacy = 1e18, best_bulk1 = 1e18, best_bulk = 1e18;
+	size_t resolved = 0;
+
+	if (!ids)
+		return 1;
+	if (!root) {
+		if (!mkdtemp(tmp_root)) {
+			perror("mkdtemp");
+			return 1;
+		}
+		root = tmp_root;
+	}
+
+	printf("Building %zu-cgroup tree under %s...\n", n, root);
+	char **paths = build_tree(root, n);
+
+	struct cgroup_resolver *r = cgroup_resolver_new(root);
+	if (!r) {
+		perror("cgroup_resolver_new");
+		return 1;
+	}
+
+	for (int round = 0; round < ROUNDS; round++) {
+		double t0 = now_ms();
+		size_t ok = 0;
+
+		for (size_t i = 0; i < n; i++)
+			ok += legacy_resolve(root, paths[i]) != 0;
+		double t1 = now_ms();
+		if (t1 - t0 < best_legacy)
+			best_legacy = t1 - t0;
+		if (ok != n)
+			fprintf(stderr, "legacy: only %zu/%zu resolved\n", ok, n);
+
+		t0 = now_ms();
+		cgroup_resolve_bulk(r, (const char *const *)paths, ids, NULL, n, 1);
+		t1 = now_ms();
+		if (t1 - t0 < best_bulk1)
+			best_bulk1 = t1 - t0;
+
+		t0 = now_ms();
+		resolved = cgroup_resolve_bulk(r, (const char *const *)paths, ids, NULL, n, 0);
+		t1 = now_ms();
+		if (t1 - t0 < best_bulk)
+			best_bulk = t1 - t0;
+	}
+
+	printf("Resolved %zu/%zu paths (best of %d rounds, %ld CPUs)\n",
+	       resolved, n, ROUNDS, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("  %-28s %9.2f ms  %6.2f us/entry\n", "per-entry realpath+open:",
+	       best_legacy, best_legacy * 1000.0 / n);
+	printf("  %-28s %9.2f ms  %6.2f us/entry  (%.1fx)\n", "bulk, 1 thread:",
+	       best_bulk1, best_bulk1 * 1000.0 / n, best_legacy / best_bulk1);
+	printf("  %-28s %9.2f ms  %6.2f us/entry  (%.1fx)\n", "bulk, worker pool:",
+	       best_bulk, best_bulk * 1000.0 / n, best_legacy / best_bulk);
+
+	cgroup_resolver_free(r);
+	for (size_t i = 0; i < n; i++)
+		free(paths[i]);
+	free(paths);
+	free(ids);
+
+	if (root == tmp_root) {
+		char cmd[64 + sizeof(tmp_root)];
+
+		snprintf(cmd, sizeof(cmd), "rm -rf '%s'", tmp_root);
+		if (system(cmd) != 0)
+			fprintf(stderr, "Failed to remove %s\n", tmp_root);
+	}
+	return resolved == n ? 0 : 1;
+}
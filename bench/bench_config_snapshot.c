@@ -0,0 +1,292 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Benchmark: cold config load from text versus a compiled snapshot
+ *
+ * Builds a synthetic cgroup tree (kubepods/<qos>/pod<N>/ctr<M>) with one
+ * config line per leaf, compiles it into a snapshot, and times the two
+ * ways the agent's first load gets its rules and cgroup IDs:
+ *
+ *   text:     read + parse + validate every line, bulk-resolve every path
+ *   snapshot: mmap + checksum, validate, confirm every recorded ID with
+ *             one stat
+ *
+ * Both paths then publish the same single batched map update, which is
+ * not part of the measurement. Each round drops the dentry cache first if
+ * run as root, otherwise the numbers are warm-cache.
+ *
+ * On a scratch tree the recorded IDs are inode numbers, as on cgroupfs.
+ *
+ * Usage: bench_config_snapshot [ENTRIES] [ROOT]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../src/cgroup_resolve.h"
+#include "../src/config_snapshot.h"
+
+#define CTRS_PER_POD 10
+#define ROUNDS 5
+
+static const char *qos_classes[] = { "burstable", "besteffort", "guaranteed" };
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void make_dir(const char *root, const char *rel)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s%s", root, rel);
+	if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "mkdir %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+}
+
+/* Create the tree and return the @n leaf paths, interleaved across pods */
+static char **build_tree(const char *root, size_t n)
+{
+	size_t pods = (n + CTRS_PER_POD - 1) / CTRS_PER_POD;
+	char **paths = calloc(n, sizeof(*paths));
+	char rel[128];
+
+	if (!paths)
+		exit(1);
+
+	make_dir(root, "/kubepods");
+	for (size_t q = 0; q < 3; q++) {
+		snprintf(rel, sizeof(rel), "/kubepods/%s", qos_classes[q]);
+		make_dir(root, rel);
+	}
+
+	for (size_t p = 0; p < pods; p++) {
+		snprintf(rel, sizeof(rel), "/kubepods/%s/pod%05zu", qos_classes[p % 3], p);
+		make_dir(root, rel);
+		for (size_t c = 0; c < CTRS_PER_POD; c++) {
+			snprintf(rel, sizeof(rel), "/kubepods/%s/pod%05zu/ctr%02zu",
+				 qos_classes[p % 3], p, c);
+			make_dir(root, rel);
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		size_t p = i % pods, c = (i / pods) % CTRS_PER_POD;
+
+		snprintf(rel, sizeof(rel), "/kubepods/%s/pod%05zu/ctr%02zu",
+			 qos_classes[p % 3], p, c);
+		paths[i] = strdup(rel);
+	}
+	return paths;
+}
+
+static void drop_caches(void)
+{
+	int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+
+	if (fd < 0)
+		return;
+	sync();
+	if (write(fd, "2", 1) != 1)
+		fprintf(stderr, "drop_caches: %s\n", strerror(errno));
+	close(fd);
+}
+
+/* Character and range checks of the config loader, line by line */
+static bool valid_line(const char *path, unsigned long long budget_ms, unsigned int importance)
+{
+	if (path[0] != '/' || strstr(path, ".."))
+		return false;
+	for (const char *c = path; *c; c++)
+		if (!((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') ||
+		      (*c >= '0' && *c <= '9') || *c == '/' || *c == '-' ||
+		      *c == '_' || *c == '.'))
+			return false;
+	return budget_ms >= 1 && budget_ms <= 10000 && importance >= 1 && importance <= 100;
+}
+
+/* Text path: returns the number of rules with an ID */
+static size_t load_text(struct cgroup_resolver *r, const char *config, size_t n,
+			char **paths, __u64 *ids)
+{
+	char line[256];
+	unsigned long long budget;
+	unsigned int importance;
+	size_t nr = 0, resolved;
+	FILE *f = fopen(config, "r");
+
+	if (!f)
+		return 0;
+	while (nr < n && fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%511s %llu %u", paths[nr], &budget, &importance) != 3 ||
+		    !valid_line(paths[nr], budget, importance))
+			continue;
+		nr++;
+	}
+	fclose(f);
+
+	resolved = cgroup_resolve_bulk(r, (const char *const *)paths, ids, NULL, nr, 0);
+	return resolved;
+}
+
+/* Snapshot path: returns the number of rules with a confirmed ID */
+static size_t load_snapshot(int root_fd, const char *config, const char *snap_path, __u64 *ids)
+{
+	struct slo_snapshot_source src;
+	struct slo_snapshot snap;
+	size_t confirmed;
+
+	if (slo_snapshot_source_of(config, &src) != 0 ||
+	    slo_snapshot_open(&snap, snap_path, &src) != 0)
+		return 0;
+	confirmed = slo_snapshot_verify(&snap, root_fd, ids);
+	/* The agent re-validates snapshot rules like text lines */
+	for (__u32 i = 0; i < snap.nr_rules; i++)
+		if (!valid_line(slo_snapshot_path(&snap, i),
+				snap.rules[i].cfg.budget_ns / 1000000ULL, snap.rules[i].cfg.importance))
+			confirmed--;
+	slo_snapshot_close(&snap);
+	return confirmed;
+}
+
+int main(int argc, char **argv)
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	char tmp_root[] = "/tmp/scx_slo_bench.XXXXXX";
+	char tmp_dir[] = "/tmp/scx_slo_snapbench.XXXXXX";
+	char config[PATH_MAX], snap_path[PATH_MAX], full[PATH_MAX];
+	const char *root = argc > 2 ? argv[2] : NULL;
+	double best_text = 1e18, best_snap = 1e18;
+	size_t text_ok = 0, snap_ok = 0;
+	struct slo_snapshot_source src;
+	struct slo_snapshot_rule *rules;
+	char **text_paths;
+	__u64 *ids;
+	struct stat st;
+	FILE *f;
+
+	if (!root) {
+		if (!mkdtemp(tmp_root)) {
+			perror("mkdtemp");
+			return 1;
+		}
+		root = tmp_root;
+	}
+	if (!mkdtemp(tmp_dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	snprintf(config, sizeof(config), "%s/config", tmp_dir);
+	snprintf(snap_path, sizeof(snap_path), "%s/config.snap", tmp_dir);
+
+	printf("Building %zu-cgroup tree under %s...\n", n, root);
+	char **paths = build_tree(root, n);
+
+	rules = calloc(n, sizeof(*rules));
+	ids = calloc(n, sizeof(*ids));
+	text_paths = calloc(n, sizeof(*text_paths));
+	if (!rules || !ids || !text_paths)
+		return 1;
+	for (size_t i = 0; i < n; i++) {
+		text_paths[i] = malloc(512);
+		if (!text_paths[i])
+			return 1;
+	}
+
+	f = fopen(config, "w");
+	if (!f) {
+		perror(config);
+		return 1;
+	}
+	fprintf(f, "# Generated by bench_config_snapshot\n");
+	for (size_t i = 0; i < n; i++)
+		fprintf(f, "%s %zu %zu\n", paths[i], 10 + i % 500, 1 + i % 100);
+	fclose(f);
+
+	/* Compile: what --compile-config does once, ahead of startup */
+	double t0 = now_ms();
+	for (size_t i = 0; i < n; i++) {
+		snprintf(full, sizeof(full), "%s%s", root, paths[i]);
+		if (stat(full, &st) != 0)
+			return 1;
+		rules[i].cgroup_id = st.st_ino;
+		rules[i].cfg.budget_ns = (10 + i % 500) * 1000000ULL;
+		rules[i].cfg.importance = 1 + i % 100;
+		rules[i].line_num = i + 2;
+	}
+	if (slo_snapshot_source_of(config, &src) != 0 ||
+	    slo_snapshot_write(snap_path, &src, rules, (const char *const *)paths, n) != 0) {
+		fprintf(stderr, "Failed to write snapshot\n");
+		return 1;
+	}
+	double compile_ms = now_ms() - t0;
+	stat(snap_path, &st);
+
+	struct cgroup_resolver *r = cgroup_resolver_new(root);
+	int root_fd = open(root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+
+	if (!r || root_fd < 0) {
+		perror(root);
+		return 1;
+	}
+
+	for (int round = 0; round < ROUNDS; round++) {
+		drop_caches();
+		t0 = now_ms();
+		text_ok = load_text(r, config, n, text_paths, ids);
+		double t1 = now_ms();
+		if (t1 - t0 < best_text)
+			best_text = t1 - t0;
+
+		drop_caches();
+		t0 = now_ms();
+		snap_ok = load_snapshot(root_fd, config, snap_path, ids);
+		t1 = now_ms();
+		if (t1 - t0 < best_snap)
+			best_snap = t1 - t0;
+	}
+
+	printf("Loaded %zu entries (best of %d rounds), snapshot %lld bytes, compiled in %.2f ms\n",
+	       n, ROUNDS, (long long)st.st_size, compile_ms);
+	printf("  %-32s %9.2f ms  %6.2f us/entry  %zu resolved\n", "text parse + bulk resolve:",
+	       best_text, best_text * 1000.0 / n, text_ok);
+	printf("  %-32s %9.2f ms  %6.2f us/entry  %zu confirmed  (%.1fx)\n",
+	       "snapshot mmap + verify:", best_snap, best_snap * 1000.0 / n, snap_ok,
+	       best_text / best_snap);
+
+	cgroup_resolver_free(r);
+	close(root_fd);
+	for (size_t i = 0; i < n; i++) {
+		free(paths[i]);
+		free(text_paths[i]);
+	}
+	free(paths);
+	free(text_paths);
+	free(rules);
+	free(ids);
+	unlink(config);
+	unlink(snap_path);
+	rmdir(tmp_dir);
+
+	if (root == tmp_root) {
+		char cmd[64 + sizeof(tmp_root)];
+
+		snprintf(cmd, sizeof(cmd), "rm -rf '%s'", tmp_root);
+		if (system(cmd) != 0)
+			fprintf(stderr, "Failed to remove %s\n", tmp_root);
+	}
+	return text_ok == n && snap_ok == n ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Benchmark: SLO updates per second through the control socket
+ *
+ * Runs the control socket server in-process against an in-memory map
+ * whose apply callback costs a fixed time per call, standing in for the
+ * batched BPF syscalls and the generation bump the agent makes. Compares:
+ *
+ *   direct:     one map write per entry, as the watcher did when it wrote
+ *               the pinned map itself
+ *   sync:       one client, one entry per request, waiting for each reply
+ *   batch:      one client, all entries in one pipelined apply
+ *   concurrent: CLIENTS clients, one entry per request each
+ *
+ * and reports updates/s and how many entries each map write carried.
+ *
+ * Usage: bench_ctl_updates [UPDATES] [WRITE_COST_US]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "../src/ctl_server.h"
+#include "../src/ctl_client.h"
+
+#define CLIENTS 4
+
+static __u64 write_cost_ns = 5000;
+static char sock_path[64];
+static size_t nr_updates;
+
+static __u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Busy-wait like a syscall would, rather than sleep with its slack */
+static void map_write(void)
+{
+	__u64 end = now_ns() + write_cost_ns;
+
+	while (now_ns() < end)
+		;
+}
+
+static int bench_apply(const __u64 *set_keys, const struct slo_cfg *set_vals, size_t nr_set,
+		       const __u64 *del_keys, size_t nr_del, bool *shadowed, void *ctx)
+{
+	(void)set_keys; (void)set_vals; (void)nr_set;
+	(void)del_keys; (void)nr_del; (void)shadowed; (void)ctx;
+	map_write();
+	return 0;
+}
+
+static void bench_query(struct slo_ctl_state *st, void *ctx)
+{
+	(void)st; (void)ctx;
+}
+
+static struct slo_ctl_entry entry(__u64 id)
+{
+	return (struct slo_ctl_entry){
+		.cgroup_id = id,
+		.cfg = { .budget_ns = 10000000, .importance = 50 },
+		.op = SLO_CTL_OP_SET,
+	};
+}
+
+static void report(const char *name, __u64 ns, size_t updates, const struct ctl_stats *st)
+{
+	printf("  %-11s %9.0f updates/s  %8zu map writes  %7.1f entries/write\n",
+	       name, updates / (ns / 1e9), st ? (size_t)st->batches : updates,
+	       st && st->batches ? (double)st->entries / st->batches : 1.0);
+}
+
+static void *sync_client(void *arg)
+{
+	size_t n = (size_t)arg;
+	struct ctl_client_conn c;
+
+	if (ctl_client_connect(&c, sock_path) != 0)
+		exit(1);
+	for (size_t i = 0; i < n; i++) {
+		struct slo_ctl_entry e = entry(i + 1);
+
+		if (ctl_client_apply(&c, &e, 1, NULL) != 0)
+			exit(1);
+	}
+	ctl_client_close(&c);
+	return NULL;
+}
+
+static struct ctl_server *start(void)
+{
+	struct ctl_ops ops = { .apply = bench_apply, .query = bench_query };
+	struct ctl_server *s = ctl_server_start(sock_path, &ops);
+
+	if (!s) {
+		fprintf(stderr, "Cannot listen on %s: %s\n", sock_path, strerror(errno));
+		exit(1);
+	}
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	struct ctl_server *s;
+	struct ctl_client_conn c;
+	struct ctl_stats st;
+	struct slo_ctl_entry *entries;
+	pthread_t threads[CLIENTS];
+	__u64 t0;
+
+	nr_updates = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	if (argc > 2)
+		write_cost_ns = strtoull(argv[2], NULL, 10) * 1000;
+	snprintf(sock_path, sizeof(sock_path), "/tmp/scx-slo-bench-%d/ctl.sock", getpid());
+
+	entries = calloc(nr_updates, sizeof(*entries));
+	if (!entries)
+		return 1;
+	for (size_t i = 0; i < nr_updates; i++)
+		entries[i] = entry(i + 1);
+
+	printf("%zu updates, %llu us per map write\n", nr_updates,
+	       (unsigned long long)write_cost_ns / 1000);
+
+	t0 = now_ns();
+	for (size_t i = 0; i < nr_updates; i++)
+		map_write();
+	report("direct", now_ns() - t0, nr_updates, NULL);
+
+	s = start();
+	t0 = now_ns();
+	sync_client((void *)nr_updates);
+	ctl_server_get_stats(s, &st);
+	report("sync", now_ns() - t0, nr_updates, &st);
+	ctl_server_stop(s);
+
+	s = start();
+	if (ctl_client_connect(&c, sock_path) != 0)
+		return 1;
+	t0 = now_ns();
+	if (ctl_client_apply(&c, entries, nr_updates, NULL) != 0)
+		return 1;
+	ctl_server_get_stats(s, &st);
+	report("batch", now_ns() - t0, nr_updates, &st);
+	ctl_client_close(&c);
+	ctl_server_stop(s);
+
+	s = start();
+	t0 = now_ns();
+	for (int i = 0; i < CLIENTS; i++)
+		pthread_create(&threads[i], NULL, sync_client, (void *)(nr_updates / CLIENTS));
+	for (int i = 0; i < CLIENTS; i++)
+		pthread_join(threads[i], NULL);
+	ctl_server_get_stats(s, &st);
+	report("concurrent", now_ns() - t0, nr_updates / CLIENTS * CLIENTS, &st);
+	ctl_server_stop(s);
+
+	*strrchr(sock_path, '/') = '\0';
+	rmdir(sock_path);
+	free(entries);
+	return 0;
+}
@@ -0,0 +1,248 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Benchmark: deadline misses of important cgroups next to batch work
+ *
+ * Simulates a node of CPUS CPUs in steps of TICK_NS. BATCH batch tasks are
+ * always runnable and hold a CPU for 40ms slices; up to CRIT tasks of one
+ * important cgroup sleep about CRIT_PERIOD_NS between short runs with a
+ * tight deadline window. Nothing is preempted, so an important task
+ * that finds every CPU taken waits for the next slice to end. The number
+ * of important tasks is low, then high, then low again. Compares:
+ *
+ *   none:    no reserved CPUs
+ *   static:  STATIC_CPUS CPUs reserved throughout
+ *   dynamic: the partition sized once per simulated second by reserve_ctl
+ *
+ * and reports the miss ratio of the important cgroup in each phase, the
+ * CPUs batch work got and the mean partition size.
+ *
+ * Usage: bench_reserve [SECONDS_PER_PHASE] [SEED]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/reserve_ctl.h"
+
+#define CPUS        8
+#define BATCH       16
+#define CRIT        24
+#define PHASES      3
+#define STATIC_CPUS 2
+#define TICK_NS     10000ULL
+#define MS          1000000ULL
+#define SEC         1000000000ULL
+
+#define BATCH_SLICE_NS (40 * MS)
+#define CRIT_RUN_NS    (200 * 1000ULL)
+#define CRIT_PERIOD_NS (1 * MS)
+
+/* Important tasks that wake, per phase */
+static const int crit_active[PHASES] = { 4, CRIT, 4 };
+
+enum mode { MODE_NONE, MODE_STATIC, MODE_DYNAMIC };
+
+struct task {
+	bool crit;
+	bool queued;
+	__u64 wake_ns;      /* Next wakeup, for important tasks */
+	__u64 deadline_ns;
+	__u64 left_ns;      /* Of the current run */
+};
+
+struct cpu {
+	struct task *curr;
+	bool reserved;
+};
+
+struct sim {
+	struct task tasks[BATCH + CRIT];
+	struct cpu cpus[CPUS];
+	struct slo_cfg cfg[2];          /* Important, batch */
+	struct slo_cgrp_stats st[2];
+	__u64 phase_runs[PHASES], phase_late[PHASES];
+	__u64 batch_ns, reserved_ticks, ticks;
+	unsigned int seed;
+};
+
+/* Uniform in [period / 2, period * 3 / 2) */
+static __u64 jitter(struct sim *s, __u64 period)
+{
+	return period / 2 + (__u64)rand_r(&s->seed) % period;
+}
+
+static double window_ns(const struct slo_cfg *cfg)
+{
+	return (double)cfg->budget_ns * (101 - cfg->importance) / 100;
+}
+
+/*
+ * The task a CPU takes next: important work first, earliest deadline
+ * first, as from the reserved queue; batch only on CPUs not reserved.
+ */
+static struct task *pick(struct sim *s, const struct cpu *c)
+{
+	struct task *best = NULL;
+
+	for (int i = BATCH; i < BATCH + CRIT; i++) {
+		struct task *t = &s->tasks[i];
+
+		if (t->queued && (!best || t->deadline_ns < best->deadline_ns))
+			best = t;
+	}
+	if (best || c->reserved)
+		return best;
+	for (int i = 0; i < BATCH; i++)
+		if (s->tasks[i].queued)
+			return &s->tasks[i];
+	return NULL;
+}
+
+static void run_ended(struct sim *s, struct task *t, __u64 now, int phase)
+{
+	struct slo_cgrp_stats *st = &s->st[!t->crit];
+
+	st->runs++;
+	if (now > t->deadline_ns) {
+		st->late++;
+		st->lateness_ns += now - t->deadline_ns;
+	} else {
+		st->slack_ns += t->deadline_ns - now;
+	}
+	if (t->crit) {
+		s->phase_runs[phase]++;
+		s->phase_late[phase] += now > t->deadline_ns;
+	}
+}
+
+static void reserve(struct sim *s, __u32 size)
+{
+	/* Highest CPUs first; a batch task already running finishes its slice */
+	for (int i = 0; i < CPUS; i++)
+		s->cpus[i].reserved = i >= CPUS - (int)size;
+}
+
+static struct budget_ctl_sample sample(const struct sim *s, int idx)
+{
+	return (struct budget_ctl_sample){
+		.cgroup_id = idx + 1, .cfg = s->cfg[idx], .stats = s->st[idx],
+	};
+}
+
+static void simulate(enum mode mode, __u64 phase_ns, unsigned int seed)
+{
+	static const char *names[] = { "none", "static", "dynamic" };
+	struct reserve_params p;
+	struct reserve_ctl *rc = NULL;
+	struct budget_ctl_sample smp[2];
+	struct sim *s = calloc(1, sizeof(*s));
+	__u64 end = PHASES * phase_ns;
+	__u32 size = 0;
+
+	if (!s)
+		exit(1);
+	s->seed = seed;
+	s->cfg[0] = (struct slo_cfg){ .budget_ns = 10 * MS, .importance = 90 };
+	s->cfg[1] = (struct slo_cfg){ .budget_ns = 100 * MS, .importance = 10,
+				      .flags = SLO_CLASS_BATCH };
+	for (int i = 0; i < BATCH + CRIT; i++) {
+		s->tasks[i].crit = i >= BATCH;
+		s->tasks[i].queued = !s->tasks[i].crit;
+		s->tasks[i].wake_ns = jitter(s, CRIT_PERIOD_NS);
+		s->tasks[i].deadline_ns = (__u64)window_ns(&s->cfg[1]);
+		s->tasks[i].left_ns = s->tasks[i].crit ? 0 : BATCH_SLICE_NS;
+	}
+
+	reserve_params_default(&p);
+	if (mode == MODE_STATIC)
+		reserve(s, size = STATIC_CPUS);
+	if (mode == MODE_DYNAMIC) {
+		rc = reserve_ctl_new(&p, CPUS);
+		smp[0] = sample(s, 0);
+		smp[1] = sample(s, 1);
+		reserve_ctl_step(rc, smp, 2, 0);
+	}
+
+	for (__u64 now = 0; now < end; now += TICK_NS) {
+		int phase = now / phase_ns;
+
+		/* Wakeups of important tasks not already waiting or running */
+		for (int i = BATCH; i < BATCH + crit_active[phase]; i++) {
+			struct task *t = &s->tasks[i];
+
+			if (t->left_ns || now < t->wake_ns)
+				continue;
+			t->queued = true;
+			t->left_ns = CRIT_RUN_NS;
+			t->deadline_ns = now + (__u64)window_ns(&s->cfg[0]);
+		}
+
+		for (int c = 0; c < CPUS; c++) {
+			struct cpu *cpu = &s->cpus[c];
+			struct task *t = cpu->curr;
+
+			if (!t && (t = pick(s, cpu))) {
+				t->queued = false;
+				cpu->curr = t;
+			}
+			if (!t)
+				continue;
+			t->left_ns -= TICK_NS;
+			s->st[!t->crit].runtime_ns += TICK_NS;
+			if (!t->crit)
+				s->batch_ns += TICK_NS;
+			if (t->left_ns)
+				continue;
+			run_ended(s, t, now + TICK_NS, phase);
+			cpu->curr = NULL;
+			if (t->crit) {
+				t->wake_ns = now + TICK_NS + jitter(s, CRIT_PERIOD_NS);
+			} else {
+				t->queued = true;
+				t->left_ns = BATCH_SLICE_NS;
+				t->deadline_ns = now + (__u64)window_ns(&s->cfg[1]);
+			}
+		}
+
+		if (rc && (now + TICK_NS) % SEC == 0) {
+			smp[0] = sample(s, 0);
+			smp[1] = sample(s, 1);
+			size = reserve_ctl_step(rc, smp, 2, SEC);
+			reserve(s, size);
+		}
+		s->reserved_ticks += size;
+		s->ticks++;
+	}
+
+	printf("  %-8s", names[mode]);
+	for (int i = 0; i < PHASES; i++)
+		printf("  %6.2f%%", s->phase_runs[i] ?
+		       100.0 * s->phase_late[i] / s->phase_runs[i] : 0);
+	printf("  %10.2f  %9.2f\n", (double)s->batch_ns / end,
+	       (double)s->reserved_ticks / s->ticks);
+
+	reserve_ctl_free(rc);
+	free(s);
+}
+
+int main(int argc, char **argv)
+{
+	__u64 phase_ns = (argc > 1 ? strtoull(argv[1], NULL, 10) : 10) * SEC;
+	unsigned int seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+	if (!phase_ns)
+		return 1;
+	printf("%d CPUs, %d batch tasks (%llums slices), %d/%d/%d important tasks "
+	       "(%lluus runs, %llums sleeps, %.1fms window), %llus per phase\n",
+	       CPUS, BATCH, (unsigned long long)(BATCH_SLICE_NS / MS),
+	       crit_active[0], crit_active[1], crit_active[2],
+	       (unsigned long long)(CRIT_RUN_NS / 1000),
+	       (unsigned long long)(CRIT_PERIOD_NS / MS),
+	       10 * (101 - 90) / 100.0, (unsigned long long)(phase_ns / SEC));
+	printf("  %-8s  %7s  %7s  %7s  %10s  %9s\n", "mode", "light", "heavy", "light",
+	       "batch CPUs", "reserved");
+	simulate(MODE_NONE, phase_ns, seed);
+	simulate(MODE_STATIC, phase_ns, seed);
+	simulate(MODE_DYNAMIC, phase_ns, seed);
+	return 0;
+}
@@ -7,13 +7,7 @@
 #ifndef __SCX_SLO_H
 #define __SCX_SLO_H
 
-#ifdef __KERNEL__
 #include <linux/types.h>
-#else
-#include <stdint.h>
-typedef uint64_t __u64;
-typedef uint32_t __u32;
-#endif
 
 /* SLO configuration per cgroup */
 struct slo_cfg {
@@ -28,6 +22,106 @@ struct slo_task_ctx {
 	__u64 start_time;     /* When task started running (for miss detection) */
 	__u64 budget_ns;      /* Task's allocated budget */
 	__u32 valid;          /* Whether this context is initialized */
+	__u32 slo_class;      /* Latency class of the task's cgroup */
+};
+
+/*
+ * Run statistics of one SLO map entry, keyed like the SLO map by the ID
+ * of the cgroup the SLO was configured on. A run lasts from an enqueue to
+ * the next time the task stops running; it is late if it stops after its
+ * deadline, or after its slo_target if there is one. Counters only grow.
+ */
+struct slo_cgrp_stats {
+	__u64 runs;           /* Runs ended */
+	__u64 late;           /* Runs that ended past their deadline */
+	__u64 lateness_ns;    /* Time past the deadline, summed over late runs */
+	__u64 slack_ns;       /* Time left before the deadline, over the other runs */
+	__u64 runtime_ns;     /* CPU time of all runs */
+};
+
+/*
+ * Deadline an adjusted SLO map entry stands for. While the entry holds
+ * @cfg, runs of the cgroup are counted late against @window_ns from their
+ * enqueue instead of against the deadline @cfg gives them.
+ */
+struct slo_target {
+	struct slo_cfg cfg;
+	__u64 window_ns;
+};
+
+/*
+ * Scheduler-wide health counters, summed over CPUs by the agent for the
+ * circuit breaker. Queueing delay runs from enqueue to running.
+ */
+struct slo_health {
+	__u64 runs;           /* Runs ended */
+	__u64 late;           /* Runs that ended past their deadline */
+	__u64 delay_ns;       /* Queueing delay summed over @delays */
+	__u64 delays;
+};
+
+/*
+ * CPU performance targets set by the scheduler, one per CPU. Targets are
+ * on the scale of SLO_CPUPERF_ONE, the CPU's full speed; 0 means none was
+ * set yet.
+ */
+#define SLO_CPUPERF_ONE 1024  /* SCX_CPUPERF_ONE */
+
+struct slo_cpu_perf {
+	__u32 target;         /* Target the CPU was last set to */
+	__u32 pad;
+	__u64 sets;           /* Changes of the target */
+	__u64 boosts;         /* Runs sped up to full speed for lack of slack */
+	__u64 capped;         /* Runs of batch and best-effort tasks held to the cap */
+};
+
+/*
+ * What the scheduler learned about a task's activations: from the first
+ * run after a wakeup until the task sleeps again. Kept in task storage,
+ * so it survives the task context being dropped while it sleeps.
+ */
+struct slo_task_burst {
+	__u64 burst_ns;       /* EWMA of on-CPU time per activation */
+	__u64 interval_ns;    /* EWMA of time from one activation to the next */
+	__u64 act_start;      /* When the current activation first ran, 0 while asleep */
+	__u64 last_start;     /* When the previous activation first ran */
+	__u64 act_ns;         /* On-CPU time of the current activation so far */
+	__u64 run_start;      /* When the current run started, 0 while off the CPU */
+	__u32 samples;        /* Activations averaged, saturating */
+	__u32 predicted;      /* Whether the current run was predicted to miss */
+};
+
+/* How burst predictions fared, per CPU */
+struct slo_burst_stats {
+	__u64 runs;           /* Runs of tasks with a learned burst, judged at their end */
+	__u64 late;           /* Of those, runs that missed their deadline */
+	__u64 predicted;      /* Runs predicted to miss when they started */
+	__u64 predicted_late; /* Predicted runs that did miss */
+	__u64 boosted;        /* Enqueues moved ahead as short bursts */
+};
+
+/*
+ * Histograms of shadow mode, one per latency class. Buckets are log2 of
+ * microseconds: bucket 0 counts values below 1us, bucket i values in
+ * [2^(i-1), 2^i) us, and the last one everything from 2^(i-1) us up.
+ */
+#define SLO_HIST_BUCKETS 26
+
+struct slo_hist {
+	__u64 count;
+	__u64 sum_ns;
+	__u64 buckets[SLO_HIST_BUCKETS];
+};
+
+/*
+ * What the scheduler would have done, observed under the kernel's own
+ * scheduler. Runs are judged against the deadline simple_enqueue would
+ * have given them.
+ */
+struct slo_shadow_stats {
+	struct slo_hist slack;     /* Time left before the deadline, runs that made it */
+	struct slo_hist lateness;  /* Time past the deadline, runs that missed it */
+	struct slo_hist delay;     /* Time from wakeup or preemption to running */
 };
 
 /* Deadline event structure for ring buffer */
@@ -37,6 +131,18 @@ struct deadline_event {
 	__u64 timestamp;
 };
 
+/*
+ * Scheduler handoff state, shared between agent instances through a pinned
+ * map so an upgrade can measure how long no SLO scheduler was attached.
+ * Timestamps are CLOCK_MONOTONIC (bpf_ktime_get_ns).
+ */
+struct slo_handoff {
+	__u64 detach_ns;      /* When the previous scheduler instance exited */
+	__u64 attach_ns;      /* When the current scheduler instance initialized */
+	__u32 generation;     /* Bumped by each agent taking ownership */
+	__u32 handoffs;       /* Completed handoffs between instances */
+};
+
 /* SLO budget constants with validation bounds */
 #define DEFAULT_BUDGET_NS (100 * 1000000ULL)  /* 100ms default */
 #define MIN_BUDGET_NS     (1 * 1000000ULL)    /* 1ms minimum */
@@ -46,6 +152,27 @@ struct deadline_event {
 #define MIN_IMPORTANCE 1
 #define MAX_IMPORTANCE 100
 
+/*
+ * Latency classes, kept in the low bits of slo_cfg.flags. Zero is the
+ * standard class, so entries written without a class keep their behavior.
+ * Each class sets the slice length, whether the task may preempt or be
+ * preempted, whether it prefers a fully idle core on wakeup, and whether
+ * it may run on reserved CPUs.
+ */
+#define SLO_CLASS_STANDARD   0
+#define SLO_CLASS_CRITICAL   1
+#define SLO_CLASS_BATCH      2
+#define SLO_CLASS_BESTEFFORT 3
+#define NR_SLO_CLASSES       4
+#define SLO_CLASS_MASK       0xfU
+
+/* Bits of slo_cfg.flags with a meaning; the rest must be zero */
+#define SLO_CFG_FLAGS_MASK   SLO_CLASS_MASK
+
+/* Ancestor levels searched for a configured SLO above a task's cgroup */
+#define DEFAULT_INHERIT_DEPTH 4
+#define MAX_INHERIT_DEPTH     16
+
 /* Rate limiting for ring buffer events */
 #define MAX_EVENTS_PER_SEC 1000
 #define RATE_LIMIT_WINDOW_NS (1 * 1000000000ULL)
@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * scx-slo control protocol
+ *
+ * The agent owns every write to the SLO map. Other local components (the
+ * Kubernetes watcher, tools) send it binary messages over a Unix stream
+ * socket instead of writing the pinned maps themselves. All integers are
+ * in host byte order; the socket never leaves the node.
+ *
+ * Every message starts with struct slo_ctl_hdr, followed by @count fixed
+ * size records of the type's record struct. Each request gets exactly one
+ * reply carrying the request's @seq, except SUBSCRIBE, after whose reply
+ * the agent streams SLO_CTL_MISS messages until the client disconnects.
+ */
+#ifndef __SCX_SLO_CTL_H
+#define __SCX_SLO_CTL_H
+
+#include <linux/types.h>
+#include "scx_slo.h"
+
+#define SLO_CTL_SOCK_PATH "/run/scx-slo/ctl.sock"
+#define SLO_CTL_VERSION   1
+
+/* Records per message; larger batches are split by the client */
+#define SLO_CTL_MAX_RECORDS 4096
+
+enum slo_ctl_type {
+	SLO_CTL_APPLY     = 1,  /* slo_ctl_entry records -> one slo_ctl_applied */
+	SLO_CTL_QUERY     = 2,  /* __u64 cgroup IDs -> slo_ctl_state records */
+	SLO_CTL_SUBSCRIBE = 3,  /* No records -> reply, then a miss stream */
+	SLO_CTL_MISS      = 4,  /* Agent to subscriber: slo_ctl_miss records */
+	SLO_CTL_REPLY     = 0x80,
+};
+
+struct slo_ctl_hdr {
+	__u32 len;            /* Bytes including this header */
+	__u16 type;           /* enum slo_ctl_type, or SLO_CTL_REPLY | type */
+	__u16 version;        /* SLO_CTL_VERSION */
+	__u32 seq;            /* Chosen by the client, echoed in the reply */
+	__u32 count;          /* Records following the header */
+	__s32 status;         /* Replies: 0 or -errno */
+	__u32 reserved;       /* Zero */
+};
+
+enum slo_ctl_op {
+	SLO_CTL_OP_SET    = 1,  /* Insert or replace the cgroup's SLO */
+	SLO_CTL_OP_DELETE = 2,  /* Remove the cgroup's SLO */
+};
+
+/* APPLY record; @cfg is validated like a config file rule */
+struct slo_ctl_entry {
+	__u64 cgroup_id;
+	struct slo_cfg cfg;
+	__u32 op;             /* enum slo_ctl_op */
+	__u32 reserved;
+};
+
+/* APPLY reply record, sent once the batch holding the request was written */
+struct slo_ctl_applied {
+	__u32 shadowed;       /* Entries left alone because the cgroup has a config rule */
+	__u32 reserved;
+};
+
+/* QUERY reply record */
+struct slo_ctl_state {
+	__u64 cgroup_id;
+	struct slo_cfg cfg;   /* Valid if present */
+	__u32 present;        /* Whether the SLO map in effect has an entry */
+	__u32 reserved;
+	__u64 deadline_misses;
+	__u64 miss_duration_ns;
+};
+
+/* MISS record, one per deadline miss the scheduler reported */
+struct slo_ctl_miss {
+	__u64 cgroup_id;
+	__u64 deadline_miss_ns;
+	__u64 timestamp;
+};
+
+#endif /* __SCX_SLO_CTL_H */
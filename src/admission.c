@@ -0,0 +1,436 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Admission control for scx-slo
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "admission.h"
+#include "spec_parse.h"
+
+/* Admission state of one SLO map entry */
+struct adm_entry {
+	__u64 cgroup_id;
+	struct slo_cfg base;        /* Configured value */
+	struct slo_cfg eff;         /* Value last handed out for the map */
+	struct slo_cfg prev_eff;    /* Before the last update, in case it never landed */
+	struct slo_cgrp_stats last; /* Counters at the previous step */
+	double util;                /* Smoothed CPUs used */
+	double run_ns;              /* Smoothed CPU time per run */
+	bool measured;              /* @run_ns has been estimated */
+	bool relax;                 /* In the relax plan */
+};
+
+struct admission {
+	pthread_mutex_t lock;
+	struct admission_params p;
+	__u32 cpus;
+	struct adm_entry *entries;  /* Sorted by cgroup_id */
+	size_t nr;
+	struct admission_stats stats;
+};
+
+void admission_params_default(struct admission_params *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->util_max = 0.9;
+	p->relax_max = 4.0;
+	p->hysteresis = 0.05;
+	p->smoothing = 0.3;
+	p->victim_below = 50;
+	p->min_runs = 20;
+	p->interval_sec = 10;
+}
+
+static const struct spec_key admission_keys[] = {
+	SPEC_KEY_CHOICE("mode", struct admission_params, enforce, "dry-run", "relax"),
+	SPEC_KEY_DOUBLE("util_max", struct admission_params, util_max, 0.05, 1),
+	SPEC_KEY_DOUBLE("relax_max", struct admission_params, relax_max, 1, 100),
+	SPEC_KEY_DOUBLE("hysteresis", struct admission_params, hysteresis, 0, 0.5),
+	SPEC_KEY_DOUBLE("smoothing", struct admission_params, smoothing, 0.01, 1),
+	SPEC_KEY_U32("victim_below", struct admission_params, victim_below, MIN_IMPORTANCE, MAX_IMPORTANCE + 1),
+	SPEC_KEY_U32("min_runs", struct admission_params, min_runs, 1, 1000000),
+	SPEC_KEY_U32("interval", struct admission_params, interval_sec, 1, 3600),
+};
+
+static const struct spec_def admission_spec = {
+	.what = "admission",
+	.keys = admission_keys,
+	.nr_keys = SPEC_NR_KEYS(admission_keys),
+	.size = sizeof(struct admission_params),
+};
+
+int admission_parse(struct admission_params *p, const char *spec)
+{
+	return spec_parse(&admission_spec, p, spec);
+}
+
+struct admission *admission_new(const struct admission_params *p, __u32 cpus)
+{
+	struct admission *a;
+
+	if (!cpus) {
+		errno = EINVAL;
+		return NULL;
+	}
+	a = calloc(1, sizeof(*a));
+	if (!a)
+		return NULL;
+	pthread_mutex_init(&a->lock, NULL);
+	a->p = *p;
+	a->cpus = cpus;
+	a->stats.cpus = cpus;
+	a->stats.headroom = 1.0;
+	a->stats.headroom_relaxed = 1.0;
+	a->stats.schedulable = true;
+	return a;
+}
+
+void admission_free(struct admission *a)
+{
+	if (!a)
+		return;
+	pthread_mutex_destroy(&a->lock);
+	free(a->entries);
+	free(a);
+}
+
+static bool cfg_eq(const struct slo_cfg *a, const struct slo_cfg *b)
+{
+	return a->budget_ns == b->budget_ns && a->importance == b->importance &&
+	       a->flags == b->flags;
+}
+
+/* Time between enqueue and deadline for @cfg, as the scheduler computes it */
+static double deadline_window(const struct slo_cfg *cfg)
+{
+	__u32 imp = cfg->importance;
+
+	if (imp < MIN_IMPORTANCE)
+		imp = MIN_IMPORTANCE;
+	if (imp > MAX_IMPORTANCE)
+		imp = MAX_IMPORTANCE;
+	return (double)cfg->budget_ns * (101 - imp) / 100;
+}
+
+static int cmp_window(const void *a, const void *b)
+{
+	const struct admission_load *x = a, *y = b;
+
+	return x->window_ns < y->window_ns ? -1 : x->window_ns > y->window_ns;
+}
+
+/*
+ * Each cgroup is taken as a sporadic task with a job of run_ns due
+ * window_ns after release, released util times per run_ns. By time t it
+ * needs at most run_ns + util * (t - window_ns) once t reaches its
+ * window. Demand only steps up at a window, so sorting by window lets
+ * running sums check every step in one pass.
+ */
+double admission_headroom(const struct admission_load *l, size_t nr, __u32 cpus)
+{
+	struct admission_load *sorted;
+	double run_sum = 0, util_sum = 0, uw_sum = 0, min = 1.0;
+	size_t i, n = 0;
+
+	if (!cpus)
+		return 0;
+	sorted = malloc((nr + 1) * sizeof(*sorted));
+	if (!sorted)
+		return 0;
+	for (i = 0; i < nr; i++)
+		if (l[i].window_ns > 0 && (l[i].util > 0 || l[i].run_ns > 0))
+			sorted[n++] = l[i];
+	qsort(sorted, n, sizeof(*sorted), cmp_window);
+
+	for (i = 0; i < n; i++) {
+		double t = sorted[i].window_ns, h;
+
+		run_sum += sorted[i].run_ns;
+		util_sum += sorted[i].util;
+		uw_sum += sorted[i].util * t;
+		/* Equal windows are one test point */
+		if (i + 1 < n && sorted[i + 1].window_ns == t)
+			continue;
+		h = 1.0 - (run_sum + util_sum * t - uw_sum) / (cpus * t);
+		if (h < min)
+			min = h;
+	}
+	free(sorted);
+
+	/* In the long run only utilization counts */
+	if (1.0 - util_sum / cpus < min)
+		min = 1.0 - util_sum / cpus;
+	return min;
+}
+
+static void entry_reset(struct adm_entry *e, const struct budget_ctl_sample *s)
+{
+	e->cgroup_id = s->cgroup_id;
+	e->base = s->cfg;
+	e->eff = s->cfg;
+	e->prev_eff = s->cfg;
+	e->relax = false;
+}
+
+/* Whether any counter went backwards, i.e. the stats entry was recreated */
+static bool stats_reset(const struct slo_cgrp_stats *cur, const struct slo_cgrp_stats *last)
+{
+	return cur->runs < last->runs || cur->runtime_ns < last->runtime_ns;
+}
+
+/* Fold one interval of @s into the demand estimate of @e */
+static void entry_measure(const struct admission_params *p, struct adm_entry *e,
+			  const struct budget_ctl_sample *s, __u64 interval_ns)
+{
+	__u64 runs = s->stats.runs - e->last.runs;
+	__u64 runtime = s->stats.runtime_ns - e->last.runtime_ns;
+	double w = p->smoothing, util;
+
+	e->last = s->stats;
+	if (!interval_ns)
+		return;
+
+	/* Utilization decays even when idle; run length needs enough runs */
+	util = (double)runtime / interval_ns;
+	e->util = e->measured ? w * util + (1 - w) * e->util : util;
+	if (runs < p->min_runs)
+		return;
+	e->run_ns = e->measured ? w * runtime / runs + (1 - w) * e->run_ns :
+				  (double)runtime / runs;
+	e->measured = true;
+}
+
+static struct slo_cfg relaxed_cfg(const struct admission_params *p, const struct slo_cfg *base)
+{
+	struct slo_cfg cfg = *base;
+	double budget = base->budget_ns * p->relax_max;
+
+	cfg.budget_ns = budget > MAX_BUDGET_NS ? MAX_BUDGET_NS : (__u64)(budget + 0.5);
+	if (cfg.budget_ns < base->budget_ns)
+		cfg.budget_ns = base->budget_ns;
+	return cfg;
+}
+
+/* An entry that may be relaxed */
+struct victim {
+	__u32 importance;
+	double util;
+	size_t idx;
+};
+
+/* Least important first, then the largest demand */
+static int cmp_victim(const void *a, const void *b)
+{
+	const struct victim *x = a, *y = b;
+
+	if (x->importance != y->importance)
+		return x->importance < y->importance ? -1 : 1;
+	if (x->util != y->util)
+		return x->util > y->util ? -1 : 1;
+	return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+/*
+ * Decide which entries of @a->entries to relax, given their demand
+ * estimates. @loads and @victims have room for every entry. Called
+ * with the lock held.
+ */
+static void plan(struct admission *a, struct admission_load *loads, struct victim *victims)
+{
+	const struct admission_params *p = &a->p;
+	double floor = 1.0 - p->util_max, h, h0, util = 0;
+	size_t i, nv = 0;
+	bool relaxed = false;
+
+	for (i = 0; i < a->nr; i++) {
+		struct adm_entry *e = &a->entries[i];
+
+		loads[i].util = e->util;
+		loads[i].run_ns = e->measured ? e->run_ns : 0;
+		loads[i].window_ns = deadline_window(&e->base);
+		util += e->util;
+		relaxed |= e->relax;
+		if (e->measured && e->base.importance < p->victim_below &&
+		    e->base.budget_ns >= MIN_BUDGET_NS) {
+			victims[nv].importance = e->base.importance;
+			victims[nv].util = e->util;
+			victims[nv++].idx = i;
+		}
+	}
+	h0 = h = admission_headroom(loads, a->nr, a->cpus);
+
+	/* Relaxed entries stay so until the node clears the floor with room to spare */
+	if (h0 < floor + (relaxed ? p->hysteresis : 0))
+		qsort(victims, nv, sizeof(*victims), cmp_victim);
+	else
+		nv = 0;
+
+	for (i = 0; i < a->nr; i++)
+		a->entries[i].relax = false;
+	for (i = 0; i < nv && h < floor + p->hysteresis; i++) {
+		struct adm_entry *e = &a->entries[victims[i].idx];
+		struct slo_cfg cfg = relaxed_cfg(p, &e->base);
+
+		e->relax = true;
+		loads[victims[i].idx].window_ns = deadline_window(&cfg);
+		h = admission_headroom(loads, a->nr, a->cpus);
+	}
+
+	a->stats.util = util;
+	a->stats.headroom = h0;
+	a->stats.headroom_relaxed = h;
+	a->stats.overcommitted = h0 < floor;
+	a->stats.schedulable = h >= floor;
+	a->stats.checks++;
+	if (h0 < floor)
+		a->stats.overcommits++;
+}
+
+static int cmp_sample(const void *a, const void *b)
+{
+	const struct budget_ctl_sample *x = a, *y = b;
+
+	return x->cgroup_id < y->cgroup_id ? -1 : x->cgroup_id > y->cgroup_id;
+}
+
+int admission_step(struct admission *a, struct budget_ctl_sample *s, size_t nr,
+		   __u64 interval_ns, struct budget_ctl_update *out)
+{
+	struct adm_entry *next = malloc((nr + 1) * sizeof(*next));
+	struct admission_load *loads = calloc(nr + 1, sizeof(*loads));
+	struct victim *victims = malloc((nr + 1) * sizeof(*victims));
+	size_t i, j = 0, n = 0;
+	__u32 measured = 0, relaxed = 0;
+
+	if (!next || !loads || !victims) {
+		free(next);
+		free(loads);
+		free(victims);
+		return -ENOMEM;
+	}
+	qsort(s, nr, sizeof(*s), cmp_sample);
+
+	pthread_mutex_lock(&a->lock);
+	for (i = 0; i < nr; i++) {
+		struct adm_entry *e = &next[i];
+		const struct slo_cfg *cur = &s[i].cfg;
+
+		while (j < a->nr && a->entries[j].cgroup_id < s[i].cgroup_id)
+			j++;
+		if (j == a->nr || a->entries[j].cgroup_id != s[i].cgroup_id ||
+		    (i && s[i - 1].cgroup_id == s[i].cgroup_id)) {
+			memset(e, 0, sizeof(*e));
+			entry_reset(e, &s[i]);
+			e->last = s[i].stats;
+			continue;
+		}
+		*e = a->entries[j];
+
+		if (!cfg_eq(cur, &e->eff)) {
+			if (cfg_eq(cur, &e->prev_eff)) {
+				/* The last update never landed */
+				e->eff = e->prev_eff;
+			} else if (!cfg_eq(cur, &e->base)) {
+				/* Someone else wrote a new value; the demand estimate still holds */
+				entry_reset(e, &s[i]);
+				a->stats.rebased++;
+			}
+		}
+
+		if (stats_reset(&s[i].stats, &e->last))
+			e->last = s[i].stats;
+		else
+			entry_measure(&a->p, e, &s[i], interval_ns);
+	}
+
+	free(a->entries);
+	a->entries = next;
+	a->nr = nr;
+	plan(a, loads, victims);
+
+	for (i = 0; i < nr; i++) {
+		struct adm_entry *e = &a->entries[i];
+		const struct slo_cfg *cur = &s[i].cfg;
+
+		e->prev_eff = e->eff;
+		if (a->p.enforce)
+			e->eff = e->relax ? relaxed_cfg(&a->p, &e->base) : e->base;
+		if (!cfg_eq(&e->eff, cur)) {
+			out[n].cgroup_id = e->cgroup_id;
+			out[n].expected = *cur;
+			out[n++].cfg = e->eff;
+		}
+		measured += e->measured;
+		relaxed += e->relax;
+	}
+
+	a->stats.tracked = nr;
+	a->stats.measured = measured;
+	a->stats.relaxed = relaxed;
+	a->stats.updates += n;
+	pthread_mutex_unlock(&a->lock);
+	free(loads);
+	free(victims);
+	return n;
+}
+
+static struct adm_entry *find_entry(struct admission *a, __u64 id)
+{
+	size_t lo = 0, hi = a->nr;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (a->entries[mid].cgroup_id < id)
+			lo = mid + 1;
+		else if (a->entries[mid].cgroup_id > id)
+			hi = mid;
+		else
+			return &a->entries[mid];
+	}
+	return NULL;
+}
+
+bool admission_base(struct admission *a, __u64 cgroup_id, const struct slo_cfg *cur,
+		    struct slo_cfg *base)
+{
+	struct adm_entry *e;
+	bool owned = false;
+
+	*base = *cur;
+	pthread_mutex_lock(&a->lock);
+	e = find_entry(a, cgroup_id);
+	if (e && (cfg_eq(cur, &e->eff) || cfg_eq(cur, &e->prev_eff))) {
+		*base = e->base;
+		owned = true;
+	}
+	pthread_mutex_unlock(&a->lock);
+	return owned;
+}
+
+size_t admission_restore(struct admission *a, struct budget_ctl_update *out, size_t max)
+{
+	size_t n = 0;
+
+	pthread_mutex_lock(&a->lock);
+	for (size_t i = 0; i < a->nr && n < max; i++) {
+		const struct adm_entry *e = &a->entries[i];
+
+		if (cfg_eq(&e->eff, &e->base))
+			continue;
+		out[n].cgroup_id = e->cgroup_id;
+		out[n].expected = e->eff;
+		out[n++].cfg = e->base;
+	}
+	pthread_mutex_unlock(&a->lock);
+	return n;
+}
+
+void admission_get_stats(struct admission *a, struct admission_stats *out)
+{
+	pthread_mutex_lock(&a->lock);
+	*out = a->stats;
+	pthread_mutex_unlock(&a->lock);
+}
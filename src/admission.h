@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Admission control for scx-slo
+ *
+ * Budgets are only promises if the node can keep them all. Once per
+ * interval the agent hands the admission controller every SLO map entry
+ * with its run statistics, as for the budget controller. It estimates
+ * each cgroup's demand from them (CPUs used and CPU time per run, both
+ * smoothed) and runs the EDF processor demand test on the node's CPUs:
+ * for every deadline window t, the work of all cgroups whose deadlines
+ * fall within t must fit in util_max of cpus * t. Headroom is the
+ * smallest fraction of capacity left over any t.
+ *
+ * A tight budget concentrates demand in a short window, so an overcommit
+ * at short windows is resolved by stretching the budgets of the least
+ * important cgroups, up to relax_max times, until the test passes with
+ * hysteresis to spare. Relaxed entries go back to their configured budget
+ * once the node has room for them. In a dry run the same plan is only
+ * reported. Demand beyond util_max of the node in the long run cannot be
+ * fixed by any budget and is only reported.
+ */
+#ifndef __SCX_SLO_ADMISSION_H
+#define __SCX_SLO_ADMISSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "scx_slo.h"
+#include "budget_ctl.h"
+
+struct admission_params {
+	double util_max;      /* Share of the node's CPU time the SLOs may claim */
+	double relax_max;     /* Largest factor a budget is stretched by */
+	double hysteresis;    /* Headroom kept on top of 1 - util_max once relaxed */
+	double smoothing;     /* EWMA weight of the newest interval */
+	__u32 victim_below;   /* Only entries below this importance are relaxed */
+	__u32 min_runs;       /* Runs per interval below which demand is not re-estimated */
+	__u32 interval_sec;   /* Time between two steps */
+	bool enforce;         /* Write relaxed budgets; report only otherwise */
+};
+
+/* Demand of one cgroup as the test sees it */
+struct admission_load {
+	double util;          /* CPUs used: CPU time per wall time */
+	double run_ns;        /* CPU time per run */
+	double window_ns;     /* Deadline window */
+};
+
+struct admission_stats {
+	__u32 cpus;
+	__u32 tracked;        /* Entries followed */
+	__u32 measured;       /* Of those, with a demand estimate */
+	__u32 relaxed;        /* Entries relaxed, or that would be in a dry run */
+	bool overcommitted;   /* Over util_max at the configured budgets */
+	bool schedulable;     /* Within util_max once relaxed */
+	double util;          /* CPUs claimed by all entries */
+	double headroom;      /* At the configured budgets */
+	double headroom_relaxed;
+	__u64 checks;
+	__u64 overcommits;    /* Checks that found the node overcommitted */
+	__u64 updates;        /* Updates returned by admission_step() */
+	__u64 rebased;        /* Entries another writer changed */
+};
+
+struct admission;
+
+void admission_params_default(struct admission_params *p);
+
+/*
+ * Parse @spec (see spec_parse.h) into @p. Keys: mode (dry-run or relax),
+ * util_max, relax_max, hysteresis, smoothing, victim_below, min_runs and
+ * interval.
+ */
+int admission_parse(struct admission_params *p, const char *spec);
+
+struct admission *admission_new(const struct admission_params *p, __u32 cpus);
+void admission_free(struct admission *a);
+
+/*
+ * Headroom of @nr loads on @cpus CPUs: the smallest 1 - demand(t) /
+ * (cpus * t) over every deadline window t and the long run. Negative
+ * when even every CPU would not do.
+ */
+double admission_headroom(const struct admission_load *l, size_t nr, __u32 cpus);
+
+/*
+ * Check the entries of @s, sampled @interval_ns after the last step, as
+ * budget_ctl_step() does: sorted in place, entries missing are
+ * forgotten. Writes up to @nr updates to @out when enforcing; returns
+ * their number, or -ENOMEM.
+ */
+int admission_step(struct admission *a, struct budget_ctl_sample *s, size_t nr,
+		   __u64 interval_ns, struct budget_ctl_update *out);
+
+/* The configured value behind @cur, as budget_ctl_base() */
+bool admission_base(struct admission *a, __u64 cgroup_id, const struct slo_cfg *cur,
+		    struct slo_cfg *base);
+
+/* Updates putting every relaxed entry back, at most @max. Returns their number. */
+size_t admission_restore(struct admission *a, struct budget_ctl_update *out, size_t max);
+
+void admission_get_stats(struct admission *a, struct admission_stats *out);
+
+#endif /* __SCX_SLO_ADMISSION_H */
@@ -0,0 +1,297 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Circuit breaker for scx-slo
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "breaker.h"
+#include "spec_parse.h"
+
+/*
+ * Floors under the baselines: a scheduler that never missed would
+ * otherwise trip on its first few misses.
+ */
+#define BREAKER_MISS_FLOOR  0.01
+#define BREAKER_DELAY_FLOOR 0.0005  /* Seconds */
+
+struct breaker {
+	pthread_mutex_t lock;   /* The agent steps, the metrics thread reads */
+	struct breaker_params p;
+	struct breaker_stats st;
+	__u32 cooldown_sec;     /* Of the current or last open period */
+	__u32 miss_samples;     /* Healthy intervals averaged into the baselines */
+	__u32 delay_samples;
+	__u64 reopen_ns;        /* When an open breaker asks to re-attach */
+	__u64 probation_end_ns;
+	__u64 last_ns;
+};
+
+void breaker_params_default(struct breaker_params *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->miss_max = 0.5;
+	p->miss_factor = 4.0;
+	p->delay_max_us = 50000;
+	p->delay_factor = 4.0;
+	p->cpu_max = 0.1;
+	p->min_runs = 1000;
+	p->trip_after = 3;
+	p->baseline = 60;
+	p->warmup = 12;
+	p->cooldown_sec = 60;
+	p->cooldown_max_sec = 3600;
+	p->probation_sec = 60;
+	p->interval_sec = 5;
+}
+
+static const struct spec_key breaker_keys[] = {
+	SPEC_KEY_DOUBLE("miss", struct breaker_params, miss_max, 0, 1),
+	SPEC_KEY_DOUBLE("miss_factor", struct breaker_params, miss_factor, 0, 1000),
+	SPEC_KEY_DOUBLE("delay_us", struct breaker_params, delay_max_us, 0, 60e6),
+	SPEC_KEY_DOUBLE("delay_factor", struct breaker_params, delay_factor, 0, 1000),
+	SPEC_KEY_DOUBLE("cpu", struct breaker_params, cpu_max, 0, 1),
+	SPEC_KEY_U32("min_runs", struct breaker_params, min_runs, 1, 100000000),
+	SPEC_KEY_U32("trip_after", struct breaker_params, trip_after, 1, 1000),
+	SPEC_KEY_U32("baseline", struct breaker_params, baseline, 1, 100000),
+	SPEC_KEY_U32("warmup", struct breaker_params, warmup, 1, 100000),
+	SPEC_KEY_U32("cooldown", struct breaker_params, cooldown_sec, 1, 86400),
+	SPEC_KEY_U32("cooldown_max", struct breaker_params, cooldown_max_sec, 1, 86400 * 7),
+	SPEC_KEY_U32("probation", struct breaker_params, probation_sec, 0, 86400),
+	SPEC_KEY_U32("interval", struct breaker_params, interval_sec, 1, 3600),
+};
+
+static bool breaker_params_valid(const void *params)
+{
+	const struct breaker_params *p = params;
+
+	return p->cooldown_sec <= p->cooldown_max_sec;
+}
+
+static const struct spec_def breaker_spec = {
+	.what = "circuit breaker",
+	.keys = breaker_keys,
+	.nr_keys = SPEC_NR_KEYS(breaker_keys),
+	.size = sizeof(struct breaker_params),
+	.valid = breaker_params_valid,
+};
+
+int breaker_parse(struct breaker_params *p, const char *spec)
+{
+	return spec_parse(&breaker_spec, p, spec);
+}
+
+struct breaker *breaker_new(const struct breaker_params *p)
+{
+	struct breaker *b = calloc(1, sizeof(*b));
+
+	if (!b)
+		return NULL;
+	pthread_mutex_init(&b->lock, NULL);
+	b->p = *p;
+	b->cooldown_sec = p->cooldown_sec;
+	b->st.state = BREAKER_CLOSED;
+	return b;
+}
+
+void breaker_free(struct breaker *b)
+{
+	if (!b)
+		return;
+	pthread_mutex_destroy(&b->lock);
+	free(b);
+}
+
+static double ewma(double avg, double v, __u32 n, __u32 window)
+{
+	double alpha = 2.0 / (window + 1);
+
+	return n == 0 ? v : avg + alpha * (v - avg);
+}
+
+static bool over(struct breaker_trip *t, enum breaker_reason r, double value, double threshold)
+{
+	if (value <= threshold)
+		return false;
+	t->reason = r;
+	t->value = value;
+	t->threshold = threshold;
+	return true;
+}
+
+/*
+ * Judge one interval. Returns true and fills @t with the first limit
+ * crossed if it is bad; sets @miss_ok and @delay_ok if those could be
+ * judged and were healthy.
+ */
+static bool judge(struct breaker *b, const struct breaker_sample *s, struct breaker_trip *t,
+		  bool *miss_ok, bool *delay_ok)
+{
+	const struct breaker_params *p = &b->p;
+	bool baseline = b->miss_samples >= p->warmup;
+
+	*miss_ok = *delay_ok = false;
+
+	if (s->nr_cpus && s->interval_ns) {
+		b->st.last_cpu = (double)s->sched_ns / ((double)s->interval_ns * s->nr_cpus);
+		if (p->cpu_max > 0 && over(t, BREAKER_CPU, b->st.last_cpu, p->cpu_max))
+			return true;
+	}
+
+	if (s->runs >= p->min_runs) {
+		double miss = (double)s->late / s->runs;
+
+		b->st.last_miss = miss;
+		if (p->miss_max > 0 && over(t, BREAKER_MISS_RATIO, miss, p->miss_max))
+			return true;
+		if (p->miss_factor > 0 && baseline &&
+		    over(t, BREAKER_MISS_BASELINE, miss,
+			 p->miss_factor * (b->st.baseline_miss > BREAKER_MISS_FLOOR ?
+					   b->st.baseline_miss : BREAKER_MISS_FLOOR)))
+			return true;
+		*miss_ok = true;
+	}
+
+	if (s->delays >= p->min_runs) {
+		double delay = (double)s->delay_ns / s->delays / 1e9;
+
+		baseline = b->delay_samples >= p->warmup;
+		b->st.last_delay = delay;
+		if (p->delay_max_us > 0 && over(t, BREAKER_DELAY, delay, p->delay_max_us / 1e6))
+			return true;
+		if (p->delay_factor > 0 && baseline &&
+		    over(t, BREAKER_DELAY_BASELINE, delay,
+			 p->delay_factor * (b->st.baseline_delay > BREAKER_DELAY_FLOOR ?
+					    b->st.baseline_delay : BREAKER_DELAY_FLOOR)))
+			return true;
+		*delay_ok = true;
+	}
+	return false;
+}
+
+enum breaker_action breaker_step(struct breaker *b, const struct breaker_sample *s,
+				 __u64 now_ns, struct breaker_trip *trip)
+{
+	enum breaker_action action = BREAKER_NONE;
+	struct breaker_trip t = {0};
+	bool miss_ok, delay_ok;
+
+	pthread_mutex_lock(&b->lock);
+
+	if (b->st.state == BREAKER_OPEN) {
+		if (now_ns > b->last_ns)
+			b->st.open_ns += now_ns - b->last_ns;
+		if (now_ns >= b->reopen_ns) {
+			b->st.state = BREAKER_PROBATION;
+			b->probation_end_ns = now_ns + (__u64)b->p.probation_sec * 1000000000ULL;
+			b->st.attaches++;
+			action = BREAKER_ATTACH;
+		}
+		goto out;
+	}
+	if (!s)
+		goto out;
+
+	if (judge(b, s, &t, &miss_ok, &delay_ok)) {
+		b->st.bad_streak++;
+		if (b->st.state == BREAKER_PROBATION || b->st.bad_streak >= b->p.trip_after) {
+			/* Tripping again right after a cooldown backs off further */
+			if (b->st.state == BREAKER_PROBATION) {
+				b->cooldown_sec = b->cooldown_sec > b->p.cooldown_max_sec / 2 ?
+						  b->p.cooldown_max_sec : b->cooldown_sec * 2;
+			} else {
+				b->cooldown_sec = b->p.cooldown_sec;
+			}
+			t.bad_intervals = b->st.bad_streak;
+			t.cooldown_sec = b->cooldown_sec;
+			t.time_ns = now_ns;
+			b->st.trips[t.reason]++;
+			b->st.last_trip = t;
+			b->st.bad_streak = 0;
+			b->st.state = BREAKER_OPEN;
+			b->reopen_ns = now_ns + (__u64)b->cooldown_sec * 1000000000ULL;
+			if (trip)
+				*trip = t;
+			action = BREAKER_DETACH;
+			goto out;
+		}
+	} else {
+		/* An interval too small to judge neither breaks nor extends a streak */
+		if (miss_ok || delay_ok || (s->nr_cpus && s->interval_ns))
+			b->st.bad_streak = 0;
+		/* The baseline only learns from the scheduler at its settled best */
+		if (b->st.state == BREAKER_CLOSED) {
+			if (miss_ok) {
+				b->st.baseline_miss = ewma(b->st.baseline_miss, b->st.last_miss,
+							   b->miss_samples++, b->p.baseline);
+			}
+			if (delay_ok) {
+				b->st.baseline_delay = ewma(b->st.baseline_delay, b->st.last_delay,
+							    b->delay_samples++, b->p.baseline);
+			}
+			b->st.baseline_ready = b->miss_samples >= b->p.warmup;
+		}
+	}
+
+	if (b->st.state == BREAKER_PROBATION && now_ns >= b->probation_end_ns) {
+		b->st.state = BREAKER_CLOSED;
+		b->cooldown_sec = b->p.cooldown_sec;
+	}
+out:
+	b->last_ns = now_ns;
+	pthread_mutex_unlock(&b->lock);
+	return action;
+}
+
+void breaker_attach_failed(struct breaker *b, __u64 now_ns)
+{
+	pthread_mutex_lock(&b->lock);
+	if (b->st.attaches)
+		b->st.attaches--;
+	b->st.state = BREAKER_OPEN;
+	b->reopen_ns = now_ns + (__u64)b->cooldown_sec * 1000000000ULL;
+	b->last_ns = now_ns;
+	pthread_mutex_unlock(&b->lock);
+}
+
+int breaker_reattach(struct breaker *b, __u64 now_ns, breaker_attach_fn attach, void *ctx)
+{
+	int err = attach(ctx);
+
+	if (err)
+		breaker_attach_failed(b, now_ns);
+	return err;
+}
+
+void breaker_get_stats(struct breaker *b, struct breaker_stats *out)
+{
+	pthread_mutex_lock(&b->lock);
+	*out = b->st;
+	pthread_mutex_unlock(&b->lock);
+}
+
+const char *breaker_reason_name(enum breaker_reason r)
+{
+	static const char *const names[NR_BREAKER_REASONS] = {
+		[BREAKER_MISS_RATIO] = "miss_ratio",
+		[BREAKER_MISS_BASELINE] = "miss_baseline",
+		[BREAKER_DELAY] = "queue_delay",
+		[BREAKER_DELAY_BASELINE] = "queue_delay_baseline",
+		[BREAKER_CPU] = "cpu",
+	};
+
+	return r < NR_BREAKER_REASONS ? names[r] : "unknown";
+}
+
+const char *breaker_state_name(enum breaker_state s)
+{
+	switch (s) {
+	case BREAKER_CLOSED:
+		return "closed";
+	case BREAKER_OPEN:
+		return "open";
+	case BREAKER_PROBATION:
+		return "probation";
+	}
+	return "unknown";
+}
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Circuit breaker for scx-slo
+ *
+ * Once per interval the agent feeds the breaker what the scheduler did:
+ * runs and late runs, queueing delay, and the CPU time its BPF programs
+ * took. An interval is bad if the miss ratio, the mean queueing delay or
+ * the scheduler's share of CPU crosses its absolute ceiling, or if the
+ * miss ratio or delay exceeds a rolling baseline by a factor. The
+ * baseline is an EWMA of healthy intervals only, so a regression cannot
+ * raise it. After trip_after bad intervals in a row the breaker opens and
+ * the agent detaches the scheduler. It asks for a re-attach once the
+ * cooldown has passed, then watches a probation period in which a single
+ * bad interval trips again with the cooldown doubled.
+ *
+ * Like the budget controller it is plain arithmetic over samples, so it
+ * is tested with synthetic ones.
+ */
+#ifndef __SCX_SLO_BREAKER_H
+#define __SCX_SLO_BREAKER_H
+
+#include <stdbool.h>
+#include "scx_slo.h"
+
+struct breaker_params {
+	double miss_max;        /* Miss ratio ceiling, 0 = off */
+	double miss_factor;     /* Trip above baseline * factor, 0 = off */
+	double delay_max_us;    /* Mean queueing delay ceiling, 0 = off */
+	double delay_factor;    /* Trip above baseline * factor, 0 = off */
+	double cpu_max;         /* Share of all CPU time spent in the scheduler, 0 = off */
+	__u32 min_runs;         /* Runs per interval below which misses and delay are not judged */
+	__u32 trip_after;       /* Bad intervals in a row that open the breaker */
+	__u32 baseline;         /* Intervals the baseline averages over */
+	__u32 warmup;           /* Healthy intervals before the baseline is used */
+	__u32 cooldown_sec;     /* Time detached after a trip */
+	__u32 cooldown_max_sec; /* Ceiling of the doubled cooldown */
+	__u32 probation_sec;    /* Time after re-attaching in which one bad interval trips */
+	__u32 interval_sec;     /* Time between two samples */
+};
+
+/* What the scheduler did over one interval */
+struct breaker_sample {
+	__u64 interval_ns;
+	__u64 runs;
+	__u64 late;             /* Runs that ended past their deadline */
+	__u64 delay_ns;         /* Queueing delay summed over @delays wakeups */
+	__u64 delays;
+	__u64 sched_ns;         /* CPU time of the scheduler's programs */
+	__u32 nr_cpus;          /* 0 if @sched_ns is unknown */
+};
+
+enum breaker_state {
+	BREAKER_CLOSED,         /* Attached */
+	BREAKER_OPEN,           /* Detached, cooling down */
+	BREAKER_PROBATION,      /* Re-attached, on probation */
+};
+
+enum breaker_reason {
+	BREAKER_MISS_RATIO,
+	BREAKER_MISS_BASELINE,
+	BREAKER_DELAY,
+	BREAKER_DELAY_BASELINE,
+	BREAKER_CPU,
+	NR_BREAKER_REASONS,
+};
+
+enum breaker_action {
+	BREAKER_NONE,
+	BREAKER_DETACH,
+	BREAKER_ATTACH,
+};
+
+/* Why the breaker opened; values are ratios, seconds or CPU shares */
+struct breaker_trip {
+	enum breaker_reason reason;
+	double value;
+	double threshold;
+	__u32 bad_intervals;
+	__u32 cooldown_sec;
+	__u64 time_ns;
+};
+
+struct breaker_stats {
+	enum breaker_state state;
+	__u64 trips[NR_BREAKER_REASONS];
+	__u64 attaches;         /* Successful re-attaches after a cooldown */
+	__u64 open_ns;          /* Time spent open, up to the last step */
+	__u32 bad_streak;
+	bool baseline_ready;
+	double baseline_miss;   /* Miss ratio */
+	double baseline_delay;  /* Mean queueing delay, seconds */
+	double last_miss, last_delay, last_cpu;
+	struct breaker_trip last_trip;  /* Valid if any trips */
+};
+
+struct breaker;
+
+void breaker_params_default(struct breaker_params *p);
+
+/*
+ * Parse @spec (see spec_parse.h) into @p. Keys: miss, miss_factor,
+ * delay_us, delay_factor, cpu, min_runs, trip_after, baseline, warmup,
+ * cooldown, cooldown_max, probation and interval.
+ */
+int breaker_parse(struct breaker_params *p, const char *spec);
+
+struct breaker *breaker_new(const struct breaker_params *p);
+void breaker_free(struct breaker *b);
+
+/*
+ * Advance by one interval ending at @now_ns. @s is ignored while open
+ * and may be NULL. Returns BREAKER_DETACH with @trip filled when the
+ * breaker opens, and BREAKER_ATTACH when the cooldown has passed.
+ */
+enum breaker_action breaker_step(struct breaker *b, const struct breaker_sample *s,
+				 __u64 now_ns, struct breaker_trip *trip);
+
+/* The re-attach asked for failed: stay open for another cooldown */
+void breaker_attach_failed(struct breaker *b, __u64 now_ns);
+
+/* Attach the scheduler; 0 or a negative errno */
+typedef int (*breaker_attach_fn)(void *ctx);
+
+/*
+ * Act on BREAKER_ATTACH at @now_ns: call @attach, and if it fails stay
+ * open for another cooldown. Returns what @attach returned.
+ */
+int breaker_reattach(struct breaker *b, __u64 now_ns, breaker_attach_fn attach, void *ctx);
+
+void breaker_get_stats(struct breaker *b, struct breaker_stats *out);
+
+const char *breaker_reason_name(enum breaker_reason r);
+const char *breaker_state_name(enum breaker_state s);
+
+#endif /* __SCX_SLO_BREAKER_H */
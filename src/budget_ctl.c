@@ -0,0 +1,539 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Adaptive SLO budgets for scx-slo
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "budget_ctl.h"
+#include "spec_parse.h"
+
+/* Controller state of one SLO map entry */
+struct ctl_entry {
+	__u64 cgroup_id;
+	struct slo_cfg base;        /* Configured value */
+	struct slo_cfg eff;         /* Value last handed out for the map */
+	struct slo_cgrp_stats last; /* Counters at the previous step */
+	double scale;               /* eff.budget_ns / base.budget_ns, before rounding */
+	double integral;
+	double prev_err;
+	__u32 boost;                /* Importance added to the base */
+	bool saturated;
+	/* State before the last update, restored if it never reached the map */
+	struct slo_cfg prev_eff;
+	double prev_scale;
+	__u32 prev_boost;
+};
+
+struct budget_ctl {
+	pthread_mutex_t lock;
+	struct budget_ctl_params p;
+	struct ctl_entry *entries;  /* Sorted by cgroup_id */
+	size_t nr;
+	struct budget_ctl_stats stats;
+};
+
+void budget_ctl_params_default(struct budget_ctl_params *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->target = 0.01;
+	p->kp = 0.1;
+	p->ki = 0.05;
+	p->kd = 0.0;
+	p->scale_min = 0.25;
+	p->scale_max = 1.0;
+	p->max_step = 0.1;
+	p->min_slack = 0.2;
+	p->integral_max = 20.0;
+	p->min_runs = 20;
+	p->boost_max = 20;
+	p->boost_step = 5;
+	p->interval_sec = 5;
+}
+
+static const struct spec_key budget_ctl_keys[] = {
+	SPEC_KEY_DOUBLE("target", struct budget_ctl_params, target, 1e-6, 0.5),
+	SPEC_KEY_DOUBLE("kp", struct budget_ctl_params, kp, 0, 10),
+	SPEC_KEY_DOUBLE("ki", struct budget_ctl_params, ki, 0, 10),
+	SPEC_KEY_DOUBLE("kd", struct budget_ctl_params, kd, 0, 10),
+	SPEC_KEY_DOUBLE("scale_min", struct budget_ctl_params, scale_min, 0.01, 1),
+	SPEC_KEY_DOUBLE("scale_max", struct budget_ctl_params, scale_max, 0.01, 4),
+	SPEC_KEY_DOUBLE("max_step", struct budget_ctl_params, max_step, 0.001, 1),
+	SPEC_KEY_DOUBLE("min_slack", struct budget_ctl_params, min_slack, 0, 1),
+	SPEC_KEY_DOUBLE("integral_max", struct budget_ctl_params, integral_max, 0, 1000),
+	SPEC_KEY_U32("min_runs", struct budget_ctl_params, min_runs, 1, 1000000),
+	SPEC_KEY_U32("boost_max", struct budget_ctl_params, boost_max, 0, MAX_IMPORTANCE),
+	SPEC_KEY_U32("boost_step", struct budget_ctl_params, boost_step, 1, MAX_IMPORTANCE),
+	SPEC_KEY_U32("interval", struct budget_ctl_params, interval_sec, 1, 3600),
+	/* Paths may not hold commas; the trace is the last item */
+	SPEC_KEY_STR("trace", struct budget_ctl_params, trace),
+};
+
+static bool budget_ctl_params_valid(const void *params)
+{
+	const struct budget_ctl_params *p = params;
+
+	return p->scale_min <= p->scale_max;
+}
+
+static const struct spec_def budget_ctl_spec = {
+	.what = "adaptive budget",
+	.keys = budget_ctl_keys,
+	.nr_keys = SPEC_NR_KEYS(budget_ctl_keys),
+	.size = sizeof(struct budget_ctl_params),
+	.valid = budget_ctl_params_valid,
+};
+
+int budget_ctl_parse(struct budget_ctl_params *p, const char *spec)
+{
+	return spec_parse(&budget_ctl_spec, p, spec);
+}
+
+struct budget_ctl *budget_ctl_new(const struct budget_ctl_params *p)
+{
+	struct budget_ctl *c = calloc(1, sizeof(*c));
+
+	if (!c)
+		return NULL;
+	pthread_mutex_init(&c->lock, NULL);
+	c->p = *p;
+	return c;
+}
+
+void budget_ctl_free(struct budget_ctl *c)
+{
+	if (!c)
+		return;
+	pthread_mutex_destroy(&c->lock);
+	free(c->entries);
+	free(c);
+}
+
+static bool cfg_eq(const struct slo_cfg *a, const struct slo_cfg *b)
+{
+	return a->budget_ns == b->budget_ns && a->importance == b->importance &&
+	       a->flags == b->flags;
+}
+
+static double clamp_d(double v, double lo, double hi)
+{
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+/* Time between enqueue and deadline for @cfg, as the scheduler computes it */
+static double deadline_window(const struct slo_cfg *cfg)
+{
+	__u32 imp = cfg->importance;
+
+	if (imp < MIN_IMPORTANCE)
+		imp = MIN_IMPORTANCE;
+	if (imp > MAX_IMPORTANCE)
+		imp = MAX_IMPORTANCE;
+	return (double)cfg->budget_ns * (101 - imp) / 100;
+}
+
+static void entry_reset(struct ctl_entry *e, const struct budget_ctl_sample *s)
+{
+	memset(e, 0, sizeof(*e));
+	e->cgroup_id = s->cgroup_id;
+	e->base = s->cfg;
+	e->eff = s->cfg;
+	e->last = s->stats;
+	e->scale = 1.0;
+	e->prev_eff = s->cfg;
+	e->prev_scale = 1.0;
+}
+
+/* Whether any counter went backwards, i.e. the stats entry was recreated */
+static bool stats_reset(const struct slo_cgrp_stats *cur, const struct slo_cgrp_stats *last)
+{
+	return cur->runs < last->runs || cur->late < last->late ||
+	       cur->lateness_ns < last->lateness_ns || cur->slack_ns < last->slack_ns ||
+	       cur->runtime_ns < last->runtime_ns;
+}
+
+/*
+ * One interval of @e. The error is the miss fraction relative to the
+ * target, normalized to [-1, 1]: -1 with no misses, 0 on target, towards
+ * 1 as every run misses. The integral tracks the output actually applied
+ * (back-calculation), so it never winds up against the clamps, the rate
+ * limit or a hold, and a saturated entry relaxes as soon as misses stop.
+ */
+static void entry_step(const struct budget_ctl_params *p, struct ctl_entry *e,
+		       const struct budget_ctl_sample *s)
+{
+	struct slo_cgrp_stats d;
+	double miss, err, de, u, window, slack_frac;
+	__u64 nonlate, budget;
+	bool hold = false;
+
+	d.runs = s->stats.runs - e->last.runs;
+	d.late = s->stats.late - e->last.late;
+	d.slack_ns = s->stats.slack_ns - e->last.slack_ns;
+	d.runtime_ns = s->stats.runtime_ns - e->last.runtime_ns;
+	e->last = s->stats;
+	e->saturated = false;
+
+	if (d.runs < p->min_runs || d.late > d.runs || e->base.budget_ns < MIN_BUDGET_NS)
+		return;
+
+	miss = (double)d.late / d.runs;
+	err = (miss - p->target) / (miss > p->target ? miss : p->target);
+	de = err - e->prev_err;
+	e->prev_err = err;
+	window = deadline_window(&e->base);
+
+	/* Runs longer than their whole window miss however early they are queued */
+	if (err > 0 && (double)d.runtime_ns / d.runs >= window)
+		return;
+
+	e->integral = clamp_d(e->integral + err, -p->integral_max, p->integral_max);
+	u = 1.0 - (p->kp * err + p->ki * e->integral + p->kd * de);
+
+	/* Give back the importance boost before loosening the budget */
+	if (err < 0 && e->boost) {
+		e->boost -= e->boost < p->boost_step ? e->boost : p->boost_step;
+		hold = true;
+	}
+
+	/* Loosen only with headroom left before the configured deadlines */
+	nonlate = d.runs - d.late;
+	slack_frac = nonlate && window > 0 ? (double)d.slack_ns / nonlate / window : 0;
+	if (u > e->scale && (hold || slack_frac < p->min_slack))
+		u = e->scale;
+
+	u = clamp_d(u, e->scale - p->max_step, e->scale + p->max_step);
+	u = clamp_d(u, p->scale_min, p->scale_max);
+
+	budget = (__u64)(e->base.budget_ns * u + 0.5);
+	if (budget < MIN_BUDGET_NS)
+		budget = MIN_BUDGET_NS;
+	if (budget > MAX_BUDGET_NS)
+		budget = MAX_BUDGET_NS;
+
+	/* Still missing at the floor: the budget cannot help, importance may */
+	if (err > 0 && (u <= p->scale_min || budget == MIN_BUDGET_NS)) {
+		__u32 room = p->boost_max > e->boost ? p->boost_max - e->boost : 0;
+
+		e->saturated = true;
+		e->boost += room < p->boost_step ? room : p->boost_step;
+	}
+
+	if (p->ki > 0)
+		e->integral = clamp_d((1.0 - u - p->kp * err - p->kd * de) / p->ki,
+				      -p->integral_max, p->integral_max);
+	e->scale = u;
+	e->eff.budget_ns = budget;
+	e->eff.importance = e->base.importance + e->boost > MAX_IMPORTANCE ?
+				    MAX_IMPORTANCE : e->base.importance + e->boost;
+	e->eff.flags = e->base.flags;
+}
+
+static int cmp_sample(const void *a, const void *b)
+{
+	const struct budget_ctl_sample *x = a, *y = b;
+
+	return x->cgroup_id < y->cgroup_id ? -1 : x->cgroup_id > y->cgroup_id;
+}
+
+int budget_ctl_step(struct budget_ctl *c, struct budget_ctl_sample *s, size_t nr,
+		    struct budget_ctl_update *out)
+{
+	struct ctl_entry *next = malloc((nr + 1) * sizeof(*next));
+	size_t i, j = 0, n = 0;
+	__u32 adjusted = 0, saturated = 0;
+
+	if (!next)
+		return -ENOMEM;
+	qsort(s, nr, sizeof(*s), cmp_sample);
+
+	pthread_mutex_lock(&c->lock);
+	for (i = 0; i < nr; i++) {
+		struct ctl_entry *e = &next[i];
+		const struct slo_cfg *cur = &s[i].cfg;
+
+		while (j < c->nr && c->entries[j].cgroup_id < s[i].cgroup_id)
+			j++;
+		if (j == c->nr || c->entries[j].cgroup_id != s[i].cgroup_id ||
+		    (i && s[i - 1].cgroup_id == s[i].cgroup_id)) {
+			entry_reset(e, &s[i]);
+			continue;
+		}
+		*e = c->entries[j];
+
+		if (!cfg_eq(cur, &e->eff)) {
+			if (cfg_eq(cur, &e->prev_eff)) {
+				/* The last update never landed; continue from what did */
+				e->eff = e->prev_eff;
+				e->scale = e->prev_scale;
+				e->boost = e->prev_boost;
+			} else if (!cfg_eq(cur, &e->base)) {
+				/* Someone else wrote a new value; it is the base from now on */
+				entry_reset(e, &s[i]);
+				c->stats.rebased++;
+				continue;
+			}
+			/* Otherwise the base was written back, e.g. by a config publish */
+		}
+
+		e->prev_eff = e->eff;
+		e->prev_scale = e->scale;
+		e->prev_boost = e->boost;
+		if (stats_reset(&s[i].stats, &e->last))
+			e->last = s[i].stats;
+		else
+			entry_step(&c->p, e, &s[i]);
+
+		if (!cfg_eq(&e->eff, cur)) {
+			out[n].cgroup_id = e->cgroup_id;
+			out[n].expected = *cur;
+			out[n++].cfg = e->eff;
+		}
+		if (!cfg_eq(&e->eff, &e->base))
+			adjusted++;
+		if (e->saturated)
+			saturated++;
+	}
+
+	free(c->entries);
+	c->entries = next;
+	c->nr = nr;
+	c->stats.tracked = nr;
+	c->stats.adjusted = adjusted;
+	c->stats.saturated = saturated;
+	c->stats.updates += n;
+	pthread_mutex_unlock(&c->lock);
+	return n;
+}
+
+static struct ctl_entry *find_entry(struct budget_ctl *c, __u64 id)
+{
+	size_t lo = 0, hi = c->nr;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (c->entries[mid].cgroup_id < id)
+			lo = mid + 1;
+		else if (c->entries[mid].cgroup_id > id)
+			hi = mid;
+		else
+			return &c->entries[mid];
+	}
+	return NULL;
+}
+
+bool budget_ctl_base(struct budget_ctl *c, __u64 cgroup_id, const struct slo_cfg *cur,
+		     struct slo_cfg *base)
+{
+	struct ctl_entry *e;
+	bool owned = false;
+
+	*base = *cur;
+	pthread_mutex_lock(&c->lock);
+	e = find_entry(c, cgroup_id);
+	if (e && (cfg_eq(cur, &e->eff) || cfg_eq(cur, &e->prev_eff))) {
+		*base = e->base;
+		owned = true;
+	}
+	pthread_mutex_unlock(&c->lock);
+	return owned;
+}
+
+void budget_ctl_get_stats(struct budget_ctl *c, struct budget_ctl_stats *out)
+{
+	pthread_mutex_lock(&c->lock);
+	*out = c->stats;
+	pthread_mutex_unlock(&c->lock);
+}
+
+size_t budget_ctl_targets(struct budget_ctl *c, struct budget_ctl_target *out, size_t max)
+{
+	size_t n = 0;
+
+	pthread_mutex_lock(&c->lock);
+	for (size_t i = 0; i < c->nr && n < max; i++) {
+		const struct ctl_entry *e = &c->entries[i];
+
+		if (cfg_eq(&e->eff, &e->base))
+			continue;
+		out[n].cgroup_id = e->cgroup_id;
+		out[n].target.cfg = e->eff;
+		out[n++].target.window_ns = deadline_window(&e->base);
+	}
+	pthread_mutex_unlock(&c->lock);
+	return n;
+}
+
+size_t budget_ctl_restore(struct budget_ctl *c, struct budget_ctl_update *out, size_t max)
+{
+	size_t n = 0;
+
+	pthread_mutex_lock(&c->lock);
+	for (size_t i = 0; i < c->nr && n < max; i++) {
+		const struct ctl_entry *e = &c->entries[i];
+
+		if (cfg_eq(&e->eff, &e->base))
+			continue;
+		out[n].cgroup_id = e->cgroup_id;
+		out[n].expected = e->eff;
+		out[n++].cfg = e->base;
+	}
+	pthread_mutex_unlock(&c->lock);
+	return n;
+}
+
+int budget_ctl_trace_write(FILE *f, __u64 interval_ns, const struct budget_ctl_sample *s,
+			   size_t nr)
+{
+	fprintf(f, "T %llu %zu\n", (unsigned long long)interval_ns, nr);
+	for (size_t i = 0; i < nr; i++)
+		fprintf(f, "C %llu %llu %u %u %llu %llu %llu %llu %llu\n",
+			(unsigned long long)s[i].cgroup_id,
+			(unsigned long long)s[i].cfg.budget_ns, s[i].cfg.importance,
+			s[i].cfg.flags, (unsigned long long)s[i].stats.runs,
+			(unsigned long long)s[i].stats.late,
+			(unsigned long long)s[i].stats.lateness_ns,
+			(unsigned long long)s[i].stats.slack_ns,
+			(unsigned long long)s[i].stats.runtime_ns);
+	return ferror(f) ? -1 : 0;
+}
+
+/* Next line that is not blank or a comment, or NULL at the end */
+static char *next_line(FILE *f, char *buf, size_t size)
+{
+	while (fgets(buf, size, f)) {
+		char *p = buf + strspn(buf, " \t");
+
+		if (*p && *p != '\n' && *p != '#')
+			return p;
+	}
+	return NULL;
+}
+
+int budget_ctl_trace_read(FILE *f, __u64 *interval_ns, struct budget_ctl_sample **s,
+			  size_t *nr, size_t *cap)
+{
+	unsigned long long interval, id, budget, runs, late, lateness, slack, runtime;
+	unsigned int imp, flags;
+	char buf[256], *line;
+	size_t count;
+
+	line = next_line(f, buf, sizeof(buf));
+	if (!line)
+		return 0;
+	if (sscanf(line, "T %llu %zu", &interval, &count) != 2 || count > (1U << 24))
+		return -1;
+
+	if (count > *cap) {
+		struct budget_ctl_sample *grown = realloc(*s, count * sizeof(**s));
+
+		if (!grown)
+			return -1;
+		*s = grown;
+		*cap = count;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		line = next_line(f, buf, sizeof(buf));
+		if (!line || sscanf(line, "C %llu %llu %u %u %llu %llu %llu %llu %llu", &id,
+				    &budget, &imp, &flags, &runs, &late, &lateness, &slack,
+				    &runtime) != 9)
+			return -1;
+		(*s)[i] = (struct budget_ctl_sample){
+			.cgroup_id = id,
+			.cfg = { .budget_ns = budget, .importance = imp, .flags = flags },
+			.stats = { .runs = runs, .late = late, .lateness_ns = lateness,
+				   .slack_ns = slack, .runtime_ns = runtime },
+		};
+	}
+	*interval_ns = interval;
+	*nr = count;
+	return 1;
+}
+
+/* Simulated SLO map entry of a replay */
+struct sim_entry {
+	__u64 cgroup_id;
+	struct slo_cfg base;  /* Base the trace gave last */
+	struct slo_cfg cur;   /* Value in the simulated map */
+};
+
+static struct sim_entry *find_sim(struct sim_entry *m, size_t nr, __u64 id)
+{
+	size_t lo = 0, hi = nr;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (m[mid].cgroup_id < id)
+			lo = mid + 1;
+		else if (m[mid].cgroup_id > id)
+			hi = mid;
+		else
+			return &m[mid];
+	}
+	return NULL;
+}
+
+int budget_ctl_replay(struct budget_ctl *c, FILE *f, budget_ctl_replay_fn fn, void *ctx)
+{
+	struct budget_ctl_sample *s = NULL;
+	struct budget_ctl_update *u = NULL;
+	struct sim_entry *map = NULL, *next;
+	size_t nr, cap = 0, nr_map = 0, u_cap = 0;
+	__u64 interval;
+	int steps = 0, ret, n;
+
+	while ((ret = budget_ctl_trace_read(f, &interval, &s, &nr, &cap)) == 1) {
+		qsort(s, nr, sizeof(*s), cmp_sample);
+
+		next = malloc((nr + 1) * sizeof(*next));
+		if (nr > u_cap) {
+			struct budget_ctl_update *grown = realloc(u, nr * sizeof(*u));
+
+			if (grown) {
+				u = grown;
+				u_cap = nr;
+			}
+		}
+		if (!next || nr > u_cap) {
+			free(next);
+			ret = -1;
+			break;
+		}
+
+		for (size_t i = 0; i < nr; i++) {
+			struct sim_entry *m = find_sim(map, nr_map, s[i].cgroup_id);
+
+			next[i].cgroup_id = s[i].cgroup_id;
+			next[i].base = s[i].cfg;
+			next[i].cur = m && cfg_eq(&m->base, &s[i].cfg) ? m->cur : s[i].cfg;
+			s[i].cfg = next[i].cur;
+		}
+		free(map);
+		map = next;
+		nr_map = nr;
+
+		n = budget_ctl_step(c, s, nr, u);
+		if (n < 0) {
+			ret = -1;
+			break;
+		}
+		for (int i = 0; i < n; i++) {
+			struct sim_entry *m = find_sim(map, nr_map, u[i].cgroup_id);
+
+			if (m && cfg_eq(&m->cur, &u[i].expected))
+				m->cur = u[i].cfg;
+		}
+		if (fn)
+			fn(steps, s, nr, u, n, ctx);
+		steps++;
+	}
+
+	free(s);
+	free(u);
+	free(map);
+	return ret < 0 ? -1 : steps;
+}
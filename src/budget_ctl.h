@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Adaptive SLO budgets for scx-slo
+ *
+ * A PI(D) controller per SLO map entry, run by the agent once per
+ * interval. It reads the run statistics the scheduler keeps per configured
+ * cgroup (struct slo_cgrp_stats) and scales the entry's budget between
+ * scale_min and scale_max of the configured value, so that no more than
+ * the target fraction of runs end past their deadline. A cgroup that
+ * still misses with its budget at the floor is boosted in importance
+ * instead. The configured entry is the base; the controller only ever
+ * writes base * scale, and a write by anyone else becomes the new base.
+ * Misses are always counted against the base's deadline: for each
+ * adjusted entry the agent publishes a struct slo_target.
+ *
+ * The controller is plain arithmetic over samples and knows nothing of
+ * BPF, so it can be driven offline from a recorded trace.
+ */
+#ifndef __SCX_SLO_BUDGET_CTL_H
+#define __SCX_SLO_BUDGET_CTL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "scx_slo.h"
+
+#define BUDGET_CTL_TRACE_MAX 256
+
+struct budget_ctl_params {
+	double target;        /* Fraction of runs that may miss their deadline */
+	double kp, ki, kd;    /* Gains on the normalized miss error, in scale units */
+	double scale_min;     /* Floor of the budget, as a fraction of the configured one */
+	double scale_max;     /* Ceiling; 1 never loosens past the configured budget */
+	double max_step;      /* Largest scale change per interval */
+	double min_slack;     /* Mean slack, per deadline window, needed to loosen */
+	double integral_max;  /* Bound of the integral term */
+	__u32 min_runs;       /* Runs per interval below which the entry is held */
+	__u32 boost_max;      /* Importance added at most while the budget is at the floor */
+	__u32 boost_step;     /* Importance added or removed per interval */
+	__u32 interval_sec;   /* Time between two steps */
+	char trace[BUDGET_CTL_TRACE_MAX]; /* File to record samples to, or empty */
+};
+
+/* One SLO map entry and the cumulative statistics of its runs */
+struct budget_ctl_sample {
+	__u64 cgroup_id;
+	struct slo_cfg cfg;   /* Value in the SLO map, or the base in traces */
+	struct slo_cgrp_stats stats;
+};
+
+/* Write @cfg if the entry still holds @expected */
+struct budget_ctl_update {
+	__u64 cgroup_id;
+	struct slo_cfg expected;
+	struct slo_cfg cfg;
+};
+
+/* Deadline window of the base behind an adjusted entry */
+struct budget_ctl_target {
+	__u64 cgroup_id;
+	struct slo_target target;
+};
+
+struct budget_ctl_stats {
+	__u32 tracked;        /* Entries followed */
+	__u32 adjusted;       /* Entries whose value differs from their base */
+	__u32 saturated;      /* Entries missing at the budget floor */
+	__u64 updates;        /* Updates returned by budget_ctl_step() */
+	__u64 rebased;        /* Entries another writer changed */
+};
+
+struct budget_ctl;
+
+void budget_ctl_params_default(struct budget_ctl_params *p);
+
+/*
+ * Parse @spec (see spec_parse.h) into @p. Keys: target, kp, ki, kd,
+ * scale_min, scale_max, max_step, min_slack, integral_max, min_runs,
+ * boost_max, boost_step, interval and trace.
+ */
+int budget_ctl_parse(struct budget_ctl_params *p, const char *spec);
+
+struct budget_ctl *budget_ctl_new(const struct budget_ctl_params *p);
+void budget_ctl_free(struct budget_ctl *c);
+
+/*
+ * Advance every entry by one interval. @s holds each SLO map entry once,
+ * with zeroed stats if it has none yet, and is sorted by cgroup ID in
+ * place. Entries missing from @s are forgotten. Up to @nr updates are
+ * written to @out; returns their number, or -ENOMEM.
+ */
+int budget_ctl_step(struct budget_ctl *c, struct budget_ctl_sample *s, size_t nr,
+		    struct budget_ctl_update *out);
+
+/*
+ * The configured value behind @cur, the entry's value in the map, for
+ * readers that must not see the controller's adjustments. Returns false
+ * and copies @cur if the controller does not own the value.
+ */
+bool budget_ctl_base(struct budget_ctl *c, __u64 cgroup_id, const struct slo_cfg *cur,
+		     struct slo_cfg *base);
+
+void budget_ctl_get_stats(struct budget_ctl *c, struct budget_ctl_stats *out);
+
+/*
+ * Write the target of every adjusted entry, at most @max, to @out.
+ * Returns their number.
+ */
+size_t budget_ctl_targets(struct budget_ctl *c, struct budget_ctl_target *out, size_t max);
+
+/*
+ * Updates that put every adjusted entry back to its base, at most @max,
+ * for when the controller stops. Returns their number.
+ */
+size_t budget_ctl_restore(struct budget_ctl *c, struct budget_ctl_update *out, size_t max);
+
+/*
+ * Traces are text: a "T interval_ns count" line per step, then one line
+ * "C cgroup_id budget_ns importance flags runs late lateness_ns slack_ns
+ * runtime_ns" per sample, with the base config of the entry. Lines
+ * starting with '#' are comments.
+ */
+int budget_ctl_trace_write(FILE *f, __u64 interval_ns, const struct budget_ctl_sample *s,
+			   size_t nr);
+
+/*
+ * Read the next step of a trace into *@s, which is grown with realloc.
+ * Returns 1, 0 at the end of the trace, or -1 if it is malformed.
+ */
+int budget_ctl_trace_read(FILE *f, __u64 *interval_ns, struct budget_ctl_sample **s,
+			  size_t *nr, size_t *cap);
+
+/* Called after each replayed step with the samples as stepped and the updates */
+typedef void (*budget_ctl_replay_fn)(unsigned int step, const struct budget_ctl_sample *s,
+				     size_t nr, const struct budget_ctl_update *u,
+				     size_t nr_u, void *ctx);
+
+/*
+ * Drive @c from the trace in @f against a simulated SLO map: each entry
+ * starts at its base, takes the controller's updates, and is reset when
+ * the trace's base changes. Returns the number of steps, or -1.
+ */
+int budget_ctl_replay(struct budget_ctl *c, FILE *f, budget_ctl_replay_fn fn, void *ctx);
+
+#endif /* __SCX_SLO_BUDGET_CTL_H */
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Burst learning for scx-slo
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "burst.h"
+#include "spec_parse.h"
+
+void burst_params_default(struct burst_params *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->shift = 3;
+	p->min_samples = 4;
+	p->short_ns = 1000000;
+	p->boost = 50;
+	p->slice_mult = 2;
+	p->slice_min_ns = 250000;
+}
+
+static const struct spec_key burst_keys[] = {
+	SPEC_KEY_U32("shift", struct burst_params, shift, 0, 8),
+	SPEC_KEY_U32("min_samples", struct burst_params, min_samples, 1, 1000),
+	SPEC_KEY_US("short_us", struct burst_params, short_ns, 0, 1000000),
+	SPEC_KEY_U32("boost", struct burst_params, boost, 0, 100),
+	SPEC_KEY_U32("slice_mult", struct burst_params, slice_mult, 1, 100),
+	SPEC_KEY_US("slice_min_us", struct burst_params, slice_min_ns, 10, 1000000),
+};
+
+static const struct spec_def burst_spec = {
+	.what = "burst learning",
+	.keys = burst_keys,
+	.nr_keys = SPEC_NR_KEYS(burst_keys),
+	.size = sizeof(struct burst_params),
+};
+
+int burst_parse(struct burst_params *p, const char *spec)
+{
+	return spec_parse(&burst_spec, p, spec);
+}
+
+void burst_running(struct slo_task_burst *b, __u64 now)
+{
+	if (!b->act_start)
+		b->act_start = now;
+	b->run_start = now;
+}
+
+/* @avg moved 1 / 2^shift of the way to @sample; the first sample is taken as is */
+static __u64 ewma(__u64 avg, __u64 sample, __u32 shift)
+{
+	if (!avg)
+		return sample;
+	return avg - (avg >> shift) + (sample >> shift);
+}
+
+void burst_stopping(const struct burst_params *p, struct slo_task_burst *b, __u64 now,
+		    bool runnable)
+{
+	if (b->run_start && now > b->run_start)
+		b->act_ns += now - b->run_start;
+	b->run_start = 0;
+	if (runnable || !b->act_start)
+		return;
+
+	b->burst_ns = ewma(b->burst_ns, b->act_ns, p->shift);
+	if (b->last_start && b->act_start > b->last_start)
+		b->interval_ns = ewma(b->interval_ns, b->act_start - b->last_start, p->shift);
+	if (b->samples < ~0U)
+		b->samples++;
+	b->last_start = b->act_start;
+	b->act_start = 0;
+	b->act_ns = 0;
+}
+
+bool burst_learned(const struct burst_params *p, const struct slo_task_burst *b)
+{
+	return b->samples >= p->min_samples;
+}
+
+__u64 burst_slice(const struct burst_params *p, const struct slo_task_burst *b,
+		  __u64 class_slice_ns)
+{
+	__u64 slice;
+
+	if (!burst_learned(p, b))
+		return class_slice_ns;
+	slice = b->burst_ns * p->slice_mult;
+	if (slice < p->slice_min_ns)
+		slice = p->slice_min_ns;
+	return slice < class_slice_ns ? slice : class_slice_ns;
+}
+
+bool burst_short(const struct burst_params *p, const struct slo_task_burst *b)
+{
+	return burst_learned(p, b) && b->burst_ns < p->short_ns &&
+	       b->interval_ns >= 2 * b->burst_ns;
+}
+
+__u64 burst_vtime(const struct burst_params *p, const struct slo_task_burst *b, __u64 deadline,
+		  __u64 window_ns)
+{
+	__u64 ahead = window_ns * p->boost / 100;
+
+	if (!burst_short(p, b))
+		return deadline;
+	return deadline > ahead ? deadline - ahead : 0;
+}
+
+bool burst_predict(const struct burst_params *p, const struct slo_task_burst *b,
+		   __u64 slack_ns)
+{
+	return burst_learned(p, b) && b->burst_ns > b->act_ns &&
+	       b->burst_ns - b->act_ns > slack_ns;
+}
+
+void burst_stats_sum(struct slo_burst_stats *out, const struct slo_burst_stats *percpu,
+		     int nr_cpus)
+{
+	memset(out, 0, sizeof(*out));
+	for (int cpu = 0; cpu < nr_cpus; cpu++) {
+		out->runs += percpu[cpu].runs;
+		out->late += percpu[cpu].late;
+		out->predicted += percpu[cpu].predicted;
+		out->predicted_late += percpu[cpu].predicted_late;
+		out->boosted += percpu[cpu].boosted;
+	}
+}
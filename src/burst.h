@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Burst learning for scx-slo
+ *
+ * The scheduler keeps, per task, an EWMA of the CPU time of each
+ * activation (the burst, from the first run after a wakeup until the task
+ * sleeps) and of the time between activations, updated when the task
+ * stops running. Once a task has min_samples activations behind it:
+ *
+ *   - its slice is slice_mult times its burst, within slice_min and the
+ *     slice of its latency class, so a task that overruns its usual burst
+ *     goes back to the queue sooner;
+ *   - if its burst is below short_ns and it sleeps at least as long as it
+ *     runs, its queue position moves boost percent of its deadline window
+ *     ahead, so short requests do not wait behind long ones with similar
+ *     deadlines; the deadline it is judged against does not change;
+ *   - a run is predicted to miss when the rest of its expected burst
+ *     exceeds the slack left as it starts. The prediction only feeds the
+ *     accuracy counters; scheduling does not act on it.
+ *
+ * The policy is fixed before load. These helpers parse its tuning and
+ * mirror the computation for tests and the trace-driven benchmark.
+ */
+#ifndef __SCX_SLO_BURST_H
+#define __SCX_SLO_BURST_H
+
+#include <stdbool.h>
+#include "scx_slo.h"
+
+struct burst_params {
+	__u32 shift;          /* EWMA weight of a new sample is 1 / 2^shift */
+	__u32 min_samples;    /* Activations before the burst is used */
+	__u64 short_ns;       /* Bursts below this count as short */
+	__u32 boost;          /* Percent of the window short bursts move ahead */
+	__u32 slice_mult;     /* Slice as a multiple of the burst */
+	__u64 slice_min_ns;   /* Shortest slice given */
+};
+
+void burst_params_default(struct burst_params *p);
+
+/*
+ * Parse @spec (see spec_parse.h) into @p. Keys: shift, min_samples,
+ * short_us, boost, slice_mult and slice_min_us.
+ */
+int burst_parse(struct burst_params *p, const char *spec);
+
+/* @b's task starts running at @now */
+void burst_running(struct slo_task_burst *b, __u64 now);
+
+/*
+ * @b's task stops running at @now; unless @runnable it goes to sleep,
+ * which ends the activation and adds it to the averages
+ */
+void burst_stopping(const struct burst_params *p, struct slo_task_burst *b, __u64 now,
+		    bool runnable);
+
+/* Whether @b has seen enough activations to be used */
+bool burst_learned(const struct burst_params *p, const struct slo_task_burst *b);
+
+/* Slice for @b's task, whose class gives it @class_slice_ns */
+__u64 burst_slice(const struct burst_params *p, const struct slo_task_burst *b,
+		  __u64 class_slice_ns);
+
+/* Whether @b's task runs short bursts and sleeps at least as long */
+bool burst_short(const struct burst_params *p, const struct slo_task_burst *b);
+
+/* Queue position of @b's task with @deadline, @window_ns after its enqueue */
+__u64 burst_vtime(const struct burst_params *p, const struct slo_task_burst *b, __u64 deadline,
+		  __u64 window_ns);
+
+/* Whether a run starting with @slack_ns to its deadline is expected to miss it */
+bool burst_predict(const struct burst_params *p, const struct slo_task_burst *b,
+		   __u64 slack_ns);
+
+/* Add up @nr_cpus per-CPU copies of the prediction counters */
+void burst_stats_sum(struct slo_burst_stats *out, const struct slo_burst_stats *percpu,
+		     int nr_cpus);
+
+#endif /* __SCX_SLO_BURST_H */
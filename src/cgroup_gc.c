@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Stale SLO entry collection for scx-slo
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include "cgroup_gc.h"
+
+#ifndef MAX_HANDLE_SZ
+#define MAX_HANDLE_SZ 128
+#endif
+
+/* kernfs file handles: the 64-bit node ID, which is the cgroup ID */
+#ifndef FILEID_KERNFS
+#define FILEID_KERNFS 0xfe
+#endif
+
+int cgroup_id_alive(int root_fd, __u64 id)
+{
+	struct {
+		struct file_handle handle;
+		__u64 id;
+	} fh = {
+		.handle.handle_bytes = sizeof(__u64),
+		.handle.handle_type = FILEID_KERNFS,
+	};
+	int fd;
+
+	memcpy(fh.handle.f_handle, &id, sizeof(id));
+	fd = open_by_handle_at(root_fd, &fh.handle, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd >= 0) {
+		close(fd);
+		return 1;
+	}
+	/* kernfs reports a node that no longer exists as a stale handle */
+	if (errno == ESTALE || errno == ENOENT)
+		return 0;
+	return -errno;
+}
+
+int cgroup_gc_open_root(const char *root)
+{
+	struct {
+		struct file_handle handle;
+		unsigned char buf[MAX_HANDLE_SZ];
+	} fh = { .handle.handle_bytes = MAX_HANDLE_SZ };
+	struct statfs sfs;
+	int fd, mount_id, r;
+	__u64 id;
+
+	fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstatfs(fd, &sfs) != 0 || sfs.f_type != CGROUP2_SUPER_MAGIC) {
+		close(fd);
+		return -EMEDIUMTYPE;
+	}
+
+	/* The root cgroup must check out as live, or every answer is suspect */
+	if (name_to_handle_at(fd, "", &fh.handle, &mount_id, AT_EMPTY_PATH) != 0) {
+		r = -errno;
+		goto fail;
+	}
+	memcpy(&id, fh.handle.f_handle, sizeof(id));
+	r = cgroup_id_alive(fd, id);
+	if (r == 1)
+		return fd;
+	if (r == 0)
+		r = -ESTALE;
+fail:
+	close(fd);
+	return r;
+}
+
+int cgroup_alive_by_handle(__u64 id, void *ctx)
+{
+	return cgroup_id_alive(*(int *)ctx, id);
+}
+
+long cgroup_gc_partition(__u64 *ids, size_t nr, cgroup_alive_fn alive, void *ctx)
+{
+	__u64 *sorted;
+	size_t nr_dead = 0, nr_live = 0;
+
+	if (!nr)
+		return 0;
+	sorted = malloc(nr * sizeof(*sorted));
+	if (!sorted)
+		return -ENOMEM;
+
+	/* Dead IDs fill @sorted from the front, live ones from the back */
+	for (size_t i = 0; i < nr; i++) {
+		int r = alive(ids[i], ctx);
+
+		if (r < 0) {
+			free(sorted);
+			return r;
+		}
+		if (r)
+			sorted[nr - ++nr_live] = ids[i];
+		else
+			sorted[nr_dead++] = ids[i];
+	}
+
+	/* Live IDs went in reversed; restore their order */
+	memcpy(ids, sorted, nr_dead * sizeof(*ids));
+	for (size_t i = 0; i < nr_live; i++)
+		ids[nr_dead + i] = sorted[nr - 1 - i];
+	free(sorted);
+	return nr_dead;
+}
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Stale SLO entry collection for scx-slo
+ *
+ * SLO map entries are keyed by cgroup ID, and nothing removes an entry
+ * when its cgroup goes away: on nodes with pod churn the map fills with
+ * dead IDs until new pods stop getting SLOs. The scheduler drops entries
+ * in its cgroup_exit callback; this sweep catches whatever that missed
+ * (kernels without cgroup callbacks, cgroups removed while no scheduler
+ * was attached). A cgroup ID is live if the kernel can still open it by
+ * handle, which needs no walk of the hierarchy.
+ */
+#ifndef __SCX_SLO_CGROUP_GC_H
+#define __SCX_SLO_CGROUP_GC_H
+
+#include <stddef.h>
+#include "scx_slo.h"
+
+/* Seconds between sweeps of the SLO map */
+#define CGROUP_GC_INTERVAL_SEC 60
+
+/*
+ * Open the cgroup2 mount at @root for liveness checks. Fails with
+ * -EMEDIUMTYPE if @root is not cgroup2, where handles are not cgroup IDs,
+ * or with the error of a check of the root cgroup itself (-EPERM without
+ * CAP_DAC_READ_SEARCH). Returns the fd or -errno.
+ */
+int cgroup_gc_open_root(const char *root);
+
+/* Returns 1 if cgroup @id exists, 0 if it is gone, or -errno if unknown */
+typedef int (*cgroup_alive_fn)(__u64 id, void *ctx);
+
+/*
+ * Whether cgroup @id exists on the cgroup2 mount @root_fd is on. Needs
+ * CAP_DAC_READ_SEARCH; returns -EPERM without it.
+ */
+int cgroup_id_alive(int root_fd, __u64 id);
+
+/* cgroup_alive_fn for cgroup_id_alive(), with the root fd in @ctx (an int *) */
+int cgroup_alive_by_handle(__u64 id, void *ctx);
+
+/*
+ * Move the IDs of removed cgroups to the front of @ids, in their original
+ * order, and return how many there are. Stops at the first ID whose
+ * liveness cannot be told and returns its -errno, with @ids unchanged, so
+ * a missing capability never deletes live entries.
+ */
+long cgroup_gc_partition(__u64 *ids, size_t nr, cgroup_alive_fn alive, void *ctx);
+
+#endif /* __SCX_SLO_CGROUP_GC_H */
@@ -0,0 +1,780 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Cgroup ID reverse index for scx-slo
+ *
+ * The index is an open-addressing hash table keyed by cgroup ID. A second
+ * table maps inotify watch descriptors back to cgroup IDs so that removal
+ * (IN_IGNORED after rmdir) can be resolved without a path lookup.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/inotify.h>
+#include "cgroup_index.h"
+#include "cgroup_resolve.h"
+#include "log.h"
+
+#define INDEX_INITIAL_CAP 1024         /* Must be a power of two */
+#define INDEX_MAX_DEPTH   32           /* Recursion bound for the walk */
+#define WATCH_MASK (IN_CREATE | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR)
+
+/* Slot markers for open addressing; real cgroup IDs are never 0 or ~0 */
+#define SLOT_EMPTY     0ULL
+#define SLOT_TOMBSTONE (~0ULL)
+
+struct index_entry {
+	__u64 id;
+	char *path;
+	char pod[CGROUP_INDEX_POD_MAX];
+	char namespace[CGROUP_INDEX_NS_MAX];
+	__u64 deadline_misses;
+	__u64 miss_duration_ns;
+	__u32 seen;                /* Walk generation, for overflow resync */
+	__u32 idle;                /* Unresolved: expiry passes since the last miss */
+};
+
+/* Cgroup that appeared after the callback was registered */
+struct created_entry {
+	__u64 id;
+	char *path;
+};
+
+struct watch_entry {
+	int wd;                    /* 0 = empty, -1 = tombstone */
+	__u64 id;
+};
+
+struct cgroup_index {
+	pthread_mutex_t lock;
+	char root[PATH_MAX];
+	int inotify_fd;
+	int handle_type;           /* File handle type of the cgroupfs mount */
+	int mount_fd;              /* Root directory, for open_by_handle_at() */
+	__u32 walk_gen;
+
+	size_t nr_unresolved;      /* Entries without a path, recounted on expiry */
+	__u64 expired_misses;      /* Misses of unresolved entries no longer kept */
+	__u64 expired_miss_ns;
+
+	struct index_entry *entries;
+	size_t cap;
+	size_t used;               /* Live entries */
+	size_t filled;             /* Live entries plus tombstones */
+
+	struct watch_entry *watches;
+	size_t watch_cap;
+	size_t watch_filled;
+
+	cgroup_index_create_fn create_fn;
+	void *create_ctx;
+	struct created_entry *created;  /* Queued for create_fn, run unlocked */
+	size_t nr_created;
+	size_t created_cap;
+};
+
+/* splitmix64 finalizer - cgroup IDs are sequential so they need mixing */
+static inline size_t hash_id(__u64 id)
+{
+	id ^= id >> 30;
+	id *= 0xbf58476d1ce4e5b9ULL;
+	id ^= id >> 27;
+	id *= 0x94d049bb133111ebULL;
+	id ^= id >> 31;
+	return (size_t)id;
+}
+
+static struct index_entry *find_entry(struct cgroup_index *idx, __u64 id)
+{
+	size_t mask = idx->cap - 1;
+
+	for (size_t i = hash_id(id) & mask, n = 0; n < idx->cap; i = (i + 1) & mask, n++) {
+		struct index_entry *e = &idx->entries[i];
+
+		if (e->id == SLOT_EMPTY)
+			return NULL;
+		if (e->id == id)
+			return e;
+	}
+	return NULL;
+}
+
+static int resize_entries(struct cgroup_index *idx, size_t new_cap)
+{
+	struct index_entry *old = idx->entries;
+	size_t old_cap = idx->cap;
+	struct index_entry *tbl = calloc(new_cap, sizeof(*tbl));
+
+	if (!tbl)
+		return -ENOMEM;
+
+	for (size_t i = 0; i < old_cap; i++) {
+		if (old[i].id == SLOT_EMPTY || old[i].id == SLOT_TOMBSTONE)
+			continue;
+		size_t j = hash_id(old[i].id) & (new_cap - 1);
+		while (tbl[j].id != SLOT_EMPTY)
+			j = (j + 1) & (new_cap - 1);
+		tbl[j] = old[i];
+	}
+
+	free(old);
+	idx->entries = tbl;
+	idx->cap = new_cap;
+	idx->filled = idx->used;
+	return 0;
+}
+
+/* Insert or fetch the entry for @id. Returns NULL on allocation failure. */
+static struct index_entry *get_or_insert(struct cgroup_index *idx, __u64 id)
+{
+	struct index_entry *e = find_entry(idx, id);
+
+	if (e)
+		return e;
+
+	/* Keep load (including tombstones) under 70% */
+	if ((idx->filled + 1) * 10 > idx->cap * 7) {
+		size_t new_cap = idx->used * 2 >= idx->cap ? idx->cap * 2 : idx->cap;
+		if (resize_entries(idx, new_cap) != 0)
+			return NULL;
+	}
+
+	size_t mask = idx->cap - 1;
+	size_t i = hash_id(id) & mask;
+	while (idx->entries[i].id != SLOT_EMPTY && idx->entries[i].id != SLOT_TOMBSTONE)
+		i = (i + 1) & mask;
+
+	e = &idx->entries[i];
+	if (e->id == SLOT_EMPTY)
+		idx->filled++;
+	memset(e, 0, sizeof(*e));
+	e->id = id;
+	idx->used++;
+	return e;
+}
+
+static void remove_entry(struct cgroup_index *idx, struct index_entry *e)
+{
+	free(e->path);
+	memset(e, 0, sizeof(*e));
+	e->id = SLOT_TOMBSTONE;
+	idx->used--;
+}
+
+static struct watch_entry *find_watch(struct cgroup_index *idx, int wd)
+{
+	size_t mask = idx->watch_cap - 1;
+
+	for (size_t i = hash_id((__u64)wd) & mask, n = 0; n < idx->watch_cap;
+	     i = (i + 1) & mask, n++) {
+		struct watch_entry *w = &idx->watches[i];
+
+		if (w->wd == 0)
+			return NULL;
+		if (w->wd == wd)
+			return w;
+	}
+	return NULL;
+}
+
+static int set_watch(struct cgroup_index *idx, int wd, __u64 id)
+{
+	struct watch_entry *w = find_watch(idx, wd);
+
+	if (w) {
+		w->id = id;
+		return 0;
+	}
+
+	if ((idx->watch_filled + 1) * 10 > idx->watch_cap * 7) {
+		size_t new_cap = idx->watch_cap * 2;
+		struct watch_entry *tbl = calloc(new_cap, sizeof(*tbl));
+
+		if (!tbl)
+			return -ENOMEM;
+		idx->watch_filled = 0;
+		for (size_t i = 0; i < idx->watch_cap; i++) {
+			if (idx->watches[i].wd <= 0)
+				continue;
+			size_t j = hash_id((__u64)idx->watches[i].wd) & (new_cap - 1);
+			while (tbl[j].wd != 0)
+				j = (j + 1) & (new_cap - 1);
+			tbl[j] = idx->watches[i];
+			idx->watch_filled++;
+		}
+		free(idx->watches);
+		idx->watches = tbl;
+		idx->watch_cap = new_cap;
+	}
+
+	size_t mask = idx->watch_cap - 1;
+	size_t i = hash_id((__u64)wd) & mask;
+	while (idx->watches[i].wd > 0)
+		i = (i + 1) & mask;
+	if (idx->watches[i].wd == 0)
+		idx->watch_filled++;
+	idx->watches[i].wd = wd;
+	idx->watches[i].id = id;
+	return 0;
+}
+
+bool cgroup_path_to_pod_uid(const char *path, char *uid, size_t uid_len)
+{
+	bool under_kubepods = false;
+	const char *p = path;
+
+	while (*p) {
+		while (*p == '/')
+			p++;
+		const char *end = strchrnul(p, '/');
+		size_t len = end - p;
+		const char *start = NULL;
+		size_t ulen = 0;
+
+		if (len >= 8 && strncmp(p, "kubepods", 8) == 0)
+			under_kubepods = true;
+
+		if (len > 6 && strncmp(end - 6, ".slice", 6) == 0) {
+			/* systemd driver: kubepods[-qos]-pod<uid_with_underscores>.slice */
+			const char *pod = memmem(p, len, "-pod", 4);
+			if (pod) {
+				start = pod + 4;
+				ulen = (end - 6) - start;
+			}
+		} else if (under_kubepods && len > 3 && strncmp(p, "pod", 3) == 0) {
+			/* cgroupfs driver: /kubepods/<qos>/pod<uid> */
+			start = p + 3;
+			ulen = len - 3;
+		}
+
+		if (start && ulen > 0 && ulen < uid_len) {
+			bool valid = true;
+
+			for (size_t i = 0; i < ulen; i++) {
+				char c = start[i];
+				if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+				      (c >= 'A' && c <= 'F') || c == '-' || c == '_')) {
+					valid = false;
+					break;
+				}
+			}
+			if (valid) {
+				for (size_t i = 0; i < ulen; i++)
+					uid[i] = start[i] == '_' ? '-' : start[i];
+				uid[ulen] = '\0';
+				return true;
+			}
+		}
+		p = end;
+	}
+
+	return false;
+}
+
+/* Queue a newly seen cgroup for the creation callback. Caller holds the lock. */
+static void queue_created(struct cgroup_index *idx, __u64 id, const char *rel_path)
+{
+	if (idx->nr_created == idx->created_cap) {
+		size_t new_cap = idx->created_cap ? idx->created_cap * 2 : 16;
+		struct created_entry *tbl = realloc(idx->created, new_cap * sizeof(*tbl));
+
+		if (!tbl)
+			return;
+		idx->created = tbl;
+		idx->created_cap = new_cap;
+	}
+
+	char *copy = strdup(rel_path);
+
+	if (!copy)
+		return;
+	idx->created[idx->nr_created].id = id;
+	idx->created[idx->nr_created].path = copy;
+	idx->nr_created++;
+}
+
+/*
+ * Run the creation callback for queued cgroups. Called without the lock so
+ * the callback may take its own locks and query the index.
+ */
+static void flush_created(struct cgroup_index *idx)
+{
+	struct created_entry *list;
+	cgroup_index_create_fn fn;
+	void *ctx;
+	size_t nr;
+
+	pthread_mutex_lock(&idx->lock);
+	list = idx->created;
+	nr = idx->nr_created;
+	fn = idx->create_fn;
+	ctx = idx->create_ctx;
+	idx->created = NULL;
+	idx->nr_created = 0;
+	idx->created_cap = 0;
+	pthread_mutex_unlock(&idx->lock);
+
+	for (size_t i = 0; i < nr; i++) {
+		if (fn)
+			fn(list[i].id, list[i].path, ctx);
+		free(list[i].path);
+	}
+	free(list);
+}
+
+/* Record one cgroup. Caller holds the lock. */
+static int index_add(struct cgroup_index *idx, __u64 id, const char *rel_path)
+{
+	struct index_entry *e;
+	bool fresh;
+
+	if (id == SLOT_EMPTY || id == SLOT_TOMBSTONE)
+		return -EINVAL;
+
+	e = get_or_insert(idx, id);
+	if (!e)
+		return -ENOMEM;
+	fresh = !e->path;
+
+	if (!e->path || strcmp(e->path, rel_path) != 0) {
+		char *copy = strdup(rel_path);
+
+		if (!copy)
+			return -ENOMEM;
+		free(e->path);
+		e->path = copy;
+		if (!cgroup_path_to_pod_uid(rel_path, e->pod, sizeof(e->pod)))
+			e->pod[0] = '\0';
+	}
+	e->seen = idx->walk_gen;
+	if (fresh && idx->create_fn)
+		queue_created(idx, id, rel_path);
+	return 0;
+}
+
+static void join_path(char *out, size_t len, const char *parent, const char *name)
+{
+	if (strcmp(parent, "/") == 0)
+		snprintf(out, len, "/%s", name);
+	else
+		snprintf(out, len, "%s/%s", parent, name);
+}
+
+/*
+ * Index @fd (already opened at @rel_path) and everything below it.
+ * Consumes @fd. Caller holds the lock.
+ */
+static int index_walk(struct cgroup_index *idx, int fd, const char *rel_path, int depth)
+{
+	char full[PATH_MAX + CGROUP_INDEX_PATH_MAX];
+	int count = 0;
+	__u64 id;
+	DIR *dir;
+	struct dirent *de;
+
+	id = cgroup_handle_id(fd, "", AT_EMPTY_PATH, depth == 0 ? &idx->handle_type : NULL);
+	if (index_add(idx, id, rel_path) == 0)
+		count++;
+
+	if (idx->inotify_fd >= 0) {
+		snprintf(full, sizeof(full), "%s%s", idx->root,
+			 strcmp(rel_path, "/") == 0 ? "" : rel_path);
+		int wd = inotify_add_watch(idx->inotify_fd, full, WATCH_MASK);
+		if (wd > 0)
+			set_watch(idx, wd, id);
+		else if (errno == ENOSPC)
+			log_msg(LOG_WARN, "inotify watch limit reached at %s", full);
+	}
+
+	if (depth >= INDEX_MAX_DEPTH) {
+		close(fd);
+		return count;
+	}
+
+	dir = fdopendir(fd);
+	if (!dir) {
+		close(fd);
+		return count;
+	}
+
+	while ((de = readdir(dir)) != NULL) {
+		char child_rel[CGROUP_INDEX_PATH_MAX];
+		struct stat st;
+
+		if (de->d_name[0] == '.' &&
+		    (de->d_name[1] == '\0' || (de->d_name[1] == '.' && de->d_name[2] == '\0')))
+			continue;
+		if (de->d_type != DT_DIR) {
+			if (de->d_type != DT_UNKNOWN)
+				continue;
+			if (fstatat(dirfd(dir), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+			    !S_ISDIR(st.st_mode))
+				continue;
+		}
+
+		int child = openat(dirfd(dir), de->d_name,
+				   O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+		if (child < 0)
+			continue;
+
+		join_path(child_rel, sizeof(child_rel), rel_path, de->d_name);
+		count += index_walk(idx, child, child_rel, depth + 1);
+	}
+
+	closedir(dir);
+	return count;
+}
+
+struct cgroup_index *cgroup_index_new(const char *root)
+{
+	struct cgroup_index *idx = calloc(1, sizeof(*idx));
+
+	if (!idx)
+		return NULL;
+
+	idx->entries = calloc(INDEX_INITIAL_CAP, sizeof(*idx->entries));
+	idx->watches = calloc(INDEX_INITIAL_CAP, sizeof(*idx->watches));
+	if (!idx->entries || !idx->watches) {
+		free(idx->entries);
+		free(idx->watches);
+		free(idx);
+		return NULL;
+	}
+
+	pthread_mutex_init(&idx->lock, NULL);
+	snprintf(idx->root, sizeof(idx->root), "%s", root);
+	idx->cap = INDEX_INITIAL_CAP;
+	idx->watch_cap = INDEX_INITIAL_CAP;
+	idx->inotify_fd = -1;
+	idx->mount_fd = -1;
+	idx->handle_type = -1;
+	return idx;
+}
+
+int cgroup_index_build(struct cgroup_index *idx)
+{
+	int fd, count;
+
+	fd = open(idx->root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (idx->inotify_fd < 0) {
+		idx->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (idx->inotify_fd < 0)
+			log_msg(LOG_WARN, "inotify unavailable (%s), index will not track changes",
+				strerror(errno));
+	}
+	if (idx->mount_fd < 0)
+		idx->mount_fd = open(idx->root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	pthread_mutex_lock(&idx->lock);
+	idx->walk_gen++;
+	count = index_walk(idx, fd, "/", 0);
+
+	/* Drop entries that vanished since the previous walk (overflow resync) */
+	for (size_t i = 0; i < idx->cap; i++) {
+		struct index_entry *e = &idx->entries[i];
+
+		if (e->id != SLOT_EMPTY && e->id != SLOT_TOMBSTONE &&
+		    e->path && e->seen != idx->walk_gen)
+			remove_entry(idx, e);
+	}
+	pthread_mutex_unlock(&idx->lock);
+	flush_created(idx);
+
+	return count;
+}
+
+void cgroup_index_on_create(struct cgroup_index *idx, cgroup_index_create_fn fn, void *ctx)
+{
+	pthread_mutex_lock(&idx->lock);
+	idx->create_fn = fn;
+	idx->create_ctx = ctx;
+	pthread_mutex_unlock(&idx->lock);
+}
+
+int cgroup_index_fd(const struct cgroup_index *idx)
+{
+	return idx->inotify_fd;
+}
+
+/* Handle one inotify event. Caller holds the lock. */
+static void handle_inotify_event(struct cgroup_index *idx, const struct inotify_event *ev)
+{
+	struct watch_entry *w = find_watch(idx, ev->wd);
+
+	if (!w)
+		return;
+
+	if (ev->mask & IN_IGNORED) {
+		/* Directory removed (or watch dropped): forget the cgroup */
+		struct index_entry *e = find_entry(idx, w->id);
+
+		if (e)
+			remove_entry(idx, e);
+		w->wd = -1;
+		return;
+	}
+
+	if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) && (ev->mask & IN_ISDIR) && ev->len) {
+		struct index_entry *parent = find_entry(idx, w->id);
+		char child_rel[CGROUP_INDEX_PATH_MAX];
+		char full[PATH_MAX + CGROUP_INDEX_PATH_MAX];
+
+		if (!parent || !parent->path)
+			return;
+
+		join_path(child_rel, sizeof(child_rel), parent->path, ev->name);
+		snprintf(full, sizeof(full), "%s%s", idx->root, child_rel);
+
+		int fd = open(full, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+		if (fd < 0)
+			return;
+		/* Walk rather than add: children may appear before our watch does */
+		index_walk(idx, fd, child_rel, 1);
+	}
+}
+
+int cgroup_index_process_events(struct cgroup_index *idx)
+{
+	char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool overflow = false;
+	int handled = 0;
+
+	if (idx->inotify_fd < 0)
+		return 0;
+
+	for (;;) {
+		ssize_t len = read(idx->inotify_fd, buf, sizeof(buf));
+
+		if (len <= 0)
+			break;
+
+		pthread_mutex_lock(&idx->lock);
+		for (char *p = buf; p < buf + len;) {
+			const struct inotify_event *ev = (const struct inotify_event *)p;
+
+			if (ev->mask & IN_Q_OVERFLOW)
+				overflow = true;
+			else
+				handle_inotify_event(idx, ev);
+			handled++;
+			p += sizeof(*ev) + ev->len;
+		}
+		pthread_mutex_unlock(&idx->lock);
+		flush_created(idx);
+	}
+
+	/* Events were lost: fall back to a single resync walk */
+	if (overflow)
+		cgroup_index_build(idx);
+
+	return handled;
+}
+
+static void copy_info(const struct index_entry *e, struct cgroup_info *out)
+{
+	out->id = e->id;
+	snprintf(out->path, sizeof(out->path), "%s", e->path ? e->path : "");
+	snprintf(out->pod, sizeof(out->pod), "%s", e->pod);
+	snprintf(out->namespace, sizeof(out->namespace), "%s", e->namespace);
+	out->deadline_misses = e->deadline_misses;
+	out->miss_duration_ns = e->miss_duration_ns;
+}
+
+int cgroup_index_lookup(struct cgroup_index *idx, __u64 id, struct cgroup_info *out)
+{
+	int ret = -ENOENT;
+
+	pthread_mutex_lock(&idx->lock);
+	struct index_entry *e = find_entry(idx, id);
+	if (e) {
+		copy_info(e, out);
+		ret = 0;
+	}
+	pthread_mutex_unlock(&idx->lock);
+	return ret;
+}
+
+/*
+ * Resolve a cgroup ID that the walk has not seen (created and exited between
+ * inotify reads). Cgroup v2 file handles are the cgroup ID, so the directory
+ * can be opened directly and named through /proc/self/fd.
+ */
+static bool resolve_by_handle(struct cgroup_index *idx, __u64 id, char *rel, size_t len)
+{
+	struct {
+		struct file_handle handle;
+		unsigned char buf[sizeof(__u64)];
+	} fh;
+	char link[64], target[PATH_MAX];
+	size_t root_len = strlen(idx->root);
+	ssize_t n;
+	int fd;
+
+	if (idx->mount_fd < 0 || idx->handle_type < 0)
+		return false;
+
+	fh.handle.handle_bytes = sizeof(__u64);
+	fh.handle.handle_type = idx->handle_type;
+	memcpy(fh.handle.f_handle, &id, sizeof(id));
+
+	fd = open_by_handle_at(idx->mount_fd, &fh.handle, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+	n = readlink(link, target, sizeof(target) - 1);
+	close(fd);
+	if (n <= 0)
+		return false;
+	target[n] = '\0';
+
+	if (strncmp(target, idx->root, root_len) != 0)
+		return false;
+	snprintf(rel, len, "%s", target[root_len] ? target + root_len : "/");
+	return true;
+}
+
+void cgroup_index_record_miss(struct cgroup_index *idx, __u64 id, __u64 miss_ns)
+{
+	char rel[CGROUP_INDEX_PATH_MAX];
+	struct index_entry *e;
+	bool resolved = false;
+
+	if (id == SLOT_EMPTY || id == SLOT_TOMBSTONE)
+		return;
+
+	pthread_mutex_lock(&idx->lock);
+	e = find_entry(idx, id);
+	if (e) {
+		e->idle = 0;
+		e->deadline_misses++;
+		e->miss_duration_ns += miss_ns;
+		pthread_mutex_unlock(&idx->lock);
+		return;
+	}
+	pthread_mutex_unlock(&idx->lock);
+
+	/* Slow path, once per unknown cgroup: resolve outside the lock */
+	resolved = resolve_by_handle(idx, id, rel, sizeof(rel));
+
+	pthread_mutex_lock(&idx->lock);
+	if (resolved) {
+		index_add(idx, id, rel);
+	} else if (!find_entry(idx, id)) {
+		if (idx->nr_unresolved >= CGROUP_INDEX_UNRESOLVED_MAX) {
+			idx->expired_misses++;
+			idx->expired_miss_ns += miss_ns;
+			pthread_mutex_unlock(&idx->lock);
+			return;
+		}
+		idx->nr_unresolved++;
+	}
+	e = get_or_insert(idx, id);
+	if (e) {
+		e->seen = idx->walk_gen;
+		e->idle = 0;
+		e->deadline_misses++;
+		e->miss_duration_ns += miss_ns;
+	}
+	pthread_mutex_unlock(&idx->lock);
+	flush_created(idx);
+}
+
+size_t cgroup_index_expire_unresolved(struct cgroup_index *idx)
+{
+	size_t dropped = 0;
+
+	pthread_mutex_lock(&idx->lock);
+	idx->nr_unresolved = 0;
+	for (size_t i = 0; i < idx->cap; i++) {
+		struct index_entry *e = &idx->entries[i];
+
+		if (e->id == SLOT_EMPTY || e->id == SLOT_TOMBSTONE || e->path)
+			continue;
+		if (++e->idle < CGROUP_INDEX_UNRESOLVED_IDLE) {
+			idx->nr_unresolved++;
+			continue;
+		}
+		idx->expired_misses += e->deadline_misses;
+		idx->expired_miss_ns += e->miss_duration_ns;
+		remove_entry(idx, e);
+		dropped++;
+	}
+	pthread_mutex_unlock(&idx->lock);
+	return dropped;
+}
+
+void cgroup_index_unresolved(struct cgroup_index *idx, __u64 *misses, __u64 *miss_ns)
+{
+	pthread_mutex_lock(&idx->lock);
+	*misses = idx->expired_misses;
+	*miss_ns = idx->expired_miss_ns;
+	for (size_t i = 0; i < idx->cap; i++) {
+		const struct index_entry *e = &idx->entries[i];
+
+		if (e->id == SLOT_EMPTY || e->id == SLOT_TOMBSTONE || e->path)
+			continue;
+		*misses += e->deadline_misses;
+		*miss_ns += e->miss_duration_ns;
+	}
+	pthread_mutex_unlock(&idx->lock);
+}
+
+void cgroup_index_foreach(struct cgroup_index *idx, cgroup_index_iter_fn fn, void *ctx)
+{
+	struct cgroup_info info;
+
+	pthread_mutex_lock(&idx->lock);
+	for (size_t i = 0; i < idx->cap; i++) {
+		const struct index_entry *e = &idx->entries[i];
+
+		if (e->id == SLOT_EMPTY || e->id == SLOT_TOMBSTONE)
+			continue;
+		copy_info(e, &info);
+		fn(&info, ctx);
+	}
+	pthread_mutex_unlock(&idx->lock);
+}
+
+size_t cgroup_index_size(struct cgroup_index *idx)
+{
+	size_t n;
+
+	pthread_mutex_lock(&idx->lock);
+	n = idx->used;
+	pthread_mutex_unlock(&idx->lock);
+	return n;
+}
+
+void cgroup_index_free(struct cgroup_index *idx)
+{
+	if (!idx)
+		return;
+
+	for (size_t i = 0; i < idx->cap; i++) {
+		if (idx->entries[i].id != SLOT_EMPTY && idx->entries[i].id != SLOT_TOMBSTONE)
+			free(idx->entries[i].path);
+	}
+	if (idx->inotify_fd >= 0)
+		close(idx->inotify_fd);
+	if (idx->mount_fd >= 0)
+		close(idx->mount_fd);
+	for (size_t i = 0; i < idx->nr_created; i++)
+		free(idx->created[i].path);
+	free(idx->created);
+	pthread_mutex_destroy(&idx->lock);
+	free(idx->entries);
+	free(idx->watches);
+	free(idx);
+}
@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Cgroup ID reverse index for scx-slo
+ *
+ * Maps kernel cgroup IDs (as reported by bpf_get_current_cgroup_id()) back
+ * to cgroupfs paths and, where the path encodes it, the owning Kubernetes
+ * pod. Built once by walking the cgroup hierarchy and kept current through
+ * inotify, so lookups on the deadline event path are a single hash probe.
+ */
+#ifndef __SCX_SLO_CGROUP_INDEX_H
+#define __SCX_SLO_CGROUP_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "scx_slo.h"
+
+#define CGROUP_INDEX_PATH_MAX 512
+#define CGROUP_INDEX_POD_MAX  64
+#define CGROUP_INDEX_NS_MAX   64
+
+#define CGROUP_INDEX_UNRESOLVED_MAX  1024  /* Unresolved entries kept at most */
+#define CGROUP_INDEX_UNRESOLVED_IDLE 3     /* Expiry passes without a miss */
+
+/* Snapshot of one indexed cgroup, copied out under the index lock */
+struct cgroup_info {
+	__u64 id;
+	char path[CGROUP_INDEX_PATH_MAX];     /* Relative to the cgroupfs root */
+	char pod[CGROUP_INDEX_POD_MAX];       /* Pod UID, empty if not a pod */
+	char namespace[CGROUP_INDEX_NS_MAX];  /* Pod namespace, empty if unknown */
+	__u64 deadline_misses;
+	__u64 miss_duration_ns;
+};
+
+struct cgroup_index;
+
+typedef void (*cgroup_index_iter_fn)(const struct cgroup_info *info, void *ctx);
+typedef void (*cgroup_index_create_fn)(__u64 id, const char *path, void *ctx);
+
+/* Create an empty index rooted at the given cgroupfs mount */
+struct cgroup_index *cgroup_index_new(const char *root);
+
+/* Walk the hierarchy once and install inotify watches. Returns entry count. */
+int cgroup_index_build(struct cgroup_index *idx);
+
+/*
+ * Call @fn for every cgroup first indexed after this point, with its path
+ * relative to the root. Runs outside the index lock from whichever thread
+ * processed the event. Pass NULL to stop.
+ */
+void cgroup_index_on_create(struct cgroup_index *idx, cgroup_index_create_fn fn, void *ctx);
+
+/* inotify descriptor to poll for readability, -1 if watching is disabled */
+int cgroup_index_fd(const struct cgroup_index *idx);
+
+/* Drain pending inotify events without blocking. Returns events handled. */
+int cgroup_index_process_events(struct cgroup_index *idx);
+
+/* Copy the entry for a cgroup ID. Returns 0 if found, -ENOENT otherwise. */
+int cgroup_index_lookup(struct cgroup_index *idx, __u64 id, struct cgroup_info *out);
+
+/*
+ * Account a deadline miss against a cgroup, creating an unresolved entry
+ * if needed. Past CGROUP_INDEX_UNRESOLVED_MAX unresolved entries, misses
+ * of further unknown cgroups only count towards the unresolved total.
+ */
+void cgroup_index_record_miss(struct cgroup_index *idx, __u64 id, __u64 miss_ns);
+
+/*
+ * Drop unresolved entries that have not missed for
+ * CGROUP_INDEX_UNRESOLVED_IDLE calls, keeping their misses in the
+ * unresolved total. Call once per GC interval. Returns entries dropped.
+ */
+size_t cgroup_index_expire_unresolved(struct cgroup_index *idx);
+
+/* Total misses and miss duration of the cgroups that never resolved to a path */
+void cgroup_index_unresolved(struct cgroup_index *idx, __u64 *misses, __u64 *miss_ns);
+
+/* Visit every entry under the index lock; callbacks must not re-enter the index */
+void cgroup_index_foreach(struct cgroup_index *idx, cgroup_index_iter_fn fn, void *ctx);
+
+/* Number of indexed cgroups */
+size_t cgroup_index_size(struct cgroup_index *idx);
+
+void cgroup_index_free(struct cgroup_index *idx);
+
+/*
+ * Extract the pod UID from a kubelet-managed cgroup path. Handles both the
+ * systemd driver (kubepods-burstable-pod<uid>.slice) and the cgroupfs driver
+ * (/kubepods/burstable/pod<uid>). Returns true and fills @uid on success.
+ */
+bool cgroup_path_to_pod_uid(const char *path, char *uid, size_t uid_len);
+
+#endif /* __SCX_SLO_CGROUP_INDEX_H */
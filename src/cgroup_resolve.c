@@ -0,0 +1,363 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Bulk cgroup path -> ID resolution for scx-slo
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+#include "cgroup_resolve.h"
+
+#ifndef MAX_HANDLE_SZ
+#define MAX_HANDLE_SZ 128
+#endif
+
+#define DIR_CACHE_SLOTS      64   /* Direct-mapped parent directory fds per worker */
+#define MIN_PATHS_PER_THREAD 512  /* Below this a worker costs more than it saves */
+
+struct cgroup_resolver {
+	int root_fd;
+};
+
+struct dir_cache_slot {
+	char *path;   /* Parent directory relative to the root, NULL = empty */
+	int fd;
+};
+
+struct dir_cache {
+	struct dir_cache_slot slots[DIR_CACHE_SLOTS];
+};
+
+struct resolve_job {
+	struct cgroup_resolver *r;
+	const char *const *paths;
+	__u64 *ids;
+	int *errs;
+	const size_t *order;
+	size_t begin, end;
+	size_t resolved;
+};
+
+struct cgroup_resolver *cgroup_resolver_new(const char *root)
+{
+	struct cgroup_resolver *r = calloc(1, sizeof(*r));
+
+	if (!r)
+		return NULL;
+
+	r->root_fd = open(root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (r->root_fd < 0) {
+		int err = errno;
+
+		free(r);
+		errno = err;
+		return NULL;
+	}
+	return r;
+}
+
+void cgroup_resolver_free(struct cgroup_resolver *r)
+{
+	if (!r)
+		return;
+	close(r->root_fd);
+	free(r);
+}
+
+/* Reject anything that is not a plain "/a/b/c" path below the root */
+static int validate_path(const char *path)
+{
+	const char *p = path;
+
+	if (path[0] != '/')
+		return -EINVAL;
+
+	while (*p) {
+		while (*p == '/')
+			p++;
+		if (p[0] == '.' && (p[1] == '/' || p[1] == '\0'))
+			return -EINVAL;
+		if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0'))
+			return -EINVAL;
+		while (*p && *p != '/')
+			p++;
+	}
+	return 0;
+}
+
+/* Open a directory below the root without following symlinks out of it */
+static int open_beneath(int root_fd, const char *rel)
+{
+	struct open_how how = {
+		.flags = O_PATH | O_DIRECTORY | O_CLOEXEC,
+		.resolve = RESOLVE_BENEATH | RESOLVE_NO_SYMLINKS | RESOLVE_NO_MAGICLINKS,
+	};
+	int fd;
+
+	fd = syscall(SYS_openat2, root_fd, rel, &how, sizeof(how));
+	if (fd < 0 && errno == ENOSYS) {
+		/* Pre-5.6 kernel: ".." was rejected above, so this stays beneath */
+		fd = openat(root_fd, rel, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	}
+	return fd;
+}
+
+static unsigned int hash_str(const char *s, size_t len)
+{
+	unsigned int h = 2166136261u;
+
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ (unsigned char)s[i]) * 16777619u;
+	return h;
+}
+
+/* fd of the parent directory @rel[0..len), opened once per worker */
+static int dir_cache_get(struct dir_cache *cache, int root_fd, const char *rel, size_t len)
+{
+	struct dir_cache_slot *slot;
+	char *path;
+	int fd;
+
+	if (len == 0)
+		return root_fd;
+
+	slot = &cache->slots[hash_str(rel, len) % DIR_CACHE_SLOTS];
+	if (slot->path && strlen(slot->path) == len && memcmp(slot->path, rel, len) == 0)
+		return slot->fd;
+
+	path = strndup(rel, len);
+	if (!path)
+		return -1;
+
+	fd = open_beneath(root_fd, path);
+	if (fd < 0) {
+		int err = errno;
+
+		free(path);
+		errno = err;
+		return -1;
+	}
+
+	if (slot->path) {
+		close(slot->fd);
+		free(slot->path);
+	}
+	slot->path = path;
+	slot->fd = fd;
+	return fd;
+}
+
+static void dir_cache_clear(struct dir_cache *cache)
+{
+	for (int i = 0; i < DIR_CACHE_SLOTS; i++) {
+		if (cache->slots[i].path) {
+			close(cache->slots[i].fd);
+			free(cache->slots[i].path);
+			cache->slots[i].path = NULL;
+		}
+	}
+}
+
+__u64 cgroup_handle_id(int dir_fd, const char *name, int flags, int *handle_type)
+{
+	struct {
+		struct file_handle handle;
+		unsigned char buf[MAX_HANDLE_SZ];
+	} fh;
+	int mount_id;
+	__u64 id = 0;
+
+	fh.handle.handle_bytes = MAX_HANDLE_SZ;
+	if (name_to_handle_at(dir_fd, name, &fh.handle, &mount_id, flags) < 0) {
+		struct stat st;
+
+		if (errno != EOPNOTSUPP)
+			return 0;
+		/* Filesystem without file handles: fall back to the inode */
+		if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW | flags) < 0)
+			return 0;
+		return st.st_ino;
+	}
+
+	if (handle_type)
+		*handle_type = fh.handle.handle_type;
+	/* For cgroup2 the handle is the 64-bit cgroup ID */
+	if (fh.handle.handle_bytes >= sizeof(__u64)) {
+		memcpy(&id, fh.handle.f_handle, sizeof(__u64));
+	} else if (fh.handle.handle_bytes >= sizeof(__u32)) {
+		__u32 id32;
+
+		memcpy(&id32, fh.handle.f_handle, sizeof(__u32));
+		id = id32;
+	}
+	if (!id)
+		errno = EINVAL;
+	return id;
+}
+
+static __u64 resolve_path(struct cgroup_resolver *r, struct dir_cache *cache,
+			  const char *path, int *err)
+{
+	char rel[PATH_MAX];
+	const char *leaf;
+	size_t len;
+	int parent_fd, flags = 0;
+	__u64 id;
+
+	*err = -validate_path(path);
+	if (*err)
+		return 0;
+
+	/* Strip the leading and trailing slashes; "" is the root itself */
+	while (*path == '/')
+		path++;
+	len = strlen(path);
+	while (len && path[len - 1] == '/')
+		len--;
+	if (len >= sizeof(rel)) {
+		*err = ENAMETOOLONG;
+		return 0;
+	}
+	memcpy(rel, path, len);
+	rel[len] = '\0';
+
+	leaf = strrchr(rel, '/');
+	if (leaf) {
+		parent_fd = dir_cache_get(cache, r->root_fd, rel, leaf - rel);
+		leaf++;
+	} else {
+		parent_fd = r->root_fd;
+		leaf = rel;
+		if (!*leaf)
+			flags = AT_EMPTY_PATH;
+	}
+	if (parent_fd < 0) {
+		*err = errno;
+		return 0;
+	}
+
+	id = cgroup_handle_id(parent_fd, leaf, flags, NULL);
+	if (!id)
+		*err = errno;
+	return id;
+}
+
+static void *resolve_worker(void *arg)
+{
+	struct resolve_job *job = arg;
+	struct dir_cache cache;
+
+	memset(&cache, 0, sizeof(cache));
+	for (size_t k = job->begin; k < job->end; k++) {
+		size_t i = job->order[k];
+		int err;
+
+		job->ids[i] = resolve_path(job->r, &cache, job->paths[i], &err);
+		if (job->errs)
+			job->errs[i] = err;
+		if (job->ids[i])
+			job->resolved++;
+	}
+	dir_cache_clear(&cache);
+	return NULL;
+}
+
+static int cmp_path_order(const void *a, const void *b, void *arg)
+{
+	const char *const *paths = arg;
+
+	return strcmp(paths[*(const size_t *)a], paths[*(const size_t *)b]);
+}
+
+static int default_threads(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpus < 1)
+		return 1;
+	return cpus < CGROUP_RESOLVE_MAX_THREADS ? (int)cpus : CGROUP_RESOLVE_MAX_THREADS;
+}
+
+size_t cgroup_resolve_bulk(struct cgroup_resolver *r, const char *const *paths,
+			   __u64 *ids, int *errs, size_t n, int threads)
+{
+	struct resolve_job jobs[CGROUP_RESOLVE_MAX_THREADS];
+	pthread_t tids[CGROUP_RESOLVE_MAX_THREADS];
+	bool started[CGROUP_RESOLVE_MAX_THREADS] = { false };
+	size_t *order, resolved = 0, chunk;
+	int nr_jobs;
+
+	if (n == 0)
+		return 0;
+
+	order = malloc(n * sizeof(*order));
+	if (!order) {
+		for (size_t i = 0; i < n; i++) {
+			ids[i] = 0;
+			if (errs)
+				errs[i] = ENOMEM;
+		}
+		return 0;
+	}
+
+	/* Siblings end up adjacent, so each worker reuses its parent fds */
+	for (size_t i = 0; i < n; i++)
+		order[i] = i;
+	qsort_r(order, n, sizeof(*order), cmp_path_order, (void *)paths);
+
+	if (threads <= 0)
+		threads = default_threads();
+	if (threads > CGROUP_RESOLVE_MAX_THREADS)
+		threads = CGROUP_RESOLVE_MAX_THREADS;
+	nr_jobs = (n + MIN_PATHS_PER_THREAD - 1) / MIN_PATHS_PER_THREAD;
+	if (nr_jobs > threads)
+		nr_jobs = threads;
+	if (nr_jobs < 1)
+		nr_jobs = 1;
+	chunk = (n + nr_jobs - 1) / nr_jobs;
+
+	for (int j = 0; j < nr_jobs; j++) {
+		jobs[j] = (struct resolve_job) {
+			.r = r, .paths = paths, .ids = ids, .errs = errs, .order = order,
+			.begin = j * chunk,
+			.end = (j + 1) * chunk < n ? (j + 1) * chunk : n,
+		};
+		/* The first chunk runs on the calling thread */
+		if (j > 0 && pthread_create(&tids[j], NULL, resolve_worker, &jobs[j]) == 0)
+			started[j] = true;
+	}
+
+	resolve_worker(&jobs[0]);
+	for (int j = 1; j < nr_jobs; j++) {
+		if (started[j])
+			pthread_join(tids[j], NULL);
+		else
+			resolve_worker(&jobs[j]);
+	}
+
+	for (int j = 0; j < nr_jobs; j++)
+		resolved += jobs[j].resolved;
+
+	free(order);
+	return resolved;
+}
+
+__u64 cgroup_resolve_one(struct cgroup_resolver *r, const char *path)
+{
+	__u64 id;
+	int err;
+
+	cgroup_resolve_bulk(r, &path, &id, &err, 1, 1);
+	if (!id)
+		errno = err;
+	return id;
+}
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Bulk cgroup path -> ID resolution for scx-slo
+ *
+ * Resolving a config with thousands of cgroups one realpath()/open()/
+ * name_to_handle_at()/close() at a time costs seconds. The resolver keeps
+ * the cgroup root open, resolves each path with name_to_handle_at()
+ * relative to a cached fd of its parent directory, and splits large
+ * batches across worker threads. Parent directories are opened with
+ * RESOLVE_BENEATH so a path can never escape the cgroup root.
+ */
+#ifndef __SCX_SLO_CGROUP_RESOLVE_H
+#define __SCX_SLO_CGROUP_RESOLVE_H
+
+#include <stddef.h>
+#include "scx_slo.h"
+
+#define CGROUP_RESOLVE_MAX_THREADS 8
+
+struct cgroup_resolver;
+
+/* Open @root (e.g. "/sys/fs/cgroup"). Returns NULL with errno set on failure. */
+struct cgroup_resolver *cgroup_resolver_new(const char *root);
+void cgroup_resolver_free(struct cgroup_resolver *r);
+
+/*
+ * Resolve @n absolute-within-root paths ("/kubepods/...") into @ids.
+ * Failed entries get id 0 and, if @errs is given, a positive errno.
+ * Up to @threads workers are used (0 picks a default from the CPU count).
+ * Returns the number of paths resolved.
+ */
+size_t cgroup_resolve_bulk(struct cgroup_resolver *r, const char *const *paths,
+			   __u64 *ids, int *errs, size_t n, int threads);
+
+/* Resolve a single path. Returns 0 and sets errno on failure. */
+__u64 cgroup_resolve_one(struct cgroup_resolver *r, const char *path);
+
+/*
+ * Read the cgroup ID of @name relative to @dir_fd (@flags as for
+ * name_to_handle_at(), AT_EMPTY_PATH for @dir_fd itself), falling back to
+ * the inode on filesystems without file handles. The handle type is
+ * stored in @handle_type if given. Returns 0 and sets errno on failure.
+ */
+__u64 cgroup_handle_id(int dir_fd, const char *name, int flags, int *handle_type);
+
+#endif /* __SCX_SLO_CGROUP_RESOLVE_H */
@@ -12,41 +12,42 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <limits.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <bpf/bpf.h>
-#include "scx_slo.h"
-
-/* Linux-specific includes for name_to_handle_at */
-#ifdef __linux__
-#include <linux/limits.h>
-#endif
-
-/* Fallback definitions for portability */
-#ifndef PATH_MAX
-#define PATH_MAX 4096
-#endif
-
-#ifndef MAX_HANDLE_SZ
-#define MAX_HANDLE_SZ 128
-#endif
-
-/* file_handle structure for name_to_handle_at() */
-#ifndef __linux__
-struct file_handle {
-	unsigned int handle_bytes;
-	int handle_type;
-	unsigned char f_handle[0];
-};
-#endif
+#include "config.h"
+#include "slo_set.h"
+#include "cgroup_resolve.h"
+#include "rule_trie.h"
+#include "config_snapshot.h"
+#include "log.h"
 
-#define CONFIG_FILE_PATH "/etc/scx-slo/config"
 #define MAX_LINE_LENGTH 256
 #define MAX_CGROUP_PATH 512
 #define CGROUP_FS_ROOT "/sys/fs/cgroup"
+#define SLO_PATCH_MAX 1024  /* Largest config diff applied to the SLO map in place */
 
 struct slo_config_entry {
 	char cgroup_path[MAX_CGROUP_PATH];
 	__u64 budget_ms;
 	__u32 importance;
+	__u32 slo_class;    /* SLO_CLASS_*, standard unless the line names one */
+};
+
+/* A validated config line waiting for its cgroup ID */
+struct parsed_entry {
+	struct slo_config_entry entry;
+	int line_num;
+	int rule;           /* Position among valid lines; later rules win */
+	bool pattern;       /* Path is a pattern, expanded rather than resolved */
+	__u64 cgroup_id;    /* 0 until resolved */
+};
+
+struct parsed_entries {
+	struct parsed_entry *v;
+	size_t nr;
+	size_t cap;
 };
 
 /*
@@ -56,25 +57,31 @@ struct slo_config_entry {
 static int validate_cgroup_path(const char *path)
 {
 	if (!path || strlen(path) == 0) {
-		fprintf(stderr, "Error: Empty cgroup path\n");
+		log_msg(LOG_ERROR, "Empty cgroup path");
 		return -1;
 	}
 
 	/* Path must start with / (absolute within cgroup hierarchy) */
 	if (path[0] != '/') {
-		fprintf(stderr, "Error: Cgroup path must be absolute (start with /): %s\n", path);
+		log_msg(LOG_ERROR, "Cgroup path must be absolute (start with /): %s", path);
 		return -1;
 	}
 
-	/* Check for path traversal attempts */
-	if (strstr(path, "..") != NULL) {
-		fprintf(stderr, "Error: Path traversal detected in cgroup path: %s\n", path);
-		return -1;
+	/* Check for path traversal attempts; "..." is the only component with ".." */
+	for (const char *p = path; (p = strstr(p, "..")) != NULL; p++) {
+		const char *comp = p;
+
+		while (comp > path && comp[-1] != '/')
+			comp--;
+		if (strncmp(comp, RULE_TRIE_ANY "/", 4) != 0 && strcmp(comp, RULE_TRIE_ANY) != 0) {
+			log_msg(LOG_ERROR, "Path traversal detected in cgroup path: %s", path);
+			return -1;
+		}
 	}
 
 	/* Check path length */
 	if (strlen(path) >= MAX_CGROUP_PATH - strlen(CGROUP_FS_ROOT) - 1) {
-		fprintf(stderr, "Error: Cgroup path too long: %s\n", path);
+		log_msg(LOG_ERROR, "Cgroup path too long: %s", path);
 		return -1;
 	}
 
@@ -82,12 +89,12 @@ static int validate_cgroup_path(const char *path)
 	for (size_t i = 0; i < strlen(path); i++) {
 		if (path[i] == '\0')
 			break;
-		/* Allow alphanumeric, /, -, _, . */
+		/* Allow alphanumeric, /, -, _, . and the wildcards * and ? */
 		char c = path[i];
 		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
 		      (c >= '0' && c <= '9') || c == '/' || c == '-' ||
-		      c == '_' || c == '.')) {
-			fprintf(stderr, "Error: Invalid character '%c' in cgroup path: %s\n", c, path);
+		      c == '_' || c == '.' || c == '*' || c == '?')) {
+			log_msg(LOG_ERROR, "Invalid character '%c' in cgroup path: %s", c, path);
 			return -1;
 		}
 	}
@@ -95,195 +102,1117 @@ static int validate_cgroup_path(const char *path)
 	return 0;
 }
 
+/* Config file names of the latency classes, indexed by SLO_CLASS_* */
+static const char *const slo_class_names[NR_SLO_CLASSES] = {
+	[SLO_CLASS_STANDARD]   = "standard",
+	[SLO_CLASS_CRITICAL]   = "latency-critical",
+	[SLO_CLASS_BATCH]      = "batch",
+	[SLO_CLASS_BESTEFFORT] = "best-effort",
+};
+
+const char *slo_class_name(__u32 cls)
+{
+	return cls < NR_SLO_CLASSES ? slo_class_names[cls] : "unknown";
+}
+
+/* Parse a latency class name. Returns SLO_CLASS_* or -1. */
+static int parse_slo_class(const char *name)
+{
+	for (int i = 0; i < NR_SLO_CLASSES; i++)
+		if (strcmp(name, slo_class_names[i]) == 0)
+			return i;
+	return -1;
+}
+
+/* Validate SLO configuration entry */
+static int validate_config_entry(const struct slo_config_entry *entry)
+{
+	/* Security: validate cgroup path first to prevent path traversal */
+	if (validate_cgroup_path(entry->cgroup_path) != 0) {
+		return -1;
+	}
+
+	if (entry->budget_ms < MIN_BUDGET_NS / 1000000 ||
+	    entry->budget_ms > MAX_BUDGET_NS / 1000000) {
+		log_msg(LOG_ERROR, "Invalid budget %llu ms (must be %llu-%llu ms)",
+			(unsigned long long)entry->budget_ms,
+			(unsigned long long)(MIN_BUDGET_NS / 1000000),
+			(unsigned long long)(MAX_BUDGET_NS / 1000000));
+		return -1;
+	}
+
+	if (entry->importance < MIN_IMPORTANCE || entry->importance > MAX_IMPORTANCE) {
+		log_msg(LOG_ERROR, "Invalid importance %u (must be %u-%u)",
+			entry->importance, MIN_IMPORTANCE, MAX_IMPORTANCE);
+		return -1;
+	}
+
+	if (entry->slo_class >= NR_SLO_CLASSES) {
+		log_msg(LOG_ERROR, "Invalid latency class %u", entry->slo_class);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* The slo_cfg a validated entry puts in the SLO map */
+static struct slo_cfg entry_cfg(const struct slo_config_entry *entry)
+{
+	return (struct slo_cfg){
+		.budget_ns = entry->budget_ms * 1000000ULL,  /* ms to ns */
+		.importance = entry->importance,
+		.flags = entry->slo_class,
+	};
+}
+
+/* Rules in the published SLO map that came from the config file */
+static struct slo_set applied_set;
+
+/* SLO map generations published by this agent; 0 is the map loaded with it */
+static __u32 slo_generation;
+
 /*
- * Convert cgroup path to cgroup ID using name_to_handle_at().
- * This matches what bpf_get_current_cgroup_id() returns in the kernel.
- *
- * The kernel's cgroup ID is derived from the cgroup's kernfs node ID,
- * which can be obtained via name_to_handle_at() on cgroup v2.
+ * Rules of the last applied config, for matching cgroups created later:
+ * every rule is in the trie under its position, rule_cfgs holds its config.
+ * config_lock serializes reloads with the creation handler.
  */
-static __u64 cgroup_path_to_id(const char *path)
-{
-	char full_path[MAX_CGROUP_PATH];
-	char resolved_path[PATH_MAX];
-	int fd = -1;
-	__u64 cgroup_id = 0;
-	int mount_id;
-
-	/* Build full path */
-	int ret = snprintf(full_path, sizeof(full_path), "%s%s", CGROUP_FS_ROOT, path);
-	if (ret < 0 || (size_t)ret >= sizeof(full_path)) {
-		fprintf(stderr, "Error: Path too long: %s\n", path);
-		return 0;
+static pthread_mutex_t config_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct rule_trie *applied_rules;
+static struct slo_cfg *rule_cfgs;
+static struct slo_map_fds applied_fds = { -1, -1 };
+static __u64 auto_applied;
+
+/* Entries of each staged SLO map, 0 to match the active one */
+static __u32 map_capacity;
+
+static __u64 monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Keys and values to copy into a staged SLO map */
+struct slo_entries {
+	__u64 *keys;
+	struct slo_cfg *vals;
+	__u32 nr;
+};
+
+static void slo_entries_free(struct slo_entries *e)
+{
+	free(e->keys);
+	free(e->vals);
+	e->keys = NULL;
+	e->vals = NULL;
+	e->nr = 0;
+}
+
+/*
+ * Read the entries of @fd that the config does not own, i.e. those written
+ * through the control socket. One batch lookup, or key by key on kernels
+ * without batch support for hash maps.
+ */
+static int read_foreign_entries(int fd, __u32 max_entries, const struct slo_set *next,
+				struct slo_entries *out)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	__u64 in_batch, out_batch, key, *prev = NULL;
+	__u32 count, nr = 0, kept = 0;
+	int err;
+
+	out->keys = malloc(max_entries * sizeof(*out->keys));
+	out->vals = malloc(max_entries * sizeof(*out->vals));
+	out->nr = 0;
+	if (!out->keys || !out->vals) {
+		slo_entries_free(out);
+		return -ENOMEM;
 	}
 
-	/* Resolve to canonical path and verify it stays under cgroup root */
-	if (realpath(full_path, resolved_path) == NULL) {
-		fprintf(stderr, "Error: Cannot resolve cgroup path %s: %s\n",
-			full_path, strerror(errno));
-		return 0;
+	for (;;) {
+		count = max_entries - nr;
+		err = bpf_map_lookup_batch(fd, nr ? &in_batch : NULL, &out_batch,
+					   out->keys + nr, out->vals + nr, &count, &opts);
+		if (err && errno != ENOENT)
+			break;
+		nr += count;
+		in_batch = out_batch;
+		if (err || nr == max_entries)
+			break;
+	}
+
+	if (err && errno != ENOENT) {
+		nr = 0;
+		while (nr < max_entries && bpf_map_get_next_key(fd, prev, &key) == 0) {
+			prev = &out->keys[nr];
+			out->keys[nr] = key;
+			/* Skip keys deleted since get_next_key returned them */
+			if (bpf_map_lookup_elem(fd, &key, &out->vals[nr]) == 0)
+				nr++;
+		}
 	}
 
-	/* Security check: ensure resolved path is under cgroup root */
-	if (strncmp(resolved_path, CGROUP_FS_ROOT, strlen(CGROUP_FS_ROOT)) != 0) {
-		fprintf(stderr, "Error: Resolved path escapes cgroup root: %s -> %s\n",
-			full_path, resolved_path);
+	for (__u32 i = 0; i < nr; i++) {
+		if (slo_set_find(&applied_set, out->keys[i]) || slo_set_find(next, out->keys[i]))
+			continue;
+		out->keys[kept] = out->keys[i];
+		out->vals[kept++] = out->vals[i];
+	}
+	out->nr = kept;
+	return 0;
+}
+
+/* Write @e to @fd in one batch, falling back to one update per key */
+static int write_entries(int fd, const struct slo_entries *e)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts, .elem_flags = BPF_ANY);
+	__u32 count = e->nr;
+
+	if (!e->nr || bpf_map_update_batch(fd, e->keys, e->vals, &count, &opts) == 0)
 		return 0;
+
+	for (__u32 i = 0; i < e->nr; i++) {
+		if (bpf_map_update_elem(fd, &e->keys[i], &e->vals[i], BPF_ANY) != 0) {
+			int err = -errno;
+
+			log_msg(LOG_ERROR, "Failed to write cgroup %llu to SLO map: %s",
+				(unsigned long long)e->keys[i], strerror(-err));
+			return err;
+		}
 	}
+	return 0;
+}
 
-	/* Open the cgroup directory */
-	fd = open(resolved_path, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
-	if (fd < 0) {
-		fprintf(stderr, "Error: Cannot open cgroup %s: %s\n",
-			resolved_path, strerror(errno));
+/* Delete @nr keys from @fd in one batch; keys already gone are skipped */
+static int delete_entries(int fd, const __u64 *keys, __u32 nr)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	__u32 count = nr;
+
+	if (!nr || bpf_map_delete_batch(fd, keys, &count, &opts) == 0)
 		return 0;
+
+	/* Keys that are not in the map stop a batch delete; finish one by one */
+	for (__u32 i = count; i < nr; i++) {
+		if (bpf_map_delete_elem(fd, &keys[i]) != 0 && errno != ENOENT)
+			return -errno;
 	}
+	return 0;
+}
 
-	/*
-	 * Use name_to_handle_at to get the file handle, which contains
-	 * the cgroup ID that matches bpf_get_current_cgroup_id().
-	 *
-	 * The handle contains an opaque identifier that for cgroup v2
-	 * filesystems is the cgroup ID (kernfs node id).
-	 */
-	struct {
-		struct file_handle handle;
-		unsigned char buf[MAX_HANDLE_SZ];
-	} fh;
+/* Point the slo_map pin at the published map so new openers find it */
+static void repin_slo_map(int fd)
+{
+	const char *tmp = SLO_MAP_PIN_PATH ".new";
+
+	unlink(tmp);
+	if (bpf_obj_pin(fd, tmp) != 0 || rename(tmp, SLO_MAP_PIN_PATH) != 0) {
+		log_msg(LOG_WARN, "Cannot re-pin %s: %s", SLO_MAP_PIN_PATH, strerror(errno));
+		unlink(tmp);
+	}
+}
+
+/* Make the scheduler redo its cached per-cgroup SLO resolutions */
+static void bump_slo_gen(int slo_gen_fd)
+{
+	__u64 gen = monotonic_ns();
+	__u32 zero = 0;
+
+	if (bpf_map_update_elem(slo_gen_fd, &zero, &gen, BPF_ANY) != 0)
+		log_msg(LOG_WARN, "Cannot bump SLO generation: %s", strerror(errno));
+}
+
+/*
+ * Apply @diff to the active map in place: one batch delete and one batch
+ * update, so a reload costs in proportion to what changed. The scheduler
+ * may see some of the changes before the rest.
+ */
+static int patch_slo_map(int fd, const struct slo_diff *diff)
+{
+	struct slo_entries upsert = {
+		.keys = diff->upsert_keys,
+		.vals = diff->upsert_vals,
+		.nr = diff->nr_upsert,
+	};
+	int err;
+
+	err = delete_entries(fd, diff->delete_keys, diff->nr_delete);
+	if (err) {
+		log_msg(LOG_ERROR, "Failed to delete from SLO map: %s", strerror(-err));
+		return err;
+	}
+	return write_entries(fd, &upsert);
+}
+
+/*
+ * Build the next SLO map off to the side and publish it with one update
+ * of the outer map, so the scheduler sees either the old rules or the new
+ * ones, never a mix. The staged map starts with the entries other writers
+ * put in the active map, then gets every config rule. Anything failing
+ * before the swap leaves the active map untouched.
+ *
+ * Writes through the control socket take config_lock as well and never
+ * race with a publish. The scheduler's cgroup_exit keeps deleting from
+ * the old map until the swap; an entry it removes after the copy lives on
+ * in the new map until the next GC sweep.
+ */
+static int swap_slo_map(const struct slo_map_fds *fds, int active_fd,
+			const struct bpf_map_info *info, __u32 capacity,
+			const struct slo_set *next)
+{
+	struct slo_entries foreign = {0}, rules = {0};
+	LIBBPF_OPTS(bpf_map_create_opts, create_opts);
+	__u32 zero = 0;
+	int staged_fd, err;
+
+	/* Must match the inner map template the BPF program was verified with */
+	create_opts.map_flags = info->map_flags;
+	staged_fd = bpf_map_create(info->type, "slo_map", info->key_size, info->value_size,
+				   capacity, &create_opts);
+	if (staged_fd < 0) {
+		err = -errno;
+		log_msg(LOG_ERROR, "Failed to create staged SLO map: %s", strerror(errno));
+		return err;
+	}
+
+	rules.keys = malloc((next->nr + 1) * sizeof(*rules.keys));
+	rules.vals = malloc((next->nr + 1) * sizeof(*rules.vals));
+	if (!rules.keys || !rules.vals) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (size_t i = 0; i < next->nr; i++) {
+		rules.keys[i] = next->rules[i].cgroup_id;
+		rules.vals[i] = next->rules[i].cfg;
+	}
+	rules.nr = next->nr;
+
+	err = read_foreign_entries(active_fd, info->max_entries, next, &foreign);
+	if (!err)
+		err = write_entries(staged_fd, &foreign);
+	if (!err)
+		err = write_entries(staged_fd, &rules);
+	if (err)
+		goto out;
+
+	if (bpf_map_update_elem(fds->slo_maps, &zero, &staged_fd, BPF_ANY) != 0) {
+		err = -errno;
+		log_msg(LOG_ERROR, "Failed to publish SLO map: %s", strerror(errno));
+		goto out;
+	}
+	slo_generation++;
+	repin_slo_map(staged_fd);
+
+out:
+	slo_entries_free(&foreign);
+	slo_entries_free(&rules);
+	close(staged_fd);
+	return err;
+}
+
+/*
+ * Turn the active SLO map from the rules of @applied_set into those of
+ * @next, which differ by @diff. Diffs of up to SLO_PATCH_MAX keys are
+ * applied in place; larger ones, any resize, and patches that fail get a
+ * new map swapped in whole, which costs in proportion to the map.
+ */
+static int publish_slo_map(const struct slo_map_fds *fds, const struct slo_set *next,
+			   const struct slo_diff *diff)
+{
+	struct bpf_map_info info = {0};
+	__u32 info_len = sizeof(info), zero = 0, active_id, capacity;
+	int active_fd, err;
+
+	if (bpf_map_lookup_elem(fds->slo_maps, &zero, &active_id) != 0) {
+		err = -errno;
+		log_msg(LOG_ERROR, "Failed to find active SLO map: %s", strerror(errno));
+		return err;
+	}
+	active_fd = bpf_map_get_fd_by_id(active_id);
+	if (active_fd < 0 || bpf_map_get_info_by_fd(active_fd, &info, &info_len) != 0) {
+		err = -errno;
+		log_msg(LOG_ERROR, "Failed to open active SLO map %u: %s", active_id, strerror(errno));
+		goto out;
+	}
+	/* Hash inner maps may differ in size, so this is where a resize lands */
+	capacity = map_capacity ? map_capacity : info.max_entries;
+	if (next->nr > capacity) {
+		err = -E2BIG;
+		log_msg(LOG_ERROR, "Config has %zu rules, SLO map holds %u", next->nr, capacity);
+		goto out;
+	}
+
+	if (capacity == info.max_entries &&
+	    diff->nr_upsert + diff->nr_delete <= SLO_PATCH_MAX) {
+		err = patch_slo_map(active_fd, diff);
+		/* Partial patches are visible too, so invalidate caches either way */
+		bump_slo_gen(fds->slo_gen);
+		if (!err)
+			goto out;
+		log_msg(LOG_WARN, "Patching the SLO map failed, publishing a new one");
+	}
+
+	err = swap_slo_map(fds, active_fd, &info, capacity, next);
+	if (!err)
+		bump_slo_gen(fds->slo_gen);
+
+out:
+	if (active_fd >= 0)
+		close(active_fd);
+	return err;
+}
+
+/* Append an uninitialized entry. Returns NULL on allocation failure. */
+static struct parsed_entry *parsed_entries_add(struct parsed_entries *pes)
+{
+	if (pes->nr == pes->cap) {
+		size_t new_cap = pes->cap ? pes->cap * 2 : 256;
+		struct parsed_entry *v = realloc(pes->v, new_cap * sizeof(*v));
 
-	fh.handle.handle_bytes = MAX_HANDLE_SZ;
+		if (!v)
+			return NULL;
+		pes->v = v;
+		pes->cap = new_cap;
+	}
+	return &pes->v[pes->nr++];
+}
+
+/* Parse every valid line of the config file. Returns the count or -1. */
+static int parse_config_file(FILE *config_file, struct parsed_entries *out)
+{
+	char line[MAX_LINE_LENGTH];
+	struct parsed_entry *pe;
+	int line_num = 0;
+
+	while (fgets(line, sizeof(line), config_file)) {
+		struct slo_config_entry entry;
+		char class_name[32];
+		int n, cls;
+
+		line_num++;
+
+		/* Skip comments and empty lines */
+		if (line[0] == '#' || line[0] == '\n' || line[0] == '\0')
+			continue;
+
+		/* Parse line: cgroup_path budget_ms importance [class] */
+		n = sscanf(line, "%511s %llu %u %31s",
+			   entry.cgroup_path, &entry.budget_ms, &entry.importance, class_name);
+		if (n < 3) {
+			log_msg(LOG_WARN, "Invalid config line %d: %.*s", line_num,
+				(int)strcspn(line, "\n"), line);
+			continue;
+		}
+		entry.slo_class = SLO_CLASS_STANDARD;
+		if (n == 4 && class_name[0] != '#') {
+			cls = parse_slo_class(class_name);
+			if (cls < 0) {
+				log_msg(LOG_WARN, "Unknown latency class '%s' at line %d",
+					class_name, line_num);
+				continue;
+			}
+			entry.slo_class = cls;
+		}
+
+		/* Validate entry */
+		if (validate_config_entry(&entry) != 0) {
+			log_msg(LOG_WARN, "Invalid config at line %d", line_num);
+			continue;
+		}
 
-	if (name_to_handle_at(fd, "", &fh.handle, &mount_id, AT_EMPTY_PATH) < 0) {
-		/* Fallback to inode-based ID if name_to_handle_at fails */
+		pe = parsed_entries_add(out);
+		if (!pe)
+			return -1;
+		pe->entry = entry;
+		pe->line_num = line_num;
+		pe->rule = out->nr - 1;
+		pe->pattern = rule_is_pattern(entry.cgroup_path);
+		pe->cgroup_id = 0;
+	}
+
+	return out->nr;
+}
+
+/* Compile every rule into a trie keyed by rule position */
+static struct rule_trie *compile_rules(const struct parsed_entries *pes, struct slo_cfg **cfgs)
+{
+	struct rule_trie *t = rule_trie_new();
+
+	*cfgs = calloc(pes->nr + 1, sizeof(**cfgs));
+	if (!t || !*cfgs)
+		goto fail;
+
+	for (size_t i = 0; i < pes->nr; i++) {
+		const struct parsed_entry *pe = &pes->v[i];
+
+		(*cfgs)[pe->rule] = entry_cfg(&pe->entry);
+		if (rule_trie_add(t, pe->entry.cgroup_path, pe->rule) != 0)
+			log_msg(LOG_WARN, "Cannot compile cgroup rule %s at line %d",
+				pe->entry.cgroup_path, pe->line_num);
+	}
+	return t;
+
+fail:
+	rule_trie_free(t);
+	free(*cfgs);
+	*cfgs = NULL;
+	return NULL;
+}
+
+/*
+ * Add an entry for every existing cgroup below @dir_fd whose winning rule
+ * is a pattern. Only subtrees some pattern can reach are descended into.
+ * Consumes @dir_fd.
+ */
+static void expand_dir(const struct rule_trie *t, struct parsed_entries *pes, int dir_fd,
+		       const char *rel, int depth)
+{
+	DIR *dir = fdopendir(dir_fd);
+	struct dirent *de;
+
+	if (!dir) {
+		close(dir_fd);
+		return;
+	}
+
+	while ((de = readdir(dir)) != NULL) {
+		char child_rel[MAX_CGROUP_PATH];
 		struct stat st;
-		if (fstat(fd, &st) == 0) {
-			/*
-			 * On older kernels or non-cgroup2 filesystems, fall back
-			 * to using the inode number. This may not match
-			 * bpf_get_current_cgroup_id() but is better than nothing.
-			 */
-			cgroup_id = st.st_ino;
-			fprintf(stderr, "Warning: Using inode fallback for %s (may not match kernel ID)\n",
-				path);
+		int r;
+
+		if (de->d_name[0] == '.')
+			continue;
+		if (de->d_type != DT_DIR) {
+			if (de->d_type != DT_UNKNOWN ||
+			    fstatat(dirfd(dir), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+			    !S_ISDIR(st.st_mode))
+				continue;
+		}
+		if (snprintf(child_rel, sizeof(child_rel), "%s/%s", rel, de->d_name) >=
+		    (int)sizeof(child_rel))
+			continue;
+
+		r = rule_trie_match(t, child_rel);
+		if (r >= 0 && pes->v[r].pattern) {
+			struct parsed_entry *pe = parsed_entries_add(pes);
+
+			/* pes->v may have moved; rules stay at the front */
+			if (pe) {
+				*pe = pes->v[r];
+				strcpy(pe->entry.cgroup_path, child_rel);
+				pe->pattern = false;
+			}
+		}
+
+		if (depth + 1 < RULE_TRIE_MAX_DEPTH && rule_trie_may_match_below(t, child_rel)) {
+			int fd = openat(dirfd(dir), de->d_name,
+					O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+
+			if (fd >= 0)
+				expand_dir(t, pes, fd, child_rel, depth + 1);
 		}
-		close(fd);
-		return cgroup_id;
 	}
+	closedir(dir);
+}
+
+/* Expand pattern rules over the current cgroup hierarchy */
+static void expand_patterns(const struct rule_trie *t, struct parsed_entries *pes)
+{
+	bool any = false;
+	int fd;
 
-	close(fd);
+	for (size_t i = 0; i < pes->nr && !any; i++)
+		any = pes->v[i].pattern;
+	if (!any)
+		return;
 
-	/*
-	 * Extract cgroup ID from file handle.
-	 * For cgroup2, the handle contains the 64-bit cgroup ID.
-	 */
-	if (fh.handle.handle_bytes >= sizeof(__u64)) {
-		memcpy(&cgroup_id, fh.handle.f_handle, sizeof(__u64));
-	} else if (fh.handle.handle_bytes >= sizeof(__u32)) {
-		/* Some systems may use 32-bit handles */
-		__u32 id32;
-		memcpy(&id32, fh.handle.f_handle, sizeof(__u32));
-		cgroup_id = id32;
+	fd = open(CGROUP_FS_ROOT, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		log_msg(LOG_WARN, "Cannot expand cgroup patterns under %s: %s",
+			CGROUP_FS_ROOT, strerror(errno));
+		return;
 	}
+	expand_dir(t, pes, fd, "", 0);
+}
 
-	return cgroup_id;
+/* Order by rule so later config lines override earlier ones in slo_set_add() */
+static int cmp_entry_rule(const void *a, const void *b)
+{
+	const struct parsed_entry *pa = a, *pb = b;
+
+	if (pa->rule != pb->rule)
+		return pa->rule < pb->rule ? -1 : 1;
+	return 0;
 }
 
-/* Validate SLO configuration entry */
-static int validate_config_entry(const struct slo_config_entry *entry)
+/*
+ * Fill in cgroup IDs: reuse those of paths seen in the last load unless
+ * @full, and resolve the rest in one bulk pass relative to the cgroup root.
+ */
+static int resolve_entries(struct parsed_entry *entries, int nr, bool full,
+			   struct slo_reload_stats *stats)
 {
-	/* Security: validate cgroup path first to prevent path traversal */
-	if (validate_cgroup_path(entry->cgroup_path) != 0) {
-		return -1;
+	static struct cgroup_resolver *resolver;
+	struct slo_path_index known = {0};
+	const char **paths = NULL;
+	size_t *slot = NULL;
+	__u64 *ids = NULL;
+	int *errs = NULL;
+	size_t pending = 0;
+	int ret = -1;
+
+	if (!full && slo_path_index_build(&known, &applied_set) != 0)
+		full = true;
+
+	paths = malloc(nr * sizeof(*paths));
+	slot = malloc(nr * sizeof(*slot));
+	ids = malloc(nr * sizeof(*ids));
+	errs = malloc(nr * sizeof(*errs));
+	if (nr && (!paths || !slot || !ids || !errs))
+		goto out;
+
+	for (int i = 0; i < nr; i++) {
+		const struct slo_rule *prev;
+
+		/* Patterns are expanded; snapshot IDs are already confirmed */
+		if (entries[i].pattern || entries[i].cgroup_id)
+			continue;
+		prev = full ? NULL : slo_path_index_find(&known, entries[i].entry.cgroup_path);
+		if (prev) {
+			entries[i].cgroup_id = prev->cgroup_id;
+			continue;
+		}
+		paths[pending] = entries[i].entry.cgroup_path;
+		slot[pending++] = i;
 	}
 
-	if (entry->budget_ms < MIN_BUDGET_NS / 1000000 ||
-	    entry->budget_ms > MAX_BUDGET_NS / 1000000) {
-		fprintf(stderr, "Invalid budget %llu ms (must be %llu-%llu ms)\n",
-			(unsigned long long)entry->budget_ms,
-			(unsigned long long)(MIN_BUDGET_NS / 1000000),
-			(unsigned long long)(MAX_BUDGET_NS / 1000000));
-		return -1;
+	if (pending) {
+		if (!resolver) {
+			resolver = cgroup_resolver_new(CGROUP_FS_ROOT);
+			if (!resolver) {
+				log_msg(LOG_ERROR, "Cannot open cgroup root %s: %s",
+					CGROUP_FS_ROOT, strerror(errno));
+				goto out;
+			}
+		}
+
+		cgroup_resolve_bulk(resolver, paths, ids, errs, pending, 0);
+		stats->resolved = pending;
+
+		for (size_t k = 0; k < pending; k++) {
+			struct parsed_entry *pe = &entries[slot[k]];
+
+			pe->cgroup_id = ids[k];
+			if (!ids[k])
+				log_msg(LOG_WARN, "Failed to resolve cgroup %s at line %d: %s",
+					pe->entry.cgroup_path, pe->line_num, strerror(errs[k]));
+		}
 	}
+	ret = 0;
 
-	if (entry->importance < MIN_IMPORTANCE || entry->importance > MAX_IMPORTANCE) {
-		fprintf(stderr, "Invalid importance %u (must be %u-%u)\n",
-			entry->importance, MIN_IMPORTANCE, MAX_IMPORTANCE);
+out:
+	slo_path_index_free(&known);
+	free(paths);
+	free(slot);
+	free(ids);
+	free(errs);
+	return ret;
+}
+
+/*
+ * Take the rules from the compiled snapshot instead of parsing the text
+ * file. IDs the snapshot recorded are confirmed with one stat each; the
+ * rest are left for resolve_entries(). Returns 0, or -1 if there is no
+ * usable snapshot.
+ */
+static int load_snapshot(struct parsed_entries *pes, struct slo_reload_stats *stats)
+{
+	struct slo_snapshot_source src;
+	struct slo_snapshot snap;
+	__u64 *ids = NULL;
+	size_t confirmed = 0;
+	int root_fd, err;
+
+	if (slo_snapshot_source_of(CONFIG_FILE_PATH, &src) != 0)
 		return -1;
+	err = slo_snapshot_open(&snap, SLO_SNAPSHOT_PATH, &src);
+	if (err) {
+		if (err != -ENOENT)
+			log_msg(LOG_WARN, "Ignoring config snapshot %s: %s", SLO_SNAPSHOT_PATH,
+				err == -ESTALE ? "config changed since it was compiled" :
+				strerror(-err));
+		return -1;
+	}
+
+	ids = calloc(snap.nr_rules + 1, sizeof(*ids));
+	if (!ids)
+		goto fail;
+	root_fd = open(CGROUP_FS_ROOT, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (root_fd >= 0) {
+		confirmed = slo_snapshot_verify(&snap, root_fd, ids);
+		close(root_fd);
 	}
 
+	for (__u32 i = 0; i < snap.nr_rules; i++) {
+		const struct slo_snapshot_rule *rule = &snap.rules[i];
+		const char *path = slo_snapshot_path(&snap, i);
+		struct slo_config_entry entry;
+		struct parsed_entry *pe;
+
+		/* The snapshot gets no more trust than the text it came from */
+		if (strlen(path) >= sizeof(entry.cgroup_path))
+			continue;
+		strcpy(entry.cgroup_path, path);
+		entry.budget_ms = rule->cfg.budget_ns / 1000000ULL;
+		entry.importance = rule->cfg.importance;
+		entry.slo_class = rule->cfg.flags;
+		if (validate_config_entry(&entry) != 0) {
+			log_msg(LOG_WARN, "Invalid snapshot rule from line %u", rule->line_num);
+			continue;
+		}
+
+		pe = parsed_entries_add(pes);
+		if (!pe)
+			goto fail;
+		pe->entry = entry;
+		pe->line_num = rule->line_num;
+		pe->rule = pes->nr - 1;
+		pe->pattern = rule_is_pattern(path);
+		pe->cgroup_id = pe->pattern ? 0 : ids[i];
+	}
+
+	stats->from_snapshot = pes->nr;
+	log_msg(LOG_INFO, "Loaded config snapshot %s: %zu rules, %zu cgroup IDs confirmed",
+		SLO_SNAPSHOT_PATH, pes->nr, confirmed);
+	free(ids);
+	slo_snapshot_close(&snap);
 	return 0;
+
+fail:
+	log_msg(LOG_ERROR, "Out of memory loading config snapshot, using the text config");
+	free(ids);
+	free(pes->v);
+	memset(pes, 0, sizeof(*pes));
+	slo_snapshot_close(&snap);
+	return -1;
 }
 
-/* Parse configuration file and update BPF maps */
-int load_slo_config(int slo_map_fd)
+int reload_slo_config(const struct slo_map_fds *fds, bool full,
+		      struct slo_reload_stats *stats)
 {
 	FILE *config_file;
-	char line[MAX_LINE_LENGTH];
-	struct slo_config_entry entry;
-	struct slo_cfg cfg;
-	int line_num = 0;
-	int entries_loaded = 0;
-	
+	struct parsed_entries pes = {0};
+	struct rule_trie *rules = NULL;
+	struct slo_cfg *cfgs = NULL;
+	struct slo_set next;
+	struct slo_diff diff;
+	struct slo_reload_stats local = {0};
+	size_t nr_rules;
+	int ret = -1;
+	__u64 start_ns = monotonic_ns();
+
+	if (!stats)
+		stats = &local;
+	memset(stats, 0, sizeof(*stats));
+
+	slo_set_init(&next);
+	pthread_mutex_lock(&config_lock);
+
 	config_file = fopen(CONFIG_FILE_PATH, "r");
 	if (!config_file) {
-		if (errno == ENOENT) {
-			printf("No config file found at %s, using defaults\n", CONFIG_FILE_PATH);
-			return 0;
+		if (errno != ENOENT) {
+			log_msg(LOG_ERROR, "Failed to open config file %s: %s",
+				CONFIG_FILE_PATH, strerror(errno));
+			goto out;
+		}
+		/* A removed file drops the rules this agent applied */
+		if (!applied_set.nr)
+			log_msg(LOG_INFO, "No config file found at %s, using defaults", CONFIG_FILE_PATH);
+	} else if (!applied_rules && load_snapshot(&pes, stats) == 0) {
+		/* First load in this process: the compiled snapshot is current */
+		fclose(config_file);
+	} else {
+		int nr;
+
+		log_msg(LOG_INFO, "Loading SLO configuration from %s", CONFIG_FILE_PATH);
+		nr = parse_config_file(config_file, &pes);
+		fclose(config_file);
+		if (nr < 0) {
+			log_msg(LOG_ERROR, "Out of memory loading SLO config");
+			goto out;
 		}
-		fprintf(stderr, "Failed to open config file %s: %s\n", 
-			CONFIG_FILE_PATH, strerror(errno));
-		return -1;
 	}
-	
-	printf("Loading SLO configuration from %s\n", CONFIG_FILE_PATH);
-	
-	while (fgets(line, sizeof(line), config_file)) {
-		line_num++;
-		
-		/* Skip comments and empty lines */
-		if (line[0] == '#' || line[0] == '\n' || line[0] == '\0')
+
+	rules = compile_rules(&pes, &cfgs);
+	if (!rules) {
+		log_msg(LOG_ERROR, "Out of memory compiling SLO config rules");
+		goto out;
+	}
+	nr_rules = pes.nr;
+	expand_patterns(rules, &pes);
+	stats->expanded = pes.nr - nr_rules;
+
+	if (resolve_entries(pes.v, pes.nr, full, stats) != 0)
+		goto out;
+
+	qsort(pes.v, pes.nr, sizeof(*pes.v), cmp_entry_rule);
+	for (size_t i = 0; i < pes.nr; i++) {
+		const struct slo_config_entry *e = &pes.v[i].entry;
+		struct slo_cfg cfg = entry_cfg(e);
+
+		if (!pes.v[i].cgroup_id)
 			continue;
-		
-		/* Parse line: cgroup_path budget_ms importance */
-		if (sscanf(line, "%511s %llu %u", 
-			   entry.cgroup_path, &entry.budget_ms, &entry.importance) != 3) {
-			fprintf(stderr, "Invalid config line %d: %s", line_num, line);
+		if (slo_set_add(&next, e->cgroup_path, pes.v[i].cgroup_id, &cfg) != 0) {
+			log_msg(LOG_ERROR, "Out of memory loading SLO config");
+			goto out;
+		}
+	}
+
+	slo_set_finalize(&next);
+	stats->entries = next.nr;
+
+	if (slo_set_diff(&applied_set, &next, &diff) != 0) {
+		log_msg(LOG_ERROR, "Out of memory computing SLO config diff");
+		goto out;
+	}
+
+	stats->upserted = diff.nr_upsert;
+	stats->deleted = diff.nr_delete;
+	if ((diff.nr_upsert || diff.nr_delete) && publish_slo_map(fds, &next, &diff) != 0) {
+		stats->failed = diff.nr_upsert + diff.nr_delete;
+		stats->upserted = stats->deleted = 0;
+		stats->generation = slo_generation;
+		stats->duration_ns = monotonic_ns() - start_ns;
+		log_msg(LOG_ERROR, "SLO config not applied, keeping generation %u", slo_generation);
+		slo_diff_free(&diff);
+		goto out;
+	}
+	slo_diff_free(&diff);
+
+	slo_set_move(&applied_set, &next);
+	rule_trie_free(applied_rules);
+	free(rule_cfgs);
+	applied_rules = rules;
+	rule_cfgs = cfgs;
+	applied_fds = *fds;
+	rules = NULL;
+	cfgs = NULL;
+
+	stats->generation = slo_generation;
+	stats->duration_ns = monotonic_ns() - start_ns;
+
+	log_msg(LOG_INFO, "Loaded %d SLO configuration entries (%d updated, %d removed, %d resolved, "
+		"%d from patterns, generation %u)", stats->entries, stats->upserted,
+		stats->deleted, stats->resolved, stats->expanded, stats->generation);
+	ret = stats->entries;
+
+out:
+	pthread_mutex_unlock(&config_lock);
+	rule_trie_free(rules);
+	free(cfgs);
+	free(pes.v);
+	slo_set_free(&next);
+	return ret;
+}
+
+/* Remove rules left behind by an earlier cgroup at @path. Caller holds config_lock. */
+static void drop_stale_path(int map_fd, const char *path, __u64 cgroup_id)
+{
+	for (size_t i = 0; i < applied_set.nr; ) {
+		const struct slo_rule *rule = &applied_set.rules[i];
+		__u64 stale = rule->cgroup_id;
+
+		if (stale == cgroup_id || strcmp(rule->path, path) != 0) {
+			i++;
 			continue;
 		}
-		
-		/* Validate entry */
-		if (validate_config_entry(&entry) != 0) {
-			fprintf(stderr, "Invalid config at line %d\n", line_num);
+		bpf_map_delete_elem(map_fd, &stale);
+		slo_set_remove(&applied_set, stale);
+	}
+}
+
+int slo_config_cgroup_created(__u64 cgroup_id, const char *path)
+{
+	const struct slo_rule *cur;
+	struct slo_cfg cfg;
+	__u32 zero = 0, active_id;
+	int r, fd = -1, ret = 0;
+
+	pthread_mutex_lock(&config_lock);
+	if (!applied_rules || applied_fds.slo_maps < 0)
+		goto out;
+
+	r = rule_trie_match(applied_rules, path);
+	if (r < 0)
+		goto out;
+	cfg = rule_cfgs[r];
+	cur = slo_set_find(&applied_set, cgroup_id);
+	if (cur && memcmp(&cur->cfg, &cfg, sizeof(cfg)) == 0)
+		goto out;
+
+	if (bpf_map_lookup_elem(applied_fds.slo_maps, &zero, &active_id) != 0 ||
+	    (fd = bpf_map_get_fd_by_id(active_id)) < 0 ||
+	    bpf_map_update_elem(fd, &cgroup_id, &cfg, BPF_ANY) != 0) {
+		ret = -errno;
+		log_msg(LOG_ERROR, "Failed to apply SLO rule to new cgroup %s: %s",
+			path, strerror(errno));
+		goto out;
+	}
+
+	/* A recreated cgroup keeps its path but not its ID */
+	drop_stale_path(fd, path, cgroup_id);
+	if (slo_set_upsert(&applied_set, path, cgroup_id, &cfg) != 0) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* Tasks may already have cached an inherited or missing SLO */
+	bump_slo_gen(applied_fds.slo_gen);
+	auto_applied++;
+	ret = 1;
+
+out:
+	pthread_mutex_unlock(&config_lock);
+	if (fd >= 0)
+		close(fd);
+	return ret;
+}
+
+long slo_config_gc(cgroup_alive_fn alive, void *ctx)
+{
+	__u64 *ids;
+	size_t nr;
+	long dead;
+
+	pthread_mutex_lock(&config_lock);
+	nr = applied_set.nr;
+	ids = malloc((nr + 1) * sizeof(*ids));
+	if (ids) {
+		for (size_t i = 0; i < nr; i++)
+			ids[i] = applied_set.rules[i].cgroup_id;
+	}
+	pthread_mutex_unlock(&config_lock);
+	if (!ids)
+		return -ENOMEM;
+
+	/* One syscall per rule; keep reloads and new cgroups unblocked meanwhile */
+	dead = cgroup_gc_partition(ids, nr, alive, ctx);
+
+	pthread_mutex_lock(&config_lock);
+	for (long i = 0; i < dead; i++)
+		slo_set_remove(&applied_set, ids[i]);
+	pthread_mutex_unlock(&config_lock);
+
+	free(ids);
+	return dead;
+}
+
+int slo_config_apply_external(const struct slo_map_fds *fds,
+			       const __u64 *set_keys, const struct slo_cfg *set_vals, size_t nr_set,
+			       const __u64 *del_keys, size_t nr_del, bool *shadowed)
+{
+	struct slo_entries set = {0};
+	__u64 *del = NULL;
+	__u32 zero = 0, active_id, nr = 0;
+	int fd = -1, err = 0;
+
+	set.keys = malloc((nr_set + 1) * sizeof(*set.keys));
+	set.vals = malloc((nr_set + 1) * sizeof(*set.vals));
+	del = malloc((nr_del + 1) * sizeof(*del));
+	if (!set.keys || !set.vals || !del) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	/* Under the lock, no publish can swap the map between lookup and write */
+	pthread_mutex_lock(&config_lock);
+
+	/* Config rules win, as they do when a generation is published */
+	for (size_t i = 0; i < nr_set; i++) {
+		if (slo_set_find(&applied_set, set_keys[i])) {
+			shadowed[i] = true;
 			continue;
 		}
-		
-		/* Convert to BPF format */
-		__u64 cgroup_id = cgroup_path_to_id(entry.cgroup_path);
-		if (cgroup_id == 0) {
-			fprintf(stderr, "Failed to resolve cgroup %s at line %d\n", 
-				entry.cgroup_path, line_num);
+		set.keys[set.nr] = set_keys[i];
+		set.vals[set.nr++] = set_vals[i];
+	}
+	for (size_t i = 0; i < nr_del; i++) {
+		if (slo_set_find(&applied_set, del_keys[i])) {
+			shadowed[nr_set + i] = true;
 			continue;
 		}
-		
-		cfg.budget_ns = entry.budget_ms * 1000000ULL;  /* ms to ns */
-		cfg.importance = entry.importance;
-		cfg.flags = 0;
-		
-		/* Update BPF map */
-		if (bpf_map_update_elem(slo_map_fd, &cgroup_id, &cfg, BPF_ANY) != 0) {
-			fprintf(stderr, "Failed to update BPF map for cgroup %s: %s\n",
-				entry.cgroup_path, strerror(errno));
+		del[nr++] = del_keys[i];
+	}
+	if (!set.nr && !nr)
+		goto unlock;
+
+	if (bpf_map_lookup_elem(fds->slo_maps, &zero, &active_id) != 0 ||
+	    (fd = bpf_map_get_fd_by_id(active_id)) < 0) {
+		err = -errno;
+		goto unlock;
+	}
+
+	err = write_entries(fd, &set);
+	if (!err)
+		err = delete_entries(fd, del, nr);
+	/* Partial writes are visible too, so invalidate caches either way */
+	bump_slo_gen(fds->slo_gen);
+
+unlock:
+	pthread_mutex_unlock(&config_lock);
+out:
+	if (fd >= 0)
+		close(fd);
+	slo_entries_free(&set);
+	free(del);
+	return err;
+}
+
+int slo_config_adjust(const struct slo_map_fds *fds, const __u64 *keys,
+		      const struct slo_cfg *expected, const struct slo_cfg *vals, size_t nr,
+		      size_t *conflicts)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts, .elem_flags = BPF_EXIST);
+	struct slo_entries set = {0};
+	__u32 zero = 0, active_id, count;
+	size_t stale = 0;
+	int fd = -1, err = 0;
+
+	set.keys = malloc((nr + 1) * sizeof(*set.keys));
+	set.vals = malloc((nr + 1) * sizeof(*set.vals));
+	if (!set.keys || !set.vals) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	pthread_mutex_lock(&config_lock);
+	if (bpf_map_lookup_elem(fds->slo_maps, &zero, &active_id) != 0 ||
+	    (fd = bpf_map_get_fd_by_id(active_id)) < 0) {
+		err = -errno;
+		goto unlock;
+	}
+
+	/* Writers all hold config_lock, so nothing changes after this check */
+	for (size_t i = 0; i < nr; i++) {
+		struct slo_cfg cur;
+
+		if (bpf_map_lookup_elem(fd, &keys[i], &cur) != 0 ||
+		    cur.budget_ns != expected[i].budget_ns ||
+		    cur.importance != expected[i].importance || cur.flags != expected[i].flags) {
+			stale++;
 			continue;
 		}
-		
-		printf("Loaded SLO config: %s -> %llu ms, importance %u\n",
-		       entry.cgroup_path, entry.budget_ms, entry.importance);
-		entries_loaded++;
+		set.keys[set.nr] = keys[i];
+		set.vals[set.nr++] = vals[i];
 	}
-	
+	if (!set.nr)
+		goto unlock;
+
+	/* Never recreate an entry cgroup_exit removed meanwhile */
+	count = set.nr;
+	if (bpf_map_update_batch(fd, set.keys, set.vals, &count, &opts) != 0) {
+		for (__u32 i = count; i < set.nr; i++) {
+			if (bpf_map_update_elem(fd, &set.keys[i], &set.vals[i], BPF_EXIST) != 0 &&
+			    errno != ENOENT) {
+				err = -errno;
+				break;
+			}
+		}
+	}
+	bump_slo_gen(fds->slo_gen);
+
+unlock:
+	pthread_mutex_unlock(&config_lock);
+out:
+	if (fd >= 0)
+		close(fd);
+	slo_entries_free(&set);
+	if (conflicts)
+		*conflicts = stale;
+	return err;
+}
+
+void slo_config_set_map_capacity(__u32 entries)
+{
+	map_capacity = entries;
+}
+
+__u64 slo_config_auto_applied(void)
+{
+	__u64 n;
+
+	pthread_mutex_lock(&config_lock);
+	n = auto_applied;
+	pthread_mutex_unlock(&config_lock);
+	return n;
+}
+
+int compile_slo_config(const char *snapshot_path)
+{
+	struct parsed_entries pes = {0};
+	struct slo_reload_stats st = {0};
+	struct slo_snapshot_source src;
+	struct slo_snapshot_rule *rules = NULL;
+	const char **paths = NULL;
+	FILE *config_file;
+	int nr, err, ret = -1;
+
+	/* Identify the file before reading it, so a concurrent edit makes it stale */
+	err = slo_snapshot_source_of(CONFIG_FILE_PATH, &src);
+	config_file = err ? NULL : fopen(CONFIG_FILE_PATH, "r");
+	if (!config_file) {
+		fprintf(stderr, "Failed to open config file %s: %s\n", CONFIG_FILE_PATH,
+			strerror(err ? -err : errno));
+		return -1;
+	}
+	nr = parse_config_file(config_file, &pes);
 	fclose(config_file);
-	printf("Loaded %d SLO configuration entries\n", entries_loaded);
-	return entries_loaded;
+	if (nr < 0) {
+		fprintf(stderr, "Out of memory compiling SLO config\n");
+		goto out;
+	}
+
+	if (resolve_entries(pes.v, nr, true, &st) != 0)
+		goto out;
+
+	rules = calloc(nr + 1, sizeof(*rules));
+	paths = calloc(nr + 1, sizeof(*paths));
+	if (!rules || !paths) {
+		fprintf(stderr, "Out of memory compiling SLO config\n");
+		goto out;
+	}
+	for (int i = 0; i < nr; i++) {
+		const struct parsed_entry *pe = &pes.v[i];
+
+		rules[i].cgroup_id = pe->cgroup_id;
+		rules[i].cfg = entry_cfg(&pe->entry);
+		rules[i].line_num = pe->line_num;
+		rules[i].flags = pe->pattern ? SLO_SNAPSHOT_PATTERN : 0;
+		paths[i] = pe->entry.cgroup_path;
+	}
+
+	err = slo_snapshot_write(snapshot_path, &src, rules, paths, nr);
+	if (err) {
+		fprintf(stderr, "Failed to write config snapshot %s: %s\n", snapshot_path,
+			strerror(-err));
+		goto out;
+	}
+	printf("Compiled %d SLO rules (%d cgroup paths resolved) into %s\n",
+	       nr, st.resolved, snapshot_path);
+	ret = 0;
+
+out:
+	free(rules);
+	free(paths);
+	free(pes.v);
+	return ret;
+}
+
+/* Parse configuration file and update BPF maps */
+int load_slo_config(const struct slo_map_fds *fds)
+{
+	return reload_slo_config(fds, true, NULL);
 }
 
 /* Create example configuration file */
@@ -292,18 +1221,23 @@ int create_example_config(void)
 	FILE *config_file;
 	const char *example_config = 
 		"# SLO Scheduler Configuration\n"
-		"# Format: cgroup_path budget_ms importance\n"
+		"# Format: cgroup_path budget_ms importance [class]\n"
 		"# \n"
 		"# Examples:\n"
-		"/kubepods/critical/payment-api 50 90\n"
+		"/kubepods/critical/payment-api 50 90 latency-critical\n"
 		"/kubepods/standard/user-service 100 70\n"
-		"/kubepods/batch/analytics 500 20\n"
+		"/kubepods/batch/analytics 500 20 batch\n"
+		"# \n"
+		"# Patterns also cover cgroups created later: * and ? match within\n"
+		"# one path component, ... matches any number of components:\n"
+		"# /kubepods.slice/*burstable*/... 200 40\n"
 		"# \n"
 		"# Budget: 1-10000 ms (latency budget)\n"
-		"# Importance: 1-100 (relative priority)\n";
+		"# Importance: 1-100 (relative priority)\n"
+		"# Class: latency-critical, standard (default), batch or best-effort\n";
 	
 	/* Create directory if it doesn't exist */
-	if (mkdir("/etc/scx-slo", 0755) != 0 && errno != EEXIST) {
+	if (mkdir(CONFIG_DIR, 0755) != 0 && errno != EEXIST) {
 		fprintf(stderr, "Failed to create config directory: %s\n", strerror(errno));
 		return -1;
 	}
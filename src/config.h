@@ -5,10 +5,111 @@
 #ifndef __SCX_SLO_CONFIG_H
 #define __SCX_SLO_CONFIG_H
 
+#include <stdbool.h>
 #include "scx_slo.h"
+#include "cgroup_gc.h"
+
+#define CONFIG_DIR       "/etc/scx-slo"
+#define CONFIG_FILE_NAME "config"
+#define CONFIG_FILE_PATH CONFIG_DIR "/" CONFIG_FILE_NAME
+
+/* Binary snapshot written by --compile-config, used at startup if current */
+#define SLO_SNAPSHOT_PATH CONFIG_DIR "/config.snap"
+
+/* Pin of the SLO map the scheduler currently reads, behind slo_maps */
+#define SLO_MAP_PIN_PATH "/sys/fs/bpf/slo_map"
+
+/* BPF maps a config load writes */
+struct slo_map_fds {
+	int slo_maps;       /* Outer map holding the SLO map in effect */
+	int slo_gen;        /* Changed after each publish to drop cached lookups */
+};
+
+/* Outcome of one config (re)load */
+struct slo_reload_stats {
+	int entries;        /* Valid rules in the config file */
+	int resolved;       /* Cgroup paths resolved rather than reused */
+	int expanded;       /* Existing cgroups matched by pattern rules */
+	int from_snapshot;  /* Rules taken from the compiled snapshot */
+	int upserted;       /* Rules added or changed */
+	int deleted;        /* Rules removed */
+	int failed;         /* Changes not published because staging failed */
+	__u32 generation;   /* SLO map generation in effect afterwards */
+	__u64 duration_ns;
+};
 
 /* Load SLO configuration from file and update BPF maps */
-int load_slo_config(int slo_map_fd);
+int load_slo_config(const struct slo_map_fds *fds);
+
+/*
+ * Re-read the config file and, if any rule changed since the last load,
+ * apply the difference to the active SLO map. Small differences are
+ * written in place; large ones publish a new generation of the map,
+ * filled completely before one atomic swap through the slo_maps outer
+ * map, and on failure the previous generation stays in effect. Paths seen
+ * in the last load reuse their cgroup ID unless @full is set. The first
+ * load takes the rules from SLO_SNAPSHOT_PATH if it was compiled from the
+ * current config file. Returns the number of rules or -1.
+ */
+int reload_slo_config(const struct slo_map_fds *fds, bool full,
+		      struct slo_reload_stats *stats);
+
+/*
+ * Parse, validate and resolve the config file once and write the result
+ * to @snapshot_path. The first load of an agent uses the snapshot while
+ * the config file is unchanged. Returns 0 or -1.
+ */
+int compile_slo_config(const char *snapshot_path);
+
+/*
+ * Apply the config rule matching a cgroup created since the last load, if
+ * any, directly to the active SLO map. @path is relative to the cgroupfs
+ * root. Returns 1 if a rule was applied, 0 if none matched, or -errno.
+ */
+int slo_config_cgroup_created(__u64 cgroup_id, const char *path);
+
+/*
+ * Forget rules whose cgroup was removed, so later generations do not
+ * carry them. Entries already in the map are left to the caller's sweep.
+ * Returns the number of rules dropped or -errno from @alive.
+ */
+long slo_config_gc(cgroup_alive_fn alive, void *ctx);
+
+/*
+ * Write and delete SLO map entries on behalf of the control socket: one
+ * batch update and one batch delete on the active map, then a generation
+ * bump. Cgroups with a config rule are left alone and flagged in
+ * @shadowed (set key i at [i], delete key j at [nr_set + j]), since the
+ * config wins over other writers. Serialized with reloads, so no write is
+ * lost to a concurrent publish. Returns 0 or -errno; entries written
+ * before a failure stay.
+ */
+int slo_config_apply_external(const struct slo_map_fds *fds,
+			       const __u64 *set_keys, const struct slo_cfg *set_vals, size_t nr_set,
+			       const __u64 *del_keys, size_t nr_del, bool *shadowed);
+
+/*
+ * Replace the values of existing SLO map entries, for the adaptive budget
+ * controller: keys[i] gets vals[i] only if it still holds expected[i],
+ * so a value another writer set in between is never overwritten. Such
+ * entries, and entries that no longer exist, are counted in @conflicts.
+ * One batch update, then a generation bump. Returns 0 or -errno.
+ */
+int slo_config_adjust(const struct slo_map_fds *fds, const __u64 *keys,
+		      const struct slo_cfg *expected, const struct slo_cfg *vals, size_t nr,
+		      size_t *conflicts);
+
+/*
+ * Size of the SLO maps published from now on. 0, the default, keeps the
+ * size of the map in effect. Set before the first load.
+ */
+void slo_config_set_map_capacity(__u32 entries);
+
+/* Cgroups given a rule by slo_config_cgroup_created() */
+__u64 slo_config_auto_applied(void);
+
+/* Config file name of latency class @cls (SLO_CLASS_*) */
+const char *slo_class_name(__u32 cls);
 
 /* Create example configuration file */
 int create_example_config(void);
@@ -0,0 +1,369 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Precompiled SLO config snapshots for scx-slo
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config_snapshot.h"
+
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+
+static __u64 fnv1a(__u64 h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+
+int slo_snapshot_source_of(const char *config_path, struct slo_snapshot_source *src)
+{
+	struct stat st;
+	ssize_t n;
+	int fd;
+
+	memset(src, 0, sizeof(*src));
+	if (stat(config_path, &st) != 0)
+		return -errno;
+	src->size = st.st_size;
+	src->mtime_ns = (__u64)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+
+	/* Without a boot ID the cgroup IDs are simply never trusted */
+	fd = open(BOOT_ID_PATH, O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		n = read(fd, src->boot_id, sizeof(src->boot_id) - 1);
+		close(fd);
+		if (n > 0)
+			src->boot_id[strcspn(src->boot_id, "\n")] = '\0';
+		else
+			src->boot_id[0] = '\0';
+	}
+	return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t n = write(fd, p, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int slo_snapshot_write(const char *path, const struct slo_snapshot_source *src,
+		       const struct slo_snapshot_rule *rules, const char *const *paths,
+		       __u32 nr)
+{
+	struct slo_snapshot_header hdr = {0};
+	struct slo_snapshot_rule *out = NULL;
+	char *strtab = NULL, tmp[PATH_MAX];
+	size_t strtab_len = 0, off = 0;
+	int fd = -1, err;
+
+	for (__u32 i = 0; i < nr; i++)
+		strtab_len += strlen(paths[i]) + 1;
+	if (strtab_len > UINT32_MAX)
+		return -E2BIG;
+
+	out = malloc((nr ? nr : 1) * sizeof(*out));
+	strtab = malloc(strtab_len ? strtab_len : 1);
+	if (!out || !strtab) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (__u32 i = 0; i < nr; i++) {
+		size_t len = strlen(paths[i]) + 1;
+
+		out[i] = rules[i];
+		out[i].path_off = off;
+		out[i].reserved = 0;
+		memcpy(strtab + off, paths[i], len);
+		off += len;
+	}
+
+	memcpy(hdr.magic, SLO_SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	hdr.version = SLO_SNAPSHOT_VERSION;
+	hdr.nr_rules = nr;
+	hdr.source_size = src->size;
+	hdr.source_mtime_ns = src->mtime_ns;
+	snprintf(hdr.boot_id, sizeof(hdr.boot_id), "%s", src->boot_id);
+	hdr.strtab_len = strtab_len;
+	hdr.checksum = fnv1a(fnv1a(FNV_OFFSET, out, nr * sizeof(*out)), strtab, strtab_len);
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+		err = -ENAMETOOLONG;
+		goto out;
+	}
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		err = -errno;
+		goto out;
+	}
+	err = write_all(fd, &hdr, sizeof(hdr));
+	if (!err)
+		err = write_all(fd, out, nr * sizeof(*out));
+	if (!err)
+		err = write_all(fd, strtab, strtab_len);
+	if (!err && fsync(fd) != 0)
+		err = -errno;
+	close(fd);
+	if (!err && rename(tmp, path) != 0)
+		err = -errno;
+	if (err)
+		unlink(tmp);
+
+out:
+	free(out);
+	free(strtab);
+	return err;
+}
+
+int slo_snapshot_open(struct slo_snapshot *snap, const char *path,
+		      const struct slo_snapshot_source *expect)
+{
+	const struct slo_snapshot_header *hdr;
+	struct stat st;
+	size_t body;
+	void *map;
+	int fd, err = -EINVAL;
+
+	memset(snap, 0, sizeof(*snap));
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) != 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+	if ((size_t)st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	snap->map = map;
+	snap->len = st.st_size;
+	hdr = map;
+
+	if (memcmp(hdr->magic, SLO_SNAPSHOT_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->version != SLO_SNAPSHOT_VERSION)
+		goto fail;
+
+	/* Sizes come from the file: check them before touching the body */
+	body = snap->len - sizeof(*hdr);
+	if (hdr->nr_rules > body / sizeof(struct slo_snapshot_rule) ||
+	    body - (size_t)hdr->nr_rules * sizeof(struct slo_snapshot_rule) != hdr->strtab_len)
+		goto fail;
+
+	snap->hdr = hdr;
+	snap->rules = (const void *)(hdr + 1);
+	snap->strtab = (const char *)(snap->rules + hdr->nr_rules);
+	snap->nr_rules = hdr->nr_rules;
+
+	if (hdr->strtab_len && snap->strtab[hdr->strtab_len - 1] != '\0')
+		goto fail;
+	for (__u32 i = 0; i < snap->nr_rules; i++)
+		if (snap->rules[i].path_off >= hdr->strtab_len)
+			goto fail;
+	if (fnv1a(FNV_OFFSET, snap->rules, body) != hdr->checksum)
+		goto fail;
+
+	if (hdr->source_size != expect->size || hdr->source_mtime_ns != expect->mtime_ns) {
+		err = -ESTALE;
+		goto fail;
+	}
+	snap->ids_valid = expect->boot_id[0] &&
+		strncmp(hdr->boot_id, expect->boot_id, sizeof(hdr->boot_id)) == 0;
+	return 0;
+
+fail:
+	slo_snapshot_close(snap);
+	return err;
+}
+
+void slo_snapshot_close(struct slo_snapshot *snap)
+{
+	if (snap->map)
+		munmap(snap->map, snap->len);
+	memset(snap, 0, sizeof(*snap));
+}
+
+/* Whether @path is a plain "/a/b" path: no empty, "." or ".." components */
+static bool plain_path(const char *path)
+{
+	const char *p = path;
+
+	if (*p != '/')
+		return false;
+	while (*p) {
+		const char *comp = ++p;
+
+		while (*p && *p != '/')
+			p++;
+		if (p == comp || (p - comp == 1 && comp[0] == '.') ||
+		    (p - comp == 2 && comp[0] == '.' && comp[1] == '.'))
+			return false;
+	}
+	return true;
+}
+
+static size_t parent_len(const char *path)
+{
+	return strrchr(path, '/') - path;
+}
+
+static int cmp_rule_path(const void *a, const void *b, void *arg)
+{
+	const struct slo_snapshot *snap = arg;
+
+	return strcmp(slo_snapshot_path(snap, *(const __u32 *)a),
+		      slo_snapshot_path(snap, *(const __u32 *)b));
+}
+
+/* Confirm one rule with a stat of its full path */
+static bool verify_one(const struct slo_snapshot *snap, int root_fd, __u32 i)
+{
+	const char *rel = slo_snapshot_path(snap, i) + 1;
+	struct stat st;
+
+	return fstatat(root_fd, rel, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode) &&
+	       (__u64)st.st_ino == snap->rules[i].cgroup_id;
+}
+
+/*
+ * Confirm the rules order[0..n), which share a parent directory, with one
+ * readdir of that directory: cgroupfs reports the cgroup ID as d_ino, so
+ * no per-cgroup lookup is needed. order[] is sorted by path, hence by name.
+ */
+static size_t verify_siblings(const struct slo_snapshot *snap, int root_fd,
+			      const __u32 *order, size_t n, __u64 *ids)
+{
+	const char *first = slo_snapshot_path(snap, order[0]);
+	size_t plen = parent_len(first), confirmed = 0;
+	char parent[PATH_MAX];
+	struct dirent *de;
+	DIR *dir;
+	int fd;
+
+	if (plen == 0)
+		snprintf(parent, sizeof(parent), ".");
+	else
+		snprintf(parent, sizeof(parent), "%.*s", (int)plen - 1, first + 1);
+	fd = openat(root_fd, parent, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+		return 0;
+	dir = fdopendir(fd);
+	if (!dir) {
+		close(fd);
+		return 0;
+	}
+
+	while ((de = readdir(dir)) != NULL) {
+		size_t lo = 0, hi = n;
+
+		if (de->d_type != DT_DIR && de->d_type != DT_UNKNOWN)
+			continue;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			__u32 i = order[mid];
+			int c = strcmp(de->d_name, slo_snapshot_path(snap, i) + plen + 1);
+
+			if (c == 0) {
+				if ((__u64)de->d_ino == snap->rules[i].cgroup_id &&
+				    (de->d_type == DT_DIR || verify_one(snap, root_fd, i))) {
+					ids[i] = snap->rules[i].cgroup_id;
+					confirmed++;
+				}
+				break;
+			}
+			if (c < 0)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+	}
+	closedir(dir);
+	return confirmed;
+}
+
+/* Below this many siblings a stat each is cheaper than reading the directory */
+#define VERIFY_READDIR_MIN 4
+
+size_t slo_snapshot_verify(const struct slo_snapshot *snap, int root_fd, __u64 *ids)
+{
+	size_t confirmed = 0, n = 0;
+	__u32 *order;
+
+	for (__u32 i = 0; i < snap->nr_rules; i++)
+		ids[i] = 0;
+	if (!snap->ids_valid || !snap->nr_rules)
+		return 0;
+
+	order = malloc(snap->nr_rules * sizeof(*order));
+	if (!order)
+		return 0;
+
+	/* Never look outside the root, whatever the file says */
+	for (__u32 i = 0; i < snap->nr_rules; i++) {
+		const struct slo_snapshot_rule *rule = &snap->rules[i];
+		const char *path = slo_snapshot_path(snap, i);
+
+		if (rule->cgroup_id && !(rule->flags & SLO_SNAPSHOT_PATTERN) &&
+		    path[1] && plain_path(path))
+			order[n++] = i;
+	}
+	qsort_r(order, n, sizeof(*order), cmp_rule_path, (void *)snap);
+
+	for (size_t start = 0, end; start < n; start = end) {
+		const char *first = slo_snapshot_path(snap, order[start]);
+		size_t plen = parent_len(first);
+
+		for (end = start + 1; end < n; end++) {
+			const char *path = slo_snapshot_path(snap, order[end]);
+
+			if (parent_len(path) != plen || strncmp(path, first, plen) != 0)
+				break;
+		}
+
+		if (end - start >= VERIFY_READDIR_MIN) {
+			confirmed += verify_siblings(snap, root_fd, order + start, end - start, ids);
+			continue;
+		}
+		for (size_t k = start; k < end; k++) {
+			if (verify_one(snap, root_fd, order[k])) {
+				ids[order[k]] = snap->rules[order[k]].cgroup_id;
+				confirmed++;
+			}
+		}
+	}
+
+	free(order);
+	return confirmed;
+}
@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Precompiled SLO config snapshots for scx-slo
+ *
+ * `scx_slo --compile-config` turns the text config into a binary snapshot:
+ * validated rules with their effective slo_cfg and, for literal paths, the
+ * cgroup ID they resolved to. At startup the agent maps the snapshot
+ * instead of parsing and resolving the text file. The snapshot records the
+ * size and mtime of the config file it was compiled from and the boot it
+ * was compiled in; a different config file makes it stale, a different
+ * boot only invalidates the cgroup IDs.
+ *
+ * Layout: header, rules[nr_rules], string table of NUL-terminated paths.
+ */
+#ifndef __SCX_SLO_CONFIG_SNAPSHOT_H
+#define __SCX_SLO_CONFIG_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "scx_slo.h"
+
+#define SLO_SNAPSHOT_MAGIC   "SCXSLOSN"
+#define SLO_SNAPSHOT_VERSION 1
+#define SLO_SNAPSHOT_BOOT_ID_LEN 40
+
+/* Rule flags */
+#define SLO_SNAPSHOT_PATTERN (1U << 0)   /* Path is a pattern, never has an ID */
+
+struct slo_snapshot_header {
+	char magic[8];
+	__u32 version;
+	__u32 nr_rules;
+	__u64 source_size;          /* Config file the snapshot was compiled from */
+	__u64 source_mtime_ns;
+	char boot_id[SLO_SNAPSHOT_BOOT_ID_LEN];
+	__u32 strtab_len;
+	__u32 reserved;
+	__u64 checksum;             /* FNV-1a over everything after the header */
+};
+
+struct slo_snapshot_rule {
+	__u64 cgroup_id;            /* 0 if not resolved when compiled */
+	struct slo_cfg cfg;         /* Effective config, budget in ns */
+	__u32 path_off;             /* Offset into the string table */
+	__u32 line_num;             /* Line in the source config */
+	__u32 flags;
+	__u32 reserved;
+};
+
+/* Identity of the config file and boot a snapshot belongs to */
+struct slo_snapshot_source {
+	__u64 size;
+	__u64 mtime_ns;
+	char boot_id[SLO_SNAPSHOT_BOOT_ID_LEN];
+};
+
+/* A mapped, checked snapshot */
+struct slo_snapshot {
+	void *map;
+	size_t len;
+	const struct slo_snapshot_header *hdr;
+	const struct slo_snapshot_rule *rules;
+	const char *strtab;
+	__u32 nr_rules;
+	bool ids_valid;             /* Compiled in this boot */
+};
+
+/* Describe @config_path and the running boot. Returns 0 or -errno. */
+int slo_snapshot_source_of(const char *config_path, struct slo_snapshot_source *src);
+
+/*
+ * Write @nr rules with their @paths to @path atomically (temp file and
+ * rename). The path_off fields of @rules are ignored. Returns 0 or -errno.
+ */
+int slo_snapshot_write(const char *path, const struct slo_snapshot_source *src,
+		       const struct slo_snapshot_rule *rules, const char *const *paths,
+		       __u32 nr);
+
+/*
+ * Map and check the snapshot at @path against @expect. Returns 0, -ENOENT
+ * if there is none, -ESTALE if it was compiled from a different config
+ * file, or -EINVAL if it is corrupt or of another version.
+ */
+int slo_snapshot_open(struct slo_snapshot *snap, const char *path,
+		      const struct slo_snapshot_source *expect);
+void slo_snapshot_close(struct slo_snapshot *snap);
+
+static inline const char *slo_snapshot_path(const struct slo_snapshot *snap, __u32 i)
+{
+	return snap->strtab + snap->rules[i].path_off;
+}
+
+/*
+ * Check the recorded cgroup IDs against the hierarchy under @root_fd.
+ * cgroupfs reports the cgroup ID as the inode number, so rules sharing a
+ * parent are confirmed with one readdir of it rather than a lookup each.
+ * @ids[i] gets the ID if it still names the rule's path and 0 otherwise
+ * (patterns, other boots, recreated or removed cgroups, unusual paths).
+ * Returns the number of IDs confirmed.
+ */
+size_t slo_snapshot_verify(const struct slo_snapshot *snap, int root_fd, __u64 *ids);
+
+#endif /* __SCX_SLO_CONFIG_SNAPSHOT_H */
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * CPU performance targets for scx-slo
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuperf.h"
+#include "spec_parse.h"
+
+void cpuperf_params_default(struct cpuperf_params *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->standard_min = SLO_CPUPERF_ONE / 2;
+	p->batch_max = SLO_CPUPERF_ONE * 3 / 8;
+	p->boost_slack = 50;
+}
+
+static const struct spec_key cpuperf_keys[] = {
+	SPEC_KEY_U32("standard_min", struct cpuperf_params, standard_min, 1, SLO_CPUPERF_ONE),
+	SPEC_KEY_U32("batch_max", struct cpuperf_params, batch_max, 1, SLO_CPUPERF_ONE),
+	SPEC_KEY_U32("boost_slack", struct cpuperf_params, boost_slack, 0, 100),
+};
+
+static const struct spec_def cpuperf_spec = {
+	.what = "CPU performance",
+	.keys = cpuperf_keys,
+	.nr_keys = SPEC_NR_KEYS(cpuperf_keys),
+	.size = sizeof(struct cpuperf_params),
+};
+
+int cpuperf_parse(struct cpuperf_params *p, const char *spec)
+{
+	return spec_parse(&cpuperf_spec, p, spec);
+}
+
+__u32 cpuperf_target(const struct cpuperf_params *p, __u32 cls, __u32 importance,
+		     __u64 slack_ns, __u64 window_ns)
+{
+	if (cls == SLO_CLASS_BATCH || cls == SLO_CLASS_BESTEFFORT)
+		return p->batch_max;
+	if (cls == SLO_CLASS_CRITICAL)
+		return SLO_CPUPERF_ONE;
+	if (slack_ns > window_ns)
+		slack_ns = window_ns;
+	if (slack_ns * 100 < window_ns * p->boost_slack)
+		return SLO_CPUPERF_ONE;
+
+	if (importance < MIN_IMPORTANCE)
+		importance = MIN_IMPORTANCE;
+	if (importance > MAX_IMPORTANCE)
+		importance = MAX_IMPORTANCE;
+	return p->standard_min + (SLO_CPUPERF_ONE - p->standard_min) * importance / MAX_IMPORTANCE;
+}
+
+void cpuperf_sum(struct slo_cpu_perf *out, const struct slo_cpu_perf *percpu, int nr_cpus)
+{
+	__u64 targets = 0;
+
+	memset(out, 0, sizeof(*out));
+	for (int cpu = 0; cpu < nr_cpus; cpu++) {
+		targets += percpu[cpu].target;
+		out->sets += percpu[cpu].sets;
+		out->boosts += percpu[cpu].boosts;
+		out->capped += percpu[cpu].capped;
+	}
+	if (nr_cpus > 0)
+		out->target = targets / nr_cpus;
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * CPU performance targets for scx-slo
+ *
+ * Each time a task starts running, the scheduler sets the performance
+ * target of its CPU with scx_bpf_cpuperf_set(), so the frequency governor
+ * does not have to ramp up from what the previous task needed. Critical
+ * tasks run at full speed. Standard tasks get a target that rises with
+ * their importance from standard_min, and full speed when less than
+ * boost_slack percent of their deadline window is left by the time they
+ * run. Batch and best-effort tasks are held to batch_max, which leaves
+ * power headroom to the others. Tasks without an SLO count as standard
+ * with the default importance.
+ *
+ * The policy is fixed before load. These helpers parse its tuning, mirror
+ * the computation for tests, and add up the per-CPU counters.
+ */
+#ifndef __SCX_SLO_CPUPERF_H
+#define __SCX_SLO_CPUPERF_H
+
+#include "scx_slo.h"
+
+struct cpuperf_params {
+	__u32 standard_min;   /* Target of standard tasks of importance 0 */
+	__u32 batch_max;      /* Target of batch and best-effort tasks */
+	__u32 boost_slack;    /* Percent of the window left below which a run gets full speed */
+};
+
+void cpuperf_params_default(struct cpuperf_params *p);
+
+/*
+ * Parse @spec (see spec_parse.h) into @p. Keys: standard_min and
+ * batch_max (both out of SLO_CPUPERF_ONE), and boost_slack (percent).
+ */
+int cpuperf_parse(struct cpuperf_params *p, const char *spec);
+
+/*
+ * Target for a task of class @cls and @importance that starts running
+ * with @slack_ns of its @window_ns left, as the scheduler computes it
+ */
+__u32 cpuperf_target(const struct cpuperf_params *p, __u32 cls, __u32 importance,
+		     __u64 slack_ns, __u64 window_ns);
+
+/* Add up the counters of @nr_cpus per-CPU copies; @out->target is their mean */
+void cpuperf_sum(struct slo_cpu_perf *out, const struct slo_cpu_perf *percpu, int nr_cpus);
+
+#endif /* __SCX_SLO_CPUPERF_H */
@@ -0,0 +1,226 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Control socket client for scx-slo
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ctl_client.h"
+
+int ctl_client_connect(struct ctl_client_conn *c, const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+	c->fd = -1;
+	c->seq = 0;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	c->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (c->fd < 0)
+		return -errno;
+	if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		int err = -errno;
+
+		close(c->fd);
+		c->fd = -1;
+		return err;
+	}
+	return 0;
+}
+
+void ctl_client_close(struct ctl_client_conn *c)
+{
+	if (c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+
+	while (len) {
+		ssize_t n = recv(fd, p, len, 0);
+
+		if (n == 0)
+			return -ECONNRESET;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Read the body of a message whose header was read, keeping @max bytes */
+static int read_body(int fd, const struct slo_ctl_hdr *hdr, void *out, size_t max)
+{
+	size_t len = hdr->len - sizeof(*hdr);
+	size_t keep = len < max ? len : max;
+	char skip[512];
+	int err;
+
+	err = read_all(fd, out, keep);
+	for (len -= keep; !err && len; ) {
+		size_t n = len < sizeof(skip) ? len : sizeof(skip);
+
+		err = read_all(fd, skip, n);
+		len -= n;
+	}
+	return err;
+}
+
+static int send_request(struct ctl_client_conn *c, __u16 type, const void *records,
+			__u32 count, size_t rec_size, __u32 *seq)
+{
+	struct slo_ctl_hdr hdr = {
+		.len = sizeof(hdr) + count * rec_size,
+		.type = type,
+		.version = SLO_CTL_VERSION,
+		.seq = ++c->seq,
+		.count = count,
+	};
+	int err;
+
+	*seq = hdr.seq;
+	err = write_all(c->fd, &hdr, sizeof(hdr));
+	if (!err && count)
+		err = write_all(c->fd, records, count * rec_size);
+	return err;
+}
+
+/* Wait for the reply to @seq, copying up to @max bytes of records to @out */
+static int recv_reply(struct ctl_client_conn *c, __u32 seq, void *out, size_t max)
+{
+	for (;;) {
+		struct slo_ctl_hdr hdr;
+		int err;
+
+		err = read_all(c->fd, &hdr, sizeof(hdr));
+		if (err)
+			return err;
+		if (hdr.len < sizeof(hdr))
+			return -EPROTO;
+		if (!(hdr.type & SLO_CTL_REPLY) || hdr.seq != seq) {
+			err = read_body(c->fd, &hdr, NULL, 0);
+			if (err)
+				return err;
+			continue;
+		}
+		err = read_body(c->fd, &hdr, out, max);
+		return err ? err : hdr.status;
+	}
+}
+
+int ctl_client_apply(struct ctl_client_conn *c, const struct slo_ctl_entry *entries, size_t nr,
+		     size_t *shadowed)
+{
+	size_t nr_msgs = (nr + SLO_CTL_MAX_RECORDS - 1) / SLO_CTL_MAX_RECORDS;
+	__u32 first_seq = c->seq + 1, seq;
+	int err = 0, ret;
+
+	/*
+	 * Pipelined: the agent merges what arrives together into one batch,
+	 * so waiting for each reply would only cost round trips.
+	 */
+	for (size_t i = 0; i < nr_msgs; i++) {
+		size_t off = i * SLO_CTL_MAX_RECORDS;
+		size_t n = nr - off < SLO_CTL_MAX_RECORDS ? nr - off : SLO_CTL_MAX_RECORDS;
+
+		err = send_request(c, SLO_CTL_APPLY, entries + off, n, sizeof(*entries), &seq);
+		if (err) {
+			nr_msgs = i;
+			break;
+		}
+	}
+	if (shadowed)
+		*shadowed = 0;
+	for (size_t i = 0; i < nr_msgs; i++) {
+		struct slo_ctl_applied res = {0};
+
+		ret = recv_reply(c, first_seq + i, &res, sizeof(res));
+		if (!ret && shadowed)
+			*shadowed += res.shadowed;
+		if (ret && !err)
+			err = ret;
+		if (ret == -ECONNRESET)
+			break;
+	}
+	return err;
+}
+
+int ctl_client_query(struct ctl_client_conn *c, const __u64 *ids, size_t nr,
+		     struct slo_ctl_state *out)
+{
+	__u32 seq;
+	int err;
+
+	if (nr > SLO_CTL_MAX_RECORDS)
+		return -E2BIG;
+	err = send_request(c, SLO_CTL_QUERY, ids, nr, sizeof(*ids), &seq);
+	return err ? err : recv_reply(c, seq, out, nr * sizeof(*out));
+}
+
+int ctl_client_subscribe(struct ctl_client_conn *c)
+{
+	__u32 seq;
+	int err;
+
+	err = send_request(c, SLO_CTL_SUBSCRIBE, NULL, 0, 0, &seq);
+	return err ? err : recv_reply(c, seq, NULL, 0);
+}
+
+int ctl_client_read_misses(struct ctl_client_conn *c, struct slo_ctl_miss *out, size_t max,
+			   int timeout_ms)
+{
+	struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+
+	for (;;) {
+		struct slo_ctl_hdr hdr;
+		int n, err;
+
+		n = poll(&pfd, 1, timeout_ms);
+		if (n < 0)
+			return errno == EINTR ? 0 : -errno;
+		if (n == 0)
+			return 0;
+
+		err = read_all(c->fd, &hdr, sizeof(hdr));
+		if (err)
+			return err;
+		if (hdr.len < sizeof(hdr))
+			return -EPROTO;
+		err = read_body(c->fd, &hdr, out, max * sizeof(*out));
+		if (err)
+			return err;
+		if (hdr.type == SLO_CTL_MISS)
+			return hdr.count < max ? hdr.count : max;
+	}
+}
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Control socket client for scx-slo
+ *
+ * Blocking client side of include/slo_ctl.h, for tools, tests and
+ * benchmarks. A connection that subscribed to misses should not be used
+ * for requests as well: misses arriving while a reply is awaited are
+ * discarded.
+ */
+#ifndef __SCX_SLO_CTL_CLIENT_H
+#define __SCX_SLO_CTL_CLIENT_H
+
+#include <stddef.h>
+#include "slo_ctl.h"
+
+struct ctl_client_conn {
+	int fd;
+	__u32 seq;
+};
+
+/* Returns 0 or -errno */
+int ctl_client_connect(struct ctl_client_conn *c, const char *path);
+void ctl_client_close(struct ctl_client_conn *c);
+
+/*
+ * Apply @nr entries, split into messages of SLO_CTL_MAX_RECORDS that are
+ * all sent before the first reply is read. Returns 0, or the first error
+ * the agent reported (-EINVAL for an invalid entry) or -errno. Each
+ * message is applied whole or not at all. If @shadowed is given, it gets
+ * the number of entries the agent left alone for cgroups with a config rule.
+ */
+int ctl_client_apply(struct ctl_client_conn *c, const struct slo_ctl_entry *entries, size_t nr,
+		     size_t *shadowed);
+
+/* Look up @nr <= SLO_CTL_MAX_RECORDS cgroups. Returns 0 or -errno. */
+int ctl_client_query(struct ctl_client_conn *c, const __u64 *ids, size_t nr,
+		     struct slo_ctl_state *out);
+
+/* Start the miss stream on this connection. Returns 0 or -errno. */
+int ctl_client_subscribe(struct ctl_client_conn *c);
+
+/*
+ * Wait up to @timeout_ms for the next MISS message and copy up to @max of
+ * its records to @out. Returns the number copied, 0 on timeout, or -errno
+ * (-ECONNRESET once the agent went away).
+ */
+int ctl_client_read_misses(struct ctl_client_conn *c, struct slo_ctl_miss *out, size_t max,
+			   int timeout_ms);
+
+#endif /* __SCX_SLO_CTL_CLIENT_H */
@@ -0,0 +1,702 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Control socket server for scx-slo
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <libgen.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "ctl_server.h"
+
+/* Largest message either side sends: a full QUERY reply */
+#define CTL_MAX_MSG (sizeof(struct slo_ctl_hdr) + \
+		     SLO_CTL_MAX_RECORDS * sizeof(struct slo_ctl_state))
+
+struct ctl_buf {
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+struct ctl_client {
+	int fd;                 /* -1 = free slot */
+	bool subscribed;
+	bool closing;           /* Drop once the current batch is answered */
+	struct ctl_buf in;
+	struct ctl_buf out;
+	size_t out_off;         /* Bytes of @out already sent */
+};
+
+/* One entry of the pending batch, in arrival order */
+struct batch_op {
+	__u64 cgroup_id;
+	struct slo_cfg cfg;
+	__u32 op;
+	__u32 order;
+	__u32 reply;            /* Index of the request's pending_reply */
+};
+
+/* An APPLY waiting for the batch it joined */
+struct pending_reply {
+	int client;
+	__u32 seq;
+	__u32 shadowed;
+};
+
+struct ctl_server {
+	int listen_fd;
+	int wake_fd;
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+	struct stat sock_st;    /* Of the socket bound at @path */
+	struct ctl_ops ops;
+	pthread_t thread;
+	atomic_bool running;
+
+	struct ctl_client clients[CTL_MAX_CLIENTS];
+
+	/* Owned by the server thread */
+	struct batch_op *batch;
+	size_t nr_batch;
+	struct pending_reply *replies;
+	size_t nr_replies;
+	size_t cap_replies;
+	__u64 *set_keys;
+	struct slo_cfg *set_vals;
+	__u64 *del_keys;
+	bool *shadowed;
+
+	/* Shared with publishers and readers of the stats */
+	pthread_mutex_t lock;
+	struct slo_ctl_miss *misses;
+	size_t nr_misses;
+	struct ctl_stats stats;
+};
+
+bool slo_ctl_cfg_valid(const struct slo_cfg *cfg)
+{
+	return cfg->budget_ns >= MIN_BUDGET_NS && cfg->budget_ns <= MAX_BUDGET_NS &&
+	       cfg->importance >= MIN_IMPORTANCE && cfg->importance <= MAX_IMPORTANCE &&
+	       !(cfg->flags & ~SLO_CFG_FLAGS_MASK) &&
+	       (cfg->flags & SLO_CLASS_MASK) < NR_SLO_CLASSES;
+}
+
+static size_t record_size(__u16 type)
+{
+	switch (type) {
+	case SLO_CTL_APPLY:
+		return sizeof(struct slo_ctl_entry);
+	case SLO_CTL_QUERY:
+		return sizeof(__u64);
+	default:
+		return 0;
+	}
+}
+
+static int buf_reserve(struct ctl_buf *b, size_t extra)
+{
+	size_t cap = b->cap ? b->cap : 4096;
+	char *data;
+
+	if (b->len + extra <= b->cap)
+		return 0;
+	while (cap < b->len + extra)
+		cap *= 2;
+	data = realloc(b->data, cap);
+	if (!data)
+		return -ENOMEM;
+	b->data = data;
+	b->cap = cap;
+	return 0;
+}
+
+static void buf_free(struct ctl_buf *b)
+{
+	free(b->data);
+	memset(b, 0, sizeof(*b));
+}
+
+static void stat_add(struct ctl_server *s, __u64 *field, __u64 n)
+{
+	pthread_mutex_lock(&s->lock);
+	*field += n;
+	pthread_mutex_unlock(&s->lock);
+}
+
+/* Queue a message for @c; a client that stops reading is disconnected */
+static void send_msg(struct ctl_client *c, __u16 type, __u32 seq, __s32 status,
+		     const void *records, __u32 count, size_t rec_size)
+{
+	struct slo_ctl_hdr hdr = {
+		.len = sizeof(hdr) + count * rec_size,
+		.type = type,
+		.version = SLO_CTL_VERSION,
+		.seq = seq,
+		.count = count,
+		.status = status,
+	};
+
+	if (c->fd < 0 || c->closing)
+		return;
+	if (c->out.len - c->out_off + hdr.len > CTL_OUT_LIMIT ||
+	    buf_reserve(&c->out, hdr.len) != 0) {
+		c->closing = true;
+		return;
+	}
+	memcpy(c->out.data + c->out.len, &hdr, sizeof(hdr));
+	if (count)
+		memcpy(c->out.data + c->out.len + sizeof(hdr), records, count * rec_size);
+	c->out.len += hdr.len;
+}
+
+static void reply(struct ctl_server *s, int client, const struct slo_ctl_hdr *req,
+		  __s32 status, const void *records, __u32 count, size_t rec_size)
+{
+	send_msg(&s->clients[client], SLO_CTL_REPLY | req->type, req->seq, status,
+		 records, count, rec_size);
+}
+
+static int cmp_batch_op(const void *a, const void *b)
+{
+	const struct batch_op *oa = a, *ob = b;
+
+	if (oa->cgroup_id != ob->cgroup_id)
+		return oa->cgroup_id < ob->cgroup_id ? -1 : 1;
+	return oa->order < ob->order ? -1 : 1;
+}
+
+/* Write the pending batch and answer every APPLY that joined it */
+static void flush_batch(struct ctl_server *s)
+{
+	size_t nr_set = 0, nr_del = 0;
+	int err;
+
+	if (!s->nr_replies)
+		return;
+
+	/* The last operation on each cgroup wins */
+	qsort(s->batch, s->nr_batch, sizeof(*s->batch), cmp_batch_op);
+	for (size_t i = 0; i < s->nr_batch; i++) {
+		const struct batch_op *op = &s->batch[i];
+
+		if (i + 1 < s->nr_batch && s->batch[i + 1].cgroup_id == op->cgroup_id)
+			continue;
+		if (op->op == SLO_CTL_OP_SET) {
+			s->set_keys[nr_set] = op->cgroup_id;
+			s->set_vals[nr_set++] = op->cfg;
+		} else {
+			s->del_keys[nr_del++] = op->cgroup_id;
+		}
+	}
+
+	memset(s->shadowed, 0, (nr_set + nr_del) * sizeof(*s->shadowed));
+	err = nr_set || nr_del ?
+	      s->ops.apply(s->set_keys, s->set_vals, nr_set, s->del_keys, nr_del, s->shadowed,
+			   s->ops.ctx) : 0;
+
+	/* A cgroup left alone counts against every request that touched it */
+	for (size_t i = 0, first = 0, si = 0, di = 0; !err && i < s->nr_batch; i++) {
+		const struct batch_op *op = &s->batch[i];
+		bool shadowed;
+
+		if (i + 1 < s->nr_batch && s->batch[i + 1].cgroup_id == op->cgroup_id)
+			continue;
+		shadowed = op->op == SLO_CTL_OP_SET ? s->shadowed[si++] :
+			   s->shadowed[nr_set + di++];
+		for (; first <= i; first++) {
+			if (shadowed)
+				s->replies[s->batch[first].reply].shadowed++;
+		}
+	}
+
+	pthread_mutex_lock(&s->lock);
+	s->stats.batches++;
+	s->stats.entries += nr_set + nr_del;
+	s->stats.coalesced += s->nr_batch - nr_set - nr_del;
+	if (err)
+		s->stats.apply_failures++;
+	pthread_mutex_unlock(&s->lock);
+
+	for (size_t i = 0; i < s->nr_replies; i++) {
+		struct slo_ctl_hdr req = { .type = SLO_CTL_APPLY, .seq = s->replies[i].seq };
+		struct slo_ctl_applied res = { .shadowed = s->replies[i].shadowed };
+
+		reply(s, s->replies[i].client, &req, err, &res, 1, sizeof(res));
+	}
+	s->nr_batch = 0;
+	s->nr_replies = 0;
+}
+
+static void handle_apply(struct ctl_server *s, int client, const struct slo_ctl_hdr *hdr,
+			 const struct slo_ctl_entry *entries)
+{
+	/* A request is applied whole or not at all */
+	for (__u32 i = 0; i < hdr->count; i++) {
+		const struct slo_ctl_entry *e = &entries[i];
+
+		if (!e->cgroup_id ||
+		    (e->op != SLO_CTL_OP_SET && e->op != SLO_CTL_OP_DELETE) ||
+		    (e->op == SLO_CTL_OP_SET && !slo_ctl_cfg_valid(&e->cfg))) {
+			stat_add(s, &s->stats.rejected, 1);
+			reply(s, client, hdr, -EINVAL, NULL, 0, 0);
+			return;
+		}
+	}
+
+	if (s->nr_batch + hdr->count > CTL_BATCH_MAX)
+		flush_batch(s);
+	if (s->nr_replies == s->cap_replies) {
+		size_t cap = s->cap_replies ? s->cap_replies * 2 : 64;
+		struct pending_reply *r = realloc(s->replies, cap * sizeof(*r));
+
+		if (!r) {
+			reply(s, client, hdr, -ENOMEM, NULL, 0, 0);
+			return;
+		}
+		s->replies = r;
+		s->cap_replies = cap;
+	}
+
+	for (__u32 i = 0; i < hdr->count; i++) {
+		struct batch_op *op = &s->batch[s->nr_batch];
+
+		op->cgroup_id = entries[i].cgroup_id;
+		op->cfg = entries[i].cfg;
+		op->op = entries[i].op;
+		op->order = s->nr_batch++;
+		op->reply = s->nr_replies;
+	}
+	s->replies[s->nr_replies++] = (struct pending_reply){ client, hdr->seq, 0 };
+}
+
+static void handle_query(struct ctl_server *s, int client, const struct slo_ctl_hdr *hdr,
+			 const __u64 *ids)
+{
+	struct slo_ctl_state *st;
+
+	/* Answer after the writes queued before this query */
+	flush_batch(s);
+
+	st = calloc(hdr->count + 1, sizeof(*st));
+	if (!st) {
+		reply(s, client, hdr, -ENOMEM, NULL, 0, 0);
+		return;
+	}
+	for (__u32 i = 0; i < hdr->count; i++) {
+		st[i].cgroup_id = ids[i];
+		s->ops.query(&st[i], s->ops.ctx);
+	}
+	reply(s, client, hdr, 0, st, hdr->count, sizeof(*st));
+	free(st);
+}
+
+/* Handle every complete message in the client's input. Returns -1 to drop it. */
+static int process_input(struct ctl_server *s, int client)
+{
+	struct ctl_client *c = &s->clients[client];
+	size_t off = 0;
+
+	while (c->in.len - off >= sizeof(struct slo_ctl_hdr)) {
+		struct slo_ctl_hdr hdr;
+		const void *body;
+
+		memcpy(&hdr, c->in.data + off, sizeof(hdr));
+		/* Framing errors cannot be recovered from: the stream is lost */
+		if (hdr.len < sizeof(hdr) || hdr.len > CTL_MAX_MSG)
+			return -1;
+		if (c->in.len - off < hdr.len)
+			break;
+		body = c->in.data + off + sizeof(hdr);
+		off += hdr.len;
+		stat_add(s, &s->stats.requests, 1);
+
+		if (hdr.version != SLO_CTL_VERSION || hdr.count > SLO_CTL_MAX_RECORDS ||
+		    hdr.len != sizeof(hdr) + (size_t)hdr.count * record_size(hdr.type)) {
+			stat_add(s, &s->stats.rejected, 1);
+			reply(s, client, &hdr, -EPROTO, NULL, 0, 0);
+			continue;
+		}
+
+		switch (hdr.type) {
+		case SLO_CTL_APPLY:
+			handle_apply(s, client, &hdr, body);
+			break;
+		case SLO_CTL_QUERY:
+			handle_query(s, client, &hdr, body);
+			break;
+		case SLO_CTL_SUBSCRIBE:
+			if (!c->subscribed) {
+				c->subscribed = true;
+				pthread_mutex_lock(&s->lock);
+				s->stats.subscribers++;
+				pthread_mutex_unlock(&s->lock);
+			}
+			reply(s, client, &hdr, 0, NULL, 0, 0);
+			break;
+		default:
+			stat_add(s, &s->stats.rejected, 1);
+			reply(s, client, &hdr, -EOPNOTSUPP, NULL, 0, 0);
+			break;
+		}
+	}
+
+	memmove(c->in.data, c->in.data + off, c->in.len - off);
+	c->in.len -= off;
+	return 0;
+}
+
+static void read_client(struct ctl_server *s, int client)
+{
+	struct ctl_client *c = &s->clients[client];
+
+	for (;;) {
+		ssize_t n;
+
+		if (buf_reserve(&c->in, 64 * 1024) != 0) {
+			c->closing = true;
+			return;
+		}
+		n = recv(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len, 0);
+		if (n > 0) {
+			c->in.len += n;
+			if (process_input(s, client) != 0) {
+				c->closing = true;
+				return;
+			}
+			continue;
+		}
+		if (n == 0 || (errno != EAGAIN && errno != EINTR))
+			c->closing = true;
+		if (n < 0 && errno == EINTR)
+			continue;
+		return;
+	}
+}
+
+static void write_client(struct ctl_client *c)
+{
+	while (c->out_off < c->out.len) {
+		ssize_t n = send(c->fd, c->out.data + c->out_off, c->out.len - c->out_off,
+				 MSG_NOSIGNAL | MSG_DONTWAIT);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN)
+				c->closing = true;
+			break;
+		}
+		c->out_off += n;
+	}
+	if (c->out_off == c->out.len)
+		c->out.len = c->out_off = 0;
+}
+
+static void close_client(struct ctl_server *s, int client)
+{
+	struct ctl_client *c = &s->clients[client];
+
+	close(c->fd);
+	buf_free(&c->in);
+	buf_free(&c->out);
+	pthread_mutex_lock(&s->lock);
+	s->stats.clients--;
+	if (c->subscribed)
+		s->stats.subscribers--;
+	pthread_mutex_unlock(&s->lock);
+	memset(c, 0, sizeof(*c));
+	c->fd = -1;
+}
+
+static void accept_clients(struct ctl_server *s)
+{
+	for (;;) {
+		int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		int i;
+
+		if (fd < 0)
+			return;
+		for (i = 0; i < CTL_MAX_CLIENTS && s->clients[i].fd >= 0; i++)
+			;
+		if (i == CTL_MAX_CLIENTS) {
+			close(fd);
+			continue;
+		}
+		s->clients[i].fd = fd;
+		pthread_mutex_lock(&s->lock);
+		s->stats.clients++;
+		pthread_mutex_unlock(&s->lock);
+	}
+}
+
+/* Hand queued misses to every subscriber as one MISS message each */
+static void deliver_misses(struct ctl_server *s)
+{
+	struct slo_ctl_miss *batch;
+	size_t nr;
+
+	pthread_mutex_lock(&s->lock);
+	nr = s->nr_misses;
+	batch = nr ? malloc(nr * sizeof(*batch)) : NULL;
+	if (batch)
+		memcpy(batch, s->misses, nr * sizeof(*batch));
+	s->nr_misses = 0;
+	if (nr && !batch)
+		s->stats.misses_dropped += nr;
+	pthread_mutex_unlock(&s->lock);
+	if (!batch)
+		return;
+
+	for (int i = 0; i < CTL_MAX_CLIENTS; i++) {
+		struct ctl_client *c = &s->clients[i];
+
+		for (size_t off = 0; c->fd >= 0 && c->subscribed && off < nr;
+		     off += SLO_CTL_MAX_RECORDS) {
+			__u32 n = nr - off < SLO_CTL_MAX_RECORDS ? nr - off : SLO_CTL_MAX_RECORDS;
+
+			/* A slow subscriber loses misses rather than its connection */
+			if (c->out.len - c->out_off + n * sizeof(*batch) > CTL_OUT_LIMIT / 2) {
+				stat_add(s, &s->stats.misses_dropped, n);
+				continue;
+			}
+			send_msg(c, SLO_CTL_MISS, 0, 0, batch + off, n, sizeof(*batch));
+			stat_add(s, &s->stats.misses_sent, n);
+		}
+	}
+	free(batch);
+}
+
+static void *server_thread(void *arg)
+{
+	struct ctl_server *s = arg;
+	struct pollfd pfds[CTL_MAX_CLIENTS + 2];
+	int slot[CTL_MAX_CLIENTS + 2];
+
+	while (atomic_load(&s->running)) {
+		int nfds = 2, n;
+
+		pfds[0] = (struct pollfd){ .fd = s->listen_fd, .events = POLLIN };
+		pfds[1] = (struct pollfd){ .fd = s->wake_fd, .events = POLLIN };
+		for (int i = 0; i < CTL_MAX_CLIENTS; i++) {
+			struct ctl_client *c = &s->clients[i];
+
+			if (c->fd < 0)
+				continue;
+			pfds[nfds] = (struct pollfd){ .fd = c->fd, .events = POLLIN };
+			if (c->out_off < c->out.len)
+				pfds[nfds].events |= POLLOUT;
+			slot[nfds++] = i;
+		}
+
+		n = poll(pfds, nfds, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (pfds[1].revents & POLLIN) {
+			__u64 v;
+
+			if (read(s->wake_fd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+				break;
+		}
+		if (pfds[0].revents & POLLIN)
+			accept_clients(s);
+
+		/*
+		 * Read everything every client sent before writing anything:
+		 * APPLYs that arrived together share one batch.
+		 */
+		for (int i = 2; i < nfds; i++) {
+			if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+				read_client(s, slot[i]);
+		}
+		flush_batch(s);
+		deliver_misses(s);
+
+		for (int i = 0; i < CTL_MAX_CLIENTS; i++) {
+			struct ctl_client *c = &s->clients[i];
+
+			if (c->fd < 0)
+				continue;
+			if (!c->closing)
+				write_client(c);
+			if (c->closing)
+				close_client(s, i);
+		}
+	}
+	return NULL;
+}
+
+static int listen_on(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	char dir[sizeof(addr.sun_path)];
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	strcpy(dir, path);
+	if (mkdir(dirname(dir), 0755) != 0 && errno != EEXIST)
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	/* A previous agent's socket is stale by the time a new one starts */
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    chmod(path, 0600) != 0 || listen(fd, CTL_MAX_CLIENTS) != 0) {
+		int err = errno;
+
+		close(fd);
+		unlink(path);
+		errno = err;
+		return -1;
+	}
+	return fd;
+}
+
+struct ctl_server *ctl_server_start(const char *path, const struct ctl_ops *ops)
+{
+	struct ctl_server *s = calloc(1, sizeof(*s));
+	int err;
+
+	if (!s)
+		return NULL;
+	s->listen_fd = s->wake_fd = -1;
+	s->ops = *ops;
+	snprintf(s->path, sizeof(s->path), "%s", path);
+	pthread_mutex_init(&s->lock, NULL);
+	for (int i = 0; i < CTL_MAX_CLIENTS; i++)
+		s->clients[i].fd = -1;
+
+	s->batch = malloc(CTL_BATCH_MAX * sizeof(*s->batch));
+	s->set_keys = malloc(CTL_BATCH_MAX * sizeof(*s->set_keys));
+	s->set_vals = malloc(CTL_BATCH_MAX * sizeof(*s->set_vals));
+	s->del_keys = malloc(CTL_BATCH_MAX * sizeof(*s->del_keys));
+	s->shadowed = malloc(CTL_BATCH_MAX * sizeof(*s->shadowed));
+	s->misses = malloc(CTL_MISS_RING * sizeof(*s->misses));
+	if (!s->batch || !s->set_keys || !s->set_vals || !s->del_keys || !s->shadowed ||
+	    !s->misses) {
+		errno = ENOMEM;
+		goto fail;
+	}
+
+	s->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (s->wake_fd < 0)
+		goto fail;
+	s->listen_fd = listen_on(path);
+	if (s->listen_fd < 0 || stat(path, &s->sock_st) != 0)
+		goto fail;
+
+	atomic_store(&s->running, true);
+	err = pthread_create(&s->thread, NULL, server_thread, s);
+	if (err) {
+		errno = err;
+		goto fail;
+	}
+	return s;
+
+fail:
+	err = errno;
+	if (s->listen_fd >= 0) {
+		close(s->listen_fd);
+		unlink(path);
+	}
+	if (s->wake_fd >= 0)
+		close(s->wake_fd);
+	free(s->batch);
+	free(s->set_keys);
+	free(s->set_vals);
+	free(s->del_keys);
+	free(s->shadowed);
+	free(s->misses);
+	pthread_mutex_destroy(&s->lock);
+	free(s);
+	errno = err;
+	return NULL;
+}
+
+static void wake(struct ctl_server *s)
+{
+	__u64 one = 1;
+
+	if (write(s->wake_fd, &one, sizeof(one)) < 0) {
+		/* The counter is saturated, so a wakeup is pending anyway */
+	}
+}
+
+void ctl_server_publish_miss(struct ctl_server *s, const struct slo_ctl_miss *miss)
+{
+	bool queued = false;
+
+	if (!s)
+		return;
+	pthread_mutex_lock(&s->lock);
+	if (s->stats.subscribers) {
+		if (s->nr_misses < CTL_MISS_RING) {
+			s->misses[s->nr_misses++] = *miss;
+			queued = true;
+		} else {
+			s->stats.misses_dropped++;
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+	if (queued)
+		wake(s);
+}
+
+void ctl_server_get_stats(struct ctl_server *s, struct ctl_stats *out)
+{
+	pthread_mutex_lock(&s->lock);
+	*out = s->stats;
+	pthread_mutex_unlock(&s->lock);
+}
+
+void ctl_server_stop(struct ctl_server *s)
+{
+	struct stat st;
+
+	if (!s)
+		return;
+
+	atomic_store(&s->running, false);
+	wake(s);
+	pthread_join(s->thread, NULL);
+
+	for (int i = 0; i < CTL_MAX_CLIENTS; i++) {
+		if (s->clients[i].fd >= 0)
+			close_client(s, i);
+	}
+	close(s->listen_fd);
+	close(s->wake_fd);
+	/* During a handoff the next agent may already listen at the same path */
+	if (stat(s->path, &st) == 0 && st.st_ino == s->sock_st.st_ino &&
+	    st.st_dev == s->sock_st.st_dev)
+		unlink(s->path);
+	free(s->batch);
+	free(s->set_keys);
+	free(s->set_vals);
+	free(s->del_keys);
+	free(s->shadowed);
+	free(s->replies);
+	free(s->misses);
+	pthread_mutex_destroy(&s->lock);
+	free(s);
+}
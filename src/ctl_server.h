@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Control socket server for scx-slo
+ *
+ * Serves the protocol in include/slo_ctl.h on a Unix stream socket from
+ * one thread. APPLY requests from all clients that arrive together are
+ * validated, merged (the last operation on a cgroup wins) and handed to
+ * the map writer as one batch, so a burst of small requests costs a few
+ * batched map operations instead of one syscall per entry. Each APPLY is
+ * answered once its batch was written, with the number of its entries the
+ * map writer left alone. A QUERY first flushes the pending
+ * batch, so clients read their own writes.
+ */
+#ifndef __SCX_SLO_CTL_SERVER_H
+#define __SCX_SLO_CTL_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "slo_ctl.h"
+
+#define CTL_MAX_CLIENTS 64
+
+/* Entries merged into one batch at most */
+#define CTL_BATCH_MAX (4 * SLO_CTL_MAX_RECORDS)
+
+/* Misses buffered between the event loop and the server thread */
+#define CTL_MISS_RING 8192
+
+/* Output queued for one client; slower subscribers lose misses */
+#define CTL_OUT_LIMIT (4 << 20)
+
+struct ctl_ops {
+	/*
+	 * Write @nr_set entries and delete @nr_del keys, each set in one
+	 * operation where possible. Keys are unique across both arrays.
+	 * Entries deliberately left alone are flagged in @shadowed, which
+	 * comes zeroed: set key i at [i], delete key j at [nr_set + j].
+	 * Returns 0 or -errno, which every request in the batch gets back.
+	 */
+	int (*apply)(const __u64 *set_keys, const struct slo_cfg *set_vals, size_t nr_set,
+		     const __u64 *del_keys, size_t nr_del, bool *shadowed, void *ctx);
+	/* Fill @st for st->cgroup_id, which is set; the rest is zeroed */
+	void (*query)(struct slo_ctl_state *st, void *ctx);
+	void *ctx;
+};
+
+struct ctl_stats {
+	__u64 requests;         /* Messages received */
+	__u64 rejected;         /* Requests answered with an error before applying */
+	__u64 batches;          /* Calls of ops->apply */
+	__u64 entries;          /* Entries passed to ops->apply */
+	__u64 coalesced;        /* Entries superseded within a batch */
+	__u64 apply_failures;   /* Batches ops->apply failed */
+	__u64 misses_sent;      /* Miss records queued to subscribers */
+	__u64 misses_dropped;   /* Miss records lost to full buffers */
+	__u32 clients;
+	__u32 subscribers;
+};
+
+struct ctl_server;
+
+/*
+ * Listen on @path, replacing a stale socket, and serve from a new thread.
+ * The socket is only accessible to the agent's user. Returns NULL with
+ * errno set on failure.
+ */
+struct ctl_server *ctl_server_start(const char *path, const struct ctl_ops *ops);
+
+/* Queue a deadline miss for subscribers. Never blocks; safe from any thread. */
+void ctl_server_publish_miss(struct ctl_server *s, const struct slo_ctl_miss *miss);
+
+void ctl_server_get_stats(struct ctl_server *s, struct ctl_stats *out);
+
+/* Stop the thread, disconnect clients and remove the socket */
+void ctl_server_stop(struct ctl_server *s);
+
+/* Whether @cfg passes the checks a config file rule gets */
+bool slo_ctl_cfg_valid(const struct slo_cfg *cfg);
+
+#endif /* __SCX_SLO_CTL_SERVER_H */
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Scheduler handoff between agent instances for scx-slo
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "handoff.h"
+
+/* State poll interval; the detach itself is the only thing we wait on */
+#define HANDOFF_POLL_NS 200000
+
+int sched_ext_state(const char *path, char *buf, size_t len)
+{
+	ssize_t n;
+	int fd;
+
+	if (len == 0)
+		return -EINVAL;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	n = pread(fd, buf, len - 1, 0);
+	if (n < 0) {
+		int err = -errno;
+
+		close(fd);
+		return err;
+	}
+	close(fd);
+
+	buf[n] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+static __u64 monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int handoff_wait_detached(const char *path, int timeout_ms)
+{
+	struct timespec poll = { .tv_nsec = HANDOFF_POLL_NS };
+	__u64 deadline = monotonic_ns() + (__u64)timeout_ms * 1000000ULL;
+	char state[32];
+	int err;
+
+	for (;;) {
+		err = sched_ext_state(path, state, sizeof(state));
+		if (err)
+			return err;
+		if (strcmp(state, "disabled") == 0)
+			return 0;
+		if (monotonic_ns() >= deadline)
+			return -ETIMEDOUT;
+		nanosleep(&poll, NULL);
+	}
+}
+
+__u64 handoff_gap_ns(const struct slo_handoff *h)
+{
+	if (!h->detach_ns || h->attach_ns < h->detach_ns)
+		return 0;
+	return h->attach_ns - h->detach_ns;
+}
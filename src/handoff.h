@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Scheduler handoff between agent instances for scx-slo
+ *
+ * Only one sched_ext scheduler can be attached at a time, so an upgrade
+ * cannot overlap the old and new scheduler. To keep the window short, the
+ * new agent opens and verifies its BPF program while the old one is still
+ * attached, sharing state through the pinned maps, then asks the old agent
+ * to detach and attaches the moment sched_ext reports it is free.
+ */
+#ifndef __SCX_SLO_HANDOFF_H
+#define __SCX_SLO_HANDOFF_H
+
+#include <stddef.h>
+#include "scx_slo.h"
+
+#define SCHED_EXT_STATE_PATH "/sys/kernel/sched_ext/state"
+
+/* How long a new instance waits for the old one to detach */
+#define HANDOFF_TIMEOUT_MS 30000
+
+/* Read the sched_ext state ("enabled", "disabled", ...) from @path */
+int sched_ext_state(const char *path, char *buf, size_t len);
+
+/*
+ * Poll @path until sched_ext reports "disabled". Returns 0 once it does,
+ * -ETIMEDOUT after @timeout_ms, or -errno if the state cannot be read.
+ */
+int handoff_wait_detached(const char *path, int timeout_ms);
+
+/*
+ * Time between the previous instance detaching and the current one
+ * attaching, or 0 if no previous detach was recorded.
+ */
+__u64 handoff_gap_ns(const struct slo_handoff *h);
+
+#endif /* __SCX_SLO_HANDOFF_H */
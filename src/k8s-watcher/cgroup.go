@@ -0,0 +1,263 @@
+package main
+
+import (
+	"errors"
+	"fmt"
+	"path/filepath"
+	"sort"
+	"strings"
+	"unsafe"
+
+	"golang.org/x/sys/unix"
+	corev1 "k8s.io/api/core/v1"
+	"k8s.io/apimachinery/pkg/types"
+)
+
+// Kubelet cgroup layouts. With the systemd driver a burstable pod lives at
+// kubepods.slice/kubepods-burstable.slice/kubepods-burstable-pod<uid>.slice,
+// with the dashes of the UID turned into underscores, and each container in
+// a <runtime>-<id>.scope below it. With the cgroupfs driver the same pod is
+// kubepods/burstable/pod<uid>/<id>. Guaranteed pods sit directly below the
+// kubepods root in both layouts.
+type cgroupDriver int
+
+const (
+	driverSystemd cgroupDriver = iota
+	driverCgroupfs
+)
+
+var errNoKubepods = errors.New("no kubepods cgroup")
+
+// cgroupResolver maps pods to the IDs of their pod and container cgroups.
+// It keeps O_PATH fds of the kubepods root, the QoS directories and every
+// live pod directory, so resolving a container is one name_to_handle_at
+// relative to its pod, and restarts cost no path walks. It is not safe for
+// concurrent use; the reconciler is its only caller.
+type cgroupResolver struct {
+	root   string
+	driver cgroupDriver
+	rootFd int               // kubepods root, -1 until found
+	qosFds map[string]int    // QoS class directories by class
+	podFds map[types.UID]int // Pod directories of live pods
+}
+
+func newCgroupResolver(root string) *cgroupResolver {
+	return &cgroupResolver{
+		root:   root,
+		rootFd: -1,
+		qosFds: make(map[string]int),
+		podFds: make(map[types.UID]int),
+	}
+}
+
+func openDir(dirfd int, name string) (int, error) {
+	return unix.Openat(dirfd, name, unix.O_PATH|unix.O_DIRECTORY|unix.O_CLOEXEC, 0)
+}
+
+// cgroupID returns the kernel ID of the cgroup @name below @dirfd, or of
+// @dirfd itself when @name is empty. On cgroup2 the file handle is the
+// 64-bit cgroup ID. Filesystems without handles fall back to the inode
+// number, which is the same ID on cgroup2.
+func cgroupID(dirfd int, name string) (uint64, error) {
+	flags := 0
+	if name == "" {
+		flags = unix.AT_EMPTY_PATH
+	}
+	h, _, err := unix.NameToHandleAt(dirfd, name, flags)
+	if err == nil {
+		b := h.Bytes()
+		if len(b) < 8 {
+			return 0, fmt.Errorf("handle of %q too small for an ID: %d bytes", name, len(b))
+		}
+		return *(*uint64)(unsafe.Pointer(&b[0])), nil
+	}
+	if !errors.Is(err, unix.EOPNOTSUPP) {
+		return 0, err
+	}
+	var st unix.Stat_t
+	if err := unix.Fstatat(dirfd, name, &st, flags|unix.AT_SYMLINK_NOFOLLOW); err != nil {
+		return 0, err
+	}
+	return st.Ino, nil
+}
+
+// openRoot finds the kubepods root and, with it, the kubelet's driver
+func (c *cgroupResolver) openRoot() error {
+	if c.rootFd >= 0 {
+		return nil
+	}
+	for _, d := range []struct {
+		name   string
+		driver cgroupDriver
+	}{{"kubepods.slice", driverSystemd}, {"kubepods", driverCgroupfs}} {
+		fd, err := openDir(unix.AT_FDCWD, filepath.Join(c.root, d.name))
+		if err == nil {
+			c.rootFd, c.driver = fd, d.driver
+			return nil
+		}
+	}
+	return fmt.Errorf("%w below %s", errNoKubepods, c.root)
+}
+
+// qosDir returns the fd of the directory holding pods of class @qos
+func (c *cgroupResolver) qosDir(qos string) (int, error) {
+	if qos == "" || qos == "guaranteed" {
+		return c.rootFd, nil
+	}
+	if fd, ok := c.qosFds[qos]; ok {
+		return fd, nil
+	}
+	name := qos
+	if c.driver == driverSystemd {
+		name = fmt.Sprintf("kubepods-%s.slice", qos)
+	}
+	fd, err := openDir(c.rootFd, name)
+	if err != nil {
+		return -1, fmt.Errorf("open QoS cgroup %s: %w", name, err)
+	}
+	c.qosFds[qos] = fd
+	return fd, nil
+}
+
+// podDirName is the name of a pod's cgroup within its QoS directory
+func (c *cgroupResolver) podDirName(pod *corev1.Pod, qos string) string {
+	if c.driver == driverCgroupfs {
+		return "pod" + string(pod.UID)
+	}
+	uid := strings.ReplaceAll(string(pod.UID), "-", "_")
+	if qos == "" || qos == "guaranteed" {
+		return fmt.Sprintf("kubepods-pod%s.slice", uid)
+	}
+	return fmt.Sprintf("kubepods-%s-pod%s.slice", qos, uid)
+}
+
+// podDir returns the cached fd of the pod's cgroup, opening it on first use
+func (c *cgroupResolver) podDir(pod *corev1.Pod) (int, error) {
+	if fd, ok := c.podFds[pod.UID]; ok {
+		return fd, nil
+	}
+	if err := c.openRoot(); err != nil {
+		return -1, err
+	}
+	qos := strings.ToLower(string(pod.Status.QOSClass))
+	parent, err := c.qosDir(qos)
+	if err != nil {
+		return -1, err
+	}
+	name := c.podDirName(pod, qos)
+	fd, err := openDir(parent, name)
+	if err != nil {
+		return -1, fmt.Errorf("open pod cgroup %s: %w", name, err)
+	}
+	c.podFds[pod.UID] = fd
+	return fd, nil
+}
+
+// containerDirNames lists the cgroup names a container may have below its
+// pod, most likely first. containerID is the runtime://id form of the
+// container status; containerd and cri-dockerd name the cgroup after the
+// bare ID under cgroupfs, CRI-O always prefixes it.
+func (c *cgroupResolver) containerDirNames(containerID string) []string {
+	runtime, id, ok := strings.Cut(containerID, "://")
+	if !ok || id == "" || strings.ContainsRune(id, '/') {
+		return nil
+	}
+	prefixes := []string{"cri-containerd", "crio", "docker"}
+	switch runtime {
+	case "cri-o":
+		prefixes = []string{"crio", "cri-containerd", "docker"}
+	case "docker":
+		prefixes = []string{"docker", "cri-containerd", "crio"}
+	}
+
+	if c.driver == driverCgroupfs {
+		if runtime == "cri-o" {
+			return []string{"crio-" + id, id}
+		}
+		return []string{id, "crio-" + id}
+	}
+	var names []string
+	for _, p := range prefixes {
+		names = append(names, fmt.Sprintf("%s-%s.scope", p, id))
+	}
+	return names
+}
+
+// runningContainerIDs returns the runtime IDs of the pod's running
+// containers, init and ephemeral ones included, sorted.
+func runningContainerIDs(pod *corev1.Pod) []string {
+	var ids []string
+	for _, statuses := range [][]corev1.ContainerStatus{
+		pod.Status.InitContainerStatuses,
+		pod.Status.ContainerStatuses,
+		pod.Status.EphemeralContainerStatuses,
+	} {
+		for _, s := range statuses {
+			if s.State.Running != nil && s.ContainerID != "" {
+				ids = append(ids, s.ContainerID)
+			}
+		}
+	}
+	sort.Strings(ids)
+	return ids
+}
+
+// podCgroupsKey identifies the set of cgroups a pod has; it changes when a
+// container restarts.
+func podCgroupsKey(pod *corev1.Pod) string {
+	return strings.Join(runningContainerIDs(pod), ",")
+}
+
+// Resolve returns the IDs of the pod's cgroup and of all its running
+// containers' cgroups. Threads run in the container cgroups, so each gets
+// its own entry rather than relying on inheritance from the pod. If some
+// containers cannot be found yet, the IDs found so far are returned with
+// an error, and the pod should be resolved again later.
+func (c *cgroupResolver) Resolve(pod *corev1.Pod) ([]uint64, error) {
+	podFd, err := c.podDir(pod)
+	if err != nil {
+		return nil, err
+	}
+	podID, err := cgroupID(podFd, "")
+	if err != nil {
+		c.forget(pod.UID)
+		return nil, err
+	}
+
+	ids := []uint64{podID}
+	var missing []string
+	for _, cid := range runningContainerIDs(pod) {
+		found := false
+		for _, name := range c.containerDirNames(cid) {
+			id, err := cgroupID(podFd, name)
+			if err == nil {
+				ids = append(ids, id)
+				found = true
+				break
+			}
+		}
+		if !found {
+			missing = append(missing, cid)
+		}
+	}
+	if len(missing) > 0 {
+		return ids, fmt.Errorf("no cgroup for containers %s of pod %s", strings.Join(missing, ", "), pod.Name)
+	}
+	return ids, nil
+}
+
+func (c *cgroupResolver) forget(uid types.UID) {
+	if fd, ok := c.podFds[uid]; ok {
+		unix.Close(fd)
+		delete(c.podFds, uid)
+	}
+}
+
+// Retain closes the cached directories of pods not in @live
+func (c *cgroupResolver) Retain(live map[types.UID]bool) {
+	for uid := range c.podFds {
+		if !live[uid] {
+			c.forget(uid)
+		}
+	}
+}
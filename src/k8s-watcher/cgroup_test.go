@@ -0,0 +1,189 @@
+package main
+
+import (
+	"os"
+	"path/filepath"
+	"sort"
+	"testing"
+
+	"golang.org/x/sys/unix"
+	corev1 "k8s.io/api/core/v1"
+	metav1 "k8s.io/apimachinery/pkg/apis/meta/v1"
+	"k8s.io/apimachinery/pkg/types"
+)
+
+const testPodUID = "6f1c2a3b-0d4e-4f5a-8b9c-0123456789ab"
+
+func cgroupPod(qos corev1.PodQOSClass, containerIDs ...string) *corev1.Pod {
+	pod := &corev1.Pod{
+		ObjectMeta: metav1.ObjectMeta{Name: "web", Namespace: "default", UID: types.UID(testPodUID)},
+		Status:     corev1.PodStatus{Phase: corev1.PodRunning, QOSClass: qos},
+	}
+	for _, id := range containerIDs {
+		pod.Status.ContainerStatuses = append(pod.Status.ContainerStatuses, corev1.ContainerStatus{
+			ContainerID: id,
+			State:       corev1.ContainerState{Running: &corev1.ContainerStateRunning{}},
+		})
+	}
+	return pod
+}
+
+// mkCgroups creates dirs below a fresh root and returns the root and the ID
+// of each dir, resolved by full path.
+func mkCgroups(t *testing.T, dirs ...string) (string, map[string]uint64) {
+	t.Helper()
+	root := t.TempDir()
+	ids := make(map[string]uint64)
+	for _, d := range dirs {
+		path := filepath.Join(root, d)
+		if err := os.MkdirAll(path, 0755); err != nil {
+			t.Fatal(err)
+		}
+		id, err := cgroupID(unix.AT_FDCWD, path)
+		if err != nil {
+			t.Fatal(err)
+		}
+		ids[d] = id
+	}
+	return root, ids
+}
+
+func sortedIDs(ids []uint64) []uint64 {
+	sort.Slice(ids, func(i, j int) bool { return ids[i] < ids[j] })
+	return ids
+}
+
+func expectIDs(t *testing.T, got []uint64, ids map[string]uint64, dirs ...string) {
+	t.Helper()
+	var want []uint64
+	for _, d := range dirs {
+		want = append(want, ids[d])
+	}
+	got, want = sortedIDs(got), sortedIDs(want)
+	if len(got) != len(want) {
+		t.Fatalf("resolved %v, want %v (%v)", got, want, dirs)
+	}
+	for i := range got {
+		if got[i] != want[i] {
+			t.Fatalf("resolved %v, want %v (%v)", got, want, dirs)
+		}
+	}
+}
+
+func TestResolveLayouts(t *testing.T) {
+	const uidSystemd = "6f1c2a3b_0d4e_4f5a_8b9c_0123456789ab"
+	cases := []struct {
+		name       string
+		qos        corev1.PodQOSClass
+		containers []string
+		dirs       []string // Pod cgroup first, then its containers
+	}{
+		{"systemd containerd", corev1.PodQOSBurstable,
+			[]string{"containerd://aaa", "containerd://bbb"},
+			[]string{
+				"kubepods.slice/kubepods-burstable.slice/kubepods-burstable-pod" + uidSystemd + ".slice",
+				"kubepods.slice/kubepods-burstable.slice/kubepods-burstable-pod" + uidSystemd + ".slice/cri-containerd-aaa.scope",
+				"kubepods.slice/kubepods-burstable.slice/kubepods-burstable-pod" + uidSystemd + ".slice/cri-containerd-bbb.scope",
+			}},
+		{"systemd cri-o guaranteed", corev1.PodQOSGuaranteed,
+			[]string{"cri-o://ccc"},
+			[]string{
+				"kubepods.slice/kubepods-pod" + uidSystemd + ".slice",
+				"kubepods.slice/kubepods-pod" + uidSystemd + ".slice/crio-ccc.scope",
+			}},
+		{"cgroupfs containerd", corev1.PodQOSBestEffort,
+			[]string{"containerd://ddd"},
+			[]string{
+				"kubepods/besteffort/pod" + testPodUID,
+				"kubepods/besteffort/pod" + testPodUID + "/ddd",
+			}},
+		{"cgroupfs cri-o", corev1.PodQOSBurstable,
+			[]string{"cri-o://eee"},
+			[]string{
+				"kubepods/burstable/pod" + testPodUID,
+				"kubepods/burstable/pod" + testPodUID + "/crio-eee",
+			}},
+	}
+	for _, c := range cases {
+		t.Run(c.name, func(t *testing.T) {
+			root, ids := mkCgroups(t, c.dirs...)
+			r := newCgroupResolver(root)
+			got, err := r.Resolve(cgroupPod(c.qos, c.containers...))
+			if err != nil {
+				t.Fatal(err)
+			}
+			expectIDs(t, got, ids, c.dirs...)
+			r.Retain(nil)
+		})
+	}
+}
+
+func TestResolveRestartsAndMissingContainers(t *testing.T) {
+	podDir := "kubepods/burstable/pod" + testPodUID
+	root, ids := mkCgroups(t, podDir, podDir+"/aaa")
+	r := newCgroupResolver(root)
+
+	// bbb has not got its cgroup yet: the rest is returned with an error
+	got, err := r.Resolve(cgroupPod(corev1.PodQOSBurstable, "containerd://aaa", "containerd://bbb"))
+	if err == nil {
+		t.Fatal("missing container cgroup not reported")
+	}
+	expectIDs(t, got, ids, podDir, podDir+"/aaa")
+
+	// aaa restarts as bbb; the cached pod fd still finds the new cgroup
+	// even after the path above it is no longer reachable by name
+	if err := os.Mkdir(filepath.Join(root, podDir, "bbb"), 0755); err != nil {
+		t.Fatal(err)
+	}
+	bbb, err := cgroupID(unix.AT_FDCWD, filepath.Join(root, podDir, "bbb"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := os.Rename(filepath.Join(root, "kubepods"), filepath.Join(root, "moved")); err != nil {
+		t.Fatal(err)
+	}
+	got, err = r.Resolve(cgroupPod(corev1.PodQOSBurstable, "containerd://bbb"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	ids["bbb"] = bbb
+	expectIDs(t, got, ids, podDir, "bbb")
+
+	// Once the pod is gone its fd is closed and the pod is looked up again
+	r.Retain(map[types.UID]bool{})
+	if len(r.podFds) != 0 {
+		t.Fatalf("%d pod fds left open", len(r.podFds))
+	}
+	if err := os.RemoveAll(filepath.Join(root, "moved/burstable/pod"+testPodUID)); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := r.Resolve(cgroupPod(corev1.PodQOSBurstable)); err == nil {
+		t.Fatal("resolved a removed pod")
+	}
+}
+
+func TestResolveNoKubepods(t *testing.T) {
+	r := newCgroupResolver(t.TempDir())
+	if _, err := r.Resolve(cgroupPod(corev1.PodQOSBurstable)); err == nil {
+		t.Fatal("resolved a pod without a kubepods cgroup")
+	}
+}
+
+func TestContainerDirNames(t *testing.T) {
+	r := &cgroupResolver{driver: driverSystemd}
+	if got := r.containerDirNames("cri-o://abc"); got[0] != "crio-abc.scope" {
+		t.Fatalf("systemd cri-o: %v", got)
+	}
+	if got := r.containerDirNames("containerd://abc"); got[0] != "cri-containerd-abc.scope" {
+		t.Fatalf("systemd containerd: %v", got)
+	}
+	for _, bad := range []string{"", "abc", "containerd://", "containerd://../x"} {
+		if got := r.containerDirNames(bad); got != nil {
+			t.Fatalf("%q gave %v", bad, got)
+		}
+	}
+	r.driver = driverCgroupfs
+	if got := r.containerDirNames("docker://abc"); got[0] != "abc" {
+		t.Fatalf("cgroupfs docker: %v", got)
+	}
+}
@@ -0,0 +1,260 @@
+package main
+
+import (
+	"bufio"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"syscall"
+	"time"
+)
+
+// Control protocol of the agent, mirroring include/slo_ctl.h. The agent
+// owns every write to the SLO map; the watcher sends it batches over a
+// Unix socket. Integers are in host byte order.
+const (
+	ctlVersion    = 1
+	ctlMaxRecords = 4096
+
+	ctlApply = 1
+	ctlQuery = 2
+	ctlReply = 0x80
+
+	ctlOpSet    = 1
+	ctlOpDelete = 2
+
+	ctlHdrSize     = 24
+	ctlEntrySize   = 32
+	ctlAppliedSize = 8
+	ctlStateSize   = 48
+)
+
+var hostOrder = binary.NativeEndian
+
+type ctlHdr struct {
+	Len     uint32
+	Type    uint16
+	Version uint16
+	Seq     uint32
+	Count   uint32
+	Status  int32
+	_       uint32
+}
+
+type ctlEntry struct {
+	CgroupID uint64
+	Cfg      sloCfg
+	Op       uint32
+	_        uint32
+}
+
+// ctlApplied is the record of an APPLY reply.
+type ctlApplied struct {
+	Shadowed uint32 // Entries left alone: the cgroup has an agent config rule
+	_        uint32
+}
+
+type ctlState struct {
+	CgroupID       uint64
+	Cfg            sloCfg
+	Present        uint32
+	_              uint32
+	DeadlineMisses uint64
+	MissDurationNs uint64
+}
+
+// ctlError is an error the agent answered a request with.
+type ctlError struct {
+	op  string
+	err syscall.Errno
+}
+
+func (e *ctlError) Error() string { return fmt.Sprintf("agent %s: %v", e.op, e.err) }
+func (e *ctlError) Unwrap() error { return e.err }
+
+// agentSLOMap is the SLO map behind the agent's control socket. The
+// connection is opened on first use and again after any error, so the
+// watcher survives agent restarts and handoffs. Not safe for concurrent
+// use; the reconciler is its only caller.
+type agentSLOMap struct {
+	path    string
+	timeout time.Duration
+	conn    net.Conn
+	r       *bufio.Reader
+	seq     uint32
+}
+
+func newAgentSLOMap(path string, timeout time.Duration) *agentSLOMap {
+	return &agentSLOMap{path: path, timeout: timeout}
+}
+
+func (a *agentSLOMap) connect() error {
+	if a.conn != nil {
+		return nil
+	}
+	conn, err := net.DialTimeout("unix", a.path, a.timeout)
+	if err != nil {
+		return err
+	}
+	a.conn, a.r = conn, bufio.NewReaderSize(conn, 64<<10)
+	return nil
+}
+
+func (a *agentSLOMap) reset() {
+	if a.conn != nil {
+		a.conn.Close()
+		a.conn, a.r = nil, nil
+	}
+}
+
+// send writes one request and returns its sequence number.
+func (a *agentSLOMap) send(w io.Writer, typ uint16, records interface{}, count, size int) (uint32, error) {
+	a.seq++
+	hdr := ctlHdr{
+		Len:     uint32(ctlHdrSize + count*size),
+		Type:    typ,
+		Version: ctlVersion,
+		Seq:     a.seq,
+		Count:   uint32(count),
+	}
+	if err := binary.Write(w, hostOrder, &hdr); err != nil {
+		return 0, err
+	}
+	if count > 0 {
+		if err := binary.Write(w, hostOrder, records); err != nil {
+			return 0, err
+		}
+	}
+	return a.seq, nil
+}
+
+// recv reads the reply to seq, decoding its records into out if not nil.
+func (a *agentSLOMap) recv(op string, seq uint32, out interface{}) error {
+	for {
+		var hdr ctlHdr
+		if err := binary.Read(a.r, hostOrder, &hdr); err != nil {
+			return err
+		}
+		if hdr.Len < ctlHdrSize {
+			return fmt.Errorf("agent %s: bad reply length %d", op, hdr.Len)
+		}
+		body := int64(hdr.Len - ctlHdrSize)
+		if hdr.Type&ctlReply == 0 || hdr.Seq != seq {
+			if _, err := io.CopyN(io.Discard, a.r, body); err != nil {
+				return err
+			}
+			continue
+		}
+		if hdr.Status != 0 {
+			if _, err := io.CopyN(io.Discard, a.r, body); err != nil {
+				return err
+			}
+			return &ctlError{op: op, err: syscall.Errno(-hdr.Status)}
+		}
+		if out != nil && body > 0 {
+			return binary.Read(io.LimitReader(a.r, body), hostOrder, out)
+		}
+		_, err := io.CopyN(io.Discard, a.r, body)
+		return err
+	}
+}
+
+// roundTrip runs fn on a live connection, dropping it on any error but a
+// refusal by the agent, after which the stream is still in sync.
+func (a *agentSLOMap) roundTrip(fn func() error) error {
+	if err := a.connect(); err != nil {
+		return err
+	}
+	a.conn.SetDeadline(time.Now().Add(a.timeout))
+	err := fn()
+	if _, refused := err.(*ctlError); err != nil && !refused {
+		a.reset()
+	}
+	return err
+}
+
+func (a *agentSLOMap) Lookup(keys []uint64) (map[uint64]sloCfg, error) {
+	out := make(map[uint64]sloCfg, len(keys))
+	err := a.roundTrip(func() error {
+		for len(keys) > 0 {
+			n := len(keys)
+			if n > ctlMaxRecords {
+				n = ctlMaxRecords
+			}
+			w := bufio.NewWriter(a.conn)
+			seq, err := a.send(w, ctlQuery, keys[:n], n, 8)
+			if err == nil {
+				err = w.Flush()
+			}
+			if err != nil {
+				return err
+			}
+			states := make([]ctlState, n)
+			if err := a.recv("query", seq, states); err != nil {
+				return err
+			}
+			for _, st := range states {
+				if st.Present != 0 {
+					out[st.CgroupID] = st.Cfg
+				}
+			}
+			keys = keys[n:]
+		}
+		return nil
+	})
+	if err != nil {
+		return nil, err
+	}
+	return out, nil
+}
+
+// Apply sends update and remove as pipelined APPLY requests; the agent
+// writes what arrives together as one batch and bumps the generation.
+func (a *agentSLOMap) Apply(update map[uint64]sloCfg, remove []uint64) error {
+	entries := make([]ctlEntry, 0, len(update)+len(remove))
+	for id, cfg := range update {
+		entries = append(entries, ctlEntry{CgroupID: id, Cfg: cfg, Op: ctlOpSet})
+	}
+	for _, id := range remove {
+		entries = append(entries, ctlEntry{CgroupID: id, Op: ctlOpDelete})
+	}
+
+	return a.roundTrip(func() error {
+		w := bufio.NewWriterSize(a.conn, 64<<10)
+		var seqs []uint32
+		for off := 0; off < len(entries); off += ctlMaxRecords {
+			chunk := entries[off:]
+			if len(chunk) > ctlMaxRecords {
+				chunk = chunk[:ctlMaxRecords]
+			}
+			seq, err := a.send(w, ctlApply, chunk, len(chunk), ctlEntrySize)
+			if err != nil {
+				return err
+			}
+			seqs = append(seqs, seq)
+		}
+		if err := w.Flush(); err != nil {
+			return err
+		}
+		var first error
+		var shadowed uint32
+		for _, seq := range seqs {
+			var res ctlApplied
+			err := a.recv("apply", seq, &res)
+			if _, refused := err.(*ctlError); err != nil && !refused {
+				return err
+			}
+			if first == nil {
+				first = err
+			}
+			shadowed += res.Shadowed
+		}
+		if shadowed > 0 {
+			log.Printf("Agent left %d SLO entries alone: their cgroups have rules in its config file",
+				shadowed)
+		}
+		return first
+	})
+}
@@ -0,0 +1,177 @@
+package main
+
+import (
+	"encoding/binary"
+	"errors"
+	"io"
+	"net"
+	"path/filepath"
+	"syscall"
+	"testing"
+	"time"
+)
+
+// fakeAgent serves APPLY and QUERY like the agent's control socket, over
+// an in-memory map, and refuses importance 0 like the agent's validation.
+type fakeAgent struct {
+	ln       net.Listener
+	entries  map[uint64]sloCfg
+	requests int
+}
+
+func startFakeAgent(t *testing.T) (*fakeAgent, string) {
+	t.Helper()
+	path := filepath.Join(t.TempDir(), "ctl.sock")
+	ln, err := net.Listen("unix", path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	a := &fakeAgent{ln: ln, entries: make(map[uint64]sloCfg)}
+	t.Cleanup(func() { ln.Close() })
+	go a.serve()
+	return a, path
+}
+
+func (a *fakeAgent) serve() {
+	for {
+		conn, err := a.ln.Accept()
+		if err != nil {
+			return
+		}
+		a.handle(conn)
+	}
+}
+
+func (a *fakeAgent) reply(w io.Writer, req ctlHdr, status int32, records interface{}, count, size int) {
+	hdr := ctlHdr{Len: uint32(ctlHdrSize + count*size), Type: ctlReply | req.Type,
+		Version: ctlVersion, Seq: req.Seq, Count: uint32(count), Status: status}
+	binary.Write(w, hostOrder, &hdr)
+	if count > 0 {
+		binary.Write(w, hostOrder, records)
+	}
+}
+
+func (a *fakeAgent) handle(conn net.Conn) {
+	defer conn.Close()
+	for {
+		var hdr ctlHdr
+		if err := binary.Read(conn, hostOrder, &hdr); err != nil {
+			return
+		}
+		a.requests++
+		switch hdr.Type {
+		case ctlApply:
+			entries := make([]ctlEntry, hdr.Count)
+			if err := binary.Read(conn, hostOrder, entries); err != nil {
+				return
+			}
+			status := int32(0)
+			for _, e := range entries {
+				if e.Op == ctlOpSet && e.Cfg.Importance == 0 {
+					status = -int32(syscall.EINVAL)
+				}
+			}
+			for _, e := range entries {
+				if status != 0 {
+					break
+				}
+				if e.Op == ctlOpSet {
+					a.entries[e.CgroupID] = e.Cfg
+				} else {
+					delete(a.entries, e.CgroupID)
+				}
+			}
+			a.reply(conn, hdr, status, &ctlApplied{}, 1, ctlAppliedSize)
+		case ctlQuery:
+			ids := make([]uint64, hdr.Count)
+			if err := binary.Read(conn, hostOrder, ids); err != nil {
+				return
+			}
+			states := make([]ctlState, len(ids))
+			for i, id := range ids {
+				states[i].CgroupID = id
+				if cfg, ok := a.entries[id]; ok {
+					states[i].Cfg, states[i].Present = cfg, 1
+				}
+			}
+			a.reply(conn, hdr, 0, states, len(states), ctlStateSize)
+		default:
+			return
+		}
+	}
+}
+
+func TestCtlRecordSizes(t *testing.T) {
+	// Must match struct slo_ctl_hdr, slo_ctl_entry, slo_ctl_applied and slo_ctl_state
+	for _, c := range []struct {
+		v    interface{}
+		want int
+	}{{ctlHdr{}, ctlHdrSize}, {ctlEntry{}, ctlEntrySize}, {ctlApplied{}, ctlAppliedSize},
+		{ctlState{}, ctlStateSize}} {
+		if got := binary.Size(c.v); got != c.want {
+			t.Errorf("%T is %d bytes, want %d", c.v, got, c.want)
+		}
+	}
+}
+
+func TestAgentSLOMapApplyAndLookup(t *testing.T) {
+	agent, path := startFakeAgent(t)
+	m := newAgentSLOMap(path, time.Second)
+
+	// More entries than fit one message
+	update := make(map[uint64]sloCfg)
+	for i := uint64(1); i <= ctlMaxRecords+10; i++ {
+		update[i] = sloCfg{BudgetNs: i * 1000000, Importance: 50}
+	}
+	if err := m.Apply(update, nil); err != nil {
+		t.Fatal(err)
+	}
+	if err := m.Apply(nil, []uint64{2, 3}); err != nil {
+		t.Fatal(err)
+	}
+
+	keys := []uint64{1, 2, 3, ctlMaxRecords + 10, 99999}
+	got, err := m.Lookup(keys)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(got) != 2 || got[1].BudgetNs != 1000000 || got[ctlMaxRecords+10].Importance != 50 {
+		t.Fatalf("lookup = %v", got)
+	}
+	if agent.requests != 4 {
+		t.Fatalf("%d requests, want 4", agent.requests)
+	}
+}
+
+func TestAgentSLOMapErrors(t *testing.T) {
+	_, path := startFakeAgent(t)
+	m := newAgentSLOMap(path, time.Second)
+
+	// A refused batch is reported and the connection stays usable
+	err := m.Apply(map[uint64]sloCfg{5: {BudgetNs: 1000000}}, nil)
+	if !errors.Is(err, syscall.EINVAL) {
+		t.Fatalf("apply of an invalid entry: %v", err)
+	}
+	conn := m.conn
+	if err := m.Apply(map[uint64]sloCfg{5: {BudgetNs: 1000000, Importance: 1}}, nil); err != nil {
+		t.Fatal(err)
+	}
+	if m.conn != conn {
+		t.Fatal("connection replaced after a refusal")
+	}
+
+	// A lost connection is redialed on the next call
+	m.conn.Close()
+	if _, err := m.Lookup([]uint64{5}); err == nil {
+		t.Fatal("lookup on a closed connection succeeded")
+	}
+	got, err := m.Lookup([]uint64{5})
+	if err != nil || len(got) != 1 {
+		t.Fatalf("lookup after reconnect = %v, %v", got, err)
+	}
+
+	// No agent at all
+	if _, err := newAgentSLOMap(filepath.Join(t.TempDir(), "none"), time.Second).Lookup([]uint64{1}); err == nil {
+		t.Fatal("lookup without an agent succeeded")
+	}
+}
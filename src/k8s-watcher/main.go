@@ -2,25 +2,45 @@ package main
 
 import (
 	"context"
+	"flag"
 	"fmt"
 	"log"
 	"os"
-	"strconv"
+	"os/signal"
+	"syscall"
 	"time"
 
-	"github.com/cilium/ebpf"
 	corev1 "k8s.io/api/core/v1"
 	metav1 "k8s.io/apimachinery/pkg/apis/meta/v1"
+	"k8s.io/apimachinery/pkg/labels"
+	"k8s.io/client-go/informers"
+	coreinformers "k8s.io/client-go/informers/core/v1"
 	"k8s.io/client-go/kubernetes"
 	"k8s.io/client-go/rest"
+	"k8s.io/client-go/tools/cache"
 )
 
 const (
 	AnnotationBudget     = "scx-slo/budget-ms"
 	AnnotationImportance = "scx-slo/importance"
-	PinnedMapPath        = "/sys/fs/bpf/slo_map"
+	AnnotationClass      = "scx-slo/class"
+	AgentSocketPath      = "/run/scx-slo/ctl.sock" // SLO_CTL_SOCK_PATH
+	CgroupRoot           = "/sys/fs/cgroup"
+
+	// Bounds the agent enforces (include/scx_slo.h)
+	MinBudgetMs   = 1
+	MaxBudgetMs   = 10000
+	MaxImportance = 100
 )
 
+// Latency classes, stored in sloCfg.Flags (SLO_CLASS_* in include/scx_slo.h)
+var sloClasses = map[string]uint32{
+	"standard":         0,
+	"latency-critical": 1,
+	"batch":            2,
+	"best-effort":      3,
+}
+
 // Simplified slo_cfg struct to match BPF side
 type sloCfg struct {
 	BudgetNs   uint64
@@ -28,7 +48,45 @@ type sloCfg struct {
 	Flags      uint32
 }
 
+// newPodInformer returns an informer factory and pod informer limited to
+// the pods scheduled on nodeName.
+func newPodInformer(client kubernetes.Interface, nodeName string, resync time.Duration) (informers.SharedInformerFactory, coreinformers.PodInformer) {
+	factory := informers.NewSharedInformerFactoryWithOptions(client, resync,
+		informers.WithTweakListOptions(func(opts *metav1.ListOptions) {
+			opts.FieldSelector = fmt.Sprintf("spec.nodeName=%s", nodeName)
+		}))
+	return factory, factory.Core().V1().Pods()
+}
+
+// watchPods marks r dirty on every pod event that can change its SLO entries.
+func watchPods(pods coreinformers.PodInformer, r *reconciler) error {
+	_, err := pods.Informer().AddEventHandler(cache.ResourceEventHandlerFuncs{
+		AddFunc: func(obj interface{}) { r.markDirty() },
+		UpdateFunc: func(oldObj, newObj interface{}) {
+			oldPod, ok1 := oldObj.(*corev1.Pod)
+			newPod, ok2 := newObj.(*corev1.Pod)
+			if !ok1 || !ok2 || podChanged(oldPod, newPod) {
+				r.markDirty()
+			}
+		},
+		DeleteFunc: func(obj interface{}) { r.markDirty() },
+	})
+	return err
+}
+
 func main() {
+	batchInterval := flag.Duration("batch-interval", time.Second,
+		"Longest time pod events are coalesced before the SLO map is reconciled")
+	resync := flag.Duration("resync", 5*time.Minute,
+		"Interval of full reconciles that repair drift in the SLO map")
+	cgroupRoot := flag.String("cgroup-root", CgroupRoot,
+		"Mount point of the cgroup2 hierarchy holding the kubepods cgroups")
+	agentSocket := flag.String("agent-socket", AgentSocketPath,
+		"Control socket of the scx-slo agent, which applies the SLO map writes")
+	agentTimeout := flag.Duration("agent-timeout", 10*time.Second,
+		"Longest wait for the agent to answer one request")
+	flag.Parse()
+
 	nodeName := os.Getenv("NODE_NAME")
 	if nodeName == "" {
 		log.Fatal("NODE_NAME environment variable not set")
@@ -44,109 +102,33 @@ func main() {
 		log.Fatalf("Failed to create clientset: %v", err)
 	}
 
-	// 2. Open the pinned BPF map
-	// Note: We use the cilium/ebpf library for easy map interaction
-	m, err := ebpf.LoadPinnedMap(PinnedMapPath, nil)
-	if err != nil {
-		log.Fatalf("Failed to load pinned map at %s: %v", PinnedMapPath, err)
-	}
-	defer m.Close()
+	// 2. The agent owns the SLO map; it is reached on first use, so the
+	// watcher may start before it and outlives its restarts
+	slo := newAgentSLOMap(*agentSocket, *agentTimeout)
 
-	log.Printf("Starting K8s watcher for node %s", nodeName)
+	ctx, stop := signal.NotifyContext(context.Background(), syscall.SIGINT, syscall.SIGTERM)
+	defer stop()
 
-	// 3. Watch pods on this node
-	watch, err := clientset.CoreV1().Pods("").Watch(context.TODO(), metav1.ListOptions{
-		FieldSelector: fmt.Sprintf("spec.nodeName=%s", nodeName),
-	})
-	if err != nil {
-		log.Fatalf("Failed to watch pods: %v", err)
-	}
+	log.Printf("Starting K8s watcher for node %s", nodeName)
 
-	for event := range watch.ResultChan() {
-		pod, ok := event.Object.(*corev1.Pod)
-		if !ok {
-			continue
-		}
-
-		budgetStr, hasBudget := pod.Annotations[AnnotationBudget]
-		importStr, hasImportance := pod.Annotations[AnnotationImportance]
-
-		if !hasBudget && !hasImportance {
-			continue
-		}
-
-		// Parse SLO values
-		budgetMs, _ := strconv.ParseUint(budgetStr, 10, 64)
-		importance, _ := strconv.ParseUint(importStr, 10, 32)
-
-		if budgetMs == 0 {
-			budgetMs = 100 // Default 100ms
-		}
-		if importance == 0 {
-			importance = 50 // Default 50
-		}
-
-		// Find Cgroup ID (Simplified: we use internal K8s logic or path resolution)
-		// This is a placeholder for the actual Cgroup resolution logic
-		// which usually involves reading /proc/<pid>/cgroup for one of the pod's containers
-		cgID, err := resolvePodCgroupID(pod)
-		if err != nil {
-			log.Printf("Could not resolve Cgroup ID for pod %s: %v", pod.Name, err)
-			continue
-		}
-
-		// Update BPF Map
-		cfg := sloCfg{
-			BudgetNs:   budgetMs * 1000000,
-			Importance: uint32(importance),
-			Flags:      0,
-		}
-
-		if err := m.Update(cgID, cfg, ebpf.UpdateAny); err != nil {
-			log.Printf("Failed to update BPF map for pod %s (cgID %d): %v", pod.Name, cgID, err)
-		} else {
-			log.Printf("Updated SLO for pod %s: budget=%dms, importance=%d", pod.Name, budgetMs, importance)
-		}
+	// 3. Keep a local cache of the pods on this node. The informer lists
+	// first, then watches, and re-lists whenever the watch is lost.
+	factory, pods := newPodInformer(clientset, nodeName, *resync)
+	listPods := func() ([]*corev1.Pod, error) {
+		return pods.Lister().List(labels.Everything())
 	}
-}
-
-// resolvePodCgroupID finds the 64-bit kernel cgroup ID for a given pod.
-// It constructs the cgroup path based on Pod UID and QOS class, then
-// uses name_to_handle_at to get the inode-based ID.
-func resolvePodCgroupID(pod *corev1.Pod) (uint64, error) {
-	uid := strings.ReplaceAll(string(pod.UID), "-", "_")
-	qos := strings.ToLower(string(pod.Status.QOSClass))
-	
-	// Construct the path (Standard for cgroupv2/systemd)
-	// Example: /sys/fs/cgroup/kubepods.slice/kubepods-burstable.slice/kubepods-burstable-pod<UID>.slice
-	basePath := "/sys/fs/cgroup/kubepods.slice"
-	qosPath := fmt.Sprintf("kubepods-%s.slice", qos)
-	podPath := fmt.Sprintf("kubepods-%s-pod%s.slice", qos, uid)
-	
-	fullPath := filepath.Join(basePath, qosPath, podPath)
-	
-	// Check if path exists
-	if _, err := os.Stat(fullPath); os.IsNotExist(err) {
-		// Fallback for older K8s/different runtimes
-		fullPath = filepath.Join(basePath, podPath)
+	cgroups := newCgroupResolver(*cgroupRoot)
+	r := newReconciler(listPods, cgroups.Resolve, cgroups.Retain, slo)
+	if err := watchPods(pods, r); err != nil {
+		log.Fatalf("Failed to watch pods: %v", err)
 	}
 
-	// Use name_to_handle_at to get the file handle (contains cgroup ID)
-	var mountID int32
-	handle := make([]byte, 128)
-	fh := (*unix.FileHandle)(unsafe.Pointer(&handle[0]))
-	fh.Size = 128 - 8 // Reserve space for the header
-
-	err := unix.NameToHandleAt(unix.AT_FDCWD, fullPath, fh, &mountID, 0)
-	if err != nil {
-		return 0, fmt.Errorf("failed to get handle for %s: %v", fullPath, err)
+	factory.Start(ctx.Done())
+	if !cache.WaitForCacheSync(ctx.Done(), pods.Informer().HasSynced) {
+		log.Fatalf("Failed to sync pod cache")
 	}
 
-	// The first 8 bytes of the handle's data for cgroupv2 is the 64-bit ID
-	if fh.Size < 8 {
-		return 0, fmt.Errorf("handle too small for ID: %d", fh.Size)
-	}
-	
-	cgID := *(*uint64)(unsafe.Pointer(&handle[8]))
-	return cgID, nil
+	// 4. Converge the SLO map on the cache until told to stop
+	r.run(ctx, *batchInterval, *resync)
+	factory.Shutdown()
 }
@@ -0,0 +1,247 @@
+package main
+
+import (
+	"context"
+	"log"
+	"sort"
+	"strconv"
+	"time"
+
+	corev1 "k8s.io/api/core/v1"
+	"k8s.io/apimachinery/pkg/types"
+)
+
+// sloMap is the part of the scheduler's SLO map the reconciler reads and
+// writes. The agent implementation goes through its control socket; tests
+// use an in-memory one.
+type sloMap interface {
+	// Lookup returns the entries present for keys.
+	Lookup(keys []uint64) (map[uint64]sloCfg, error)
+	// Apply writes update and deletes remove, in as few syscalls as possible.
+	Apply(update map[uint64]sloCfg, remove []uint64) error
+}
+
+// podSLO returns the SLO requested by a pod's scx-slo annotations, and
+// false if it has none.
+func podSLO(pod *corev1.Pod) (sloCfg, bool) {
+	budgetStr, hasBudget := pod.Annotations[AnnotationBudget]
+	importStr, hasImportance := pod.Annotations[AnnotationImportance]
+	className, hasClass := pod.Annotations[AnnotationClass]
+
+	if !hasBudget && !hasImportance && !hasClass {
+		return sloCfg{}, false
+	}
+
+	budgetMs, _ := strconv.ParseUint(budgetStr, 10, 64)
+	importance, _ := strconv.ParseUint(importStr, 10, 32)
+
+	if budgetMs == 0 {
+		budgetMs = 100 // Default 100ms
+	}
+	if importance == 0 {
+		importance = 50 // Default 50
+	}
+	// The agent refuses a whole batch over one out-of-range entry
+	if budgetMs < MinBudgetMs || budgetMs > MaxBudgetMs || importance > MaxImportance {
+		log.Printf("Out-of-range SLO on pod %s, clamping to %d-%dms, importance 1-%d",
+			pod.Name, MinBudgetMs, MaxBudgetMs, MaxImportance)
+		budgetMs = min(max(budgetMs, MinBudgetMs), MaxBudgetMs)
+		importance = min(importance, MaxImportance)
+	}
+	class, ok := sloClasses[className]
+	if hasClass && !ok {
+		log.Printf("Unknown %s %q on pod %s, using standard", AnnotationClass, className, pod.Name)
+	}
+
+	return sloCfg{
+		BudgetNs:   budgetMs * 1000000,
+		Importance: uint32(importance),
+		Flags:      class,
+	}, true
+}
+
+// reconcileResult summarizes one reconcile pass.
+type reconcileResult struct {
+	Desired    int // Entries the annotated pods ask for
+	Updated    int // Entries written because they were missing or differed
+	Deleted    int // Entries removed because their pod went away
+	Unresolved int // Annotated pods whose cgroup could not be found yet
+}
+
+// podCgroups are the cgroup IDs resolved for a pod while its set of
+// running containers is key.
+type podCgroups struct {
+	key string
+	ids []uint64
+}
+
+// reconciler converges the SLO map on the annotations of the pods in the
+// informer cache. Pod events only mark it dirty; the map is diffed and
+// written at most once per batch interval, so a rollout of hundreds of
+// pods costs a handful of batched map operations.
+type reconciler struct {
+	listPods func() ([]*corev1.Pod, error)
+	resolve  func(*corev1.Pod) ([]uint64, error)
+	retain   func(live map[types.UID]bool) // Drops resolver state of gone pods, may be nil
+	slo      sloMap
+
+	owned map[uint64]sloCfg        // Entries this watcher wrote
+	ids   map[types.UID]podCgroups // Resolved cgroup IDs of live pods
+	dirty chan struct{}
+}
+
+func newReconciler(listPods func() ([]*corev1.Pod, error), resolve func(*corev1.Pod) ([]uint64, error),
+	retain func(map[types.UID]bool), slo sloMap) *reconciler {
+	return &reconciler{
+		listPods: listPods,
+		resolve:  resolve,
+		retain:   retain,
+		slo:      slo,
+		owned:    make(map[uint64]sloCfg),
+		ids:      make(map[types.UID]podCgroups),
+		dirty:    make(chan struct{}, 1),
+	}
+}
+
+// markDirty requests a reconcile at the end of the current batch interval.
+func (r *reconciler) markDirty() {
+	select {
+	case r.dirty <- struct{}{}:
+	default:
+	}
+}
+
+// podChanged reports whether an update can change the desired SLO entries.
+func podChanged(oldPod, newPod *corev1.Pod) bool {
+	oldCfg, oldOK := podSLO(oldPod)
+	newCfg, newOK := podSLO(newPod)
+	if oldOK != newOK || oldCfg != newCfg || oldPod.UID != newPod.UID ||
+		oldPod.Status.Phase != newPod.Status.Phase ||
+		oldPod.Status.QOSClass != newPod.Status.QOSClass {
+		return true
+	}
+	// Restarted containers have new cgroups
+	return newOK && podCgroupsKey(oldPod) != podCgroupsKey(newPod)
+}
+
+// reconcile computes the desired entries from the cached pods, compares
+// them with the map and applies the difference in one batch. Only entries
+// this watcher wrote are ever deleted; the agent's config rules and other
+// writers' entries are left alone.
+func (r *reconciler) reconcile() (reconcileResult, error) {
+	var res reconcileResult
+
+	pods, err := r.listPods()
+	if err != nil {
+		return res, err
+	}
+
+	desired := make(map[uint64]sloCfg)
+	live := make(map[types.UID]bool)
+	for _, pod := range pods {
+		cfg, ok := podSLO(pod)
+		if !ok || pod.Status.Phase == corev1.PodSucceeded || pod.Status.Phase == corev1.PodFailed {
+			continue
+		}
+		live[pod.UID] = true
+		key := podCgroupsKey(pod)
+		cg, ok := r.ids[pod.UID]
+		if !ok || cg.key != key {
+			// New pod or restarted containers: resolve again, and write
+			// whatever was found even if some containers are still missing
+			ids, err := r.resolve(pod)
+			cg = podCgroups{key: key, ids: ids}
+			if err != nil {
+				res.Unresolved++
+				delete(r.ids, pod.UID)
+			} else {
+				r.ids[pod.UID] = cg
+			}
+		}
+		for _, id := range cg.ids {
+			desired[id] = cfg
+		}
+	}
+	for uid := range r.ids {
+		if !live[uid] {
+			delete(r.ids, uid)
+		}
+	}
+	if r.retain != nil {
+		r.retain(live)
+	}
+	res.Desired = len(desired)
+
+	keys := make([]uint64, 0, len(desired))
+	for id := range desired {
+		keys = append(keys, id)
+	}
+	current, err := r.slo.Lookup(keys)
+	if err != nil {
+		return res, err
+	}
+
+	update := make(map[uint64]sloCfg)
+	for id, cfg := range desired {
+		if cur, ok := current[id]; !ok || cur != cfg {
+			update[id] = cfg
+		}
+	}
+	var remove []uint64
+	for id := range r.owned {
+		if _, ok := desired[id]; !ok {
+			remove = append(remove, id)
+		}
+	}
+	sort.Slice(remove, func(i, j int) bool { return remove[i] < remove[j] })
+
+	if len(update) == 0 && len(remove) == 0 {
+		r.owned = desired
+		return res, nil
+	}
+	if err := r.slo.Apply(update, remove); err != nil {
+		// Some writes may have landed; keep them owned so they are cleaned up
+		for id, cfg := range update {
+			r.owned[id] = cfg
+		}
+		return res, err
+	}
+	r.owned = desired
+	res.Updated = len(update)
+	res.Deleted = len(remove)
+	return res, nil
+}
+
+// run reconciles after pod events, at most once per batchInterval, and
+// every resync interval regardless to repair drift in the map. Pods whose
+// cgroup did not exist yet are retried every batch interval.
+func (r *reconciler) run(ctx context.Context, batchInterval, resync time.Duration) {
+	batch := time.NewTicker(batchInterval)
+	defer batch.Stop()
+	full := time.NewTicker(resync)
+	defer full.Stop()
+
+	pending := true
+	for {
+		select {
+		case <-ctx.Done():
+			return
+		case <-r.dirty:
+			pending = true
+		case <-full.C:
+			pending = true
+		case <-batch.C:
+			if !pending {
+				continue
+			}
+			res, err := r.reconcile()
+			pending = err != nil || res.Unresolved > 0
+			if err != nil {
+				log.Printf("Reconcile failed: %v", err)
+			} else if res.Updated > 0 || res.Deleted > 0 {
+				log.Printf("Reconciled %d pod SLOs: %d written, %d deleted, %d unresolved",
+					res.Desired, res.Updated, res.Deleted, res.Unresolved)
+			}
+		}
+	}
+}
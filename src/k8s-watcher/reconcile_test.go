@@ -0,0 +1,411 @@
+package main
+
+import (
+	"context"
+	"fmt"
+	"testing"
+	"time"
+
+	corev1 "k8s.io/api/core/v1"
+	metav1 "k8s.io/apimachinery/pkg/apis/meta/v1"
+	"k8s.io/apimachinery/pkg/labels"
+	"k8s.io/apimachinery/pkg/types"
+	"k8s.io/client-go/kubernetes/fake"
+	"k8s.io/client-go/tools/cache"
+)
+
+// memSLOMap is an in-memory sloMap that counts the batches applied to it.
+type memSLOMap struct {
+	entries map[uint64]sloCfg
+	applies int
+	lookups int
+}
+
+func newMemSLOMap() *memSLOMap {
+	return &memSLOMap{entries: make(map[uint64]sloCfg)}
+}
+
+func (m *memSLOMap) Lookup(keys []uint64) (map[uint64]sloCfg, error) {
+	m.lookups++
+	out := make(map[uint64]sloCfg)
+	for _, k := range keys {
+		if v, ok := m.entries[k]; ok {
+			out[k] = v
+		}
+	}
+	return out, nil
+}
+
+func (m *memSLOMap) Apply(update map[uint64]sloCfg, remove []uint64) error {
+	m.applies++
+	for k, v := range update {
+		m.entries[k] = v
+	}
+	for _, k := range remove {
+		delete(m.entries, k)
+	}
+	return nil
+}
+
+func testPod(i int, annotations map[string]string) *corev1.Pod {
+	return &corev1.Pod{
+		ObjectMeta: metav1.ObjectMeta{
+			Name:        fmt.Sprintf("pod-%d", i),
+			Namespace:   "default",
+			UID:         types.UID(fmt.Sprintf("uid-%d", i)),
+			Annotations: annotations,
+		},
+		Spec:   corev1.PodSpec{NodeName: "node-a"},
+		Status: corev1.PodStatus{Phase: corev1.PodRunning},
+	}
+}
+
+// testCgroupID stands in for the cgroup ID of the pod with the given UID.
+func testCgroupID(pod *corev1.Pod) ([]uint64, error) {
+	var i uint64
+	if _, err := fmt.Sscanf(string(pod.UID), "uid-%d", &i); err != nil {
+		return nil, err
+	}
+	return []uint64{1000 + i}, nil
+}
+
+// startCache runs a pod informer against client and returns its lister.
+func startCache(t *testing.T, client *fake.Clientset, r **reconciler) func() ([]*corev1.Pod, error) {
+	t.Helper()
+	ctx, cancel := context.WithCancel(context.Background())
+	t.Cleanup(cancel)
+
+	factory, pods := newPodInformer(client, "node-a", time.Minute)
+	listPods := func() ([]*corev1.Pod, error) {
+		return pods.Lister().List(labels.Everything())
+	}
+	if r != nil {
+		*r = newReconciler(listPods, testCgroupID, nil, newMemSLOMap())
+		if err := watchPods(pods, *r); err != nil {
+			t.Fatalf("watchPods: %v", err)
+		}
+	}
+	factory.Start(ctx.Done())
+	if !cache.WaitForCacheSync(ctx.Done(), pods.Informer().HasSynced) {
+		t.Fatal("pod cache did not sync")
+	}
+	return listPods
+}
+
+// waitForPods waits until the cache holds n pods.
+func waitForPods(t *testing.T, listPods func() ([]*corev1.Pod, error), n int) {
+	t.Helper()
+	deadline := time.Now().Add(5 * time.Second)
+	for time.Now().Before(deadline) {
+		if pods, _ := listPods(); len(pods) == n {
+			return
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+	t.Fatalf("cache never reached %d pods", n)
+}
+
+func TestPodSLO(t *testing.T) {
+	cases := []struct {
+		annotations map[string]string
+		want        sloCfg
+		ok          bool
+	}{
+		{nil, sloCfg{}, false},
+		{map[string]string{"other": "x"}, sloCfg{}, false},
+		{map[string]string{AnnotationBudget: "20", AnnotationImportance: "95"},
+			sloCfg{BudgetNs: 20000000, Importance: 95}, true},
+		{map[string]string{AnnotationClass: "batch"},
+			sloCfg{BudgetNs: 100000000, Importance: 50, Flags: 2}, true},
+		{map[string]string{AnnotationBudget: "5", AnnotationClass: "latency-critical"},
+			sloCfg{BudgetNs: 5000000, Importance: 50, Flags: 1}, true},
+		{map[string]string{AnnotationBudget: "junk", AnnotationClass: "turbo"},
+			sloCfg{BudgetNs: 100000000, Importance: 50}, true},
+		{map[string]string{AnnotationBudget: "60000", AnnotationImportance: "500"},
+			sloCfg{BudgetNs: 10000000000, Importance: 100}, true},
+	}
+	for i, c := range cases {
+		got, ok := podSLO(testPod(i, c.annotations))
+		if ok != c.ok || got != c.want {
+			t.Errorf("case %d: podSLO = %+v, %v; want %+v, %v", i, got, ok, c.want, c.ok)
+		}
+	}
+}
+
+func TestReconcileBatchesPodChurn(t *testing.T) {
+	client := fake.NewSimpleClientset()
+	for i := 0; i < 200; i++ {
+		ann := map[string]string{AnnotationBudget: fmt.Sprint(10 + i%50)}
+		if i%10 == 0 {
+			ann = nil // Not opted in
+		}
+		if _, err := client.CoreV1().Pods("default").Create(context.Background(),
+			testPod(i, ann), metav1.CreateOptions{}); err != nil {
+			t.Fatal(err)
+		}
+	}
+
+	var r *reconciler
+	listPods := startCache(t, client, &r)
+	waitForPods(t, listPods, 200)
+	m := r.slo.(*memSLOMap)
+
+	// The agent's own rules share the map and must survive
+	m.entries[42] = sloCfg{BudgetNs: 50000000, Importance: 90}
+
+	res, err := r.reconcile()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if res.Desired != 180 || res.Updated != 180 || res.Deleted != 0 {
+		t.Fatalf("first reconcile: %+v", res)
+	}
+	if m.applies != 1 || len(m.entries) != 181 {
+		t.Fatalf("200 pods took %d batches, map has %d entries", m.applies, len(m.entries))
+	}
+
+	// Nothing changed: no writes at all
+	if res, _ := r.reconcile(); res.Updated != 0 || res.Deleted != 0 || m.applies != 1 {
+		t.Fatalf("idle reconcile wrote: %+v, %d batches", res, m.applies)
+	}
+
+	// Delete 50 pods, 45 of them opted in: one more batch
+	for i := 1; i <= 50; i++ {
+		if err := client.CoreV1().Pods("default").Delete(context.Background(),
+			fmt.Sprintf("pod-%d", i), metav1.DeleteOptions{}); err != nil {
+			t.Fatal(err)
+		}
+	}
+	waitForPods(t, listPods, 150)
+	res, err = r.reconcile()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if res.Deleted != 45 || m.applies != 2 {
+		t.Fatalf("after deletes: %+v, %d batches", res, m.applies)
+	}
+	if _, ok := m.entries[1001]; ok {
+		t.Fatal("entry of deleted pod-1 still present")
+	}
+	if _, ok := m.entries[42]; !ok {
+		t.Fatal("foreign entry was deleted")
+	}
+
+	// Pod events only mark the reconciler dirty, however many there are
+	select {
+	case <-r.dirty:
+	default:
+		t.Fatal("pod events did not mark the reconciler dirty")
+	}
+}
+
+func TestReconcileRepairsDrift(t *testing.T) {
+	client := fake.NewSimpleClientset(
+		testPod(1, map[string]string{AnnotationBudget: "20", AnnotationClass: "latency-critical"}),
+		testPod(2, map[string]string{AnnotationBudget: "500", AnnotationClass: "batch"}),
+	)
+	listPods := startCache(t, client, nil)
+	m := newMemSLOMap()
+	r := newReconciler(listPods, testCgroupID, nil, m)
+
+	if _, err := r.reconcile(); err != nil {
+		t.Fatal(err)
+	}
+
+	// A config generation without our entry, and a stale overwrite
+	delete(m.entries, 1001)
+	m.entries[1002] = sloCfg{BudgetNs: 1, Importance: 1}
+
+	res, err := r.reconcile()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if res.Updated != 2 {
+		t.Fatalf("drift repair: %+v", res)
+	}
+	if m.entries[1001].Flags != 1 || m.entries[1002].BudgetNs != 500000000 {
+		t.Fatalf("map not repaired: %+v", m.entries)
+	}
+}
+
+func TestReconcileRetriesUnresolved(t *testing.T) {
+	client := fake.NewSimpleClientset(testPod(7, map[string]string{AnnotationImportance: "80"}))
+	listPods := startCache(t, client, nil)
+	m := newMemSLOMap()
+
+	// The pod's cgroup appears only after the first attempt
+	attempts := 0
+	resolve := func(pod *corev1.Pod) ([]uint64, error) {
+		attempts++
+		if attempts == 1 {
+			return nil, fmt.Errorf("no cgroup yet")
+		}
+		return testCgroupID(pod)
+	}
+	r := newReconciler(listPods, resolve, nil, m)
+
+	res, _ := r.reconcile()
+	if res.Unresolved != 1 || len(m.entries) != 0 {
+		t.Fatalf("first pass: %+v", res)
+	}
+	res, _ = r.reconcile()
+	if res.Unresolved != 0 || m.entries[1007].Importance != 80 {
+		t.Fatalf("retry: %+v", res)
+	}
+
+	// Resolved IDs are cached for the pod's lifetime
+	r.reconcile()
+	if attempts != 2 {
+		t.Fatalf("resolved %d times", attempts)
+	}
+}
+
+func TestRunCoalescesEvents(t *testing.T) {
+	client := fake.NewSimpleClientset()
+	var r *reconciler
+	listPods := startCache(t, client, &r)
+	m := r.slo.(*memSLOMap)
+
+	ctx, cancel := context.WithCancel(context.Background())
+	done := make(chan struct{})
+	go func() {
+		r.run(ctx, 200*time.Millisecond, time.Hour)
+		close(done)
+	}()
+
+	for i := 0; i < 100; i++ {
+		if _, err := client.CoreV1().Pods("default").Create(context.Background(),
+			testPod(i, map[string]string{AnnotationBudget: "30"}), metav1.CreateOptions{}); err != nil {
+			t.Fatal(err)
+		}
+	}
+	waitForPods(t, listPods, 100)
+	time.Sleep(500 * time.Millisecond)
+	cancel()
+	<-done
+
+	if len(m.entries) != 100 {
+		t.Fatalf("map has %d entries, want 100", len(m.entries))
+	}
+	// 100 creations land in a few batch intervals, not 100 writes
+	if m.applies > 4 {
+		t.Fatalf("100 pod events took %d batches", m.applies)
+	}
+}
+
+func withContainers(pod *corev1.Pod, ids ...string) *corev1.Pod {
+	pod.Status.ContainerStatuses = nil
+	for i, id := range ids {
+		pod.Status.ContainerStatuses = append(pod.Status.ContainerStatuses, corev1.ContainerStatus{
+			Name:        fmt.Sprintf("c%d", i),
+			ContainerID: "containerd://" + id,
+			State:       corev1.ContainerState{Running: &corev1.ContainerStateRunning{}},
+		})
+	}
+	return pod
+}
+
+func TestReconcileFansOutToContainers(t *testing.T) {
+	pod := withContainers(testPod(3, map[string]string{AnnotationBudget: "10"}), "aaa", "bbb")
+	client := fake.NewSimpleClientset(pod)
+	listPods := startCache(t, client, nil)
+	m := newMemSLOMap()
+
+	// One ID for the pod cgroup, one per container named after its ID
+	cgroupIDs := map[string]uint64{"containerd://aaa": 2001, "containerd://bbb": 2002, "containerd://ccc": 2003}
+	resolves := 0
+	resolve := func(pod *corev1.Pod) ([]uint64, error) {
+		resolves++
+		ids := []uint64{1003}
+		for _, cid := range runningContainerIDs(pod) {
+			ids = append(ids, cgroupIDs[cid])
+		}
+		return ids, nil
+	}
+	var retained map[types.UID]bool
+	retain := func(live map[types.UID]bool) { retained = live }
+	r := newReconciler(listPods, resolve, retain, m)
+
+	res, err := r.reconcile()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if res.Desired != 3 || len(m.entries) != 3 || m.entries[2002].BudgetNs != 10000000 {
+		t.Fatalf("fan-out: %+v, map %+v", res, m.entries)
+	}
+	if !retained["uid-3"] {
+		t.Fatal("resolver not told the pod is live")
+	}
+
+	// Container bbb restarts as ccc: re-resolve, write ccc, drop bbb
+	restarted := withContainers(pod.DeepCopy(), "aaa", "ccc")
+	if !podChanged(pod, restarted) {
+		t.Fatal("container restart not seen as a change")
+	}
+	if _, err := client.CoreV1().Pods("default").UpdateStatus(context.Background(),
+		restarted, metav1.UpdateOptions{}); err != nil {
+		t.Fatal(err)
+	}
+	deadline := time.Now().Add(5 * time.Second)
+	for {
+		pods, _ := listPods()
+		if len(pods) == 1 && podCgroupsKey(pods[0]) == "containerd://aaa,containerd://ccc" {
+			break
+		}
+		if time.Now().After(deadline) {
+			t.Fatal("cache never saw the restart")
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+	res, err = r.reconcile()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if res.Updated != 1 || res.Deleted != 1 || resolves != 2 {
+		t.Fatalf("restart: %+v after %d resolves", res, resolves)
+	}
+	if _, ok := m.entries[2002]; ok {
+		t.Fatal("cgroup of the restarted container still present")
+	}
+	if _, ok := m.entries[2003]; !ok {
+		t.Fatal("cgroup of the new container missing")
+	}
+
+	// Gone pods are dropped from the resolver
+	if err := client.CoreV1().Pods("default").Delete(context.Background(), pod.Name, metav1.DeleteOptions{}); err != nil {
+		t.Fatal(err)
+	}
+	waitForPods(t, listPods, 0)
+	if _, err := r.reconcile(); err != nil {
+		t.Fatal(err)
+	}
+	if len(retained) != 0 || len(m.entries) != 0 {
+		t.Fatalf("after delete: retained %v, map %+v", retained, m.entries)
+	}
+}
+
+func TestReconcileWritesPartialResolves(t *testing.T) {
+	client := fake.NewSimpleClientset(withContainers(testPod(4, map[string]string{AnnotationBudget: "10"}), "aaa"))
+	listPods := startCache(t, client, nil)
+	m := newMemSLOMap()
+
+	// The container cgroup shows up one pass after the pod cgroup
+	attempts := 0
+	resolve := func(pod *corev1.Pod) ([]uint64, error) {
+		attempts++
+		if attempts == 1 {
+			return []uint64{1004}, fmt.Errorf("no cgroup for container aaa")
+		}
+		return []uint64{1004, 2001}, nil
+	}
+	r := newReconciler(listPods, resolve, nil, m)
+
+	res, _ := r.reconcile()
+	if res.Unresolved != 1 || len(m.entries) != 1 {
+		t.Fatalf("first pass: %+v, map %+v", res, m.entries)
+	}
+	res, _ = r.reconcile()
+	if res.Unresolved != 0 || len(m.entries) != 2 {
+		t.Fatalf("retry: %+v, map %+v", res, m.entries)
+	}
+}
@@ -0,0 +1,409 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Asynchronous structured logging for scx-slo
+ *
+ * The ring is a bounded MPSC queue in the style of Vyukov's array queue:
+ * each slot carries a sequence number that tells producers whether it is
+ * free and tells the writer whether it has been published. Producers claim
+ * a slot with one CAS on the tail, format straight into it, then publish.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include "log.h"
+
+#define LOG_RING_MASK   (LOG_RING_SLOTS - 1)
+#define LOG_BATCH_MAX   64          /* iovecs per writev() */
+#define LOG_IDLE_SLEEP_NS (5 * 1000000L)
+
+struct log_slot {
+	_Atomic size_t seq;
+	size_t len;
+	char buf[LOG_LINE_MAX];
+};
+
+static struct log_slot ring[LOG_RING_SLOTS];
+static _Atomic size_t ring_tail;    /* Next slot for producers */
+static size_t ring_head;            /* Next slot for the writer (writer-only) */
+
+static _Atomic bool ring_active;
+static _Atomic bool writer_stop;
+static _Atomic __u64 dropped;
+static pthread_t writer_thread;
+static int log_fd = STDOUT_FILENO;
+
+static _Atomic int current_level = LOG_INFO;
+static _Atomic bool json_mode;
+
+static const char *log_level_names[] = {"debug", "info", "warn", "error"};
+
+/*
+ * Formatted "%Y-%m-%dT%H:%M:%S" for the current second. localtime_r() and
+ * strftime() only run when the second changes, per thread.
+ */
+static const char *cached_timestamp(void)
+{
+	static __thread time_t cached_sec = -1;
+	static __thread char cached[32];
+	struct timespec ts;
+	struct tm tm_info;
+
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	if (ts.tv_sec != cached_sec) {
+		localtime_r(&ts.tv_sec, &tm_info);
+		strftime(cached, sizeof(cached), "%Y-%m-%dT%H:%M:%S", &tm_info);
+		cached_sec = ts.tv_sec;
+	}
+	return cached;
+}
+
+/* Claim a free slot, or NULL if the ring is full */
+static struct log_slot *ring_claim(size_t *pos_out)
+{
+	size_t pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+
+	for (;;) {
+		struct log_slot *slot = &ring[pos & LOG_RING_MASK];
+		size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&ring_tail, &pos, pos + 1,
+								  memory_order_relaxed,
+								  memory_order_relaxed)) {
+				*pos_out = pos;
+				return slot;
+			}
+		} else if (diff < 0) {
+			return NULL;
+		} else {
+			pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+		}
+	}
+}
+
+static void ring_publish(struct log_slot *slot, size_t pos)
+{
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+/* Write all of buf, waiting out EAGAIN on non-blocking descriptors */
+static void write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+				poll(&pfd, 1, 100);
+				continue;
+			}
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+static void writev_all(int fd, struct iovec *iov, int cnt)
+{
+	while (cnt > 0) {
+		ssize_t n = writev(fd, iov, cnt);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+				poll(&pfd, 1, 100);
+				continue;
+			}
+			return;
+		}
+		/* Skip fully written iovecs, then trim the partial one */
+		while (cnt > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+		if (cnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+}
+
+/* Write out every published slot. Returns the number of lines written. */
+static int ring_drain(void)
+{
+	struct iovec iov[LOG_BATCH_MAX];
+	int total = 0;
+
+	for (;;) {
+		size_t start = ring_head;
+		int cnt = 0;
+
+		while (cnt < LOG_BATCH_MAX) {
+			struct log_slot *slot = &ring[(start + cnt) & LOG_RING_MASK];
+			size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+			if (seq != start + cnt + 1)
+				break;
+			iov[cnt].iov_base = slot->buf;
+			iov[cnt].iov_len = slot->len;
+			cnt++;
+		}
+		if (cnt == 0)
+			return total;
+
+		writev_all(log_fd, iov, cnt);
+
+		/* Hand the slots back to producers one lap ahead */
+		for (int i = 0; i < cnt; i++) {
+			struct log_slot *slot = &ring[(start + i) & LOG_RING_MASK];
+			atomic_store_explicit(&slot->seq, start + i + LOG_RING_SLOTS,
+					      memory_order_release);
+		}
+		ring_head = start + cnt;
+		total += cnt;
+	}
+}
+
+static void *log_writer(void *arg)
+{
+	__u64 reported = 0;
+	(void)arg;
+
+	for (;;) {
+		bool stop = atomic_load(&writer_stop);
+		int written = ring_drain();
+		__u64 lost = atomic_load_explicit(&dropped, memory_order_relaxed);
+
+		if (lost != reported) {
+			char note[128];
+			int n = snprintf(note, sizeof(note),
+					 "[%s] [warn] log ring full, dropped %llu messages\n",
+					 cached_timestamp(),
+					 (unsigned long long)(lost - reported));
+			write_all(log_fd, note, n);
+			reported = lost;
+		}
+
+		if (stop)
+			break;
+		if (written == 0) {
+			struct timespec ts = { .tv_nsec = LOG_IDLE_SLEEP_NS };
+			nanosleep(&ts, NULL);
+		}
+	}
+	return NULL;
+}
+
+int log_init(int out_fd)
+{
+	sigset_t all, old;
+	int err;
+
+	if (atomic_load(&ring_active))
+		return 0;
+
+	log_fd = out_fd;
+
+	for (size_t i = 0; i < LOG_RING_SLOTS; i++)
+		atomic_store_explicit(&ring[i].seq, i, memory_order_relaxed);
+	atomic_store(&ring_tail, 0);
+	ring_head = 0;
+	atomic_store(&writer_stop, false);
+
+	/* Keep signals on the main thread so poll() there sees EINTR */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	err = pthread_create(&writer_thread, NULL, log_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err)
+		return -err;
+
+	atomic_store(&ring_active, true);
+	return 0;
+}
+
+void log_shutdown(void)
+{
+	if (!atomic_exchange(&ring_active, false))
+		return;
+
+	atomic_store(&writer_stop, true);
+	pthread_join(writer_thread, NULL);
+	/* Producers that raced with shutdown published after the last drain */
+	ring_drain();
+}
+
+void log_set_level(enum log_level level)
+{
+	atomic_store(&current_level, level);
+}
+
+void log_set_json(bool json)
+{
+	atomic_store(&json_mode, json);
+}
+
+bool log_json_enabled(void)
+{
+	return atomic_load(&json_mode);
+}
+
+__u64 log_dropped(void)
+{
+	return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+/* JSON-escape @in into @out, always leaving room for the closing suffix */
+static size_t json_escape(char *out, size_t out_len, const char *in)
+{
+	static const char hex[] = "0123456789abcdef";
+	size_t j = 0;
+
+	for (size_t i = 0; in[i]; i++) {
+		unsigned char c = in[i];
+
+		if (c == '"' || c == '\\') {
+			if (j + 2 >= out_len)
+				break;
+			out[j++] = '\\';
+			out[j++] = c;
+		} else if (c < 0x20) {
+			if (j + 6 >= out_len)
+				break;
+			out[j++] = '\\';
+			out[j++] = 'u';
+			out[j++] = '0';
+			out[j++] = '0';
+			out[j++] = hex[c >> 4];
+			out[j++] = hex[c & 0xf];
+		} else {
+			if (j + 1 >= out_len)
+				break;
+			out[j++] = c;
+		}
+	}
+	out[j] = '\0';
+	return j;
+}
+
+/* Format one complete line into @buf. Returns its length including '\n'. */
+static size_t format_line(char *buf, size_t size, enum log_level level,
+			  const char *fmt, va_list args)
+{
+	const char *ts = cached_timestamp();
+	size_t len;
+	int n;
+
+	if (atomic_load_explicit(&json_mode, memory_order_relaxed)) {
+		static const char suffix[] = "\"}\n";
+		char msg[LOG_LINE_MAX];
+
+		vsnprintf(msg, sizeof(msg), fmt, args);
+		n = snprintf(buf, size, "{\"timestamp\":\"%s\",\"level\":\"%s\",\"message\":\"",
+			     ts, log_level_names[level]);
+		len = (size_t)n < size ? (size_t)n : size - 1;
+		len += json_escape(buf + len, size - len - (sizeof(suffix) - 1), msg);
+		memcpy(buf + len, suffix, sizeof(suffix));
+		return len + sizeof(suffix) - 1;
+	}
+
+	n = snprintf(buf, size, "[%s] [%s] ", ts, log_level_names[level]);
+	len = (size_t)n < size ? (size_t)n : size - 1;
+	n = vsnprintf(buf + len, size - len, fmt, args);
+	if (n > 0)
+		len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+	/* Always terminate the line, overwriting the last byte if truncated */
+	if (len >= size - 1)
+		len = size - 2;
+	buf[len++] = '\n';
+	buf[len] = '\0';
+	return len;
+}
+
+static void log_vemit(enum log_level level, bool raw, const char *fmt, va_list args)
+{
+	struct log_slot *slot;
+	size_t pos;
+
+	if (!atomic_load_explicit(&ring_active, memory_order_acquire)) {
+		char line[LOG_LINE_MAX];
+		size_t len;
+
+		if (raw) {
+			int n = vsnprintf(line, sizeof(line) - 1, fmt, args);
+			len = n < 0 ? 0 : ((size_t)n < sizeof(line) - 1 ? (size_t)n : sizeof(line) - 2);
+			line[len++] = '\n';
+		} else {
+			len = format_line(line, sizeof(line), level, fmt, args);
+		}
+		write_all(log_fd, line, len);
+		return;
+	}
+
+	slot = ring_claim(&pos);
+	if (!slot) {
+		atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	if (raw) {
+		int n = vsnprintf(slot->buf, sizeof(slot->buf) - 1, fmt, args);
+		size_t len = n < 0 ? 0 : ((size_t)n < sizeof(slot->buf) - 1 ?
+					  (size_t)n : sizeof(slot->buf) - 2);
+		slot->buf[len++] = '\n';
+		slot->len = len;
+	} else {
+		slot->len = format_line(slot->buf, sizeof(slot->buf), level, fmt, args);
+	}
+	ring_publish(slot, pos);
+}
+
+void log_msg(enum log_level level, const char *fmt, ...)
+{
+	va_list args;
+
+	if (level < atomic_load_explicit(&current_level, memory_order_relaxed))
+		return;
+
+	va_start(args, fmt);
+	log_vemit(level, false, fmt, args);
+	va_end(args);
+}
+
+void log_raw(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	log_vemit(LOG_INFO, true, fmt, args);
+	va_end(args);
+}
+
+enum log_level parse_log_level(const char *level)
+{
+	if (strcasecmp(level, "debug") == 0) return LOG_DEBUG;
+	if (strcasecmp(level, "info") == 0) return LOG_INFO;
+	if (strcasecmp(level, "warn") == 0 || strcasecmp(level, "warning") == 0) return LOG_WARN;
+	if (strcasecmp(level, "error") == 0) return LOG_ERROR;
+	return LOG_INFO;  /* Default */
+}
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Asynchronous structured logging for scx-slo
+ *
+ * Producers format into a lock-free multi-producer ring and return
+ * immediately; a dedicated writer thread drains it with batched writev().
+ * When the ring is full, messages are dropped and counted rather than
+ * blocking the caller, so a slow log pipe never stalls event consumption.
+ */
+#ifndef __SCX_SLO_LOG_H
+#define __SCX_SLO_LOG_H
+
+#include <stdbool.h>
+#include "scx_slo.h"
+
+/* Log levels */
+enum log_level {
+	LOG_DEBUG = 0,
+	LOG_INFO = 1,
+	LOG_WARN = 2,
+	LOG_ERROR = 3
+};
+
+#define LOG_LINE_MAX   512   /* Longer lines are truncated */
+#define LOG_RING_SLOTS 1024  /* Must be a power of two */
+
+/*
+ * Start the writer thread for @out_fd. Messages logged before this (or
+ * after log_shutdown()) are written synchronously.
+ */
+int log_init(int out_fd);
+
+/* Drain everything queued so far and stop the writer thread */
+void log_shutdown(void);
+
+void log_set_level(enum log_level level);
+void log_set_json(bool json);
+bool log_json_enabled(void);
+
+/* Timestamped, level-filtered message (JSON-escaped in JSON mode) */
+void log_msg(enum log_level level, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/* Pre-formatted line, written as-is (used for JSON stats records) */
+void log_raw(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/* Messages dropped because the ring was full */
+__u64 log_dropped(void);
+
+enum log_level parse_log_level(const char *level);
+
+#endif /* __SCX_SLO_LOG_H */
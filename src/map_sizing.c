@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * BPF map capacities for scx-slo
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "map_sizing.h"
+
+static __u64 clamp_u64(__u64 v, __u64 lo, __u64 hi)
+{
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+static __u64 roundup_pow2(__u64 v)
+{
+	__u64 p = 1;
+
+	while (p < v)
+		p <<= 1;
+	return p;
+}
+
+void map_sizes_for_node(struct map_sizes *s, __u32 pid_max, int nr_cpus)
+{
+	__u64 cpus = nr_cpus > 0 ? nr_cpus : 1;
+	__u64 tasks = cpus * TASKS_PER_CPU;
+
+	/* No more live tasks than PIDs; pid_max is tiny only on odd setups */
+	if (tasks < MIN_TASK_ENTRIES)
+		tasks = MIN_TASK_ENTRIES;
+	if (pid_max && tasks > pid_max)
+		tasks = pid_max;
+	s->tasks = clamp_u64(tasks, 1, MAX_TASK_ENTRIES_LIMIT);
+
+	s->cgroups = clamp_u64(cpus * CGROUPS_PER_CPU, MIN_CGROUP_ENTRIES, MAX_CGROUP_ENTRIES);
+	s->ringbuf = clamp_u64(roundup_pow2(cpus * RINGBUF_PER_CPU), MIN_RINGBUF, MAX_RINGBUF);
+}
+
+/* Parse a decimal count with an optional k or m suffix */
+static int parse_count(const char *str, size_t len, __u64 *out)
+{
+	char buf[32], *end;
+	__u64 mult = 1, v;
+
+	if (len == 0 || len >= sizeof(buf))
+		return -1;
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+
+	if (buf[len - 1] == 'k' || buf[len - 1] == 'K')
+		mult = 1024;
+	else if (buf[len - 1] == 'm' || buf[len - 1] == 'M')
+		mult = 1024 * 1024;
+	if (mult > 1)
+		buf[--len] = '\0';
+	if (len == 0 || buf[0] < '0' || buf[0] > '9')
+		return -1;
+
+	v = strtoull(buf, &end, 10);
+	if (*end != '\0' || v > MAX_RINGBUF_LIMIT)
+		return -1;
+	*out = v * mult;
+	return 0;
+}
+
+int map_sizes_parse(struct map_sizes *s, const char *spec)
+{
+	struct map_sizes next = *s;
+	const char *p = spec;
+	__u64 page = sysconf(_SC_PAGESIZE);
+
+	while (*p) {
+		const char *item = p, *eq, *end = strchr(p, ',');
+		size_t key_len;
+		__u64 v;
+
+		if (!end)
+			end = p + strlen(p);
+		eq = memchr(item, '=', end - item);
+		if (!eq || parse_count(eq + 1, end - eq - 1, &v) != 0 || v == 0)
+			goto bad;
+		key_len = eq - item;
+
+		if (key_len == 5 && strncmp(item, "tasks", 5) == 0) {
+			if (v > MAX_TASK_ENTRIES_LIMIT)
+				goto bad;
+			next.tasks = v;
+		} else if (key_len == 7 && strncmp(item, "cgroups", 7) == 0) {
+			if (v > MAX_CGROUP_ENTRIES_LIMIT)
+				goto bad;
+			next.cgroups = v;
+		} else if (key_len == 7 && strncmp(item, "ringbuf", 7) == 0) {
+			/* The kernel wants a power-of-two multiple of the page size */
+			v = roundup_pow2(v < page ? page : v);
+			if (v > MAX_RINGBUF_LIMIT)
+				goto bad;
+			next.ringbuf = v;
+		} else {
+			goto bad;
+		}
+
+		p = *end ? end + 1 : end;
+	}
+
+	*s = next;
+	return 0;
+
+bad:
+	fprintf(stderr, "Invalid map size spec '%s' (expected tasks=N,cgroups=N,ringbuf=SIZE)\n",
+		spec);
+	return -1;
+}
+
+__u32 read_pid_max(void)
+{
+	unsigned long v = 0;
+	FILE *f = fopen(PID_MAX_PATH, "r");
+
+	if (!f)
+		return 0;
+	if (fscanf(f, "%lu", &v) != 1)
+		v = 0;
+	fclose(f);
+	return v > 0xffffffffUL ? 0 : v;
+}
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * BPF map capacities for scx-slo
+ *
+ * The scheduler's maps are sized by the agent before load instead of at
+ * compile time: task contexts scale with the CPU count up to pid_max, SLO
+ * maps with the CPU count, and the deadline event ring with the number of
+ * CPUs that can report misses at the rate limit. Any of them can be
+ * overridden with "-m tasks=N,cgroups=N,ringbuf=SIZE".
+ */
+#ifndef __SCX_SLO_MAP_SIZING_H
+#define __SCX_SLO_MAP_SIZING_H
+
+#include <linux/types.h>
+
+#define PID_MAX_PATH "/proc/sys/kernel/pid_max"
+
+/* Task contexts per CPU, and the floor for small nodes */
+#define TASKS_PER_CPU    1024
+#define MIN_TASK_ENTRIES 8192
+
+/* SLO map entries per CPU, within these bounds */
+#define CGROUPS_PER_CPU    64
+#define MIN_CGROUP_ENTRIES 1024
+#define MAX_CGROUP_ENTRIES 65536
+
+/*
+ * Ring bytes per CPU: a deadline_event record takes 32 bytes and each CPU
+ * reports at most MAX_EVENTS_PER_SEC, so this holds half a second of them.
+ */
+#define RINGBUF_PER_CPU (16 * 1024)
+#define MIN_RINGBUF     (256 * 1024)
+#define MAX_RINGBUF     (16 * 1024 * 1024)
+
+/* Upper bounds for explicit overrides */
+#define MAX_TASK_ENTRIES_LIMIT   (1U << 24)
+#define MAX_CGROUP_ENTRIES_LIMIT (1U << 20)
+#define MAX_RINGBUF_LIMIT        (1U << 30)
+
+struct map_sizes {
+	__u32 tasks;        /* task_ctx_map entries */
+	__u32 cgroups;      /* Entries of each SLO map generation */
+	__u32 ringbuf;      /* deadline_events bytes, a power of two */
+};
+
+/* Sizes for a node with @nr_cpus CPUs and the given pid_max */
+void map_sizes_for_node(struct map_sizes *s, __u32 pid_max, int nr_cpus);
+
+/*
+ * Apply overrides from @spec, a comma-separated list of tasks=N,
+ * cgroups=N and ringbuf=SIZE (k and m suffixes allowed, rounded up to a
+ * power of two of at least a page). Returns 0, or -1 with @s unchanged if
+ * any item is malformed or out of range.
+ */
+int map_sizes_parse(struct map_sizes *s, const char *spec);
+
+/* The kernel's pid_max, or 0 if it cannot be read */
+__u32 read_pid_max(void);
+
+#endif /* __SCX_SLO_MAP_SIZING_H */
@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Per-cgroup deadline miss summaries for scx-slo
+ */
+#include <string.h>
+#include <stdlib.h>
+#include "miss_summary.h"
+
+#define SUB_COUNT (1U << MISS_HIST_SUB_BITS)
+
+static unsigned int hist_index(__u64 ns)
+{
+	__u64 us = ns / 1000;
+	unsigned int msb, idx;
+
+	if (us < SUB_COUNT)
+		return (unsigned int)us;
+
+	msb = 63 - __builtin_clzll(us);
+	idx = (msb - MISS_HIST_SUB_BITS + 1) * SUB_COUNT +
+	      (unsigned int)((us >> (msb - MISS_HIST_SUB_BITS)) & (SUB_COUNT - 1));
+	return idx < MISS_HIST_BUCKETS ? idx : MISS_HIST_BUCKETS - 1;
+}
+
+/* Largest value (ns) that maps to bucket @idx */
+static __u64 hist_upper_ns(unsigned int idx)
+{
+	unsigned int shift, sub;
+
+	if (idx < SUB_COUNT)
+		return (__u64)idx * 1000 + 999;
+
+	shift = idx / SUB_COUNT - 1;
+	sub = idx % SUB_COUNT;
+	return ((((__u64)SUB_COUNT + sub + 1) << shift) - 1) * 1000 + 999;
+}
+
+__u64 miss_hist_percentile(const __u32 *hist, __u64 count, unsigned int pct)
+{
+	__u64 target, seen = 0;
+
+	if (count == 0)
+		return 0;
+
+	/* Rank of the percentile sample, rounded up */
+	target = (count * pct + 99) / 100;
+	if (target == 0)
+		target = 1;
+
+	for (unsigned int i = 0; i < MISS_HIST_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= target)
+			return hist_upper_ns(i);
+	}
+	return hist_upper_ns(MISS_HIST_BUCKETS - 1);
+}
+
+void miss_summary_init(struct miss_summary *sum)
+{
+	memset(sum, 0, sizeof(*sum));
+}
+
+void miss_summary_record(struct miss_summary *sum, __u64 cgroup_id, __u64 miss_ns)
+{
+	struct miss_summary_slot *slot = NULL, *free_slot = NULL, *min_slot = NULL;
+
+	sum->total_events++;
+	sum->total_ns += miss_ns;
+
+	for (int i = 0; i < MISS_SUMMARY_SLOTS; i++) {
+		struct miss_summary_slot *s = &sum->slots[i];
+
+		if (s->cgroup_id == cgroup_id && s->count) {
+			slot = s;
+			break;
+		}
+		if (!s->count) {
+			if (!free_slot)
+				free_slot = s;
+		} else if (!min_slot || s->count < min_slot->count) {
+			min_slot = s;
+		}
+	}
+
+	if (!slot && free_slot) {
+		slot = free_slot;
+		memset(slot, 0, sizeof(*slot));
+		slot->cgroup_id = cgroup_id;
+	} else if (!slot) {
+		/*
+		 * Space-Saving: take over the smallest slot and inherit its count
+		 * as an overestimate, so a newcomer has to out-miss the current
+		 * minimum before it can push anything else out.
+		 */
+		__u64 inherited = min_slot->count;
+
+		slot = min_slot;
+		memset(slot, 0, sizeof(*slot));
+		slot->cgroup_id = cgroup_id;
+		slot->count = inherited;
+		slot->count_error = inherited;
+		sum->evictions++;
+	}
+
+	slot->count++;
+	slot->total_ns += miss_ns;
+	if (miss_ns > slot->max_ns)
+		slot->max_ns = miss_ns;
+	slot->hist[hist_index(miss_ns)]++;
+}
+
+static int cmp_count_desc(const void *a, const void *b)
+{
+	const struct miss_summary_slot *sa = *(const struct miss_summary_slot * const *)a;
+	const struct miss_summary_slot *sb = *(const struct miss_summary_slot * const *)b;
+
+	if (sa->count != sb->count)
+		return sa->count < sb->count ? 1 : -1;
+	return sa->cgroup_id < sb->cgroup_id ? -1 : sa->cgroup_id > sb->cgroup_id;
+}
+
+int miss_summary_flush(struct miss_summary *sum, miss_summary_emit_fn fn, void *ctx)
+{
+	struct miss_summary_slot *order[MISS_SUMMARY_SLOTS];
+	int n = 0;
+
+	for (int i = 0; i < MISS_SUMMARY_SLOTS; i++) {
+		if (sum->slots[i].count)
+			order[n++] = &sum->slots[i];
+	}
+	qsort(order, n, sizeof(order[0]), cmp_count_desc);
+
+	for (int i = 0; i < n; i++) {
+		const struct miss_summary_slot *s = order[i];
+		/* Inherited counts have no samples in the histogram */
+		__u64 sampled = s->count - s->count_error;
+		struct miss_summary_line line = {
+			.cgroup_id = s->cgroup_id,
+			.count = s->count,
+			.count_error = s->count_error,
+			.max_ns = s->max_ns,
+			.p99_ns = miss_hist_percentile(s->hist, sampled, 99),
+			.total_ns = s->total_ns,
+		};
+
+		/* A bucket bound can overshoot the largest sample; never report past it */
+		if (line.p99_ns > line.max_ns)
+			line.p99_ns = line.max_ns;
+		fn(&line, ctx);
+	}
+
+	miss_summary_init(sum);
+	return n;
+}
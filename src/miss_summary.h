@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Per-cgroup deadline miss summaries for scx-slo
+ *
+ * Aggregates miss events per cgroup over a reporting interval so the agent
+ * logs one line per cgroup instead of one per event. Tracking is bounded to
+ * MISS_SUMMARY_SLOTS cgroups using the Space-Saving heavy-hitters scheme:
+ * when a new cgroup arrives and every slot is taken, the least-missed slot
+ * is recycled, so the worst offenders always survive a miss storm.
+ */
+#ifndef __SCX_SLO_MISS_SUMMARY_H
+#define __SCX_SLO_MISS_SUMMARY_H
+
+#include "scx_slo.h"
+
+#define MISS_SUMMARY_SLOTS 64
+
+/*
+ * Log-linear histogram of miss durations in microseconds: 4 sub-buckets per
+ * power of two, so reported percentiles are within 25% of the true value.
+ */
+#define MISS_HIST_SUB_BITS 2
+#define MISS_HIST_BUCKETS  (42 << MISS_HIST_SUB_BITS)
+
+struct miss_summary_line {
+	__u64 cgroup_id;
+	__u64 count;
+	__u64 count_error;    /* Upper bound on misses inherited from an evicted slot */
+	__u64 max_ns;
+	__u64 p99_ns;
+	__u64 total_ns;
+};
+
+struct miss_summary_slot {
+	__u64 cgroup_id;      /* 0 = unused */
+	__u64 count;
+	__u64 count_error;
+	__u64 max_ns;
+	__u64 total_ns;
+	__u32 hist[MISS_HIST_BUCKETS];
+};
+
+struct miss_summary {
+	struct miss_summary_slot slots[MISS_SUMMARY_SLOTS];
+	__u64 total_events;   /* All events this interval, tracked or not */
+	__u64 total_ns;
+	__u64 evictions;
+};
+
+typedef void (*miss_summary_emit_fn)(const struct miss_summary_line *line, void *ctx);
+
+void miss_summary_init(struct miss_summary *sum);
+
+/* Account one deadline miss. O(MISS_SUMMARY_SLOTS), no allocation. */
+void miss_summary_record(struct miss_summary *sum, __u64 cgroup_id, __u64 miss_ns);
+
+/*
+ * Report tracked cgroups in descending miss count, then reset for the next
+ * interval. Returns the number of lines emitted.
+ */
+int miss_summary_flush(struct miss_summary *sum, miss_summary_emit_fn fn, void *ctx);
+
+/* Upper bound of the histogram bucket holding @pct percent of samples */
+__u64 miss_hist_percentile(const __u32 *hist, __u64 count, unsigned int pct);
+
+#endif /* __SCX_SLO_MISS_SUMMARY_H */
@@ -0,0 +1,360 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Partial-switch mode for scx-slo
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "partial_switch.h"
+
+#ifndef SCHED_RESET_ON_FORK
+#define SCHED_RESET_ON_FORK 0x40000000
+#endif
+
+#define THREADS_READ_SZ 4096
+
+struct tid_set {
+	pid_t *tids;
+	size_t nr, cap;
+};
+
+struct partial_switch {
+	int root_fd;
+	int depth;
+	struct partial_switch_ops ops;
+	struct tid_set owned;    /* Sorted; threads we put on SCHED_EXT */
+	pthread_mutex_t lock;    /* Protects stats */
+	struct partial_switch_stats stats;
+};
+
+static int sys_get_policy(pid_t tid, void *ctx)
+{
+	int policy;
+
+	(void)ctx;
+	policy = sched_getscheduler(tid);
+	return policy < 0 ? -errno : policy;
+}
+
+static int sys_set_policy(pid_t tid, int policy, void *ctx)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	(void)ctx;
+	return sched_setscheduler(tid, policy, &param) == 0 ? 0 : -errno;
+}
+
+static const struct partial_switch_ops sys_ops = {
+	.get_policy = sys_get_policy,
+	.set_policy = sys_set_policy,
+};
+
+static int tid_set_add(struct tid_set *s, pid_t tid)
+{
+	if (s->nr == s->cap) {
+		size_t cap = s->cap ? s->cap * 2 : 256;
+		pid_t *tids = realloc(s->tids, cap * sizeof(*tids));
+
+		if (!tids)
+			return -ENOMEM;
+		s->tids = tids;
+		s->cap = cap;
+	}
+	s->tids[s->nr++] = tid;
+	return 0;
+}
+
+static int cmp_tid(const void *a, const void *b)
+{
+	pid_t x = *(const pid_t *)a, y = *(const pid_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Sort and drop duplicates; a thread can be seen through nested configs */
+static void tid_set_normalize(struct tid_set *s)
+{
+	size_t out = 0;
+
+	qsort(s->tids, s->nr, sizeof(*s->tids), cmp_tid);
+	for (size_t i = 0; i < s->nr; i++) {
+		if (out == 0 || s->tids[out - 1] != s->tids[i])
+			s->tids[out++] = s->tids[i];
+	}
+	s->nr = out;
+}
+
+static bool tid_set_has(const struct tid_set *s, pid_t tid)
+{
+	return s->nr && bsearch(&tid, s->tids, s->nr, sizeof(*s->tids), cmp_tid);
+}
+
+struct partial_switch *partial_switch_new(const char *root, int depth,
+					  const struct partial_switch_ops *ops)
+{
+	struct partial_switch *ps = calloc(1, sizeof(*ps));
+
+	if (!ps)
+		return NULL;
+
+	ps->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (ps->root_fd < 0) {
+		int err = errno;
+
+		free(ps);
+		errno = err;
+		return NULL;
+	}
+	ps->depth = depth < 0 ? 0 : depth;
+	ps->ops = ops ? *ops : sys_ops;
+	pthread_mutex_init(&ps->lock, NULL);
+	return ps;
+}
+
+void partial_switch_free(struct partial_switch *ps)
+{
+	if (!ps)
+		return;
+	close(ps->root_fd);
+	free(ps->owned.tids);
+	pthread_mutex_destroy(&ps->lock);
+	free(ps);
+}
+
+/* Append the thread IDs listed in cgroup.threads of @dir_fd */
+static int read_threads(int dir_fd, struct tid_set *out)
+{
+	char buf[THREADS_READ_SZ + 1];
+	size_t len = 0;
+	ssize_t n;
+	int fd, err = 0;
+
+	fd = openat(dir_fd, "cgroup.threads", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return errno == ENOENT ? 0 : -errno;
+
+	/* Parse whole lines and carry a partial one into the next read */
+	while ((n = read(fd, buf + len, THREADS_READ_SZ - len)) > 0) {
+		char *p = buf, *nl;
+
+		len += n;
+		buf[len] = '\0';
+		while ((nl = memchr(p, '\n', buf + len - p))) {
+			long tid = strtol(p, NULL, 10);
+
+			if (tid > 0 && (err = tid_set_add(out, (pid_t)tid)) != 0)
+				goto out;
+			p = nl + 1;
+		}
+		len = buf + len - p;
+		memmove(buf, p, len);
+	}
+	if (n < 0)
+		err = -errno;
+out:
+	close(fd);
+	return err;
+}
+
+/* Collect threads of the cgroup at @dir_fd and its descendants to @depth */
+static int walk_cgroup(int dir_fd, int depth, struct tid_set *out)
+{
+	struct dirent *de;
+	DIR *dir;
+	int fd, err;
+
+	err = read_threads(dir_fd, out);
+	if (err || depth == 0)
+		return err;
+
+	fd = openat(dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	dir = fdopendir(fd);
+	if (!dir) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+
+	while (!err && (de = readdir(dir))) {
+		int child;
+
+		if (de->d_type != DT_DIR && de->d_type != DT_UNKNOWN)
+			continue;
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+		child = openat(dir_fd, de->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		if (child < 0)
+			continue;  /* Removed since readdir, or not a directory */
+		err = walk_cgroup(child, depth - 1, out);
+		close(child);
+	}
+	closedir(dir);
+	return err;
+}
+
+static bool fair_policy(int policy)
+{
+	return policy == SCHED_OTHER || policy == SCHED_BATCH || policy == SCHED_IDLE;
+}
+
+/* Returns 1 if @tid was moved back to SCHED_NORMAL, 0 if not, -errno on failure */
+static int revert_one(struct partial_switch *ps, pid_t tid)
+{
+	int policy = ps->ops.get_policy(tid, ps->ops.ctx);
+	int err;
+
+	if (policy < 0)
+		return policy == -ESRCH ? 0 : policy;
+	if ((policy & ~SCHED_RESET_ON_FORK) != SCHED_EXT)
+		return 0;
+	err = ps->ops.set_policy(tid, SCHED_OTHER | (policy & SCHED_RESET_ON_FORK), ps->ops.ctx);
+	if (err)
+		return err == -ESRCH ? 0 : err;
+	return 1;
+}
+
+int partial_switch_scan(struct partial_switch *ps, const char *const *paths, size_t nr)
+{
+	struct tid_set cur = {0}, owned = {0};
+	struct timespec t0, t1;
+	__u64 switched = 0, reverted = 0, failed = 0;
+	int err = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (size_t i = 0; i < nr && !err; i++) {
+		const char *rel = paths[i];
+		int fd;
+
+		while (*rel == '/')
+			rel++;
+		fd = openat(ps->root_fd, *rel ? rel : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0)
+			continue;  /* Removed, or not created yet */
+		err = walk_cgroup(fd, ps->depth, &cur);
+		close(fd);
+	}
+	if (err)
+		goto out;
+	tid_set_normalize(&cur);
+
+	for (size_t i = 0; i < cur.nr; i++) {
+		pid_t tid = cur.tids[i];
+		int policy = ps->ops.get_policy(tid, ps->ops.ctx);
+		int base = policy & ~SCHED_RESET_ON_FORK;
+		int ret;
+
+		if (policy < 0) {
+			if (policy != -ESRCH)
+				failed++;
+			continue;
+		}
+		/* Ours too if inherited on fork from a thread we switched */
+		if (base == SCHED_EXT) {
+			err = tid_set_add(&owned, tid);
+		} else if (fair_policy(base)) {
+			ret = ps->ops.set_policy(tid, SCHED_EXT | (policy & SCHED_RESET_ON_FORK),
+						 ps->ops.ctx);
+			if (ret == 0) {
+				switched++;
+				err = tid_set_add(&owned, tid);
+			} else if (ret != -ESRCH) {
+				failed++;
+			}
+		}
+		if (err)
+			goto out;
+	}
+
+	/* Threads switched earlier that left every configured cgroup */
+	for (size_t i = 0; i < ps->owned.nr; i++) {
+		pid_t tid = ps->owned.tids[i];
+		int ret;
+
+		if (tid_set_has(&cur, tid))
+			continue;
+		ret = revert_one(ps, tid);
+		if (ret > 0)
+			reverted++;
+		else if (ret < 0)
+			failed++;
+	}
+
+	/* @owned was filled in @cur order, so it is already sorted */
+	free(ps->owned.tids);
+	ps->owned = owned;
+	owned.tids = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	pthread_mutex_lock(&ps->lock);
+	ps->stats.scans++;
+	ps->stats.switched += switched;
+	ps->stats.reverted += reverted;
+	ps->stats.failed += failed;
+	ps->stats.threads = cur.nr;
+	ps->stats.owned = ps->owned.nr;
+	ps->stats.scan_ns = (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+	pthread_mutex_unlock(&ps->lock);
+out:
+	free(cur.tids);
+	free(owned.tids);
+	return err ? err : (int)switched;
+}
+
+size_t partial_switch_revert(struct partial_switch *ps, const pid_t *tids, size_t nr)
+{
+	struct tid_set gone = {0};
+	size_t reverted = 0, out = 0;
+	__u64 failed = 0;
+
+	if (!nr)
+		return 0;
+
+	for (size_t i = 0; i < nr; i++) {
+		int ret = revert_one(ps, tids[i]);
+
+		if (ret > 0)
+			reverted++;
+		else if (ret < 0)
+			failed++;
+	}
+
+	/* No longer ours; a later scan takes back any still configured */
+	gone.tids = malloc(nr * sizeof(*gone.tids));
+	if (gone.tids) {
+		memcpy(gone.tids, tids, nr * sizeof(*tids));
+		gone.nr = gone.cap = nr;
+		tid_set_normalize(&gone);
+		for (size_t i = 0; i < ps->owned.nr; i++) {
+			if (!tid_set_has(&gone, ps->owned.tids[i]))
+				ps->owned.tids[out++] = ps->owned.tids[i];
+		}
+		ps->owned.nr = out;
+		free(gone.tids);
+	}
+
+	pthread_mutex_lock(&ps->lock);
+	ps->stats.reverted += reverted;
+	ps->stats.failed += failed;
+	ps->stats.owned = ps->owned.nr;
+	pthread_mutex_unlock(&ps->lock);
+	return reverted;
+}
+
+void partial_switch_get_stats(struct partial_switch *ps, struct partial_switch_stats *out)
+{
+	pthread_mutex_lock(&ps->lock);
+	*out = ps->stats;
+	pthread_mutex_unlock(&ps->lock);
+}
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Partial-switch mode for scx-slo
+ *
+ * With SCX_OPS_SWITCH_PARTIAL the kernel only hands tasks whose policy is
+ * SCHED_EXT to the scheduler; everything else stays on the fair class.
+ * The agent owns the policy: every scan it reads cgroup.threads of each
+ * configured cgroup and of its descendants within the inherit depth (the
+ * cgroups whose tasks the scheduler would give that SLO), and moves fair
+ * threads there to SCHED_EXT. Threads it switched earlier that have since
+ * left every configured cgroup, and strays the scheduler reports, are
+ * moved back to SCHED_NORMAL. Real-time and deadline threads are never
+ * touched, and SCHED_RESET_ON_FORK is preserved.
+ *
+ * Policy changes go through an ops table so tests can run unprivileged.
+ */
+#ifndef __SCX_SLO_PARTIAL_SWITCH_H
+#define __SCX_SLO_PARTIAL_SWITCH_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "scx_slo.h"
+
+#ifndef SCHED_EXT
+#define SCHED_EXT 7
+#endif
+
+#define PARTIAL_SCAN_INTERVAL_SEC 2
+
+/* Thread policy accessors; return the policy / 0, or -errno */
+struct partial_switch_ops {
+	int (*get_policy)(pid_t tid, void *ctx);
+	int (*set_policy)(pid_t tid, int policy, void *ctx);
+	void *ctx;
+};
+
+struct partial_switch_stats {
+	__u64 scans;
+	__u64 switched;       /* Threads moved to SCHED_EXT */
+	__u64 reverted;       /* Threads moved back to SCHED_NORMAL */
+	__u64 failed;         /* Policy changes refused, other than for exited threads */
+	__u32 threads;        /* Threads in configured cgroups at the last scan */
+	__u32 owned;          /* Of those, switched by us and not reverted */
+	__u64 scan_ns;        /* Duration of the last scan */
+};
+
+struct partial_switch;
+
+/*
+ * Switch threads of cgroups under @root (e.g. "/sys/fs/cgroup") and of
+ * their descendants down to @depth levels. @ops NULL uses the
+ * sched_getscheduler()/sched_setscheduler() syscalls. Returns NULL with
+ * errno set on failure.
+ */
+struct partial_switch *partial_switch_new(const char *root, int depth,
+					  const struct partial_switch_ops *ops);
+void partial_switch_free(struct partial_switch *ps);
+
+/*
+ * Bring the policies in line with the @nr configured cgroups @paths,
+ * relative to the root ("/kubepods/..."). Missing cgroups are skipped.
+ * Returns the number of threads switched, or -errno.
+ */
+int partial_switch_scan(struct partial_switch *ps, const char *const *paths, size_t nr);
+
+/*
+ * Move @tids that are still SCHED_EXT back to SCHED_NORMAL, e.g. threads
+ * that inherited the policy on fork and then left their cgroup. Returns
+ * the number reverted.
+ */
+size_t partial_switch_revert(struct partial_switch *ps, const pid_t *tids, size_t nr);
+
+/* Copy the counters; safe against a concurrent scan */
+void partial_switch_get_stats(struct partial_switch *ps, struct partial_switch_stats *out);
+
+#endif /* __SCX_SLO_PARTIAL_SWITCH_H */
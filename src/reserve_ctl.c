@@ -0,0 +1,310 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Reserved CPU partition for scx-slo
+ */
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "reserve_ctl.h"
+#include "spec_parse.h"
+
+/* Counters of one SLO map entry at the previous step */
+struct res_entry {
+	__u64 cgroup_id;
+	struct slo_cgrp_stats last;
+};
+
+struct reserve_ctl {
+	pthread_mutex_t lock;
+	struct reserve_params p;
+	__u32 cpus;
+	__u32 size;                 /* CPUs reserved */
+	__u32 good;                 /* Intervals with slack in a row */
+	struct res_entry *entries;  /* Sorted by cgroup_id */
+	size_t nr;
+	struct reserve_stats stats;
+};
+
+void reserve_params_default(struct reserve_params *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->miss_grow = 0.01;
+	p->miss_shrink = 0.002;
+	p->slack_shrink = 0.3;
+	p->max_frac = 0.5;
+	p->importance = 80;
+	p->step = 1;
+	p->shrink_after = 3;
+	p->min_runs = 50;
+	p->interval_sec = 5;
+}
+
+static const struct spec_key reserve_keys[] = {
+	SPEC_KEY_DOUBLE("miss_grow", struct reserve_params, miss_grow, 1e-6, 1),
+	SPEC_KEY_DOUBLE("miss_shrink", struct reserve_params, miss_shrink, 0, 1),
+	SPEC_KEY_DOUBLE("slack_shrink", struct reserve_params, slack_shrink, 0, 1),
+	SPEC_KEY_DOUBLE("max_frac", struct reserve_params, max_frac, 0, 0.95),
+	SPEC_KEY_U32("importance", struct reserve_params, importance, MIN_IMPORTANCE, MAX_IMPORTANCE + 1),
+	SPEC_KEY_U32("step", struct reserve_params, step, 1, 1024),
+	SPEC_KEY_U32("shrink_after", struct reserve_params, shrink_after, 1, 1000),
+	SPEC_KEY_U32("min_runs", struct reserve_params, min_runs, 1, 1000000),
+	SPEC_KEY_U32("interval", struct reserve_params, interval_sec, 1, 3600),
+};
+
+static bool reserve_params_valid(const void *params)
+{
+	const struct reserve_params *p = params;
+
+	return p->miss_shrink <= p->miss_grow;
+}
+
+static const struct spec_def reserve_spec = {
+	.what = "reserved partition",
+	.keys = reserve_keys,
+	.nr_keys = SPEC_NR_KEYS(reserve_keys),
+	.size = sizeof(struct reserve_params),
+	.valid = reserve_params_valid,
+};
+
+int reserve_parse(struct reserve_params *p, const char *spec)
+{
+	return spec_parse(&reserve_spec, p, spec);
+}
+
+bool reserve_eligible(const struct reserve_params *p, const struct slo_cfg *cfg)
+{
+	return (cfg->flags & SLO_CLASS_MASK) == SLO_CLASS_CRITICAL ||
+	       cfg->importance >= p->importance;
+}
+
+/* Read a CPU list such as "0-1,8" from @path into @set; returns 0 or -1 */
+static int read_cpu_list(const char *path, __u32 nr_cpus, bool *set)
+{
+	char buf[256], *s, *end;
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return -1;
+	if (!fgets(buf, sizeof(buf), f)) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	for (s = buf; *s && *s != '\n';) {
+		unsigned long lo = strtoul(s, &end, 10), hi = lo;
+
+		if (end == s)
+			return -1;
+		if (*end == '-') {
+			s = end + 1;
+			hi = strtoul(s, &end, 10);
+			if (end == s)
+				return -1;
+		}
+		for (unsigned long c = lo; c <= hi && c < nr_cpus; c++)
+			set[c] = true;
+		s = *end == ',' ? end + 1 : end;
+	}
+	return 0;
+}
+
+__u32 reserve_cpu_order(const char *sysfs, __u32 nr_cpus, __u32 *order)
+{
+	bool *placed = calloc(nr_cpus + 1, sizeof(*placed));
+	bool *sib = calloc(nr_cpus + 1, sizeof(*sib));
+	char path[512];
+	__u32 n = 0;
+
+	if (!placed || !sib)
+		goto out;
+
+	for (__u32 cpu = nr_cpus; cpu-- > 0;) {
+		if (placed[cpu])
+			continue;
+		snprintf(path, sizeof(path), "%s/cpu%u/topology/thread_siblings_list", sysfs, cpu);
+		memset(sib, 0, nr_cpus * sizeof(*sib));
+		if (read_cpu_list(path, nr_cpus, sib) != 0) {
+			/* Offline, or no topology: only CPUs with one are used */
+			snprintf(path, sizeof(path), "%s/cpu%u/topology", sysfs, cpu);
+			if (access(path, F_OK) != 0)
+				continue;
+		}
+		sib[cpu] = true;
+		for (__u32 c = nr_cpus; c-- > 0;) {
+			if (sib[c] && !placed[c]) {
+				placed[c] = true;
+				order[n++] = c;
+			}
+		}
+	}
+out:
+	free(placed);
+	free(sib);
+	return n;
+}
+
+struct reserve_ctl *reserve_ctl_new(const struct reserve_params *p, __u32 cpus)
+{
+	struct reserve_ctl *rc;
+
+	if (!cpus) {
+		errno = EINVAL;
+		return NULL;
+	}
+	rc = calloc(1, sizeof(*rc));
+	if (!rc)
+		return NULL;
+	pthread_mutex_init(&rc->lock, NULL);
+	rc->p = *p;
+	rc->cpus = cpus;
+	return rc;
+}
+
+void reserve_ctl_free(struct reserve_ctl *rc)
+{
+	if (!rc)
+		return;
+	pthread_mutex_destroy(&rc->lock);
+	free(rc->entries);
+	free(rc);
+}
+
+/* Time between enqueue and deadline for @cfg, as the scheduler computes it */
+static double deadline_window(const struct slo_cfg *cfg)
+{
+	__u32 imp = cfg->importance;
+
+	if (imp < MIN_IMPORTANCE)
+		imp = MIN_IMPORTANCE;
+	if (imp > MAX_IMPORTANCE)
+		imp = MAX_IMPORTANCE;
+	return (double)cfg->budget_ns * (101 - imp) / 100;
+}
+
+/* Whether any counter went backwards, i.e. the stats entry was recreated */
+static bool stats_reset(const struct slo_cgrp_stats *cur, const struct slo_cgrp_stats *last)
+{
+	return cur->runs < last->runs || cur->late < last->late ||
+	       cur->slack_ns < last->slack_ns || cur->runtime_ns < last->runtime_ns;
+}
+
+static int cmp_sample(const void *a, const void *b)
+{
+	const struct budget_ctl_sample *x = a, *y = b;
+
+	return x->cgroup_id < y->cgroup_id ? -1 : x->cgroup_id > y->cgroup_id;
+}
+
+/* Most CPUs worth reserving: within max_frac, one beyond use, one left over */
+static __u32 size_limit(const struct reserve_ctl *rc, double util)
+{
+	__u32 limit = (__u32)(rc->p.max_frac * rc->cpus);
+	double need = ceil(util) + 1;
+
+	if (limit > rc->cpus - 1)
+		limit = rc->cpus - 1;
+	if (need < limit)
+		limit = (__u32)need;
+	return limit;
+}
+
+int reserve_ctl_step(struct reserve_ctl *rc, struct budget_ctl_sample *s, size_t nr,
+		     __u64 interval_ns)
+{
+	struct res_entry *next = malloc((nr + 1) * sizeof(*next));
+	const struct reserve_params *p = &rc->p;
+	__u64 runs = 0, late = 0, runtime = 0;
+	double slack = 0, miss, slack_frac, util;
+	__u32 eligible = 0, limit;
+	size_t i, j = 0;
+	int size;
+
+	if (!next)
+		return -ENOMEM;
+	qsort(s, nr, sizeof(*s), cmp_sample);
+
+	pthread_mutex_lock(&rc->lock);
+	for (i = 0; i < nr; i++) {
+		struct res_entry *e = &next[i];
+		const struct slo_cgrp_stats *last;
+		double window;
+		bool known;
+
+		while (j < rc->nr && rc->entries[j].cgroup_id < s[i].cgroup_id)
+			j++;
+		known = j < rc->nr && rc->entries[j].cgroup_id == s[i].cgroup_id &&
+			!(i && s[i - 1].cgroup_id == s[i].cgroup_id);
+		e->cgroup_id = s[i].cgroup_id;
+		e->last = s[i].stats;
+		if (!reserve_eligible(p, &s[i].cfg))
+			continue;
+		eligible++;
+		if (!known || stats_reset(&s[i].stats, &rc->entries[j].last))
+			continue;
+
+		last = &rc->entries[j].last;
+		window = deadline_window(&s[i].cfg);
+		runs += s[i].stats.runs - last->runs;
+		late += s[i].stats.late - last->late;
+		runtime += s[i].stats.runtime_ns - last->runtime_ns;
+		if (window > 0)
+			slack += (s[i].stats.slack_ns - last->slack_ns) / window;
+	}
+	free(rc->entries);
+	rc->entries = next;
+	rc->nr = nr;
+
+	miss = runs ? (double)late / runs : 0;
+	slack_frac = runs > late ? slack / (runs - late) : 0;
+	util = interval_ns ? (double)runtime / interval_ns : 0;
+	limit = size_limit(rc, util);
+
+	/* The first step only sets the counters to compare with */
+	if (!interval_ns) {
+		limit = rc->stats.limit;
+	} else if (rc->size > limit) {
+		rc->size = limit;
+		rc->good = 0;
+		rc->stats.shrinks++;
+	} else if (runs >= p->min_runs && miss > p->miss_grow) {
+		__u32 grown = rc->size + p->step < limit ? rc->size + p->step : limit;
+
+		if (grown > rc->size)
+			rc->stats.grows++;
+		rc->size = grown;
+		rc->good = 0;
+	} else if (runs < p->min_runs || (miss <= p->miss_shrink && slack_frac >= p->slack_shrink)) {
+		/* Too little eligible work to judge counts as slack */
+		if (rc->size && ++rc->good >= p->shrink_after) {
+			rc->size--;
+			rc->good = 0;
+			rc->stats.shrinks++;
+		}
+	} else {
+		rc->good = 0;
+	}
+
+	rc->stats.cpus = rc->size;
+	rc->stats.limit = limit;
+	rc->stats.eligible = eligible;
+	if (interval_ns) {
+		rc->stats.last_miss = miss;
+		rc->stats.last_slack = slack_frac;
+		rc->stats.util = util;
+	}
+	size = rc->size;
+	pthread_mutex_unlock(&rc->lock);
+	return size;
+}
+
+void reserve_ctl_get_stats(struct reserve_ctl *rc, struct reserve_stats *out)
+{
+	pthread_mutex_lock(&rc->lock);
+	*out = rc->stats;
+	pthread_mutex_unlock(&rc->lock);
+}
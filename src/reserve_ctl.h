@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Reserved CPU partition for scx-slo
+ *
+ * The scheduler keeps the CPUs of a reserved partition for cgroups of the
+ * critical class or of high importance; everything else runs on the rest.
+ * Once per interval the agent hands the controller every SLO map entry
+ * with its run statistics, as for the budget controller, and gets back
+ * how many CPUs to reserve. The partition grows while the eligible
+ * cgroups miss more than miss_grow of their deadlines, and gives a CPU
+ * back after shrink_after intervals in a row with few misses and slack
+ * to spare. It never takes more than max_frac of the node, nor more than
+ * one CPU beyond what the eligible cgroups use.
+ *
+ * Which CPUs are reserved is fixed by an order computed once from the CPU
+ * topology: from the highest CPU down, with SMT siblings next to each
+ * other, so the partition grows a core at a time and CPU 0, which takes
+ * most housekeeping, goes last.
+ */
+#ifndef __SCX_SLO_RESERVE_CTL_H
+#define __SCX_SLO_RESERVE_CTL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "scx_slo.h"
+#include "budget_ctl.h"
+
+struct reserve_params {
+	double miss_grow;     /* Miss ratio above which the partition grows */
+	double miss_shrink;   /* Miss ratio at or below which it may shrink */
+	double slack_shrink;  /* Mean slack, as a share of the window, needed to shrink */
+	double max_frac;      /* Largest share of the CPUs reserved */
+	__u32 importance;     /* Cgroups at or above it may use reserved CPUs */
+	__u32 step;           /* CPUs added per interval */
+	__u32 shrink_after;   /* Intervals with slack in a row before a CPU is given back */
+	__u32 min_runs;       /* Runs per interval below which misses are not judged */
+	__u32 interval_sec;   /* Time between two steps */
+};
+
+struct reserve_stats {
+	__u32 cpus;           /* CPUs reserved */
+	__u32 limit;          /* Most CPUs that could be reserved now */
+	__u32 eligible;       /* SLO map entries that may use reserved CPUs */
+	double last_miss;     /* Miss ratio of eligible cgroups, last interval */
+	double last_slack;    /* Their mean slack as a share of the window */
+	double util;          /* CPUs they used */
+	__u64 grows;
+	__u64 shrinks;
+};
+
+struct reserve_ctl;
+
+void reserve_params_default(struct reserve_params *p);
+
+/*
+ * Parse @spec (see spec_parse.h) into @p. Keys: miss_grow, miss_shrink,
+ * slack_shrink, max_frac, importance, step, shrink_after, min_runs and
+ * interval.
+ */
+int reserve_parse(struct reserve_params *p, const char *spec);
+
+/* Whether @cfg may run on reserved CPUs, as the scheduler decides */
+bool reserve_eligible(const struct reserve_params *p, const struct slo_cfg *cfg);
+
+/*
+ * Order in which CPUs 0 to @nr_cpus - 1 join the partition, from the
+ * topology under @sysfs (/sys/devices/system/cpu). CPUs without a
+ * topology directory are offline and left out. Returns the number of
+ * CPUs written to @order.
+ */
+__u32 reserve_cpu_order(const char *sysfs, __u32 nr_cpus, __u32 *order);
+
+/* A controller for a node with @cpus usable CPUs */
+struct reserve_ctl *reserve_ctl_new(const struct reserve_params *p, __u32 cpus);
+void reserve_ctl_free(struct reserve_ctl *rc);
+
+/*
+ * Take one interval of @s, sampled @interval_ns after the last step and
+ * sorted in place, and return the number of CPUs to reserve. Returns
+ * -ENOMEM, with the partition unchanged, if state cannot be kept.
+ */
+int reserve_ctl_step(struct reserve_ctl *rc, struct budget_ctl_sample *s, size_t nr,
+		     __u64 interval_ns);
+
+void reserve_ctl_get_stats(struct reserve_ctl *rc, struct reserve_stats *out);
+
+#endif /* __SCX_SLO_RESERVE_CTL_H */
@@ -0,0 +1,404 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Cgroup path pattern matching for scx-slo
+ *
+ * Each trie node is one path component. Literal children are kept sorted
+ * for binary search. Wildcard children are sorted by their literal prefix
+ * (the characters before the first wildcard), so only those whose prefix
+ * starts the component are tried with fnmatch(). A "..." child absorbs any
+ * number of components before its own children continue the match.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fnmatch.h>
+#include "rule_trie.h"
+
+struct trie_node {
+	char *name;                  /* Component; NULL for the root and "..." */
+	size_t prefix_len;           /* Characters of name before a wildcard */
+	int rule;                    /* Highest rule ending here, -1 if none */
+	struct trie_node **lits;     /* Literal children, sorted by name */
+	size_t nr_lits, cap_lits;
+	struct trie_node **globs;    /* Wildcard children, sorted by prefix */
+	size_t nr_globs, cap_globs;
+	size_t *prefix_lens;         /* Distinct prefix lengths among globs */
+	size_t nr_prefix_lens, cap_prefix_lens;
+	struct trie_node *any;       /* "..." child */
+};
+
+/* Position in the wildcard children that may match one component */
+struct glob_iter {
+	const char *comp;
+	size_t len;
+	size_t li;                   /* Next prefix length to try */
+	size_t j;                    /* Next candidate in globs */
+	size_t prefix;               /* Prefix length of the current group */
+};
+
+struct rule_trie {
+	struct trie_node root;
+	size_t nr_patterns;
+};
+
+/* Path split into components, pointing into buf */
+struct path_parts {
+	char buf[PATH_MAX];
+	const char *comp[RULE_TRIE_MAX_DEPTH];
+	int nr;
+};
+
+static int split_path(const char *path, struct path_parts *pp)
+{
+	char *p, *save = NULL;
+
+	if (!path || path[0] != '/' || strlen(path) >= sizeof(pp->buf))
+		return -EINVAL;
+
+	strcpy(pp->buf, path);
+	pp->nr = 0;
+	for (p = strtok_r(pp->buf, "/", &save); p; p = strtok_r(NULL, "/", &save)) {
+		if (pp->nr == RULE_TRIE_MAX_DEPTH)
+			return -E2BIG;
+		pp->comp[pp->nr++] = p;
+	}
+	return 0;
+}
+
+static bool is_glob(const char *comp)
+{
+	return strpbrk(comp, "*?[") != NULL;
+}
+
+static bool is_any(const char *comp)
+{
+	return strcmp(comp, RULE_TRIE_ANY) == 0;
+}
+
+bool rule_is_pattern(const char *path)
+{
+	struct path_parts pp;
+
+	if (split_path(path, &pp) != 0)
+		return false;
+	for (int i = 0; i < pp.nr; i++)
+		if (is_glob(pp.comp[i]) || is_any(pp.comp[i]))
+			return true;
+	return false;
+}
+
+static struct trie_node *node_new(const char *name)
+{
+	struct trie_node *n = calloc(1, sizeof(*n));
+
+	if (!n)
+		return NULL;
+	n->rule = -1;
+	if (name) {
+		n->name = strdup(name);
+		if (!n->name) {
+			free(n);
+			return NULL;
+		}
+		n->prefix_len = strcspn(name, "*?[");
+	}
+	return n;
+}
+
+static void node_free(struct trie_node *n)
+{
+	for (size_t i = 0; i < n->nr_lits; i++) {
+		node_free(n->lits[i]);
+		free(n->lits[i]);
+	}
+	for (size_t i = 0; i < n->nr_globs; i++) {
+		node_free(n->globs[i]);
+		free(n->globs[i]);
+	}
+	if (n->any) {
+		node_free(n->any);
+		free(n->any);
+	}
+	free(n->lits);
+	free(n->globs);
+	free(n->prefix_lens);
+	free(n->name);
+}
+
+struct rule_trie *rule_trie_new(void)
+{
+	struct rule_trie *t = calloc(1, sizeof(*t));
+
+	if (t)
+		t->root.rule = -1;
+	return t;
+}
+
+void rule_trie_free(struct rule_trie *t)
+{
+	if (!t)
+		return;
+	node_free(&t->root);
+	free(t);
+}
+
+/* Index of the first literal child >= @name */
+static size_t lit_lower_bound(const struct trie_node *n, const char *name)
+{
+	size_t lo = 0, hi = n->nr_lits;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (strcmp(n->lits[mid]->name, name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static struct trie_node *find_lit(const struct trie_node *n, const char *name)
+{
+	size_t i = lit_lower_bound(n, name);
+
+	return i < n->nr_lits && strcmp(n->lits[i]->name, name) == 0 ? n->lits[i] : NULL;
+}
+
+static int cmp_prefix(const char *a, size_t alen, const char *b, size_t blen)
+{
+	int c = memcmp(a, b, alen < blen ? alen : blen);
+
+	if (c)
+		return c;
+	return (alen > blen) - (alen < blen);
+}
+
+/* Index of the first wildcard child whose prefix is >= @key[0..@len) */
+static size_t glob_lower_bound(const struct trie_node *n, const char *key, size_t len)
+{
+	size_t lo = 0, hi = n->nr_globs;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const struct trie_node *g = n->globs[mid];
+
+		if (cmp_prefix(g->name, g->prefix_len, key, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Next wildcard child of @n matching the iterator's component, or NULL */
+static const struct trie_node *glob_next(const struct trie_node *n, struct glob_iter *it)
+{
+	for (;;) {
+		while (it->j < n->nr_globs) {
+			const struct trie_node *g = n->globs[it->j];
+
+			if (cmp_prefix(g->name, g->prefix_len, it->comp, it->prefix) != 0)
+				break;
+			it->j++;
+			if (fnmatch(g->name, it->comp, FNM_PERIOD) == 0)
+				return g;
+		}
+
+		/* Move on to the group of the next prefix length */
+		while (it->li < n->nr_prefix_lens && n->prefix_lens[it->li] > it->len)
+			it->li++;
+		if (it->li == n->nr_prefix_lens)
+			return NULL;
+		it->prefix = n->prefix_lens[it->li++];
+		it->j = glob_lower_bound(n, it->comp, it->prefix);
+	}
+}
+
+static void glob_iter_init(struct glob_iter *it, const char *comp)
+{
+	it->comp = comp;
+	it->len = strlen(comp);
+	it->li = 0;
+	it->j = SIZE_MAX;
+	it->prefix = 0;
+}
+
+static int grow(void **arr, size_t *cap, size_t nr, size_t size)
+{
+	void *p;
+	size_t new_cap;
+
+	if (nr < *cap)
+		return 0;
+	new_cap = *cap ? *cap * 2 : 4;
+	p = realloc(*arr, new_cap * size);
+	if (!p)
+		return -ENOMEM;
+	*arr = p;
+	*cap = new_cap;
+	return 0;
+}
+
+static struct trie_node *add_glob(struct trie_node *n, const char *comp)
+{
+	size_t plen = strcspn(comp, "*?["), i, k;
+	struct trie_node *c;
+
+	i = glob_lower_bound(n, comp, plen);
+	for (k = i; k < n->nr_globs &&
+	     cmp_prefix(n->globs[k]->name, n->globs[k]->prefix_len, comp, plen) == 0; k++)
+		if (strcmp(n->globs[k]->name, comp) == 0)
+			return n->globs[k];
+
+	for (k = 0; k < n->nr_prefix_lens && n->prefix_lens[k] != plen; k++)
+		;
+	if (k == n->nr_prefix_lens) {
+		if (grow((void **)&n->prefix_lens, &n->cap_prefix_lens, n->nr_prefix_lens,
+			 sizeof(*n->prefix_lens)) != 0)
+			return NULL;
+		n->prefix_lens[n->nr_prefix_lens++] = plen;
+	}
+
+	if (grow((void **)&n->globs, &n->cap_globs, n->nr_globs, sizeof(*n->globs)) != 0)
+		return NULL;
+	c = node_new(comp);
+	if (!c)
+		return NULL;
+	memmove(&n->globs[i + 1], &n->globs[i], (n->nr_globs - i) * sizeof(*n->globs));
+	n->globs[i] = c;
+	n->nr_globs++;
+	return c;
+}
+
+/* Child of @n for component @comp, created if missing */
+static struct trie_node *get_child(struct trie_node *n, const char *comp)
+{
+	struct trie_node *c;
+
+	if (is_any(comp)) {
+		if (!n->any)
+			n->any = node_new(NULL);
+		return n->any;
+	}
+
+	if (is_glob(comp))
+		return add_glob(n, comp);
+
+	size_t i = lit_lower_bound(n, comp);
+
+	if (i < n->nr_lits && strcmp(n->lits[i]->name, comp) == 0)
+		return n->lits[i];
+	if (grow((void **)&n->lits, &n->cap_lits, n->nr_lits, sizeof(*n->lits)) != 0)
+		return NULL;
+	c = node_new(comp);
+	if (!c)
+		return NULL;
+	memmove(&n->lits[i + 1], &n->lits[i], (n->nr_lits - i) * sizeof(*n->lits));
+	n->lits[i] = c;
+	n->nr_lits++;
+	return c;
+}
+
+int rule_trie_add(struct rule_trie *t, const char *pattern, int rule)
+{
+	struct path_parts pp;
+	struct trie_node *n = &t->root;
+
+	if (rule < 0 || split_path(pattern, &pp) != 0)
+		return -EINVAL;
+	for (int i = 0; i < pp.nr; i++)
+		if (strcmp(pp.comp[i], ".") == 0 || strcmp(pp.comp[i], "..") == 0)
+			return -EINVAL;
+
+	for (int i = 0; i < pp.nr; i++) {
+		/* Consecutive "..." are one "..." */
+		if (i > 0 && is_any(pp.comp[i]) && is_any(pp.comp[i - 1]))
+			continue;
+		n = get_child(n, pp.comp[i]);
+		if (!n)
+			return -ENOMEM;
+	}
+
+	if (rule > n->rule)
+		n->rule = rule;
+	t->nr_patterns++;
+	return 0;
+}
+
+static int max_rule(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+/* Best rule for comp[i..] starting at @n */
+static int match_from(const struct trie_node *n, const struct path_parts *pp, int i)
+{
+	int best = -1;
+
+	if (i == pp->nr)
+		best = n->rule;
+	else {
+		const struct trie_node *lit = find_lit(n, pp->comp[i]), *g;
+		struct glob_iter it;
+
+		if (lit)
+			best = max_rule(best, match_from(lit, pp, i + 1));
+		glob_iter_init(&it, pp->comp[i]);
+		while ((g = glob_next(n, &it)))
+			best = max_rule(best, match_from(g, pp, i + 1));
+	}
+
+	/* "..." swallows comp[i..k) for every k, including nothing */
+	if (n->any)
+		for (int k = i; k <= pp->nr; k++)
+			best = max_rule(best, match_from(n->any, pp, k));
+
+	return best;
+}
+
+int rule_trie_match(const struct rule_trie *t, const char *path)
+{
+	struct path_parts pp;
+
+	if (split_path(path, &pp) != 0)
+		return -1;
+	return match_from(&t->root, &pp, 0);
+}
+
+/* Whether some pattern continues past comp[0..i) from @n */
+static bool reachable_from(const struct trie_node *n, const struct path_parts *pp, int i)
+{
+	/* Every node leads to a rule, and "..." accepts whatever follows */
+	if (i == pp->nr || n->any)
+		return true;
+
+	const struct trie_node *lit = find_lit(n, pp->comp[i]), *g;
+	struct glob_iter it;
+
+	if (lit && reachable_from(lit, pp, i + 1))
+		return true;
+	glob_iter_init(&it, pp->comp[i]);
+	while ((g = glob_next(n, &it)))
+		if (reachable_from(g, pp, i + 1))
+			return true;
+	return false;
+}
+
+bool rule_trie_may_match_below(const struct rule_trie *t, const char *path)
+{
+	struct path_parts pp;
+
+	if (!t->nr_patterns || split_path(path, &pp) != 0)
+		return false;
+	return reachable_from(&t->root, &pp, 0);
+}
+
+size_t rule_trie_size(const struct rule_trie *t)
+{
+	return t->nr_patterns;
+}
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Cgroup path pattern matching for scx-slo
+ *
+ * Config rules name cgroups by path. Besides literal paths a rule may use
+ * shell wildcards within a component ("pod*", "nginx-?") and "..." as
+ * a component matching any number of components, including none:
+ *
+ *   /kubepods.slice/kubepods-burstable.slice/kubepods-burstable-pod?*.slice/...
+ *
+ * Patterns are compiled into a trie over path components, so matching a
+ * path costs a few lookups per component regardless of the rule count.
+ * When several patterns match, the one with the highest rule number wins,
+ * mirroring "later config lines override earlier ones".
+ */
+#ifndef __SCX_SLO_RULE_TRIE_H
+#define __SCX_SLO_RULE_TRIE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RULE_TRIE_MAX_DEPTH 32    /* Path components matched at most */
+#define RULE_TRIE_ANY       "..." /* Component matching zero or more components */
+
+struct rule_trie;
+
+struct rule_trie *rule_trie_new(void);
+void rule_trie_free(struct rule_trie *t);
+
+/* Whether @path uses wildcards or "...", i.e. may match more than one cgroup */
+bool rule_is_pattern(const char *path);
+
+/*
+ * Add absolute @pattern for @rule (>= 0). Returns 0, -EINVAL for a
+ * malformed pattern or -ENOMEM.
+ */
+int rule_trie_add(struct rule_trie *t, const char *pattern, int rule);
+
+/* Highest rule whose pattern matches absolute @path, or -1 */
+int rule_trie_match(const struct rule_trie *t, const char *path);
+
+/* Whether any pattern could match @path or a cgroup below it */
+bool rule_trie_may_match_below(const struct rule_trie *t, const char *path);
+
+/* Number of patterns added */
+size_t rule_trie_size(const struct rule_trie *t);
+
+#endif /* __SCX_SLO_RULE_TRIE_H */
@@ -10,6 +10,14 @@
  * - Per-cgroup SLO configuration (latency budget in nanoseconds)
  * - Virtual deadline scheduling (deadline = last_runtime + budget)
  * - Deadline miss detection and reporting
+ * - Latency classes (critical, standard, batch, best-effort) per cgroup
+ * - Per-SLO run statistics for the agent's adaptive budgets
+ * - A reserved CPU partition for latency-critical cgroups, sized by the agent
+ * - CPU performance targets from each running task's class, importance and slack
+ * - Burst learning: per-task slices, short-burst priority and miss prediction stats
+ * - SLO entries of removed cgroups dropped on cgroup exit
+ * - Shadow mode: the same deadlines computed from scheduler tracepoints
+ *   under the kernel's own scheduler, without sched_ext
  * - Graceful fallback for tasks without SLO configuration
  *
  * Based on scx_simple scheduler framework.
@@ -18,11 +26,40 @@
 
 char _license[] SEC("license") = "GPL";
 
+/*
+ * Shadow mode loads this object on kernels without sched_ext, where the
+ * scheduler's kfuncs do not exist. Weak references leave them unresolved
+ * there; the programs calling them are not loaded in that mode.
+ */
+#pragma weak scx_bpf_create_dsq
+#pragma weak scx_bpf_select_cpu_dfl
+#pragma weak scx_bpf_test_and_clear_cpu_idle
+#pragma weak scx_bpf_kick_cpu
+#pragma weak scx_bpf_task_cpu
+#pragma weak scx_bpf_task_cgroup
+#pragma weak scx_bpf_dsq_insert
+#pragma weak scx_bpf_dsq_insert_vtime
+#pragma weak scx_bpf_dsq_move_to_local
+#pragma weak scx_bpf_cpuperf_set
+
 /* Maximum value for u64 - used for overflow protection */
 #ifndef U64_MAX
 #define U64_MAX ((u64)~0ULL)
 #endif
 
+/* Map sizing defaults; the agent sizes these maps for the node before load */
+#define MAX_CGROUPS 10000
+#define MAX_TASKS 100000
+#define MAX_STRAYS 4096          /* Partial mode; drained every scan */
+#define MAX_CPUS 4096            /* Reserved partition; sized to the node */
+#define RINGBUF_SIZE (1 << 20)   /* 1MB */
+#define STATS_MAP_ENTRIES 2      /* [local, global] */
+#define RATE_LIMIT_MAP_ENTRIES 2 /* [event_count, window_start] */
+
+/* Ancestor levels searched for a configured SLO above a task's cgroup */
+#define DEFAULT_INHERIT_DEPTH 4
+#define MAX_INHERIT_DEPTH 16
+
 /* SLO configuration per cgroup */
 struct slo_cfg {
   u64 budget_ns;  /* Latency budget in nanoseconds */
@@ -36,9 +73,102 @@ struct slo_task_ctx {
   u64 start_time; /* When task started running (for miss detection) */
   u64 budget_ns;  /* Task's allocated budget */
   u32 valid;      /* Whether this context is initialized */
+  u32 slo_class;  /* Latency class of the task's cgroup */
+};
+
+/* Run statistics per configured cgroup (include/scx_slo.h) */
+struct slo_cgrp_stats {
+  u64 runs;        /* Runs ended */
+  u64 late;        /* Runs that ended past their deadline */
+  u64 lateness_ns; /* Time past the deadline, summed over late runs */
+  u64 slack_ns;    /* Time left before the deadline, over the other runs */
+  u64 runtime_ns;  /* CPU time of all runs */
+};
+
+/* Deadline an adjusted SLO map entry stands for (include/scx_slo.h) */
+struct slo_target {
+  struct slo_cfg cfg; /* Entry value the target applies to */
+  u64 window_ns;      /* Deadline window of the configured SLO */
+};
+
+/* Circuit breaker counters (include/scx_slo.h) */
+struct slo_health {
+  u64 runs;     /* Runs ended */
+  u64 late;     /* Runs that ended past their deadline */
+  u64 delay_ns; /* Queueing delay summed over delays */
+  u64 delays;
+};
+
+/* CPU performance targets, per CPU (include/scx_slo.h) */
+struct slo_cpu_perf {
+  u32 target; /* Target the CPU was last set to, 0 before the first */
+  u32 pad;
+  u64 sets;   /* Changes of the target */
+  u64 boosts; /* Runs sped up to full speed for lack of slack */
+  u64 capped; /* Runs of batch and best-effort tasks held to the cap */
+};
+
+/* Burst learning per task and its prediction counters (include/scx_slo.h) */
+struct slo_task_burst {
+  u64 burst_ns;    /* EWMA of on-CPU time per activation */
+  u64 interval_ns; /* EWMA of time from one activation to the next */
+  u64 act_start;   /* When the current activation first ran, 0 while asleep */
+  u64 last_start;  /* When the previous activation first ran */
+  u64 act_ns;      /* On-CPU time of the current activation so far */
+  u64 run_start;   /* When the current run started, 0 while off the CPU */
+  u32 samples;     /* Activations averaged, saturating */
+  u32 predicted;   /* Whether the current run was predicted to miss */
+};
+
+struct slo_burst_stats {
+  u64 runs;           /* Runs of tasks with a learned burst */
+  u64 late;           /* Of those, runs that missed their deadline */
+  u64 predicted;      /* Runs predicted to miss when they started */
+  u64 predicted_late; /* Predicted runs that did miss */
+  u64 boosted;        /* Enqueues moved ahead as short bursts */
+};
+
+/* Shadow mode histograms (include/scx_slo.h) */
+#define SLO_HIST_BUCKETS 26
+
+struct slo_hist {
+  u64 count;
+  u64 sum_ns;
+  u64 buckets[SLO_HIST_BUCKETS];
+};
+
+struct slo_shadow_stats {
+  struct slo_hist slack;    /* Time left before the deadline, runs that made it */
+  struct slo_hist lateness; /* Time past the deadline, runs that missed it */
+  struct slo_hist delay;    /* Time from wakeup or preemption to running */
+};
+
+/* Would-be scheduling state of a task observed in shadow mode */
+struct slo_shadow_task {
+  u64 enqueue_time; /* When the task became runnable */
+  u64 deadline;     /* Deadline simple_enqueue would have given it */
+  u64 start_time;   /* When it started running, 0 while it waits */
+  u32 slo_class;    /* Latency class of the task's cgroup */
+  u32 valid;        /* Whether this context is initialized */
 };
 
-/* Map: cgroup_id -> SLO configuration */
+/* Scheduler handoff state, shared between agent instances */
+struct slo_handoff {
+  u64 detach_ns;  /* When the previous scheduler instance exited */
+  u64 attach_ns;  /* When the current scheduler instance initialized */
+  u32 generation; /* Bumped by each agent taking ownership */
+  u32 handoffs;   /* Completed handoffs between instances */
+};
+
+/* Map layout: cgroup_id -> SLO configuration */
+struct slo_cfg_map {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(key_size, sizeof(u64));
+  __uint(value_size, sizeof(struct slo_cfg));
+  __uint(max_entries, MAX_CGROUPS);
+};
+
+/* Generation 0 of the SLO map, in effect until the agent publishes one */
 struct {
   __uint(type, BPF_MAP_TYPE_HASH);
   __uint(key_size, sizeof(u64));
@@ -47,6 +177,119 @@ struct {
   __uint(pinning, LIBBPF_PIN_BY_NAME);
 } slo_map SEC(".maps");
 
+/*
+ * The SLO map in effect. The agent fills a fresh slo_cfg_map for each
+ * config generation and swaps it in here, so lookups never see a
+ * half-applied config. Pinned so the active generation survives restarts.
+ */
+struct {
+  __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+  __uint(key_size, sizeof(u32));
+  __uint(max_entries, 1);
+  __uint(pinning, LIBBPF_PIN_BY_NAME);
+  __array(values, struct slo_cfg_map);
+} slo_maps SEC(".maps") = {
+    .values = {[0] = &slo_map},
+};
+
+/*
+ * Set to a new value by every SLO map writer after a change (the agent on
+ * each published generation, the watcher on each update). Cached
+ * resolutions stamped with an older value are redone.
+ */
+struct {
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(u64));
+  __uint(max_entries, 1);
+  __uint(pinning, LIBBPF_PIN_BY_NAME);
+} slo_gen SEC(".maps");
+
+/* SLO a cgroup resolved to through its ancestors */
+struct slo_cgrp_cache {
+  u64 gen;        /* slo_gen value the entry was resolved at */
+  struct slo_cfg cfg;
+  u32 resolved;   /* Whether gen and found are meaningful */
+  u32 found;      /* Whether a configured cgroup was within reach */
+  u64 slo_id;     /* Cgroup the SLO is configured on */
+  s64 target_off; /* Configured deadline minus the one cfg gives */
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_CGRP_STORAGE);
+  __uint(map_flags, BPF_F_NO_PREALLOC);
+  __type(key, int);
+  __type(value, struct slo_cgrp_cache);
+} slo_cgrp_cache SEC(".maps");
+
+/* Ancestor levels to search, set by the agent before load (0 = exact only) */
+const volatile u32 slo_inherit_depth = DEFAULT_INHERIT_DEPTH;
+
+/* SLO entries deleted because their cgroup was removed, read by the agent */
+u64 nr_cgroup_exit_deletes;
+
+/* Whether adaptive budgets may move deadlines off the configured ones, set before load */
+const volatile bool slo_adaptive = false;
+
+/* Whether to keep run statistics per SLO, for adaptive budgets and admission control */
+const volatile bool slo_run_stats = false;
+
+/* Whether only tasks the agent set to SCHED_EXT are ours, set before load */
+const volatile bool slo_partial = false;
+
+/*
+ * Partial mode: tasks queued here without an SLO, e.g. forked from a
+ * switched thread and then moved to an unconfigured cgroup. The agent
+ * drains the map and moves them back to the fair class. Value is the
+ * first time seen.
+ */
+struct {
+  __uint(type, BPF_MAP_TYPE_LRU_HASH);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(u64));
+  __uint(max_entries, MAX_STRAYS);
+} slo_strays SEC(".maps");
+
+/* Whether to keep health counters for the circuit breaker, set before load */
+const volatile bool slo_breaker = false;
+
+/* When each task was last enqueued, for queueing delay */
+struct {
+  __uint(type, BPF_MAP_TYPE_TASK_STORAGE);
+  __uint(map_flags, BPF_F_NO_PREALLOC);
+  __type(key, int);
+  __type(value, u64);
+} enqueue_ts SEC(".maps");
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(struct slo_health));
+  __uint(max_entries, 1);
+} health SEC(".maps");
+
+/*
+ * Run statistics per SLO map key, read by the agent every interval.
+ * Entries are created on first use and only ever counted up.
+ */
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(key_size, sizeof(u64));
+  __uint(value_size, sizeof(struct slo_cgrp_stats));
+  __uint(max_entries, MAX_CGROUPS);
+} slo_stats SEC(".maps");
+
+/*
+ * Configured deadlines of the entries the agent adjusted, so lateness is
+ * always counted against the SLO and not against the adjusted budget.
+ */
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(key_size, sizeof(u64));
+  __uint(value_size, sizeof(struct slo_target));
+  __uint(max_entries, MAX_CGROUPS);
+} slo_targets SEC(".maps");
+
 /* Map: task PID -> per-task scheduling context */
 struct {
   __uint(type, BPF_MAP_TYPE_HASH);
@@ -85,6 +328,40 @@ struct deadline_event {
 #define MIN_IMPORTANCE 1
 #define MAX_IMPORTANCE 100
 
+/* Latency classes in the low bits of slo_cfg.flags (include/scx_slo.h) */
+#define SLO_CLASS_STANDARD 0
+#define SLO_CLASS_CRITICAL 1
+#define SLO_CLASS_BATCH 2
+#define SLO_CLASS_BESTEFFORT 3
+#define NR_SLO_CLASSES 4
+#define SLO_CLASS_MASK 0xfU
+
+/* What a latency class changes about how its tasks are scheduled */
+struct slo_class_policy {
+  u64 slice_ns;     /* Time slice per dispatch */
+  bool preempt;     /* Kicks a preemptible task off its CPU when queued */
+  bool preemptible; /* May be kicked off its CPU by a preempting class */
+  bool idle_core;   /* Prefers a fully idle SMT core to its previous CPU */
+  bool reserved;    /* May run on CPUs set aside for latency-critical work */
+};
+
+/*
+ * Critical tasks run in short slices and take a CPU back from batch and
+ * best-effort work instead of waiting for its slice to end. Batch tasks
+ * run longer for throughput and stay on their previous CPU when it is
+ * idle, leaving whole idle cores to latency-sensitive wakeups.
+ */
+static const struct slo_class_policy class_policy[NR_SLO_CLASSES] = {
+    [SLO_CLASS_STANDARD] = {.slice_ns = SCX_SLICE_DFL, .idle_core = true},
+    [SLO_CLASS_CRITICAL] = {.slice_ns = SCX_SLICE_DFL / 4,
+                            .preempt = true,
+                            .idle_core = true,
+                            .reserved = true},
+    [SLO_CLASS_BATCH] = {.slice_ns = SCX_SLICE_DFL * 2, .preemptible = true},
+    [SLO_CLASS_BESTEFFORT] = {.slice_ns = SCX_SLICE_DFL / 2,
+                              .preemptible = true},
+};
+
 /* Rate limiting for ring buffer events */
 #define MAX_EVENTS_PER_SEC 1000
 #define RATE_LIMIT_WINDOW_NS (1 * NSEC_PER_SEC)
@@ -100,21 +377,115 @@ UEI_DEFINE(uei);
  */
 #define SHARED_DSQ 0
 #define LOCAL_DSQ_ID 1
+#define RESERVED_DSQ 2  /* Tasks allowed on reserved CPUs, while any are */
 
-/* Map sizing constants */
-#define MAX_CGROUPS 10000
-#define MAX_TASKS 100000
-#define RINGBUF_SIZE (1 << 20)   /* 1MB */
-#define STATS_MAP_ENTRIES 2      /* [local, global] */
-#define RATE_LIMIT_MAP_ENTRIES 2 /* [event_count, window_start] */
-
+/*
+ * Stats and handoff state are pinned so counters survive an agent upgrade
+ * and the next instance can measure how long no scheduler was attached.
+ */
 struct {
   __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
   __uint(key_size, sizeof(u32));
   __uint(value_size, sizeof(u64));
   __uint(max_entries, STATS_MAP_ENTRIES);
+  __uint(pinning, LIBBPF_PIN_BY_NAME);
 } stats SEC(".maps");
 
+struct {
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(struct slo_handoff));
+  __uint(max_entries, 1);
+  __uint(pinning, LIBBPF_PIN_BY_NAME);
+} handoff SEC(".maps");
+
+/*
+ * Reserved CPU partition, written by the agent: nonzero for each CPU kept
+ * for latency-critical work. nr_reserved_cpus is the number set, and 0
+ * turns the partition off.
+ */
+struct {
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(u32));
+  __uint(max_entries, MAX_CPUS);
+} reserved_cpus SEC(".maps");
+
+u32 nr_reserved_cpus;
+
+/* Importance from which a cgroup may use reserved CPUs, set before load */
+const volatile u32 slo_reserve_importance = MAX_IMPORTANCE + 1;
+
+/*
+ * CPU performance targets, set before load (include/scx_slo.h, out of
+ * SLO_CPUPERF_ONE). Off unless slo_cpuperf is set.
+ */
+#define SLO_CPUPERF_ONE 1024
+
+const volatile bool slo_cpuperf = false;
+const volatile u32 slo_perf_standard_min = SLO_CPUPERF_ONE / 2;
+const volatile u32 slo_perf_batch_max = SLO_CPUPERF_ONE * 3 / 8;
+const volatile u32 slo_perf_boost_slack = 50; /* Percent of the window */
+
+/* Set when the kernel has no scx_bpf_cpuperf_set(), read by the agent */
+bool cpuperf_unsupported;
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(struct slo_cpu_perf));
+  __uint(max_entries, 1);
+} cpu_perf SEC(".maps");
+
+/* Burst learning, set before load (src/burst.h) */
+const volatile bool slo_burst = false;
+const volatile u32 slo_burst_shift = 3; /* New samples weigh 1 / 2^shift */
+const volatile u32 slo_burst_min_samples = 4;
+const volatile u64 slo_burst_short_ns = 1 * NSEC_PER_MSEC;
+const volatile u32 slo_burst_boost = 50; /* Percent of the window */
+const volatile u32 slo_burst_slice_mult = 2;
+const volatile u64 slo_burst_slice_min_ns = 250 * 1000;
+
+struct {
+  __uint(type, BPF_MAP_TYPE_TASK_STORAGE);
+  __uint(map_flags, BPF_F_NO_PREALLOC);
+  __type(key, int);
+  __type(value, struct slo_task_burst);
+} task_burst SEC(".maps");
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(struct slo_burst_stats));
+  __uint(max_entries, 1);
+} burst_stats SEC(".maps");
+
+/* Whether the task running on each CPU may be preempted by its class */
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(u32));
+  __uint(max_entries, 1);
+} cpu_preemptible SEC(".maps");
+
+/*
+ * Shadow mode state. Only the tracepoint programs use these; the agent
+ * loads either them or the scheduler, never both.
+ */
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(struct slo_shadow_task));
+  __uint(max_entries, MAX_TASKS);
+} shadow_task_ctx SEC(".maps");
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(key_size, sizeof(u32));
+  __uint(value_size, sizeof(struct slo_shadow_stats));
+  __uint(max_entries, NR_SLO_CLASSES);
+} shadow_stats SEC(".maps");
+
 static void stat_inc(u32 idx) {
   u64 *cnt_p = bpf_map_lookup_elem(&stats, &idx);
   if (cnt_p)
@@ -139,9 +510,117 @@ static inline int validate_slo_cfg(struct slo_cfg *cfg) {
   return 0;
 }
 
+/*
+ * Find the SLO of @cgrp or of its nearest ancestor within slo_inherit_depth
+ * levels. Kubernetes configs name pod slices, while threads run in the
+ * container cgroups below them. @slo_id is set to the cgroup found.
+ */
+static bool resolve_slo_cfg(struct cgroup *cgrp, struct slo_cfg *out,
+                            u64 *slo_id) {
+  u32 zero = 0;
+  void *cfgs = bpf_map_lookup_elem(&slo_maps, &zero);
+  int level = cgrp->level;
+
+  if (!cfgs)
+    return false;
+
+  for (int i = 0; i <= MAX_INHERIT_DEPTH; i++) {
+    struct cgroup *anc;
+    struct slo_cfg *cfg;
+    u64 id;
+
+    if (i > slo_inherit_depth || level - i < 0)
+      break;
+
+    anc = bpf_cgroup_ancestor(cgrp, level - i);
+    if (!anc)
+      break;
+    id = anc->kn->id;
+    bpf_cgroup_release(anc);
+
+    cfg = bpf_map_lookup_elem(cfgs, &id);
+    if (cfg) {
+      *out = *cfg;
+      *slo_id = id;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Deadline window @cfg gives a task, as computed in enqueue */
+static inline u64 deadline_window(const struct slo_cfg *cfg) {
+  u32 importance = cfg->importance;
+
+  if (importance < MIN_IMPORTANCE)
+    importance = MIN_IMPORTANCE;
+  if (importance > MAX_IMPORTANCE)
+    importance = MAX_IMPORTANCE;
+  return cfg->budget_ns * (101 - importance) / 100;
+}
+
+/*
+ * How much later than @cfg's deadline the configured SLO of @slo_id ends.
+ * The target only counts while the entry still holds the value it was
+ * written for.
+ */
+static s64 target_offset(u64 slo_id, const struct slo_cfg *cfg) {
+  struct slo_target *t;
+
+  if (!slo_adaptive)
+    return 0;
+  t = bpf_map_lookup_elem(&slo_targets, &slo_id);
+  if (!t || t->cfg.budget_ns != cfg->budget_ns ||
+      t->cfg.importance != cfg->importance || t->cfg.flags != cfg->flags)
+    return 0;
+  return (s64)t->window_ns - (s64)deadline_window(cfg);
+}
+
+/*
+ * Look up the SLO for @cgrp. The ancestor walk runs once per cgroup and
+ * config change; after that it costs one cgroup storage lookup.
+ */
+static bool lookup_cgrp_slo(struct cgroup *cgrp, struct slo_cfg *cfg) {
+  u32 zero = 0;
+  u64 *genp = bpf_map_lookup_elem(&slo_gen, &zero);
+  u64 gen = genp ? *genp : 0;
+  struct slo_cgrp_cache *cache;
+  bool found;
+
+  cache = bpf_cgrp_storage_get(&slo_cgrp_cache, cgrp, 0,
+                               BPF_LOCAL_STORAGE_GET_F_CREATE);
+  if (cache && cache->resolved && cache->gen == gen) {
+    found = cache->found;
+    if (found)
+      *cfg = cache->cfg;
+  } else {
+    u64 slo_id = 0;
+
+    found = resolve_slo_cfg(cgrp, cfg, &slo_id);
+    if (cache) {
+      if (found) {
+        cache->cfg = *cfg;
+        cache->slo_id = slo_id;
+        cache->target_off = target_offset(slo_id, cfg);
+      }
+      cache->found = found;
+      cache->gen = gen;
+      cache->resolved = 1;
+    }
+  }
+  return found;
+}
+
+static bool lookup_slo_cfg(struct task_struct *p, struct slo_cfg *cfg) {
+  struct cgroup *cgrp = scx_bpf_task_cgroup(p);
+  bool found = lookup_cgrp_slo(cgrp, cfg);
+
+  bpf_cgroup_release(cgrp);
+  return found;
+}
+
 /* Validate and get safe budget value */
-static inline u64 get_safe_budget(u64 cgroup_id) {
-  struct slo_cfg *cfg = bpf_map_lookup_elem(&slo_map, &cgroup_id);
+static inline u64 get_safe_budget(struct slo_cfg *cfg) {
   if (!cfg)
     return DEFAULT_BUDGET_NS;
 
@@ -152,6 +631,279 @@ static inline u64 get_safe_budget(u64 cgroup_id) {
   return cfg->budget_ns;
 }
 
+/*
+ * Deadline of a task queued at @now under @cfg, or under the default SLO
+ * if @cfg is NULL, with weighted importance and overflow protection.
+ * Higher importance (1-100) results in a shorter virtual budget, giving
+ * the task an earlier deadline in the EDF queue.
+ *
+ * Formula: effective_budget = budget_ns * (101 - importance) / 100
+ */
+static inline u64 slo_deadline(struct slo_cfg *cfg, u64 now) {
+  u64 budget_ns = get_safe_budget(cfg);
+  u32 importance = cfg ? cfg->importance : 50;
+
+  if (importance < 1)
+    importance = 1;
+  if (importance > 100)
+    importance = 100;
+
+  u64 scaling_factor = 101 - importance;
+  u64 effective_budget = (budget_ns * scaling_factor) / 100;
+
+  /* Saturate at the maximum instead of overflowing */
+  if (effective_budget > U64_MAX - now)
+    return U64_MAX;
+  return now + effective_budget;
+}
+
+/* Latency class of @cfg; unknown classes are treated as standard */
+static inline u32 get_slo_class(struct slo_cfg *cfg) {
+  u32 cls;
+
+  if (!cfg)
+    return SLO_CLASS_STANDARD;
+  cls = cfg->flags & SLO_CLASS_MASK;
+  return cls < NR_SLO_CLASSES ? cls : SLO_CLASS_STANDARD;
+}
+
+static inline const struct slo_class_policy *get_class_policy(u32 cls) {
+  if (cls >= NR_SLO_CLASSES)
+    cls = SLO_CLASS_STANDARD;
+  return &class_policy[cls];
+}
+
+static bool cpu_reserved(s32 cpu) {
+  u32 key = cpu, *reserved;
+
+  if (!nr_reserved_cpus)
+    return false;
+  reserved = bpf_map_lookup_elem(&reserved_cpus, &key);
+  return reserved && *reserved;
+}
+
+/* Whether a task with @cfg may run on reserved CPUs */
+static bool may_reserve(const struct slo_cfg *cfg,
+                        const struct slo_class_policy *policy) {
+  return cfg && (policy->reserved || cfg->importance >= slo_reserve_importance);
+}
+
+/*
+ * Kick @cpu if the task running there may be preempted, so it goes back
+ * to the shared DSQ for a task that was just queued ahead of it.
+ */
+static void preempt_cpu(s32 cpu) {
+  u32 zero = 0;
+  u32 *preemptible = bpf_map_lookup_percpu_elem(&cpu_preemptible, &zero, cpu);
+
+  if (preemptible && *preemptible)
+    scx_bpf_kick_cpu(cpu, SCX_KICK_PREEMPT);
+}
+
+/*
+ * Performance target for a task of class @cls under @cfg (NULL for the
+ * default SLO) that starts running at @now, @deadline being its deadline
+ * or 0 if it has none. Mirrored by cpuperf_target() in cpuperf.c.
+ */
+static u32 cpuperf_target(const struct slo_cfg *cfg, u32 cls, u64 deadline,
+                          u64 now, bool *boost) {
+  u32 importance = cfg ? cfg->importance : 50;
+  u64 window, slack;
+
+  *boost = false;
+  if (cls == SLO_CLASS_BATCH || cls == SLO_CLASS_BESTEFFORT)
+    return slo_perf_batch_max;
+  if (cls == SLO_CLASS_CRITICAL)
+    return SLO_CPUPERF_ONE;
+
+  window = cfg ? deadline_window(cfg) : DEFAULT_BUDGET_NS * (101 - 50) / 100;
+  slack = !deadline ? window : deadline > now ? deadline - now : 0;
+  if (slack > window)
+    slack = window;
+  if (slack * 100 < window * slo_perf_boost_slack) {
+    *boost = true;
+    return SLO_CPUPERF_ONE;
+  }
+
+  if (importance < MIN_IMPORTANCE)
+    importance = MIN_IMPORTANCE;
+  if (importance > MAX_IMPORTANCE)
+    importance = MAX_IMPORTANCE;
+  return slo_perf_standard_min +
+         (SLO_CPUPERF_ONE - slo_perf_standard_min) * importance / MAX_IMPORTANCE;
+}
+
+/*
+ * Set the performance target of this CPU for @p, which starts running
+ * now. The kfunc is only called when the target changes.
+ */
+static void set_cpuperf(struct task_struct *p, struct slo_task_ctx *ctx,
+                        u64 now) {
+  struct slo_cpu_perf *perf;
+  struct slo_cfg slo;
+  struct slo_cfg *cfg;
+  u32 zero = 0, cls, target;
+  bool boost;
+
+  if (!bpf_ksym_exists(scx_bpf_cpuperf_set)) {
+    cpuperf_unsupported = true;
+    return;
+  }
+  perf = bpf_map_lookup_elem(&cpu_perf, &zero);
+  if (!perf)
+    return;
+
+  /* A task without context has no deadline to judge its slack by */
+  cfg = lookup_slo_cfg(p, &slo) ? &slo : NULL;
+  if (ctx && ctx->valid) {
+    cls = ctx->slo_class;
+    target = cpuperf_target(cfg, cls, ctx->deadline, now, &boost);
+  } else {
+    cls = get_slo_class(cfg);
+    target = cpuperf_target(cfg, cls, 0, now, &boost);
+  }
+
+  if (boost)
+    perf->boosts++;
+  else if (cls == SLO_CLASS_BATCH || cls == SLO_CLASS_BESTEFFORT)
+    perf->capped++;
+  if (target == perf->target)
+    return;
+  scx_bpf_cpuperf_set(bpf_get_smp_processor_id(), target);
+  perf->target = target;
+  perf->sets++;
+}
+
+/*
+ * Burst learning. These mirror burst.c, which documents the policy and
+ * is what the tests and the trace-driven benchmark run.
+ */
+static struct slo_task_burst *get_burst(struct task_struct *p, bool create) {
+  if (!slo_burst)
+    return NULL;
+  return bpf_task_storage_get(&task_burst, p, 0,
+                              create ? BPF_LOCAL_STORAGE_GET_F_CREATE : 0);
+}
+
+static inline bool burst_learned(const struct slo_task_burst *b) {
+  return b && b->samples >= slo_burst_min_samples;
+}
+
+static inline bool burst_short(const struct slo_task_burst *b) {
+  return burst_learned(b) && b->burst_ns < slo_burst_short_ns &&
+         b->interval_ns >= 2 * b->burst_ns;
+}
+
+/* Slice of @p: its class slice until its burst is known */
+static u64 task_slice(struct task_struct *p,
+                      const struct slo_class_policy *policy) {
+  struct slo_task_burst *b = get_burst(p, false);
+  u64 slice;
+
+  if (!burst_learned(b))
+    return policy->slice_ns;
+  slice = b->burst_ns * slo_burst_slice_mult;
+  if (slice < slo_burst_slice_min_ns)
+    slice = slo_burst_slice_min_ns;
+  return slice < policy->slice_ns ? slice : policy->slice_ns;
+}
+
+/*
+ * Queue position of @p, queued at @now with @deadline: moved ahead by
+ * part of its window for short bursts. Misses are still judged against
+ * @deadline.
+ */
+static u64 task_vtime(struct task_struct *p, u64 deadline, u64 now) {
+  struct slo_task_burst *b = get_burst(p, false);
+  struct slo_burst_stats *st;
+  u64 window, ahead;
+  u32 zero = 0;
+
+  if (!burst_short(b))
+    return deadline;
+  window = deadline > now ? deadline - now : 0;
+  if (window > MAX_BUDGET_NS)
+    window = MAX_BUDGET_NS;
+  ahead = window * slo_burst_boost / 100;
+
+  st = bpf_map_lookup_elem(&burst_stats, &zero);
+  if (st)
+    st->boosted++;
+  return deadline > ahead ? deadline - ahead : 0;
+}
+
+/* @avg moved 1 / 2^shift of the way to @sample; the first sample as is */
+static inline u64 burst_ewma(u64 avg, u64 sample) {
+  if (!avg)
+    return sample;
+  return avg - (avg >> slo_burst_shift) + (sample >> slo_burst_shift);
+}
+
+/*
+ * @p starts running at @now. A run is predicted to miss if the rest of
+ * the expected burst exceeds the slack left to its deadline. Only
+ * burst_stats uses the prediction; the slice and queue position do not.
+ */
+static void burst_running(struct task_struct *p, struct slo_task_ctx *ctx,
+                          u64 now) {
+  struct slo_task_burst *b = get_burst(p, true);
+  u64 slack;
+
+  if (!b)
+    return;
+  if (!b->act_start)
+    b->act_start = now;
+  b->run_start = now;
+
+  b->predicted = 0;
+  if (!ctx || !ctx->valid || !burst_learned(b) || b->burst_ns <= b->act_ns)
+    return;
+  slack = ctx->deadline > now ? ctx->deadline - now : 0;
+  b->predicted = b->burst_ns - b->act_ns > slack;
+}
+
+/*
+ * @p stops running at @now. Judge the prediction, and unless @runnable
+ * close the activation and add it to the averages.
+ */
+static void burst_stopping(struct task_struct *p, struct slo_task_ctx *ctx,
+                           bool runnable, u64 now) {
+  struct slo_task_burst *b = get_burst(p, false);
+  struct slo_burst_stats *st;
+  u32 zero = 0;
+
+  if (!b)
+    return;
+
+  st = bpf_map_lookup_elem(&burst_stats, &zero);
+  if (st && ctx && ctx->valid && burst_learned(b)) {
+    bool late = now > ctx->deadline;
+
+    st->runs++;
+    st->late += late;
+    if (b->predicted) {
+      st->predicted++;
+      st->predicted_late += late;
+    }
+  }
+  b->predicted = 0;
+
+  if (b->run_start && now > b->run_start)
+    b->act_ns += now - b->run_start;
+  b->run_start = 0;
+  if (runnable || !b->act_start)
+    return;
+
+  b->burst_ns = burst_ewma(b->burst_ns, b->act_ns);
+  if (b->last_start && b->act_start > b->last_start)
+    b->interval_ns = burst_ewma(b->interval_ns, b->act_start - b->last_start);
+  if (b->samples < ~0U)
+    b->samples++;
+  b->last_start = b->act_start;
+  b->act_start = 0;
+  b->act_ns = 0;
+}
+
 /* Rate limit ring buffer events to prevent spam attacks */
 static inline bool is_rate_limited(void) {
   u64 now = bpf_ktime_get_ns();
@@ -186,7 +938,8 @@ static struct slo_task_ctx *get_task_ctx(u32 pid) {
 
   /* Create new context */
   struct slo_task_ctx new_ctx = {
-      .deadline = 0, .start_time = 0, .budget_ns = 0, .valid = 0};
+      .deadline = 0, .start_time = 0, .budget_ns = 0, .valid = 0,
+      .slo_class = SLO_CLASS_STANDARD};
 
   if (bpf_map_update_elem(&task_ctx_map, &pid, &new_ctx, BPF_ANY) == 0)
     return bpf_map_lookup_elem(&task_ctx_map, &pid);
@@ -196,13 +949,39 @@ static struct slo_task_ctx *get_task_ctx(u32 pid) {
 
 s32 BPF_STRUCT_OPS(simple_select_cpu, struct task_struct *p, s32 prev_cpu,
                    u64 wake_flags) {
+  const struct slo_class_policy *policy;
   bool is_idle = false;
+  struct slo_cfg slo;
+  struct slo_cfg *cfg = lookup_slo_cfg(p, &slo) ? &slo : NULL;
   s32 cpu;
 
-  cpu = scx_bpf_select_cpu_dfl(p, prev_cpu, wake_flags, &is_idle);
+  policy = get_class_policy(get_slo_class(cfg));
+
+  /* Without an idle-core preference, an idle previous CPU is good enough */
+  if (!policy->idle_core && scx_bpf_test_and_clear_cpu_idle(prev_cpu)) {
+    cpu = prev_cpu;
+    is_idle = true;
+  } else {
+    cpu = scx_bpf_select_cpu_dfl(p, prev_cpu, wake_flags, &is_idle);
+  }
+
+  /*
+   * Keep other tasks off an idle reserved CPU. Its idle state was claimed
+   * for this task; the kick lets it go idle again. Without another idle
+   * CPU the task waits in the shared DSQ, as on a busy node.
+   */
+  if (is_idle && cpu_reserved(cpu) && !may_reserve(cfg, policy)) {
+    s32 reserved = cpu;
+
+    cpu = prev_cpu;
+    is_idle = cpu != reserved && !cpu_reserved(cpu) &&
+              scx_bpf_test_and_clear_cpu_idle(cpu);
+    scx_bpf_kick_cpu(reserved, SCX_KICK_IDLE);
+  }
+
   if (is_idle) {
     stat_inc(0); /* count local queueing */
-    scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL, SCX_SLICE_DFL, 0);
+    scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL, task_slice(p, policy), 0);
   }
 
   return cpu;
@@ -212,66 +991,171 @@ void BPF_STRUCT_OPS(simple_enqueue, struct task_struct *p, u64 enq_flags) {
   stat_inc(1); /* count global queueing */
 
   u32 pid = p->pid;
-  u64 cg_id = bpf_get_current_cgroup_id();
   u64 now = bpf_ktime_get_ns();
 
+  /* Budget, importance and class come from one lookup, cached per cgroup */
+  struct slo_cfg slo;
+  struct slo_cfg *cfg = lookup_slo_cfg(p, &slo) ? &slo : NULL;
+
+  if (slo_partial && !cfg)
+    bpf_map_update_elem(&slo_strays, &pid, &now, BPF_NOEXIST);
+
+  if (slo_breaker) {
+    u64 *ts = bpf_task_storage_get(&enqueue_ts, p, 0,
+                                   BPF_LOCAL_STORAGE_GET_F_CREATE);
+    if (ts)
+      *ts = now;
+  }
+
   /* Get validated budget for this cgroup */
-  u64 budget_ns = get_safe_budget(cg_id);
+  u64 budget_ns = get_safe_budget(cfg);
+  u32 slo_class = get_slo_class(cfg);
+  const struct slo_class_policy *policy = get_class_policy(slo_class);
+  u64 dsq = nr_reserved_cpus && may_reserve(cfg, policy) ? RESERVED_DSQ
+                                                         : SHARED_DSQ;
+  u64 slice = task_slice(p, policy);
+
+  u64 deadline = slo_deadline(cfg, now);
 
   /* Get or create task context */
   struct slo_task_ctx *ctx = get_task_ctx(pid);
   if (!ctx) {
-    /* Fallback: use default scheduling without context */
-    scx_bpf_dsq_insert(p, SHARED_DSQ, SCX_SLICE_DFL, enq_flags);
+    /*
+     * Fallback: queue by deadline without tracking it. Both DSQs are
+     * priority queues; a FIFO insert into either is a scheduler error.
+     */
+    scx_bpf_dsq_insert_vtime(p, dsq, slice, deadline, enq_flags);
     return;
   }
 
-  /*
-   * Calculate deadline with weighted importance and overflow protection.
-   * Higher importance (1-100) results in a shorter virtual budget,
-   * giving the task an earlier deadline in the EDF queue.
-   *
-   * Formula: effective_budget = budget_ns * (101 - importance) / 100
-   */
-  struct slo_cfg *cfg = bpf_map_lookup_elem(&slo_map, &cg_id);
-  u32 importance = cfg ? cfg->importance : 50;
-  if (importance < 1)
-    importance = 1;
-  if (importance > 100)
-    importance = 100;
-
-  u64 scaling_factor = 101 - importance;
-  u64 effective_budget = (budget_ns * scaling_factor) / 100;
-
-  u64 deadline;
-  if (effective_budget > U64_MAX - now) {
-    /* Overflow would occur, saturate at maximum */
-    deadline = U64_MAX;
-  } else {
-    deadline = now + effective_budget;
-  }
-
   /* Store context properly instead of abusing dsq_vtime */
   ctx->deadline = deadline;
   ctx->budget_ns = budget_ns;
   ctx->start_time = 0; /* Will be set when task starts running */
+  ctx->slo_class = slo_class;
   ctx->valid = 1;
 
   /* Insert task with deadline as vtime for earliest-deadline-first */
-  scx_bpf_dsq_insert_vtime(p, SHARED_DSQ, SCX_SLICE_DFL, deadline, enq_flags);
+  scx_bpf_dsq_insert_vtime(p, dsq, slice, task_vtime(p, deadline, now),
+                           enq_flags);
+
+  /* Don't leave a critical task waiting behind batch work on its CPU */
+  if (policy->preempt)
+    preempt_cpu(scx_bpf_task_cpu(p));
 }
 
+/*
+ * Tasks allowed on reserved CPUs go first everywhere, and are all that
+ * reserved CPUs run. The reserved DSQ is drained even once the partition
+ * is gone, so nothing is left behind in it.
+ */
 void BPF_STRUCT_OPS(simple_dispatch, s32 cpu, struct task_struct *prev) {
-  scx_bpf_dsq_move_to_local(SHARED_DSQ);
+  if (scx_bpf_dsq_move_to_local(RESERVED_DSQ))
+    return;
+  if (!cpu_reserved(cpu))
+    scx_bpf_dsq_move_to_local(SHARED_DSQ);
 }
 
 void BPF_STRUCT_OPS(simple_running, struct task_struct *p) {
-  u32 pid = p->pid;
+  u32 pid = p->pid, zero = 0;
   struct slo_task_ctx *ctx = get_task_ctx(pid);
+  u32 *preemptible = bpf_map_lookup_elem(&cpu_preemptible, &zero);
+  u32 slo_class = SLO_CLASS_STANDARD;
+  u64 now = bpf_ktime_get_ns();
 
   if (ctx && ctx->valid) {
     /* Record when task actually started running */
-    ctx->start_time = bpf_ktime_get_ns();
+    ctx->start_time = now;
+    slo_class = ctx->slo_class;
+  }
+  if (preemptible)
+    *preemptible = get_class_policy(slo_class)->preemptible;
+
+  if (slo_cpuperf)
+    set_cpuperf(p, ctx, now);
+  if (slo_burst)
+    burst_running(p, ctx, now);
+
+  if (slo_breaker) {
+    u64 *ts = bpf_task_storage_get(&enqueue_ts, p, 0, 0);
+    struct slo_health *h = bpf_map_lookup_elem(&health, &zero);
+
+    /* Once per enqueue; a task resumed without one is not counted */
+    if (ts && *ts && h && now > *ts) {
+      h->delay_ns += now - *ts;
+      h->delays++;
+      *ts = 0;
+    }
+  }
+}
+
+/*
+ * Count a run of a task in @cgrp that started at @start_time and ends at
+ * @now against the SLO the cgroup resolved to. The cached resolution is
+ * used as is; a stale one at worst counts a run right after a config
+ * change against the previous SLO.
+ */
+static void record_cgrp_run(struct cgroup *cgrp, u64 deadline, u64 start_time,
+                            u64 now) {
+  struct slo_cgrp_stats *st;
+  struct slo_cgrp_cache *cache;
+  u64 slo_id;
+  s64 off;
+
+  cache = bpf_cgrp_storage_get(&slo_cgrp_cache, cgrp, 0, 0);
+  if (!cache || !cache->resolved || !cache->found)
+    return;
+  slo_id = cache->slo_id;
+  off = cache->target_off;
+
+  /* Saturate like the deadline itself */
+  if (off > 0)
+    deadline = deadline > U64_MAX - off ? U64_MAX : deadline + off;
+  else if (off < 0)
+    deadline = deadline < (u64)-off ? 0 : deadline + off;
+
+  st = bpf_map_lookup_elem(&slo_stats, &slo_id);
+  if (!st) {
+    struct slo_cgrp_stats zero = {};
+
+    bpf_map_update_elem(&slo_stats, &slo_id, &zero, BPF_NOEXIST);
+    st = bpf_map_lookup_elem(&slo_stats, &slo_id);
+    if (!st)
+      return;
+  }
+
+  __sync_fetch_and_add(&st->runs, 1);
+  if (now > deadline) {
+    __sync_fetch_and_add(&st->late, 1);
+    __sync_fetch_and_add(&st->lateness_ns, now - deadline);
+  } else {
+    __sync_fetch_and_add(&st->slack_ns, deadline - now);
+  }
+  if (start_time && now > start_time)
+    __sync_fetch_and_add(&st->runtime_ns, now - start_time);
+}
+
+static void record_run(struct task_struct *p, struct slo_task_ctx *ctx,
+                       u64 now) {
+  struct cgroup *cgrp = scx_bpf_task_cgroup(p);
+
+  record_cgrp_run(cgrp, ctx->deadline, ctx->start_time, now);
+  bpf_cgroup_release(cgrp);
+}
+
+/* Report a deadline miss of @miss_ns by a task of @cg_id, rate limited */
+static void report_miss(u64 cg_id, u64 miss_ns, u64 now) {
+  struct deadline_event *event;
+
+  if (is_rate_limited())
+    return;
+
+  event = bpf_ringbuf_reserve(&deadline_events, sizeof(*event), 0);
+  if (event) {
+    event->cgroup_id = cg_id;
+    event->deadline_miss_ns = miss_ns;
+    event->timestamp = now;
+    bpf_ringbuf_submit(event, 0);
   }
 }
 
@@ -280,28 +1164,31 @@ void BPF_STRUCT_OPS(simple_stopping, struct task_struct *p, bool runnable) {
   u64 now = bpf_ktime_get_ns();
   struct slo_task_ctx *ctx = bpf_map_lookup_elem(&task_ctx_map, &pid);
 
+  if (slo_burst)
+    burst_stopping(p, ctx, runnable, now);
+
   if (!ctx || !ctx->valid)
     return;
 
-  /* CORRECT deadline miss detection: check if current time > original deadline
-   */
-  if (now > ctx->deadline) {
-    u64 cg_id = bpf_get_current_cgroup_id();
-    u64 miss_duration = now - ctx->deadline;
-
-    /* Report deadline miss with rate limiting to prevent spam */
-    if (!is_rate_limited()) {
-      struct deadline_event *event;
-      event = bpf_ringbuf_reserve(&deadline_events, sizeof(*event), 0);
-      if (event) {
-        event->cgroup_id = cg_id;
-        event->deadline_miss_ns = miss_duration;
-        event->timestamp = now;
-        bpf_ringbuf_submit(event, 0);
-      }
+  if (slo_run_stats)
+    record_run(p, ctx, now);
+
+  if (slo_breaker) {
+    u32 zero = 0;
+    struct slo_health *h = bpf_map_lookup_elem(&health, &zero);
+
+    if (h) {
+      h->runs++;
+      if (now > ctx->deadline)
+        h->late++;
     }
   }
 
+  /* CORRECT deadline miss detection: check if current time > original deadline
+   */
+  if (now > ctx->deadline)
+    report_miss(bpf_get_current_cgroup_id(), now - ctx->deadline, now);
+
   /* Clean up task context when task stops */
   if (!runnable) {
     bpf_map_delete_elem(&task_ctx_map, &pid);
@@ -316,11 +1203,54 @@ void BPF_STRUCT_OPS(simple_enable, struct task_struct *p) {
   /* Context will be properly initialized in enqueue */
 }
 
+/*
+ * Drop the SLO of a removed cgroup so churn does not fill the map with
+ * dead IDs. cgroup_exit also runs for every cgroup when the scheduler is
+ * detached; only cgroups being destroyed are dropped, so the config
+ * survives restarts and handoffs. Removal clears CSS_ONLINE on the
+ * cgroup's own css (CSS_DYING is only set on its subsystem csses).
+ */
+void BPF_STRUCT_OPS(simple_cgroup_exit, struct cgroup *cgrp) {
+  u32 zero = 0;
+  void *cfgs;
+  u64 id;
+
+  if (cgrp->self.flags & CSS_ONLINE)
+    return;
+
+  cfgs = bpf_map_lookup_elem(&slo_maps, &zero);
+  if (!cfgs)
+    return;
+
+  id = cgrp->kn->id;
+  if (bpf_map_delete_elem(cfgs, &id) == 0)
+    __sync_fetch_and_add(&nr_cgroup_exit_deletes, 1);
+  bpf_map_delete_elem(&slo_stats, &id);
+  bpf_map_delete_elem(&slo_targets, &id);
+}
+
 s32 BPF_STRUCT_OPS_SLEEPABLE(simple_init) {
-  return scx_bpf_create_dsq(SHARED_DSQ, -1);
+  u32 zero = 0;
+  s32 ret;
+  struct slo_handoff *h = bpf_map_lookup_elem(&handoff, &zero);
+
+  if (h)
+    h->attach_ns = bpf_ktime_get_ns();
+
+  ret = scx_bpf_create_dsq(SHARED_DSQ, -1);
+  if (ret)
+    return ret;
+  return scx_bpf_create_dsq(RESERVED_DSQ, -1);
 }
 
 void BPF_STRUCT_OPS(simple_exit, struct scx_exit_info *ei) {
+  u32 zero = 0;
+  struct slo_handoff *h = bpf_map_lookup_elem(&handoff, &zero);
+
+  /* Tasks fall back to the fair class from here until the next init */
+  if (h)
+    h->detach_ns = bpf_ktime_get_ns();
+
   UEI_RECORD(uei, ei);
 }
 
@@ -329,5 +1259,174 @@ SCX_OPS_DEFINE(slo_ops, .select_cpu = (void *)simple_select_cpu,
                .dispatch = (void *)simple_dispatch,
                .running = (void *)simple_running,
                .stopping = (void *)simple_stopping,
-               .enable = (void *)simple_enable, .init = (void *)simple_init,
+               .enable = (void *)simple_enable,
+               .cgroup_exit = (void *)simple_cgroup_exit,
+               .init = (void *)simple_init,
                .exit = (void *)simple_exit, .name = "scx_slo");
+
+/*
+ * Shadow mode
+ *
+ * Loaded by the agent instead of the scheduler, on kernels with or without
+ * sched_ext. Tasks keep running under the kernel's own scheduler; these
+ * programs follow them through the scheduler tracepoints and give each run
+ * the deadline simple_enqueue would have, from the same SLO map. Would-be
+ * misses go to the ring buffer like real ones, and slack, lateness and
+ * queueing delay are kept in histograms per latency class.
+ */
+
+/* Policies sched_ext takes over; RT and deadline tasks are left out */
+#ifndef SCHED_NORMAL
+#define SCHED_NORMAL 0
+#endif
+#ifndef SCHED_BATCH
+#define SCHED_BATCH 3
+#endif
+#ifndef SCHED_IDLE
+#define SCHED_IDLE 5
+#endif
+
+static inline bool shadow_observed(struct task_struct *p) {
+  u32 policy = p->policy;
+
+  return p->pid && (policy == SCHED_NORMAL || policy == SCHED_BATCH ||
+                    policy == SCHED_IDLE);
+}
+
+/* Histogram bucket of @ns, log2 of microseconds (include/scx_slo.h) */
+static inline u32 hist_bucket(u64 ns) {
+  u64 us = ns / 1000;
+  u32 b = 1;
+
+  if (!us)
+    return 0;
+  if (us >> 32) {
+    us >>= 32;
+    b += 32;
+  }
+  if (us >> 16) {
+    us >>= 16;
+    b += 16;
+  }
+  if (us >> 8) {
+    us >>= 8;
+    b += 8;
+  }
+  if (us >> 4) {
+    us >>= 4;
+    b += 4;
+  }
+  if (us >> 2) {
+    us >>= 2;
+    b += 2;
+  }
+  if (us >> 1)
+    b += 1;
+  return b < SLO_HIST_BUCKETS ? b : SLO_HIST_BUCKETS - 1;
+}
+
+/* Per-CPU histograms, so no atomics */
+static inline void hist_add(struct slo_hist *h, u64 ns) {
+  h->count++;
+  h->sum_ns += ns;
+  h->buckets[hist_bucket(ns)]++;
+}
+
+/*
+ * Queue @p at @now as simple_enqueue would. Wakeups use BPF_NOEXIST: a
+ * task woken while still queued or running keeps its deadline, just as it
+ * would not be enqueued again under sched_ext.
+ */
+static void shadow_enqueue(struct task_struct *p, u64 now, u64 flags) {
+  struct slo_shadow_task t = {.enqueue_time = now, .valid = 1};
+  struct cgroup *cgrp = p->cgroups->dfl_cgrp;
+  struct slo_cfg slo;
+  struct slo_cfg *cfg = NULL;
+  u32 pid = p->pid;
+
+  if (cgrp && lookup_cgrp_slo(cgrp, &slo))
+    cfg = &slo;
+  t.deadline = slo_deadline(cfg, now);
+  t.slo_class = get_slo_class(cfg);
+  bpf_map_update_elem(&shadow_task_ctx, &pid, &t, flags);
+}
+
+/* @p stops running at @now: judge the run like simple_stopping */
+static void shadow_stop(struct task_struct *p, u64 now) {
+  u32 pid = p->pid;
+  struct slo_shadow_task *t = bpf_map_lookup_elem(&shadow_task_ctx, &pid);
+  struct slo_shadow_stats *hs;
+  struct cgroup *cgrp;
+  u32 cls;
+
+  if (!t || !t->valid || !t->start_time)
+    return;
+
+  cls = t->slo_class;
+  hs = bpf_map_lookup_elem(&shadow_stats, &cls);
+  if (now > t->deadline) {
+    if (hs)
+      hist_add(&hs->lateness, now - t->deadline);
+    /* sched_switch runs on the outgoing task */
+    report_miss(bpf_get_current_cgroup_id(), now - t->deadline, now);
+  } else if (hs) {
+    hist_add(&hs->slack, t->deadline - now);
+  }
+
+  cgrp = p->cgroups->dfl_cgrp;
+  if (slo_run_stats && cgrp)
+    record_cgrp_run(cgrp, t->deadline, t->start_time, now);
+}
+
+/* @p starts running at @now after waiting since its enqueue */
+static void shadow_start(struct task_struct *p, u64 now) {
+  u32 pid = p->pid;
+  struct slo_shadow_task *t = bpf_map_lookup_elem(&shadow_task_ctx, &pid);
+  struct slo_shadow_stats *hs;
+  u32 cls;
+
+  if (!t || !t->valid || t->start_time)
+    return;
+
+  t->start_time = now;
+  cls = t->slo_class;
+  hs = bpf_map_lookup_elem(&shadow_stats, &cls);
+  if (hs && now > t->enqueue_time)
+    hist_add(&hs->delay, now - t->enqueue_time);
+}
+
+SEC("tp_btf/sched_wakeup")
+int BPF_PROG(shadow_wakeup, struct task_struct *p) {
+  if (shadow_observed(p))
+    shadow_enqueue(p, bpf_ktime_get_ns(), BPF_NOEXIST);
+  return 0;
+}
+
+SEC("tp_btf/sched_wakeup_new")
+int BPF_PROG(shadow_wakeup_new, struct task_struct *p) {
+  if (shadow_observed(p))
+    shadow_enqueue(p, bpf_ktime_get_ns(), BPF_NOEXIST);
+  return 0;
+}
+
+/*
+ * A preempted task stays runnable and is queued again with a new deadline,
+ * as sched_ext would call enqueue again; a task that blocks or exits is
+ * forgotten until its next wakeup. Tasks already running when shadow mode
+ * started are picked up at their first preemption.
+ */
+SEC("tp_btf/sched_switch")
+int BPF_PROG(shadow_switch, bool preempt, struct task_struct *prev,
+             struct task_struct *next) {
+  u64 now = bpf_ktime_get_ns();
+  u32 pid = prev->pid;
+
+  shadow_stop(prev, now);
+  if (shadow_observed(prev) && (preempt || !prev->__state))
+    shadow_enqueue(prev, now, BPF_ANY);
+  else
+    bpf_map_delete_elem(&shadow_task_ctx, &pid);
+
+  shadow_start(next, now);
+  return 0;
+}
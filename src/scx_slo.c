@@ -7,7 +7,7 @@
  * scx-slo userspace agent - SLO-aware sched_ext scheduler
  *
  * This program is Linux-specific and requires:
- * - Linux 6.12+ with CONFIG_SCHED_CLASS_EXT=y
+ * - Linux 6.12+ with CONFIG_SCHED_CLASS_EXT=y (6.2+ with BTF in shadow mode)
  * - libbpf, libelf, zlib
  * - pthreads
  */
@@ -24,6 +24,7 @@
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/inotify.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
@@ -34,42 +35,92 @@
 #include <scx/common.h>
 #include "scx_slo.skel.h"
 #include "config.h"
+#include "cgroup_index.h"
+#include "log.h"
+#include "miss_summary.h"
+#include "handoff.h"
+#include "timeline.h"
+#include "map_sizing.h"
+#include "cgroup_gc.h"
+#include "ctl_server.h"
+#include "budget_ctl.h"
+#include "shadow_stats.h"
+#include "partial_switch.h"
+#include "breaker.h"
+#include "admission.h"
+#include "reserve_ctl.h"
+#include "cpuperf.h"
+#include "burst.h"
 
 /* Linux-specific: MSG_NOSIGNAL for send() to prevent SIGPIPE */
 #ifndef MSG_NOSIGNAL
 #define MSG_NOSIGNAL 0x4000
 #endif
 
-/* Deadline event structure - must match BPF side */
-struct deadline_event {
-	__u64 cgroup_id;
-	__u64 deadline_miss_ns;
-	__u64 timestamp;
-};
-
-/* Log levels */
-enum log_level {
-	LOG_DEBUG = 0,
-	LOG_INFO = 1,
-	LOG_WARN = 2,
-	LOG_ERROR = 3
-};
+#define CGROUP_FS_ROOT "/sys/fs/cgroup"
+#define TASK_CTX_PIN_PATH "/sys/fs/bpf/task_ctx_map"
 
-static const char *log_level_names[] = {"debug", "info", "warn", "error"};
+/* How often map occupancy is counted for the metrics endpoint */
+#define OCCUPANCY_INTERVAL_SEC 10
+#define OCCUPANCY_BATCH 4096
 
 const char help_fmt[] =
 "SLO-aware sched_ext scheduler (scx-slo).\n"
 "\n"
 "Enforces service-level latency budgets at the kernel level.\n"
 "\n"
-"Usage: %s [-v] [-c] [-p PORT] [-j] [-l LEVEL] [--create-config]\n"
+"Usage: %s [-v] [-t] [-c] [-H] [-d DEPTH] [-p PORT] [-j] [-l LEVEL] [-s SEC]\n"
+"          [-m SIZES] [-u PATH] [-a] [-A PARAMS] [-S | -P] [-b] [-B PARAMS]\n"
+"          [-e] [-E PARAMS] [-r] [-R PARAMS] [-f] [-F PARAMS] [-w] [-W PARAMS]\n"
+"       [--create-config] [--compile-config]\n"
 "\n"
-"  -v            Print libbpf debug messages and detailed deadline events\n"
-"  -c            Reload configuration file on startup\n"
+"  -v            Print libbpf debug messages\n"
+"  -t            Trace mode: log every deadline miss event individually\n"
+"  -c            Load configuration file on startup and reload it on change\n"
+"  -H            Handoff: take over from a running scx_slo instance, keeping\n"
+"                its pinned state and minimizing the time without a scheduler\n"
+"  -d DEPTH      Ancestor cgroups searched for an SLO when a task's own cgroup\n"
+"                has none (default: 4, max: 16, 0 for exact matches only)\n"
 "  -p PORT       HTTP health check port (default: 8080, 0 to disable)\n"
 "  -j            Enable JSON structured logging\n"
 "  -l LEVEL      Log level: debug, info, warn, error (default: info)\n"
+"  -s SEC        Per-cgroup miss summary interval (default: 10, 0 to disable)\n"
+"  -m SIZES      Map sizes, e.g. tasks=200000,cgroups=20000,ringbuf=4m\n"
+"                (default: from the CPU count and pid_max)\n"
+"  -u PATH       Control socket for the watcher and tools\n"
+"                (default: " SLO_CTL_SOCK_PATH ", empty to disable)\n"
+"  -a            Adapt budgets to observed deadline misses, within bounds\n"
+"  -A PARAMS     Adaptive budget tuning, e.g. target=0.01,scale_min=0.25,\n"
+"                interval=5,trace=/var/log/scx-slo.trace (implies -a)\n"
+"  -S            Shadow mode: leave scheduling to the kernel and report the\n"
+"                deadlines scx-slo would have set, from scheduler tracepoints;\n"
+"                needs no sched_ext\n"
+"  -P            Partial switch: schedule only threads of cgroups with an SLO\n"
+"                and leave every other task on the kernel's fair class\n"
+"  -b            Circuit breaker: detach the scheduler while misses, queueing\n"
+"                delay or its own CPU time regress, re-attaching after a cooldown\n"
+"  -B PARAMS     Circuit breaker tuning, e.g. miss=0.2,delay_us=20000,cpu=0.05,\n"
+"                trip_after=3,cooldown=60 (implies -b)\n"
+"  -e            Admission control: check that the node can meet every budget\n"
+"                and report the headroom, without changing anything\n"
+"  -E PARAMS     Admission control tuning, e.g. mode=relax,util_max=0.9,\n"
+"                victim_below=50 (implies -e; mode=relax stretches the\n"
+"                budgets of unimportant cgroups while overcommitted)\n"
+"  -r            Reserve CPUs for critical and important cgroups, more while\n"
+"                they miss deadlines and fewer while they have slack\n"
+"  -R PARAMS     Reserved partition tuning, e.g. importance=80,max_frac=0.5,\n"
+"                miss_grow=0.01 (implies -r)\n"
+"  -f            Set each CPU's performance target from the class, importance\n"
+"                and slack of the task it runs, capping batch work\n"
+"  -F PARAMS     CPU performance tuning, e.g. standard_min=512,batch_max=384,\n"
+"                boost_slack=50 (implies -f)\n"
+"  -w            Learn each task's burst length: size its slice from it, queue\n"
+"                short bursts ahead and predict deadline misses as runs start\n"
+"  -W PARAMS     Burst learning tuning, e.g. shift=3,min_samples=4,short_us=1000,\n"
+"                boost=50,slice_mult=2,slice_min_us=250 (implies -w)\n"
 "  --create-config Create example configuration file\n"
+"  --compile-config Compile the configuration into " SLO_SNAPSHOT_PATH "\n"
+"                for faster startup; recompile after editing the config\n"
 "  -h            Display this help and exit\n"
 "\n"
 "HTTP Endpoints:\n"
@@ -77,18 +128,30 @@ const char help_fmt[] =
 "  GET /metrics  Returns Prometheus-format metrics\n"
 "\n"
 "Configuration:\n"
-"  Default config: /etc/scx-slo/config\n"
-"  Format: cgroup_path budget_ms importance\n"
-"  Example: /kubepods/critical/payment-api 50 90\n";
+"  Default config: /etc/scx-slo/config (SIGHUP forces a full reload)\n"
+"  Format: cgroup_path budget_ms importance [class]\n"
+"  Example: /kubepods/critical/payment-api 50 90\n"
+"  Paths may use * and ? within a component and ... for any depth; such\n"
+"  rules also apply to matching cgroups as they are created\n";
 
 /* Configuration */
 static bool verbose;
+static bool trace_events;
 static bool reload_config;
-static bool json_logging = false;
-static enum log_level current_log_level = LOG_INFO;
+static bool handoff_mode;
+static bool shadow_mode;
+static bool partial_mode;
+static int summary_interval_sec = 10;
+static int inherit_depth = DEFAULT_INHERIT_DEPTH;
 static int health_port = 8080;
+static const char *map_size_spec;
+static const char *ctl_sock_path = SLO_CTL_SOCK_PATH;
 static volatile sig_atomic_t exit_req = 0;
 static volatile sig_atomic_t scheduler_attached = 0;
+static volatile sig_atomic_t reload_req = 0;
+
+/* inotify watch on the config directory, -1 if not watching */
+static int config_watch_fd = -1;
 
 /* Cleanup timeout in seconds */
 #define CLEANUP_TIMEOUT_SEC 5
@@ -99,50 +162,113 @@ static __u64 total_deadline_misses = 0;
 static __u64 total_miss_duration_ns = 0;
 static __u64 last_local_dispatches = 0;
 static __u64 last_global_dispatches = 0;
+static __u64 last_handoff_gap_ns = 0;
+static __u32 completed_handoffs = 0;
+static __u64 config_reloads = 0;
+static __u64 config_reload_failures = 0;
+static __u64 last_config_reload_ns = 0;
+static int config_rules = 0;
+static __u32 config_generation = 0;
+
+/* Map capacities chosen before load, and occupancy counted since */
+static struct map_sizes map_sizes;
+static __u32 slo_map_capacity = 0;
+static long task_ctx_entries = -1;
+static long slo_map_entries = -1;
+static __u64 ringbuf_pending = 0;
+
+/* Stale SLO entry collection */
+static int cgroup_gc_fd = -1;
+static __u64 gc_sweep_deleted = 0;
+static __u64 gc_exit_deleted = 0;
+static __u64 gc_config_dropped = 0;
+static __u64 last_gc_sweep_ns = 0;
+
+/* Control socket; the agent is the only writer of the SLO map */
+static struct ctl_server *ctl_server;
+static __u64 ctl_shadowed = 0;
+
+/* Adaptive budget controller, stepped from the main loop */
+static bool adaptive;
+static struct budget_ctl *budget_ctl;
+static struct budget_ctl_params adaptive_params;
+static FILE *adaptive_trace;
+static __u64 adaptive_conflicts = 0;
+
+/* Circuit breaker, stepped from the main loop */
+static bool breaker_enabled;
+static struct breaker *breaker;
+static struct breaker_params breaker_params;
+static struct slo_health breaker_health;  /* Counters at the last step */
+static __u64 breaker_sched_ns;
+static __u64 breaker_last_ns;
+static int bpf_stats_fd = -1;             /* Keeps program run time accounting on */
+static volatile sig_atomic_t breaker_open = 0;
+static time_t last_breaker_trip = 0;
+
+/* Admission control, stepped from the main loop */
+static bool admission_enabled;
+static struct admission *admission;
+static struct admission_params admission_params;
+static __u64 admission_last_ns;
+static __u64 admission_conflicts = 0;
+static struct admission_stats admission_logged;  /* As of the last state change logged */
+
+/* Reserved CPU partition, resized from the main loop */
+static bool reserve_enabled;
+static struct reserve_ctl *reserve_ctl;
+static struct reserve_params reserve_params;
+static __u32 *reserve_order;  /* CPUs in the order they join the partition */
+static __u32 reserve_nr_order;
+static __u32 reserve_size;    /* CPUs set in the scheduler's map */
+static __u64 reserve_last_ns;
+
+/* CPU performance targets, copied from the scheduler's per-CPU map */
+static bool cpuperf_enabled;
+static struct cpuperf_params cpuperf_params;
+static struct slo_cpu_perf *cpuperf_percpu;  /* Under stats_lock */
+static int cpuperf_nr_cpus;
+static bool cpuperf_warned;
+
+/* Burst learning, its counters summed from the scheduler's per-CPU map */
+static bool burst_enabled;
+static struct burst_params burst_params;
+static struct slo_burst_stats burst_totals;  /* Under stats_lock */
+static int burst_nr_cpus;
+
+/* Shadow mode histograms per latency class, summed from the per-CPU maps */
+static struct slo_shadow_stats shadow_totals[NR_SLO_CLASSES];
+static struct slo_shadow_stats shadow_logged[NR_SLO_CLASSES];
+
+/* Partial-switch mode: moves threads of configured cgroups to SCHED_EXT */
+static struct partial_switch *partial_switch;
+static volatile sig_atomic_t partial_scan_req = 0;
+static __u64 partial_strays = 0;
+
+/* Map of per-task state in the mode loaded, for occupancy metrics */
+static const char *task_map_name = "task_ctx_map";
+
+/* Startup phase timings; complete before the health server starts */
+static struct startup_timeline timeline;
+
+/* Ownership generation claimed in the pinned handoff map */
+static __u32 handoff_generation;
+
+/* Per-cgroup miss aggregation, owned by the main loop */
+static struct miss_summary miss_summary;
+
+/* Cgroup ID -> path/pod index, NULL if the cgroup hierarchy is unavailable */
+static struct cgroup_index *cgroup_idx;
+
+/* Applies config rules to new cgroups as soon as inotify reports them */
+static pthread_t cgroup_watch_thread;
+static volatile bool cgroup_watch_running = false;
 
 /* Health server state */
 static int health_server_fd = -1;
 static pthread_t health_thread;
 static volatile bool health_thread_running = false;
 
-/* Structured logging */
-static void log_msg(enum log_level level, const char *fmt, ...)
-{
-	if (level < current_log_level)
-		return;
-
-	va_list args;
-	va_start(args, fmt);
-
-	time_t now = time(NULL);
-	struct tm *tm_info = localtime(&now);
-	char timestamp[32];
-	strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", tm_info);
-
-	if (json_logging) {
-		char msg[1024];
-		vsnprintf(msg, sizeof(msg), fmt, args);
-		/* Escape quotes in message for JSON */
-		char escaped_msg[2048];
-		size_t j = 0;
-		for (size_t i = 0; msg[i] && j < sizeof(escaped_msg) - 2; i++) {
-			if (msg[i] == '"' || msg[i] == '\\') {
-				escaped_msg[j++] = '\\';
-			}
-			escaped_msg[j++] = msg[i];
-		}
-		escaped_msg[j] = '\0';
-		printf("{\"timestamp\":\"%s\",\"level\":\"%s\",\"message\":\"%s\"}\n",
-		       timestamp, log_level_names[level], escaped_msg);
-	} else {
-		printf("[%s] [%s] ", timestamp, log_level_names[level]);
-		vprintf(fmt, args);
-		printf("\n");
-	}
-	va_end(args);
-	fflush(stdout);
-}
-
 static int libbpf_print_fn(enum libbpf_print_level level, const char *format, va_list args)
 {
 	if (level == LIBBPF_DEBUG && !verbose)
@@ -156,6 +282,12 @@ static void sigint_handler(int sig)
 	exit_req = 1;
 }
 
+static void sighup_handler(int sig)
+{
+	(void)sig;
+	reload_req = 1;
+}
+
 /* Convert nanoseconds to milliseconds for readable output */
 static double ns_to_ms(__u64 ns)
 {
@@ -166,22 +298,98 @@ static double ns_to_ms(__u64 ns)
 static void send_http_response(int client_fd, int status_code, const char *status_text,
 			       const char *content_type, const char *body)
 {
-	char response[4096];
-	int body_len = body ? strlen(body) : 0;
+	char header[512];
+	size_t body_len = body ? strlen(body) : 0;
 
-	int len = snprintf(response, sizeof(response),
+	int len = snprintf(header, sizeof(header),
 			   "HTTP/1.1 %d %s\r\n"
 			   "Content-Type: %s\r\n"
-			   "Content-Length: %d\r\n"
+			   "Content-Length: %zu\r\n"
 			   "Connection: close\r\n"
-			   "\r\n"
-			   "%s",
-			   status_code, status_text, content_type, body_len,
-			   body ? body : "");
+			   "\r\n",
+			   status_code, status_text, content_type, body_len);
+
+	if (len <= 0 || (size_t)len >= sizeof(header))
+		return;
+
+	/* Per-cgroup metrics can be large, so the body is sent separately */
+	if (send(client_fd, header, len, MSG_NOSIGNAL | (body_len ? MSG_MORE : 0)) != len)
+		return;
+
+	while (body_len > 0) {
+		ssize_t sent = send(client_fd, body, body_len, MSG_NOSIGNAL);
+		if (sent <= 0) {
+			if (sent < 0 && errno == EINTR)
+				continue;
+			return;
+		}
+		body += sent;
+		body_len -= sent;
+	}
+}
+
+/* Growable buffer for building the metrics response */
+struct metrics_buf {
+	char *data;
+	size_t len;
+	size_t cap;
+	bool failed;
+};
+
+static void metrics_printf(struct metrics_buf *mb, const char *fmt, ...)
+{
+	va_list args;
+	int n;
+
+	if (mb->failed)
+		return;
+
+	for (;;) {
+		size_t avail = mb->cap - mb->len;
+
+		va_start(args, fmt);
+		n = vsnprintf(mb->data + mb->len, avail, fmt, args);
+		va_end(args);
+
+		if (n < 0) {
+			mb->failed = true;
+			return;
+		}
+		if ((size_t)n < avail) {
+			mb->len += n;
+			return;
+		}
+
+		size_t new_cap = mb->cap * 2;
+		while (new_cap - mb->len <= (size_t)n)
+			new_cap *= 2;
+		char *p = realloc(mb->data, new_cap);
+		if (!p) {
+			mb->failed = true;
+			return;
+		}
+		mb->data = p;
+		mb->cap = new_cap;
+	}
+}
 
-	if (len > 0 && (size_t)len < sizeof(response)) {
-		send(client_fd, response, len, MSG_NOSIGNAL);
+/* Escape a Prometheus label value (backslash, double quote, newline) */
+static void escape_label(const char *in, char *out, size_t out_len)
+{
+	size_t j = 0;
+
+	for (size_t i = 0; in[i] && j + 2 < out_len; i++) {
+		if (in[i] == '\\' || in[i] == '"') {
+			out[j++] = '\\';
+			out[j++] = in[i];
+		} else if (in[i] == '\n') {
+			out[j++] = '\\';
+			out[j++] = 'n';
+		} else {
+			out[j++] = in[i];
+		}
 	}
+	out[j] = '\0';
 }
 
 /* Health check handler */
@@ -189,28 +397,213 @@ static void handle_health_request(int client_fd)
 {
 	if (scheduler_attached) {
 		send_http_response(client_fd, 200, "OK", "text/plain", "OK\n");
+	} else if (breaker_open) {
+		/* Detached on purpose; restarting the agent would undo that */
+		send_http_response(client_fd, 200, "OK", "text/plain",
+				   "OK (circuit breaker open, scheduler detached)\n");
 	} else {
 		send_http_response(client_fd, 503, "Service Unavailable",
 				   "text/plain", "Scheduler not attached\n");
 	}
 }
 
+/*
+ * Emit per-cgroup series for cgroups that have missed at least once.
+ * Unresolved cgroups have no path to tell them apart and are summed into
+ * one "unknown" series after the walk.
+ */
+static void write_cgroup_misses(const struct cgroup_info *info, void *ctx)
+{
+	struct metrics_buf *mb = ctx;
+	char cgroup[2 * CGROUP_INDEX_PATH_MAX], pod[2 * CGROUP_INDEX_POD_MAX];
+	char ns[2 * CGROUP_INDEX_NS_MAX];
+
+	if (info->deadline_misses == 0 || !info->path[0])
+		return;
+
+	escape_label(info->path, cgroup, sizeof(cgroup));
+	escape_label(info->pod, pod, sizeof(pod));
+	escape_label(info->namespace, ns, sizeof(ns));
+
+	metrics_printf(mb, "scx_slo_cgroup_deadline_misses_total"
+		       "{cgroup=\"%s\",namespace=\"%s\",pod=\"%s\"} %llu\n",
+		       cgroup, ns, pod, (unsigned long long)info->deadline_misses);
+	metrics_printf(mb, "scx_slo_cgroup_miss_duration_seconds_total"
+		       "{cgroup=\"%s\",namespace=\"%s\",pod=\"%s\"} %.6f\n",
+		       cgroup, ns, pod, (double)info->miss_duration_ns / 1e9);
+}
+
+/* One class of a shadow histogram, cumulative as Prometheus expects */
+static void write_shadow_hist(struct metrics_buf *mb, const char *name, __u32 cls,
+			      const struct slo_hist *h)
+{
+	const char *cname = slo_class_name(cls);
+	__u64 seen = 0;
+
+	for (unsigned int i = 0; i < SLO_HIST_BUCKETS; i++) {
+		__u64 le = shadow_hist_upper_ns(i);
+
+		seen += h->buckets[i];
+		if (le == UINT64_MAX)
+			metrics_printf(mb, "%s_bucket{class=\"%s\",le=\"+Inf\"} %llu\n",
+				       name, cname, (unsigned long long)seen);
+		else
+			metrics_printf(mb, "%s_bucket{class=\"%s\",le=\"%g\"} %llu\n",
+				       name, cname, le / 1e9, (unsigned long long)seen);
+	}
+	metrics_printf(mb, "%s_sum{class=\"%s\"} %.9f\n%s_count{class=\"%s\"} %llu\n",
+		       name, cname, h->sum_ns / 1e9, name, cname, (unsigned long long)seen);
+}
+
+static void write_shadow_metrics(struct metrics_buf *mb)
+{
+	struct slo_shadow_stats totals[NR_SLO_CLASSES];
+	__u32 cls;
+
+	pthread_mutex_lock(&stats_lock);
+	memcpy(totals, shadow_totals, sizeof(totals));
+	pthread_mutex_unlock(&stats_lock);
+
+	metrics_printf(mb,
+		"\n"
+		"# HELP scx_slo_shadow_slack_seconds Time left before the would-be deadline, runs that made it\n"
+		"# TYPE scx_slo_shadow_slack_seconds histogram\n");
+	for (cls = 0; cls < NR_SLO_CLASSES; cls++)
+		write_shadow_hist(mb, "scx_slo_shadow_slack_seconds", cls, &totals[cls].slack);
+
+	metrics_printf(mb,
+		"\n"
+		"# HELP scx_slo_shadow_lateness_seconds Time past the would-be deadline, runs that missed it\n"
+		"# TYPE scx_slo_shadow_lateness_seconds histogram\n");
+	for (cls = 0; cls < NR_SLO_CLASSES; cls++)
+		write_shadow_hist(mb, "scx_slo_shadow_lateness_seconds", cls, &totals[cls].lateness);
+
+	metrics_printf(mb,
+		"\n"
+		"# HELP scx_slo_shadow_queue_delay_seconds Time from wakeup or preemption to running\n"
+		"# TYPE scx_slo_shadow_queue_delay_seconds histogram\n");
+	for (cls = 0; cls < NR_SLO_CLASSES; cls++)
+		write_shadow_hist(mb, "scx_slo_shadow_queue_delay_seconds", cls, &totals[cls].delay);
+}
+
+static void write_cpuperf_metrics(struct metrics_buf *mb)
+{
+	struct slo_cpu_perf sum;
+
+	pthread_mutex_lock(&stats_lock);
+	metrics_printf(mb,
+		"\n"
+		"# HELP scx_slo_cpuperf_target_ratio Performance target of each CPU, as a share of full speed\n"
+		"# TYPE scx_slo_cpuperf_target_ratio gauge\n");
+	for (int cpu = 0; cpu < cpuperf_nr_cpus; cpu++)
+		metrics_printf(mb, "scx_slo_cpuperf_target_ratio{cpu=\"%d\"} %.4f\n", cpu,
+			       (double)cpuperf_percpu[cpu].target / SLO_CPUPERF_ONE);
+	cpuperf_sum(&sum, cpuperf_percpu, cpuperf_nr_cpus);
+	pthread_mutex_unlock(&stats_lock);
+
+	metrics_printf(mb,
+		"\n"
+		"# HELP scx_slo_cpuperf_sets_total Changes of a CPU's performance target\n"
+		"# TYPE scx_slo_cpuperf_sets_total counter\n"
+		"scx_slo_cpuperf_sets_total %llu\n"
+		"\n"
+		"# HELP scx_slo_cpuperf_runs_total Runs given full speed for lack of slack, or held to the batch cap\n"
+		"# TYPE scx_slo_cpuperf_runs_total counter\n"
+		"scx_slo_cpuperf_runs_total{reason=\"boost\"} %llu\n"
+		"scx_slo_cpuperf_runs_total{reason=\"cap\"} %llu\n",
+		(unsigned long long)sum.sets, (unsigned long long)sum.boosts,
+		(unsigned long long)sum.capped);
+}
+
+static void write_burst_metrics(struct metrics_buf *mb)
+{
+	struct slo_burst_stats sum;
+
+	pthread_mutex_lock(&stats_lock);
+	sum = burst_totals;
+	pthread_mutex_unlock(&stats_lock);
+
+	metrics_printf(mb,
+		"\n"
+		"# HELP scx_slo_burst_runs_total Runs of tasks with a learned burst, and those that missed their deadline\n"
+		"# TYPE scx_slo_burst_runs_total counter\n"
+		"scx_slo_burst_runs_total{outcome=\"met\"} %llu\n"
+		"scx_slo_burst_runs_total{outcome=\"late\"} %llu\n"
+		"\n"
+		"# HELP scx_slo_burst_predictions_total Runs predicted to miss as they started, by whether they did\n"
+		"# TYPE scx_slo_burst_predictions_total counter\n"
+		"scx_slo_burst_predictions_total{outcome=\"hit\"} %llu\n"
+		"scx_slo_burst_predictions_total{outcome=\"false_alarm\"} %llu\n"
+		"\n"
+		"# HELP scx_slo_burst_boosted_total Enqueues of short-burst tasks moved ahead in the queue\n"
+		"# TYPE scx_slo_burst_boosted_total counter\n"
+		"scx_slo_burst_boosted_total %llu\n",
+		(unsigned long long)(sum.runs - sum.late), (unsigned long long)sum.late,
+		(unsigned long long)sum.predicted_late,
+		(unsigned long long)(sum.predicted - sum.predicted_late),
+		(unsigned long long)sum.boosted);
+}
+
 /* Prometheus metrics handler */
 static void handle_metrics_request(int client_fd)
 {
-	char metrics[4096];
-	__u64 misses, miss_duration, local, global;
+	struct metrics_buf mb = { .cap = 4096 };
+	__u64 misses, miss_duration, local, global, handoff_gap;
+	__u64 reloads, reload_failures, reload_ns;
+	__u32 handoffs, generation;
+	__u64 auto_applied, rb_pending;
+	long task_entries, slo_entries;
+	__u64 gc_sweep, gc_exit, gc_config, gc_ns;
+	__u64 shadowed, conflicts, strays;
+	time_t last_trip;
+	struct ctl_stats ctl = {0};
+	struct budget_ctl_stats adapt;
+	struct partial_switch_stats part;
+	struct breaker_stats brk;
+	struct admission_stats adm;
+	struct reserve_stats res;
+	__u64 adm_conflicts;
+	__u32 slo_capacity;
+	int rules;
+
+	mb.data = malloc(mb.cap);
+	if (!mb.data) {
+		send_http_response(client_fd, 500, "Internal Server Error",
+				   "text/plain", "Out of memory\n");
+		return;
+	}
 
 	pthread_mutex_lock(&stats_lock);
 	misses = total_deadline_misses;
 	miss_duration = total_miss_duration_ns;
 	local = last_local_dispatches;
 	global = last_global_dispatches;
+	handoff_gap = last_handoff_gap_ns;
+	handoffs = completed_handoffs;
+	reloads = config_reloads;
+	reload_failures = config_reload_failures;
+	reload_ns = last_config_reload_ns;
+	rules = config_rules;
+	generation = config_generation;
+	task_entries = task_ctx_entries;
+	slo_entries = slo_map_entries;
+	slo_capacity = slo_map_capacity;
+	rb_pending = ringbuf_pending;
+	gc_sweep = gc_sweep_deleted;
+	gc_exit = gc_exit_deleted;
+	gc_config = gc_config_dropped;
+	gc_ns = last_gc_sweep_ns;
+	shadowed = ctl_shadowed;
+	conflicts = adaptive_conflicts;
+	strays = partial_strays;
+	last_trip = last_breaker_trip;
+	adm_conflicts = admission_conflicts;
 	pthread_mutex_unlock(&stats_lock);
+	auto_applied = slo_config_auto_applied();
 
 	double avg_miss_ms = misses > 0 ? ns_to_ms(miss_duration / misses) : 0.0;
 
-	int len = snprintf(metrics, sizeof(metrics),
+	metrics_printf(&mb,
 		"# HELP scx_slo_deadline_misses_total Total number of deadline misses\n"
 		"# TYPE scx_slo_deadline_misses_total counter\n"
 		"scx_slo_deadline_misses_total %llu\n"
@@ -229,20 +622,400 @@ static void handle_metrics_request(int client_fd)
 		"\n"
 		"# HELP scx_slo_scheduler_attached Whether scheduler is attached\n"
 		"# TYPE scx_slo_scheduler_attached gauge\n"
-		"scx_slo_scheduler_attached %d\n",
+		"scx_slo_scheduler_attached %d\n"
+		"\n"
+		"# HELP scx_slo_shadow_mode Whether the agent only observes, reporting the deadlines it would set\n"
+		"# TYPE scx_slo_shadow_mode gauge\n"
+		"scx_slo_shadow_mode %d\n"
+		"\n"
+		"# HELP scx_slo_partial_mode Whether only threads of configured cgroups are scheduled\n"
+		"# TYPE scx_slo_partial_mode gauge\n"
+		"scx_slo_partial_mode %d\n"
+		"\n"
+		"# HELP scx_slo_log_dropped_total Log messages dropped because the log ring was full\n"
+		"# TYPE scx_slo_log_dropped_total counter\n"
+		"scx_slo_log_dropped_total %llu\n"
+		"\n"
+		"# HELP scx_slo_handoff_gap_seconds Time without a scheduler between the previous instance detaching and this one attaching\n"
+		"# TYPE scx_slo_handoff_gap_seconds gauge\n"
+		"scx_slo_handoff_gap_seconds %.6f\n"
+		"\n"
+		"# HELP scx_slo_handoffs_total Completed handoffs between agent instances\n"
+		"# TYPE scx_slo_handoffs_total counter\n"
+		"scx_slo_handoffs_total %u\n",
 		(unsigned long long)misses,
 		(unsigned long long)local,
 		(unsigned long long)global,
 		avg_miss_ms / 1000.0,  /* Convert ms to seconds */
-		scheduler_attached ? 1 : 0);
+		scheduler_attached ? 1 : 0,
+		shadow_mode ? 1 : 0,
+		partial_mode ? 1 : 0,
+		(unsigned long long)log_dropped(),
+		(double)handoff_gap / 1e9,
+		handoffs);
+
+	metrics_printf(&mb,
+		"\n"
+		"# HELP scx_slo_config_rules SLO rules applied from the config file\n"
+		"# TYPE scx_slo_config_rules gauge\n"
+		"scx_slo_config_rules %d\n"
+		"\n"
+		"# HELP scx_slo_config_reloads_total Config reloads applied while running\n"
+		"# TYPE scx_slo_config_reloads_total counter\n"
+		"scx_slo_config_reloads_total %llu\n"
+		"\n"
+		"# HELP scx_slo_config_reload_failures_total Config reloads that could not be published\n"
+		"# TYPE scx_slo_config_reload_failures_total counter\n"
+		"scx_slo_config_reload_failures_total %llu\n"
+		"\n"
+		"# HELP scx_slo_config_reload_duration_seconds Duration of the last config reload\n"
+		"# TYPE scx_slo_config_reload_duration_seconds gauge\n"
+		"scx_slo_config_reload_duration_seconds %.6f\n"
+		"\n"
+		"# HELP scx_slo_config_generation SLO map generation the scheduler is reading\n"
+		"# TYPE scx_slo_config_generation gauge\n"
+		"scx_slo_config_generation %u\n"
+		"\n"
+		"# HELP scx_slo_config_auto_applied_total Rules applied to cgroups as they were created\n"
+		"# TYPE scx_slo_config_auto_applied_total counter\n"
+		"scx_slo_config_auto_applied_total %llu\n",
+		rules, (unsigned long long)reloads, (unsigned long long)reload_failures,
+		reload_ns / 1e9, generation, (unsigned long long)auto_applied);
+
+	metrics_printf(&mb,
+		"\n"
+		"# HELP scx_slo_map_max_entries Capacity of the scheduler's hash maps\n"
+		"# TYPE scx_slo_map_max_entries gauge\n"
+		"scx_slo_map_max_entries{map=\"%s\"} %u\n"
+		"scx_slo_map_max_entries{map=\"slo_map\"} %u\n"
+		"\n"
+		"# HELP scx_slo_ringbuf_size_bytes Size of the deadline event ring buffer\n"
+		"# TYPE scx_slo_ringbuf_size_bytes gauge\n"
+		"scx_slo_ringbuf_size_bytes %u\n"
+		"\n"
+		"# HELP scx_slo_ringbuf_pending_bytes Deadline event bytes not yet consumed\n"
+		"# TYPE scx_slo_ringbuf_pending_bytes gauge\n"
+		"scx_slo_ringbuf_pending_bytes %llu\n",
+		task_map_name, map_sizes.tasks, slo_capacity, map_sizes.ringbuf,
+		(unsigned long long)rb_pending);
+	if (task_entries >= 0 || slo_entries >= 0)
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_map_entries Entries in the scheduler's hash maps\n"
+			"# TYPE scx_slo_map_entries gauge\n");
+	if (task_entries >= 0)
+		metrics_printf(&mb, "scx_slo_map_entries{map=\"%s\"} %ld\n", task_map_name,
+			       task_entries);
+	if (slo_entries >= 0)
+		metrics_printf(&mb, "scx_slo_map_entries{map=\"slo_map\"} %ld\n", slo_entries);
+
+	metrics_printf(&mb,
+		"\n"
+		"# HELP scx_slo_map_gc_deleted_total SLO map entries of removed cgroups deleted\n"
+		"# TYPE scx_slo_map_gc_deleted_total counter\n"
+		"scx_slo_map_gc_deleted_total{source=\"cgroup_exit\"} %llu\n"
+		"scx_slo_map_gc_deleted_total{source=\"sweep\"} %llu\n"
+		"\n"
+		"# HELP scx_slo_config_gc_dropped_total Config rules dropped because their cgroup was removed\n"
+		"# TYPE scx_slo_config_gc_dropped_total counter\n"
+		"scx_slo_config_gc_dropped_total %llu\n"
+		"\n"
+		"# HELP scx_slo_map_gc_sweep_duration_seconds Duration of the last SLO map sweep\n"
+		"# TYPE scx_slo_map_gc_sweep_duration_seconds gauge\n"
+		"scx_slo_map_gc_sweep_duration_seconds %.6f\n",
+		(unsigned long long)gc_exit, (unsigned long long)gc_sweep,
+		(unsigned long long)gc_config, gc_ns / 1e9);
+
+	if (ctl_server) {
+		ctl_server_get_stats(ctl_server, &ctl);
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_ctl_requests_total Control socket requests received\n"
+			"# TYPE scx_slo_ctl_requests_total counter\n"
+			"scx_slo_ctl_requests_total %llu\n"
+			"\n"
+			"# HELP scx_slo_ctl_rejected_total Control socket requests refused as invalid\n"
+			"# TYPE scx_slo_ctl_rejected_total counter\n"
+			"scx_slo_ctl_rejected_total %llu\n"
+			"\n"
+			"# HELP scx_slo_ctl_batches_total Batched SLO map writes made for control socket requests\n"
+			"# TYPE scx_slo_ctl_batches_total counter\n"
+			"scx_slo_ctl_batches_total %llu\n"
+			"\n"
+			"# HELP scx_slo_ctl_entries_total SLO map entries written or deleted for control socket requests\n"
+			"# TYPE scx_slo_ctl_entries_total counter\n"
+			"scx_slo_ctl_entries_total %llu\n"
+			"\n"
+			"# HELP scx_slo_ctl_coalesced_total Control socket entries superseded before reaching the map\n"
+			"# TYPE scx_slo_ctl_coalesced_total counter\n"
+			"scx_slo_ctl_coalesced_total %llu\n"
+			"\n"
+			"# HELP scx_slo_ctl_shadowed_total Control socket entries ignored for cgroups with a config rule\n"
+			"# TYPE scx_slo_ctl_shadowed_total counter\n"
+			"scx_slo_ctl_shadowed_total %llu\n"
+			"\n"
+			"# HELP scx_slo_ctl_clients Connected control socket clients\n"
+			"# TYPE scx_slo_ctl_clients gauge\n"
+			"scx_slo_ctl_clients{role=\"all\"} %u\n"
+			"scx_slo_ctl_clients{role=\"subscriber\"} %u\n"
+			"\n"
+			"# HELP scx_slo_ctl_misses_total Deadline misses streamed to subscribers\n"
+			"# TYPE scx_slo_ctl_misses_total counter\n"
+			"scx_slo_ctl_misses_total{result=\"sent\"} %llu\n"
+			"scx_slo_ctl_misses_total{result=\"dropped\"} %llu\n",
+			(unsigned long long)ctl.requests, (unsigned long long)ctl.rejected,
+			(unsigned long long)ctl.batches, (unsigned long long)ctl.entries,
+			(unsigned long long)ctl.coalesced, (unsigned long long)shadowed,
+			ctl.clients, ctl.subscribers,
+			(unsigned long long)ctl.misses_sent, (unsigned long long)ctl.misses_dropped);
+	}
+
+	if (budget_ctl) {
+		budget_ctl_get_stats(budget_ctl, &adapt);
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_adaptive_cgroups SLO map entries followed by the adaptive budget controller\n"
+			"# TYPE scx_slo_adaptive_cgroups gauge\n"
+			"scx_slo_adaptive_cgroups{state=\"tracked\"} %u\n"
+			"scx_slo_adaptive_cgroups{state=\"adjusted\"} %u\n"
+			"scx_slo_adaptive_cgroups{state=\"saturated\"} %u\n"
+			"\n"
+			"# HELP scx_slo_adaptive_updates_total Adjusted SLO map values the controller wrote\n"
+			"# TYPE scx_slo_adaptive_updates_total counter\n"
+			"scx_slo_adaptive_updates_total %llu\n"
+			"\n"
+			"# HELP scx_slo_adaptive_rebased_total Adjusted entries another writer set anew\n"
+			"# TYPE scx_slo_adaptive_rebased_total counter\n"
+			"scx_slo_adaptive_rebased_total %llu\n"
+			"\n"
+			"# HELP scx_slo_adaptive_conflicts_total Controller writes skipped because the entry changed\n"
+			"# TYPE scx_slo_adaptive_conflicts_total counter\n"
+			"scx_slo_adaptive_conflicts_total %llu\n",
+			adapt.tracked, adapt.adjusted, adapt.saturated,
+			(unsigned long long)adapt.updates, (unsigned long long)adapt.rebased,
+			(unsigned long long)conflicts);
+	}
+
+	if (partial_switch) {
+		partial_switch_get_stats(partial_switch, &part);
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_partial_threads Threads in configured cgroups at the last partial-mode scan\n"
+			"# TYPE scx_slo_partial_threads gauge\n"
+			"scx_slo_partial_threads{state=\"configured\"} %u\n"
+			"scx_slo_partial_threads{state=\"switched\"} %u\n"
+			"\n"
+			"# HELP scx_slo_partial_policy_changes_total Thread policy changes made by partial mode\n"
+			"# TYPE scx_slo_partial_policy_changes_total counter\n"
+			"scx_slo_partial_policy_changes_total{policy=\"ext\"} %llu\n"
+			"scx_slo_partial_policy_changes_total{policy=\"normal\"} %llu\n"
+			"\n"
+			"# HELP scx_slo_partial_policy_failures_total Thread policy changes the kernel refused\n"
+			"# TYPE scx_slo_partial_policy_failures_total counter\n"
+			"scx_slo_partial_policy_failures_total %llu\n"
+			"\n"
+			"# HELP scx_slo_partial_strays_total Tasks the scheduler saw without an SLO, sent back to the fair class\n"
+			"# TYPE scx_slo_partial_strays_total counter\n"
+			"scx_slo_partial_strays_total %llu\n"
+			"\n"
+			"# HELP scx_slo_partial_scan_duration_seconds Duration of the last partial-mode scan\n"
+			"# TYPE scx_slo_partial_scan_duration_seconds gauge\n"
+			"scx_slo_partial_scan_duration_seconds %.6f\n",
+			part.threads, part.owned,
+			(unsigned long long)part.switched, (unsigned long long)part.reverted,
+			(unsigned long long)part.failed, (unsigned long long)strays,
+			part.scan_ns / 1e9);
+	}
+
+	if (breaker) {
+		breaker_get_stats(breaker, &brk);
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_breaker_state Circuit breaker state (0 closed, 1 open with the scheduler detached, 2 probation)\n"
+			"# TYPE scx_slo_breaker_state gauge\n"
+			"scx_slo_breaker_state %d\n"
+			"\n"
+			"# HELP scx_slo_breaker_trips_total Times the circuit breaker detached the scheduler, by the limit crossed\n"
+			"# TYPE scx_slo_breaker_trips_total counter\n",
+			(int)brk.state);
+		for (int i = 0; i < NR_BREAKER_REASONS; i++)
+			metrics_printf(&mb, "scx_slo_breaker_trips_total{reason=\"%s\"} %llu\n",
+				       breaker_reason_name(i), (unsigned long long)brk.trips[i]);
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_breaker_reattaches_total Re-attaches after a circuit breaker cooldown\n"
+			"# TYPE scx_slo_breaker_reattaches_total counter\n"
+			"scx_slo_breaker_reattaches_total %llu\n"
+			"\n"
+			"# HELP scx_slo_breaker_open_seconds_total Time the circuit breaker kept the scheduler detached\n"
+			"# TYPE scx_slo_breaker_open_seconds_total counter\n"
+			"scx_slo_breaker_open_seconds_total %.3f\n"
+			"\n"
+			"# HELP scx_slo_breaker_last_trip_timestamp_seconds Unix time of the last trip, 0 if none\n"
+			"# TYPE scx_slo_breaker_last_trip_timestamp_seconds gauge\n"
+			"scx_slo_breaker_last_trip_timestamp_seconds %ld\n"
+			"\n"
+			"# HELP scx_slo_breaker_miss_ratio Miss ratio of the last interval and its rolling baseline\n"
+			"# TYPE scx_slo_breaker_miss_ratio gauge\n"
+			"scx_slo_breaker_miss_ratio{value=\"last\"} %.6f\n"
+			"scx_slo_breaker_miss_ratio{value=\"baseline\"} %.6f\n"
+			"\n"
+			"# HELP scx_slo_breaker_queue_delay_seconds Mean queueing delay of the last interval and its rolling baseline\n"
+			"# TYPE scx_slo_breaker_queue_delay_seconds gauge\n"
+			"scx_slo_breaker_queue_delay_seconds{value=\"last\"} %.9f\n"
+			"scx_slo_breaker_queue_delay_seconds{value=\"baseline\"} %.9f\n"
+			"\n"
+			"# HELP scx_slo_breaker_sched_cpu_ratio Share of all CPU time spent in the scheduler's programs, last interval\n"
+			"# TYPE scx_slo_breaker_sched_cpu_ratio gauge\n"
+			"scx_slo_breaker_sched_cpu_ratio %.6f\n",
+			(unsigned long long)brk.attaches, brk.open_ns / 1e9, (long)last_trip,
+			brk.last_miss, brk.baseline_miss, brk.last_delay, brk.baseline_delay,
+			brk.last_cpu);
+	}
+
+	if (admission) {
+		admission_get_stats(admission, &adm);
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_admission_headroom_ratio Smallest share of CPU capacity left over any deadline window, at the configured budgets and with the relax plan applied\n"
+			"# TYPE scx_slo_admission_headroom_ratio gauge\n"
+			"scx_slo_admission_headroom_ratio{budgets=\"configured\"} %.6f\n"
+			"scx_slo_admission_headroom_ratio{budgets=\"relaxed\"} %.6f\n"
+			"\n"
+			"# HELP scx_slo_admission_utilization_cpus CPUs used by cgroups with an SLO, smoothed\n"
+			"# TYPE scx_slo_admission_utilization_cpus gauge\n"
+			"scx_slo_admission_utilization_cpus %.3f\n"
+			"\n"
+			"# HELP scx_slo_admission_cpus CPUs the schedulability test runs against\n"
+			"# TYPE scx_slo_admission_cpus gauge\n"
+			"scx_slo_admission_cpus %u\n"
+			"\n"
+			"# HELP scx_slo_admission_overcommitted Whether the configured budgets fail the schedulability test\n"
+			"# TYPE scx_slo_admission_overcommitted gauge\n"
+			"scx_slo_admission_overcommitted %d\n"
+			"\n"
+			"# HELP scx_slo_admission_schedulable Whether the budgets pass the test once relaxed\n"
+			"# TYPE scx_slo_admission_schedulable gauge\n"
+			"scx_slo_admission_schedulable %d\n"
+			"\n"
+			"# HELP scx_slo_admission_cgroups SLO map entries followed by admission control\n"
+			"# TYPE scx_slo_admission_cgroups gauge\n"
+			"scx_slo_admission_cgroups{state=\"tracked\"} %u\n"
+			"scx_slo_admission_cgroups{state=\"measured\"} %u\n"
+			"scx_slo_admission_cgroups{state=\"relaxed\"} %u\n"
+			"\n"
+			"# HELP scx_slo_admission_checks_total Schedulability tests run, by result at the configured budgets\n"
+			"# TYPE scx_slo_admission_checks_total counter\n"
+			"scx_slo_admission_checks_total{result=\"pass\"} %llu\n"
+			"scx_slo_admission_checks_total{result=\"overcommit\"} %llu\n"
+			"\n"
+			"# HELP scx_slo_admission_updates_total Relaxed or restored SLO map values admission control wrote\n"
+			"# TYPE scx_slo_admission_updates_total counter\n"
+			"scx_slo_admission_updates_total %llu\n"
+			"\n"
+			"# HELP scx_slo_admission_conflicts_total Admission control writes skipped because the entry changed\n"
+			"# TYPE scx_slo_admission_conflicts_total counter\n"
+			"scx_slo_admission_conflicts_total %llu\n",
+			adm.headroom, adm.headroom_relaxed, adm.util, adm.cpus,
+			adm.overcommitted, adm.schedulable, adm.tracked, adm.measured,
+			adm.relaxed, (unsigned long long)(adm.checks - adm.overcommits),
+			(unsigned long long)adm.overcommits, (unsigned long long)adm.updates,
+			(unsigned long long)adm_conflicts);
+	}
+
+	if (reserve_ctl) {
+		reserve_ctl_get_stats(reserve_ctl, &res);
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_reserved_cpus CPUs reserved for critical and important cgroups\n"
+			"# TYPE scx_slo_reserved_cpus gauge\n"
+			"scx_slo_reserved_cpus %u\n"
+			"\n"
+			"# HELP scx_slo_reserve_limit_cpus Most CPUs the partition may take at its cgroups' current use\n"
+			"# TYPE scx_slo_reserve_limit_cpus gauge\n"
+			"scx_slo_reserve_limit_cpus %u\n"
+			"\n"
+			"# HELP scx_slo_reserve_cgroups SLO map entries allowed on reserved CPUs\n"
+			"# TYPE scx_slo_reserve_cgroups gauge\n"
+			"scx_slo_reserve_cgroups %u\n"
+			"\n"
+			"# HELP scx_slo_reserve_miss_ratio Miss ratio of cgroups allowed on reserved CPUs, last interval\n"
+			"# TYPE scx_slo_reserve_miss_ratio gauge\n"
+			"scx_slo_reserve_miss_ratio %.6f\n"
+			"\n"
+			"# HELP scx_slo_reserve_slack_ratio Their mean slack as a share of the deadline window, last interval\n"
+			"# TYPE scx_slo_reserve_slack_ratio gauge\n"
+			"scx_slo_reserve_slack_ratio %.6f\n"
+			"\n"
+			"# HELP scx_slo_reserve_resizes_total Partition size changes\n"
+			"# TYPE scx_slo_reserve_resizes_total counter\n"
+			"scx_slo_reserve_resizes_total{direction=\"grow\"} %llu\n"
+			"scx_slo_reserve_resizes_total{direction=\"shrink\"} %llu\n",
+			res.cpus, res.limit, res.eligible, res.last_miss, res.last_slack,
+			(unsigned long long)res.grows, (unsigned long long)res.shrinks);
+	}
+
+	if (cpuperf_percpu)
+		write_cpuperf_metrics(&mb);
+
+	if (burst_enabled)
+		write_burst_metrics(&mb);
+
+	if (shadow_mode)
+		write_shadow_metrics(&mb);
+
+	metrics_printf(&mb,
+		"\n"
+		"# HELP scx_slo_time_to_enforcement_seconds Time from agent start until the scheduler was attached\n"
+		"# TYPE scx_slo_time_to_enforcement_seconds gauge\n"
+		"scx_slo_time_to_enforcement_seconds %.6f\n"
+		"\n"
+		"# HELP scx_slo_startup_phase_seconds Duration of each agent startup phase\n"
+		"# TYPE scx_slo_startup_phase_seconds gauge\n",
+		timeline_enforcement_ns(&timeline) / 1e9);
+	for (int i = 0; i < NR_STARTUP_PHASES; i++) {
+		__u64 ns = timeline_phase_ns(&timeline, i);
+
+		if (ns)
+			metrics_printf(&mb, "scx_slo_startup_phase_seconds{phase=\"%s\"} %.6f\n",
+				       timeline_phase_name(i), ns / 1e9);
+	}
+
+	if (cgroup_idx) {
+		__u64 unresolved, unresolved_ns;
+
+		metrics_printf(&mb,
+			"\n"
+			"# HELP scx_slo_indexed_cgroups Cgroups known to the ID index\n"
+			"# TYPE scx_slo_indexed_cgroups gauge\n"
+			"scx_slo_indexed_cgroups %zu\n"
+			"\n"
+			"# HELP scx_slo_cgroup_deadline_misses_total Deadline misses per cgroup\n"
+			"# TYPE scx_slo_cgroup_deadline_misses_total counter\n"
+			"# HELP scx_slo_cgroup_miss_duration_seconds_total Cumulative miss duration per cgroup\n"
+			"# TYPE scx_slo_cgroup_miss_duration_seconds_total counter\n",
+			cgroup_index_size(cgroup_idx));
+		cgroup_index_foreach(cgroup_idx, write_cgroup_misses, &mb);
+
+		cgroup_index_unresolved(cgroup_idx, &unresolved, &unresolved_ns);
+		if (unresolved) {
+			metrics_printf(&mb, "scx_slo_cgroup_deadline_misses_total"
+				       "{cgroup=\"unknown\",namespace=\"\",pod=\"\"} %llu\n",
+				       (unsigned long long)unresolved);
+			metrics_printf(&mb, "scx_slo_cgroup_miss_duration_seconds_total"
+				       "{cgroup=\"unknown\",namespace=\"\",pod=\"\"} %.6f\n",
+				       (double)unresolved_ns / 1e9);
+		}
+	}
 
-	if (len > 0 && (size_t)len < sizeof(metrics)) {
+	if (!mb.failed) {
 		send_http_response(client_fd, 200, "OK",
-				   "text/plain; version=0.0.4", metrics);
+				   "text/plain; version=0.0.4", mb.data);
 	} else {
 		send_http_response(client_fd, 500, "Internal Server Error",
 				   "text/plain", "Metrics buffer overflow\n");
 	}
+	free(mb.data);
 }
 
 /* Parse HTTP request and route to handler */
@@ -422,9 +1195,31 @@ static int handle_deadline_event(void *ctx, void *data, size_t data_sz)
 	total_miss_duration_ns += event->deadline_miss_ns;
 	pthread_mutex_unlock(&stats_lock);
 
-	if (verbose) {
-		log_msg(LOG_DEBUG, "DEADLINE MISS: cgroup=%llu miss=%.2fms timestamp=%llu",
-			(unsigned long long)event->cgroup_id,
+	if (cgroup_idx)
+		cgroup_index_record_miss(cgroup_idx, event->cgroup_id, event->deadline_miss_ns);
+
+	miss_summary_record(&miss_summary, event->cgroup_id, event->deadline_miss_ns);
+
+	if (ctl_server) {
+		struct slo_ctl_miss miss = {
+			.cgroup_id = event->cgroup_id,
+			.deadline_miss_ns = event->deadline_miss_ns,
+			.timestamp = event->timestamp,
+		};
+
+		ctl_server_publish_miss(ctl_server, &miss);
+	}
+
+	if (trace_events) {
+		struct cgroup_info info;
+		const char *path = "unknown";
+
+		if (cgroup_idx && cgroup_index_lookup(cgroup_idx, event->cgroup_id, &info) == 0 &&
+		    info.path[0])
+			path = info.path;
+
+		log_msg(LOG_INFO, "DEADLINE MISS: cgroup=%llu path=%s miss=%.2fms timestamp=%llu",
+			(unsigned long long)event->cgroup_id, path,
 			ns_to_ms(event->deadline_miss_ns),
 			(unsigned long long)event->timestamp);
 	}
@@ -432,6 +1227,131 @@ static int handle_deadline_event(void *ctx, void *data, size_t data_sz)
 	return 0;
 }
 
+/* One summary line per cgroup, labelled with its path when known */
+static void log_miss_summary_line(const struct miss_summary_line *line, void *ctx)
+{
+	struct cgroup_info info;
+	const char *path = "unknown";
+
+	(void)ctx;
+	if (cgroup_idx && cgroup_index_lookup(cgroup_idx, line->cgroup_id, &info) == 0 &&
+	    info.path[0])
+		path = info.path;
+
+	log_msg(LOG_INFO, "MISS SUMMARY: cgroup=%llu path=%s count=%llu%s max=%.2fms "
+		"p99=%.2fms total=%.2fms",
+		(unsigned long long)line->cgroup_id, path,
+		(unsigned long long)line->count, line->count_error ? "~" : "",
+		ns_to_ms(line->max_ns), ns_to_ms(line->p99_ns),
+		ns_to_ms(line->total_ns));
+}
+
+static void flush_miss_summary(void)
+{
+	__u64 events = miss_summary.total_events;
+	__u64 evictions = miss_summary.evictions;
+
+	if (events == 0)
+		return;
+
+	int lines = miss_summary_flush(&miss_summary, log_miss_summary_line, NULL);
+	if (evictions)
+		log_msg(LOG_INFO, "MISS SUMMARY: %llu misses, top %d cgroups shown (%llu slot evictions)",
+			(unsigned long long)events, lines, (unsigned long long)evictions);
+}
+
+/* Sum the shadow programs' per-CPU histograms for metrics and summaries */
+static void read_shadow_stats(struct scx_slo *skel)
+{
+	int nr_cpus = libbpf_num_possible_cpus();
+	struct slo_shadow_stats sums[NR_SLO_CLASSES];
+	struct slo_shadow_stats *percpu;
+	int fd = bpf_map__fd(skel->maps.shadow_stats);
+
+	percpu = calloc(nr_cpus, sizeof(*percpu));
+	if (!percpu)
+		return;
+
+	memset(sums, 0, sizeof(sums));
+	for (__u32 cls = 0; cls < NR_SLO_CLASSES; cls++)
+		if (bpf_map_lookup_elem(fd, &cls, percpu) == 0)
+			shadow_stats_sum(&sums[cls], percpu, nr_cpus);
+	free(percpu);
+
+	pthread_mutex_lock(&stats_lock);
+	memcpy(shadow_totals, sums, sizeof(sums));
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/* Copy the scheduler's per-CPU performance targets for the metrics endpoint */
+static void read_cpuperf(struct scx_slo *skel)
+{
+	struct slo_cpu_perf *percpu;
+	__u32 zero = 0;
+
+	if (skel->bss->cpuperf_unsupported && !cpuperf_warned) {
+		log_msg(LOG_WARN, "CPU performance targets unavailable: the kernel lacks "
+			"scx_bpf_cpuperf_set (Linux 6.11+)");
+		cpuperf_warned = true;
+	}
+
+	percpu = calloc(cpuperf_nr_cpus, sizeof(*percpu));
+	if (!percpu)
+		return;
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.cpu_perf), &zero, percpu) == 0) {
+		pthread_mutex_lock(&stats_lock);
+		memcpy(cpuperf_percpu, percpu, cpuperf_nr_cpus * sizeof(*percpu));
+		pthread_mutex_unlock(&stats_lock);
+	}
+	free(percpu);
+}
+
+/* Sum the scheduler's per-CPU burst prediction counters */
+static void read_burst_stats(struct scx_slo *skel)
+{
+	struct slo_burst_stats *percpu, sum;
+	__u32 zero = 0;
+
+	percpu = calloc(burst_nr_cpus, sizeof(*percpu));
+	if (!percpu)
+		return;
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.burst_stats), &zero, percpu) == 0) {
+		burst_stats_sum(&sum, percpu, burst_nr_cpus);
+		pthread_mutex_lock(&stats_lock);
+		burst_totals = sum;
+		pthread_mutex_unlock(&stats_lock);
+	}
+	free(percpu);
+}
+
+/* One line per latency class with runs observed since the last summary */
+static void log_shadow_summary(void)
+{
+	struct slo_shadow_stats cur[NR_SLO_CLASSES], d;
+
+	pthread_mutex_lock(&stats_lock);
+	memcpy(cur, shadow_totals, sizeof(cur));
+	pthread_mutex_unlock(&stats_lock);
+
+	for (__u32 cls = 0; cls < NR_SLO_CLASSES; cls++) {
+		__u64 runs;
+
+		shadow_stats_delta(&d, &cur[cls], &shadow_logged[cls]);
+		runs = d.slack.count + d.lateness.count;
+		if (!runs)
+			continue;
+
+		log_msg(LOG_INFO, "SHADOW SUMMARY: class=%s runs=%llu would_miss=%llu (%.2f%%) "
+			"delay_p99<=%.2fms slack_p50<=%.2fms late_p99<=%.2fms",
+			slo_class_name(cls), (unsigned long long)runs,
+			(unsigned long long)d.lateness.count, 100.0 * d.lateness.count / runs,
+			ns_to_ms(shadow_hist_percentile(&d.delay, 99)),
+			ns_to_ms(shadow_hist_percentile(&d.slack, 50)),
+			ns_to_ms(shadow_hist_percentile(&d.lateness, 99)));
+	}
+	memcpy(shadow_logged, cur, sizeof(cur));
+}
+
 static void read_stats(struct scx_slo *skel, __u64 *stats)
 {
 	int nr_cpus = libbpf_num_possible_cpus();
@@ -459,108 +1379,1773 @@ static void read_stats(struct scx_slo *skel, __u64 *stats)
 	pthread_mutex_unlock(&stats_lock);
 }
 
-static enum log_level parse_log_level(const char *level)
+static struct slo_map_fds slo_map_fds(struct scx_slo *skel)
 {
-	if (strcasecmp(level, "debug") == 0) return LOG_DEBUG;
-	if (strcasecmp(level, "info") == 0) return LOG_INFO;
-	if (strcasecmp(level, "warn") == 0 || strcasecmp(level, "warning") == 0) return LOG_WARN;
-	if (strcasecmp(level, "error") == 0) return LOG_ERROR;
-	return LOG_INFO;  /* Default */
+	struct slo_map_fds fds = {
+		.slo_maps = bpf_map__fd(skel->maps.slo_maps),
+		.slo_gen = bpf_map__fd(skel->maps.slo_gen),
+	};
+	return fds;
 }
 
-int main(int argc, char **argv)
+/* max_entries of the map pinned at @path, or 0 if there is none */
+static __u32 pinned_max_entries(const char *path)
 {
-	struct scx_slo *skel = NULL;
-	struct bpf_link *link = NULL;
-	struct ring_buffer *rb = NULL;
-	int opt;
-	__u64 ecode;
-	int err = 0;
+	struct bpf_map_info info = {0};
+	__u32 info_len = sizeof(info);
+	int fd = bpf_obj_get(path);
 
-	libbpf_set_print(libbpf_print_fn);
+	if (fd < 0)
+		return 0;
+	if (bpf_map_get_info_by_fd(fd, &info, &info_len) != 0)
+		info.max_entries = 0;
+	close(fd);
+	return info.max_entries;
+}
 
-	/* Set up signal handlers */
-	struct sigaction sa = {
-		.sa_handler = sigint_handler,
-		.sa_flags = 0
-	};
-	sigemptyset(&sa.sa_mask);
-	sigaction(SIGINT, &sa, NULL);
-	sigaction(SIGTERM, &sa, NULL);
-	signal(SIGPIPE, SIG_IGN);
+/*
+ * Size the maps before load. libbpf only reuses a pinned map of the same
+ * size, so pinned maps keep theirs: task contexts, which enqueue rebuilds,
+ * get a fresh map instead, and the pinned SLO map is replaced by a map of
+ * the new size on the next published config generation.
+ */
+static int size_maps(struct scx_slo *skel)
+{
+	__u32 pinned;
+
+	map_sizes_for_node(&map_sizes, read_pid_max(), libbpf_num_possible_cpus());
+	if (map_size_spec && map_sizes_parse(&map_sizes, map_size_spec) != 0)
+		return -EINVAL;
+
+	/* Shadow mode leaves the scheduler's task contexts alone */
+	pinned = shadow_mode ? 0 : pinned_max_entries(TASK_CTX_PIN_PATH);
+	if (pinned && pinned != map_sizes.tasks) {
+		log_msg(LOG_INFO, "Replacing pinned task_ctx_map of %u entries", pinned);
+		if (unlink(TASK_CTX_PIN_PATH) != 0)
+			map_sizes.tasks = pinned;
+	}
 
-	/* Handle --create-config first */
-	for (int i = 1; i < argc; i++) {
-		if (strcmp(argv[i], "--create-config") == 0) {
-			return create_example_config() == 0 ? 0 : 1;
-		}
+	pinned = pinned_max_entries(SLO_MAP_PIN_PATH);
+	if (pinned && pinned != map_sizes.cgroups) {
+		log_msg(LOG_INFO, "Pinned SLO map holds %u entries, resized to %u on the "
+			"next config generation", pinned, map_sizes.cgroups);
+	} else {
+		pinned = map_sizes.cgroups;
 	}
+	bpf_map__set_max_entries(skel->maps.slo_map, pinned);
+	slo_config_set_map_capacity(map_sizes.cgroups);
 
-restart:
-	skel = SCX_OPS_OPEN(slo_ops, scx_slo);
+	pthread_mutex_lock(&stats_lock);
+	slo_map_capacity = pinned;
+	pthread_mutex_unlock(&stats_lock);
 
-	while ((opt = getopt(argc, argv, "vcp:jl:h")) != -1) {
-		switch (opt) {
-		case 'v':
-			verbose = true;
-			break;
-		case 'c':
-			reload_config = true;
-			break;
-		case 'p':
-			health_port = atoi(optarg);
-			break;
-		case 'j':
-			json_logging = true;
-			break;
-		case 'l':
-			current_log_level = parse_log_level(optarg);
-			break;
-		default:
-			fprintf(stderr, help_fmt, basename(argv[0]));
-			return opt != 'h';
-		}
-	}
+	if (bpf_map__set_max_entries(skel->maps.task_ctx_map, map_sizes.tasks) != 0 ||
+	    bpf_map__set_max_entries(skel->maps.shadow_task_ctx, map_sizes.tasks) != 0 ||
+	    bpf_map__set_max_entries(skel->maps.deadline_events, map_sizes.ringbuf) != 0 ||
+	    bpf_map__set_max_entries(skel->maps.slo_stats, map_sizes.cgroups) != 0 ||
+	    bpf_map__set_max_entries(skel->maps.slo_targets, map_sizes.cgroups) != 0)
+		return -EINVAL;
 
-	/* Reset getopt for potential restart */
-	optind = 1;
+	log_msg(LOG_INFO, "Map sizes: %u task contexts, %u cgroups, %u KiB event ring",
+		map_sizes.tasks, map_sizes.cgroups, map_sizes.ringbuf / 1024);
+	return 0;
+}
 
-	err = SCX_OPS_LOAD(skel, slo_ops, scx_slo, uei);
-	if (err) {
-		log_msg(LOG_ERROR, "Failed to load BPF program: %d", err);
-		goto cleanup;
-	}
+/*
+ * The object holds both the scheduler and the shadow programs; load only
+ * the ones of this mode. Shadow mode must load on kernels without
+ * sched_ext, so nothing of the scheduler is created there, not even its
+ * pinned task contexts.
+ */
+static int select_programs(struct scx_slo *skel)
+{
+	struct bpf_program *prog;
 
-	link = SCX_OPS_ATTACH(skel, slo_ops, scx_slo);
-	if (!link) {
-		log_msg(LOG_ERROR, "Failed to attach BPF program");
-		err = -1;
-		goto cleanup;
+	bpf_object__for_each_program(prog, skel->obj) {
+		bool sched = bpf_program__type(prog) == BPF_PROG_TYPE_STRUCT_OPS;
+
+		if (bpf_program__set_autoload(prog, sched != shadow_mode) != 0)
+			return -EINVAL;
+	}
+
+	if (shadow_mode) {
+		task_map_name = bpf_map__name(skel->maps.shadow_task_ctx);
+		if (bpf_map__set_autocreate(skel->maps.slo_ops, false) != 0 ||
+		    bpf_map__set_autocreate(skel->maps.task_ctx_map, false) != 0)
+			return -EINVAL;
+	} else if (bpf_map__set_autocreate(skel->maps.shadow_task_ctx, false) != 0 ||
+		   bpf_map__set_autocreate(skel->maps.shadow_stats, false) != 0) {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * Entries in hash map @fd, read a batch at a time; key by key on kernels
+ * without batch lookups. Returns the count or -errno.
+ */
+static long count_map_entries(int fd, __u32 key_size, __u32 value_size)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	__u64 in_batch, out_batch, key[2];
+	void *keys, *vals;
+	long nr = 0;
+	__u32 count;
+	int err;
+
+	keys = malloc(OCCUPANCY_BATCH * key_size);
+	vals = malloc(OCCUPANCY_BATCH * value_size);
+	if (!keys || !vals) {
+		nr = -ENOMEM;
+		goto out;
+	}
+
+	for (bool first = true;; first = false) {
+		count = OCCUPANCY_BATCH;
+		err = bpf_map_lookup_batch(fd, first ? NULL : &in_batch, &out_batch,
+					   keys, vals, &count, &opts);
+		if (err && errno != ENOENT)
+			break;
+		nr += count;
+		if (err)
+			goto out;
+		in_batch = out_batch;
+	}
+
+	nr = 0;
+	if (key_size > sizeof(key[0])) {
+		nr = -EINVAL;
+		goto out;
+	}
+	for (void *prev = NULL; bpf_map_get_next_key(fd, prev, &key[nr & 1]) == 0; nr++)
+		prev = &key[nr & 1];
+
+out:
+	free(keys);
+	free(vals);
+	return nr;
+}
+
+/* Count what the scheduler's maps hold, for the metrics endpoint */
+static void update_occupancy(struct scx_slo *skel, struct ring_buffer *rb)
+{
+	struct bpf_map_info info = {0};
+	__u32 info_len = sizeof(info), zero = 0, active_id;
+	long task_entries, slo_entries = -1;
+	__u64 pending;
+	int fd;
+
+	if (shadow_mode)
+		task_entries = count_map_entries(bpf_map__fd(skel->maps.shadow_task_ctx),
+						 sizeof(__u32), bpf_map__value_size(skel->maps.shadow_task_ctx));
+	else
+		task_entries = count_map_entries(bpf_map__fd(skel->maps.task_ctx_map),
+						 sizeof(__u32), sizeof(struct slo_task_ctx));
+
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.slo_maps), &zero, &active_id) == 0 &&
+	    (fd = bpf_map_get_fd_by_id(active_id)) >= 0) {
+		if (bpf_map_get_info_by_fd(fd, &info, &info_len) == 0)
+			slo_entries = count_map_entries(fd, info.key_size, info.value_size);
+		close(fd);
+	}
+
+	pending = ring__avail_data_size(ring_buffer__ring(rb, 0));
+
+	pthread_mutex_lock(&stats_lock);
+	gc_exit_deleted = skel->bss->nr_cgroup_exit_deletes;
+	task_ctx_entries = task_entries;
+	slo_map_entries = slo_entries;
+	if (info.max_entries)
+		slo_map_capacity = info.max_entries;
+	ringbuf_pending = pending;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/*
+ * Read every entry of hash map @fd, keyed by cgroup ID, into @keys and
+ * @vals (room for @max each). Values of @value_size bytes are dropped if
+ * @vals is NULL. Returns the count or -errno.
+ */
+static long read_map_entries(int fd, __u64 *keys, void *vals, __u32 value_size, __u32 max)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	void *scratch = NULL;
+	__u64 in_batch, out_batch, *prev = NULL;
+	__u32 count, nr = 0;
+	int err = 0;
+
+	if (!vals) {
+		scratch = malloc((size_t)OCCUPANCY_BATCH * value_size);
+		if (!scratch)
+			return -ENOMEM;
+	}
+
+	while (nr < max) {
+		count = max - nr < OCCUPANCY_BATCH ? max - nr : OCCUPANCY_BATCH;
+		err = bpf_map_lookup_batch(fd, nr ? &in_batch : NULL, &out_batch, keys + nr,
+					   vals ? (char *)vals + (size_t)nr * value_size : scratch,
+					   &count, &opts);
+		if (err && errno != ENOENT)
+			break;
+		nr += count;
+		in_batch = out_batch;
+		if (err)
+			break;
+	}
+
+	if (err && errno != ENOENT) {
+		nr = 0;
+		while (nr < max && bpf_map_get_next_key(fd, prev, &keys[nr]) == 0) {
+			prev = &keys[nr];
+			/* Skip keys deleted since get_next_key returned them */
+			if (!vals || bpf_map_lookup_elem(fd, &keys[nr],
+							 (char *)vals + (size_t)nr * value_size) == 0)
+				nr++;
+		}
+	}
+	free(scratch);
+	return nr;
+}
+
+/*
+ * Delete the entries of removed cgroups from the SLO map in effect, and
+ * forget the config rules that name them. The scheduler's cgroup_exit
+ * usually got there first; this catches cgroups removed while no
+ * scheduler was attached or on kernels without cgroup callbacks.
+ */
+static void sweep_slo_map(struct scx_slo *skel)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	struct bpf_map_info info = {0};
+	__u32 info_len = sizeof(info), zero = 0, active_id, count;
+	struct timespec t0, t1;
+	__u64 *keys = NULL;
+	long nr, dead = 0, dropped;
+	int fd = -1;
+
+	if (cgroup_gc_fd < 0)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	dropped = slo_config_gc(cgroup_alive_by_handle, &cgroup_gc_fd);
+	if (dropped < 0)
+		goto fail;
+
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.slo_maps), &zero, &active_id) != 0 ||
+	    (fd = bpf_map_get_fd_by_id(active_id)) < 0 ||
+	    bpf_map_get_info_by_fd(fd, &info, &info_len) != 0) {
+		dead = -errno;
+		goto fail;
+	}
+	keys = malloc((info.max_entries + 1) * sizeof(*keys));
+	if (!keys) {
+		dead = -ENOMEM;
+		goto fail;
+	}
+	nr = read_map_entries(fd, keys, NULL, sizeof(struct slo_cfg), info.max_entries);
+	dead = nr < 0 ? nr : cgroup_gc_partition(keys, nr, cgroup_alive_by_handle, &cgroup_gc_fd);
+	if (dead < 0)
+		goto fail;
+
+	/* Keys deleted since the lookup stop a batch delete; finish one by one */
+	count = dead;
+	if (dead && bpf_map_delete_batch(fd, keys, &count, &opts) != 0) {
+		for (long i = count; i < dead; i++)
+			bpf_map_delete_elem(fd, &keys[i]);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	pthread_mutex_lock(&stats_lock);
+	gc_sweep_deleted += dead;
+	gc_config_dropped += dropped;
+	slo_map_entries = nr - dead;
+	last_gc_sweep_ns = (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+	pthread_mutex_unlock(&stats_lock);
+
+	if (dead || dropped)
+		log_msg(LOG_INFO, "Removed %ld SLO map entries and %ld config rules of "
+			"deleted cgroups", dead, dropped);
+	goto out;
+
+fail:
+	log_msg(LOG_WARN, "SLO map sweep failed: %s", strerror(-(dropped < 0 ? dropped : dead)));
+out:
+	free(keys);
+	if (fd >= 0)
+		close(fd);
+}
+
+/* Sweep only where handles are cgroup IDs and can be opened */
+static void start_cgroup_gc(void)
+{
+	if (cgroup_gc_fd >= 0)
+		return;
+
+	cgroup_gc_fd = cgroup_gc_open_root(CGROUP_FS_ROOT);
+	if (cgroup_gc_fd < 0) {
+		log_msg(LOG_WARN, "Cannot check cgroup liveness under %s: %s "
+			"(stale SLO entries only removed on cgroup exit)",
+			CGROUP_FS_ROOT, strerror(-cgroup_gc_fd));
+		cgroup_gc_fd = -1;
+	}
+}
+
+/*
+ * Send the tasks the scheduler queued without an SLO back to the fair
+ * class. Runs before each scan, which takes back any that are configured
+ * again by now.
+ */
+static void drain_strays(struct scx_slo *skel)
+{
+	int fd = bpf_map__fd(skel->maps.slo_strays);
+	__u32 max = bpf_map__max_entries(skel->maps.slo_strays);
+	pid_t *tids, *prev = NULL;
+	size_t nr = 0, reverted;
+
+	tids = malloc(max * sizeof(*tids));
+	if (!tids)
+		return;
+	while (nr < max && bpf_map_get_next_key(fd, prev, &tids[nr]) == 0) {
+		prev = &tids[nr];
+		nr++;
+	}
+	for (size_t i = 0; i < nr; i++)
+		bpf_map_delete_elem(fd, &tids[i]);
+
+	reverted = partial_switch_revert(partial_switch, tids, nr);
+	free(tids);
+
+	pthread_mutex_lock(&stats_lock);
+	partial_strays += nr;
+	pthread_mutex_unlock(&stats_lock);
+	if (reverted)
+		log_msg(LOG_DEBUG, "Partial mode: moved %zu stray threads back to the fair class",
+			reverted);
+}
+
+/* Bring thread policies in line with the SLO map in effect */
+static void partial_scan(struct scx_slo *skel)
+{
+	struct bpf_map_info info = {0};
+	__u32 info_len = sizeof(info), zero = 0, active_id;
+	struct cgroup_info cg;
+	__u64 *keys = NULL;
+	char **paths = NULL;
+	size_t nr_paths = 0;
+	long nr;
+	int fd = -1, ret;
+
+	partial_scan_req = 0;
+	drain_strays(skel);
+
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.slo_maps), &zero, &active_id) != 0 ||
+	    (fd = bpf_map_get_fd_by_id(active_id)) < 0 ||
+	    bpf_map_get_info_by_fd(fd, &info, &info_len) != 0) {
+		ret = -errno;
+		goto out;
+	}
+	keys = malloc((info.max_entries + 1) * sizeof(*keys));
+	paths = malloc((info.max_entries + 1) * sizeof(*paths));
+	if (!keys || !paths) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	nr = read_map_entries(fd, keys, NULL, sizeof(struct slo_cfg), info.max_entries);
+	if (nr < 0) {
+		ret = nr;
+		goto out;
+	}
+
+	/* IDs the index has not seen yet are picked up by a later scan */
+	for (long i = 0; i < nr; i++) {
+		if (cgroup_index_lookup(cgroup_idx, keys[i], &cg) != 0 || !cg.path[0])
+			continue;
+		paths[nr_paths] = strdup(cg.path);
+		if (paths[nr_paths])
+			nr_paths++;
+	}
+
+	ret = partial_switch_scan(partial_switch, (const char *const *)paths, nr_paths);
+	if (ret > 0)
+		log_msg(LOG_DEBUG, "Partial mode: moved %d threads of %zu cgroups to SCHED_EXT",
+			ret, nr_paths);
+out:
+	if (ret < 0)
+		log_msg(LOG_WARN, "Partial mode scan failed: %s", strerror(-ret));
+	for (size_t i = 0; i < nr_paths; i++)
+		free(paths[i]);
+	free(paths);
+	free(keys);
+	if (fd >= 0)
+		close(fd);
+}
+
+/* Partial mode finds the threads of a cgroup ID through the cgroup index */
+static int start_partial_switch(void)
+{
+	if (!partial_mode || partial_switch)
+		return 0;
+
+	if (!cgroup_idx) {
+		log_msg(LOG_ERROR, "Partial mode needs the cgroup index to find configured cgroups");
+		return -ENOENT;
+	}
+	partial_switch = partial_switch_new(CGROUP_FS_ROOT, inherit_depth, NULL);
+	if (!partial_switch) {
+		int err = -errno;
+
+		log_msg(LOG_ERROR, "Cannot open %s for partial mode: %s",
+			CGROUP_FS_ROOT, strerror(-err));
+		return err;
+	}
+	log_msg(LOG_INFO, "Partial mode: only threads of configured cgroups are scheduled");
+	return 0;
+}
+
+static int ctl_apply(const __u64 *set_keys, const struct slo_cfg *set_vals, size_t nr_set,
+		     const __u64 *del_keys, size_t nr_del, bool *shadowed, void *ctx)
+{
+	struct slo_map_fds fds = slo_map_fds(ctx);
+	size_t nr_shadowed = 0;
+	int err;
+
+	err = slo_config_apply_external(&fds, set_keys, set_vals, nr_set, del_keys, nr_del,
+					shadowed);
+	if (err)
+		log_msg(LOG_WARN, "Control socket update of %zu entries failed: %s",
+			nr_set + nr_del, strerror(-err));
+	for (size_t i = 0; i < nr_set + nr_del; i++)
+		nr_shadowed += shadowed[i];
+
+	pthread_mutex_lock(&stats_lock);
+	ctl_shadowed += nr_shadowed;
+	pthread_mutex_unlock(&stats_lock);
+	partial_scan_req = 1;
+	return err;
+}
+
+static void ctl_query(struct slo_ctl_state *st, void *ctx)
+{
+	struct scx_slo *skel = ctx;
+	struct cgroup_info info;
+	__u32 zero = 0, active_id;
+	int fd;
+
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.slo_maps), &zero, &active_id) == 0 &&
+	    (fd = bpf_map_get_fd_by_id(active_id)) >= 0) {
+		st->present = bpf_map_lookup_elem(fd, &st->cgroup_id, &st->cfg) == 0;
+		close(fd);
+	}
+	/* Clients see the SLO they set, not the controller's adjustment of it */
+	if (st->present && budget_ctl)
+		budget_ctl_base(budget_ctl, st->cgroup_id, &st->cfg, &st->cfg);
+	if (st->present && admission)
+		admission_base(admission, st->cgroup_id, &st->cfg, &st->cfg);
+	if (cgroup_idx && cgroup_index_lookup(cgroup_idx, st->cgroup_id, &info) == 0) {
+		st->deadline_misses = info.deadline_misses;
+		st->miss_duration_ns = info.miss_duration_ns;
+	}
+}
+
+static void start_ctl_server(struct scx_slo *skel)
+{
+	struct ctl_ops ops = { .apply = ctl_apply, .query = ctl_query, .ctx = skel };
+
+	if (!ctl_sock_path[0] || ctl_server)
+		return;
+	ctl_server = ctl_server_start(ctl_sock_path, &ops);
+	if (!ctl_server)
+		log_msg(LOG_WARN, "Control socket %s unavailable: %s", ctl_sock_path,
+			strerror(errno));
+}
+
+static void stop_ctl_server(void)
+{
+	ctl_server_stop(ctl_server);
+	ctl_server = NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	__u64 x = *(const __u64 *)a, y = *(const __u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Index of @key in sorted @keys, or -1 */
+static long find_u64(const __u64 *keys, long nr, __u64 key)
+{
+	const __u64 *hit = bsearch(&key, keys, nr, sizeof(*keys), cmp_u64);
+
+	return hit ? hit - keys : -1;
+}
+
+/* Delete @nr keys in one batch, finishing key by key past any that vanished */
+static void delete_keys(int fd, __u64 *keys, __u32 nr)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	__u32 count = nr;
+
+	if (nr && bpf_map_delete_batch(fd, keys, &count, &opts) != 0) {
+		for (__u32 i = count; i < nr; i++)
+			bpf_map_delete_elem(fd, &keys[i]);
+	}
+}
+
+/*
+ * Publish the configured deadline of every adjusted entry, so the
+ * scheduler keeps counting misses against the SLO, and drop the rest.
+ */
+static void write_targets(struct scx_slo *skel, __u32 max)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts, .elem_flags = BPF_ANY);
+	int fd = bpf_map__fd(skel->maps.slo_targets);
+	struct budget_ctl_target *t = malloc((max + 1) * sizeof(*t));
+	struct slo_target *vals = malloc((max + 1) * sizeof(*vals));
+	__u64 *keys = malloc((max + 1) * sizeof(*keys));
+	__u64 *old = malloc((max + 1) * sizeof(*old));
+	long nr_old, stale = 0;
+	__u32 nr, count;
+
+	if (!t || !vals || !keys || !old)
+		goto out;
+
+	nr = budget_ctl_targets(budget_ctl, t, max);
+	for (__u32 i = 0; i < nr; i++) {
+		keys[i] = t[i].cgroup_id;
+		vals[i] = t[i].target;
+	}
+	count = nr;
+	if (nr && bpf_map_update_batch(fd, keys, vals, &count, &opts) != 0) {
+		for (__u32 i = count; i < nr; i++)
+			bpf_map_update_elem(fd, &keys[i], &vals[i], BPF_ANY);
+	}
+
+	/* Targets come sorted by cgroup ID */
+	nr_old = read_map_entries(fd, old, NULL, sizeof(struct slo_target), max);
+	for (long i = 0; i < nr_old; i++) {
+		if (find_u64(keys, nr, old[i]) < 0)
+			old[stale++] = old[i];
+	}
+	delete_keys(fd, old, stale);
+out:
+	free(t);
+	free(vals);
+	free(keys);
+	free(old);
+}
+
+static int cmp_sample(const void *a, const void *b)
+{
+	const struct budget_ctl_sample *x = a, *y = b;
+
+	return x->cgroup_id < y->cgroup_id ? -1 : x->cgroup_id > y->cgroup_id;
+}
+
+/*
+ * Read the SLO map in effect and the run statistics of its entries with
+ * batch lookups, joined on the cgroup ID and sorted by it. Returns the
+ * number of samples in *@out, allocated for @max entries, or -1.
+ */
+static long read_samples(struct scx_slo *skel, const char *who,
+			 struct budget_ctl_sample **out, __u32 *max_out)
+{
+	struct bpf_map_info info = {0};
+	__u32 info_len = sizeof(info), zero = 0, active_id, max;
+	int fd = -1, stats_fd = bpf_map__fd(skel->maps.slo_stats);
+	__u64 *keys = NULL, *stat_keys = NULL;
+	struct slo_cfg *vals = NULL;
+	struct slo_cgrp_stats *stats = NULL;
+	struct budget_ctl_sample *samples = NULL;
+	long nr = -1, nr_stats, stale = 0;
+
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.slo_maps), &zero, &active_id) != 0 ||
+	    (fd = bpf_map_get_fd_by_id(active_id)) < 0 ||
+	    bpf_map_get_info_by_fd(fd, &info, &info_len) != 0) {
+		log_msg(LOG_WARN, "%s: cannot open SLO map: %s", who, strerror(errno));
+		goto out;
+	}
+	max = info.max_entries > map_sizes.cgroups ? info.max_entries : map_sizes.cgroups;
+
+	keys = malloc((max + 1) * sizeof(*keys));
+	vals = malloc((max + 1) * sizeof(*vals));
+	stat_keys = malloc((max + 1) * sizeof(*stat_keys));
+	stats = malloc((max + 1) * sizeof(*stats));
+	samples = malloc((max + 1) * sizeof(*samples));
+	if (!keys || !vals || !stat_keys || !stats || !samples)
+		goto out;
+
+	nr = read_map_entries(fd, keys, vals, sizeof(*vals), info.max_entries);
+	nr_stats = read_map_entries(stats_fd, stat_keys, stats, sizeof(*stats), map_sizes.cgroups);
+	if (nr < 0 || nr_stats < 0) {
+		log_msg(LOG_WARN, "%s: cannot read maps: %s", who,
+			strerror(-(nr < 0 ? nr : nr_stats)));
+		nr = -1;
+		goto out;
+	}
+
+	/* Entries without statistics have not run yet */
+	for (long i = 0; i < nr; i++)
+		samples[i] = (struct budget_ctl_sample){ .cgroup_id = keys[i], .cfg = vals[i] };
+	qsort(samples, nr, sizeof(*samples), cmp_sample);
+	for (long i = 0; i < nr_stats; i++) {
+		struct budget_ctl_sample key = { .cgroup_id = stat_keys[i] }, *hit;
+
+		hit = bsearch(&key, samples, nr, sizeof(*samples), cmp_sample);
+		if (hit)
+			hit->stats = stats[i];
+		else
+			stat_keys[stale++] = stat_keys[i];
+	}
+	/* Statistics of entries deleted through the control socket */
+	delete_keys(stats_fd, stat_keys, stale);
+
+	*out = samples;
+	*max_out = max;
+	samples = NULL;
+out:
+	if (fd >= 0)
+		close(fd);
+	free(keys);
+	free(vals);
+	free(stat_keys);
+	free(stats);
+	free(samples);
+	return nr;
+}
+
+/* Write @n controller updates in one batch, skipping entries changed meanwhile */
+static int write_updates(struct scx_slo *skel, const struct budget_ctl_update *u, size_t n,
+			 size_t *conflicts)
+{
+	struct slo_map_fds fds = slo_map_fds(skel);
+	__u64 *keys = malloc((n + 1) * sizeof(*keys));
+	struct slo_cfg *expected = malloc((n + 1) * sizeof(*expected));
+	struct slo_cfg *vals = malloc((n + 1) * sizeof(*vals));
+	int err = -ENOMEM;
+
+	if (keys && expected && vals) {
+		for (size_t i = 0; i < n; i++) {
+			keys[i] = u[i].cgroup_id;
+			expected[i] = u[i].expected;
+			vals[i] = u[i].cfg;
+		}
+		err = slo_config_adjust(&fds, keys, expected, vals, n, conflicts);
+	}
+	free(keys);
+	free(expected);
+	free(vals);
+	return err;
+}
+
+/*
+ * One interval of the adaptive budget controller: step it over the
+ * current samples and write the adjusted values back in one batch.
+ */
+static void adjust_budgets(struct scx_slo *skel)
+{
+	struct budget_ctl_sample *samples = NULL;
+	struct budget_ctl_update *updates = NULL;
+	size_t conflicts = 0;
+	__u32 max;
+	long nr;
+	int n, err;
+
+	nr = read_samples(skel, "Adaptive budgets", &samples, &max);
+	if (nr < 0)
+		return;
+	updates = malloc((max + 1) * sizeof(*updates));
+	if (!updates)
+		goto out;
+
+	if (adaptive_trace) {
+		struct budget_ctl_sample *base = malloc((nr + 1) * sizeof(*base));
+
+		if (base) {
+			for (long i = 0; i < nr; i++) {
+				base[i] = samples[i];
+				budget_ctl_base(budget_ctl, base[i].cgroup_id, &samples[i].cfg,
+						&base[i].cfg);
+			}
+			budget_ctl_trace_write(adaptive_trace,
+					       adaptive_params.interval_sec * 1000000000ULL, base, nr);
+			fflush(adaptive_trace);
+			free(base);
+		}
+	}
+
+	n = budget_ctl_step(budget_ctl, samples, nr, updates);
+	if (n < 0)
+		goto out;
+	write_targets(skel, max);
+	if (!n)
+		goto out;
+
+	err = write_updates(skel, updates, n, &conflicts);
+	if (err)
+		log_msg(LOG_WARN, "Adaptive budgets: writing %d entries failed: %s", n,
+			strerror(-err));
+	else
+		log_msg(LOG_DEBUG, "Adaptive budgets: adjusted %d entries (%zu changed meanwhile)",
+			n, conflicts);
+
+	pthread_mutex_lock(&stats_lock);
+	adaptive_conflicts += conflicts;
+	pthread_mutex_unlock(&stats_lock);
+out:
+	free(samples);
+	free(updates);
+}
+
+static void start_budget_ctl(void)
+{
+	if (!adaptive || budget_ctl)
+		return;
+	budget_ctl = budget_ctl_new(&adaptive_params);
+	if (!budget_ctl) {
+		log_msg(LOG_WARN, "Adaptive budgets unavailable: %s", strerror(errno));
+		return;
+	}
+	if (adaptive_params.trace[0]) {
+		adaptive_trace = fopen(adaptive_params.trace, "a");
+		if (!adaptive_trace)
+			log_msg(LOG_WARN, "Cannot record adaptive budget trace to %s: %s",
+				adaptive_params.trace, strerror(errno));
+	}
+	log_msg(LOG_INFO, "Adaptive budgets: target miss ratio %.3f, budget %.2f-%.2f of the "
+		"configured one, every %us", adaptive_params.target, adaptive_params.scale_min,
+		adaptive_params.scale_max, adaptive_params.interval_sec);
+}
+
+/* Put every adjusted entry back to its configured value, then stop */
+static void stop_budget_ctl(struct scx_slo *skel)
+{
+	struct budget_ctl_stats st;
+	struct budget_ctl_update *u;
+	size_t n;
+
+	if (!budget_ctl)
+		return;
+	budget_ctl_get_stats(budget_ctl, &st);
+	u = malloc((st.tracked + 1) * sizeof(*u));
+	if (u && skel) {
+		n = budget_ctl_restore(budget_ctl, u, st.tracked);
+		if (n && write_updates(skel, u, n, NULL) == 0)
+			log_msg(LOG_INFO, "Adaptive budgets: restored %zu configured SLOs", n);
+	}
+	free(u);
+
+	if (adaptive_trace) {
+		fclose(adaptive_trace);
+		adaptive_trace = NULL;
+	}
+	budget_ctl_free(budget_ctl);
+	budget_ctl = NULL;
+}
+
+static void read_health(struct scx_slo *skel, struct slo_health *out)
+{
+	int nr_cpus = libbpf_num_possible_cpus();
+	struct slo_health *percpu;
+	__u32 zero = 0;
+
+	memset(out, 0, sizeof(*out));
+	percpu = calloc(nr_cpus, sizeof(*percpu));
+	if (!percpu)
+		return;
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.health), &zero, percpu) == 0) {
+		for (int cpu = 0; cpu < nr_cpus; cpu++) {
+			out->runs += percpu[cpu].runs;
+			out->late += percpu[cpu].late;
+			out->delay_ns += percpu[cpu].delay_ns;
+			out->delays += percpu[cpu].delays;
+		}
+	}
+	free(percpu);
+}
+
+/* CPU time of the scheduler's programs so far, 0 without run time stats */
+static __u64 sched_prog_ns(struct scx_slo *skel)
+{
+	struct bpf_program *prog;
+	__u64 ns = 0;
+
+	if (bpf_stats_fd < 0)
+		return 0;
+	bpf_object__for_each_program(prog, skel->obj) {
+		struct bpf_prog_info info = {0};
+		__u32 len = sizeof(info);
+		int fd = bpf_program__fd(prog);
+
+		if (fd >= 0 && bpf_program__type(prog) == BPF_PROG_TYPE_STRUCT_OPS &&
+		    bpf_prog_get_info_by_fd(fd, &info, &len) == 0)
+			ns += info.run_time_ns;
+	}
+	return ns;
+}
+
+static __u64 monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Start the next interval from the counters as they are now */
+static void breaker_mark(struct scx_slo *skel)
+{
+	read_health(skel, &breaker_health);
+	breaker_sched_ns = sched_prog_ns(skel);
+	breaker_last_ns = monotonic_ns();
+}
+
+static void start_breaker(struct scx_slo *skel)
+{
+	if (!breaker_enabled || breaker)
+		return;
+	breaker = breaker_new(&breaker_params);
+	if (!breaker) {
+		log_msg(LOG_WARN, "Circuit breaker unavailable: %s", strerror(errno));
+		return;
+	}
+	bpf_stats_fd = bpf_enable_stats(BPF_STATS_RUN_TIME);
+	if (bpf_stats_fd < 0)
+		log_msg(LOG_WARN, "Cannot enable BPF run time stats: %s "
+			"(circuit breaker ignores scheduler CPU time)", strerror(errno));
+	breaker_mark(skel);
+	log_msg(LOG_INFO, "Circuit breaker: miss ratio %.3f, queueing delay %.0fus, "
+		"scheduler CPU %.3f, %u bad intervals of %us to trip, %us cooldown",
+		breaker_params.miss_max, breaker_params.delay_max_us, breaker_params.cpu_max,
+		breaker_params.trip_after, breaker_params.interval_sec, breaker_params.cooldown_sec);
+}
+
+static void stop_breaker(void)
+{
+	if (bpf_stats_fd >= 0)
+		close(bpf_stats_fd);
+	bpf_stats_fd = -1;
+	breaker_free(breaker);
+	breaker = NULL;
+	breaker_open = 0;
+}
+
+static void log_breaker_trip(const struct breaker_trip *t)
+{
+	const char *reason = breaker_reason_name(t->reason);
+
+	if (log_json_enabled()) {
+		log_raw("{\"timestamp\":\"%ld\",\"type\":\"breaker_trip\",\"reason\":\"%s\","
+			"\"value\":%.6f,\"threshold\":%.6f,\"bad_intervals\":%u,"
+			"\"cooldown_sec\":%u}",
+			time(NULL), reason, t->value, t->threshold, t->bad_intervals,
+			t->cooldown_sec);
+	} else {
+		log_msg(LOG_WARN, "Circuit breaker tripped: %s %.6f above %.6f for %u interval%s, "
+			"detaching the scheduler for %us", reason, t->value, t->threshold,
+			t->bad_intervals, t->bad_intervals == 1 ? "" : "s", t->cooldown_sec);
+	}
+}
+
+struct reattach_ctx {
+	struct scx_slo *skel;
+	struct bpf_link **link;
+};
+
+/*
+ * Not SCX_OPS_ATTACH: it aborts the agent when attaching fails, which
+ * is expected here, e.g. with another sched_ext scheduler loaded while
+ * this one was detached.
+ */
+static int reattach_scheduler(void *ctx)
+{
+	struct reattach_ctx *c = ctx;
+
+	*c->link = bpf_map__attach_struct_ops(c->skel->maps.slo_ops);
+	return *c->link ? 0 : -errno;
+}
+
+/*
+ * Feed the breaker the last interval and act on its verdict. Detaching
+ * destroys the struct_ops link, which hands every task back to the fair
+ * class; re-attaching links the loaded struct_ops map again.
+ */
+static void check_breaker(struct scx_slo *skel, struct bpf_link **link)
+{
+	struct breaker_sample s = { .nr_cpus = bpf_stats_fd >= 0 ? libbpf_num_possible_cpus() : 0 };
+	struct slo_health cur;
+	struct breaker_trip trip;
+	__u64 now = monotonic_ns(), sched_ns = 0;
+
+	if (!breaker_open) {
+		read_health(skel, &cur);
+		sched_ns = sched_prog_ns(skel);
+		s.interval_ns = now - breaker_last_ns;
+		s.runs = cur.runs - breaker_health.runs;
+		s.late = cur.late - breaker_health.late;
+		s.delay_ns = cur.delay_ns - breaker_health.delay_ns;
+		s.delays = cur.delays - breaker_health.delays;
+		s.sched_ns = sched_ns - breaker_sched_ns;
+		breaker_health = cur;
+		breaker_sched_ns = sched_ns;
+		breaker_last_ns = now;
+	}
+
+	switch (breaker_step(breaker, breaker_open ? NULL : &s, now, &trip)) {
+	case BREAKER_DETACH:
+		log_breaker_trip(&trip);
+		pthread_mutex_lock(&stats_lock);
+		last_breaker_trip = time(NULL);
+		pthread_mutex_unlock(&stats_lock);
+		breaker_open = 1;
+		scheduler_attached = 0;
+		bpf_link__destroy(*link);
+		*link = NULL;
+		/* Our own unregistration is not an exit for the main loop */
+		memset(&skel->data->uei, 0, sizeof(skel->data->uei));
+		break;
+	case BREAKER_ATTACH: {
+		struct reattach_ctx ctx = { .skel = skel, .link = link };
+		int err = breaker_reattach(breaker, now, reattach_scheduler, &ctx);
+
+		if (err) {
+			log_msg(LOG_ERROR, "Circuit breaker: re-attaching the scheduler failed (%s), "
+				"staying detached", strerror(-err));
+			break;
+		}
+		breaker_open = 0;
+		scheduler_attached = 1;
+		breaker_mark(skel);
+		log_msg(LOG_INFO, "Circuit breaker: scheduler re-attached, on probation for %us",
+			breaker_params.probation_sec);
+		break;
+	}
+	case BREAKER_NONE:
+		break;
+	}
+}
+
+/* Log when the node becomes overcommitted or the relax plan changes */
+static void log_admission(const struct admission_stats *st)
+{
+	const char *verb = admission_params.enforce ? "relaxed" : "would relax";
+
+	if (st->overcommitted == admission_logged.overcommitted &&
+	    st->relaxed == admission_logged.relaxed &&
+	    st->schedulable == admission_logged.schedulable)
+		return;
+	admission_logged = *st;
+
+	if (!st->overcommitted && !st->relaxed) {
+		log_msg(LOG_INFO, "Admission control: budgets fit on %u CPUs again, headroom %.3f",
+			st->cpus, st->headroom);
+		return;
+	}
+	log_msg(st->schedulable ? LOG_INFO : LOG_WARN,
+		"Admission control: headroom %.3f on %u CPUs (%.2f used by SLOs), %s %u "
+		"budgets for headroom %.3f%s", st->headroom, st->cpus, st->util, verb,
+		st->relaxed, st->headroom_relaxed,
+		st->schedulable ? "" : ", still overcommitted");
+}
+
+/*
+ * One admission check: estimate demand from the current samples, run the
+ * schedulability test, and in relax mode write the plan in one batch.
+ */
+static void check_admission(struct scx_slo *skel)
+{
+	struct budget_ctl_sample *samples = NULL;
+	struct budget_ctl_update *updates = NULL;
+	struct admission_stats st;
+	__u64 now = monotonic_ns();
+	size_t conflicts = 0;
+	__u32 max;
+	long nr;
+	int n, err;
+
+	nr = read_samples(skel, "Admission control", &samples, &max);
+	if (nr < 0)
+		return;
+	updates = malloc((max + 1) * sizeof(*updates));
+	if (!updates)
+		goto out;
+
+	n = admission_step(admission, samples, nr,
+			   admission_last_ns ? now - admission_last_ns : 0, updates);
+	admission_last_ns = now;
+	if (n < 0)
+		goto out;
+	admission_get_stats(admission, &st);
+	log_admission(&st);
+	if (!n)
+		goto out;
+
+	err = write_updates(skel, updates, n, &conflicts);
+	if (err)
+		log_msg(LOG_WARN, "Admission control: writing %d entries failed: %s", n,
+			strerror(-err));
+	else
+		log_msg(LOG_DEBUG, "Admission control: updated %d entries (%zu changed meanwhile)",
+			n, conflicts);
+
+	pthread_mutex_lock(&stats_lock);
+	admission_conflicts += conflicts;
+	pthread_mutex_unlock(&stats_lock);
+out:
+	free(samples);
+	free(updates);
+}
+
+static void start_admission(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (!admission_enabled || admission)
+		return;
+	admission = admission_new(&admission_params, cpus > 0 ? cpus : 1);
+	if (!admission) {
+		log_msg(LOG_WARN, "Admission control unavailable: %s", strerror(errno));
+		return;
+	}
+	admission_last_ns = 0;
+	memset(&admission_logged, 0, sizeof(admission_logged));
+	admission_logged.schedulable = true;
+	log_msg(LOG_INFO, "Admission control (%s): SLOs may claim %.0f%% of %ld CPUs, checked "
+		"every %us", admission_params.enforce ? "relax" : "dry run",
+		admission_params.util_max * 100, cpus, admission_params.interval_sec);
+}
+
+/* Put every relaxed entry back to its configured value, then stop */
+static void stop_admission(struct scx_slo *skel)
+{
+	struct admission_stats st;
+	struct budget_ctl_update *u;
+	size_t n;
+
+	if (!admission)
+		return;
+	admission_get_stats(admission, &st);
+	u = malloc((st.tracked + 1) * sizeof(*u));
+	if (u && skel) {
+		n = admission_restore(admission, u, st.tracked);
+		if (n && write_updates(skel, u, n, NULL) == 0)
+			log_msg(LOG_INFO, "Admission control: restored %zu configured SLOs", n);
+	}
+	free(u);
+	admission_free(admission);
+	admission = NULL;
+}
+
+/*
+ * Reserve the first @size CPUs of the order and release the rest. The
+ * scheduler's nr_reserved_cpus holds how many are reserved: it is raised
+ * to @size after the CPUs are marked and lowered to @size before they are
+ * cleared, so it never exceeds the number of CPUs marked.
+ */
+static void resize_partition(struct scx_slo *skel, __u32 size)
+{
+	int fd = bpf_map__fd(skel->maps.reserved_cpus);
+	__u32 on = size > reserve_size, from, to;
+
+	from = on ? reserve_size : size;
+	to = on ? size : reserve_size;
+	if (!on)
+		skel->bss->nr_reserved_cpus = size;
+	for (__u32 i = from; i < to; i++) {
+		if (bpf_map_update_elem(fd, &reserve_order[i], &on, BPF_ANY) != 0) {
+			log_msg(LOG_WARN, "Reserved partition: cannot update CPU %u: %s",
+				reserve_order[i], strerror(errno));
+			if (on) {
+				size = i;
+				break;
+			}
+		}
+	}
+	if (on)
+		skel->bss->nr_reserved_cpus = size;
+	reserve_size = size;
+}
+
+/* One interval of the partition controller */
+static void check_reserve(struct scx_slo *skel)
+{
+	struct budget_ctl_sample *samples = NULL;
+	struct reserve_stats st;
+	__u64 now = monotonic_ns();
+	__u32 max, old = reserve_size;
+	long nr;
+	int size;
+
+	nr = read_samples(skel, "Reserved partition", &samples, &max);
+	if (nr < 0)
+		return;
+	size = reserve_ctl_step(reserve_ctl, samples, nr,
+				reserve_last_ns ? now - reserve_last_ns : 0);
+	reserve_last_ns = now;
+	free(samples);
+	if (size < 0 || (__u32)size == reserve_size)
+		return;
+
+	resize_partition(skel, size);
+	reserve_ctl_get_stats(reserve_ctl, &st);
+	log_msg(LOG_INFO, "Reserved partition: %u -> %u CPUs (miss ratio %.4f, slack %.2f, "
+		"%.2f CPUs used)", old, reserve_size, st.last_miss, st.last_slack, st.util);
+}
+
+static void start_reserve(struct scx_slo *skel)
+{
+	__u32 nr_cpus = libbpf_num_possible_cpus();
+
+	if (!reserve_enabled || reserve_ctl)
+		return;
+	if (nr_cpus > bpf_map__max_entries(skel->maps.reserved_cpus))
+		nr_cpus = bpf_map__max_entries(skel->maps.reserved_cpus);
+	reserve_order = calloc(nr_cpus + 1, sizeof(*reserve_order));
+	if (reserve_order)
+		reserve_nr_order = reserve_cpu_order("/sys/devices/system/cpu", nr_cpus,
+						     reserve_order);
+	if (reserve_nr_order < 2) {
+		log_msg(LOG_WARN, "Reserved partition unavailable: %u usable CPUs",
+			reserve_nr_order);
+		goto fail;
+	}
+	reserve_ctl = reserve_ctl_new(&reserve_params, reserve_nr_order);
+	if (!reserve_ctl) {
+		log_msg(LOG_WARN, "Reserved partition unavailable: %s", strerror(errno));
+		goto fail;
+	}
+	reserve_size = 0;
+	reserve_last_ns = 0;
+	log_msg(LOG_INFO, "Reserved partition: up to %.0f%% of %u CPUs for critical cgroups and "
+		"importance >= %u, from CPU %u down", reserve_params.max_frac * 100,
+		reserve_nr_order, reserve_params.importance, reserve_order[0]);
+	return;
+fail:
+	free(reserve_order);
+	reserve_order = NULL;
+	reserve_nr_order = 0;
+}
+
+static void stop_reserve(struct scx_slo *skel)
+{
+	if (!reserve_ctl)
+		return;
+	if (skel)
+		resize_partition(skel, 0);
+	reserve_ctl_free(reserve_ctl);
+	reserve_ctl = NULL;
+	free(reserve_order);
+	reserve_order = NULL;
+	reserve_nr_order = 0;
+}
+
+static int apply_slo_config(const struct slo_map_fds *fds)
+{
+	struct slo_reload_stats st;
+	int config_entries;
+
+	timeline_begin(&timeline, PHASE_CONFIG);
+	config_entries = reload_slo_config(fds, true, &st);
+	timeline_end(&timeline, PHASE_CONFIG);
+
+	if (config_entries < 0) {
+		log_msg(LOG_ERROR, "Failed to load configuration");
+		return -1;
+	}
+	if (st.from_snapshot)
+		log_msg(LOG_INFO, "Loaded %d SLO configuration entries from %s "
+			"(%d paths resolved) in %.2fms", config_entries, SLO_SNAPSHOT_PATH,
+			st.resolved, ns_to_ms(st.duration_ns));
+	else
+		log_msg(LOG_INFO, "Loaded %d SLO configuration entries", config_entries);
+
+	pthread_mutex_lock(&stats_lock);
+	config_rules = config_entries;
+	config_generation = st.generation;
+	pthread_mutex_unlock(&stats_lock);
+	return 0;
+}
+
+/* Watch the config directory; ConfigMap updates swap a ..data symlink there */
+static void watch_config_dir(void)
+{
+	if (config_watch_fd >= 0)
+		return;
+
+	config_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (config_watch_fd < 0) {
+		log_msg(LOG_WARN, "Config watch unavailable: %s (reload with SIGHUP)", strerror(errno));
+		return;
+	}
+
+	if (inotify_add_watch(config_watch_fd, CONFIG_DIR,
+			      IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+			      IN_CREATE | IN_DELETE | IN_ONLYDIR) < 0) {
+		log_msg(LOG_WARN, "Cannot watch %s: %s (reload with SIGHUP)",
+			CONFIG_DIR, strerror(errno));
+		close(config_watch_fd);
+		config_watch_fd = -1;
+	}
+}
+
+/* Drain pending inotify events; true if any touched the config file */
+static bool config_changed(void)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool changed = false;
+	ssize_t len;
+
+	while ((len = read(config_watch_fd, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + len; ) {
+			const struct inotify_event *ev = (const struct inotify_event *)p;
+
+			if ((ev->mask & IN_Q_OVERFLOW) ||
+			    (ev->len && (strcmp(ev->name, CONFIG_FILE_NAME) == 0 ||
+					 strncmp(ev->name, "..", 2) == 0)))
+				changed = true;
+			p += sizeof(*ev) + ev->len;
+		}
+	}
+	return changed;
+}
+
+/* Apply config changes to the attached scheduler */
+static void reload_slo_map(struct scx_slo *skel, bool full)
+{
+	struct slo_reload_stats st;
+	struct slo_map_fds fds = slo_map_fds(skel);
+	int entries = reload_slo_config(&fds, full, &st);
+
+	pthread_mutex_lock(&stats_lock);
+	config_reloads++;
+	if (entries < 0)
+		config_reload_failures++;
+	if (entries >= 0)
+		config_rules = entries;
+	config_generation = st.generation;
+	last_config_reload_ns = st.duration_ns;
+	pthread_mutex_unlock(&stats_lock);
+
+	if (entries < 0) {
+		log_msg(LOG_ERROR, "Config reload failed, keeping previous rules");
+		return;
+	}
+	partial_scan_req = 1;
+	log_msg(LOG_INFO, "Config reloaded%s: %d rules, %d updated, %d removed, "
+		"%d paths resolved in %.2fms, generation %u",
+		full ? " (full)" : "", entries, st.upserted, st.deleted,
+		st.resolved, ns_to_ms(st.duration_ns), st.generation);
+}
+
+struct config_job {
+	struct slo_map_fds fds;
+	int err;
+};
+
+static void *config_thread_fn(void *arg)
+{
+	struct config_job *job = arg;
+
+	job->err = apply_slo_config(&job->fds);
+	return NULL;
+}
+
+static void build_cgroup_index(void)
+{
+	if (cgroup_idx)
+		return;
+
+	timeline_begin(&timeline, PHASE_CGROUP_INDEX);
+	cgroup_idx = cgroup_index_new(CGROUP_FS_ROOT);
+	if (cgroup_idx) {
+		int indexed = cgroup_index_build(cgroup_idx);
+		if (indexed < 0) {
+			log_msg(LOG_WARN, "Failed to index %s: %s (per-cgroup metrics disabled)",
+				CGROUP_FS_ROOT, strerror(-indexed));
+			cgroup_index_free(cgroup_idx);
+			cgroup_idx = NULL;
+		} else {
+			log_msg(LOG_INFO, "Indexed %d cgroups under %s", indexed, CGROUP_FS_ROOT);
+		}
+	}
+	timeline_end(&timeline, PHASE_CGROUP_INDEX);
+}
+
+static void on_cgroup_created(__u64 id, const char *path, void *ctx)
+{
+	(void)ctx;
+
+	if (slo_config_cgroup_created(id, path) > 0)
+		log_msg(LOG_DEBUG, "Applied SLO rule to new cgroup %s", path);
+}
+
+static void *cgroup_watch_fn(void *arg)
+{
+	struct pollfd pfd = { .fd = cgroup_index_fd(cgroup_idx), .events = POLLIN };
+
+	(void)arg;
+	while (cgroup_watch_running) {
+		int n = poll(&pfd, 1, 200);  /* Bounds the time to notice a stop */
+
+		if (n > 0)
+			cgroup_index_process_events(cgroup_idx);
+		else if (n < 0 && errno != EINTR)
+			break;
+	}
+	return NULL;
+}
+
+/*
+ * Follow cgroup creation on its own thread rather than the once-a-second
+ * main loop, so pattern rules reach new cgroups within milliseconds.
+ */
+static void start_cgroup_watch(void)
+{
+	if (!cgroup_idx || cgroup_index_fd(cgroup_idx) < 0 || cgroup_watch_running)
+		return;
+
+	if (reload_config)
+		cgroup_index_on_create(cgroup_idx, on_cgroup_created, NULL);
+	cgroup_watch_running = true;
+	if (pthread_create(&cgroup_watch_thread, NULL, cgroup_watch_fn, NULL) != 0) {
+		log_msg(LOG_WARN, "Failed to start cgroup watch thread, following cgroups from the main loop");
+		cgroup_watch_running = false;
+	}
+}
+
+/* Must run before the skeleton is destroyed: the callback writes its maps */
+static void stop_cgroup_watch(void)
+{
+	if (!cgroup_watch_running)
+		return;
+
+	cgroup_watch_running = false;
+	pthread_join(cgroup_watch_thread, NULL);
+	cgroup_index_on_create(cgroup_idx, NULL, NULL);
+}
+
+static int read_handoff(struct scx_slo *skel, struct slo_handoff *h)
+{
+	__u32 zero = 0;
+
+	return bpf_map_lookup_elem(bpf_map__fd(skel->maps.handoff), &zero, h);
+}
+
+static int write_handoff(struct scx_slo *skel, const struct slo_handoff *h)
+{
+	__u32 zero = 0;
+
+	return bpf_map_update_elem(bpf_map__fd(skel->maps.handoff), &zero, h, BPF_ANY);
+}
+
+/*
+ * Record the ownership generation of the pinned state. With @take_over the
+ * generation is bumped, and a running instance that sees it move past its
+ * own detaches so this one can attach.
+ */
+static int claim_handoff(struct scx_slo *skel, bool take_over)
+{
+	struct slo_handoff h;
+	int err;
+
+	err = read_handoff(skel, &h);
+	if (err)
+		return err;
+
+	if (take_over) {
+		h.generation++;
+		err = write_handoff(skel, &h);
+		if (err)
+			return err;
+	}
+
+	handoff_generation = h.generation;
+	return 0;
+}
+
+/* True once a newer instance has claimed the pinned state */
+static bool handoff_requested(struct scx_slo *skel)
+{
+	struct slo_handoff h;
+
+	if (read_handoff(skel, &h))
+		return false;
+	return h.generation != handoff_generation;
+}
+
+/* Report the detach-to-reattach gap recorded by the scheduler's exit/init */
+static void report_handoff(struct scx_slo *skel, bool took_over)
+{
+	struct slo_handoff h;
+	__u64 gap;
+
+	if (read_handoff(skel, &h))
+		return;
+
+	gap = handoff_gap_ns(&h);
+	if (took_over && gap) {
+		h.handoffs++;
+		write_handoff(skel, &h);
+	}
+
+	pthread_mutex_lock(&stats_lock);
+	last_handoff_gap_ns = gap;
+	completed_handoffs = h.handoffs;
+	pthread_mutex_unlock(&stats_lock);
+
+	if (took_over)
+		log_msg(LOG_INFO, "Handoff complete: scheduler gap %.3fms (handoff #%u)",
+			ns_to_ms(gap), h.handoffs);
+	else if (gap)
+		log_msg(LOG_INFO, "Previous scheduler instance detached %.3fms before attach",
+			ns_to_ms(gap));
+}
+
+int main(int argc, char **argv)
+{
+	struct scx_slo *skel = NULL;
+	struct bpf_link *link = NULL;
+	struct ring_buffer *rb = NULL;
+	int opt;
+	__u64 ecode;
+	int err = 0;
+	bool handed_off = false;
+	bool restarted = false;
+	bool config_before_attach;
+	struct config_job config_job = { .fds = { -1, -1 } };
+	pthread_t config_thread;
+	bool config_thread_started = false;
+	char timeline_buf[256];
+
+	libbpf_set_print(libbpf_print_fn);
+
+	/* Set up signal handlers */
+	struct sigaction sa = {
+		.sa_handler = sigint_handler,
+		.sa_flags = 0
+	};
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sa.sa_handler = sighup_handler;
+	sigaction(SIGHUP, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Handle --create-config and --compile-config first */
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--create-config") == 0) {
+			return create_example_config() == 0 ? 0 : 1;
+		}
+		if (strcmp(argv[i], "--compile-config") == 0) {
+			return compile_slo_config(SLO_SNAPSHOT_PATH) == 0 ? 0 : 1;
+		}
+	}
+
+restart:
+	budget_ctl_params_default(&adaptive_params);
+	breaker_params_default(&breaker_params);
+	admission_params_default(&admission_params);
+	reserve_params_default(&reserve_params);
+	cpuperf_params_default(&cpuperf_params);
+	burst_params_default(&burst_params);
+	while ((opt = getopt(argc, argv, "vtcHd:p:jl:s:m:u:aA:SPbB:eE:rR:fF:wW:h")) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = true;
+			break;
+		case 't':
+			trace_events = true;
+			break;
+		case 'c':
+			reload_config = true;
+			break;
+		case 'H':
+			handoff_mode = true;
+			break;
+		case 'd':
+			inherit_depth = atoi(optarg);
+			if (inherit_depth < 0 || inherit_depth > MAX_INHERIT_DEPTH) {
+				fprintf(stderr, "Inherit depth must be 0-%d\n", MAX_INHERIT_DEPTH);
+				return 1;
+			}
+			break;
+		case 'p':
+			health_port = atoi(optarg);
+			break;
+		case 'j':
+			log_set_json(true);
+			break;
+		case 'l':
+			log_set_level(parse_log_level(optarg));
+			break;
+		case 's':
+			summary_interval_sec = atoi(optarg);
+			break;
+		case 'm':
+			map_size_spec = optarg;
+			break;
+		case 'u':
+			ctl_sock_path = optarg;
+			break;
+		case 'a':
+			adaptive = true;
+			break;
+		case 'A':
+			adaptive = true;
+			if (budget_ctl_parse(&adaptive_params, optarg) != 0)
+				return 1;
+			break;
+		case 'S':
+			shadow_mode = true;
+			break;
+		case 'P':
+			partial_mode = true;
+			break;
+		case 'b':
+			breaker_enabled = true;
+			break;
+		case 'B':
+			breaker_enabled = true;
+			if (breaker_parse(&breaker_params, optarg) != 0)
+				return 1;
+			break;
+		case 'e':
+			admission_enabled = true;
+			break;
+		case 'E':
+			admission_enabled = true;
+			if (admission_parse(&admission_params, optarg) != 0)
+				return 1;
+			break;
+		case 'r':
+			reserve_enabled = true;
+			break;
+		case 'R':
+			reserve_enabled = true;
+			if (reserve_parse(&reserve_params, optarg) != 0)
+				return 1;
+			break;
+		case 'f':
+			cpuperf_enabled = true;
+			break;
+		case 'F':
+			cpuperf_enabled = true;
+			if (cpuperf_parse(&cpuperf_params, optarg) != 0)
+				return 1;
+			break;
+		case 'w':
+			burst_enabled = true;
+			break;
+		case 'W':
+			burst_enabled = true;
+			if (burst_parse(&burst_params, optarg) != 0)
+				return 1;
+			break;
+		default:
+			fprintf(stderr, help_fmt, basename(argv[0]));
+			return opt != 'h';
+		}
+	}
+
+	/* Reset getopt for potential restart */
+	optind = 1;
+
+	if (shadow_mode && partial_mode) {
+		fprintf(stderr, "Shadow mode (-S) and partial switch (-P) are exclusive\n");
+		return 1;
+	}
+	if (shadow_mode && breaker_enabled) {
+		fprintf(stderr, "Shadow mode (-S) has no scheduler for the circuit breaker (-b) to detach\n");
+		return 1;
+	}
+	if (shadow_mode && reserve_enabled) {
+		fprintf(stderr, "Shadow mode (-S) has no scheduler to reserve CPUs (-r) in\n");
+		return 1;
+	}
+	if (shadow_mode && cpuperf_enabled) {
+		fprintf(stderr, "Shadow mode (-S) leaves CPU frequency to the kernel; drop -f\n");
+		return 1;
+	}
+	if (shadow_mode && burst_enabled) {
+		fprintf(stderr, "Shadow mode (-S) has no scheduler to size slices for burst learning (-w)\n");
+		return 1;
+	}
+	if (adaptive && admission_params.enforce) {
+		fprintf(stderr, "Adaptive budgets (-a) and admission control in relax mode (-E mode=relax) "
+			"both write budgets; use one\n");
+		return 1;
+	}
+
+	/* Shadow mode must open on kernels the sched_ext checks would reject */
+	timeline_init(&timeline);
+	timeline_begin(&timeline, PHASE_OPEN);
+	skel = shadow_mode ? scx_slo__open() : SCX_OPS_OPEN(slo_ops, scx_slo);
+	timeline_end(&timeline, PHASE_OPEN);
+	if (!skel) {
+		fprintf(stderr, "Failed to open BPF skeleton\n");
+		return 1;
+	}
+
+	skel->rodata->slo_inherit_depth = inherit_depth;
+	skel->rodata->slo_adaptive = adaptive;
+	skel->rodata->slo_run_stats = adaptive || admission_enabled || reserve_enabled;
+	if (reserve_enabled)
+		skel->rodata->slo_reserve_importance = reserve_params.importance;
+	skel->rodata->slo_cpuperf = cpuperf_enabled;
+	skel->rodata->slo_perf_standard_min = cpuperf_params.standard_min;
+	skel->rodata->slo_perf_batch_max = cpuperf_params.batch_max;
+	skel->rodata->slo_perf_boost_slack = cpuperf_params.boost_slack;
+	if (cpuperf_enabled && !cpuperf_percpu) {
+		cpuperf_nr_cpus = libbpf_num_possible_cpus();
+		cpuperf_percpu = calloc(cpuperf_nr_cpus, sizeof(*cpuperf_percpu));
+		if (!cpuperf_percpu) {
+			log_msg(LOG_ERROR, "Cannot allocate CPU performance stats");
+			err = -ENOMEM;
+			goto cleanup;
+		}
+	}
+	skel->rodata->slo_burst = burst_enabled;
+	skel->rodata->slo_burst_shift = burst_params.shift;
+	skel->rodata->slo_burst_min_samples = burst_params.min_samples;
+	skel->rodata->slo_burst_short_ns = burst_params.short_ns;
+	skel->rodata->slo_burst_boost = burst_params.boost;
+	skel->rodata->slo_burst_slice_mult = burst_params.slice_mult;
+	skel->rodata->slo_burst_slice_min_ns = burst_params.slice_min_ns;
+	burst_nr_cpus = libbpf_num_possible_cpus();
+	skel->rodata->slo_partial = partial_mode;
+	skel->rodata->slo_breaker = breaker_enabled;
+	if (partial_mode)
+		skel->struct_ops.slo_ops->flags |= SCX_OPS_SWITCH_PARTIAL;
+
+	/* Move log output off the event loop (no-op on restart) */
+	if (log_init(STDOUT_FILENO) != 0)
+		fprintf(stderr, "Failed to start log writer, logging synchronously\n");
+
+	err = select_programs(skel);
+	if (!err)
+		err = size_maps(skel);
+	if (err)
+		goto cleanup;
+
+	/* Pinned maps from a previous or still-running instance are reused here */
+	timeline_begin(&timeline, PHASE_LOAD);
+	if (shadow_mode)
+		err = scx_slo__load(skel);
+	else
+		err = SCX_OPS_LOAD(skel, slo_ops, scx_slo, uei);
+	timeline_end(&timeline, PHASE_LOAD);
+	if (err) {
+		log_msg(LOG_ERROR, "Failed to load BPF program: %d", err);
+		goto cleanup;
+	}
+
+	/*
+	 * During a handoff the old scheduler is still enforcing, so the config
+	 * is applied up front for free. Otherwise attach first with whatever
+	 * the pinned SLO map holds (defaults on a fresh node) and load the
+	 * config in the background, so enforcement starts right after the
+	 * verifier finishes.
+	 */
+	config_before_attach = handoff_mode && !restarted;
+	if (reload_config && config_before_attach) {
+		struct slo_map_fds fds = slo_map_fds(skel);
+
+		err = apply_slo_config(&fds);
+		if (err)
+			goto cleanup;
+	}
+
+	err = claim_handoff(skel, handoff_mode && !restarted);
+	if (err) {
+		log_msg(LOG_ERROR, "Failed to claim handoff state: %d", err);
+		goto cleanup;
+	}
+
+	if (handoff_mode && !restarted) {
+		log_msg(LOG_INFO, "Handoff: waiting for running scheduler to detach");
+		timeline_begin(&timeline, PHASE_HANDOFF_WAIT);
+		err = handoff_wait_detached(SCHED_EXT_STATE_PATH, HANDOFF_TIMEOUT_MS);
+		timeline_end(&timeline, PHASE_HANDOFF_WAIT);
+		if (err) {
+			log_msg(LOG_ERROR, "Handoff: scheduler did not detach: %s", strerror(-err));
+			goto cleanup;
+		}
+	}
+
+	timeline_begin(&timeline, PHASE_ATTACH);
+	if (shadow_mode) {
+		/* The skeleton owns the tracepoint links */
+		err = scx_slo__attach(skel);
+	} else {
+		link = SCX_OPS_ATTACH(skel, slo_ops, scx_slo);
+		err = link ? 0 : -1;
+	}
+	timeline_end(&timeline, PHASE_ATTACH);
+	if (err) {
+		log_msg(LOG_ERROR, "Failed to attach BPF program");
+		err = -1;
+		goto cleanup;
 	}
 
 	scheduler_attached = 1;
-	log_msg(LOG_INFO, "BPF scheduler attached successfully");
+	if (shadow_mode) {
+		log_msg(LOG_INFO, "Shadow mode: observing scheduler tracepoints, not scheduling");
+	} else {
+		timeline_mark_enforced(&timeline);
+		log_msg(LOG_INFO, "BPF scheduler attached successfully");
+		report_handoff(skel, handoff_mode && !restarted);
+	}
 
 	/* Set up ring buffer for deadline events */
+	timeline_begin(&timeline, PHASE_RINGBUF);
 	rb = ring_buffer__new(bpf_map__fd(skel->maps.deadline_events),
 			      handle_deadline_event, NULL, NULL);
+	timeline_end(&timeline, PHASE_RINGBUF);
 	if (!rb) {
 		log_msg(LOG_ERROR, "Failed to create ring buffer");
 		err = -1;
 		goto cleanup;
 	}
 
-	/* Load SLO configuration if requested */
-	if (reload_config) {
-		int config_entries = load_slo_config(bpf_map__fd(skel->maps.slo_map));
-		if (config_entries < 0) {
-			log_msg(LOG_ERROR, "Failed to load configuration");
-			err = -1;
-			goto cleanup;
-		}
-		log_msg(LOG_INFO, "Loaded %d SLO configuration entries", config_entries);
+	/* Resolve config cgroup IDs while the cgroup index walks the hierarchy */
+	config_job.err = 0;
+	if (reload_config && !config_before_attach) {
+		config_job.fds = slo_map_fds(skel);
+		if (pthread_create(&config_thread, NULL, config_thread_fn, &config_job) == 0)
+			config_thread_started = true;
+		else
+			config_job.err = apply_slo_config(&config_job.fds);
+	}
+
+	/* Build the cgroup ID index used to label per-cgroup metrics */
+	build_cgroup_index();
+
+	if (config_thread_started) {
+		pthread_join(config_thread, NULL);
+		config_thread_started = false;
+	}
+	if (config_job.err) {
+		err = config_job.err;
+		goto cleanup;
 	}
 
+	err = start_partial_switch();
+	if (err)
+		goto cleanup;
+
+	if (reload_config)
+		watch_config_dir();
+	start_cgroup_watch();
+	start_budget_ctl();
+	start_admission();
+	start_reserve(skel);
+	start_breaker(skel);
+	start_ctl_server(skel);
+
+	timeline_format(&timeline, timeline_buf, sizeof(timeline_buf));
+	log_msg(LOG_INFO, "Startup timeline: %s", timeline_buf);
+
 	/* Start health check server */
 	if (start_health_server() < 0) {
 		log_msg(LOG_WARN, "Failed to start health server (continuing without it)");
@@ -568,6 +3153,17 @@ restart:
 
 	log_msg(LOG_INFO, "SLO scheduler started, press Ctrl-C to exit");
 
+	time_t last_summary = time(NULL);
+	time_t last_occupancy = 0;
+	time_t last_gc = time(NULL);
+	time_t last_adjust = time(NULL);
+	time_t last_admission = 0;
+	time_t last_reserve = 0;
+	time_t last_partial = 0;
+	time_t last_breaker = time(NULL);
+
+	start_cgroup_gc();
+
 	while (!exit_req && !UEI_EXITED(skel, uei)) {
 		__u64 stats[2];
 
@@ -579,6 +3175,37 @@ restart:
 		}
 
 		read_stats(skel, stats);
+		if (shadow_mode)
+			read_shadow_stats(skel);
+		if (cpuperf_percpu)
+			read_cpuperf(skel);
+		if (burst_enabled)
+			read_burst_stats(skel);
+
+		if (handoff_requested(skel)) {
+			log_msg(LOG_INFO, "Handoff requested by a newer instance, detaching");
+			handed_off = true;
+			break;
+		}
+
+		/* Without the watch thread, apply cgroup changes once per tick */
+		if (cgroup_idx && !cgroup_watch_running)
+			cgroup_index_process_events(cgroup_idx);
+
+		/* SIGHUP re-resolves every path; file changes only what changed */
+		if (reload_req || (config_watch_fd >= 0 && config_changed())) {
+			bool full = reload_req;
+
+			reload_req = 0;
+			reload_slo_map(skel, full);
+		}
+
+		/* Policies follow SLO map changes and threads entering cgroups */
+		if (partial_switch && (partial_scan_req ||
+				       time(NULL) - last_partial >= PARTIAL_SCAN_INTERVAL_SEC)) {
+			partial_scan(skel);
+			last_partial = time(NULL);
+		}
 
 		/* Log stats at INFO level */
 		pthread_mutex_lock(&stats_lock);
@@ -586,15 +3213,15 @@ restart:
 		__u64 miss_duration = total_miss_duration_ns;
 		pthread_mutex_unlock(&stats_lock);
 
-		if (json_logging) {
-			printf("{\"timestamp\":\"%ld\",\"type\":\"stats\","
-			       "\"local\":%llu,\"global\":%llu,"
-			       "\"deadline_misses\":%llu,\"avg_miss_ms\":%.2f}\n",
-			       time(NULL),
-			       (unsigned long long)stats[0],
-			       (unsigned long long)stats[1],
-			       (unsigned long long)misses,
-			       misses > 0 ? ns_to_ms(miss_duration / misses) : 0.0);
+		if (log_json_enabled()) {
+			log_raw("{\"timestamp\":\"%ld\",\"type\":\"stats\","
+				"\"local\":%llu,\"global\":%llu,"
+				"\"deadline_misses\":%llu,\"avg_miss_ms\":%.2f}",
+				time(NULL),
+				(unsigned long long)stats[0],
+				(unsigned long long)stats[1],
+				(unsigned long long)misses,
+				misses > 0 ? ns_to_ms(miss_duration / misses) : 0.0);
 		} else {
 			log_msg(LOG_INFO, "local=%llu global=%llu deadline_misses=%llu avg_miss=%.2fms",
 				(unsigned long long)stats[0],
@@ -603,9 +3230,55 @@ restart:
 				misses > 0 ? ns_to_ms(miss_duration / misses) : 0.0);
 		}
 
+		if (time(NULL) - last_occupancy >= OCCUPANCY_INTERVAL_SEC) {
+			update_occupancy(skel, rb);
+			last_occupancy = time(NULL);
+		}
+
+		if (time(NULL) - last_gc >= CGROUP_GC_INTERVAL_SEC) {
+			sweep_slo_map(skel);
+			if (cgroup_idx)
+				cgroup_index_expire_unresolved(cgroup_idx);
+			last_gc = time(NULL);
+		}
+
+		if (breaker && time(NULL) - last_breaker >= breaker_params.interval_sec) {
+			check_breaker(skel, &link);
+			last_breaker = time(NULL);
+		}
+
+		if (budget_ctl && time(NULL) - last_adjust >= adaptive_params.interval_sec) {
+			adjust_budgets(skel);
+			last_adjust = time(NULL);
+		}
+
+		if (admission && time(NULL) - last_admission >= admission_params.interval_sec) {
+			check_admission(skel);
+			last_admission = time(NULL);
+		}
+
+		if (reserve_ctl && time(NULL) - last_reserve >= reserve_params.interval_sec) {
+			check_reserve(skel);
+			last_reserve = time(NULL);
+		}
+
+		if (summary_interval_sec > 0 &&
+		    time(NULL) - last_summary >= summary_interval_sec) {
+			flush_miss_summary();
+			if (shadow_mode)
+				log_shadow_summary();
+			last_summary = time(NULL);
+		}
+
 		sleep(1);
 	}
 
+	if (summary_interval_sec > 0) {
+		flush_miss_summary();
+		if (shadow_mode)
+			log_shadow_summary();
+	}
+
 	err = 0;  /* Clean exit */
 
 cleanup:
@@ -614,6 +3287,13 @@ cleanup:
 
 	/* Stop health server first */
 	stop_health_server();
+	stop_cgroup_watch();
+	/* Before the skeleton goes away: its maps back every request */
+	stop_ctl_server();
+	stop_budget_ctl(skel);
+	stop_admission(skel);
+	stop_reserve(skel);
+	stop_breaker();
 
 	if (rb) {
 		log_msg(LOG_DEBUG, "Freeing ring buffer");
@@ -628,13 +3308,16 @@ cleanup:
 	}
 
 	if (skel) {
-		ecode = UEI_REPORT(skel, uei);
+		/* Nothing in shadow mode can exit on its own */
+		ecode = shadow_mode ? 0 : UEI_REPORT(skel, uei);
 		scx_slo__destroy(skel);
 		skel = NULL;
-		log_msg(LOG_INFO, "BPF scheduler detached successfully");
+		log_msg(LOG_INFO, "BPF %s detached successfully",
+			shadow_mode ? "shadow programs" : "scheduler");
 
-		if (UEI_ECODE_RESTART(ecode)) {
+		if (!handed_off && UEI_ECODE_RESTART(ecode)) {
 			log_msg(LOG_INFO, "Restarting scheduler");
+			restarted = true;
 			goto restart;
 		}
 	}
@@ -653,6 +3336,23 @@ cleanup:
 		log_msg(LOG_INFO, "Final stats: No deadline misses detected");
 	}
 
+	/* Switched threads fall back to the fair class with the scheduler gone */
+	partial_switch_free(partial_switch);
+	partial_switch = NULL;
+	cgroup_index_free(cgroup_idx);
+	cgroup_idx = NULL;
+
+	if (cgroup_gc_fd >= 0) {
+		close(cgroup_gc_fd);
+		cgroup_gc_fd = -1;
+	}
+
+	if (config_watch_fd >= 0) {
+		close(config_watch_fd);
+		config_watch_fd = -1;
+	}
+
 	log_msg(LOG_INFO, "Shutdown complete");
+	log_shutdown();
 	return err;
 }
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Shadow mode histograms for scx-slo
+ */
+#include <stdint.h>
+#include <string.h>
+#include "shadow_stats.h"
+
+unsigned int shadow_hist_bucket(__u64 ns)
+{
+	__u64 us = ns / 1000;
+	unsigned int idx;
+
+	if (!us)
+		return 0;
+	idx = 64 - __builtin_clzll(us);
+	return idx < SLO_HIST_BUCKETS ? idx : SLO_HIST_BUCKETS - 1;
+}
+
+__u64 shadow_hist_upper_ns(unsigned int idx)
+{
+	if (idx >= SLO_HIST_BUCKETS - 1)
+		return UINT64_MAX;
+	return (1ULL << idx) * 1000;
+}
+
+__u64 shadow_hist_percentile(const struct slo_hist *h, unsigned int pct)
+{
+	__u64 total = 0, target, seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < SLO_HIST_BUCKETS; i++)
+		total += h->buckets[i];
+	if (!total)
+		return 0;
+
+	if (pct > 100)
+		pct = 100;
+	target = (total * pct + 99) / 100;
+	if (!target)
+		target = 1;
+
+	for (i = 0; i < SLO_HIST_BUCKETS - 1; i++) {
+		seen += h->buckets[i];
+		if (seen >= target)
+			return shadow_hist_upper_ns(i);
+	}
+	return shadow_hist_upper_ns(SLO_HIST_BUCKETS - 2);
+}
+
+static void hist_add(struct slo_hist *out, const struct slo_hist *h)
+{
+	out->count += h->count;
+	out->sum_ns += h->sum_ns;
+	for (unsigned int i = 0; i < SLO_HIST_BUCKETS; i++)
+		out->buckets[i] += h->buckets[i];
+}
+
+/* Counters only grow, but a reloaded program starts over from zero */
+static void hist_sub(struct slo_hist *out, const struct slo_hist *cur, const struct slo_hist *prev)
+{
+	if (cur->count < prev->count) {
+		*out = *cur;
+		return;
+	}
+	out->count = cur->count - prev->count;
+	out->sum_ns = cur->sum_ns - prev->sum_ns;
+	for (unsigned int i = 0; i < SLO_HIST_BUCKETS; i++)
+		out->buckets[i] = cur->buckets[i] >= prev->buckets[i] ?
+				  cur->buckets[i] - prev->buckets[i] : 0;
+}
+
+void shadow_stats_sum(struct slo_shadow_stats *out, const struct slo_shadow_stats *percpu,
+		      int nr_cpus)
+{
+	memset(out, 0, sizeof(*out));
+	for (int cpu = 0; cpu < nr_cpus; cpu++) {
+		hist_add(&out->slack, &percpu[cpu].slack);
+		hist_add(&out->lateness, &percpu[cpu].lateness);
+		hist_add(&out->delay, &percpu[cpu].delay);
+	}
+}
+
+void shadow_stats_delta(struct slo_shadow_stats *out, const struct slo_shadow_stats *cur,
+			const struct slo_shadow_stats *prev)
+{
+	hist_sub(&out->slack, &cur->slack, &prev->slack);
+	hist_sub(&out->lateness, &cur->lateness, &prev->lateness);
+	hist_sub(&out->delay, &cur->delay, &prev->delay);
+}
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Shadow mode histograms for scx-slo
+ *
+ * In shadow mode the BPF side keeps a struct slo_shadow_stats per latency
+ * class and CPU. These helpers add them up and read bucket bounds and
+ * percentiles out of the result for the metrics endpoint and the periodic
+ * summary. Bucketing matches hist_bucket() in scx_slo.bpf.c.
+ */
+#ifndef __SCX_SLO_SHADOW_STATS_H
+#define __SCX_SLO_SHADOW_STATS_H
+
+#include "scx_slo.h"
+
+/* Bucket of @ns, as the BPF side counts it */
+unsigned int shadow_hist_bucket(__u64 ns);
+
+/* Smallest value (ns) beyond bucket @idx; UINT64_MAX for the last bucket */
+__u64 shadow_hist_upper_ns(unsigned int idx);
+
+/*
+ * Upper bound (ns) of the bucket holding the @pct-th percentile, so the
+ * answer is within a factor of two. The last bucket has no bound and
+ * reports where it starts. Returns 0 for an empty histogram.
+ */
+__u64 shadow_hist_percentile(const struct slo_hist *h, unsigned int pct);
+
+/* Add up @nr_cpus per-CPU copies of the stats of one class */
+void shadow_stats_sum(struct slo_shadow_stats *out, const struct slo_shadow_stats *percpu,
+		      int nr_cpus);
+
+/* What was counted between @prev and @cur, both sums of the same class */
+void shadow_stats_delta(struct slo_shadow_stats *out, const struct slo_shadow_stats *cur,
+			const struct slo_shadow_stats *prev);
+
+#endif /* __SCX_SLO_SHADOW_STATS_H */
@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Resolved SLO rule sets and their differences for scx-slo
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slo_set.h"
+
+void slo_set_init(struct slo_set *set)
+{
+	memset(set, 0, sizeof(*set));
+	set->sorted = true;
+}
+
+void slo_set_free(struct slo_set *set)
+{
+	free(set->rules);
+	slo_set_init(set);
+}
+
+void slo_set_move(struct slo_set *dst, struct slo_set *src)
+{
+	slo_set_free(dst);
+	*dst = *src;
+	slo_set_init(src);
+}
+
+int slo_set_add(struct slo_set *set, const char *path, __u64 cgroup_id,
+		const struct slo_cfg *cfg)
+{
+	struct slo_rule *rule;
+
+	if (set->nr == set->cap) {
+		size_t cap = set->cap ? set->cap * 2 : 64;
+		struct slo_rule *rules = realloc(set->rules, cap * sizeof(*rules));
+
+		if (!rules)
+			return -ENOMEM;
+		set->rules = rules;
+		set->cap = cap;
+	}
+
+	rule = &set->rules[set->nr++];
+	memset(rule, 0, sizeof(*rule));
+	strncpy(rule->path, path, sizeof(rule->path) - 1);
+	rule->cgroup_id = cgroup_id;
+	rule->cfg = *cfg;
+	set->sorted = false;
+	return 0;
+}
+
+/*
+ * Order by cgroup ID; for equal IDs, the later rule sorts first so
+ * deduplication keeps it. Rules are tagged with their position first.
+ */
+struct rule_pos {
+	struct slo_rule *rule;
+	size_t pos;
+};
+
+static int cmp_rule_pos(const void *a, const void *b)
+{
+	const struct rule_pos *ra = a, *rb = b;
+
+	if (ra->rule->cgroup_id != rb->rule->cgroup_id)
+		return ra->rule->cgroup_id < rb->rule->cgroup_id ? -1 : 1;
+	return ra->pos < rb->pos ? 1 : -1;
+}
+
+static int cmp_rule_id(const void *a, const void *b)
+{
+	const struct slo_rule *ra = a, *rb = b;
+
+	if (ra->cgroup_id != rb->cgroup_id)
+		return ra->cgroup_id < rb->cgroup_id ? -1 : 1;
+	return 0;
+}
+
+void slo_set_finalize(struct slo_set *set)
+{
+	struct rule_pos *order;
+	struct slo_rule *out;
+	size_t n = 0;
+
+	if (set->sorted || set->nr == 0) {
+		set->sorted = true;
+		return;
+	}
+
+	order = malloc(set->nr * sizeof(*order));
+	out = malloc(set->nr * sizeof(*out));
+	if (!order || !out) {
+		/* Fall back to an in-place sort; duplicates keep an arbitrary winner */
+		free(order);
+		free(out);
+		qsort(set->rules, set->nr, sizeof(*set->rules), cmp_rule_id);
+		for (size_t i = 0; i < set->nr; i++) {
+			if (n && set->rules[n - 1].cgroup_id == set->rules[i].cgroup_id)
+				continue;
+			set->rules[n++] = set->rules[i];
+		}
+		set->nr = n;
+		set->sorted = true;
+		return;
+	}
+
+	for (size_t i = 0; i < set->nr; i++) {
+		order[i].rule = &set->rules[i];
+		order[i].pos = i;
+	}
+	qsort(order, set->nr, sizeof(*order), cmp_rule_pos);
+
+	for (size_t i = 0; i < set->nr; i++) {
+		if (n && out[n - 1].cgroup_id == order[i].rule->cgroup_id)
+			continue;
+		out[n++] = *order[i].rule;
+	}
+
+	free(order);
+	free(set->rules);
+	set->rules = out;
+	set->nr = n;
+	set->cap = set->nr;
+	set->sorted = true;
+}
+
+const struct slo_rule *slo_set_find(const struct slo_set *set, __u64 cgroup_id)
+{
+	size_t lo = 0, hi = set->nr;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (set->rules[mid].cgroup_id == cgroup_id)
+			return &set->rules[mid];
+		if (cgroup_id < set->rules[mid].cgroup_id)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+int slo_set_upsert(struct slo_set *set, const char *path, __u64 cgroup_id,
+		   const struct slo_cfg *cfg)
+{
+	size_t lo = 0, hi = set->nr;
+	struct slo_rule *rule;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (set->rules[mid].cgroup_id < cgroup_id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == set->nr || set->rules[lo].cgroup_id != cgroup_id) {
+		if (set->nr == set->cap) {
+			size_t cap = set->cap ? set->cap * 2 : 64;
+			struct slo_rule *rules = realloc(set->rules, cap * sizeof(*rules));
+
+			if (!rules)
+				return -ENOMEM;
+			set->rules = rules;
+			set->cap = cap;
+		}
+		memmove(&set->rules[lo + 1], &set->rules[lo],
+			(set->nr - lo) * sizeof(*set->rules));
+		set->nr++;
+	}
+
+	rule = &set->rules[lo];
+	memset(rule, 0, sizeof(*rule));
+	strncpy(rule->path, path, sizeof(rule->path) - 1);
+	rule->cgroup_id = cgroup_id;
+	rule->cfg = *cfg;
+	return 0;
+}
+
+int slo_set_remove(struct slo_set *set, __u64 cgroup_id)
+{
+	const struct slo_rule *rule = slo_set_find(set, cgroup_id);
+	size_t i;
+
+	if (!rule)
+		return -ENOENT;
+
+	i = rule - set->rules;
+	memmove(&set->rules[i], &set->rules[i + 1], (set->nr - i - 1) * sizeof(*set->rules));
+	set->nr--;
+	return 0;
+}
+
+static int cmp_rule_path(const void *a, const void *b)
+{
+	const struct slo_rule *ra = *(const struct slo_rule * const *)a;
+	const struct slo_rule *rb = *(const struct slo_rule * const *)b;
+
+	return strcmp(ra->path, rb->path);
+}
+
+int slo_path_index_build(struct slo_path_index *idx, const struct slo_set *set)
+{
+	idx->nr = 0;
+	idx->by_path = NULL;
+	if (!set->nr)
+		return 0;
+
+	idx->by_path = malloc(set->nr * sizeof(*idx->by_path));
+	if (!idx->by_path)
+		return -ENOMEM;
+
+	for (size_t i = 0; i < set->nr; i++)
+		idx->by_path[i] = &set->rules[i];
+	idx->nr = set->nr;
+	qsort(idx->by_path, idx->nr, sizeof(*idx->by_path), cmp_rule_path);
+	return 0;
+}
+
+const struct slo_rule *slo_path_index_find(const struct slo_path_index *idx, const char *path)
+{
+	size_t lo = 0, hi = idx->nr;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int c = strcmp(path, idx->by_path[mid]->path);
+
+		if (c == 0)
+			return idx->by_path[mid];
+		if (c < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+void slo_path_index_free(struct slo_path_index *idx)
+{
+	free(idx->by_path);
+	idx->by_path = NULL;
+	idx->nr = 0;
+}
+
+static bool cfg_equal(const struct slo_cfg *a, const struct slo_cfg *b)
+{
+	return a->budget_ns == b->budget_ns &&
+	       a->importance == b->importance &&
+	       a->flags == b->flags;
+}
+
+int slo_set_diff(const struct slo_set *old, const struct slo_set *new, struct slo_diff *diff)
+{
+	size_t i = 0, j = 0;
+
+	memset(diff, 0, sizeof(*diff));
+	if (new->nr) {
+		diff->upsert_keys = malloc(new->nr * sizeof(*diff->upsert_keys));
+		diff->upsert_vals = malloc(new->nr * sizeof(*diff->upsert_vals));
+		if (!diff->upsert_keys || !diff->upsert_vals)
+			goto nomem;
+	}
+	if (old->nr) {
+		diff->delete_keys = malloc(old->nr * sizeof(*diff->delete_keys));
+		if (!diff->delete_keys)
+			goto nomem;
+	}
+
+	/* Merge walk over both sets, which are sorted by cgroup ID */
+	while (i < old->nr || j < new->nr) {
+		const struct slo_rule *o = i < old->nr ? &old->rules[i] : NULL;
+		const struct slo_rule *n = j < new->nr ? &new->rules[j] : NULL;
+
+		if (o && (!n || o->cgroup_id < n->cgroup_id)) {
+			diff->delete_keys[diff->nr_delete++] = o->cgroup_id;
+			i++;
+		} else if (n && (!o || n->cgroup_id < o->cgroup_id)) {
+			diff->upsert_keys[diff->nr_upsert] = n->cgroup_id;
+			diff->upsert_vals[diff->nr_upsert++] = n->cfg;
+			j++;
+		} else {
+			if (!cfg_equal(&o->cfg, &n->cfg)) {
+				diff->upsert_keys[diff->nr_upsert] = n->cgroup_id;
+				diff->upsert_vals[diff->nr_upsert++] = n->cfg;
+			}
+			i++;
+			j++;
+		}
+	}
+	return 0;
+
+nomem:
+	slo_diff_free(diff);
+	return -ENOMEM;
+}
+
+void slo_diff_free(struct slo_diff *diff)
+{
+	free(diff->upsert_keys);
+	free(diff->upsert_vals);
+	free(diff->delete_keys);
+	memset(diff, 0, sizeof(*diff));
+}
@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Resolved SLO rule sets and their differences for scx-slo
+ *
+ * A config load produces a set of rules keyed by cgroup ID. Reloads diff
+ * the new set against the last applied one to tell whether anything
+ * changed and which keys the config owns.
+ */
+#ifndef __SCX_SLO_SLO_SET_H
+#define __SCX_SLO_SLO_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "scx_slo.h"
+
+#define SLO_RULE_PATH_MAX 512
+
+struct slo_rule {
+	char path[SLO_RULE_PATH_MAX]; /* Cgroup path as written in the config */
+	__u64 cgroup_id;
+	struct slo_cfg cfg;
+};
+
+struct slo_set {
+	struct slo_rule *rules;
+	size_t nr;
+	size_t cap;
+	bool sorted;                  /* Sorted by cgroup ID, duplicates removed */
+};
+
+/* Keys to write and delete to turn one set into another */
+struct slo_diff {
+	__u64 *upsert_keys;
+	struct slo_cfg *upsert_vals;
+	size_t nr_upsert;
+	__u64 *delete_keys;
+	size_t nr_delete;
+};
+
+void slo_set_init(struct slo_set *set);
+void slo_set_free(struct slo_set *set);
+
+/* Move @src into @dst, freeing what @dst held. @src is left empty. */
+void slo_set_move(struct slo_set *dst, struct slo_set *src);
+
+/* Append a rule; a later rule for the same cgroup ID overrides earlier ones */
+int slo_set_add(struct slo_set *set, const char *path, __u64 cgroup_id,
+		const struct slo_cfg *cfg);
+
+/* Sort by cgroup ID and drop overridden rules. Idempotent. */
+void slo_set_finalize(struct slo_set *set);
+
+/* Rule for @cgroup_id in a finalized set, or NULL */
+const struct slo_rule *slo_set_find(const struct slo_set *set, __u64 cgroup_id);
+
+/*
+ * Insert or replace the rule for @cgroup_id in a finalized set, keeping it
+ * finalized. Returns 0 or -ENOMEM.
+ */
+int slo_set_upsert(struct slo_set *set, const char *path, __u64 cgroup_id,
+		   const struct slo_cfg *cfg);
+
+/* Drop the rule for @cgroup_id from a finalized set. Returns 0 or -ENOENT. */
+int slo_set_remove(struct slo_set *set, __u64 cgroup_id);
+
+/* Lookup of rules by config path, for reusing resolved cgroup IDs */
+struct slo_path_index {
+	const struct slo_rule **by_path;
+	size_t nr;
+};
+
+int slo_path_index_build(struct slo_path_index *idx, const struct slo_set *set);
+const struct slo_rule *slo_path_index_find(const struct slo_path_index *idx, const char *path);
+void slo_path_index_free(struct slo_path_index *idx);
+
+/*
+ * Compute the changes that turn finalized set @old into finalized set
+ * @new: keys that are new or whose config changed, and keys that are gone.
+ * Returns 0 or -ENOMEM.
+ */
+int slo_set_diff(const struct slo_set *old, const struct slo_set *new, struct slo_diff *diff);
+void slo_diff_free(struct slo_diff *diff);
+
+#endif /* __SCX_SLO_SLO_SET_H */
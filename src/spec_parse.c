@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * key=value tuning specs for scx-slo
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/types.h>
+#include "spec_parse.h"
+
+/* Parse @len bytes at @str as a double within [lo, hi] */
+static int parse_double(const char *str, size_t len, double lo, double hi, double *out)
+{
+	char buf[32], *end;
+	double v;
+
+	if (len == 0 || len >= sizeof(buf))
+		return -1;
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+	v = strtod(buf, &end);
+	if (*end != '\0' || !(v >= lo && v <= hi))
+		return -1;
+	*out = v;
+	return 0;
+}
+
+static int parse_u32(const char *str, size_t len, double lo, double hi, __u32 *out)
+{
+	char buf[16], *end;
+	unsigned long v;
+
+	if (len == 0 || len >= sizeof(buf) || str[0] < '0' || str[0] > '9')
+		return -1;
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+	v = strtoul(buf, &end, 10);
+	if (*end != '\0' || v < lo || v > hi)
+		return -1;
+	*out = v;
+	return 0;
+}
+
+static bool key_is(const char *item, size_t len, const char *key)
+{
+	return strlen(key) == len && strncmp(item, key, len) == 0;
+}
+
+static int parse_value(void *params, const struct spec_key *k, const char *val, size_t len)
+{
+	char *field = (char *)params + k->offset;
+	__u32 us;
+
+	switch (k->type) {
+	case SPEC_DOUBLE:
+		return parse_double(val, len, k->lo, k->hi, (double *)field);
+	case SPEC_U32:
+		return parse_u32(val, len, k->lo, k->hi, (__u32 *)field);
+	case SPEC_US:
+		if (parse_u32(val, len, k->lo, k->hi, &us) != 0)
+			return -1;
+		*(__u64 *)field = us * 1000ULL;
+		return 0;
+	case SPEC_STR:
+		if (len == 0 || len >= k->size)
+			return -1;
+		memcpy(field, val, len);
+		field[len] = '\0';
+		return 0;
+	case SPEC_CHOICE:
+		for (int i = 0; i < 2; i++) {
+			if (key_is(val, len, k->choices[i])) {
+				*(bool *)field = i;
+				return 0;
+			}
+		}
+		return -1;
+	}
+	return -1;
+}
+
+/* Apply the items of @spec to @params; -1 at the first bad one */
+static int parse_items(const struct spec_def *def, void *params, const char *spec)
+{
+	const char *s = spec;
+
+	while (*s) {
+		const char *item = s, *eq, *val, *end = strchr(s, ',');
+		const struct spec_key *k = NULL;
+		size_t key_len;
+
+		if (!end)
+			end = s + strlen(s);
+		eq = memchr(item, '=', end - item);
+		if (!eq)
+			return -1;
+		key_len = eq - item;
+		val = eq + 1;
+
+		for (size_t i = 0; i < def->nr_keys && !k; i++) {
+			if (key_is(item, key_len, def->keys[i].name))
+				k = &def->keys[i];
+		}
+		if (!k || parse_value(params, k, val, end - val) != 0)
+			return -1;
+
+		s = *end ? end + 1 : end;
+	}
+	return 0;
+}
+
+static void report_invalid(const struct spec_def *def, const char *spec)
+{
+	fprintf(stderr, "Invalid %s spec '%s' (expected key=value,... with keys ", def->what, spec);
+	for (size_t i = 0; i < def->nr_keys; i++) {
+		const struct spec_key *k = &def->keys[i];
+
+		fprintf(stderr, "%s%s", i ? ", " : "", k->name);
+		if (k->type == SPEC_CHOICE)
+			fprintf(stderr, " (%s or %s)", k->choices[0], k->choices[1]);
+	}
+	fprintf(stderr, ")\n");
+}
+
+int spec_parse(const struct spec_def *def, void *params, const char *spec)
+{
+	void *next = malloc(def->size);
+	int err = -1;
+
+	if (!next) {
+		fprintf(stderr, "Out of memory parsing %s spec\n", def->what);
+		return -1;
+	}
+	memcpy(next, params, def->size);
+	if (parse_items(def, next, spec) == 0 && (!def->valid || def->valid(next))) {
+		memcpy(params, next, def->size);
+		err = 0;
+	} else {
+		report_invalid(def, spec);
+	}
+	free(next);
+	return err;
+}
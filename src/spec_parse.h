@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * key=value tuning specs for scx-slo
+ *
+ * Options such as -A, -B, -E, -R, -F and -W take a comma-separated list
+ * of key=value items. Each module describes its keys in a table of
+ * struct spec_key, naming the field of its params struct each key sets
+ * and the range it accepts; spec_parse() does the rest.
+ */
+#ifndef __SCX_SLO_SPEC_PARSE_H
+#define __SCX_SLO_SPEC_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum spec_type {
+	SPEC_DOUBLE,  /* double within [lo, hi] */
+	SPEC_U32,     /* __u32 within [lo, hi] */
+	SPEC_US,      /* Microseconds within [lo, hi], stored as __u64 nanoseconds */
+	SPEC_STR,     /* char[size], up to the next comma */
+	SPEC_CHOICE,  /* bool: false for choices[0], true for choices[1] */
+};
+
+struct spec_key {
+	const char *name;
+	enum spec_type type;
+	size_t offset;            /* Of the field in the params struct */
+	double lo, hi;
+	size_t size;              /* SPEC_STR: size of the field */
+	const char *choices[2];   /* SPEC_CHOICE: values for false and true */
+};
+
+#define SPEC_KEY_DOUBLE(name, st, field, lo, hi) \
+	{ name, SPEC_DOUBLE, offsetof(st, field), lo, hi, 0, { NULL, NULL } }
+#define SPEC_KEY_U32(name, st, field, lo, hi) \
+	{ name, SPEC_U32, offsetof(st, field), lo, hi, 0, { NULL, NULL } }
+#define SPEC_KEY_US(name, st, field, lo, hi) \
+	{ name, SPEC_US, offsetof(st, field), lo, hi, 0, { NULL, NULL } }
+#define SPEC_KEY_STR(name, st, field) \
+	{ name, SPEC_STR, offsetof(st, field), 0, 0, sizeof(((st *)0)->field), { NULL, NULL } }
+#define SPEC_KEY_CHOICE(name, st, field, no, yes) \
+	{ name, SPEC_CHOICE, offsetof(st, field), 0, 0, 0, { no, yes } }
+
+#define SPEC_NR_KEYS(keys) (sizeof(keys) / sizeof((keys)[0]))
+
+/* A params struct of @size bytes, tuned by the keys of @keys */
+struct spec_def {
+	const char *what;              /* For the error message, e.g. "burst learning" */
+	const struct spec_key *keys;
+	size_t nr_keys;
+	size_t size;
+	/* Checks across keys, on the params as they would be; may be NULL */
+	bool (*valid)(const void *params);
+};
+
+/*
+ * Apply overrides from @spec, a comma-separated list of key=value items
+ * with keys from @def, to @params. Returns 0, or -1 with @params
+ * unchanged and the keys listed on stderr if any item is malformed,
+ * unknown or out of range, or the result fails @def->valid.
+ */
+int spec_parse(const struct spec_def *def, void *params, const char *spec);
+
+#endif /* __SCX_SLO_SPEC_PARSE_H */
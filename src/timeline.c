@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Agent startup timeline for scx-slo
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "timeline.h"
+
+static const char *phase_names[NR_STARTUP_PHASES] = {
+	[PHASE_OPEN]         = "open",
+	[PHASE_LOAD]         = "load",
+	[PHASE_HANDOFF_WAIT] = "handoff_wait",
+	[PHASE_ATTACH]       = "attach",
+	[PHASE_RINGBUF]      = "ringbuf",
+	[PHASE_CONFIG]       = "config",
+	[PHASE_CGROUP_INDEX] = "cgroup_index",
+};
+
+static __u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void timeline_init(struct startup_timeline *tl)
+{
+	memset(tl, 0, sizeof(*tl));
+	tl->origin_ns = now_ns();
+}
+
+void timeline_begin(struct startup_timeline *tl, enum startup_phase phase)
+{
+	tl->start_ns[phase] = now_ns();
+	tl->end_ns[phase] = 0;
+}
+
+void timeline_end(struct startup_timeline *tl, enum startup_phase phase)
+{
+	if (tl->start_ns[phase])
+		tl->end_ns[phase] = now_ns();
+}
+
+void timeline_mark_enforced(struct startup_timeline *tl)
+{
+	tl->enforced_ns = now_ns();
+}
+
+__u64 timeline_phase_ns(const struct startup_timeline *tl, enum startup_phase phase)
+{
+	if (!tl->start_ns[phase] || tl->end_ns[phase] < tl->start_ns[phase])
+		return 0;
+	return tl->end_ns[phase] - tl->start_ns[phase];
+}
+
+__u64 timeline_enforcement_ns(const struct startup_timeline *tl)
+{
+	if (!tl->enforced_ns)
+		return 0;
+	return tl->enforced_ns - tl->origin_ns;
+}
+
+const char *timeline_phase_name(enum startup_phase phase)
+{
+	if (phase < 0 || phase >= NR_STARTUP_PHASES)
+		return "unknown";
+	return phase_names[phase];
+}
+
+int timeline_format(const struct startup_timeline *tl, char *buf, size_t len)
+{
+	size_t off = 0;
+	int n, total = 0;
+
+	if (len)
+		buf[0] = '\0';
+
+	for (int i = 0; i < NR_STARTUP_PHASES; i++) {
+		if (!tl->start_ns[i] || !tl->end_ns[i])
+			continue;
+		n = snprintf(buf + off, len > off ? len - off : 0, "%s%s=%.1fms",
+			     total ? " " : "", phase_names[i],
+			     timeline_phase_ns(tl, i) / 1e6);
+		if (n < 0)
+			return n;
+		total += n;
+		off = (size_t)total < len ? (size_t)total : len;
+	}
+
+	if (tl->enforced_ns) {
+		n = snprintf(buf + off, len > off ? len - off : 0, "%senforced=%.1fms",
+			     total ? " " : "", timeline_enforcement_ns(tl) / 1e6);
+		if (n < 0)
+			return n;
+		total += n;
+	}
+	return total;
+}
@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Agent startup timeline for scx-slo
+ *
+ * Records how long each startup phase took and when the scheduler started
+ * enforcing SLOs, so the window a node runs without SLO scheduling after a
+ * restart is visible in logs and metrics.
+ */
+#ifndef __SCX_SLO_TIMELINE_H
+#define __SCX_SLO_TIMELINE_H
+
+#include <stddef.h>
+#include "scx_slo.h"
+
+enum startup_phase {
+	PHASE_OPEN,
+	PHASE_LOAD,
+	PHASE_HANDOFF_WAIT,
+	PHASE_ATTACH,
+	PHASE_RINGBUF,
+	PHASE_CONFIG,
+	PHASE_CGROUP_INDEX,
+	NR_STARTUP_PHASES
+};
+
+struct startup_timeline {
+	__u64 origin_ns;                   /* CLOCK_MONOTONIC at timeline_init() */
+	__u64 start_ns[NR_STARTUP_PHASES];
+	__u64 end_ns[NR_STARTUP_PHASES];
+	__u64 enforced_ns;                 /* When the scheduler was attached */
+};
+
+void timeline_init(struct startup_timeline *tl);
+
+/* Phases may run concurrently; each is only written by the thread running it */
+void timeline_begin(struct startup_timeline *tl, enum startup_phase phase);
+void timeline_end(struct startup_timeline *tl, enum startup_phase phase);
+void timeline_mark_enforced(struct startup_timeline *tl);
+
+/* Duration of @phase, 0 if it did not run or has not finished */
+__u64 timeline_phase_ns(const struct startup_timeline *tl, enum startup_phase phase);
+
+/* Time from timeline_init() to enforcement, 0 if not enforcing yet */
+__u64 timeline_enforcement_ns(const struct startup_timeline *tl);
+
+const char *timeline_phase_name(enum startup_phase phase);
+
+/*
+ * Format finished phases as "open=1.2ms load=85.0ms ... enforced=87.1ms".
+ * Returns the length snprintf() would have produced.
+ */
+int timeline_format(const struct startup_timeline *tl, char *buf, size_t len);
+
+#endif /* __SCX_SLO_TIMELINE_H */
@@ -0,0 +1,307 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for admission control
+ * Tests admission.c with hand-computed demand: the processor demand
+ * test, overcommit detection, dry runs, relaxing the least important
+ * budgets with hysteresis, other writers and restore
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "../src/admission.h"
+#include "test_cgrp.h"
+
+#define US  1000ULL
+#define MS  1000000ULL
+#define SEC 1000000000ULL
+
+/* One second in which @c runs @runs times for @run_ns each */
+static struct budget_ctl_sample cgrp_run(struct test_cgrp *c, __u64 runs, __u64 run_ns)
+{
+	return test_cgrp_run(c, runs, 0, 0, 0, runs * run_ns);
+}
+
+static void apply(struct test_cgrp *c, size_t nr, const struct budget_ctl_update *u, int n)
+{
+	for (int i = 0; i < n; i++)
+		for (size_t j = 0; j < nr; j++)
+			if (c[j].id == u[i].cgroup_id) {
+				assert(memcmp(&c[j].cfg, &u[i].expected, sizeof(c[j].cfg)) == 0);
+				c[j].cfg = u[i].cfg;
+			}
+}
+
+static bool near(double a, double b)
+{
+	return fabs(a - b) < 1e-6;
+}
+
+static void test_params(void)
+{
+	printf("Testing parameter parsing...\n");
+
+	struct admission_params p;
+
+	admission_params_default(&p);
+	assert(!p.enforce && p.util_max == 0.9 && p.victim_below == 50);
+
+	assert(admission_parse(&p, "mode=relax,util_max=0.8,relax_max=2,victim_below=30") == 0);
+	assert(p.enforce && p.util_max == 0.8 && p.relax_max == 2 && p.victim_below == 30);
+	assert(admission_parse(&p, "mode=dry-run") == 0 && !p.enforce);
+
+	/* Modes and ranges */
+	assert(admission_parse(&p, "mode=strict") == -1);
+	assert(admission_parse(&p, "relax_max=0.5") == -1);
+	assert(admission_parse(&p, "victim_below=102") == -1);
+
+	printf("OK Admission keys, modes and ranges\n");
+}
+
+/* Test the demand criterion against values worked out by hand */
+static void test_headroom(void)
+{
+	printf("Testing processor demand test...\n");
+
+	struct admission_load l[3] = {
+		{ .util = 0.2, .run_ns = 1 * MS, .window_ns = 2 * MS },
+		{ .util = 0.3, .run_ns = 3 * MS, .window_ns = 4 * MS },
+		{ .util = 0.1, .run_ns = 1 * MS, .window_ns = 0 },  /* No deadline */
+	};
+
+	/* 1ms of 2ms at the first window, long run 80% free */
+	assert(near(admission_headroom(l, 1, 1), 0.5));
+
+	/* 1 + 0.2 * 2 + 3 = 4.4ms due within 4ms */
+	assert(near(admission_headroom(l, 3, 1), -0.1));
+	assert(near(admission_headroom(l, 3, 2), 0.45));
+
+	/* Long windows leave only utilization */
+	l[0].window_ns = l[1].window_ns = 1000 * MS;
+	assert(near(admission_headroom(l, 2, 1), 0.5));
+
+	assert(admission_headroom(NULL, 0, 4) == 1.0);
+	assert(admission_headroom(l, 2, 0) == 0);
+
+	printf("OK Headroom matches the demand at each window\n");
+}
+
+/*
+ * One CPU. A is important with a tight budget and short runs; B is
+ * unimportant, with runs close to its window.
+ */
+static void setup(struct test_cgrp *c)
+{
+	memset(c, 0, 2 * sizeof(*c));
+	c[0].id = 1;
+	c[0].cfg = (struct slo_cfg){ .budget_ns = 1 * MS, .importance = 90 };
+	c[1].id = 2;
+	c[1].cfg = (struct slo_cfg){ .budget_ns = 2 * MS, .importance = 10 };
+}
+
+/* Test that a dry run reports the plan without writing */
+static void test_dry_run(void)
+{
+	printf("Testing dry run...\n");
+
+	struct admission_params p;
+	struct budget_ctl_sample s[2];
+	struct budget_ctl_update u[2];
+	struct admission_stats st;
+	struct admission *a;
+	struct test_cgrp c[2];
+
+	admission_params_default(&p);
+	p.smoothing = 1;
+	a = admission_new(&p, 1);
+	assert(a);
+	setup(c);
+
+	/* The first step has nothing to measure against */
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	assert(admission_step(a, s, 2, 0, u) == 0);
+	admission_get_stats(a, &st);
+	assert(st.tracked == 2 && st.measured == 0 && !st.overcommitted);
+
+	/* 50 + 0.05 * 1710 + 1600 of 1820us at B's window */
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	assert(admission_step(a, s, 2, SEC, u) == 0);
+	admission_get_stats(a, &st);
+	assert(st.measured == 2 && near(st.util, 0.21));
+	assert(near(st.headroom, 1.0 - 1735.5 / 1820));
+	assert(st.overcommitted && st.schedulable && st.relaxed == 1);
+	assert(near(st.headroom_relaxed, 1.0 - 50.0 / 110));  /* Now A's window is the tightest */
+	assert(st.checks == 2 && st.overcommits == 1);
+	admission_free(a);
+
+	printf("OK Overcommit found, B would be relaxed, nothing written\n");
+}
+
+/* Test relaxing, hysteresis and return to the configured budget */
+static void test_relax(void)
+{
+	printf("Testing relax and restore...\n");
+
+	struct admission_params p;
+	struct budget_ctl_sample s[2];
+	struct budget_ctl_update u[2];
+	struct admission_stats st;
+	struct slo_cfg base;
+	struct admission *a;
+	struct test_cgrp c[2];
+	int n;
+
+	admission_params_default(&p);
+	p.smoothing = 1;
+	p.enforce = true;
+	a = admission_new(&p, 1);
+	setup(c);
+
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	admission_step(a, s, 2, 0, u);
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	n = admission_step(a, s, 2, SEC, u);
+	assert(n == 1 && u[0].cgroup_id == 2 && u[0].cfg.budget_ns == 8 * MS);
+	assert(u[0].cfg.importance == 10);
+	apply(c, 2, u, n);
+
+	assert(admission_base(a, 2, &c[1].cfg, &base) && base.budget_ns == 2 * MS);
+	assert(!admission_base(a, 1, &(struct slo_cfg){ .budget_ns = 5 * MS }, &base));
+
+	/* Past the floor but within the hysteresis: stays relaxed */
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1450 * US);
+	assert(admission_step(a, s, 2, SEC, u) == 0);
+	admission_get_stats(a, &st);
+	assert(!st.overcommitted && st.relaxed == 1);
+
+	/* Room to spare: back to the configured budget */
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1000 * US);
+	n = admission_step(a, s, 2, SEC, u);
+	assert(n == 1 && u[0].cgroup_id == 2 && u[0].cfg.budget_ns == 2 * MS);
+	apply(c, 2, u, n);
+	admission_get_stats(a, &st);
+	assert(st.relaxed == 0 && st.updates == 2);
+	admission_free(a);
+
+	printf("OK B relaxed 4x, kept within the hysteresis, restored after\n");
+}
+
+/* Test overcommits relaxing cannot fix */
+static void test_unfixable(void)
+{
+	printf("Testing overcommit beyond relaxing...\n");
+
+	struct admission_params p;
+	struct budget_ctl_sample s[2];
+	struct budget_ctl_update u[2];
+	struct admission_stats st;
+	struct admission *a;
+	struct test_cgrp c[2];
+
+	admission_params_default(&p);
+	p.smoothing = 1;
+	p.enforce = true;
+
+	/* Only important cgroups are short of room */
+	a = admission_new(&p, 1);
+	setup(c);
+	c[1].cfg.importance = 60;
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	admission_step(a, s, 2, 0, u);
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	assert(admission_step(a, s, 2, SEC, u) == 0);
+	admission_get_stats(a, &st);
+	assert(st.overcommitted && !st.schedulable && st.relaxed == 0);
+	admission_free(a);
+
+	/* More CPU time than the node has */
+	a = admission_new(&p, 1);
+	setup(c);
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 1000, 900 * US);
+	admission_step(a, s, 2, 0, u);
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 1000, 900 * US);
+	assert(admission_step(a, s, 2, SEC, u) == 1);
+	admission_get_stats(a, &st);
+	assert(near(st.util, 0.95) && !st.schedulable && st.relaxed == 1);
+	admission_free(a);
+
+	printf("OK Reported as unschedulable\n");
+}
+
+/* Test other writers, vanished entries and restore */
+static void test_writers(void)
+{
+	printf("Testing other writers and restore...\n");
+
+	struct admission_params p;
+	struct budget_ctl_sample s[2];
+	struct budget_ctl_update u[2];
+	struct admission_stats st;
+	struct admission *a;
+	struct test_cgrp c[2];
+	int n;
+
+	admission_params_default(&p);
+	p.smoothing = 1;
+	p.enforce = true;
+	a = admission_new(&p, 1);
+	setup(c);
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	admission_step(a, s, 2, 0, u);
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	n = admission_step(a, s, 2, SEC, u);
+	apply(c, 2, u, n);
+
+	/* Restore undoes what was written */
+	assert(admission_restore(a, u, 2) == 1);
+	assert(u[0].expected.budget_ns == 8 * MS && u[0].cfg.budget_ns == 2 * MS);
+
+	/* An operator loosens B: the new value is its base, and it fits */
+	c[1].cfg.budget_ns = 20 * MS;
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	s[1] = cgrp_run(&c[1], 100, 1600 * US);
+	assert(admission_step(a, s, 2, SEC, u) == 0);
+	admission_get_stats(a, &st);
+	assert(st.rebased == 1 && st.relaxed == 0 && !st.overcommitted);
+	assert(st.measured == 2);  /* The estimate survived */
+	assert(admission_restore(a, u, 2) == 0);
+
+	/* Entries gone from the map are forgotten */
+	s[0] = cgrp_run(&c[0], 1000, 50 * US);
+	assert(admission_step(a, s, 1, SEC, u) == 0);
+	admission_get_stats(a, &st);
+	assert(st.tracked == 1);
+	admission_free(a);
+
+	assert(!admission_new(&p, 0));
+
+	printf("OK Rebased on outside writes, restore undoes relaxing\n");
+}
+
+int main(void)
+{
+	printf("=== Admission Control Tests ===\n\n");
+
+	test_params();
+	test_headroom();
+	test_dry_run();
+	test_relax();
+	test_unfixable();
+	test_writers();
+
+	printf("\nAll admission control tests passed!\n");
+	return 0;
+}
@@ -310,7 +310,7 @@ static void test_dsq_priority_ordering(void)
 	printf("Testing DSQ priority ordering (EDF)...\n");
 
 	/* Simulate multiple tasks with different deadlines */
-	struct {
+	struct queued_task {
 		uint32_t pid;
 		uint64_t deadline;
 	} tasks[] = {
@@ -327,7 +327,7 @@ static void test_dsq_priority_ordering(void)
 	for (size_t i = 0; i < 4; i++) {
 		for (size_t j = i + 1; j < 4; j++) {
 			if (tasks[j].deadline < tasks[i].deadline) {
-				struct { uint32_t pid; uint64_t deadline; } tmp = tasks[i];
+				struct queued_task tmp = tasks[i];
 				tasks[i] = tasks[j];
 				tasks[j] = tmp;
 			}
@@ -417,6 +417,191 @@ static void test_cpu_selection_logic(void)
 	printf("OK CPU selection logic verified\n");
 }
 
+/* Simulation of class_policy and get_slo_class from BPF */
+#define SCX_SLICE_DFL (20 * NSEC_PER_MSEC)
+
+struct slo_class_policy {
+	uint64_t slice_ns;
+	int preempt;
+	int preemptible;
+	int idle_core;
+	int reserved;
+};
+
+static const struct slo_class_policy class_policy[NR_SLO_CLASSES] = {
+	[SLO_CLASS_STANDARD]   = { .slice_ns = SCX_SLICE_DFL, .idle_core = 1 },
+	[SLO_CLASS_CRITICAL]   = { .slice_ns = SCX_SLICE_DFL / 4, .preempt = 1,
+				   .idle_core = 1, .reserved = 1 },
+	[SLO_CLASS_BATCH]      = { .slice_ns = SCX_SLICE_DFL * 2, .preemptible = 1 },
+	[SLO_CLASS_BESTEFFORT] = { .slice_ns = SCX_SLICE_DFL / 2, .preemptible = 1 },
+};
+
+static uint32_t get_slo_class(struct slo_cfg *cfg)
+{
+	uint32_t cls;
+
+	if (!cfg)
+		return SLO_CLASS_STANDARD;
+	cls = cfg->flags & SLO_CLASS_MASK;
+	return cls < NR_SLO_CLASSES ? cls : SLO_CLASS_STANDARD;
+}
+
+/* Test latency class policies */
+static void test_latency_classes(void)
+{
+	printf("Testing latency class policies...\n");
+
+	struct slo_cfg cfg = { .budget_ns = 50 * NSEC_PER_MSEC, .importance = 90 };
+
+	/* Entries without a class, and tasks without an SLO, are standard */
+	assert(get_slo_class(NULL) == SLO_CLASS_STANDARD);
+	assert(get_slo_class(&cfg) == SLO_CLASS_STANDARD);
+	cfg.flags = SLO_CLASS_CRITICAL;
+	assert(get_slo_class(&cfg) == SLO_CLASS_CRITICAL);
+	cfg.flags = SLO_CLASS_BESTEFFORT;
+	assert(get_slo_class(&cfg) == SLO_CLASS_BESTEFFORT);
+	printf("  Class read from slo_cfg.flags\n");
+
+	/* Unknown classes and stray bits fall back to standard */
+	cfg.flags = 7;
+	assert(get_slo_class(&cfg) == SLO_CLASS_STANDARD);
+	cfg.flags = 0x100 | SLO_CLASS_BATCH;
+	assert(get_slo_class(&cfg) == SLO_CLASS_BATCH);
+	printf("  Unknown class -> standard\n");
+
+	/* Slices get longer from critical to batch */
+	assert(class_policy[SLO_CLASS_CRITICAL].slice_ns < class_policy[SLO_CLASS_STANDARD].slice_ns);
+	assert(class_policy[SLO_CLASS_STANDARD].slice_ns < class_policy[SLO_CLASS_BATCH].slice_ns);
+	for (int i = 0; i < NR_SLO_CLASSES; i++)
+		assert(class_policy[i].slice_ns > 0);
+
+	/* No class both preempts and yields, only critical preempts */
+	for (int i = 0; i < NR_SLO_CLASSES; i++) {
+		assert(!(class_policy[i].preempt && class_policy[i].preemptible));
+		assert(class_policy[i].preempt == (i == SLO_CLASS_CRITICAL));
+		assert(class_policy[i].reserved == (i == SLO_CLASS_CRITICAL));
+	}
+	assert(!class_policy[SLO_CLASS_STANDARD].preemptible);
+	printf("  Critical preempts batch and best-effort, never standard\n");
+
+	/* Simulated enqueue of a critical task onto a CPU running each class */
+	for (int running = 0; running < NR_SLO_CLASSES; running++) {
+		int kicked = class_policy[SLO_CLASS_CRITICAL].preempt &&
+			     class_policy[running].preemptible;
+
+		assert(kicked == (running == SLO_CLASS_BATCH || running == SLO_CLASS_BESTEFFORT));
+	}
+
+	/* Only critical and standard prefer a whole idle core on wakeup */
+	assert(class_policy[SLO_CLASS_CRITICAL].idle_core && class_policy[SLO_CLASS_STANDARD].idle_core);
+	assert(!class_policy[SLO_CLASS_BATCH].idle_core && !class_policy[SLO_CLASS_BESTEFFORT].idle_core);
+	printf("  Batch work keeps its previous CPU before taking an idle core\n");
+
+	printf("OK Latency class policies verified\n");
+}
+
+/*
+ * Simulation of the reserved CPU partition: DSQ choice in enqueue, idle
+ * CPU choice in select_cpu and which DSQs each CPU drains in dispatch
+ */
+#define SIM_CPUS 4
+#define SIM_SHARED_DSQ 0
+#define SIM_RESERVED_DSQ 2
+
+static uint32_t sim_reserved[SIM_CPUS];
+static uint32_t sim_nr_reserved;
+static uint32_t sim_reserve_importance = MAX_IMPORTANCE + 1;
+
+static int sim_cpu_reserved(int cpu)
+{
+	return sim_nr_reserved && sim_reserved[cpu];
+}
+
+static int sim_may_reserve(struct slo_cfg *cfg)
+{
+	return cfg && (class_policy[get_slo_class(cfg)].reserved ||
+		       cfg->importance >= sim_reserve_importance);
+}
+
+static int sim_enqueue_dsq(struct slo_cfg *cfg)
+{
+	return sim_nr_reserved && sim_may_reserve(cfg) ? SIM_RESERVED_DSQ : SIM_SHARED_DSQ;
+}
+
+/* CPU a wakeup goes to given the idle CPU found; *local if dispatched there */
+static int sim_select_cpu(struct slo_cfg *cfg, int prev, int idle_cpu, int prev_idle, int *local)
+{
+	*local = idle_cpu >= 0;
+	if (!*local)
+		return prev;
+	if (sim_cpu_reserved(idle_cpu) && !sim_may_reserve(cfg)) {
+		*local = prev != idle_cpu && !sim_cpu_reserved(prev) && prev_idle;
+		return prev;
+	}
+	return idle_cpu;
+}
+
+/* DSQ @cpu takes its next task from, given which are non-empty, or -1 */
+static int sim_dispatch(int cpu, int reserved_queued, int shared_queued)
+{
+	if (reserved_queued)
+		return SIM_RESERVED_DSQ;
+	if (!sim_cpu_reserved(cpu) && shared_queued)
+		return SIM_SHARED_DSQ;
+	return -1;
+}
+
+/* Test the reserved partition */
+static void test_reserved_partition(void)
+{
+	printf("Testing reserved CPU partition...\n");
+
+	struct slo_cfg crit = { .budget_ns = 10 * NSEC_PER_MSEC, .importance = 50,
+				.flags = SLO_CLASS_CRITICAL };
+	struct slo_cfg high = { .budget_ns = 10 * NSEC_PER_MSEC, .importance = 90 };
+	struct slo_cfg batch = { .budget_ns = 100 * NSEC_PER_MSEC, .importance = 10,
+				 .flags = SLO_CLASS_BATCH };
+	int local;
+
+	/* No partition: one DSQ, every CPU as before */
+	assert(sim_enqueue_dsq(&crit) == SIM_SHARED_DSQ);
+	assert(sim_select_cpu(&batch, 0, 3, 0, &local) == 3 && local);
+	for (int cpu = 0; cpu < SIM_CPUS; cpu++)
+		assert(sim_dispatch(cpu, 0, 1) == SIM_SHARED_DSQ);
+
+	/* Reserve CPU 3 for critical work and importance >= 80 */
+	sim_reserved[3] = 1;
+	sim_nr_reserved = 1;
+	sim_reserve_importance = 80;
+	assert(sim_enqueue_dsq(&crit) == SIM_RESERVED_DSQ);
+	assert(sim_enqueue_dsq(&high) == SIM_RESERVED_DSQ);
+	assert(sim_enqueue_dsq(&batch) == SIM_SHARED_DSQ);
+	assert(sim_enqueue_dsq(NULL) == SIM_SHARED_DSQ);
+	printf("  Critical and important tasks queue for the partition\n");
+
+	/* Batch work finding only the reserved CPU idle */
+	assert(sim_select_cpu(&batch, 1, 3, 1, &local) == 1 && local);
+	assert(sim_select_cpu(&batch, 1, 3, 0, &local) == 1 && !local);
+	assert(sim_select_cpu(&batch, 3, 3, 1, &local) == 3 && !local);
+	assert(sim_select_cpu(&crit, 1, 3, 0, &local) == 3 && local);
+	printf("  Other tasks never dispatched to an idle reserved CPU\n");
+
+	/* Reserved CPUs run only partition work; others run it first */
+	assert(sim_dispatch(3, 0, 1) == -1);
+	assert(sim_dispatch(3, 1, 1) == SIM_RESERVED_DSQ);
+	assert(sim_dispatch(0, 1, 1) == SIM_RESERVED_DSQ);
+	assert(sim_dispatch(0, 0, 1) == SIM_SHARED_DSQ);
+
+	/* Partition gone: leftovers in the reserved DSQ still drain */
+	sim_nr_reserved = 0;
+	assert(sim_dispatch(3, 1, 1) == SIM_RESERVED_DSQ);
+	assert(sim_dispatch(3, 0, 1) == SIM_SHARED_DSQ);
+	memset(sim_reserved, 0, sizeof(sim_reserved));
+	printf("  Reserved DSQ drained after the partition shrinks to 0\n");
+
+	printf("OK Reserved partition verified\n");
+}
+
 /* Test enqueue fallback behavior */
 static void test_enqueue_fallback(void)
 {
@@ -472,6 +657,393 @@ static void test_map_limits(void)
 	printf("OK Map limits verified\n");
 }
 
+/*
+ * Simulation of resolve_slo_cfg/lookup_slo_cfg: a cgroup is identified by
+ * its ancestor IDs from the root down (ids[level] is the cgroup itself)
+ */
+#define SIM_CGROUPS 8
+
+static struct { uint64_t id; struct slo_cfg cfg; } sim_slo_map[SIM_CGROUPS];
+static int sim_slo_nr;
+static uint64_t sim_slo_gen;
+static int sim_walks;
+
+struct sim_cgroup {
+	int level;
+	uint64_t ids[MAX_INHERIT_DEPTH + 2];
+	struct {
+		uint64_t gen;
+		struct slo_cfg cfg;
+		uint32_t resolved;
+		uint32_t found;
+	} cache;
+};
+
+static struct slo_cfg *sim_map_lookup(uint64_t id)
+{
+	for (int i = 0; i < sim_slo_nr; i++)
+		if (sim_slo_map[i].id == id)
+			return &sim_slo_map[i].cfg;
+	return NULL;
+}
+
+static int sim_resolve(struct sim_cgroup *cgrp, uint32_t depth, struct slo_cfg *out)
+{
+	sim_walks++;
+	for (int i = 0; i <= MAX_INHERIT_DEPTH; i++) {
+		struct slo_cfg *cfg;
+
+		if (i > (int)depth || cgrp->level - i < 0)
+			break;
+		cfg = sim_map_lookup(cgrp->ids[cgrp->level - i]);
+		if (cfg) {
+			*out = *cfg;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int sim_lookup(struct sim_cgroup *cgrp, uint32_t depth, struct slo_cfg *cfg)
+{
+	if (cgrp->cache.resolved && cgrp->cache.gen == sim_slo_gen) {
+		if (cgrp->cache.found)
+			*cfg = cgrp->cache.cfg;
+		return cgrp->cache.found;
+	}
+	cgrp->cache.found = sim_resolve(cgrp, depth, &cgrp->cache.cfg);
+	cgrp->cache.gen = sim_slo_gen;
+	cgrp->cache.resolved = 1;
+	*cfg = cgrp->cache.cfg;
+	return cgrp->cache.found;
+}
+
+/* Test SLO inheritance from ancestor cgroups and its cache */
+static void test_slo_inheritance(void)
+{
+	printf("Testing SLO inheritance from ancestors...\n");
+
+	/* / -> kubepods -> burstable -> pod -> container */
+	struct sim_cgroup ctr = { .level = 4, .ids = { 1, 10, 20, 30, 40 } };
+	struct sim_cgroup other = { .level = 2, .ids = { 1, 10, 21 } };
+	struct slo_cfg cfg;
+
+	sim_slo_nr = 0;
+	sim_slo_gen = 0;
+	sim_walks = 0;
+	sim_slo_map[sim_slo_nr].id = 30;   /* Pod slice */
+	sim_slo_map[sim_slo_nr++].cfg = (struct slo_cfg){ 20 * NSEC_PER_MSEC, 90, 0 };
+
+	/* Container inherits the pod's budget */
+	assert(sim_lookup(&ctr, DEFAULT_INHERIT_DEPTH, &cfg));
+	assert(cfg.budget_ns == 20 * NSEC_PER_MSEC && cfg.importance == 90);
+	assert(get_safe_budget(&cfg) == 20 * NSEC_PER_MSEC);
+	printf("  Container cgroup inherits pod SLO: 20ms, importance 90\n");
+
+	/* Steady state: cache hit, no walk */
+	assert(sim_lookup(&ctr, DEFAULT_INHERIT_DEPTH, &cfg));
+	assert(sim_walks == 1);
+	printf("  Second lookup served from cache\n");
+
+	/* Nothing above the sibling qos cgroup is configured */
+	assert(!sim_lookup(&other, DEFAULT_INHERIT_DEPTH, &cfg));
+	assert(get_safe_budget(NULL) == DEFAULT_BUDGET_NS);
+
+	/* An exact entry wins over the inherited one once the generation moves */
+	sim_slo_map[sim_slo_nr].id = 40;
+	sim_slo_map[sim_slo_nr++].cfg = (struct slo_cfg){ 5 * NSEC_PER_MSEC, 99, 0 };
+	assert(sim_lookup(&ctr, DEFAULT_INHERIT_DEPTH, &cfg));
+	assert(cfg.budget_ns == 20 * NSEC_PER_MSEC);   /* Stale until bumped */
+	sim_slo_gen++;
+	assert(sim_lookup(&ctr, DEFAULT_INHERIT_DEPTH, &cfg));
+	assert(cfg.budget_ns == 5 * NSEC_PER_MSEC && cfg.importance == 99);
+	printf("  Generation bump picks up the container's own entry\n");
+
+	/* Depth bounds the walk: 0 is exact match only */
+	sim_slo_nr = 1;   /* Only the pod entry */
+	sim_slo_gen++;
+	assert(!sim_lookup(&ctr, 0, &cfg));
+	sim_slo_gen++;
+	assert(sim_lookup(&ctr, 1, &cfg) && cfg.budget_ns == 20 * NSEC_PER_MSEC);
+	sim_slo_map[0].id = 10;   /* Move the entry up to kubepods */
+	sim_slo_gen++;
+	assert(!sim_lookup(&ctr, 2, &cfg));
+	sim_slo_gen++;
+	assert(sim_lookup(&ctr, 3, &cfg));
+	printf("  Depth 0 matches exactly, depth N reaches N levels up\n");
+
+	/* The walk stops at the root */
+	sim_slo_gen++;
+	assert(sim_lookup(&other, MAX_INHERIT_DEPTH, &cfg));
+	sim_slo_map[0].id = 99;
+	sim_slo_gen++;
+	assert(!sim_lookup(&other, MAX_INHERIT_DEPTH, &cfg));
+
+	printf("OK SLO inheritance verified\n");
+}
+
+/*
+ * Simulated cgroup_exit: entries are dropped only for removed cgroups,
+ * since the callback also runs for every cgroup when the scheduler
+ * detaches. Removal clears CSS_ONLINE on the cgroup's own css; CSS_DYING
+ * is never set there.
+ */
+#define CSS_ONLINE (1 << 1)
+
+static uint64_t sim_exit_deletes;
+
+static void sim_cgroup_exit(uint64_t id, uint32_t self_flags)
+{
+	if (self_flags & CSS_ONLINE)
+		return;
+	for (int i = 0; i < sim_slo_nr; i++) {
+		if (sim_slo_map[i].id == id) {
+			sim_slo_map[i] = sim_slo_map[--sim_slo_nr];
+			sim_exit_deletes++;
+			return;
+		}
+	}
+}
+
+/* Test that removed cgroups lose their SLO entries */
+static void test_cgroup_exit_gc(void)
+{
+	printf("Testing SLO entry removal on cgroup exit...\n");
+
+	struct slo_cfg cfg = { 20 * NSEC_PER_MSEC, 80, 0 };
+
+	sim_slo_nr = 0;
+	sim_exit_deletes = 0;
+	for (uint64_t id = 100; id < 100 + SIM_CGROUPS; id++) {
+		sim_slo_map[sim_slo_nr].id = id;
+		sim_slo_map[sim_slo_nr++].cfg = cfg;
+	}
+
+	/* Scheduler detach: every cgroup exits, all still online */
+	for (uint64_t id = 100; id < 100 + SIM_CGROUPS; id++)
+		sim_cgroup_exit(id, CSS_ONLINE);
+	assert(sim_slo_nr == SIM_CGROUPS && sim_exit_deletes == 0);
+	printf("  Detach keeps all %d entries\n", SIM_CGROUPS);
+
+	/* Pod churn: removed cgroups free their slots for new pods */
+	sim_cgroup_exit(101, 0);
+	sim_cgroup_exit(105, 0);
+	sim_cgroup_exit(999, 0);   /* Never configured */
+	assert(sim_slo_nr == SIM_CGROUPS - 2 && sim_exit_deletes == 2);
+	assert(!sim_map_lookup(101) && !sim_map_lookup(105) && sim_map_lookup(100));
+
+	sim_slo_map[sim_slo_nr].id = 200;
+	sim_slo_map[sim_slo_nr++].cfg = cfg;
+	sim_slo_map[sim_slo_nr].id = 201;
+	sim_slo_map[sim_slo_nr++].cfg = cfg;
+	assert(sim_slo_nr == SIM_CGROUPS);
+	printf("  2 removed cgroups dropped, slots reused by new pods\n");
+
+	printf("OK cgroup exit GC verified\n");
+}
+
+/* Simulation of deadline_window/target_offset from BPF */
+static uint64_t sim_window(const struct slo_cfg *cfg)
+{
+	return cfg->budget_ns * (101 - cfg->importance) / 100;
+}
+
+static int64_t sim_target_offset(const struct slo_target *t, const struct slo_cfg *cfg)
+{
+	if (!t || memcmp(&t->cfg, cfg, sizeof(*cfg)) != 0)
+		return 0;
+	return (int64_t)t->window_ns - (int64_t)sim_window(cfg);
+}
+
+/* Simulation of record_run from BPF */
+static void sim_record_run(struct slo_cgrp_stats *st, uint64_t deadline, int64_t off,
+			   uint64_t start, uint64_t now)
+{
+	if (off > 0)
+		deadline = deadline > UINT64_MAX - off ? UINT64_MAX : deadline + off;
+	else if (off < 0)
+		deadline = deadline < (uint64_t)-off ? 0 : deadline + off;
+
+	st->runs++;
+	if (now > deadline) {
+		st->late++;
+		st->lateness_ns += now - deadline;
+	} else {
+		st->slack_ns += deadline - now;
+	}
+	if (start && now > start)
+		st->runtime_ns += now - start;
+}
+
+/* Test run statistics for adaptive budgets */
+static void test_run_stats(void)
+{
+	printf("Testing run statistics against configured deadlines...\n");
+
+	struct slo_cfg base = { 100 * NSEC_PER_MSEC, 50, 0 };
+	struct slo_cfg tight = { 50 * NSEC_PER_MSEC, 50, 0 };
+	struct slo_target t = { .cfg = tight, .window_ns = sim_window(&base) };
+	struct slo_cgrp_stats st = {0};
+	uint64_t enq = NSEC_PER_SEC, deadline = enq + sim_window(&tight);
+	int64_t off = sim_target_offset(&t, &tight);
+
+	assert(sizeof(struct slo_cgrp_stats) == 5 * sizeof(uint64_t));
+	assert(sizeof(struct slo_target) == 24);
+
+	/* The adjusted entry is judged by the configured 51ms window, not 25.5ms */
+	assert(off == (int64_t)(sim_window(&base) - sim_window(&tight)));
+	sim_record_run(&st, deadline, off, enq + NSEC_PER_MSEC, enq + 40 * NSEC_PER_MSEC);
+	assert(st.runs == 1 && st.late == 0);
+	assert(st.slack_ns == 11 * NSEC_PER_MSEC);
+	assert(st.runtime_ns == 39 * NSEC_PER_MSEC);
+	sim_record_run(&st, deadline, off, 0, enq + 60 * NSEC_PER_MSEC);
+	assert(st.runs == 2 && st.late == 1 && st.lateness_ns == 9 * NSEC_PER_MSEC);
+	printf("  Late and slack measured against the configured window\n");
+
+	/* A target written for another value is ignored */
+	assert(sim_target_offset(&t, &base) == 0);
+	assert(sim_target_offset(NULL, &tight) == 0);
+
+	/* Offsets saturate at both ends */
+	sim_record_run(&st, UINT64_MAX - 5, 10, 0, UINT64_MAX);
+	assert(st.late == 1);
+	sim_record_run(&st, 5, -10, 0, 1);
+	assert(st.late == 2 && st.lateness_ns == 9 * NSEC_PER_MSEC + 1);
+	printf("  Offsets saturate instead of wrapping\n");
+
+	printf("OK Run statistics verified\n");
+}
+
+/* Simulation of the shadow mode tracepoint programs from BPF */
+#define SIM_SHADOW_PIDS 8
+
+struct sim_shadow_task {
+	uint64_t enqueue_time;
+	uint64_t deadline;
+	uint64_t start_time;
+	uint32_t valid;
+};
+
+static struct sim_shadow_task sim_shadow[SIM_SHADOW_PIDS];
+static struct slo_shadow_stats sim_shadow_stats;
+static uint64_t sim_shadow_misses;
+
+static uint32_t sim_hist_bucket(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	uint32_t b = 1;
+
+	if (!us)
+		return 0;
+	if (us >> 32) { us >>= 32; b += 32; }
+	if (us >> 16) { us >>= 16; b += 16; }
+	if (us >> 8) { us >>= 8; b += 8; }
+	if (us >> 4) { us >>= 4; b += 4; }
+	if (us >> 2) { us >>= 2; b += 2; }
+	if (us >> 1)
+		b += 1;
+	return b < SLO_HIST_BUCKETS ? b : SLO_HIST_BUCKETS - 1;
+}
+
+static void sim_hist_add(struct slo_hist *h, uint64_t ns)
+{
+	h->count++;
+	h->sum_ns += ns;
+	h->buckets[sim_hist_bucket(ns)]++;
+}
+
+static void sim_shadow_enqueue(uint32_t pid, const struct slo_cfg *cfg, uint64_t now,
+			       int noexist)
+{
+	struct sim_shadow_task *t = &sim_shadow[pid];
+
+	if (noexist && t->valid)
+		return;
+	t->enqueue_time = now;
+	t->deadline = now + sim_window(cfg);
+	t->start_time = 0;
+	t->valid = 1;
+}
+
+static void sim_shadow_switch(uint32_t prev, int prev_runnable, uint32_t next,
+			      const struct slo_cfg *cfg, uint64_t now)
+{
+	struct sim_shadow_task *t = &sim_shadow[prev];
+
+	if (t->valid && t->start_time) {
+		if (now > t->deadline) {
+			sim_hist_add(&sim_shadow_stats.lateness, now - t->deadline);
+			sim_shadow_misses++;
+		} else {
+			sim_hist_add(&sim_shadow_stats.slack, t->deadline - now);
+		}
+	}
+	if (prev_runnable)
+		sim_shadow_enqueue(prev, cfg, now, 0);
+	else
+		memset(t, 0, sizeof(*t));
+
+	t = &sim_shadow[next];
+	if (t->valid && !t->start_time) {
+		t->start_time = now;
+		if (now > t->enqueue_time)
+			sim_hist_add(&sim_shadow_stats.delay, now - t->enqueue_time);
+	}
+}
+
+/* Test shadow mode deadlines, misses and histograms */
+static void test_shadow_mode(void)
+{
+	printf("Testing shadow mode...\n");
+
+	struct slo_cfg cfg = { 10 * NSEC_PER_MSEC, 50, 0 };
+	uint64_t window = sim_window(&cfg), us;
+
+	/* Wakeups of a queued task keep the deadline, like a single enqueue */
+	sim_shadow_enqueue(1, &cfg, 0, 1);
+	sim_shadow_enqueue(1, &cfg, NSEC_PER_MSEC, 1);
+	assert(sim_shadow[1].deadline == window);
+
+	/* Running at 2ms: 2ms of queueing delay */
+	sim_shadow_switch(0, 0, 1, &cfg, 2 * NSEC_PER_MSEC);
+	assert(sim_shadow[1].start_time == 2 * NSEC_PER_MSEC);
+	assert(sim_shadow_stats.delay.count == 1);
+	assert(sim_shadow_stats.delay.sum_ns == 2 * NSEC_PER_MSEC);
+
+	/* Preempted at 4ms within the deadline: slack, then queued anew */
+	sim_shadow_switch(1, 1, 0, &cfg, 4 * NSEC_PER_MSEC);
+	assert(sim_shadow_stats.slack.count == 1);
+	assert(sim_shadow_stats.slack.sum_ns == window - 4 * NSEC_PER_MSEC);
+	assert(sim_shadow[1].deadline == 4 * NSEC_PER_MSEC + window);
+	assert(sim_shadow[1].start_time == 0);
+	printf("  Preempted task re-queued with a new deadline\n");
+
+	/* Back after 8ms of waiting, blocks past its deadline: a would-be miss */
+	sim_shadow_switch(0, 0, 1, &cfg, 12 * NSEC_PER_MSEC);
+	sim_shadow_switch(1, 0, 0, &cfg, 13 * NSEC_PER_MSEC);
+	assert(sim_shadow_misses == 1);
+	assert(sim_shadow_stats.lateness.sum_ns == 13 * NSEC_PER_MSEC - 4 * NSEC_PER_MSEC - window);
+	assert(!sim_shadow[1].valid);
+	assert(sim_shadow_stats.delay.buckets[sim_hist_bucket(8 * NSEC_PER_MSEC)] == 1);
+	printf("  Blocked task forgotten, miss counted against its deadline\n");
+
+	/* A task running before shadow mode started is picked up when preempted */
+	sim_shadow_switch(2, 1, 0, &cfg, 20 * NSEC_PER_MSEC);
+	assert(sim_shadow[2].valid && sim_shadow[2].deadline == 20 * NSEC_PER_MSEC + window);
+	assert(sim_shadow_stats.slack.count + sim_shadow_stats.lateness.count == 2);
+
+	/* The shift-based bucketing is a log2 of microseconds */
+	for (us = 1; us < (1ULL << 40); us = us * 3 + 1) {
+		uint32_t b = 64 - __builtin_clzll(us);
+
+		assert(sim_hist_bucket(us * 1000) == (b < SLO_HIST_BUCKETS ? b : SLO_HIST_BUCKETS - 1));
+	}
+	assert(sim_hist_bucket(999) == 0);
+	assert(sim_hist_bucket(UINT64_MAX) == SLO_HIST_BUCKETS - 1);
+
+	printf("OK Shadow mode verified\n");
+}
+
 /* Test deadline event structure packing */
 static void test_deadline_event_packing(void)
 {
@@ -510,8 +1082,14 @@ int main(void)
 	test_dsq_priority_ordering();
 	test_stats_increment();
 	test_cpu_selection_logic();
+	test_latency_classes();
+	test_reserved_partition();
 	test_enqueue_fallback();
 	test_map_limits();
+	test_slo_inheritance();
+	test_cgroup_exit_gc();
+	test_run_stats();
+	test_shadow_mode();
 	test_deadline_event_packing();
 
 	printf("\nAll BPF logic simulation tests passed!\n");
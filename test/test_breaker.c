@@ -0,0 +1,324 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for the circuit breaker
+ * Tests breaker.c with synthetic interval samples: absolute ceilings,
+ * the rolling baseline, trip hysteresis, cooldown and probation, and
+ * parameter parsing
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include "../src/breaker.h"
+
+#define SEC 1000000000ULL
+
+/* One interval with @runs runs, @late of them late, and mean delay @delay_us */
+static struct breaker_sample sample(__u64 runs, __u64 late, __u64 delay_us)
+{
+	struct breaker_sample s = {
+		.interval_ns = 5 * SEC,
+		.runs = runs,
+		.late = late,
+		.delay_ns = runs * delay_us * 1000,
+		.delays = runs,
+	};
+
+	return s;
+}
+
+static void test_params(void)
+{
+	printf("Testing parameter parsing...\n");
+
+	struct breaker_params p;
+
+	breaker_params_default(&p);
+	assert(p.trip_after == 3 && p.cooldown_sec == 60);
+
+	assert(breaker_parse(&p, "miss=0.2,cpu=0.05,trip_after=2,cooldown=30") == 0);
+	assert(p.miss_max == 0.2 && p.cpu_max == 0.05 && p.trip_after == 2);
+	assert(p.cooldown_sec == 30);
+
+	/* Out of range, or a cooldown above its cap */
+	assert(breaker_parse(&p, "cooldown=0") == -1);
+	assert(breaker_parse(&p, "miss=2") == -1);
+	assert(breaker_parse(&p, "cooldown=100,cooldown_max=50") == -1);
+
+	printf("OK Breaker keys and ranges\n");
+}
+
+/* Test tripping on an absolute ceiling only after trip_after intervals */
+static void test_absolute_trip(void)
+{
+	printf("Testing absolute ceilings...\n");
+
+	struct breaker_params p;
+	struct breaker_sample good = sample(10000, 10, 100), bad = sample(10000, 6000, 100);
+	struct breaker_trip trip;
+	struct breaker_stats st;
+	struct breaker *b;
+	__u64 now = 0;
+
+	breaker_params_default(&p);
+	b = breaker_new(&p);
+	assert(b);
+
+	/* Two bad intervals, a good one resets the streak */
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_NONE);
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_NONE);
+	assert(breaker_step(b, &good, now += 5 * SEC, &trip) == BREAKER_NONE);
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_NONE);
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_NONE);
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_DETACH);
+	assert(trip.reason == BREAKER_MISS_RATIO);
+	assert(trip.value == 0.6 && trip.threshold == 0.5);
+	assert(trip.bad_intervals == 3 && trip.cooldown_sec == 60);
+
+	breaker_get_stats(b, &st);
+	assert(st.state == BREAKER_OPEN && st.trips[BREAKER_MISS_RATIO] == 1);
+
+	/* Too few runs to judge: neither bad nor good */
+	breaker_free(b);
+	b = breaker_new(&p);
+	bad.runs = bad.delays = p.min_runs;
+	assert(breaker_step(b, &bad, now += 5 * SEC, NULL) == BREAKER_NONE);
+	assert(breaker_step(b, &bad, now += 5 * SEC, NULL) == BREAKER_NONE);
+	good.runs = good.delays = p.min_runs - 1;
+	for (int i = 0; i < 10; i++)
+		assert(breaker_step(b, &good, now += 5 * SEC, NULL) == BREAKER_NONE);
+	assert(breaker_step(b, &bad, now += 5 * SEC, NULL) == BREAKER_DETACH);
+	breaker_free(b);
+
+	printf("OK Trips after 3 bad intervals in a row, small samples ignored\n");
+}
+
+/* Test the scheduler's own CPU share */
+static void test_cpu_trip(void)
+{
+	printf("Testing scheduler CPU ceiling...\n");
+
+	struct breaker_params p;
+	struct breaker_sample s = sample(10, 0, 100);  /* Too few runs for the rest */
+	struct breaker_trip trip;
+	struct breaker *b;
+	__u64 now = 0;
+
+	breaker_params_default(&p);
+	p.trip_after = 1;
+	b = breaker_new(&p);
+
+	/* 8 CPUs for 5s; 2s in the scheduler is 5% */
+	s.nr_cpus = 8;
+	s.sched_ns = 2 * SEC;
+	assert(breaker_step(b, &s, now += 5 * SEC, &trip) == BREAKER_NONE);
+	s.sched_ns = 6 * SEC;
+	assert(breaker_step(b, &s, now += 5 * SEC, &trip) == BREAKER_DETACH);
+	assert(trip.reason == BREAKER_CPU && trip.value == 0.15);
+
+	/* Unknown CPU time is never judged */
+	breaker_free(b);
+	b = breaker_new(&p);
+	s.nr_cpus = 0;
+	assert(breaker_step(b, &s, now += 5 * SEC, &trip) == BREAKER_NONE);
+	breaker_free(b);
+
+	printf("OK 15%% CPU trips at a 10%% ceiling\n");
+}
+
+/* Test regression against the rolling baseline */
+static void test_baseline_trip(void)
+{
+	printf("Testing baseline regression...\n");
+
+	struct breaker_params p;
+	struct breaker_sample s;
+	struct breaker_trip trip;
+	struct breaker_stats st;
+	struct breaker *b;
+	__u64 now = 0;
+
+	breaker_params_default(&p);
+	p.warmup = 4;
+	b = breaker_new(&p);
+
+	/* 2% misses, 1ms delay: learnt, not judged against until warm */
+	s = sample(10000, 200, 1000);
+	for (int i = 0; i < 4; i++)
+		assert(breaker_step(b, &s, now += 5 * SEC, NULL) == BREAKER_NONE);
+	breaker_get_stats(b, &st);
+	assert(st.baseline_ready);
+	assert(st.baseline_miss > 0.0199 && st.baseline_miss < 0.0201);
+	assert(st.baseline_delay > 0.00099 && st.baseline_delay < 0.00101);
+
+	/* 6% is 3x the baseline, within the 4x factor */
+	s = sample(10000, 600, 1000);
+	for (int i = 0; i < 5; i++)
+		assert(breaker_step(b, &s, now += 5 * SEC, NULL) == BREAKER_NONE);
+
+	/* Queueing delay 5x the baseline, misses still fine */
+	breaker_get_stats(b, &st);
+	double base = st.baseline_delay;
+	s = sample(10000, 200, 5000);
+	assert(breaker_step(b, &s, now += 5 * SEC, NULL) == BREAKER_NONE);
+	assert(breaker_step(b, &s, now += 5 * SEC, NULL) == BREAKER_NONE);
+	assert(breaker_step(b, &s, now += 5 * SEC, &trip) == BREAKER_DETACH);
+	assert(trip.reason == BREAKER_DELAY_BASELINE);
+	assert(trip.threshold == 4 * base);
+
+	/* The regression did not move the baseline */
+	breaker_get_stats(b, &st);
+	assert(st.baseline_delay == base);
+	breaker_free(b);
+
+	/* A baseline near zero is held to the floor */
+	b = breaker_new(&p);
+	s = sample(10000, 0, 100);
+	for (int i = 0; i < 4; i++)
+		breaker_step(b, &s, now += 5 * SEC, NULL);
+	s = sample(10000, 30, 100);  /* 0.3%, under 4 x 1% */
+	for (int i = 0; i < 5; i++)
+		assert(breaker_step(b, &s, now += 5 * SEC, NULL) == BREAKER_NONE);
+	breaker_free(b);
+
+	printf("OK Delay regression trips, baseline unaffected by it\n");
+}
+
+/* Test cooldown, re-attach, probation and back-off */
+static void test_hysteresis(void)
+{
+	printf("Testing cooldown and probation...\n");
+
+	struct breaker_params p;
+	struct breaker_sample good = sample(10000, 10, 100), bad = sample(10000, 9000, 100);
+	struct breaker_trip trip;
+	struct breaker_stats st;
+	struct breaker *b;
+	__u64 now = 0;
+
+	breaker_params_default(&p);
+	p.trip_after = 1;
+	p.cooldown_sec = 60;
+	p.cooldown_max_sec = 200;
+	p.probation_sec = 30;
+	b = breaker_new(&p);
+
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_DETACH);
+	assert(trip.cooldown_sec == 60);
+
+	/* Samples while open are ignored until the cooldown is over */
+	for (int i = 0; i < 11; i++)
+		assert(breaker_step(b, &bad, now += 5 * SEC, NULL) == BREAKER_NONE);
+	assert(breaker_step(b, NULL, now += 5 * SEC, NULL) == BREAKER_ATTACH);
+	breaker_get_stats(b, &st);
+	assert(st.state == BREAKER_PROBATION && st.attaches == 1);
+	assert(st.open_ns == 60 * SEC);
+
+	/* Bad right away: trips at once, for twice as long */
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_DETACH);
+	assert(trip.cooldown_sec == 120);
+	assert(breaker_step(b, NULL, now += 119 * SEC, NULL) == BREAKER_NONE);
+	assert(breaker_step(b, NULL, now += 1 * SEC, NULL) == BREAKER_ATTACH);
+
+	/* A failed attach waits another cooldown */
+	breaker_attach_failed(b, now);
+	assert(breaker_step(b, NULL, now += 60 * SEC, NULL) == BREAKER_NONE);
+	assert(breaker_step(b, NULL, now += 60 * SEC, NULL) == BREAKER_ATTACH);
+
+	/* Capped at cooldown_max */
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_DETACH);
+	assert(trip.cooldown_sec == 200);
+	assert(breaker_step(b, NULL, now += 200 * SEC, NULL) == BREAKER_ATTACH);
+
+	/* Surviving probation closes the breaker and resets the cooldown */
+	for (int i = 0; i < 6; i++)
+		assert(breaker_step(b, &good, now += 5 * SEC, NULL) == BREAKER_NONE);
+	breaker_get_stats(b, &st);
+	assert(st.state == BREAKER_CLOSED);
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_DETACH);
+	assert(trip.cooldown_sec == 60);
+
+	breaker_get_stats(b, &st);
+	assert(st.trips[BREAKER_MISS_RATIO] == 4 && st.attaches == 3);
+	breaker_free(b);
+
+	printf("OK Cooldown doubles on probation trips up to the cap, resets after\n");
+}
+
+/* Attach stub: fails with -EBUSY while @ctx counts down, as when another scheduler holds sched_ext */
+static int attach_stub(void *ctx)
+{
+	int *busy = ctx;
+
+	if (*busy > 0) {
+		(*busy)--;
+		return -EBUSY;
+	}
+	return 0;
+}
+
+static void test_reattach(void)
+{
+	printf("Testing failed re-attaches...\n");
+
+	struct breaker_params p;
+	struct breaker_sample bad = sample(10000, 9000, 100);
+	struct breaker_trip trip;
+	struct breaker_stats st;
+	struct breaker *b;
+	__u64 now = 0;
+	int busy = 2;
+
+	breaker_params_default(&p);
+	p.trip_after = 1;
+	p.cooldown_sec = 60;
+	b = breaker_new(&p);
+
+	assert(breaker_step(b, &bad, now += 5 * SEC, &trip) == BREAKER_DETACH);
+
+	assert(breaker_step(b, NULL, now += 60 * SEC, NULL) == BREAKER_ATTACH);
+
+	/* Each failure stays open for another cooldown and is not an attach */
+	for (int i = 0; i < 2; i++) {
+		assert(breaker_reattach(b, now, attach_stub, &busy) == -EBUSY);
+		breaker_get_stats(b, &st);
+		assert(st.state == BREAKER_OPEN && st.attaches == 0);
+		assert(breaker_step(b, NULL, now += 59 * SEC, NULL) == BREAKER_NONE);
+		assert(breaker_step(b, NULL, now += 1 * SEC, NULL) == BREAKER_ATTACH);
+	}
+
+	assert(breaker_reattach(b, now, attach_stub, &busy) == 0);
+	breaker_get_stats(b, &st);
+	assert(st.state == BREAKER_PROBATION && st.attaches == 1);
+	breaker_free(b);
+
+	printf("OK Failed re-attaches stay detached and retry after the cooldown\n");
+}
+
+static void test_names(void)
+{
+	printf("Testing names...\n");
+
+	assert(strcmp(breaker_reason_name(BREAKER_CPU), "cpu") == 0);
+	assert(strcmp(breaker_reason_name(NR_BREAKER_REASONS), "unknown") == 0);
+	assert(strcmp(breaker_state_name(BREAKER_PROBATION), "probation") == 0);
+
+	printf("OK Names\n");
+}
+
+int main(void)
+{
+	printf("=== Circuit Breaker Tests ===\n\n");
+
+	test_params();
+	test_absolute_trip();
+	test_cpu_trip();
+	test_baseline_trip();
+	test_hysteresis();
+	test_reattach();
+	test_names();
+
+	printf("\nAll circuit breaker tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,597 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for the adaptive budget controller
+ * Tests budget_ctl.c against simulated cgroups and recorded traces:
+ * convergence, bounds and rate limits, anti-windup, holds, other writers
+ * and trace replay
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "../src/budget_ctl.h"
+#include "test_cgrp.h"
+
+#define BASE_BUDGET (100 * 1000000ULL)
+#define BASE_IMP    50
+#define RUNS        1000
+
+/*
+ * A cgroup seen through its SLO map entry. Each step it runs RUNS times;
+ * the fraction that misses the configured deadline and the mean slack of
+ * the rest depend on how far its budget was scaled down.
+ */
+struct plant {
+	struct test_cgrp cg;        /* cg.cfg is the entry as it is now */
+	struct slo_cfg base;
+	double (*miss)(double scale);
+	double (*slack)(double scale);  /* Per non-late run, as a fraction of the window */
+	double runtime;                 /* Per run, as a fraction of the window */
+};
+
+static void plant_init(struct plant *pl, __u64 id)
+{
+	memset(pl, 0, sizeof(*pl));
+	pl->cg.id = id;
+	pl->base = (struct slo_cfg){ .budget_ns = BASE_BUDGET, .importance = BASE_IMP };
+	pl->cg.cfg = pl->base;
+	pl->runtime = 0.05;
+}
+
+static double scale_of(const struct plant *pl)
+{
+	return (double)pl->cg.cfg.budget_ns / pl->base.budget_ns;
+}
+
+/* Run one interval and return the sample the agent would read */
+static struct budget_ctl_sample plant_run(struct plant *pl)
+{
+	double u = scale_of(pl), w = test_cgrp_window(&pl->base);
+	__u64 late = (__u64)(pl->miss(u) * RUNS + 0.5);
+
+	return test_cgrp_run(&pl->cg, RUNS, late, (__u64)(w / 10), (__u64)(pl->slack(u) * w),
+			     RUNS * (__u64)(pl->runtime * w));
+}
+
+/* Apply @u like slo_config_adjust(): only if the entry is unchanged */
+static int plant_apply(struct plant *pl, const struct budget_ctl_update *u, int n)
+{
+	int applied = 0;
+
+	for (int i = 0; i < n; i++) {
+		if (u[i].cgroup_id != pl->cg.id)
+			continue;
+		assert(memcmp(&u[i].expected, &pl->cg.cfg, sizeof(pl->cg.cfg)) == 0);
+		pl->cg.cfg = u[i].cfg;
+		applied++;
+	}
+	return applied;
+}
+
+/* One step of a single plant; returns the updates applied */
+static int plant_step(struct budget_ctl *c, struct plant *pl)
+{
+	struct budget_ctl_sample s = plant_run(pl);
+	struct budget_ctl_update u[1];
+	int n = budget_ctl_step(c, &s, 1, u);
+
+	assert(n >= 0 && n <= 1);
+	return plant_apply(pl, u, n);
+}
+
+/* Misses fall linearly from 20% to none as the budget goes down to 60% */
+static double miss_linear(double u)
+{
+	double m = 0.2 * (u - 0.6) / 0.4;
+
+	return m < 0 ? 0 : m;
+}
+
+static double slack_tightened(double u)
+{
+	return 0.1 + (1.0 - u);
+}
+
+static double miss_always(double u)
+{
+	(void)u;
+	return 0.5;
+}
+
+static double miss_never(double u)
+{
+	(void)u;
+	return 0;
+}
+
+static double slack_none(double u)
+{
+	(void)u;
+	return 0.01;
+}
+
+static double slack_plenty(double u)
+{
+	(void)u;
+	return 0.8;
+}
+
+static struct budget_ctl *new_ctl(struct budget_ctl_params *p)
+{
+	struct budget_ctl *c;
+
+	budget_ctl_params_default(p);
+	c = budget_ctl_new(p);
+	assert(c);
+	return c;
+}
+
+/* Test that a missing cgroup is tightened to its target, within bounds and rate limits */
+static void test_converges(void)
+{
+	printf("Testing convergence...\n");
+
+	struct budget_ctl_params p;
+	struct budget_ctl *c = new_ctl(&p);
+	struct plant pl;
+	double prev, misses = 0;
+
+	plant_init(&pl, 100);
+	pl.miss = miss_linear;
+	pl.slack = slack_tightened;
+
+	/* The first sample only primes the counters */
+	assert(plant_step(c, &pl) == 0);
+
+	prev = scale_of(&pl);
+	for (int i = 0; i < 100; i++) {
+		plant_step(c, &pl);
+		double u = scale_of(&pl);
+
+		assert(fabs(u - prev) <= p.max_step + 1e-6);
+		assert(u >= p.scale_min - 1e-6 && u <= p.scale_max + 1e-6);
+		assert(pl.cg.cfg.importance == BASE_IMP);
+		assert(pl.cg.cfg.flags == pl.base.flags);
+		if (i >= 80)
+			misses += miss_linear(u);
+		prev = u;
+	}
+	misses /= 20;
+	printf("  scale %.3f, misses %.4f over the last 20 intervals\n", scale_of(&pl), misses);
+
+	/* Near the target, and not pinned at the floor */
+	assert(misses <= 3 * p.target);
+	assert(scale_of(&pl) > 0.5 && scale_of(&pl) < 0.8);
+
+	struct budget_ctl_stats st;
+
+	budget_ctl_get_stats(c, &st);
+	assert(st.tracked == 1 && st.adjusted == 1 && st.saturated == 0 && st.rebased == 0);
+	assert(st.updates > 0);
+
+	/* The configured value stays visible to readers */
+	struct slo_cfg base;
+
+	assert(budget_ctl_base(c, pl.cg.id, &pl.cg.cfg, &base));
+	assert(base.budget_ns == BASE_BUDGET && base.importance == BASE_IMP);
+	assert(!budget_ctl_base(c, 999, &pl.cg.cfg, &base));
+	assert(base.budget_ns == pl.cg.cfg.budget_ns);
+
+	/* Misses are measured against the configured deadline */
+	struct budget_ctl_target t[2];
+
+	assert(budget_ctl_targets(c, t, 2) == 1);
+	assert(t[0].cgroup_id == pl.cg.id);
+	assert(memcmp(&t[0].target.cfg, &pl.cg.cfg, sizeof(pl.cg.cfg)) == 0);
+	assert(t[0].target.window_ns == (__u64)test_cgrp_window(&pl.base));
+
+	/* Stopping puts the configured value back */
+	struct budget_ctl_update u[2];
+
+	assert(budget_ctl_restore(c, u, 2) == 1);
+	assert(memcmp(&u[0].expected, &pl.cg.cfg, sizeof(pl.cg.cfg)) == 0);
+	assert(memcmp(&u[0].cfg, &pl.base, sizeof(pl.base)) == 0);
+
+	budget_ctl_free(c);
+	printf("OK Converges within bounds\n");
+}
+
+/* Test that a long saturation does not delay recovery */
+static void test_anti_windup(void)
+{
+	printf("Testing anti-windup...\n");
+
+	struct budget_ctl_params p;
+	struct budget_ctl *c;
+	struct budget_ctl_stats st;
+	struct plant pl;
+	int steps;
+
+	/* Bound the integral so loosely that only back-calculation limits it */
+	budget_ctl_params_default(&p);
+	assert(budget_ctl_parse(&p, "integral_max=1000") == 0);
+	c = budget_ctl_new(&p);
+	assert(c);
+
+	plant_init(&pl, 200);
+	pl.miss = miss_always;
+	pl.slack = slack_plenty;
+	for (int i = 0; i < 200; i++)
+		plant_step(c, &pl);
+
+	/* Budget at the floor, importance boosted up to its limit */
+	assert(fabs(scale_of(&pl) - p.scale_min) < 1e-6);
+	assert(pl.cg.cfg.importance == BASE_IMP + p.boost_max);
+	budget_ctl_get_stats(c, &st);
+	assert(st.saturated == 1);
+	printf("  saturated at scale %.2f, importance %u\n", scale_of(&pl), pl.cg.cfg.importance);
+
+	/* Once misses stop, the boost goes first, then the budget recovers */
+	pl.miss = miss_never;
+	for (steps = 1; steps <= 40; steps++) {
+		plant_step(c, &pl);
+		if (pl.cg.cfg.importance > BASE_IMP)
+			assert(fabs(scale_of(&pl) - p.scale_min) < 1e-6);
+		if (memcmp(&pl.cg.cfg, &pl.base, sizeof(pl.base)) == 0)
+			break;
+	}
+	printf("  back to the configured SLO after %d intervals\n", steps);
+	assert(steps <= 20);
+
+	budget_ctl_get_stats(c, &st);
+	assert(st.adjusted == 0 && st.saturated == 0);
+
+	budget_ctl_free(c);
+	printf("OK No windup\n");
+}
+
+/* Test that entries are held when loosening or tightening cannot be justified */
+static void test_holds(void)
+{
+	printf("Testing holds...\n");
+
+	struct budget_ctl_params p;
+	struct budget_ctl *c = new_ctl(&p);
+	struct plant pl;
+	double u;
+
+	/* No slack: tightened once, never loosened */
+	plant_init(&pl, 300);
+	pl.miss = miss_always;
+	pl.slack = slack_none;
+	for (int i = 0; i < 4; i++)
+		plant_step(c, &pl);
+	u = scale_of(&pl);
+	assert(u < 1.0);
+	pl.miss = miss_never;
+	for (int i = 0; i < 20; i++)
+		assert(plant_step(c, &pl) == 0);
+	assert(scale_of(&pl) == u);
+	printf("  no loosening without slack at scale %.2f\n", u);
+	budget_ctl_free(c);
+
+	/* Runs longer than their window: misses are their own, nothing changes */
+	c = new_ctl(&p);
+	plant_init(&pl, 301);
+	pl.miss = miss_always;
+	pl.slack = slack_plenty;
+	pl.runtime = 1.5;
+	for (int i = 0; i < 20; i++)
+		assert(plant_step(c, &pl) == 0);
+	assert(memcmp(&pl.cg.cfg, &pl.base, sizeof(pl.base)) == 0);
+	printf("  overlong runs left alone\n");
+	budget_ctl_free(c);
+
+	/* Too few runs to judge */
+	c = new_ctl(&p);
+	struct budget_ctl_sample s = { .cgroup_id = 302, .cfg = pl.base };
+	struct budget_ctl_update upd[1];
+
+	for (int i = 0; i < 20; i++) {
+		s.stats.runs += p.min_runs - 1;
+		s.stats.late += p.min_runs - 1;
+		assert(budget_ctl_step(c, &s, 1, upd) == 0);
+	}
+	printf("  idle cgroup left alone\n");
+
+	/* Counters that went backwards only reprime */
+	s.stats = (struct slo_cgrp_stats){ .runs = 5 };
+	assert(budget_ctl_step(c, &s, 1, upd) == 0);
+	s.stats.runs += RUNS;
+	s.stats.late += RUNS / 2;
+	assert(budget_ctl_step(c, &s, 1, upd) == 1);
+	printf("  counter reset reprimed\n");
+	budget_ctl_free(c);
+
+	printf("OK Holds correct\n");
+}
+
+/* Test that other writers and lost updates are followed */
+static void test_other_writers(void)
+{
+	printf("Testing other writers...\n");
+
+	struct budget_ctl_params p;
+	struct budget_ctl *c = new_ctl(&p);
+	struct budget_ctl_stats st;
+	struct budget_ctl_sample s;
+	struct budget_ctl_update u[1];
+	struct slo_cfg base;
+	struct plant pl;
+	int n;
+
+	plant_init(&pl, 400);
+	pl.miss = miss_always;
+	pl.slack = slack_plenty;
+	for (int i = 0; i < 3; i++)
+		plant_step(c, &pl);
+	assert(scale_of(&pl) < 1.0);
+
+	/* A config publish writes the base back: the adjusted value returns */
+	struct slo_cfg eff = pl.cg.cfg;
+
+	pl.cg.cfg = pl.base;
+	s = plant_run(&pl);
+	n = budget_ctl_step(c, &s, 1, u);
+	assert(n == 1);
+	assert(memcmp(&u[0].expected, &pl.base, sizeof(pl.base)) == 0);
+	assert(u[0].cfg.budget_ns <= eff.budget_ns);
+	plant_apply(&pl, u, n);
+
+	/* An update that did not land is retried from the value in the map */
+	s = plant_run(&pl);
+	n = budget_ctl_step(c, &s, 1, u);
+	assert(n == 1);
+	s = plant_run(&pl);
+	n = budget_ctl_step(c, &s, 1, u);
+	assert(n == 1);
+	plant_apply(&pl, u, n);
+	budget_ctl_get_stats(c, &st);
+	assert(st.rebased == 0);
+
+	/* A new value from someone else becomes the base */
+	pl.base.budget_ns = 40 * 1000000ULL;
+	pl.base.importance = 70;
+	pl.cg.cfg = pl.base;
+	assert(budget_ctl_base(c, pl.cg.id, &pl.cg.cfg, &base) == false);
+	s = plant_run(&pl);
+	assert(budget_ctl_step(c, &s, 1, u) == 0);
+	budget_ctl_get_stats(c, &st);
+	assert(st.rebased == 1 && st.adjusted == 0);
+	assert(budget_ctl_base(c, pl.cg.id, &pl.cg.cfg, &base));
+	assert(base.budget_ns == 40 * 1000000ULL && base.importance == 70);
+
+	/* Entries no longer in the map are forgotten */
+	assert(budget_ctl_step(c, &s, 0, u) == 0);
+	budget_ctl_get_stats(c, &st);
+	assert(st.tracked == 0);
+
+	budget_ctl_free(c);
+	printf("OK Other writers followed\n");
+}
+
+/* Test many cgroups in one step, unsorted */
+static void test_many(void)
+{
+	printf("Testing many cgroups...\n");
+
+	struct budget_ctl_params p;
+	struct budget_ctl *c = new_ctl(&p);
+	struct plant pl[64];
+	struct budget_ctl_sample s[64];
+	struct budget_ctl_update u[64];
+	int n = 0;
+
+	for (int i = 0; i < 64; i++) {
+		plant_init(&pl[i], 1000 + (i * 37) % 64);
+		pl[i].miss = i % 2 ? miss_linear : miss_never;
+		pl[i].slack = slack_tightened;
+	}
+	for (int step = 0; step < 10; step++) {
+		for (int i = 0; i < 64; i++)
+			s[i] = plant_run(&pl[i]);
+		n = budget_ctl_step(c, s, 64, u);
+		assert(n >= 0);
+		for (int i = 1; i < 64; i++)
+			assert(s[i - 1].cgroup_id < s[i].cgroup_id);
+		for (int i = 0; i < 64; i++)
+			plant_apply(&pl[i], u, n);
+	}
+	for (int i = 0; i < 64; i++)
+		assert((i % 2 == 1) == (scale_of(&pl[i]) < 1.0));
+
+	struct budget_ctl_stats st;
+
+	budget_ctl_get_stats(c, &st);
+	assert(st.tracked == 64 && st.adjusted == 32);
+	printf("  %u of %u cgroups adjusted\n", st.adjusted, st.tracked);
+
+	budget_ctl_free(c);
+	printf("OK Many cgroups stepped together\n");
+}
+
+/*
+ * Recorded on a test node: cgroup 7 misses a fifth of its runs for four
+ * intervals, then its misses stop; cgroup 9 meets its SLO throughout and
+ * its base is changed halfway.
+ */
+static const char recorded_trace[] =
+	"# scx-slo budget trace\n"
+	"T 5000000000 2\n"
+	"C 7 50000000 60 1 0 0 0 0 0\n"
+	"C 9 20000000 90 0 0 0 0 0 0\n"
+	"T 5000000000 2\n"
+	"C 7 50000000 60 1 800 160 16000000 1000000000 2000000000\n"
+	"C 9 20000000 90 0 400 0 0 100000000 80000000\n"
+	"T 5000000000 2\n"
+	"C 7 50000000 60 1 1600 320 32000000 2000000000 4000000000\n"
+	"C 9 20000000 90 0 800 0 0 200000000 160000000\n"
+	"T 5000000000 2\n"
+	"C 7 50000000 60 1 2400 470 47000000 3200000000 6000000000\n"
+	"C 9 20000000 90 0 1200 0 0 300000000 240000000\n"
+	"T 5000000000 2\n"
+	"C 7 50000000 60 1 3200 610 61000000 4500000000 8000000000\n"
+	"C 9 30000000 90 0 1600 0 0 400000000 320000000\n"
+	"# misses stop\n"
+	"T 5000000000 2\n"
+	"C 7 50000000 60 1 4000 610 61000000 10000000000 10000000000\n"
+	"C 9 30000000 90 0 2000 0 0 500000000 400000000\n"
+	"T 5000000000 2\n"
+	"C 7 50000000 60 1 4800 610 61000000 16000000000 12000000000\n"
+	"C 9 30000000 90 0 2400 0 0 600000000 480000000\n"
+	"T 5000000000 2\n"
+	"C 7 50000000 60 1 5600 610 61000000 22000000000 14000000000\n"
+	"C 9 30000000 90 0 2800 0 0 700000000 560000000\n";
+
+struct replay_log {
+	__u64 budget7[16];
+	int updates9;
+	int steps;
+};
+
+static void replay_step(unsigned int step, const struct budget_ctl_sample *s, size_t nr,
+			const struct budget_ctl_update *u, size_t nr_u, void *ctx)
+{
+	struct replay_log *log = ctx;
+
+	assert(nr == 2 && s[0].cgroup_id == 7 && s[1].cgroup_id == 9);
+	log->budget7[step] = s[0].cfg.budget_ns;
+	for (size_t i = 0; i < nr_u; i++) {
+		if (u[i].cgroup_id == 7)
+			log->budget7[step] = u[i].cfg.budget_ns;
+		else
+			log->updates9++;
+	}
+	log->steps++;
+}
+
+/* Test replaying a recorded trace offline */
+static void test_replay(void)
+{
+	printf("Testing trace replay...\n");
+
+	struct budget_ctl_params p;
+	struct budget_ctl *c = new_ctl(&p);
+	struct replay_log log = {0};
+	FILE *f = fmemopen((void *)recorded_trace, sizeof(recorded_trace) - 1, "r");
+
+	assert(f);
+	assert(budget_ctl_replay(c, f, replay_step, &log) == 8);
+	fclose(f);
+
+	printf("  cgroup 7 budget:");
+	for (int i = 0; i < log.steps; i++)
+		printf(" %llu", (unsigned long long)log.budget7[i] / 1000000);
+	printf(" ms\n");
+
+	/* Tightened while missing, at most one step at a time, then loosened */
+	assert(log.budget7[0] == 50000000);
+	for (int i = 1; i < 5; i++) {
+		assert(log.budget7[i] <= log.budget7[i - 1]);
+		assert(log.budget7[i - 1] - log.budget7[i] <= 50000000 * p.max_step + 1);
+	}
+	assert(log.budget7[4] < 50000000);
+	assert(log.budget7[7] > log.budget7[4]);
+
+	/* Cgroup 9 never needed a change, its new base included */
+	assert(log.updates9 == 0);
+
+	/* Replays are deterministic */
+	struct replay_log again = {0};
+
+	budget_ctl_free(c);
+	c = new_ctl(&p);
+	f = fmemopen((void *)recorded_trace, sizeof(recorded_trace) - 1, "r");
+	assert(budget_ctl_replay(c, f, replay_step, &again) == 8);
+	fclose(f);
+	assert(memcmp(&log, &again, sizeof(log)) == 0);
+
+	/* Malformed traces are refused */
+	static const char bad[] = "T 5000000000 2\nC 7 50000000 60 1 0 0 0 0 0\n";
+
+	f = fmemopen((void *)bad, sizeof(bad) - 1, "r");
+	assert(budget_ctl_replay(c, f, NULL, NULL) == -1);
+	fclose(f);
+
+	budget_ctl_free(c);
+	printf("OK Trace replayed\n");
+}
+
+/* Test that traces read back what was written */
+static void test_trace_roundtrip(void)
+{
+	printf("Testing trace round trip...\n");
+
+	struct budget_ctl_sample in[3], *out = NULL;
+	size_t nr, cap = 0;
+	__u64 interval;
+	FILE *f = tmpfile();
+
+	assert(f);
+	for (int i = 0; i < 3; i++) {
+		in[i] = (struct budget_ctl_sample){
+			.cgroup_id = 1ULL << (20 + i),
+			.cfg = { .budget_ns = MAX_BUDGET_NS - i, .importance = 100 - i, .flags = i },
+			.stats = { .runs = ~0ULL - i, .late = 3 + i, .lateness_ns = 4 + i,
+				   .slack_ns = 5 + i, .runtime_ns = 6 + i },
+		};
+	}
+	assert(budget_ctl_trace_write(f, 5000000000ULL, in, 3) == 0);
+	assert(budget_ctl_trace_write(f, 1000000000ULL, in, 1) == 0);
+	rewind(f);
+
+	assert(budget_ctl_trace_read(f, &interval, &out, &nr, &cap) == 1);
+	assert(interval == 5000000000ULL && nr == 3);
+	assert(memcmp(in, out, sizeof(in)) == 0);
+	assert(budget_ctl_trace_read(f, &interval, &out, &nr, &cap) == 1);
+	assert(interval == 1000000000ULL && nr == 1);
+	assert(budget_ctl_trace_read(f, &interval, &out, &nr, &cap) == 0);
+
+	free(out);
+	fclose(f);
+	printf("OK Traces round trip\n");
+}
+
+/* Test controller parameter specs */
+static void test_parse(void)
+{
+	printf("Testing parameter specs...\n");
+
+	struct budget_ctl_params p;
+
+	budget_ctl_params_default(&p);
+	assert(budget_ctl_parse(&p, "target=0.05,kp=0.2,scale_min=0.5,interval=10,"
+				    "boost_max=0,trace=/tmp/slo.trace") == 0);
+	assert(p.target == 0.05 && p.kp == 0.2 && p.scale_min == 0.5);
+	assert(p.interval_sec == 10 && p.boost_max == 0);
+	assert(strcmp(p.trace, "/tmp/slo.trace") == 0);
+	assert(p.ki == 0.05);
+
+	/* Out of range, or scale_min above scale_max */
+	const char *bad[] = {
+		"target=0", "target=0.9", "kp=-1", "scale_min=0", "scale_max=5",
+		"scale_min=0.9,scale_max=0.5", "interval=0", "boost_max=101",
+	};
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+		assert(budget_ctl_parse(&p, bad[i]) == -1);
+
+	printf("OK Parameter specs parsed\n");
+}
+
+int main(void)
+{
+	printf("Running adaptive budget tests...\n\n");
+
+	test_converges();
+	test_anti_windup();
+	test_holds();
+	test_other_writers();
+	test_many();
+	test_replay();
+	test_trace_roundtrip();
+	test_parse();
+
+	printf("\nAll adaptive budget tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for burst learning
+ * Tests burst.c: parameter parsing, the averages over activations split
+ * into several runs, slices, short-burst boosts and miss predictions
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "../src/burst.h"
+
+#define US 1000ULL
+#define MS 1000000ULL
+
+/* One activation starting at @at: runs of @run_ns each, back to back */
+static void activation(const struct burst_params *p, struct slo_task_burst *b, __u64 at,
+		       __u64 run_ns, int runs)
+{
+	for (int i = 0; i < runs; i++) {
+		burst_running(b, at);
+		at += run_ns;
+		burst_stopping(p, b, at, i < runs - 1);
+	}
+}
+
+static void test_params(void)
+{
+	printf("Testing parameter parsing...\n");
+
+	struct burst_params p;
+
+	burst_params_default(&p);
+	assert(p.shift == 3 && p.min_samples == 4 && p.short_ns == 1 * MS);
+	assert(p.boost == 50 && p.slice_mult == 2 && p.slice_min_ns == 250 * US);
+
+	assert(burst_parse(&p, "shift=2,short_us=500,boost=25,slice_min_us=100") == 0);
+	assert(p.shift == 2 && p.short_ns == 500 * US && p.boost == 25);
+	assert(p.slice_min_ns == 100 * US);
+
+	/* Out of range */
+	assert(burst_parse(&p, "shift=9") == -1);
+	assert(burst_parse(&p, "min_samples=0") == -1);
+	assert(burst_parse(&p, "slice_min_us=5") == -1);
+
+	printf("OK Burst learning keys and ranges\n");
+}
+
+/* Test the averages, with activations split over several runs */
+static void test_learning(void)
+{
+	printf("Testing burst and interval averages...\n");
+
+	struct burst_params p;
+	struct slo_task_burst b;
+
+	burst_params_default(&p);
+	memset(&b, 0, sizeof(b));
+
+	/* The first activation is taken as is; its interval is not known yet */
+	activation(&p, &b, 10 * MS, 200 * US, 2);
+	assert(b.burst_ns == 400 * US && b.interval_ns == 0 && b.samples == 1);
+	assert(!b.act_start && !b.act_ns && !b.run_start);
+
+	/* Then each moves the average an eighth of the way */
+	activation(&p, &b, 14 * MS, 1200 * US, 1);
+	assert(b.burst_ns == 500 * US && b.interval_ns == 4 * MS && b.samples == 2);
+	activation(&p, &b, 22 * MS, 500 * US, 1);
+	assert(b.burst_ns == 500 * US && b.interval_ns == 4500 * US);
+	assert(!burst_learned(&p, &b));
+
+	/* A run that stays runnable keeps the activation going */
+	burst_running(&b, 30 * MS);
+	burst_stopping(&p, &b, 30 * MS + 100 * US, true);
+	assert(b.act_start == 30 * MS && b.act_ns == 100 * US && b.samples == 3);
+	burst_running(&b, 31 * MS);
+	burst_stopping(&p, &b, 31 * MS + 400 * US, false);
+	assert(b.samples == 4 && b.burst_ns == 500 * US && burst_learned(&p, &b));
+
+	printf("OK Activations averaged across runs, intervals between their starts\n");
+}
+
+static void test_policy(void)
+{
+	printf("Testing slices, boosts and predictions...\n");
+
+	struct burst_params p;
+	struct slo_task_burst b = {
+		.burst_ns = 500 * US, .interval_ns = 4 * MS, .samples = 4,
+	};
+
+	burst_params_default(&p);
+
+	/* Slices: twice the burst, within the minimum and the class slice */
+	assert(burst_slice(&p, &b, 20 * MS) == 1 * MS);
+	assert(burst_slice(&p, &b, 800 * US) == 800 * US);
+	b.burst_ns = 50 * US;
+	assert(burst_slice(&p, &b, 20 * MS) == 250 * US);
+	b.samples = 3;
+	assert(burst_slice(&p, &b, 20 * MS) == 20 * MS);
+
+	/* Short bursts move half the window ahead, if they sleep as long */
+	b.samples = 4;
+	b.burst_ns = 500 * US;
+	assert(burst_short(&p, &b));
+	assert(burst_vtime(&p, &b, 100 * MS, 10 * MS) == 95 * MS);
+	assert(burst_vtime(&p, &b, 3 * MS, 10 * MS) == 0);
+	b.interval_ns = 900 * US;
+	assert(!burst_short(&p, &b));
+	assert(burst_vtime(&p, &b, 100 * MS, 10 * MS) == 100 * MS);
+	b.interval_ns = 4 * MS;
+	b.burst_ns = 2 * MS;
+	assert(!burst_short(&p, &b));
+
+	/* Predicted to miss when the rest of the burst exceeds the slack */
+	assert(burst_predict(&p, &b, 1 * MS));
+	assert(!burst_predict(&p, &b, 2 * MS));
+	b.act_ns = 1500 * US;
+	assert(!burst_predict(&p, &b, 1 * MS));
+	assert(burst_predict(&p, &b, 400 * US));
+	b.samples = 1;
+	assert(!burst_predict(&p, &b, 0));
+
+	printf("OK Slices sized, short bursts boosted, misses predicted\n");
+}
+
+static void test_sum(void)
+{
+	printf("Testing per-CPU sums...\n");
+
+	struct slo_burst_stats percpu[2] = {
+		{ .runs = 10, .late = 2, .predicted = 3, .predicted_late = 1, .boosted = 5 },
+		{ .runs = 5, .late = 1, .predicted = 1, .predicted_late = 1, .boosted = 0 },
+	}, sum;
+
+	burst_stats_sum(&sum, percpu, 2);
+	assert(sum.runs == 15 && sum.late == 3 && sum.predicted == 4);
+	assert(sum.predicted_late == 2 && sum.boosted == 5);
+
+	printf("OK Counters added up\n");
+}
+
+int main(void)
+{
+	printf("=== Burst Learning Tests ===\n\n");
+
+	test_params();
+	test_learning();
+	test_policy();
+	test_sum();
+
+	printf("\nAll burst learning tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,385 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for the cgroup ID reverse index
+ * Tests cgroup_index.c against a scratch directory tree
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "../src/cgroup_index.h"
+
+static char root[256];
+
+static void make_dir(const char *rel)
+{
+	char path[512];
+
+	snprintf(path, sizeof(path), "%s%s", root, rel);
+	assert(mkdir(path, 0755) == 0);
+}
+
+static void remove_dir(const char *rel)
+{
+	char path[512];
+
+	snprintf(path, sizeof(path), "%s%s", root, rel);
+	assert(rmdir(path) == 0);
+}
+
+/* Find the ID the index assigned to a path */
+struct find_ctx {
+	const char *path;
+	__u64 id;
+	int visited;
+};
+
+static void find_by_path(const struct cgroup_info *info, void *ctx)
+{
+	struct find_ctx *f = ctx;
+
+	f->visited++;
+	if (strcmp(info->path, f->path) == 0)
+		f->id = info->id;
+}
+
+static __u64 id_of(struct cgroup_index *idx, const char *path)
+{
+	struct find_ctx f = { .path = path };
+
+	cgroup_index_foreach(idx, find_by_path, &f);
+	return f.id;
+}
+
+/* Test pod UID extraction from kubelet cgroup layouts */
+static void test_pod_uid_parsing(void)
+{
+	printf("Testing pod UID extraction...\n");
+
+	struct {
+		const char *path;
+		const char *uid;
+	} cases[] = {
+		{"/kubepods.slice/kubepods-burstable.slice/"
+		 "kubepods-burstable-pod1f2e3d4c_aaaa_bbbb_cccc_0123456789ab.slice",
+		 "1f2e3d4c-aaaa-bbbb-cccc-0123456789ab"},
+		{"/kubepods.slice/kubepods-pod0a1b2c3d_0000_1111_2222_333344445555.slice/"
+		 "cri-containerd-abcdef.scope",
+		 "0a1b2c3d-0000-1111-2222-333344445555"},
+		{"/kubepods/burstable/pod9e8d7c6b-1111-2222-3333-444455556666/abc123",
+		 "9e8d7c6b-1111-2222-3333-444455556666"},
+		{"/kubepods/pod01234567-89ab-cdef-0123-456789abcdef",
+		 "01234567-89ab-cdef-0123-456789abcdef"},
+	};
+	char uid[CGROUP_INDEX_POD_MAX];
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		assert(cgroup_path_to_pod_uid(cases[i].path, uid, sizeof(uid)));
+		assert(strcmp(uid, cases[i].uid) == 0);
+		printf("  %s -> %s\n", cases[i].path, uid);
+	}
+
+	/* Non-pod cgroups must not produce a UID */
+	const char *non_pod[] = {
+		"/",
+		"/system.slice/kubelet.service",
+		"/kubepods.slice/kubepods-burstable.slice",
+		"/user.slice/user-1000.slice",
+		"/podman/pod1234",             /* "pod" prefix outside kubepods */
+		"/kubepods/burstable/podXYZ",  /* Not a UID */
+	};
+	for (size_t i = 0; i < sizeof(non_pod) / sizeof(non_pod[0]); i++) {
+		assert(!cgroup_path_to_pod_uid(non_pod[i], uid, sizeof(uid)));
+		printf("  %s -> (none)\n", non_pod[i]);
+	}
+
+	printf("OK Pod UID extraction correct\n");
+}
+
+/* Test the initial walk and O(1) lookups */
+static void test_build_and_lookup(void)
+{
+	printf("Testing initial walk and lookup...\n");
+
+	make_dir("/kubepods");
+	make_dir("/kubepods/burstable");
+	make_dir("/kubepods/burstable/pod11111111-2222-3333-4444-555555555555");
+	make_dir("/kubepods/burstable/pod11111111-2222-3333-4444-555555555555/ctr1");
+	make_dir("/system.slice");
+
+	struct cgroup_index *idx = cgroup_index_new(root);
+	assert(idx);
+
+	int count = cgroup_index_build(idx);
+	assert(count == 6);  /* root + 5 directories */
+	assert(cgroup_index_size(idx) == 6);
+	printf("  Indexed %d cgroups\n", count);
+
+	__u64 id = id_of(idx, "/kubepods/burstable/pod11111111-2222-3333-4444-555555555555/ctr1");
+	assert(id != 0);
+
+	struct cgroup_info info;
+	assert(cgroup_index_lookup(idx, id, &info) == 0);
+	assert(strcmp(info.pod, "11111111-2222-3333-4444-555555555555") == 0);
+	assert(info.namespace[0] == '\0');
+	printf("  Container cgroup inherits pod UID %s\n", info.pod);
+
+	assert(cgroup_index_lookup(idx, id_of(idx, "/system.slice"), &info) == 0);
+	assert(info.pod[0] == '\0');
+	printf("  Non-pod cgroup has no pod label\n");
+
+	assert(cgroup_index_lookup(idx, 0xdeadbeefULL, &info) != 0);
+	printf("  Unknown ID not found\n");
+
+	cgroup_index_free(idx);
+	printf("OK Walk and lookup correct\n");
+}
+
+/* Test per-cgroup miss accounting */
+static void test_record_miss(void)
+{
+	printf("Testing per-cgroup miss accounting...\n");
+
+	struct cgroup_index *idx = cgroup_index_new(root);
+	assert(idx);
+	assert(cgroup_index_build(idx) > 0);
+
+	__u64 id = id_of(idx, "/system.slice");
+	cgroup_index_record_miss(idx, id, 5000000);
+	cgroup_index_record_miss(idx, id, 3000000);
+
+	struct cgroup_info info;
+	assert(cgroup_index_lookup(idx, id, &info) == 0);
+	assert(info.deadline_misses == 2);
+	assert(info.miss_duration_ns == 8000000);
+	printf("  %s: misses=%llu duration=%lluns\n", info.path,
+	       (unsigned long long)info.deadline_misses,
+	       (unsigned long long)info.miss_duration_ns);
+
+	/* Misses for unknown IDs are kept under an unresolved entry */
+	size_t before = cgroup_index_size(idx);
+	cgroup_index_record_miss(idx, 424242, 1000);
+	assert(cgroup_index_size(idx) == before + 1);
+	assert(cgroup_index_lookup(idx, 424242, &info) == 0);
+	assert(info.deadline_misses == 1);
+	assert(info.path[0] == '\0');
+	printf("  Unknown cgroup tracked without path\n");
+
+	/* Reserved slot markers are never inserted */
+	cgroup_index_record_miss(idx, 0, 1000);
+	assert(cgroup_index_size(idx) == before + 1);
+
+	/* Unresolved cgroups are reported as one sum */
+	__u64 misses, miss_ns;
+
+	cgroup_index_record_miss(idx, 434343, 2000);
+	cgroup_index_record_miss(idx, 434343, 3000);
+	cgroup_index_unresolved(idx, &misses, &miss_ns);
+	assert(misses == 3 && miss_ns == 6000);
+
+	cgroup_index_free(idx);
+	printf("OK Miss accounting correct\n");
+}
+
+/* Test the cap on unresolved entries and their expiry */
+static void test_unresolved_expiry(void)
+{
+	printf("Testing unresolved entry cap and expiry...\n");
+
+	struct cgroup_index *idx = cgroup_index_new(root);
+	assert(idx);
+	assert(cgroup_index_build(idx) > 0);
+
+	size_t before = cgroup_index_size(idx);
+	const __u64 base = 1000000;
+	__u64 misses, miss_ns;
+
+	/* Unknown cgroups past the cap still count towards the total */
+	for (__u64 i = 0; i < CGROUP_INDEX_UNRESOLVED_MAX + 10; i++)
+		cgroup_index_record_miss(idx, base + i, 1000);
+	assert(cgroup_index_size(idx) == before + CGROUP_INDEX_UNRESOLVED_MAX);
+	cgroup_index_unresolved(idx, &misses, &miss_ns);
+	assert(misses == CGROUP_INDEX_UNRESOLVED_MAX + 10);
+	printf("  %d entries kept, all misses counted\n", CGROUP_INDEX_UNRESOLVED_MAX);
+
+	/* Entries that keep missing stay; idle ones go, their misses kept */
+	for (int pass = 1; pass < CGROUP_INDEX_UNRESOLVED_IDLE; pass++) {
+		cgroup_index_record_miss(idx, base, 1000);
+		assert(cgroup_index_expire_unresolved(idx) == 0);
+	}
+	cgroup_index_record_miss(idx, base, 1000);
+	assert(cgroup_index_expire_unresolved(idx) == CGROUP_INDEX_UNRESOLVED_MAX - 1);
+	assert(cgroup_index_size(idx) == before + 1);
+	cgroup_index_unresolved(idx, &misses, &miss_ns);
+	assert(misses == CGROUP_INDEX_UNRESOLVED_MAX + 10 + CGROUP_INDEX_UNRESOLVED_IDLE);
+	assert(miss_ns == misses * 1000);
+
+	/* With room again, new unknown cgroups get entries */
+	cgroup_index_record_miss(idx, 424242, 1000);
+	assert(cgroup_index_size(idx) == before + 2);
+
+	cgroup_index_free(idx);
+	printf("OK Unresolved entries capped and expired\n");
+}
+
+/* Test incremental updates through inotify */
+static void test_incremental_updates(void)
+{
+	printf("Testing incremental inotify updates...\n");
+
+	struct cgroup_index *idx = cgroup_index_new(root);
+	assert(idx);
+	int initial = cgroup_index_build(idx);
+	assert(initial > 0);
+	assert(cgroup_index_fd(idx) >= 0);
+
+	make_dir("/kubepods/burstable/pod22222222-3333-4444-5555-666666666666");
+	make_dir("/kubepods/burstable/pod22222222-3333-4444-5555-666666666666/ctr2");
+	assert(cgroup_index_process_events(idx) > 0);
+	/* The nested directory may be picked up by the walk or by its own event */
+	cgroup_index_process_events(idx);
+
+	__u64 id = id_of(idx, "/kubepods/burstable/pod22222222-3333-4444-5555-666666666666/ctr2");
+	assert(id != 0);
+	assert(cgroup_index_size(idx) == (size_t)initial + 2);
+	printf("  mkdir picked up: size %zu\n", cgroup_index_size(idx));
+
+	remove_dir("/kubepods/burstable/pod22222222-3333-4444-5555-666666666666/ctr2");
+	remove_dir("/kubepods/burstable/pod22222222-3333-4444-5555-666666666666");
+	assert(cgroup_index_process_events(idx) > 0);
+
+	struct cgroup_info info;
+	assert(cgroup_index_lookup(idx, id, &info) != 0);
+	assert(cgroup_index_size(idx) == (size_t)initial);
+	printf("  rmdir picked up: size %zu\n", cgroup_index_size(idx));
+
+	cgroup_index_free(idx);
+	printf("OK Incremental updates correct\n");
+}
+
+struct created_log {
+	int calls;
+	char last[CGROUP_INDEX_PATH_MAX];
+	struct cgroup_index *idx;
+	bool indexed;      /* Entry visible to the callback */
+};
+
+static void on_create(__u64 id, const char *path, void *ctx)
+{
+	struct created_log *log = ctx;
+	struct cgroup_info info;
+
+	log->calls++;
+	snprintf(log->last, sizeof(log->last), "%s", path);
+	/* Runs unlocked, so the index can be queried from the callback */
+	log->indexed = cgroup_index_lookup(log->idx, id, &info) == 0;
+}
+
+/* Test the creation callback for cgroups appearing after the build */
+static void test_create_callback(void)
+{
+	printf("Testing creation callback...\n");
+
+	struct cgroup_index *idx = cgroup_index_new(root);
+	struct created_log log = { .idx = NULL };
+
+	assert(idx);
+	log.idx = idx;
+	assert(cgroup_index_build(idx) > 0);
+	cgroup_index_on_create(idx, on_create, &log);
+
+	/* Existing cgroups are not reported again by a resync */
+	cgroup_index_build(idx);
+	assert(log.calls == 0);
+
+	make_dir("/kubepods/burstable/pod33333333-4444-5555-6666-777777777777");
+	make_dir("/kubepods/burstable/pod33333333-4444-5555-6666-777777777777/ctr3");
+	cgroup_index_process_events(idx);
+	cgroup_index_process_events(idx);
+	assert(log.calls == 2);
+	assert(log.indexed);
+	printf("  %d creations reported, last %s\n", log.calls, log.last);
+
+	cgroup_index_on_create(idx, NULL, NULL);
+	remove_dir("/kubepods/burstable/pod33333333-4444-5555-6666-777777777777/ctr3");
+	remove_dir("/kubepods/burstable/pod33333333-4444-5555-6666-777777777777");
+	cgroup_index_process_events(idx);
+	make_dir("/kubepods/burstable/pod44444444-5555-6666-7777-888888888888");
+	cgroup_index_process_events(idx);
+	assert(log.calls == 2);
+	remove_dir("/kubepods/burstable/pod44444444-5555-6666-7777-888888888888");
+
+	cgroup_index_free(idx);
+	printf("OK Creation callback correct\n");
+}
+
+/* Test table growth past the initial capacity */
+static void test_growth(void)
+{
+	printf("Testing index growth...\n");
+
+	char rel[64];
+	const int n = 3000;
+
+	make_dir("/bulk");
+	for (int i = 0; i < n; i++) {
+		snprintf(rel, sizeof(rel), "/bulk/cg%d", i);
+		make_dir(rel);
+	}
+
+	struct cgroup_index *idx = cgroup_index_new(root);
+	assert(idx);
+	int count = cgroup_index_build(idx);
+	assert(count >= n);
+
+	struct find_ctx f = { .path = "/bulk/cg2999" };
+	cgroup_index_foreach(idx, find_by_path, &f);
+	assert(f.id != 0);
+	assert(f.visited == count);
+	printf("  %d entries indexed, all reachable\n", count);
+
+	cgroup_index_free(idx);
+
+	for (int i = 0; i < n; i++) {
+		snprintf(rel, sizeof(rel), "/bulk/cg%d", i);
+		remove_dir(rel);
+	}
+	remove_dir("/bulk");
+
+	printf("OK Index growth correct\n");
+}
+
+static void cleanup_tree(void)
+{
+	remove_dir("/kubepods/burstable/pod11111111-2222-3333-4444-555555555555/ctr1");
+	remove_dir("/kubepods/burstable/pod11111111-2222-3333-4444-555555555555");
+	remove_dir("/kubepods/burstable");
+	remove_dir("/kubepods");
+	remove_dir("/system.slice");
+	rmdir(root);
+}
+
+int main(void)
+{
+	printf("Running cgroup index tests...\n\n");
+
+	snprintf(root, sizeof(root), "/tmp/scx_slo_cgidx.XXXXXX");
+	assert(mkdtemp(root) != NULL);
+
+	test_pod_uid_parsing();
+	test_build_and_lookup();
+	test_record_miss();
+	test_unresolved_expiry();
+	test_incremental_updates();
+	test_create_callback();
+	test_growth();
+
+	cleanup_tree();
+
+	printf("\nAll cgroup index tests passed!\n");
+	return 0;
+}
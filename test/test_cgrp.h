@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Simulated cgroups for the controller tests (budget_ctl, admission,
+ * reserve_ctl): each is seen the way the agent sees it, through its SLO
+ * map entry and the cumulative run counters of the scheduler.
+ */
+#ifndef __SCX_SLO_TEST_CGRP_H
+#define __SCX_SLO_TEST_CGRP_H
+
+#include "../src/budget_ctl.h"
+
+/* A cgroup seen through its SLO map entry, with cumulative counters */
+struct test_cgrp {
+	__u64 id;
+	struct slo_cfg cfg;
+	struct slo_cgrp_stats st;
+};
+
+/* Deadline window of @cfg, as the scheduler computes it */
+static inline double test_cgrp_window(const struct slo_cfg *cfg)
+{
+	return (double)cfg->budget_ns * (101 - cfg->importance) / 100;
+}
+
+/*
+ * One interval in which @c runs @runs times for @runtime_ns of CPU time
+ * in total: @late of them late by @lateness_ns each, the rest with
+ * @slack_ns to spare each. Returns the sample the agent would read.
+ */
+static inline struct budget_ctl_sample test_cgrp_run(struct test_cgrp *c, __u64 runs, __u64 late,
+						     __u64 lateness_ns, __u64 slack_ns,
+						     __u64 runtime_ns)
+{
+	c->st.runs += runs;
+	c->st.late += late;
+	c->st.lateness_ns += late * lateness_ns;
+	c->st.slack_ns += (runs - late) * slack_ns;
+	c->st.runtime_ns += runtime_ns;
+	return (struct budget_ctl_sample){ .cgroup_id = c->id, .cfg = c->cfg, .stats = c->st };
+}
+
+#endif /* __SCX_SLO_TEST_CGRP_H */
@@ -21,8 +21,46 @@ struct slo_config_entry {
 	char cgroup_path[MAX_CGROUP_PATH];
 	uint64_t budget_ms;
 	uint32_t importance;
+	uint32_t slo_class;
 };
 
+/* Latency class names mimicking config.c slo_class_names */
+static const char *const slo_class_names[NR_SLO_CLASSES] = {
+	[SLO_CLASS_STANDARD]   = "standard",
+	[SLO_CLASS_CRITICAL]   = "latency-critical",
+	[SLO_CLASS_BATCH]      = "batch",
+	[SLO_CLASS_BESTEFFORT] = "best-effort",
+};
+
+static int parse_slo_class(const char *name)
+{
+	for (int i = 0; i < NR_SLO_CLASSES; i++)
+		if (strcmp(name, slo_class_names[i]) == 0)
+			return i;
+	return -1;
+}
+
+/* Line parsing mimicking config.c parse_config_file. Returns 0 or -1. */
+static int parse_config_line(const char *line, struct slo_config_entry *entry)
+{
+	char class_name[32];
+	int n, cls;
+
+	n = sscanf(line, "%511s %llu %u %31s",
+		   entry->cgroup_path, (unsigned long long *)&entry->budget_ms,
+		   &entry->importance, class_name);
+	if (n < 3)
+		return -1;
+	entry->slo_class = SLO_CLASS_STANDARD;
+	if (n == 4 && class_name[0] != '#') {
+		cls = parse_slo_class(class_name);
+		if (cls < 0)
+			return -1;
+		entry->slo_class = cls;
+	}
+	return 0;
+}
+
 /* Validation function mimicking config.c validate_config_entry */
 static int validate_config_entry(const struct slo_config_entry *entry)
 {
@@ -204,6 +242,51 @@ static void test_config_line_parsing(void)
 	printf("OK Config line parsing working correctly\n");
 }
 
+/* Test the optional latency class column */
+static void test_latency_classes(void)
+{
+	printf("Testing latency class column...\n");
+
+	struct {
+		const char *line;
+		int expected_class;   /* -1: line rejected */
+	} test_lines[] = {
+		{"/kubepods/payment 50 90", SLO_CLASS_STANDARD},
+		{"/kubepods/payment 50 90 latency-critical", SLO_CLASS_CRITICAL},
+		{"/kubepods/web 100 70 standard", SLO_CLASS_STANDARD},
+		{"/kubepods/etl 500 20 batch", SLO_CLASS_BATCH},
+		{"/kubepods/scrub 1000 5 best-effort", SLO_CLASS_BESTEFFORT},
+		{"/kubepods/etl 500 20 # nightly jobs", SLO_CLASS_STANDARD},
+		{"/kubepods/etl 500 20 batch trailing", SLO_CLASS_BATCH},
+		{"/kubepods/payment 50 90 critical", -1},
+		{"/kubepods/payment 50 90 Batch", -1},
+		{"/kubepods/payment 50 90 realtime", -1},
+	};
+
+	for (size_t i = 0; i < sizeof(test_lines) / sizeof(test_lines[0]); i++) {
+		struct slo_config_entry entry;
+		int ok;
+
+		memset(&entry, 0, sizeof(entry));
+		ok = parse_config_line(test_lines[i].line, &entry) == 0 &&
+		     validate_config_entry(&entry) == 0 && entry.slo_class < NR_SLO_CLASSES;
+		if (test_lines[i].expected_class < 0) {
+			assert(!ok);
+			printf("  Rejected: %s\n", test_lines[i].line);
+		} else {
+			assert(ok);
+			assert(entry.slo_class == (uint32_t)test_lines[i].expected_class);
+			printf("  %s -> class %u\n", test_lines[i].line, entry.slo_class);
+		}
+	}
+
+	/* The class is stored as-is in slo_cfg.flags and fits its mask */
+	for (uint32_t cls = 0; cls < NR_SLO_CLASSES; cls++)
+		assert((cls & ~SLO_CFG_FLAGS_MASK) == 0);
+
+	printf("OK Latency classes parsed correctly\n");
+}
+
 /* Test budget to nanoseconds conversion */
 static void test_budget_conversion(void)
 {
@@ -354,6 +437,7 @@ int main(void)
 	test_budget_boundaries();
 	test_importance_boundaries();
 	test_config_line_parsing();
+	test_latency_classes();
 	test_budget_conversion();
 	test_cgroup_path_handling();
 	test_config_entry_copy_safety();
@@ -0,0 +1,270 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for precompiled config snapshots
+ * Tests config_snapshot.c: round trip, staleness against the source
+ * config, boot changes, corruption, and ID verification against a
+ * scratch directory tree
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "../src/config_snapshot.h"
+
+static char dir[] = "/tmp/scx_slo_snap.XXXXXX";
+static char config_path[256], snap_path[256];
+
+static void write_file(const char *path, const char *text)
+{
+	FILE *f = fopen(path, "w");
+
+	assert(f);
+	fputs(text, f);
+	fclose(f);
+}
+
+static void make_dir(const char *rel)
+{
+	char path[512];
+
+	snprintf(path, sizeof(path), "%s%s", dir, rel);
+	assert(mkdir(path, 0755) == 0);
+}
+
+static __u64 ino_of(const char *rel)
+{
+	char path[512];
+	struct stat st;
+
+	snprintf(path, sizeof(path), "%s%s", dir, rel);
+	assert(stat(path, &st) == 0);
+	return st.st_ino;
+}
+
+static struct slo_snapshot_rule make_rule(__u64 id, __u64 budget_ms, __u32 importance,
+					  __u32 line, __u32 flags)
+{
+	struct slo_snapshot_rule r = {
+		.cgroup_id = id,
+		.cfg = { .budget_ns = budget_ms * 1000000ULL, .importance = importance },
+		.line_num = line,
+		.flags = flags,
+	};
+	return r;
+}
+
+/* Test writing and mapping a snapshot */
+static void test_round_trip(void)
+{
+	printf("Testing snapshot round trip...\n");
+
+	const char *paths[] = { "/cg/a", "/cg/b", "/cg/.../*" };
+	struct slo_snapshot_rule rules[3];
+	struct slo_snapshot_source src;
+	struct slo_snapshot snap;
+
+	write_file(config_path, "/cg/a 50 90\n/cg/b 100 50\n/cg/.../* 200 10\n");
+	assert(slo_snapshot_source_of(config_path, &src) == 0);
+
+	rules[0] = make_rule(ino_of("/cg/a"), 50, 90, 1, 0);
+	rules[1] = make_rule(ino_of("/cg/b"), 100, 50, 2, 0);
+	rules[2] = make_rule(0, 200, 10, 3, SLO_SNAPSHOT_PATTERN);
+	assert(slo_snapshot_write(snap_path, &src, rules, paths, 3) == 0);
+
+	assert(slo_snapshot_open(&snap, snap_path, &src) == 0);
+	assert(snap.nr_rules == 3);
+	assert(snap.ids_valid == (src.boot_id[0] != '\0'));
+	for (int i = 0; i < 3; i++) {
+		assert(strcmp(slo_snapshot_path(&snap, i), paths[i]) == 0);
+		assert(snap.rules[i].cfg.budget_ns == rules[i].cfg.budget_ns);
+		assert(snap.rules[i].line_num == rules[i].line_num);
+	}
+	assert(snap.rules[2].flags & SLO_SNAPSHOT_PATTERN);
+
+	/* Few siblings: confirmed with a stat each */
+	__u64 ids[3];
+	int root_fd = open(dir, O_PATH | O_DIRECTORY);
+
+	assert(root_fd >= 0);
+	assert(slo_snapshot_verify(&snap, root_fd, ids) == (snap.ids_valid ? 2 : 0));
+	assert(ids[2] == 0);
+	close(root_fd);
+	slo_snapshot_close(&snap);
+	printf("  3 rules mapped back, %s\n", src.boot_id[0] ? "IDs trusted" : "no boot ID");
+
+	/* Empty configs compile to an empty snapshot */
+	assert(slo_snapshot_write(snap_path, &src, NULL, NULL, 0) == 0);
+	assert(slo_snapshot_open(&snap, snap_path, &src) == 0);
+	assert(snap.nr_rules == 0);
+	slo_snapshot_close(&snap);
+
+	printf("OK Round trip correct\n");
+}
+
+/* Test that snapshots of another config or boot are not trusted */
+static void test_staleness(void)
+{
+	printf("Testing staleness checks...\n");
+
+	const char *paths[] = { "/cg/a" };
+	struct slo_snapshot_rule rule = make_rule(ino_of("/cg/a"), 50, 90, 1, 0);
+	struct slo_snapshot_source src, now;
+	struct slo_snapshot snap;
+
+	write_file(config_path, "/cg/a 50 90\n");
+	assert(slo_snapshot_source_of(config_path, &src) == 0);
+	assert(slo_snapshot_write(snap_path, &src, &rule, paths, 1) == 0);
+
+	write_file(config_path, "/cg/a 50 95\n/cg/b 10 10\n");
+	assert(slo_snapshot_source_of(config_path, &now) == 0);
+	assert(slo_snapshot_open(&snap, snap_path, &now) == -ESTALE);
+	assert(snap.map == NULL);
+	printf("  Edited config -> stale\n");
+
+	/* Same file, different boot: rules usable, IDs not */
+	now = src;
+	snprintf(now.boot_id, sizeof(now.boot_id), "another-boot");
+	assert(slo_snapshot_open(&snap, snap_path, &now) == 0);
+	assert(!snap.ids_valid);
+	slo_snapshot_close(&snap);
+	printf("  Other boot -> IDs untrusted\n");
+
+	assert(slo_snapshot_open(&snap, "/nonexistent/config.snap", &src) == -ENOENT);
+	printf("OK Staleness checks correct\n");
+}
+
+/* Test that damaged files are rejected */
+static void test_corruption(void)
+{
+	printf("Testing corrupt snapshots...\n");
+
+	const char *paths[] = { "/cg/a", "/cg/b" };
+	struct slo_snapshot_rule rules[2] = {
+		make_rule(1, 50, 90, 1, 0), make_rule(2, 60, 80, 2, 0),
+	};
+	struct slo_snapshot_source src;
+	struct slo_snapshot snap;
+	struct stat st;
+	char byte;
+	int fd;
+
+	assert(slo_snapshot_source_of(config_path, &src) == 0);
+	assert(slo_snapshot_write(snap_path, &src, rules, paths, 2) == 0);
+	assert(stat(snap_path, &st) == 0);
+
+	/* Flip one byte of a budget */
+	fd = open(snap_path, O_RDWR);
+	assert(fd >= 0);
+	assert(pread(fd, &byte, 1, sizeof(struct slo_snapshot_header) + 8) == 1);
+	byte ^= 0x40;
+	assert(pwrite(fd, &byte, 1, sizeof(struct slo_snapshot_header) + 8) == 1);
+	assert(slo_snapshot_open(&snap, snap_path, &src) == -EINVAL);
+	printf("  Bit flip detected\n");
+
+	/* Truncated file */
+	assert(ftruncate(fd, st.st_size - 3) == 0);
+	assert(slo_snapshot_open(&snap, snap_path, &src) == -EINVAL);
+	assert(ftruncate(fd, 4) == 0);
+	assert(slo_snapshot_open(&snap, snap_path, &src) == -EINVAL);
+	close(fd);
+	printf("  Truncation detected\n");
+
+	write_file(snap_path, "# not a snapshot, just text long enough to hold a header ......"
+			      "..........................................\n");
+	assert(slo_snapshot_open(&snap, snap_path, &src) == -EINVAL);
+
+	printf("OK Corruption rejected\n");
+}
+
+/* Test confirming recorded IDs against the tree */
+static void test_verify(void)
+{
+	printf("Testing ID verification...\n");
+
+	const char *paths[] = { "/cg/a", "/cg/b", "/cg/gone", "/cg/.../x", "/cg/../cg/a", "/cg/c" };
+	struct slo_snapshot_rule rules[6];
+	struct slo_snapshot_source src;
+	struct slo_snapshot snap;
+	__u64 ids[6];
+	char path[512];
+	int root_fd;
+
+	make_dir("/cg/gone");
+	make_dir("/cg/c");
+	rules[0] = make_rule(ino_of("/cg/a"), 50, 90, 1, 0);
+	rules[1] = make_rule(ino_of("/cg/b"), 50, 90, 2, 0);
+	rules[2] = make_rule(ino_of("/cg/gone"), 50, 90, 3, 0);
+	rules[3] = make_rule(0, 50, 90, 4, SLO_SNAPSHOT_PATTERN);
+	rules[4] = make_rule(ino_of("/cg/a"), 50, 90, 5, 0);
+	rules[5] = make_rule(ino_of("/cg/c"), 50, 90, 6, 0);
+
+	assert(slo_snapshot_source_of(config_path, &src) == 0);
+	snprintf(src.boot_id, sizeof(src.boot_id), "this-boot");
+	assert(slo_snapshot_write(snap_path, &src, rules, paths, 6) == 0);
+
+	/*
+	 * Remove one cgroup and recreate another under the same name. The four
+	 * plain siblings under /cg are checked with one readdir.
+	 */
+	snprintf(path, sizeof(path), "%s/cg/gone", dir);
+	assert(rmdir(path) == 0);
+	snprintf(path, sizeof(path), "%s/cg/c", dir);
+	assert(rmdir(path) == 0);
+	write_file(path, "");   /* Same name, now a file and another inode */
+
+	root_fd = open(dir, O_PATH | O_DIRECTORY);
+	assert(root_fd >= 0);
+	assert(slo_snapshot_open(&snap, snap_path, &src) == 0);
+	assert(slo_snapshot_verify(&snap, root_fd, ids) == 2);
+	assert(ids[0] == rules[0].cgroup_id && ids[1] == rules[1].cgroup_id);
+	assert(ids[2] == 0 && ids[3] == 0 && ids[4] == 0 && ids[5] == 0);
+	slo_snapshot_close(&snap);
+	printf("  2/6 confirmed: removed, replaced, pattern and traversal left to resolve\n");
+
+	/* Nothing is trusted from another boot */
+	snprintf(src.boot_id, sizeof(src.boot_id), "next-boot");
+	assert(slo_snapshot_open(&snap, snap_path, &src) == 0);
+	assert(slo_snapshot_verify(&snap, root_fd, ids) == 0);
+	slo_snapshot_close(&snap);
+
+	unlink(path);
+	close(root_fd);
+	printf("OK Verification correct\n");
+}
+
+int main(void)
+{
+	char path[512];
+
+	printf("Running config snapshot tests...\n\n");
+
+	assert(mkdtemp(dir) != NULL);
+	snprintf(config_path, sizeof(config_path), "%s/config", dir);
+	snprintf(snap_path, sizeof(snap_path), "%s/config.snap", dir);
+	make_dir("/cg");
+	make_dir("/cg/a");
+	make_dir("/cg/b");
+
+	test_round_trip();
+	test_staleness();
+	test_corruption();
+	test_verify();
+
+	unlink(config_path);
+	unlink(snap_path);
+	snprintf(path, sizeof(path), "%s/cg/a", dir);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/cg/b", dir);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/cg", dir);
+	rmdir(path);
+	rmdir(dir);
+
+	printf("\nAll config snapshot tests passed!\n");
+	return 0;
+}
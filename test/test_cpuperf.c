@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for CPU performance targets
+ * Tests cpuperf.c: parameter parsing, the target per class, importance
+ * and slack, and summing the per-CPU counters
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "../src/cpuperf.h"
+
+#define MS 1000000ULL
+
+static void test_params(void)
+{
+	printf("Testing parameter parsing...\n");
+
+	struct cpuperf_params p;
+
+	cpuperf_params_default(&p);
+	assert(p.standard_min == 512 && p.batch_max == 384 && p.boost_slack == 50);
+
+	assert(cpuperf_parse(&p, "standard_min=256,batch_max=1024,boost_slack=0") == 0);
+	assert(p.standard_min == 256 && p.batch_max == 1024 && p.boost_slack == 0);
+
+	/* Targets out of SLO_CPUPERF_ONE, slack in percent */
+	assert(cpuperf_parse(&p, "batch_max=1025") == -1);
+	assert(cpuperf_parse(&p, "batch_max=0") == -1);
+	assert(cpuperf_parse(&p, "boost_slack=101") == -1);
+
+	printf("OK CPU performance keys and ranges\n");
+}
+
+static void test_target(void)
+{
+	printf("Testing targets...\n");
+
+	struct cpuperf_params p;
+	__u64 window = 10 * MS;
+
+	cpuperf_params_default(&p);
+
+	/* Classes that ignore slack */
+	assert(cpuperf_target(&p, SLO_CLASS_CRITICAL, 1, window, window) == SLO_CPUPERF_ONE);
+	assert(cpuperf_target(&p, SLO_CLASS_BATCH, 100, 0, window) == 384);
+	assert(cpuperf_target(&p, SLO_CLASS_BESTEFFORT, 100, 0, window) == 384);
+
+	/* Standard: from standard_min up with importance */
+	assert(cpuperf_target(&p, SLO_CLASS_STANDARD, 50, window, window) == 768);
+	assert(cpuperf_target(&p, SLO_CLASS_STANDARD, 100, window, window) == SLO_CPUPERF_ONE);
+	assert(cpuperf_target(&p, SLO_CLASS_STANDARD, 0, window, window) == 517);
+
+	/* Full speed with less than half the window left, or none */
+	assert(cpuperf_target(&p, SLO_CLASS_STANDARD, 10, 5 * MS, window) == 563);
+	assert(cpuperf_target(&p, SLO_CLASS_STANDARD, 10, 5 * MS - 1, window) == SLO_CPUPERF_ONE);
+	assert(cpuperf_target(&p, SLO_CLASS_STANDARD, 10, 0, window) == SLO_CPUPERF_ONE);
+
+	/* Slack beyond the window counts as the whole window */
+	p.boost_slack = 100;
+	assert(cpuperf_target(&p, SLO_CLASS_STANDARD, 10, 100 * window, window) == 563);
+	p.boost_slack = 0;
+	assert(cpuperf_target(&p, SLO_CLASS_STANDARD, 10, 0, window) == 563);
+
+	printf("OK Critical at full speed, batch capped, standard boosted when short of slack\n");
+}
+
+static void test_sum(void)
+{
+	printf("Testing per-CPU sums...\n");
+
+	struct slo_cpu_perf percpu[4], sum;
+
+	memset(percpu, 0, sizeof(percpu));
+	percpu[0] = (struct slo_cpu_perf){ .target = 1024, .sets = 3, .boosts = 2 };
+	percpu[1] = (struct slo_cpu_perf){ .target = 384, .sets = 1, .capped = 7 };
+	percpu[2] = (struct slo_cpu_perf){ .target = 640, .sets = 5, .boosts = 1, .capped = 1 };
+
+	cpuperf_sum(&sum, percpu, 4);
+	assert(sum.target == 512);  /* CPU 3 was never set */
+	assert(sum.sets == 9 && sum.boosts == 3 && sum.capped == 8);
+
+	cpuperf_sum(&sum, percpu, 0);
+	assert(sum.target == 0 && sum.sets == 0);
+
+	printf("OK Counters added up, mean target\n");
+}
+
+int main(void)
+{
+	printf("=== CPU Performance Target Tests ===\n\n");
+
+	test_params();
+	test_target();
+	test_sum();
+
+	printf("\nAll CPU performance target tests passed!\n");
+	return 0;
+}
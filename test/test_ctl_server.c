@@ -0,0 +1,476 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for the control socket
+ * Tests ctl_server.c and ctl_client.c over a real Unix socket against an
+ * in-memory SLO map: requests from concurrent clients share batches, the
+ * last operation on a cgroup wins, entries left alone are reported,
+ * invalid requests change nothing, queries see earlier writes, misses
+ * reach subscribers, malformed frames are refused, and an outgoing agent
+ * keeps its successor's socket
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "../src/ctl_server.h"
+#include "../src/ctl_client.h"
+
+#define MOCK_SLOTS 65536
+
+/* Direct-mapped by cgroup ID; the tests keep IDs below MOCK_SLOTS */
+struct mock_map {
+	pthread_mutex_t lock;
+	struct slo_cfg cfg[MOCK_SLOTS];
+	bool present[MOCK_SLOTS];
+	bool owned[MOCK_SLOTS];     /* Cgroups with a config rule, never written */
+	int apply_delay_us;
+	int fail_with;
+};
+
+static struct mock_map mock = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static int mock_apply(const __u64 *set_keys, const struct slo_cfg *set_vals, size_t nr_set,
+		      const __u64 *del_keys, size_t nr_del, bool *shadowed, void *ctx)
+{
+	struct mock_map *m = ctx;
+
+	/* A slow map write lets requests pile up behind it */
+	if (m->apply_delay_us)
+		usleep(m->apply_delay_us);
+	if (m->fail_with)
+		return m->fail_with;
+
+	pthread_mutex_lock(&m->lock);
+	for (size_t i = 0; i < nr_set; i++) {
+		/* Keys must be unique within a batch */
+		for (size_t j = 0; j < i; j++)
+			assert(set_keys[j] != set_keys[i]);
+		assert(!shadowed[i]);
+		if (m->owned[set_keys[i]]) {
+			shadowed[i] = true;
+			continue;
+		}
+		m->cfg[set_keys[i]] = set_vals[i];
+		m->present[set_keys[i]] = true;
+	}
+	for (size_t i = 0; i < nr_del; i++) {
+		assert(!shadowed[nr_set + i]);
+		if (m->owned[del_keys[i]])
+			shadowed[nr_set + i] = true;
+		else
+			m->present[del_keys[i]] = false;
+	}
+	pthread_mutex_unlock(&m->lock);
+	return 0;
+}
+
+static void mock_query(struct slo_ctl_state *st, void *ctx)
+{
+	struct mock_map *m = ctx;
+
+	pthread_mutex_lock(&m->lock);
+	if (st->cgroup_id < MOCK_SLOTS && m->present[st->cgroup_id]) {
+		st->present = 1;
+		st->cfg = m->cfg[st->cgroup_id];
+	}
+	st->deadline_misses = st->cgroup_id * 2;
+	pthread_mutex_unlock(&m->lock);
+}
+
+static char sock_path[64];
+
+static struct ctl_server *start_server(void)
+{
+	struct ctl_ops ops = { .apply = mock_apply, .query = mock_query, .ctx = &mock };
+	struct ctl_server *s;
+
+	pthread_mutex_lock(&mock.lock);
+	memset(mock.present, 0, sizeof(mock.present));
+	memset(mock.owned, 0, sizeof(mock.owned));
+	mock.apply_delay_us = 0;
+	mock.fail_with = 0;
+	pthread_mutex_unlock(&mock.lock);
+
+	s = ctl_server_start(sock_path, &ops);
+	assert(s);
+	return s;
+}
+
+static struct slo_ctl_entry set_entry(__u64 id, __u64 budget_ns)
+{
+	return (struct slo_ctl_entry){
+		.cgroup_id = id,
+		.cfg = { .budget_ns = budget_ns, .importance = 50 },
+		.op = SLO_CTL_OP_SET,
+	};
+}
+
+/* Test set, delete and query round trips */
+static void test_apply_and_query(void)
+{
+	printf("Testing apply and query...\n");
+
+	struct ctl_server *s = start_server();
+	struct ctl_client_conn c;
+	struct slo_ctl_state st[3];
+	__u64 ids[3] = { 10, 11, 12 };
+
+	assert(ctl_client_connect(&c, sock_path) == 0);
+
+	struct slo_ctl_entry e[] = {
+		set_entry(10, 5000000),
+		set_entry(11, 7000000),
+		set_entry(12, 9000000),
+	};
+	assert(ctl_client_apply(&c, e, 3, NULL) == 0);
+
+	e[0] = (struct slo_ctl_entry){ .cgroup_id = 12, .op = SLO_CTL_OP_DELETE };
+	assert(ctl_client_apply(&c, e, 1, NULL) == 0);
+
+	assert(ctl_client_query(&c, ids, 3, st) == 0);
+	assert(st[0].cgroup_id == 10 && st[0].present && st[0].cfg.budget_ns == 5000000);
+	assert(st[1].present && st[1].cfg.budget_ns == 7000000);
+	assert(!st[2].present && st[2].deadline_misses == 24);
+
+	ctl_client_close(&c);
+	ctl_server_stop(s);
+	assert(access(sock_path, F_OK) != 0);
+
+	printf("OK Writes visible to queries, socket removed on stop\n");
+}
+
+/* Test that the last operation on a cgroup within a batch wins */
+static void test_last_write_wins(void)
+{
+	printf("Testing merging within a batch...\n");
+
+	struct ctl_server *s = start_server();
+	struct ctl_client_conn c;
+	struct ctl_stats stats;
+	struct slo_ctl_state st[2];
+	__u64 ids[2] = { 20, 21 };
+
+	assert(ctl_client_connect(&c, sock_path) == 0);
+
+	struct slo_ctl_entry e[] = {
+		set_entry(20, 2000000),
+		set_entry(21, 2000000),
+		set_entry(20, 3000000),
+		{ .cgroup_id = 21, .op = SLO_CTL_OP_DELETE },
+		set_entry(20, 4000000),
+	};
+	assert(ctl_client_apply(&c, e, 5, NULL) == 0);
+	assert(ctl_client_query(&c, ids, 2, st) == 0);
+	assert(st[0].present && st[0].cfg.budget_ns == 4000000);
+	assert(!st[1].present);
+
+	ctl_server_get_stats(s, &stats);
+	assert(stats.batches == 1 && stats.entries == 2 && stats.coalesced == 3);
+
+	ctl_client_close(&c);
+	ctl_server_stop(s);
+
+	printf("OK 5 operations on 2 cgroups written as 2\n");
+}
+
+#define NR_WRITERS 4
+#define WRITES_PER_CLIENT 50
+
+static void *writer(void *arg)
+{
+	long n = (long)arg;
+	struct ctl_client_conn c;
+
+	assert(ctl_client_connect(&c, sock_path) == 0);
+	for (int i = 0; i < WRITES_PER_CLIENT; i++) {
+		struct slo_ctl_entry e = set_entry(1000 + n * WRITES_PER_CLIENT + i, 8000000);
+
+		assert(ctl_client_apply(&c, &e, 1, NULL) == 0);
+	}
+	ctl_client_close(&c);
+	return NULL;
+}
+
+/* Test that entries the map writer leaves alone are reported per request */
+static void test_shadowed(void)
+{
+	printf("Testing entries shadowed by config rules...\n");
+
+	struct ctl_server *s = start_server();
+	struct ctl_client_conn c;
+	size_t shadowed;
+
+	mock.owned[40] = true;
+	assert(ctl_client_connect(&c, sock_path) == 0);
+
+	/* Both operations on the owned cgroup count, merged or not */
+	struct slo_ctl_entry e[] = {
+		set_entry(40, 5000000),
+		set_entry(41, 5000000),
+		{ .cgroup_id = 40, .op = SLO_CTL_OP_DELETE },
+	};
+	assert(ctl_client_apply(&c, e, 3, &shadowed) == 0);
+	assert(shadowed == 2);
+	assert(!mock.present[40] && mock.present[41]);
+
+	assert(ctl_client_apply(&c, &e[1], 1, &shadowed) == 0);
+	assert(shadowed == 0);
+
+	ctl_client_close(&c);
+	ctl_server_stop(s);
+
+	printf("OK Shadowed entries counted in the reply\n");
+}
+
+/* Test that concurrent single-entry requests share map batches */
+static void test_concurrent_coalescing(void)
+{
+	printf("Testing concurrent writers...\n");
+
+	struct ctl_server *s = start_server();
+	pthread_t threads[NR_WRITERS];
+	struct ctl_stats stats;
+
+	mock.apply_delay_us = 500;
+	for (long i = 0; i < NR_WRITERS; i++)
+		assert(pthread_create(&threads[i], NULL, writer, (void *)i) == 0);
+	for (int i = 0; i < NR_WRITERS; i++)
+		pthread_join(threads[i], NULL);
+
+	ctl_server_get_stats(s, &stats);
+	assert(stats.requests == NR_WRITERS * WRITES_PER_CLIENT);
+	assert(stats.entries == NR_WRITERS * WRITES_PER_CLIENT);
+	assert(stats.batches < stats.requests);
+	for (int i = 0; i < NR_WRITERS * WRITES_PER_CLIENT; i++)
+		assert(mock.present[1000 + i]);
+	printf("  %llu requests in %llu batches\n",
+	       (unsigned long long)stats.requests, (unsigned long long)stats.batches);
+
+	ctl_server_stop(s);
+
+	printf("OK Concurrent requests merged\n");
+}
+
+/* Test that batches larger than one message are split and all applied */
+static void test_large_apply(void)
+{
+	printf("Testing a batch over several messages...\n");
+
+	struct ctl_server *s = start_server();
+	struct ctl_client_conn c;
+	size_t nr = 3 * SLO_CTL_MAX_RECORDS + 17;
+	struct slo_ctl_entry *e = calloc(nr, sizeof(*e));
+
+	assert(e);
+	for (size_t i = 0; i < nr; i++)
+		e[i] = set_entry(i + 1, 6000000);
+	assert(ctl_client_connect(&c, sock_path) == 0);
+	assert(ctl_client_apply(&c, e, nr, NULL) == 0);
+	for (size_t i = 0; i < nr; i++)
+		assert(mock.present[i + 1]);
+
+	ctl_client_close(&c);
+	ctl_server_stop(s);
+	free(e);
+
+	printf("OK %zu entries applied\n", nr);
+}
+
+/* Test that an invalid entry rejects its whole request */
+static void test_validation(void)
+{
+	printf("Testing invalid entries...\n");
+
+	struct ctl_server *s = start_server();
+	struct ctl_client_conn c;
+	struct ctl_stats stats;
+
+	assert(ctl_client_connect(&c, sock_path) == 0);
+
+	struct slo_ctl_entry bad[] = {
+		set_entry(30, MIN_BUDGET_NS - 1),
+		set_entry(30, MAX_BUDGET_NS + 1),
+		{ .cgroup_id = 30, .cfg = { .budget_ns = 5000000, .importance = 0 }, .op = SLO_CTL_OP_SET },
+		{ .cgroup_id = 30, .cfg = { .budget_ns = 5000000, .importance = 50,
+					    .flags = NR_SLO_CLASSES }, .op = SLO_CTL_OP_SET },
+		{ .cgroup_id = 30, .cfg = { .budget_ns = 5000000, .importance = 50,
+					    .flags = 0x100 }, .op = SLO_CTL_OP_SET },
+		{ .cgroup_id = 30, .op = 7 },
+		set_entry(0, 5000000),
+	};
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		struct slo_ctl_entry pair[2] = { set_entry(31, 5000000), bad[i] };
+
+		assert(ctl_client_apply(&c, pair, 2, NULL) == -EINVAL);
+	}
+	assert(!mock.present[30] && !mock.present[31]);
+
+	ctl_server_get_stats(s, &stats);
+	assert(stats.rejected == sizeof(bad) / sizeof(bad[0]));
+	assert(stats.batches == 0);
+
+	/* The connection stays usable */
+	struct slo_ctl_entry ok = set_entry(31, 5000000);
+
+	assert(ctl_client_apply(&c, &ok, 1, NULL) == 0);
+	assert(mock.present[31]);
+
+	/* Map errors reach every request of the batch */
+	mock.fail_with = -ENOSPC;
+	ok.cgroup_id = 32;
+	assert(ctl_client_apply(&c, &ok, 1, NULL) == -ENOSPC);
+
+	ctl_client_close(&c);
+	ctl_server_stop(s);
+
+	printf("OK Invalid requests change nothing\n");
+}
+
+/* Test the miss stream */
+static void test_subscribe(void)
+{
+	printf("Testing miss subscription...\n");
+
+	struct ctl_server *s = start_server();
+	struct ctl_client_conn sub;
+	struct slo_ctl_miss got[8];
+	int n = 0, r;
+
+	/* Without subscribers misses are not even queued */
+	struct slo_ctl_miss m = { .cgroup_id = 1, .deadline_miss_ns = 100, .timestamp = 1 };
+
+	ctl_server_publish_miss(s, &m);
+
+	assert(ctl_client_connect(&sub, sock_path) == 0);
+	assert(ctl_client_subscribe(&sub) == 0);
+	for (int i = 0; i < 3; i++) {
+		m.cgroup_id = 40 + i;
+		m.timestamp = i;
+		ctl_server_publish_miss(s, &m);
+	}
+	while (n < 3) {
+		r = ctl_client_read_misses(&sub, got + n, 8 - n, 1000);
+		assert(r > 0);
+		n += r;
+	}
+	assert(n == 3);
+	for (int i = 0; i < 3; i++)
+		assert(got[i].cgroup_id == 40 + (__u64)i && got[i].deadline_miss_ns == 100);
+
+	/* Nothing else arrives */
+	assert(ctl_client_read_misses(&sub, got, 8, 50) == 0);
+
+	struct ctl_stats stats;
+
+	ctl_server_get_stats(s, &stats);
+	assert(stats.subscribers == 1 && stats.misses_sent == 3);
+
+	ctl_client_close(&sub);
+	ctl_server_stop(s);
+
+	printf("OK Misses streamed in order\n");
+}
+
+static int raw_request(int fd, const struct slo_ctl_hdr *req, struct slo_ctl_hdr *rep)
+{
+	if (send(fd, req, sizeof(*req), MSG_NOSIGNAL) != sizeof(*req))
+		return -1;
+	return recv(fd, rep, sizeof(*rep), MSG_WAITALL) == sizeof(*rep) ? 0 : -1;
+}
+
+/* Test protocol errors */
+static void test_malformed(void)
+{
+	printf("Testing malformed messages...\n");
+
+	struct ctl_server *s = start_server();
+	struct ctl_client_conn c;
+	struct slo_ctl_hdr req, rep;
+
+	assert(ctl_client_connect(&c, sock_path) == 0);
+
+	/* Wrong version: refused, connection kept */
+	req = (struct slo_ctl_hdr){ .len = sizeof(req), .type = SLO_CTL_QUERY, .version = 99, .seq = 5 };
+	assert(raw_request(c.fd, &req, &rep) == 0);
+	assert(rep.seq == 5 && rep.status == -EPROTO);
+
+	/* Count that does not match the length */
+	req = (struct slo_ctl_hdr){ .len = sizeof(req), .type = SLO_CTL_APPLY,
+				    .version = SLO_CTL_VERSION, .seq = 6, .count = 1 };
+	assert(raw_request(c.fd, &req, &rep) == 0);
+	assert(rep.seq == 6 && rep.status == -EPROTO);
+
+	/* Unknown type */
+	req = (struct slo_ctl_hdr){ .len = sizeof(req), .type = 42,
+				    .version = SLO_CTL_VERSION, .seq = 7 };
+	assert(raw_request(c.fd, &req, &rep) == 0);
+	assert(rep.seq == 7 && rep.status == -EOPNOTSUPP);
+
+	/* A length shorter than the header loses the framing: disconnected */
+	req = (struct slo_ctl_hdr){ .len = 3, .type = SLO_CTL_QUERY, .version = SLO_CTL_VERSION };
+	assert(send(c.fd, &req, sizeof(req), MSG_NOSIGNAL) == sizeof(req));
+	assert(recv(c.fd, &rep, sizeof(rep), MSG_WAITALL) == 0);
+	ctl_client_close(&c);
+
+	/* Other clients are unaffected */
+	__u64 id = 1;
+	struct slo_ctl_state st;
+
+	assert(ctl_client_connect(&c, sock_path) == 0);
+	assert(ctl_client_query(&c, &id, 1, &st) == 0);
+	ctl_client_close(&c);
+	ctl_server_stop(s);
+
+	printf("OK Malformed messages refused\n");
+}
+
+/* Test that a stopping server leaves a successor's socket alone */
+static void test_handoff(void)
+{
+	printf("Testing two servers on one path...\n");
+
+	struct ctl_server *old = start_server();
+	struct ctl_server *next = start_server();
+	struct ctl_client_conn c;
+	__u64 id = 1;
+	struct slo_ctl_state st;
+
+	ctl_server_stop(old);
+	assert(access(sock_path, F_OK) == 0);
+	assert(ctl_client_connect(&c, sock_path) == 0);
+	assert(ctl_client_query(&c, &id, 1, &st) == 0);
+	ctl_client_close(&c);
+	ctl_server_stop(next);
+	assert(access(sock_path, F_OK) != 0);
+
+	printf("OK Successor keeps its socket\n");
+}
+
+int main(void)
+{
+	printf("Running control socket tests...\n\n");
+
+	snprintf(sock_path, sizeof(sock_path), "/tmp/scx-slo-test-%d/ctl.sock", getpid());
+
+	test_apply_and_query();
+	test_last_write_wins();
+	test_shadowed();
+	test_concurrent_coalescing();
+	test_large_apply();
+	test_validation();
+	test_subscribe();
+	test_malformed();
+	test_handoff();
+
+	*strrchr(sock_path, '/') = '\0';
+	rmdir(sock_path);
+
+	printf("\nAll control socket tests passed!\n");
+	return 0;
+}
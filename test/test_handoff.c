@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for scheduler handoff between agent instances
+ * Tests handoff.c: sched_ext state parsing, waiting for the previous
+ * scheduler to detach, and gap measurement
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "../src/handoff.h"
+
+static char state_path[] = "/tmp/scx_slo_state.XXXXXX";
+
+/* Replace the state file atomically, as sysfs would present it */
+static void write_state(const char *state)
+{
+	char tmp[sizeof(state_path) + 4];
+	FILE *f;
+
+	snprintf(tmp, sizeof(tmp), "%s.new", state_path);
+	f = fopen(tmp, "w");
+	assert(f);
+	fprintf(f, "%s\n", state);
+	fclose(f);
+	assert(rename(tmp, state_path) == 0);
+}
+
+static double elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000.0 +
+	       (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* Test reading the sched_ext state file */
+static void test_state_read(void)
+{
+	printf("Testing sched_ext state read...\n");
+
+	char buf[32];
+
+	write_state("enabled");
+	assert(sched_ext_state(state_path, buf, sizeof(buf)) == 0);
+	assert(strcmp(buf, "enabled") == 0);
+
+	write_state("disabled");
+	assert(sched_ext_state(state_path, buf, sizeof(buf)) == 0);
+	assert(strcmp(buf, "disabled") == 0);
+
+	/* Short buffers truncate rather than overflow */
+	char small[4];
+	assert(sched_ext_state(state_path, small, sizeof(small)) == 0);
+	assert(strcmp(small, "dis") == 0);
+
+	assert(sched_ext_state("/nonexistent/sched_ext/state", buf, sizeof(buf)) == -ENOENT);
+	printf("OK State read correct\n");
+}
+
+static void *detach_later(void *arg)
+{
+	(void)arg;
+	usleep(50 * 1000);
+	write_state("disabling");
+	usleep(10 * 1000);
+	write_state("disabled");
+	return NULL;
+}
+
+/* Test that the wait returns promptly once the old scheduler detaches */
+static void test_wait_detached(void)
+{
+	printf("Testing wait for previous scheduler to detach...\n");
+
+	struct timespec start;
+	pthread_t thread;
+
+	/* Nothing attached: no wait at all */
+	write_state("disabled");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	assert(handoff_wait_detached(state_path, 1000) == 0);
+	assert(elapsed_ms(&start) < 10.0);
+
+	/* Old scheduler detaches after ~60ms */
+	write_state("enabled");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	assert(pthread_create(&thread, NULL, detach_later, NULL) == 0);
+	assert(handoff_wait_detached(state_path, 5000) == 0);
+	double waited = elapsed_ms(&start);
+	pthread_join(thread, NULL);
+	assert(waited >= 55.0 && waited < 1000.0);
+	printf("  Detected detach after %.1fms\n", waited);
+
+	printf("OK Wait for detach correct\n");
+}
+
+/* Test timeout and error reporting */
+static void test_wait_timeout(void)
+{
+	printf("Testing handoff timeout...\n");
+
+	struct timespec start;
+
+	write_state("enabled");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	assert(handoff_wait_detached(state_path, 30) == -ETIMEDOUT);
+	assert(elapsed_ms(&start) >= 30.0);
+
+	assert(handoff_wait_detached("/nonexistent/sched_ext/state", 30) == -ENOENT);
+	printf("OK Timeout and errors reported\n");
+}
+
+/* Test gap computation from the exit/init timestamps */
+static void test_gap(void)
+{
+	printf("Testing detach-to-reattach gap...\n");
+
+	struct slo_handoff h = {0};
+
+	/* First ever attach: no previous detach */
+	h.attach_ns = 5000000000ULL;
+	assert(handoff_gap_ns(&h) == 0);
+
+	h.detach_ns = 4997500000ULL;
+	assert(handoff_gap_ns(&h) == 2500000ULL);
+
+	/* Stale attach time from before the last detach is not a gap */
+	h.attach_ns = 4000000000ULL;
+	assert(handoff_gap_ns(&h) == 0);
+
+	printf("OK Gap computation correct\n");
+}
+
+int main(void)
+{
+	int fd;
+
+	printf("Running scheduler handoff tests...\n\n");
+
+	fd = mkstemp(state_path);
+	assert(fd >= 0);
+	close(fd);
+
+	test_state_read();
+	test_wait_detached();
+	test_wait_timeout();
+	test_gap();
+
+	unlink(state_path);
+	printf("\nAll handoff tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,268 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for the asynchronous logging pipeline
+ * Tests log.c: formatting, JSON escaping, multi-producer ordering and
+ * drop accounting when the output pipe stalls
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "../src/log.h"
+
+#define PRODUCERS 4
+#define PER_PRODUCER 2000
+
+/* Read everything from @fd until EOF into a malloc'd buffer */
+static char *slurp(int fd, size_t *len_out)
+{
+	size_t cap = 1 << 16, len = 0;
+	char *buf = malloc(cap);
+	ssize_t n;
+
+	assert(buf);
+	while ((n = read(fd, buf + len, cap - len - 1)) > 0) {
+		len += n;
+		if (cap - len < 4096) {
+			cap *= 2;
+			buf = realloc(buf, cap);
+			assert(buf);
+		}
+	}
+	buf[len] = '\0';
+	*len_out = len;
+	return buf;
+}
+
+static size_t count_lines(const char *buf)
+{
+	size_t n = 0;
+
+	for (; *buf; buf++)
+		if (*buf == '\n')
+			n++;
+	return n;
+}
+
+/* Test text formatting and level filtering */
+static void test_text_format(void)
+{
+	printf("Testing text format and level filter...\n");
+
+	char path[] = "/tmp/scx_slo_log.XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd >= 0);
+
+	log_set_json(false);
+	log_set_level(LOG_INFO);
+	assert(log_init(fd) == 0);
+
+	log_msg(LOG_DEBUG, "hidden %d", 1);
+	log_msg(LOG_INFO, "visible %d", 2);
+	log_msg(LOG_ERROR, "error %s", "three");
+	log_shutdown();
+
+	size_t len;
+	lseek(fd, 0, SEEK_SET);
+	char *out = slurp(fd, &len);
+
+	assert(count_lines(out) == 2);
+	assert(strstr(out, "hidden") == NULL);
+	assert(strstr(out, "] [info] visible 2\n") != NULL);
+	assert(strstr(out, "] [error] error three\n") != NULL);
+	assert(out[0] == '[' && out[5] == '-' && out[11] == 'T');
+	printf("  %.*s", (int)(strchr(out, '\n') - out + 1), out);
+
+	free(out);
+	close(fd);
+	unlink(path);
+	printf("OK Text format correct\n");
+}
+
+/* Test JSON escaping of quotes, backslashes and control characters */
+static void test_json_escaping(void)
+{
+	printf("Testing JSON escaping...\n");
+
+	char path[] = "/tmp/scx_slo_log.XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd >= 0);
+
+	log_set_json(true);
+	log_set_level(LOG_DEBUG);
+	assert(log_init(fd) == 0);
+
+	log_msg(LOG_WARN, "say \"hi\" \\ tab\there\nnext");
+	log_raw("{\"type\":\"stats\",\"local\":%d}", 7);
+	log_shutdown();
+
+	size_t len;
+	lseek(fd, 0, SEEK_SET);
+	char *out = slurp(fd, &len);
+
+	assert(count_lines(out) == 2);
+	assert(strstr(out, "\"level\":\"warn\"") != NULL);
+	assert(strstr(out, "\"message\":\"say \\\"hi\\\" \\\\ tab\\u0009here\\u000anext\"}\n") != NULL);
+	assert(strstr(out, "{\"type\":\"stats\",\"local\":7}\n") != NULL);
+	printf("  %s", out);
+
+	free(out);
+	close(fd);
+	unlink(path);
+	log_set_json(false);
+	printf("OK JSON escaping correct\n");
+}
+
+/* Test that overlong messages are truncated but still newline-terminated */
+static void test_truncation(void)
+{
+	printf("Testing truncation of long lines...\n");
+
+	char path[] = "/tmp/scx_slo_log.XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd >= 0);
+
+	char big[4 * LOG_LINE_MAX];
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+
+	log_set_level(LOG_INFO);
+	assert(log_init(fd) == 0);
+	log_msg(LOG_INFO, "%s", big);
+	log_set_json(true);
+	log_msg(LOG_INFO, "%s", big);
+	log_shutdown();
+	log_set_json(false);
+
+	size_t len;
+	lseek(fd, 0, SEEK_SET);
+	char *out = slurp(fd, &len);
+
+	assert(count_lines(out) == 2);
+	assert(len <= 2 * LOG_LINE_MAX);
+	assert(strstr(out, "xxx\"}\n") != NULL);
+	printf("  Two truncated lines, %zu bytes total\n", len);
+
+	free(out);
+	close(fd);
+	unlink(path);
+	printf("OK Truncation correct\n");
+}
+
+static void *producer(void *arg)
+{
+	long id = (long)arg;
+
+	for (int i = 0; i < PER_PRODUCER; i++)
+		log_msg(LOG_INFO, "p%ld seq %d", id, i);
+	return NULL;
+}
+
+/* Test concurrent producers: nothing lost or torn, per-producer order kept */
+static void test_concurrent_producers(void)
+{
+	printf("Testing concurrent producers...\n");
+
+	char path[] = "/tmp/scx_slo_log.XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd >= 0);
+
+	__u64 dropped_before = log_dropped();
+	pthread_t threads[PRODUCERS];
+
+	log_set_level(LOG_INFO);
+	assert(log_init(fd) == 0);
+	for (long i = 0; i < PRODUCERS; i++)
+		assert(pthread_create(&threads[i], NULL, producer, (void *)i) == 0);
+	for (int i = 0; i < PRODUCERS; i++)
+		pthread_join(threads[i], NULL);
+	log_shutdown();
+
+	size_t len;
+	lseek(fd, 0, SEEK_SET);
+	char *out = slurp(fd, &len);
+
+	__u64 lost = log_dropped() - dropped_before;
+	int next[PRODUCERS] = {0};
+	size_t lines = 0;
+
+	for (char *line = strtok(out, "\n"); line; line = strtok(NULL, "\n")) {
+		long id;
+		int seq;
+
+		if (strstr(line, "dropped"))
+			continue;
+		assert(sscanf(strstr(line, "] p"), "] p%ld seq %d", &id, &seq) == 2);
+		assert(id >= 0 && id < PRODUCERS);
+		assert(seq >= next[id]);  /* Drops may leave gaps, never reorder */
+		next[id] = seq + 1;
+		lines++;
+	}
+
+	assert(lines + lost == PRODUCERS * PER_PRODUCER);
+	printf("  %zu lines written, %llu dropped\n", lines, (unsigned long long)lost);
+
+	free(out);
+	close(fd);
+	unlink(path);
+	printf("OK Concurrent producers correct\n");
+}
+
+/* Test that a stalled pipe drops instead of blocking the producer */
+static void test_stalled_pipe_drops(void)
+{
+	printf("Testing stalled output pipe...\n");
+
+	int pipefd[2];
+	assert(pipe(pipefd) == 0);
+	/* Shrink the pipe so the writer stalls quickly */
+	fcntl(pipefd[1], F_SETPIPE_SZ, 4096);
+
+	__u64 dropped_before = log_dropped();
+
+	log_set_level(LOG_INFO);
+	assert(log_init(pipefd[1]) == 0);
+	for (int i = 0; i < 4 * LOG_RING_SLOTS; i++)
+		log_msg(LOG_INFO, "message %d padded to take up some room in the pipe", i);
+
+	__u64 lost = log_dropped() - dropped_before;
+	assert(lost > 0);
+	printf("  Producer returned with %llu messages dropped\n", (unsigned long long)lost);
+
+	/* Drain the reader side so the writer can finish */
+	pid_t child = fork();
+	assert(child >= 0);
+	if (child == 0) {
+		char buf[65536];
+
+		close(pipefd[1]);
+		while (read(pipefd[0], buf, sizeof(buf)) > 0)
+			;
+		_exit(0);
+	}
+	log_shutdown();
+	close(pipefd[1]);
+	close(pipefd[0]);
+	waitpid(child, NULL, 0);
+
+	printf("OK Stalled pipe handled without blocking\n");
+}
+
+int main(void)
+{
+	printf("Running async logging tests...\n\n");
+
+	test_text_format();
+	test_json_escaping();
+	test_truncation();
+	test_concurrent_producers();
+	test_stalled_pipe_drops();
+
+	printf("\nAll logging tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for BPF map sizing
+ * Tests map_sizing.c: per-node defaults, pid_max limits and overrides
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "../src/map_sizing.h"
+
+static int is_pow2(__u64 v)
+{
+	return v && !(v & (v - 1));
+}
+
+/* Test sizes derived from the node */
+static void test_node_defaults(void)
+{
+	printf("Testing per-node defaults...\n");
+
+	struct map_sizes s;
+
+	/* Small edge node: floors apply, far below the old fixed sizes */
+	map_sizes_for_node(&s, 32768, 4);
+	assert(s.tasks == MIN_TASK_ENTRIES);
+	assert(s.cgroups == MIN_CGROUP_ENTRIES);
+	assert(s.ringbuf == MIN_RINGBUF);
+	printf("  4 CPUs: tasks=%u cgroups=%u ringbuf=%u\n", s.tasks, s.cgroups, s.ringbuf);
+
+	/* Large node with a high pid_max: more contexts than the old 100000 */
+	map_sizes_for_node(&s, 4194304, 192);
+	assert(s.tasks == 192 * TASKS_PER_CPU);
+	assert(s.tasks > 100000);
+	assert(s.cgroups == 192 * CGROUPS_PER_CPU);
+	assert(is_pow2(s.ringbuf) && s.ringbuf >= 192 * RINGBUF_PER_CPU);
+	printf("  192 CPUs: tasks=%u cgroups=%u ringbuf=%u\n", s.tasks, s.cgroups, s.ringbuf);
+
+	/* pid_max bounds the task contexts, even below the floor */
+	map_sizes_for_node(&s, 32768, 192);
+	assert(s.tasks == 32768);
+	map_sizes_for_node(&s, 4096, 1);
+	assert(s.tasks == 4096);
+
+	/* Unknown pid_max or CPU count still gives usable sizes */
+	map_sizes_for_node(&s, 0, 0);
+	assert(s.tasks == MIN_TASK_ENTRIES && s.cgroups == MIN_CGROUP_ENTRIES);
+
+	/* Huge nodes hit the caps */
+	map_sizes_for_node(&s, 4194304, 8192);
+	assert(s.cgroups == MAX_CGROUP_ENTRIES);
+	assert(s.ringbuf == MAX_RINGBUF);
+
+	printf("OK Per-node defaults correct\n");
+}
+
+/* Test command-line overrides */
+static void test_overrides(void)
+{
+	printf("Testing overrides...\n");
+
+	struct map_sizes s, before;
+
+	map_sizes_for_node(&s, 4194304, 8);
+	assert(map_sizes_parse(&s, "tasks=200000") == 0);
+	assert(s.tasks == 200000);
+
+	assert(map_sizes_parse(&s, "cgroups=20000,ringbuf=4m") == 0);
+	assert(s.tasks == 200000 && s.cgroups == 20000 && s.ringbuf == 4 * 1024 * 1024);
+
+	/* Ring sizes are rounded up to a power of two of at least a page */
+	assert(map_sizes_parse(&s, "ringbuf=300k") == 0);
+	assert(s.ringbuf == 512 * 1024);
+	assert(map_sizes_parse(&s, "ringbuf=1") == 0);
+	assert(is_pow2(s.ringbuf) && s.ringbuf >= 4096);
+	printf("  Ring sizes rounded to %u\n", s.ringbuf);
+
+	/* Malformed specs change nothing */
+	const char *bad[] = {
+		"tasks", "tasks=", "tasks=0", "tasks=-1", "tasks=12x", "threads=5",
+		"cgroups=10,bogus=1", "cgroups=99999999", "ringbuf=2048m", "=5", "tasks=k",
+	};
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		before = s;
+		assert(map_sizes_parse(&s, bad[i]) == -1);
+		assert(memcmp(&s, &before, sizeof(s)) == 0);
+	}
+	printf("  %zu malformed specs rejected\n", sizeof(bad) / sizeof(bad[0]));
+
+	printf("OK Overrides correct\n");
+}
+
+/* Test reading pid_max from procfs */
+static void test_pid_max(void)
+{
+	printf("Testing pid_max...\n");
+
+	__u32 pid_max = read_pid_max();
+
+	/* Always at least 301 when procfs is mounted */
+	assert(pid_max == 0 || pid_max > 300);
+	printf("  pid_max=%u\n", pid_max);
+
+	printf("OK pid_max read\n");
+}
+
+int main(void)
+{
+	printf("Running map sizing tests...\n\n");
+
+	test_node_defaults();
+	test_overrides();
+	test_pid_max();
+
+	printf("\nAll map sizing tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for per-cgroup deadline miss summaries
+ * Tests miss_summary.c: aggregation, percentile accuracy and bounded
+ * output under a miss storm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "../src/miss_summary.h"
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+
+struct collected {
+	struct miss_summary_line lines[MISS_SUMMARY_SLOTS];
+	int n;
+};
+
+static void collect(const struct miss_summary_line *line, void *ctx)
+{
+	struct collected *c = ctx;
+
+	assert(c->n < MISS_SUMMARY_SLOTS);
+	c->lines[c->n++] = *line;
+}
+
+/* Test basic per-cgroup aggregation and ordering */
+static void test_basic_aggregation(void)
+{
+	printf("Testing basic aggregation...\n");
+
+	struct miss_summary sum;
+	struct collected out = {0};
+
+	miss_summary_init(&sum);
+	miss_summary_record(&sum, 1001, 5 * NSEC_PER_MSEC);
+	miss_summary_record(&sum, 1002, 10 * NSEC_PER_MSEC);
+	miss_summary_record(&sum, 1001, 3 * NSEC_PER_MSEC);
+	miss_summary_record(&sum, 1001, 7 * NSEC_PER_MSEC);
+
+	assert(sum.total_events == 4);
+	assert(miss_summary_flush(&sum, collect, &out) == 2);
+
+	/* Most-missed cgroup first */
+	assert(out.lines[0].cgroup_id == 1001);
+	assert(out.lines[0].count == 3);
+	assert(out.lines[0].count_error == 0);
+	assert(out.lines[0].max_ns == 7 * NSEC_PER_MSEC);
+	assert(out.lines[0].total_ns == 15 * NSEC_PER_MSEC);
+	assert(out.lines[1].cgroup_id == 1002);
+	assert(out.lines[1].count == 1);
+	printf("  cgroup 1001: count=%llu max=%llums total=%llums\n",
+	       (unsigned long long)out.lines[0].count,
+	       (unsigned long long)(out.lines[0].max_ns / NSEC_PER_MSEC),
+	       (unsigned long long)(out.lines[0].total_ns / NSEC_PER_MSEC));
+
+	/* Flush resets the interval */
+	assert(sum.total_events == 0);
+	out.n = 0;
+	assert(miss_summary_flush(&sum, collect, &out) == 0);
+	printf("  Interval reset after flush\n");
+
+	printf("OK Basic aggregation correct\n");
+}
+
+/* Test p99 estimation against the exact value */
+static void test_percentile_accuracy(void)
+{
+	printf("Testing p99 accuracy...\n");
+
+	struct miss_summary sum;
+	struct collected out = {0};
+
+	miss_summary_init(&sum);
+	/* 1000 samples: 1..1000 ms, exact p99 = 990 ms */
+	for (int i = 1; i <= 1000; i++)
+		miss_summary_record(&sum, 42, (__u64)i * NSEC_PER_MSEC);
+
+	miss_summary_flush(&sum, collect, &out);
+	assert(out.n == 1);
+
+	double p99_ms = (double)out.lines[0].p99_ns / NSEC_PER_MSEC;
+	assert(p99_ms >= 990.0);
+	assert(p99_ms <= 990.0 * 1.25);
+	assert(out.lines[0].p99_ns <= out.lines[0].max_ns);
+	printf("  p99 estimate %.1fms (exact 990ms)\n", p99_ms);
+
+	/* Sub-bucket resolution at the low end is exact */
+	__u32 hist[MISS_HIST_BUCKETS] = {0};
+	hist[3] = 1;
+	assert(miss_hist_percentile(hist, 1, 99) == 3 * NSEC_PER_USEC + 999);
+	assert(miss_hist_percentile(hist, 0, 99) == 0);
+	printf("  Low-range buckets exact\n");
+
+	/* Huge values land in the last bucket instead of overflowing */
+	miss_summary_init(&sum);
+	out.n = 0;
+	miss_summary_record(&sum, 7, ~0ULL / 2);
+	miss_summary_flush(&sum, collect, &out);
+	assert(out.n == 1 && out.lines[0].p99_ns <= out.lines[0].max_ns);
+	printf("  Saturating bucket for extreme values\n");
+
+	printf("OK p99 accuracy within bucket bounds\n");
+}
+
+/* Test that a storm across many cgroups stays bounded and keeps heavy hitters */
+static void test_storm_bounded(void)
+{
+	printf("Testing miss storm across many cgroups...\n");
+
+	struct miss_summary sum;
+	struct collected out = {0};
+	const int noise_cgroups = 5000;
+
+	miss_summary_init(&sum);
+
+	/* Three heavy hitters interleaved with one-off misses from thousands of cgroups */
+	for (int i = 0; i < noise_cgroups; i++) {
+		miss_summary_record(&sum, 1, 2 * NSEC_PER_MSEC);
+		if (i % 2 == 0)
+			miss_summary_record(&sum, 2, 4 * NSEC_PER_MSEC);
+		if (i % 4 == 0)
+			miss_summary_record(&sum, 3, 8 * NSEC_PER_MSEC);
+		miss_summary_record(&sum, 100000 + i, 1 * NSEC_PER_MSEC);
+	}
+
+	__u64 expected_events = noise_cgroups + noise_cgroups / 2 + noise_cgroups / 4 +
+				noise_cgroups;
+	assert(sum.total_events == expected_events);
+	assert(sum.evictions > 0);
+
+	int lines = miss_summary_flush(&sum, collect, &out);
+	assert(lines == MISS_SUMMARY_SLOTS);
+	printf("  %llu events from %d cgroups -> %d lines\n",
+	       (unsigned long long)expected_events, noise_cgroups + 3, lines);
+
+	/* Heavy hitters survive and lead the report with exact counts */
+	assert(out.lines[0].cgroup_id == 1 && out.lines[0].count == (__u64)noise_cgroups);
+	assert(out.lines[1].cgroup_id == 2 && out.lines[1].count == (__u64)noise_cgroups / 2);
+	assert(out.lines[2].cgroup_id == 3 && out.lines[2].count == (__u64)noise_cgroups / 4);
+	assert(out.lines[0].count_error == 0);
+	printf("  Heavy hitters retained: 1=%llu 2=%llu 3=%llu\n",
+	       (unsigned long long)out.lines[0].count,
+	       (unsigned long long)out.lines[1].count,
+	       (unsigned long long)out.lines[2].count);
+
+	/* Recycled slots carry an error bound and never report a p99 above max */
+	for (int i = 3; i < out.n; i++) {
+		assert(out.lines[i].count >= out.lines[i].count_error);
+		assert(out.lines[i].p99_ns <= out.lines[i].max_ns);
+	}
+	printf("  Recycled slots carry count error bounds\n");
+
+	printf("OK Storm output bounded to %d lines\n", MISS_SUMMARY_SLOTS);
+}
+
+int main(void)
+{
+	printf("Running miss summary tests...\n\n");
+
+	test_basic_aggregation();
+	test_percentile_accuracy();
+	test_storm_bounded();
+
+	printf("\nAll miss summary tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,284 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for partial-switch mode
+ * Tests partial_switch.c against a fake cgroup tree with fake thread
+ * policies: threads of configured cgroups and of descendants within the
+ * inherit depth are switched, real-time threads are left alone, and
+ * threads that leave are switched back
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include "../src/partial_switch.h"
+
+#define NR_FAKE_TIDS 16
+#define RESET_ON_FORK 0x40000000
+
+/* Policy per thread ID; -ESRCH marks an exited thread */
+struct fake_sched {
+	int policy[NR_FAKE_TIDS];
+	int sets;
+	pid_t refuse;  /* set_policy() fails with EPERM for this thread */
+};
+
+static int fake_get(pid_t tid, void *ctx)
+{
+	struct fake_sched *f = ctx;
+
+	if (tid <= 0 || tid >= NR_FAKE_TIDS)
+		return -ESRCH;
+	return f->policy[tid];
+}
+
+static int fake_set(pid_t tid, int policy, void *ctx)
+{
+	struct fake_sched *f = ctx;
+
+	if (tid <= 0 || tid >= NR_FAKE_TIDS || f->policy[tid] == -ESRCH)
+		return -ESRCH;
+	if (tid == f->refuse)
+		return -EPERM;
+	f->policy[tid] = policy;
+	f->sets++;
+	return 0;
+}
+
+static char root[64];
+
+static void write_file(const char *rel, const char *content)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", root, rel);
+	f = fopen(path, "w");
+	assert(f);
+	fputs(content, f);
+	fclose(f);
+}
+
+static void make_dir(const char *rel)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/%s", root, rel);
+	assert(mkdir(path, 0755) == 0);
+}
+
+/*
+ * root/svc          1 2
+ * root/svc/ctr      3 4 (4 is SCHED_FIFO)
+ * root/svc/ctr/sub  5
+ * root/other        6
+ */
+static void build_tree(void)
+{
+	strcpy(root, "/tmp/scx-slo-partial-XXXXXX");
+	assert(mkdtemp(root));
+	make_dir("svc");
+	make_dir("svc/ctr");
+	make_dir("svc/ctr/sub");
+	make_dir("other");
+	write_file("svc/cgroup.threads", "1\n2\n");
+	write_file("svc/ctr/cgroup.threads", "3\n4\n");
+	write_file("svc/ctr/sub/cgroup.threads", "5\n");
+	write_file("other/cgroup.threads", "6\n");
+	write_file("svc/cpu.weight", "100\n");
+}
+
+static void remove_tree(void)
+{
+	char cmd[128];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	assert(system(cmd) == 0);
+}
+
+static void fake_init(struct fake_sched *f)
+{
+	memset(f, 0, sizeof(*f));
+	for (int i = 0; i < NR_FAKE_TIDS; i++)
+		f->policy[i] = SCHED_OTHER;
+	f->policy[2] = SCHED_BATCH | RESET_ON_FORK;
+	f->policy[4] = SCHED_FIFO;
+}
+
+/* Test which threads a scan switches, by depth */
+static void test_scan_depth(void)
+{
+	printf("Testing scan within the inherit depth...\n");
+
+	struct fake_sched f;
+	struct partial_switch_ops ops = { fake_get, fake_set, &f };
+	struct partial_switch_stats st;
+	const char *paths[] = { "/svc" };
+	struct partial_switch *ps;
+
+	fake_init(&f);
+	ps = partial_switch_new(root, 1, &ops);
+	assert(ps);
+	assert(partial_switch_scan(ps, paths, 1) == 3);
+	assert(f.policy[1] == SCHED_EXT);
+	assert(f.policy[2] == (SCHED_EXT | RESET_ON_FORK));
+	assert(f.policy[3] == SCHED_EXT);
+	assert(f.policy[4] == SCHED_FIFO);
+	assert(f.policy[5] == SCHED_OTHER);  /* Two levels down */
+	assert(f.policy[6] == SCHED_OTHER);
+
+	partial_switch_get_stats(ps, &st);
+	assert(st.scans == 1 && st.switched == 3 && st.threads == 4 && st.owned == 3);
+
+	/* Nothing left to do on a rescan */
+	assert(partial_switch_scan(ps, paths, 1) == 0);
+	partial_switch_free(ps);
+
+	/* Exact matches only */
+	fake_init(&f);
+	ps = partial_switch_new(root, 0, &ops);
+	assert(partial_switch_scan(ps, paths, 1) == 2);
+	assert(f.policy[3] == SCHED_OTHER);
+	partial_switch_free(ps);
+
+	printf("OK Depth 1 switches 3 threads, depth 0 switches 2\n");
+}
+
+/* Test that overlapping and missing configs are handled */
+static void test_scan_overlap(void)
+{
+	printf("Testing overlapping and missing cgroups...\n");
+
+	struct fake_sched f;
+	struct partial_switch_ops ops = { fake_get, fake_set, &f };
+	const char *paths[] = { "/svc", "/svc/ctr", "svc/ctr/sub", "/gone", "/other" };
+	struct partial_switch_stats st;
+	struct partial_switch *ps;
+
+	fake_init(&f);
+	f.policy[6] = -ESRCH;
+	ps = partial_switch_new(root, 4, &ops);
+	assert(ps);
+	assert(partial_switch_scan(ps, paths, 5) == 4);
+	assert(f.sets == 4);  /* Each thread once */
+	partial_switch_get_stats(ps, &st);
+	assert(st.threads == 6 && st.failed == 0);
+	partial_switch_free(ps);
+
+	printf("OK Threads seen twice switched once, gone ones skipped\n");
+}
+
+/* Test that threads leaving every configured cgroup are switched back */
+static void test_revert_on_leave(void)
+{
+	printf("Testing revert of threads that left...\n");
+
+	struct fake_sched f;
+	struct partial_switch_ops ops = { fake_get, fake_set, &f };
+	const char *paths[] = { "/svc" };
+	struct partial_switch_stats st;
+	struct partial_switch *ps;
+
+	fake_init(&f);
+	ps = partial_switch_new(root, 1, &ops);
+	assert(partial_switch_scan(ps, paths, 1) == 3);
+
+	/* Thread 3 moves to /other, thread 2 exits */
+	write_file("svc/ctr/cgroup.threads", "4\n");
+	write_file("svc/cgroup.threads", "1\n");
+	write_file("other/cgroup.threads", "6\n3\n");
+	f.policy[2] = -ESRCH;
+	assert(partial_switch_scan(ps, paths, 1) == 0);
+	assert(f.policy[3] == SCHED_OTHER);
+	assert(f.policy[1] == SCHED_EXT);
+
+	partial_switch_get_stats(ps, &st);
+	assert(st.reverted == 1 && st.owned == 1 && st.failed == 0);
+
+	/* Config removed: everything goes back */
+	assert(partial_switch_scan(ps, NULL, 0) == 0);
+	assert(f.policy[1] == SCHED_OTHER);
+	partial_switch_free(ps);
+
+	write_file("svc/cgroup.threads", "1\n2\n");
+	write_file("svc/ctr/cgroup.threads", "3\n4\n");
+	write_file("other/cgroup.threads", "6\n");
+
+	printf("OK Moved thread reverted, exited thread forgotten\n");
+}
+
+/* Test reverting strays reported by the scheduler */
+static void test_revert_strays(void)
+{
+	printf("Testing stray revert...\n");
+
+	struct fake_sched f;
+	struct partial_switch_ops ops = { fake_get, fake_set, &f };
+	const char *paths[] = { "/svc" };
+	struct partial_switch_stats st;
+	struct partial_switch *ps;
+	pid_t strays[] = { 7, 1, 4, 15 };
+
+	fake_init(&f);
+	f.policy[7] = SCHED_EXT | RESET_ON_FORK;  /* Forked, then moved away */
+	ps = partial_switch_new(root, 0, &ops);
+	assert(partial_switch_scan(ps, paths, 1) == 2);
+
+	assert(partial_switch_revert(ps, strays, 4) == 2);
+	assert(f.policy[7] == RESET_ON_FORK);
+	assert(f.policy[1] == SCHED_OTHER);
+	assert(f.policy[4] == SCHED_FIFO);
+	partial_switch_get_stats(ps, &st);
+	assert(st.owned == 1);
+
+	/* A thread still configured is taken back by the next scan */
+	assert(partial_switch_scan(ps, paths, 1) == 1);
+	assert(f.policy[1] == SCHED_EXT);
+	partial_switch_free(ps);
+
+	printf("OK Strays reverted, RT threads and flags untouched\n");
+}
+
+/* Test that refused changes are counted, not fatal */
+static void test_refused(void)
+{
+	printf("Testing refused policy changes...\n");
+
+	struct fake_sched f;
+	struct partial_switch_ops ops = { fake_get, fake_set, &f };
+	const char *paths[] = { "/svc" };
+	struct partial_switch_stats st;
+	struct partial_switch *ps;
+
+	fake_init(&f);
+	f.refuse = 2;
+	ps = partial_switch_new(root, 0, &ops);
+	assert(partial_switch_scan(ps, paths, 1) == 1);
+	partial_switch_get_stats(ps, &st);
+	assert(st.failed == 1 && st.owned == 1);
+	partial_switch_free(ps);
+
+	assert(!partial_switch_new("/nonexistent/scx-slo", 0, &ops) && errno == ENOENT);
+
+	printf("OK Refusal counted, missing root reported\n");
+}
+
+int main(void)
+{
+	printf("=== Partial Switch Tests ===\n\n");
+
+	build_tree();
+	test_scan_depth();
+	test_scan_overlap();
+	test_revert_on_leave();
+	test_revert_strays();
+	test_refused();
+	remove_tree();
+
+	printf("\nAll partial switch tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,230 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for the reserved CPU partition
+ * Tests reserve_ctl.c with synthetic run statistics: growth on misses of
+ * eligible cgroups only, limits, shrinking after sustained slack, and the
+ * CPU order read from a fake topology tree
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../src/reserve_ctl.h"
+#include "test_cgrp.h"
+
+#define MS  1000000ULL
+#define SEC 1000000000ULL
+
+/*
+ * One second in which @c runs @runs times using @cpus CPUs in total,
+ * @late of them late and the rest with @slack of their window to spare.
+ */
+static struct budget_ctl_sample cgrp_run(struct test_cgrp *c, __u64 runs, __u64 late, double slack,
+					 double cpus)
+{
+	return test_cgrp_run(c, runs, late, 0, (__u64)(slack * test_cgrp_window(&c->cfg)),
+			     (__u64)(cpus * SEC));
+}
+
+static void setup(struct test_cgrp *c)
+{
+	memset(c, 0, 2 * sizeof(*c));
+	c[0].id = 1;
+	c[0].cfg = (struct slo_cfg){ .budget_ns = 10 * MS, .importance = 90 };
+	c[1].id = 2;
+	c[1].cfg = (struct slo_cfg){ .budget_ns = 100 * MS, .importance = 10,
+				     .flags = SLO_CLASS_BATCH };
+}
+
+static void test_params(void)
+{
+	printf("Testing parameter parsing...\n");
+
+	struct reserve_params p;
+	struct slo_cfg cfg = { .budget_ns = 10 * MS, .importance = 50 };
+
+	reserve_params_default(&p);
+	assert(p.importance == 80 && p.max_frac == 0.5);
+
+	assert(reserve_parse(&p, "miss_grow=0.05,importance=60,max_frac=0.25,step=2") == 0);
+	assert(p.miss_grow == 0.05 && p.importance == 60 && p.step == 2);
+
+	/* Out of range, or miss_shrink above miss_grow */
+	assert(reserve_parse(&p, "max_frac=1") == -1);
+	assert(reserve_parse(&p, "miss_shrink=0.1") == -1);
+
+	/* Critical class or high enough importance */
+	assert(!reserve_eligible(&p, &cfg));
+	cfg.flags = SLO_CLASS_CRITICAL;
+	assert(reserve_eligible(&p, &cfg));
+	cfg.flags = 0;
+	cfg.importance = 60;
+	assert(reserve_eligible(&p, &cfg));
+
+	printf("OK Params parsed, eligibility by class and importance\n");
+}
+
+/* Test growth on misses, the limits and shrinking after slack */
+static void test_resize(void)
+{
+	printf("Testing partition growth and shrink...\n");
+
+	struct reserve_params p;
+	struct budget_ctl_sample s[2];
+	struct reserve_stats st;
+	struct reserve_ctl *rc;
+	struct test_cgrp c[2];
+
+	reserve_params_default(&p);
+	rc = reserve_ctl_new(&p, 8);
+	assert(rc);
+	setup(c);
+
+	s[0] = cgrp_run(&c[0], 1000, 0, 0.5, 3);
+	s[1] = cgrp_run(&c[1], 1000, 0, 0.5, 4);
+	assert(reserve_ctl_step(rc, s, 2, 0) == 0);
+
+	/* 5% misses: one CPU per interval up to half the node */
+	for (int i = 1; i <= 5; i++) {
+		s[0] = cgrp_run(&c[0], 1000, 50, 0.1, 3);
+		s[1] = cgrp_run(&c[1], 1000, 0, 0.5, 4);
+		assert(reserve_ctl_step(rc, s, 2, SEC) == (i < 4 ? i : 4));
+	}
+	reserve_ctl_get_stats(rc, &st);
+	assert(st.cpus == 4 && st.limit == 4 && st.grows == 4 && st.eligible == 1);
+	assert(st.last_miss == 0.05 && st.util == 3);
+
+	/* Misses within target but no slack: held */
+	for (int i = 0; i < 5; i++) {
+		s[0] = cgrp_run(&c[0], 1000, 1, 0.1, 3);
+		s[1] = cgrp_run(&c[1], 1000, 0, 0.5, 4);
+		assert(reserve_ctl_step(rc, s, 2, SEC) == 4);
+	}
+
+	/* Slack: one CPU back after 3 intervals */
+	for (int i = 1; i <= 3; i++) {
+		s[0] = cgrp_run(&c[0], 1000, 0, 0.5, 3);
+		s[1] = cgrp_run(&c[1], 1000, 0, 0.5, 4);
+		assert(reserve_ctl_step(rc, s, 2, SEC) == 4 - i / 3);
+	}
+
+	/* Eligible work drops to half a CPU: down to 2 right away */
+	s[0] = cgrp_run(&c[0], 1000, 50, 0.1, 0.5);
+	s[1] = cgrp_run(&c[1], 1000, 0, 0.5, 4);
+	assert(reserve_ctl_step(rc, s, 2, SEC) == 2);
+	reserve_ctl_get_stats(rc, &st);
+	assert(st.limit == 2 && st.shrinks == 2);
+	reserve_ctl_free(rc);
+
+	printf("OK Grows to the limit on misses, shrinks after sustained slack\n");
+}
+
+/* Test that misses of cgroups kept off the partition do not grow it */
+static void test_ineligible(void)
+{
+	printf("Testing misses of ineligible cgroups...\n");
+
+	struct reserve_params p;
+	struct budget_ctl_sample s[2];
+	struct reserve_ctl *rc;
+	struct test_cgrp c[2];
+
+	reserve_params_default(&p);
+	rc = reserve_ctl_new(&p, 8);
+	setup(c);
+
+	s[0] = cgrp_run(&c[0], 1000, 0, 0.5, 1);
+	s[1] = cgrp_run(&c[1], 1000, 500, 0, 4);
+	reserve_ctl_step(rc, s, 2, 0);
+	for (int i = 0; i < 3; i++) {
+		s[0] = cgrp_run(&c[0], 1000, 0, 0.5, 1);
+		s[1] = cgrp_run(&c[1], 1000, 500, 0, 4);
+		assert(reserve_ctl_step(rc, s, 2, SEC) == 0);
+	}
+
+	/* Too few eligible runs to judge */
+	s[0] = cgrp_run(&c[0], 10, 10, 0, 1);
+	s[1] = cgrp_run(&c[1], 1000, 0, 0.5, 4);
+	assert(reserve_ctl_step(rc, s, 2, SEC) == 0);
+	reserve_ctl_free(rc);
+
+	assert(!reserve_ctl_new(&p, 0));
+
+	printf("OK Only eligible misses count\n");
+}
+
+static char root[64];
+
+static void write_file(const char *rel, const char *content)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", root, rel);
+	f = fopen(path, "w");
+	assert(f);
+	fputs(content, f);
+	fclose(f);
+}
+
+static void make_dir(const char *rel)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/%s", root, rel);
+	assert(mkdir(path, 0755) == 0);
+}
+
+/*
+ * cpu0/cpu2 and cpu1/cpu3 are SMT siblings, cpu4 has no sibling list and
+ * cpu5 is offline
+ */
+static void test_cpu_order(void)
+{
+	printf("Testing CPU order...\n");
+
+	char cmd[128], dir[32];
+	__u32 order[8];
+
+	strcpy(root, "/tmp/scx-slo-reserve-XXXXXX");
+	assert(mkdtemp(root));
+	for (int i = 0; i < 6; i++) {
+		snprintf(dir, sizeof(dir), "cpu%d", i);
+		make_dir(dir);
+		if (i == 5)
+			continue;
+		snprintf(dir, sizeof(dir), "cpu%d/topology", i);
+		make_dir(dir);
+	}
+	write_file("cpu0/topology/thread_siblings_list", "0,2\n");
+	write_file("cpu2/topology/thread_siblings_list", "0,2\n");
+	write_file("cpu1/topology/thread_siblings_list", "1,3\n");
+	write_file("cpu3/topology/thread_siblings_list", "1-3\n");  /* 2 joins this core */
+
+	assert(reserve_cpu_order(root, 6, order) == 5);
+	assert(order[0] == 4);
+	assert(order[1] == 3 && order[2] == 2 && order[3] == 1 && order[4] == 0);
+
+	write_file("cpu3/topology/thread_siblings_list", "1,3\n");
+	assert(reserve_cpu_order(root, 6, order) == 5);
+	assert(order[1] == 3 && order[2] == 1 && order[3] == 2 && order[4] == 0);
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	assert(system(cmd) == 0);
+
+	printf("OK Highest CPU first, siblings together, offline CPUs skipped\n");
+}
+
+int main(void)
+{
+	printf("=== Reserved Partition Tests ===\n\n");
+
+	test_params();
+	test_resize();
+	test_ineligible();
+	test_cpu_order();
+
+	printf("\nAll reserved partition tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for cgroup path pattern matching
+ * Tests rule_trie.c: literals, wildcards, "...", rule precedence, subtree
+ * pruning and that matching cost does not grow with the rule count
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "../src/rule_trie.h"
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Test pattern detection and malformed patterns */
+static void test_patterns(void)
+{
+	printf("Testing pattern syntax...\n");
+
+	assert(!rule_is_pattern("/kubepods/critical/payment-api"));
+	assert(rule_is_pattern("/kubepods.slice/*burstable*"));
+	assert(rule_is_pattern("/kubepods/pod?"));
+	assert(rule_is_pattern("/kubepods/..."));
+	assert(!rule_is_pattern("/kubepods/a..b"));
+	assert(!rule_is_pattern("relative/*"));
+
+	struct rule_trie *t = rule_trie_new();
+	assert(t);
+	assert(rule_trie_add(t, "relative/path", 0) == -EINVAL);
+	assert(rule_trie_add(t, "/kubepods/../etc", 0) == -EINVAL);
+	assert(rule_trie_add(t, "/kubepods/./x", 0) == -EINVAL);
+	assert(rule_trie_add(t, "/kubepods", -1) == -EINVAL);
+	assert(rule_trie_size(t) == 0);
+	assert(rule_trie_match(t, "/kubepods") == -1);
+	rule_trie_free(t);
+
+	printf("OK Pattern syntax handled\n");
+}
+
+/* Test literal, wildcard and "..." matching */
+static void test_matching(void)
+{
+	printf("Testing matching...\n");
+
+	struct rule_trie *t = rule_trie_new();
+	assert(t);
+
+	assert(rule_trie_add(t, "/kubepods/critical/payment-api", 0) == 0);
+	assert(rule_trie_add(t, "/kubepods.slice/*burstable*/...", 1) == 0);
+	assert(rule_trie_add(t, "/system.slice/nginx-?.service", 2) == 0);
+	assert(rule_trie_add(t, "/batch/.../worker*", 3) == 0);
+
+	assert(rule_trie_match(t, "/kubepods/critical/payment-api") == 0);
+	assert(rule_trie_match(t, "/kubepods/critical/payment-api/") == 0);
+	assert(rule_trie_match(t, "/kubepods/critical") == -1);
+	assert(rule_trie_match(t, "/kubepods/critical/payment-api/ctr") == -1);
+	printf("  Literal rule matches exactly\n");
+
+	/* "..." includes the directory itself */
+	assert(rule_trie_match(t, "/kubepods.slice/kubepods-burstable.slice") == 1);
+	assert(rule_trie_match(t,
+		"/kubepods.slice/kubepods-burstable.slice/kubepods-burstable-podabc.slice/cri-containerd-1.scope") == 1);
+	assert(rule_trie_match(t, "/kubepods.slice/kubepods-besteffort.slice/x") == -1);
+	assert(rule_trie_match(t, "/kubepods.slice") == -1);
+	printf("  Trailing \"...\" covers a subtree\n");
+
+	assert(rule_trie_match(t, "/system.slice/nginx-1.service") == 2);
+	assert(rule_trie_match(t, "/system.slice/nginx-12.service") == -1);
+	/* Wildcards do not match hidden names */
+	assert(rule_trie_match(t, "/kubepods.slice/.burstable/x") == -1);
+
+	assert(rule_trie_match(t, "/batch/worker-1") == 3);
+	assert(rule_trie_match(t, "/batch/a/b/c/worker-2") == 3);
+	assert(rule_trie_match(t, "/batch/a/b/c") == -1);
+	printf("  Inner \"...\" spans zero or more levels\n");
+
+	rule_trie_free(t);
+	printf("OK Matching correct\n");
+}
+
+/* Test that the highest-numbered (latest) matching rule wins */
+static void test_precedence(void)
+{
+	printf("Testing rule precedence...\n");
+
+	struct rule_trie *t = rule_trie_new();
+	assert(t);
+
+	assert(rule_trie_add(t, "/kubepods/...", 0) == 0);
+	assert(rule_trie_add(t, "/kubepods/pod*", 1) == 0);
+	assert(rule_trie_add(t, "/kubepods/pod42", 2) == 0);
+	assert(rule_trie_add(t, "/kubepods/pod7", 3) == 0);
+	assert(rule_trie_add(t, "/kubepods/...", 4) == 0);   /* Repeated later */
+
+	assert(rule_trie_match(t, "/kubepods/pod42") == 4);
+	assert(rule_trie_match(t, "/kubepods") == 4);
+	assert(rule_trie_size(t) == 5);
+
+	struct rule_trie *u = rule_trie_new();
+	assert(u);
+	assert(rule_trie_add(u, "/kubepods/...", 0) == 0);
+	assert(rule_trie_add(u, "/kubepods/pod*", 1) == 0);
+	assert(rule_trie_add(u, "/kubepods/pod42", 2) == 0);
+	assert(rule_trie_match(u, "/kubepods/pod42") == 2);
+	assert(rule_trie_match(u, "/kubepods/pod43") == 1);
+	assert(rule_trie_match(u, "/kubepods/other") == 0);
+	printf("  Later rules override earlier ones regardless of specificity\n");
+
+	rule_trie_free(t);
+	rule_trie_free(u);
+	printf("OK Precedence correct\n");
+}
+
+/* Test pruning of subtrees no pattern can reach */
+static void test_may_match_below(void)
+{
+	printf("Testing subtree pruning...\n");
+
+	struct rule_trie *t = rule_trie_new();
+	assert(t);
+	assert(!rule_trie_may_match_below(t, "/"));
+
+	assert(rule_trie_add(t, "/kubepods.slice/*burstable*/...", 0) == 0);
+	assert(rule_trie_add(t, "/system.slice/nginx.service", 1) == 0);
+
+	assert(rule_trie_may_match_below(t, "/"));
+	assert(rule_trie_may_match_below(t, "/kubepods.slice"));
+	assert(rule_trie_may_match_below(t, "/kubepods.slice/kubepods-burstable.slice/pod/ctr"));
+	assert(!rule_trie_may_match_below(t, "/kubepods.slice/kubepods-besteffort.slice"));
+	assert(rule_trie_may_match_below(t, "/system.slice"));
+	assert(rule_trie_may_match_below(t, "/system.slice/nginx.service"));
+	assert(!rule_trie_may_match_below(t, "/system.slice/sshd.service"));
+	assert(!rule_trie_may_match_below(t, "/user.slice"));
+	printf("  Only ancestors of possible matches are visited\n");
+
+	rule_trie_free(t);
+	printf("OK Subtree pruning correct\n");
+}
+
+/* Test that matching stays fast with thousands of rules */
+static void test_many_rules(void)
+{
+	printf("Testing matching against many rules...\n");
+
+	const int rules = 5000, lookups = 20000;
+	struct rule_trie *t = rule_trie_new();
+	char path[256];
+	double start, per_match;
+	int hits = 0;
+
+	assert(t);
+	for (int i = 0; i < rules; i++) {
+		snprintf(path, sizeof(path), "/kubepods.slice/kubepods-burstable.slice/"
+			 "kubepods-burstable-pod%05d*.slice/...", i);
+		assert(rule_trie_add(t, path, i) == 0);
+	}
+	assert(rule_trie_add(t, "/kubepods.slice/*besteffort*/...", rules) == 0);
+
+	snprintf(path, sizeof(path), "/kubepods.slice/kubepods-burstable.slice/"
+		 "kubepods-burstable-pod%05d_x.slice/cri-containerd-1.scope", 1234);
+	assert(rule_trie_match(t, path) == 1234);
+	assert(rule_trie_match(t, "/kubepods.slice/kubepods-besteffort.slice/x") == rules);
+
+	/* Every lookup passes the node with all 5000 wildcard children */
+	start = now_us();
+	for (int i = 0; i < lookups; i++) {
+		snprintf(path, sizeof(path), "/kubepods.slice/kubepods-burstable.slice/"
+			 "kubepods-burstable-pod%05d_uid.slice/ctr", i % rules);
+		hits += rule_trie_match(t, path) == i % rules;
+	}
+	per_match = (now_us() - start) / lookups;
+	assert(hits == lookups);
+	printf("  %d rules: %.2f us per match\n", rules + 1, per_match);
+
+	rule_trie_free(t);
+	printf("OK Many rules handled\n");
+}
+
+int main(void)
+{
+	printf("Running rule trie tests...\n\n");
+
+	test_patterns();
+	test_matching();
+	test_precedence();
+	test_may_match_below();
+	test_many_rules();
+
+	printf("\nAll rule trie tests passed!\n");
+	return 0;
+}
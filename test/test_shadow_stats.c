@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for shadow mode histograms
+ * Tests shadow_stats.c: bucket bounds, percentiles, and summing and
+ * differencing the per-CPU copies
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include "../src/shadow_stats.h"
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+
+static void hist_add(struct slo_hist *h, __u64 ns)
+{
+	h->count++;
+	h->sum_ns += ns;
+	h->buckets[shadow_hist_bucket(ns)]++;
+}
+
+/* Test that bucket bounds line up with the bucketing */
+static void test_buckets(void)
+{
+	printf("Testing bucket bounds...\n");
+
+	assert(shadow_hist_bucket(0) == 0);
+	assert(shadow_hist_bucket(999) == 0);
+	assert(shadow_hist_bucket(NSEC_PER_USEC) == 1);
+	assert(shadow_hist_bucket(2 * NSEC_PER_USEC - 1) == 1);
+	assert(shadow_hist_bucket(2 * NSEC_PER_USEC) == 2);
+	assert(shadow_hist_bucket(UINT64_MAX) == SLO_HIST_BUCKETS - 1);
+
+	/* Every bucket ends where the next starts */
+	for (unsigned int i = 0; i < SLO_HIST_BUCKETS - 1; i++) {
+		__u64 upper = shadow_hist_upper_ns(i);
+
+		assert(shadow_hist_bucket(upper - 1) == i);
+		assert(shadow_hist_bucket(upper) == i + 1);
+	}
+	assert(shadow_hist_upper_ns(SLO_HIST_BUCKETS - 1) == UINT64_MAX);
+
+	/* The 10s budget ceiling, and lateness beyond it, stay below the last bucket */
+	assert(shadow_hist_bucket(10000 * NSEC_PER_MSEC) < SLO_HIST_BUCKETS - 1);
+	printf("  %d buckets up to %.1fs\n", SLO_HIST_BUCKETS,
+	       shadow_hist_upper_ns(SLO_HIST_BUCKETS - 2) / 1e9);
+
+	printf("OK Bucket bounds verified\n");
+}
+
+/* Test percentiles against a known distribution */
+static void test_percentiles(void)
+{
+	printf("Testing percentiles...\n");
+
+	struct slo_hist h = {0};
+	__u64 p50, p99;
+
+	assert(shadow_hist_percentile(&h, 99) == 0);
+
+	/* 98 runs at 100us, 2 at 30ms */
+	for (int i = 0; i < 98; i++)
+		hist_add(&h, 100 * NSEC_PER_USEC);
+	hist_add(&h, 30 * NSEC_PER_MSEC);
+	hist_add(&h, 30 * NSEC_PER_MSEC);
+
+	p50 = shadow_hist_percentile(&h, 50);
+	p99 = shadow_hist_percentile(&h, 99);
+	assert(p50 >= 100 * NSEC_PER_USEC && p50 <= 200 * NSEC_PER_USEC);
+	assert(p99 >= 30 * NSEC_PER_MSEC && p99 <= 60 * NSEC_PER_MSEC);
+	assert(shadow_hist_percentile(&h, 98) == p50);
+	assert(shadow_hist_percentile(&h, 0) == p50);
+	assert(shadow_hist_percentile(&h, 1000) == p99);
+	printf("  p50<=%.3fms p99<=%.3fms\n", p50 / 1e6, p99 / 1e6);
+
+	/* The last bucket reports where it starts */
+	memset(&h, 0, sizeof(h));
+	hist_add(&h, UINT64_MAX);
+	assert(shadow_hist_percentile(&h, 50) == shadow_hist_upper_ns(SLO_HIST_BUCKETS - 2));
+
+	printf("OK Percentiles verified\n");
+}
+
+/* Test summing per-CPU copies and taking interval deltas */
+static void test_sum_and_delta(void)
+{
+	printf("Testing per-CPU sums and deltas...\n");
+
+	struct slo_shadow_stats percpu[4], prev, cur, d;
+
+	memset(percpu, 0, sizeof(percpu));
+	for (int cpu = 0; cpu < 4; cpu++) {
+		hist_add(&percpu[cpu].slack, (cpu + 1) * NSEC_PER_MSEC);
+		hist_add(&percpu[cpu].delay, 50 * NSEC_PER_USEC);
+	}
+	hist_add(&percpu[2].lateness, 5 * NSEC_PER_MSEC);
+
+	shadow_stats_sum(&prev, percpu, 4);
+	assert(prev.slack.count == 4);
+	assert(prev.slack.sum_ns == 10 * NSEC_PER_MSEC);
+	assert(prev.lateness.count == 1);
+	assert(prev.delay.buckets[shadow_hist_bucket(50 * NSEC_PER_USEC)] == 4);
+
+	/* Only what was counted since @prev shows up */
+	hist_add(&percpu[0].lateness, 7 * NSEC_PER_MSEC);
+	hist_add(&percpu[3].slack, 9 * NSEC_PER_MSEC);
+	shadow_stats_sum(&cur, percpu, 4);
+	shadow_stats_delta(&d, &cur, &prev);
+	assert(d.slack.count == 1 && d.slack.sum_ns == 9 * NSEC_PER_MSEC);
+	assert(d.lateness.count == 1 && d.lateness.sum_ns == 7 * NSEC_PER_MSEC);
+	assert(d.lateness.buckets[shadow_hist_bucket(7 * NSEC_PER_MSEC)] == 1);
+	assert(d.delay.count == 0);
+
+	/* Counters that went backwards (programs reloaded) restart the delta */
+	memset(percpu, 0, sizeof(percpu));
+	hist_add(&percpu[1].slack, NSEC_PER_MSEC);
+	shadow_stats_sum(&prev, percpu, 4);
+	shadow_stats_delta(&d, &prev, &cur);
+	assert(d.slack.count == 1 && d.slack.sum_ns == NSEC_PER_MSEC);
+	assert(d.lateness.count == 0);
+
+	printf("OK Sums and deltas verified\n");
+}
+
+int main(void)
+{
+	printf("Running shadow stats tests...\n\n");
+
+	test_buckets();
+	test_percentiles();
+	test_sum_and_delta();
+
+	printf("\nAll shadow stats tests passed!\n");
+	return 0;
+}
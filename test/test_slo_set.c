@@ -0,0 +1,229 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for SLO rule sets and config reload diffs
+ * Tests slo_set.c: duplicate handling, diffs between loads, path lookup
+ * and that a reload touches only the keys that changed
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include "../src/slo_set.h"
+
+#define NSEC_PER_MSEC 1000000ULL
+
+static struct slo_cfg make_cfg(__u64 budget_ms, __u32 importance)
+{
+	struct slo_cfg cfg = {
+		.budget_ns = budget_ms * NSEC_PER_MSEC,
+		.importance = importance,
+	};
+	return cfg;
+}
+
+static void add_rule(struct slo_set *set, const char *path, __u64 id,
+		     __u64 budget_ms, __u32 importance)
+{
+	struct slo_cfg cfg = make_cfg(budget_ms, importance);
+
+	assert(slo_set_add(set, path, id, &cfg) == 0);
+}
+
+/* Test sorting and that later lines override earlier ones */
+static void test_finalize(void)
+{
+	printf("Testing finalize ordering and duplicates...\n");
+
+	struct slo_set set;
+
+	slo_set_init(&set);
+	add_rule(&set, "/kubepods/c", 30, 100, 50);
+	add_rule(&set, "/kubepods/a", 10, 50, 90);
+	add_rule(&set, "/kubepods/b", 20, 200, 10);
+	add_rule(&set, "/kubepods/a", 10, 25, 95);   /* Overrides the first /a */
+	slo_set_finalize(&set);
+
+	assert(set.sorted);
+	assert(set.nr == 3);
+	assert(set.rules[0].cgroup_id == 10);
+	assert(set.rules[1].cgroup_id == 20);
+	assert(set.rules[2].cgroup_id == 30);
+	assert(set.rules[0].cfg.budget_ns == 25 * NSEC_PER_MSEC);
+	assert(set.rules[0].cfg.importance == 95);
+	printf("  Later duplicate wins: /kubepods/a -> 25ms, importance 95\n");
+
+	/* Finalize is idempotent */
+	slo_set_finalize(&set);
+	assert(set.nr == 3);
+
+	assert(slo_set_find(&set, 20)->cfg.budget_ns == 200 * NSEC_PER_MSEC);
+	assert(slo_set_find(&set, 30) == &set.rules[2]);
+	assert(slo_set_find(&set, 15) == NULL);
+	assert(slo_set_find(&set, 99) == NULL);
+
+	assert(slo_set_remove(&set, 20) == 0);
+	assert(set.nr == 2 && set.rules[1].cgroup_id == 30);
+	assert(slo_set_remove(&set, 20) == -ENOENT);
+	assert(slo_set_find(&set, 20) == NULL);
+
+	/* Upsert keeps the set sorted and replaces in place */
+	struct slo_cfg cfg = make_cfg(75, 60);
+	assert(slo_set_upsert(&set, "/kubepods/b", 20, &cfg) == 0);
+	assert(slo_set_upsert(&set, "/kubepods/z", 5, &cfg) == 0);
+	assert(slo_set_upsert(&set, "/kubepods/y", 40, &cfg) == 0);
+	assert(set.nr == 5);
+	for (size_t i = 1; i < set.nr; i++)
+		assert(set.rules[i - 1].cgroup_id < set.rules[i].cgroup_id);
+	cfg = make_cfg(10, 99);
+	assert(slo_set_upsert(&set, "/kubepods/b", 20, &cfg) == 0);
+	assert(set.nr == 5);
+	assert(slo_set_find(&set, 20)->cfg.importance == 99);
+	printf("  Upsert keeps order: %zu rules\n", set.nr);
+
+	slo_set_free(&set);
+	printf("OK Finalize correct\n");
+}
+
+/* Test diffs between two loads */
+static void test_diff(void)
+{
+	printf("Testing diff between loads...\n");
+
+	struct slo_set old, new;
+	struct slo_diff diff;
+
+	slo_set_init(&old);
+	slo_set_init(&new);
+
+	add_rule(&old, "/unchanged", 1, 50, 90);
+	add_rule(&old, "/changed", 2, 100, 70);
+	add_rule(&old, "/removed", 3, 500, 20);
+
+	add_rule(&new, "/unchanged", 1, 50, 90);
+	add_rule(&new, "/changed", 2, 80, 70);
+	add_rule(&new, "/added", 4, 10, 99);
+
+	slo_set_finalize(&old);
+	slo_set_finalize(&new);
+
+	assert(slo_set_diff(&old, &new, &diff) == 0);
+	assert(diff.nr_upsert == 2);
+	assert(diff.upsert_keys[0] == 2);
+	assert(diff.upsert_vals[0].budget_ns == 80 * NSEC_PER_MSEC);
+	assert(diff.upsert_keys[1] == 4);
+	assert(diff.nr_delete == 1);
+	assert(diff.delete_keys[0] == 3);
+	printf("  2 upserts (changed, added), 1 delete (removed)\n");
+	slo_diff_free(&diff);
+
+	/* First load: everything is new */
+	struct slo_set empty;
+	slo_set_init(&empty);
+	assert(slo_set_diff(&empty, &new, &diff) == 0);
+	assert(diff.nr_upsert == 3 && diff.nr_delete == 0);
+	slo_diff_free(&diff);
+
+	/* Config file removed: everything goes */
+	assert(slo_set_diff(&new, &empty, &diff) == 0);
+	assert(diff.nr_upsert == 0 && diff.nr_delete == 3);
+	slo_diff_free(&diff);
+
+	/* Identical loads: nothing to write */
+	assert(slo_set_diff(&new, &new, &diff) == 0);
+	assert(diff.nr_upsert == 0 && diff.nr_delete == 0);
+	slo_diff_free(&diff);
+
+	slo_set_free(&old);
+	slo_set_free(&new);
+	printf("OK Diff correct\n");
+}
+
+/* Test reusing resolved IDs by config path */
+static void test_path_index(void)
+{
+	printf("Testing path index...\n");
+
+	struct slo_set set;
+	struct slo_path_index idx;
+
+	slo_set_init(&set);
+	add_rule(&set, "/kubepods/b", 20, 100, 50);
+	add_rule(&set, "/kubepods/a", 10, 100, 50);
+	add_rule(&set, "/system.slice/nginx.service", 30, 100, 50);
+	slo_set_finalize(&set);
+
+	assert(slo_path_index_build(&idx, &set) == 0);
+	assert(slo_path_index_find(&idx, "/kubepods/a")->cgroup_id == 10);
+	assert(slo_path_index_find(&idx, "/system.slice/nginx.service")->cgroup_id == 30);
+	assert(slo_path_index_find(&idx, "/kubepods/c") == NULL);
+	assert(slo_path_index_find(&idx, "") == NULL);
+	slo_path_index_free(&idx);
+
+	/* Empty set */
+	struct slo_set empty;
+	slo_set_init(&empty);
+	assert(slo_path_index_build(&idx, &empty) == 0);
+	assert(slo_path_index_find(&idx, "/kubepods/a") == NULL);
+	slo_path_index_free(&idx);
+
+	slo_set_free(&set);
+	printf("OK Path index correct\n");
+}
+
+/* Test that a small edit to a large config yields a small diff */
+static void test_large_config_small_edit(void)
+{
+	printf("Testing small edit to a large config...\n");
+
+	const int rules = 10000;
+	struct slo_set old, new;
+	struct slo_diff diff;
+	char path[64];
+
+	slo_set_init(&old);
+	slo_set_init(&new);
+
+	for (int i = 0; i < rules; i++) {
+		snprintf(path, sizeof(path), "/kubepods/pod%d", i);
+		/* Insert in reverse so finalize has real sorting to do */
+		add_rule(&old, path, 1000 + rules - i, 100, 50);
+		if (i == 17)
+			add_rule(&new, path, 1000 + rules - i, 40, 50);  /* Budget edit */
+		else if (i != 4242)                                     /* Line deleted */
+			add_rule(&new, path, 1000 + rules - i, 100, 50);
+	}
+	add_rule(&new, "/kubepods/new-pod", 999, 20, 80);
+
+	slo_set_finalize(&old);
+	slo_set_finalize(&new);
+	assert(old.nr == (size_t)rules && new.nr == (size_t)rules);
+
+	assert(slo_set_diff(&old, &new, &diff) == 0);
+	assert(diff.nr_upsert == 2);
+	assert(diff.nr_delete == 1);
+	assert(diff.delete_keys[0] == 1000 + rules - 4242);
+	printf("  %d rules, 1 edit + 1 add + 1 delete -> %zu upserts, %zu deletes\n",
+	       rules, diff.nr_upsert, diff.nr_delete);
+	slo_diff_free(&diff);
+
+	slo_set_move(&old, &new);
+	assert(new.nr == 0 && old.nr == (size_t)rules);
+
+	slo_set_free(&old);
+	slo_set_free(&new);
+	printf("OK Diff proportional to changes\n");
+}
+
+int main(void)
+{
+	printf("Running SLO rule set tests...\n\n");
+
+	test_finalize();
+	test_diff();
+	test_path_index();
+	test_large_config_small_edit();
+
+	printf("\nAll SLO rule set tests passed!\n");
+	return 0;
+}
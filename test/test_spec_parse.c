@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for key=value tuning specs
+ * Tests spec_parse.c: each value type, ranges, malformed items, and
+ * rejecting a spec whole
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <linux/types.h>
+#include "../src/spec_parse.h"
+
+struct test_params {
+	double ratio;
+	__u32 count;
+	__u32 limit;
+	__u64 wait_ns;
+	char path[8];
+	bool fast;
+};
+
+static const struct spec_key test_keys[] = {
+	SPEC_KEY_DOUBLE("ratio", struct test_params, ratio, 0, 1),
+	SPEC_KEY_U32("count", struct test_params, count, 1, 100),
+	SPEC_KEY_U32("limit", struct test_params, limit, 1, 100),
+	SPEC_KEY_US("wait_us", struct test_params, wait_ns, 10, 1000000),
+	SPEC_KEY_STR("path", struct test_params, path),
+	SPEC_KEY_CHOICE("mode", struct test_params, fast, "slow", "fast"),
+};
+
+static bool test_valid(const void *params)
+{
+	const struct test_params *p = params;
+
+	return p->count <= p->limit;
+}
+
+static const struct spec_def test_spec = {
+	.what = "test",
+	.keys = test_keys,
+	.nr_keys = SPEC_NR_KEYS(test_keys),
+	.size = sizeof(struct test_params),
+	.valid = test_valid,
+};
+
+static void test_types(void)
+{
+	printf("Testing value types...\n");
+
+	struct test_params p = { .limit = 100 };
+
+	assert(spec_parse(&test_spec, &p, "") == 0);
+	assert(spec_parse(&test_spec, &p,
+			  "ratio=0.25,count=7,wait_us=500,path=/tmp/x,mode=fast") == 0);
+	assert(p.ratio == 0.25 && p.count == 7 && p.wait_ns == 500000);
+	assert(strcmp(p.path, "/tmp/x") == 0 && p.fast);
+	assert(spec_parse(&test_spec, &p, "mode=slow,count=100") == 0);
+	assert(!p.fast && p.count == 100);
+	assert(spec_parse(&test_spec, &p, "count=1,") == 0);
+
+	printf("OK Doubles, integers, microseconds, strings and choices\n");
+}
+
+static void test_rejects(void)
+{
+	printf("Testing malformed items...\n");
+
+	const char *bad[] = {
+		"ratio=1.5", "ratio=", "ratio=0.5x", "count=0", "count=-1", "wait_us=5",
+		"path=/too/long", "mode=turbo", "count", "counts=1", "count=1,,",
+	};
+	struct test_params p = { .count = 5, .limit = 100 }, before = p;
+
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		assert(spec_parse(&test_spec, &p, bad[i]) == -1);
+		assert(memcmp(&p, &before, sizeof(p)) == 0);
+	}
+
+	printf("OK Out of range, unknown and malformed items rejected\n");
+}
+
+static void test_whole(void)
+{
+	printf("Testing whole-spec rejection...\n");
+
+	struct test_params p = { .count = 5, .limit = 100 }, before = p;
+
+	/* Good items before a bad one are not applied */
+	assert(spec_parse(&test_spec, &p, "ratio=0.5,count=9,mode=turbo") == -1);
+	assert(memcmp(&p, &before, sizeof(p)) == 0);
+
+	/* Nor are items that fail the check across keys */
+	assert(spec_parse(&test_spec, &p, "ratio=0.5,limit=4") == -1);
+	assert(memcmp(&p, &before, sizeof(p)) == 0);
+	assert(spec_parse(&test_spec, &p, "limit=4,count=3") == 0);
+	assert(p.count == 3 && p.limit == 4);
+
+	printf("OK Bad specs rejected whole, leaving the params as they were\n");
+}
+
+int main(void)
+{
+	printf("=== Spec Parser Tests ===\n\n");
+
+	test_types();
+	test_rejects();
+	test_whole();
+
+	printf("\nAll spec parser tests passed!\n");
+	return 0;
+}
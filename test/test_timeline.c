@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Unit tests for the agent startup timeline
+ * Tests timeline.c: phase timing, concurrent phases, time to enforcement
+ * and log formatting
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../src/timeline.h"
+
+#define NSEC_PER_MSEC 1000000ULL
+
+/* Test sequential phase durations and unrecorded phases */
+static void test_phase_durations(void)
+{
+	printf("Testing phase durations...\n");
+
+	struct startup_timeline tl;
+
+	timeline_init(&tl);
+	assert(timeline_enforcement_ns(&tl) == 0);
+
+	timeline_begin(&tl, PHASE_LOAD);
+	usleep(20 * 1000);
+	timeline_end(&tl, PHASE_LOAD);
+
+	timeline_begin(&tl, PHASE_ATTACH);
+	usleep(5 * 1000);
+	timeline_end(&tl, PHASE_ATTACH);
+	timeline_mark_enforced(&tl);
+
+	__u64 load = timeline_phase_ns(&tl, PHASE_LOAD);
+	__u64 attach = timeline_phase_ns(&tl, PHASE_ATTACH);
+	__u64 enforced = timeline_enforcement_ns(&tl);
+
+	assert(load >= 20 * NSEC_PER_MSEC && load < 1000 * NSEC_PER_MSEC);
+	assert(attach >= 5 * NSEC_PER_MSEC && attach < load);
+	assert(enforced >= load + attach);
+	printf("  load=%.1fms attach=%.1fms enforced=%.1fms\n",
+	       load / 1e6, attach / 1e6, enforced / 1e6);
+
+	/* Phases that never ran, or never finished, report nothing */
+	assert(timeline_phase_ns(&tl, PHASE_HANDOFF_WAIT) == 0);
+	timeline_begin(&tl, PHASE_CONFIG);
+	assert(timeline_phase_ns(&tl, PHASE_CONFIG) == 0);
+
+	/* Ending a phase that never began is ignored */
+	timeline_end(&tl, PHASE_RINGBUF);
+	assert(timeline_phase_ns(&tl, PHASE_RINGBUF) == 0);
+
+	printf("OK Phase durations correct\n");
+}
+
+static struct startup_timeline shared_tl;
+
+static void *config_phase(void *arg)
+{
+	(void)arg;
+	timeline_begin(&shared_tl, PHASE_CONFIG);
+	usleep(30 * 1000);
+	timeline_end(&shared_tl, PHASE_CONFIG);
+	return NULL;
+}
+
+/* Test phases running concurrently on different threads */
+static void test_concurrent_phases(void)
+{
+	printf("Testing concurrent phases...\n");
+
+	pthread_t thread;
+
+	timeline_init(&shared_tl);
+	assert(pthread_create(&thread, NULL, config_phase, NULL) == 0);
+	timeline_begin(&shared_tl, PHASE_CGROUP_INDEX);
+	usleep(30 * 1000);
+	timeline_end(&shared_tl, PHASE_CGROUP_INDEX);
+	pthread_join(thread, NULL);
+
+	__u64 config = timeline_phase_ns(&shared_tl, PHASE_CONFIG);
+	__u64 index = timeline_phase_ns(&shared_tl, PHASE_CGROUP_INDEX);
+	__u64 start = shared_tl.start_ns[PHASE_CONFIG] < shared_tl.start_ns[PHASE_CGROUP_INDEX] ?
+		      shared_tl.start_ns[PHASE_CONFIG] : shared_tl.start_ns[PHASE_CGROUP_INDEX];
+	__u64 end = shared_tl.end_ns[PHASE_CONFIG] > shared_tl.end_ns[PHASE_CGROUP_INDEX] ?
+		    shared_tl.end_ns[PHASE_CONFIG] : shared_tl.end_ns[PHASE_CGROUP_INDEX];
+
+	assert(config >= 30 * NSEC_PER_MSEC && index >= 30 * NSEC_PER_MSEC);
+	/* Overlapping phases take less wall time than their sum */
+	assert(end - start < config + index);
+	printf("  config=%.1fms cgroup_index=%.1fms wall=%.1fms\n",
+	       config / 1e6, index / 1e6, (end - start) / 1e6);
+
+	printf("OK Concurrent phases overlap\n");
+}
+
+/* Test the startup log line */
+static void test_format(void)
+{
+	printf("Testing timeline formatting...\n");
+
+	struct startup_timeline tl = { .origin_ns = 1000 * NSEC_PER_MSEC };
+	char buf[256];
+
+	tl.start_ns[PHASE_OPEN] = 1000 * NSEC_PER_MSEC;
+	tl.end_ns[PHASE_OPEN] = 1002 * NSEC_PER_MSEC;
+	tl.start_ns[PHASE_LOAD] = 1002 * NSEC_PER_MSEC;
+	tl.end_ns[PHASE_LOAD] = 1087 * NSEC_PER_MSEC;
+	tl.start_ns[PHASE_CONFIG] = 1090 * NSEC_PER_MSEC;  /* Still running */
+	tl.enforced_ns = 1088 * NSEC_PER_MSEC;
+
+	int n = timeline_format(&tl, buf, sizeof(buf));
+	assert(n == (int)strlen(buf));
+	assert(strcmp(buf, "open=2.0ms load=85.0ms enforced=88.0ms") == 0);
+	printf("  %s\n", buf);
+
+	/* Truncation reports the full length and stays terminated */
+	char small[12];
+	assert(timeline_format(&tl, small, sizeof(small)) == n);
+	assert(strlen(small) == sizeof(small) - 1);
+
+	assert(strcmp(timeline_phase_name(PHASE_CGROUP_INDEX), "cgroup_index") == 0);
+	assert(strcmp(timeline_phase_name(NR_STARTUP_PHASES), "unknown") == 0);
+
+	printf("OK Formatting correct\n");
+}
+
+int main(void)
+{
+	printf("Running startup timeline tests...\n\n");
+
+	test_phase_durations();
+	test_concurrent_phases();
+	test_format();
+
+	printf("\nAll startup timeline tests passed!\n");
+	return 0;
+}